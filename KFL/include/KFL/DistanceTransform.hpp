@@ -0,0 +1,54 @@
+/**
+ * @file DistanceTransform.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KFL_DISTANCE_TRANSFORM_HPP
+#define _KFL_DISTANCE_TRANSFORM_HPP
+
+#pragma once
+
+#include <KFL/Types.hpp>
+
+namespace KlayGE
+{
+	namespace MathLib
+	{
+		// Exact squared Euclidean distance transform of a sampled function, from "Distance Transforms of Sampled Functions"
+		// by Felzenszwalb and Huttenlocher. Replaces each f(p) with the min over q of (|p - q|^2 + f(q)). If f is 0 on the
+		// features and infinity elsewhere, that's the squared distance to the nearest feature.
+		//
+		// Samples are x first, then y, then z. Images have a depth of 1. If nearest isn't null, it gets the index of the q,
+		// or uint32_t(-1) when all f are infinity. The axes are transformed one after another, lines of an axis are spread
+		// over num_threads threads. 0 means all the hardware threads.
+		void squared_distance_transform(float* f, uint32_t* nearest, uint32_t width, uint32_t height, uint32_t depth,
+			uint32_t num_threads = 0);
+	}
+}
+
+#endif		// _KFL_DISTANCE_TRANSFORM_HPP
@@ -54,6 +54,7 @@ namespace KlayGE
 	typedef std::shared_ptr<XMLNode> XMLNodePtr;
 	class XMLAttribute;
 	typedef std::shared_ptr<XMLAttribute> XMLAttributePtr;
+	class XMLReader;
 
 	class bad_join;
 	template <typename ResultType>
@@ -73,6 +73,7 @@ namespace KlayGE
 		SIMDVectorF4 Sgn(SIMDVectorF4 const & x);
 		SIMDVectorF4 Sqr(SIMDVectorF4 const & x);
 		SIMDVectorF4 Cube(SIMDVectorF4 const & x);
+		SIMDVectorF4 Sqrt(SIMDVectorF4 const & x);
 
 		SIMDVectorF4 LoadVector1(float v);
 		SIMDVectorF4 LoadVector2(float2 const & v);
@@ -34,6 +34,8 @@
 #pragma once
 
 #include <boost/assert.hpp>
+#include <algorithm>
+#include <atomic>
 #include <thread>
 #include <condition_variable>
 #include <mutex>
@@ -612,6 +614,54 @@ namespace KlayGE
 	private:
 		std::shared_ptr<thread_pool_common_data_t> data_;
 	};
+
+	// Runs task(i) for i in [0, num_tasks) on the calling thread and up to num_threads - 1 threads of the pool. Tasks are
+	//  handed out one at a time, so uneven ones balance. Returns when all of them are done.
+	// If a task throws, the tasks not started yet are skipped, and the first exception is rethrown after all the threads
+	//  are joined.
+	template <typename Task>
+	inline void parallel_for(thread_pool& tp, uint32_t num_threads, uint32_t num_tasks, Task const & task)
+	{
+		std::atomic<uint32_t> next_task(0);
+		std::atomic<bool> failed(false);
+		std::exception_ptr first_exception;
+		std::mutex exception_mutex;
+		auto worker = [&task, &next_task, &failed, &first_exception, &exception_mutex, num_tasks]
+			{
+				try
+				{
+					for (uint32_t i = next_task ++; (i < num_tasks) && !failed; i = next_task ++)
+					{
+						task(i);
+					}
+				}
+				catch (...)
+				{
+					std::lock_guard<std::mutex> lock(exception_mutex);
+					if (!first_exception)
+					{
+						first_exception = std::current_exception();
+					}
+					failed = true;
+				}
+			};
+
+		std::vector<joiner<void>> joiners;
+		for (uint32_t i = 1; i < std::min(num_threads, num_tasks); ++ i)
+		{
+			joiners.push_back(tp(worker));
+		}
+		worker();
+		for (auto& joiner : joiners)
+		{
+			joiner();
+		}
+
+		if (first_exception)
+		{
+			std::rethrow_exception(first_exception);
+		}
+	}
 }
 
 #endif		// _KFL_THREAD_HPP
@@ -182,6 +182,13 @@ namespace KlayGE
 	std::string ReadShortString(ResIdentifierPtr const & res);
 	void WriteShortString(std::ostream& os, std::string const & str);
 
+	// Different in every call, in every process running at the same time. For the names of intermediate files.
+	std::string UniqueBuildTag();
+	// write writes the file under the temporary name it's given, which is renamed to name afterward. A reader never sees
+	// a half written file, and writers in other threads or processes never write into the same one. If write throws,
+	// nothing is left behind and false is returned.
+	bool WriteFileAtomically(std::string const & name, std::function<void(std::string const & tmp_name)> const & write);
+
 	template <typename T, typename... Args>
 	inline std::shared_ptr<T> MakeSharedPtr(Args&&... args)
 	{
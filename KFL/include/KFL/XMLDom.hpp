@@ -34,6 +34,7 @@
 #pragma once
 
 #include <iosfwd>
+#include <string>
 #include <vector>
 
 namespace KlayGE
@@ -131,6 +132,12 @@ namespace KlayGE
 		float ValueFloat() const;
 		std::string ValueString() const;
 
+		// Parses a comma separated list of numbers, such as an array in a CDATA node, in place. Returns the number of
+		// values written, no more than max_count.
+		uint32_t ValueArray(int32_t* vals, uint32_t max_count) const;
+		uint32_t ValueArray(uint32_t* vals, uint32_t max_count) const;
+		uint32_t ValueArray(float* vals, uint32_t max_count) const;
+
 	private:
 		void* node_;
 		std::string name_;
@@ -167,6 +174,94 @@ namespace KlayGE
 		std::string name_;
 		std::string value_;
 	};
+
+	// Reads a document one tag at a time, without building a DOM. Only a window of the source is kept in memory, so
+	// reading a huge document, like a meshml with millions of vertices, takes memory for the results only. The name and
+	// the attributes of a tag are valid until the next read.
+	class XMLReader
+	{
+	public:
+		explicit XMLReader(ResIdentifierPtr const & source);
+
+		// Moves to the next start or end tag. Text, CDATA, comments, declarations and processing instructions are
+		// skipped. An empty element, <a/>, is read as a start tag followed by an end tag. Returns false at the end of the
+		// document. Throws on an unterminated tag, comment or CDATA section, on an end tag without a start tag or with
+		// another name than its start tag, and at the end of the input while elements are still open.
+		bool Read();
+		// Moves to the next start tag of a child of the element at parent_depth, passing over the rest of the previous
+		// child. Returns false after the end tag of the parent.
+		bool ReadChild(uint32_t parent_depth);
+		// Moves to the end tag of the current start tag
+		void Skip();
+		// The same as Skip, and returns the source of the element, so a small part of a big document can be parsed by
+		// XMLDocument
+		std::string ReadElementSource();
+
+		bool IsStartElement() const
+		{
+			return start_;
+		}
+		std::string const & Name() const
+		{
+			return name_;
+		}
+		// 0 for the root element
+		uint32_t Depth() const
+		{
+			return depth_;
+		}
+
+		bool HasAttrib(std::string const & name) const;
+
+		bool TryConvertAttrib(std::string const & name, int32_t& val, int32_t default_val) const;
+		bool TryConvertAttrib(std::string const & name, uint32_t& val, uint32_t default_val) const;
+		bool TryConvertAttrib(std::string const & name, float& val, float default_val) const;
+
+		int32_t AttribInt(std::string const & name, int32_t default_val) const;
+		uint32_t AttribUInt(std::string const & name, uint32_t default_val) const;
+		float AttribFloat(std::string const & name, float default_val) const;
+		std::string AttribString(std::string const & name, std::string default_val) const;
+
+		// Parses a list of numbers separated by spaces or commas. Returns the number of values written, no more than
+		// max_count.
+		uint32_t AttribArray(std::string const & name, int32_t* vals, uint32_t max_count) const;
+		uint32_t AttribArray(std::string const & name, uint32_t* vals, uint32_t max_count) const;
+		uint32_t AttribArray(std::string const & name, float* vals, uint32_t max_count) const;
+
+	private:
+		struct AttribRange
+		{
+			size_t name;
+			size_t name_len;
+			size_t value;
+			size_t value_len;
+		};
+
+		bool Fill();
+		bool Ensure(size_t len);
+		bool Find(char const * pattern, size_t from, size_t& found);
+		bool FindTagEnd(size_t& found);
+		void ParseStartTag(size_t len);
+		AttribRange const * FindAttrib(std::string const & name) const;
+
+	private:
+		ResIdentifierPtr source_;
+
+		std::vector<char> buf_;
+		size_t pos_;
+		size_t end_;
+
+		std::string name_;
+		std::vector<AttribRange> attrs_;
+		bool start_;
+		bool pending_end_;
+		uint32_t depth_;
+		std::vector<std::string> open_names_;
+		size_t tag_begin_;
+
+		std::string* capture_;
+		size_t capture_begin_;
+	};
 }
 
 #endif		// _KFL_XMLDOM_HPP
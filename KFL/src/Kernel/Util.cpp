@@ -42,10 +42,14 @@
 	#include <cstdlib>
 	#include <cwchar>
 	#include <clocale>
+	#include <unistd.h>
 #endif
 
 #include <vector>
 #include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <sstream>
 #include <boost/assert.hpp>
 
 #include <KFL/Util.hpp>
@@ -220,4 +224,49 @@ namespace KlayGE
 			os.write(&str[0], len * sizeof(str[0]));
 		}
 	}
+
+	std::string UniqueBuildTag()
+	{
+		static std::atomic<uint32_t> counter(0);
+
+		std::ostringstream ss;
+#ifdef KLAYGE_PLATFORM_WINDOWS
+		ss << std::hex << ::GetCurrentProcessId();
+#else
+		ss << std::hex << ::getpid();
+#endif
+		ss << '_' << counter ++;
+		return ss.str();
+	}
+
+	bool WriteFileAtomically(std::string const & name, std::function<void(std::string const & tmp_name)> const & write)
+	{
+		std::string const tmp_name = name + '.' + UniqueBuildTag() + ".tmp";
+		bool renamed;
+		try
+		{
+			write(tmp_name);
+
+#ifdef KLAYGE_PLATFORM_WINDOWS
+			// rename doesn't replace an existing file on Windows
+			std::wstring tmp_wname;
+			std::wstring wname;
+			Convert(tmp_wname, tmp_name);
+			Convert(wname, name);
+			renamed = (::MoveFileExW(tmp_wname.c_str(), wname.c_str(), MOVEFILE_REPLACE_EXISTING) != 0);
+#else
+			renamed = (0 == std::rename(tmp_name.c_str(), name.c_str()));
+#endif
+		}
+		catch (...)
+		{
+			renamed = false;
+		}
+
+		if (!renamed)
+		{
+			std::remove(tmp_name.c_str());
+		}
+		return renamed;
+	}
 }
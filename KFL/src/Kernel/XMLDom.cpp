@@ -29,9 +29,12 @@
  */
 
 #include <KFL/KFL.hpp>
+#include <KFL/ErrorHandling.hpp>
 #include <KFL/Util.hpp>
 #include <KFL/ResIdentifier.hpp>
 
+#include <algorithm>
+
 #if defined(KLAYGE_COMPILER_CLANGC2)
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wunused-variable" // Ignore mpl_assertion_in_line_xxx
@@ -46,6 +49,328 @@
 
 #include <KFL/XMLDom.hpp>
 
+namespace
+{
+	using namespace KlayGE;
+
+	bool IsSpace(char c)
+	{
+		return (' ' == c) || ('\t' == c) || ('\n' == c) || ('\r' == c) || ('\v' == c) || ('\f' == c);
+	}
+
+	// Hand-written scanners for the plain forms of numbers, which covers nearly all values in the resource files. Anything
+	// else, like "+1", "1e100" or garbage, is left to lexical_cast, so the results and the errors are the same as before.
+	bool ScanNumber(char const * first, char const * last, uint32_t& val)
+	{
+		if (first == last)
+		{
+			return false;
+		}
+
+		uint64_t v = 0;
+		for (; first != last; ++ first)
+		{
+			if ((*first < '0') || (*first > '9'))
+			{
+				return false;
+			}
+			v = v * 10 + (*first - '0');
+			if (v > 0xFFFFFFFFU)
+			{
+				return false;
+			}
+		}
+
+		val = static_cast<uint32_t>(v);
+		return true;
+	}
+
+	bool ScanNumber(char const * first, char const * last, int32_t& val)
+	{
+		bool const neg = (first != last) && ('-' == *first);
+		if (neg)
+		{
+			++ first;
+		}
+
+		uint32_t v;
+		if (!ScanNumber(first, last, v) || (v > (neg ? 0x80000000U : 0x7FFFFFFFU)))
+		{
+			return false;
+		}
+
+		val = static_cast<int32_t>(neg ? -static_cast<int64_t>(v) : static_cast<int64_t>(v));
+		return true;
+	}
+
+	bool ScanNumber(char const * first, char const * last, float& val)
+	{
+		bool const neg = (first != last) && ('-' == *first);
+		if (neg)
+		{
+			++ first;
+		}
+
+		uint64_t mantissa = 0;
+		int exp10 = 0;
+		bool has_digits = false;
+		for (; (first != last) && (*first >= '0') && (*first <= '9'); ++ first)
+		{
+			mantissa = mantissa * 10 + (*first - '0');
+			if (mantissa > (1ULL << 32))
+			{
+				return false;
+			}
+			has_digits = true;
+		}
+		if (!has_digits)
+		{
+			return false;
+		}
+
+		if ((first != last) && ('.' == *first))
+		{
+			++ first;
+			has_digits = false;
+			int pending_zeros = 0;
+			for (; (first != last) && (*first >= '0') && (*first <= '9'); ++ first)
+			{
+				has_digits = true;
+
+				// Trailing zeros in the fraction don't take mantissa bits
+				if ('0' == *first)
+				{
+					++ pending_zeros;
+				}
+				else
+				{
+					for (int i = 0; i <= pending_zeros; ++ i)
+					{
+						mantissa *= 10;
+					}
+					mantissa += *first - '0';
+					exp10 -= pending_zeros + 1;
+					pending_zeros = 0;
+					if (mantissa > (1ULL << 32))
+					{
+						return false;
+					}
+				}
+			}
+			if (!has_digits)
+			{
+				return false;
+			}
+		}
+
+		if ((first != last) && (('e' == *first) || ('E' == *first)))
+		{
+			++ first;
+			int32_t e;
+			if (!ScanNumber(first, last, e) || (e < -100) || (e > 100))
+			{
+				return false;
+			}
+			exp10 += e;
+			first = last;
+		}
+
+		if (first != last)
+		{
+			return false;
+		}
+
+		// Both the mantissa and the power of 10 are exact in float, so one operation gives the correctly rounded result
+		static float const pow10[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+		if ((mantissa > (1ULL << 24)) || (exp10 < -10) || (exp10 > 10))
+		{
+			return false;
+		}
+
+		float f = static_cast<float>(mantissa);
+		f = (exp10 < 0) ? f / pow10[-exp10] : f * pow10[exp10];
+		val = neg ? -f : f;
+		return true;
+	}
+
+	template <typename T>
+	T ConvertValue(char const * first, char const * last)
+	{
+		T val;
+		if (!ScanNumber(first, last, val))
+		{
+			val = boost::lexical_cast<T>(first, last - first);
+		}
+		return val;
+	}
+
+	template <typename T>
+	bool TryConvertValue(char const * first, char const * last, T& val)
+	{
+		return ScanNumber(first, last, val) || boost::conversion::try_lexical_convert(first, last - first, val);
+	}
+
+	template <typename T>
+	uint32_t ConvertList(char const * str, size_t len, T* vals, uint32_t max_count)
+	{
+		char const * const end = str + len;
+		uint32_t n = 0;
+		while (n < max_count)
+		{
+			char const * first = str;
+			char const * const next = std::find(str, end, ',');
+			char const * last = next;
+			while ((first != last) && IsSpace(*first))
+			{
+				++ first;
+			}
+			while ((first != last) && IsSpace(*(last - 1)))
+			{
+				-- last;
+			}
+
+			vals[n] = ConvertValue<T>(first, last);
+			++ n;
+
+			if (next == end)
+			{
+				break;
+			}
+			str = next + 1;
+		}
+		return n;
+	}
+
+	template <typename T>
+	T ConvertNodeValue(void* node)
+	{
+		rapidxml::xml_node<>* xnode = static_cast<rapidxml::xml_node<>*>(node);
+		return ConvertValue<T>(xnode->value(), xnode->value() + xnode->value_size());
+	}
+
+	template <typename T>
+	T ConvertAttribValue(void* node, std::string const & name, T default_val)
+	{
+		rapidxml::xml_attribute<>* attr = static_cast<rapidxml::xml_node<>*>(node)->first_attribute(name.c_str());
+		return attr ? ConvertValue<T>(attr->value(), attr->value() + attr->value_size()) : default_val;
+	}
+
+	template <typename T>
+	bool TryConvertAttribValue(void* node, std::string const & name, T& val, T default_val)
+	{
+		val = default_val;
+
+		rapidxml::xml_attribute<>* attr = static_cast<rapidxml::xml_node<>*>(node)->first_attribute(name.c_str());
+		return attr ? TryConvertValue(attr->value(), attr->value() + attr->value_size(), val) : true;
+	}
+
+	template <typename T>
+	uint32_t ConvertSeparatedList(char const * str, size_t len, T* vals, uint32_t max_count)
+	{
+		char const * const end = str + len;
+		uint32_t n = 0;
+		while (n < max_count)
+		{
+			while ((str != end) && (IsSpace(*str) || (',' == *str)))
+			{
+				++ str;
+			}
+			if (str == end)
+			{
+				break;
+			}
+
+			char const * const first = str;
+			while ((str != end) && !IsSpace(*str) && (*str != ','))
+			{
+				++ str;
+			}
+			vals[n] = ConvertValue<T>(first, str);
+			++ n;
+		}
+		return n;
+	}
+
+	// The same references as rapidxml translates, the 5 predefined entities and character references
+	std::string DecodeEntities(char const * first, char const * last)
+	{
+		std::string ret;
+		ret.reserve(last - first);
+		while (first != last)
+		{
+			if (*first != '&')
+			{
+				ret.push_back(*first);
+				++ first;
+				continue;
+			}
+
+			char const * const semicolon = std::find(first, last, ';');
+			std::string const entity(first + 1, semicolon);
+			if (semicolon == last)
+			{
+				ret.append(first, last);
+				break;
+			}
+
+			if ("lt" == entity)
+			{
+				ret.push_back('<');
+			}
+			else if ("gt" == entity)
+			{
+				ret.push_back('>');
+			}
+			else if ("amp" == entity)
+			{
+				ret.push_back('&');
+			}
+			else if ("quot" == entity)
+			{
+				ret.push_back('"');
+			}
+			else if ("apos" == entity)
+			{
+				ret.push_back('\'');
+			}
+			else if ((entity.size() > 1) && ('#' == entity[0]))
+			{
+				uint32_t code = static_cast<uint32_t>(('x' == entity[1])
+					? std::strtoul(entity.c_str() + 2, nullptr, 16) : std::strtoul(entity.c_str() + 1, nullptr, 10));
+				if (code < 0x80)
+				{
+					ret.push_back(static_cast<char>(code));
+				}
+				else if (code < 0x800)
+				{
+					ret.push_back(static_cast<char>(0xC0 | (code >> 6)));
+					ret.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+				}
+				else if (code < 0x10000)
+				{
+					ret.push_back(static_cast<char>(0xE0 | (code >> 12)));
+					ret.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+					ret.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+				}
+				else
+				{
+					ret.push_back(static_cast<char>(0xF0 | (code >> 18)));
+					ret.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+					ret.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+					ret.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+				}
+			}
+			else
+			{
+				ret.append(first, semicolon + 1);
+			}
+
+			first = semicolon + 1;
+		}
+		return ret;
+	}
+}
+
 namespace KlayGE
 {
 	XMLDocument::XMLDocument()
@@ -272,50 +597,38 @@ namespace KlayGE
 
 	bool XMLNode::TryConvertAttrib(std::string const & name, int32_t& val, int32_t default_val) const
 	{
-		val = default_val;
-
-		XMLAttributePtr attr = this->Attrib(name);
-		return attr ? attr->TryConvert(val) : true;
+		return TryConvertAttribValue(node_, name, val, default_val);
 	}
 
 	bool XMLNode::TryConvertAttrib(std::string const & name, uint32_t& val, uint32_t default_val) const
 	{
-		val = default_val;
-
-		XMLAttributePtr attr = this->Attrib(name);
-		return attr ? attr->TryConvert(val) : true;
+		return TryConvertAttribValue(node_, name, val, default_val);
 	}
 
 	bool XMLNode::TryConvertAttrib(std::string const & name, float& val, float default_val) const
 	{
-		val = default_val;
-
-		XMLAttributePtr attr = this->Attrib(name);
-		return attr ? attr->TryConvert(val) : true;
+		return TryConvertAttribValue(node_, name, val, default_val);
 	}
 
 	int32_t XMLNode::AttribInt(std::string const & name, int32_t default_val) const
 	{
-		XMLAttributePtr attr = this->Attrib(name);
-		return attr ? attr->ValueInt() : default_val;
+		return ConvertAttribValue(node_, name, default_val);
 	}
 
 	uint32_t XMLNode::AttribUInt(std::string const & name, uint32_t default_val) const
 	{
-		XMLAttributePtr attr = this->Attrib(name);
-		return attr ? attr->ValueUInt() : default_val;
+		return ConvertAttribValue(node_, name, default_val);
 	}
 
 	float XMLNode::AttribFloat(std::string const & name, float default_val) const
 	{
-		XMLAttributePtr attr = this->Attrib(name);
-		return attr ? attr->ValueFloat() : default_val;
+		return ConvertAttribValue(node_, name, default_val);
 	}
 
 	std::string XMLNode::AttribString(std::string const & name, std::string default_val) const
 	{
-		XMLAttributePtr attr = this->Attrib(name);
-		return attr ? attr->ValueString() : default_val;
+		rapidxml::xml_attribute<>* attr = static_cast<rapidxml::xml_node<>*>(node_)->first_attribute(name.c_str());
+		return attr ? std::string(attr->value(), attr->value_size()) : default_val;
 	}
 
 	XMLNodePtr XMLNode::FirstNode(std::string const & name) const
@@ -490,32 +803,35 @@ namespace KlayGE
 
 	bool XMLNode::TryConvert(int32_t& val) const
 	{
-		return boost::conversion::try_lexical_convert(this->ValueString(), val);
+		rapidxml::xml_node<>* node = static_cast<rapidxml::xml_node<>*>(node_);
+		return TryConvertValue(node->value(), node->value() + node->value_size(), val);
 	}
 
 	bool XMLNode::TryConvert(uint32_t& val) const
 	{
-		return boost::conversion::try_lexical_convert(this->ValueString(), val);
+		rapidxml::xml_node<>* node = static_cast<rapidxml::xml_node<>*>(node_);
+		return TryConvertValue(node->value(), node->value() + node->value_size(), val);
 	}
 
 	bool XMLNode::TryConvert(float& val) const
 	{
-		return boost::conversion::try_lexical_convert(this->ValueString(), val);
+		rapidxml::xml_node<>* node = static_cast<rapidxml::xml_node<>*>(node_);
+		return TryConvertValue(node->value(), node->value() + node->value_size(), val);
 	}
 
 	int32_t XMLNode::ValueInt() const
 	{
-		return boost::lexical_cast<int32_t>(this->ValueString());
+		return ConvertNodeValue<int32_t>(node_);
 	}
 
 	uint32_t XMLNode::ValueUInt() const
 	{
-		return boost::lexical_cast<uint32_t>(this->ValueString());
+		return ConvertNodeValue<uint32_t>(node_);
 	}
 
 	float XMLNode::ValueFloat() const
 	{
-		return boost::lexical_cast<float>(this->ValueString());
+		return ConvertNodeValue<float>(node_);
 	}
 
 	std::string XMLNode::ValueString() const
@@ -524,6 +840,24 @@ namespace KlayGE
 			static_cast<rapidxml::xml_node<>*>(node_)->value_size());
 	}
 
+	uint32_t XMLNode::ValueArray(int32_t* vals, uint32_t max_count) const
+	{
+		rapidxml::xml_node<>* node = static_cast<rapidxml::xml_node<>*>(node_);
+		return ConvertList(node->value(), node->value_size(), vals, max_count);
+	}
+
+	uint32_t XMLNode::ValueArray(uint32_t* vals, uint32_t max_count) const
+	{
+		rapidxml::xml_node<>* node = static_cast<rapidxml::xml_node<>*>(node_);
+		return ConvertList(node->value(), node->value_size(), vals, max_count);
+	}
+
+	uint32_t XMLNode::ValueArray(float* vals, uint32_t max_count) const
+	{
+		rapidxml::xml_node<>* node = static_cast<rapidxml::xml_node<>*>(node_);
+		return ConvertList(node->value(), node->value_size(), vals, max_count);
+	}
+
 
 	XMLAttribute::XMLAttribute(void* attr)
 		: attr_(attr)
@@ -574,36 +908,425 @@ namespace KlayGE
 
 	bool XMLAttribute::TryConvert(int32_t& val) const
 	{
-		return boost::conversion::try_lexical_convert(value_, val);
+		return TryConvertValue(value_.data(), value_.data() + value_.size(), val);
 	}
 
 	bool XMLAttribute::TryConvert(uint32_t& val) const
 	{
-		return boost::conversion::try_lexical_convert(value_, val);
+		return TryConvertValue(value_.data(), value_.data() + value_.size(), val);
 	}
 
 	bool XMLAttribute::TryConvert(float& val) const
 	{
-		return boost::conversion::try_lexical_convert(value_, val);
+		return TryConvertValue(value_.data(), value_.data() + value_.size(), val);
 	}
 
 	int32_t XMLAttribute::ValueInt() const
 	{
-		return boost::lexical_cast<int32_t>(value_);
+		return ConvertValue<int32_t>(value_.data(), value_.data() + value_.size());
 	}
 
 	uint32_t XMLAttribute::ValueUInt() const
 	{
-		return boost::lexical_cast<uint32_t>(value_);
+		return ConvertValue<uint32_t>(value_.data(), value_.data() + value_.size());
 	}
 
 	float XMLAttribute::ValueFloat() const
 	{
-		return boost::lexical_cast<float>(value_);
+		return ConvertValue<float>(value_.data(), value_.data() + value_.size());
 	}
 
 	std::string const & XMLAttribute::ValueString() const
 	{
 		return value_;
 	}
+
+
+	XMLReader::XMLReader(ResIdentifierPtr const & source)
+		: source_(source), buf_(64 * 1024), pos_(0), end_(0),
+			start_(false), pending_end_(false), depth_(0), tag_begin_(0),
+			capture_(nullptr), capture_begin_(0)
+	{
+	}
+
+	// Moves the unread part to the front and reads more after it. The buffer only grows for a tag longer than it.
+	bool XMLReader::Fill()
+	{
+		if (capture_ != nullptr)
+		{
+			capture_->append(buf_.data() + capture_begin_, buf_.data() + pos_);
+			capture_begin_ = 0;
+		}
+
+		std::memmove(buf_.data(), buf_.data() + pos_, end_ - pos_);
+		end_ -= pos_;
+		pos_ = 0;
+		if (end_ == buf_.size())
+		{
+			buf_.resize(buf_.size() * 2);
+		}
+
+		if (!source_ || !*source_)
+		{
+			return false;
+		}
+		source_->read(buf_.data() + end_, buf_.size() - end_);
+		size_t const len = static_cast<size_t>(source_->gcount());
+		end_ += len;
+		return len > 0;
+	}
+
+	bool XMLReader::Ensure(size_t len)
+	{
+		while (end_ - pos_ < len)
+		{
+			if (!this->Fill())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// found is the offset from pos_
+	bool XMLReader::Find(char const * pattern, size_t from, size_t& found)
+	{
+		size_t const pattern_len = std::strlen(pattern);
+		for (;;)
+		{
+			char const * const first = buf_.data() + pos_ + from;
+			char const * const last = buf_.data() + end_;
+			char const * const iter = std::search(first, last, pattern, pattern + pattern_len);
+			if (iter != last)
+			{
+				found = iter - (buf_.data() + pos_);
+				return true;
+			}
+
+			from = std::max(from, end_ - pos_ - std::min(end_ - pos_, pattern_len - 1));
+			if (!this->Fill())
+			{
+				return false;
+			}
+		}
+	}
+
+	// The > closing the tag at pos_, not one in a quoted attribute value
+	bool XMLReader::FindTagEnd(size_t& found)
+	{
+		char quote = 0;
+		size_t i = 1;
+		for (;;)
+		{
+			for (; pos_ + i < end_; ++ i)
+			{
+				char const c = buf_[pos_ + i];
+				if (quote != 0)
+				{
+					if (c == quote)
+					{
+						quote = 0;
+					}
+				}
+				else if (('"' == c) || ('\'' == c))
+				{
+					quote = c;
+				}
+				else if ('>' == c)
+				{
+					found = i;
+					return true;
+				}
+			}
+
+			if (!this->Fill())
+			{
+				return false;
+			}
+		}
+	}
+
+	void XMLReader::ParseStartTag(size_t len)
+	{
+		char const * const tag = buf_.data() + pos_;
+		size_t i = 1;
+		while ((i < len) && !IsSpace(tag[i]) && (tag[i] != '/'))
+		{
+			++ i;
+		}
+		name_.assign(tag + 1, tag + i);
+
+		attrs_.clear();
+		for (;;)
+		{
+			while ((i < len) && IsSpace(tag[i]))
+			{
+				++ i;
+			}
+			if ((i >= len) || ('/' == tag[i]))
+			{
+				break;
+			}
+
+			AttribRange attr;
+			attr.name = pos_ + i;
+			while ((i < len) && !IsSpace(tag[i]) && (tag[i] != '='))
+			{
+				++ i;
+			}
+			attr.name_len = pos_ + i - attr.name;
+
+			while ((i < len) && (IsSpace(tag[i]) || ('=' == tag[i])))
+			{
+				++ i;
+			}
+			if ((i >= len) || ((tag[i] != '"') && (tag[i] != '\'')))
+			{
+				break;
+			}
+			char const quote = tag[i];
+			++ i;
+			attr.value = pos_ + i;
+			while ((i < len) && (tag[i] != quote))
+			{
+				++ i;
+			}
+			attr.value_len = pos_ + i - attr.value;
+			++ i;
+
+			attrs_.push_back(attr);
+		}
+	}
+
+	bool XMLReader::Read()
+	{
+		attrs_.clear();
+
+		if (pending_end_)
+		{
+			pending_end_ = false;
+			start_ = false;
+			open_names_.pop_back();
+			depth_ = static_cast<uint32_t>(open_names_.size());
+			return true;
+		}
+
+		for (;;)
+		{
+			size_t found;
+			if (!this->Find("<", 0, found))
+			{
+				pos_ = end_;
+				if (!open_names_.empty())
+				{
+					TMSG("Unexpected end of XML, elements are still open");
+				}
+				return false;
+			}
+			pos_ += found;
+			this->Ensure(9);
+
+			char const * const tag = buf_.data() + pos_;
+			size_t const available = end_ - pos_;
+			if ((available >= 4) && (0 == std::memcmp(tag, "<!--", 4)))
+			{
+				if (!this->Find("-->", 4, found))
+				{
+					TMSG("Unterminated XML comment");
+				}
+				pos_ += found + 3;
+			}
+			else if ((available >= 9) && (0 == std::memcmp(tag, "<![CDATA[", 9)))
+			{
+				if (!this->Find("]]>", 9, found))
+				{
+					TMSG("Unterminated XML CDATA");
+				}
+				pos_ += found + 3;
+			}
+			else if ((available >= 2) && ('?' == tag[1]))
+			{
+				if (!this->Find("?>", 2, found))
+				{
+					TMSG("Unterminated XML processing instruction");
+				}
+				pos_ += found + 2;
+			}
+			else if ((available >= 2) && ('!' == tag[1]))
+			{
+				if (!this->Find(">", 2, found))
+				{
+					TMSG("Unterminated XML declaration");
+				}
+				pos_ += found + 1;
+			}
+			else
+			{
+				if (!this->FindTagEnd(found))
+				{
+					TMSG("Unterminated XML tag");
+				}
+
+				tag_begin_ = pos_;
+				if ('/' == buf_[pos_ + 1])
+				{
+					if (open_names_.empty())
+					{
+						TMSG("XML end tag without a start tag");
+					}
+
+					size_t first = 2;
+					size_t last = found;
+					while ((first < last) && IsSpace(buf_[pos_ + first]))
+					{
+						++ first;
+					}
+					while ((last > first) && IsSpace(buf_[pos_ + last - 1]))
+					{
+						-- last;
+					}
+					name_.assign(buf_.data() + pos_ + first, buf_.data() + pos_ + last);
+					if (name_ != open_names_.back())
+					{
+						TMSG("XML end tag doesn't match the start tag");
+					}
+
+					start_ = false;
+					open_names_.pop_back();
+					depth_ = static_cast<uint32_t>(open_names_.size());
+				}
+				else
+				{
+					this->ParseStartTag(found);
+
+					start_ = true;
+					depth_ = static_cast<uint32_t>(open_names_.size());
+					open_names_.push_back(name_);
+					pending_end_ = ('/' == buf_[pos_ + found - 1]);
+				}
+				pos_ += found + 1;
+
+				return true;
+			}
+		}
+	}
+
+	bool XMLReader::ReadChild(uint32_t parent_depth)
+	{
+		while (this->Read())
+		{
+			if (start_)
+			{
+				if (depth_ == parent_depth + 1)
+				{
+					return true;
+				}
+			}
+			else if (depth_ == parent_depth)
+			{
+				return false;
+			}
+		}
+		return false;
+	}
+
+	void XMLReader::Skip()
+	{
+		if (start_)
+		{
+			uint32_t const depth = depth_;
+			while (this->Read() && (start_ || (depth_ != depth)));
+		}
+	}
+
+	std::string XMLReader::ReadElementSource()
+	{
+		std::string ret;
+		capture_ = &ret;
+		capture_begin_ = tag_begin_;
+		this->Skip();
+		ret.append(buf_.data() + capture_begin_, buf_.data() + pos_);
+		capture_ = nullptr;
+		return ret;
+	}
+
+	XMLReader::AttribRange const * XMLReader::FindAttrib(std::string const & name) const
+	{
+		for (auto const & attr : attrs_)
+		{
+			if ((attr.name_len == name.size()) && (0 == std::memcmp((buf_.data() + attr.name), name.data(), name.size())))
+			{
+				return &attr;
+			}
+		}
+		return nullptr;
+	}
+
+	bool XMLReader::HasAttrib(std::string const & name) const
+	{
+		return this->FindAttrib(name) != nullptr;
+	}
+
+	bool XMLReader::TryConvertAttrib(std::string const & name, int32_t& val, int32_t default_val) const
+	{
+		val = default_val;
+		AttribRange const * attr = this->FindAttrib(name);
+		return attr ? TryConvertValue(buf_.data() + attr->value, buf_.data() + attr->value + attr->value_len, val) : true;
+	}
+
+	bool XMLReader::TryConvertAttrib(std::string const & name, uint32_t& val, uint32_t default_val) const
+	{
+		val = default_val;
+		AttribRange const * attr = this->FindAttrib(name);
+		return attr ? TryConvertValue(buf_.data() + attr->value, buf_.data() + attr->value + attr->value_len, val) : true;
+	}
+
+	bool XMLReader::TryConvertAttrib(std::string const & name, float& val, float default_val) const
+	{
+		val = default_val;
+		AttribRange const * attr = this->FindAttrib(name);
+		return attr ? TryConvertValue(buf_.data() + attr->value, buf_.data() + attr->value + attr->value_len, val) : true;
+	}
+
+	int32_t XMLReader::AttribInt(std::string const & name, int32_t default_val) const
+	{
+		AttribRange const * attr = this->FindAttrib(name);
+		return attr ? ConvertValue<int32_t>(buf_.data() + attr->value, buf_.data() + attr->value + attr->value_len) : default_val;
+	}
+
+	uint32_t XMLReader::AttribUInt(std::string const & name, uint32_t default_val) const
+	{
+		AttribRange const * attr = this->FindAttrib(name);
+		return attr ? ConvertValue<uint32_t>(buf_.data() + attr->value, buf_.data() + attr->value + attr->value_len) : default_val;
+	}
+
+	float XMLReader::AttribFloat(std::string const & name, float default_val) const
+	{
+		AttribRange const * attr = this->FindAttrib(name);
+		return attr ? ConvertValue<float>(buf_.data() + attr->value, buf_.data() + attr->value + attr->value_len) : default_val;
+	}
+
+	std::string XMLReader::AttribString(std::string const & name, std::string default_val) const
+	{
+		AttribRange const * attr = this->FindAttrib(name);
+		return attr ? DecodeEntities(buf_.data() + attr->value, buf_.data() + attr->value + attr->value_len) : default_val;
+	}
+
+	uint32_t XMLReader::AttribArray(std::string const & name, int32_t* vals, uint32_t max_count) const
+	{
+		AttribRange const * attr = this->FindAttrib(name);
+		return attr ? ConvertSeparatedList(buf_.data() + attr->value, attr->value_len, vals, max_count) : 0;
+	}
+
+	uint32_t XMLReader::AttribArray(std::string const & name, uint32_t* vals, uint32_t max_count) const
+	{
+		AttribRange const * attr = this->FindAttrib(name);
+		return attr ? ConvertSeparatedList(buf_.data() + attr->value, attr->value_len, vals, max_count) : 0;
+	}
+
+	uint32_t XMLReader::AttribArray(std::string const & name, float* vals, uint32_t max_count) const
+	{
+		AttribRange const * attr = this->FindAttrib(name);
+		return attr ? ConvertSeparatedList(buf_.data() + attr->value, attr->value_len, vals, max_count) : 0;
+	}
 }
@@ -0,0 +1,234 @@
+/**
+ * @file DistanceTransform.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KFL, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KFL/KFL.hpp>
+#include <KFL/CpuInfo.hpp>
+#include <KFL/Thread.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <KFL/DistanceTransform.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t const LINES_PER_GROUP = 64;
+
+	// Scratch space of a group of lines, for lines up to the longest axis
+	struct LineBuffers
+	{
+		explicit LineBuffers(uint32_t n)
+			: f(n), nearest(n), v(n), z(n + 1)
+		{
+		}
+
+		std::vector<float> f;
+		std::vector<uint32_t> nearest;
+		std::vector<uint32_t> v;
+		std::vector<double> z;
+	};
+
+	// The lower envelope of the parabolas rooted at the finite samples, evaluated at each sample. Computed in double,
+	// so f + q^2 stays exact on large volumes.
+	void TransformLine(float* f, uint32_t* nearest, uint32_t n, uint32_t stride, LineBuffers& buffers)
+	{
+		float const INF = std::numeric_limits<float>::infinity();
+
+		for (uint32_t q = 0; q < n; ++ q)
+		{
+			buffers.f[q] = f[q * stride];
+		}
+		if (nearest)
+		{
+			for (uint32_t q = 0; q < n; ++ q)
+			{
+				buffers.nearest[q] = nearest[q * stride];
+			}
+		}
+
+		int k = -1;
+		for (uint32_t q = 0; q < n; ++ q)
+		{
+			if (buffers.f[q] == INF)
+			{
+				continue;
+			}
+
+			double const fq = buffers.f[q] + static_cast<double>(q) * q;
+			double s = -std::numeric_limits<double>::infinity();
+			while (k >= 0)
+			{
+				uint32_t const vk = buffers.v[k];
+				s = (fq - (buffers.f[vk] + static_cast<double>(vk) * vk)) / (2.0 * q - 2.0 * vk);
+				if (s > buffers.z[k])
+				{
+					break;
+				}
+				-- k;
+				s = -std::numeric_limits<double>::infinity();
+			}
+
+			++ k;
+			buffers.v[k] = q;
+			buffers.z[k] = s;
+			buffers.z[k + 1] = std::numeric_limits<double>::infinity();
+		}
+
+		if (k < 0)
+		{
+			for (uint32_t q = 0; q < n; ++ q)
+			{
+				f[q * stride] = INF;
+			}
+			if (nearest)
+			{
+				for (uint32_t q = 0; q < n; ++ q)
+				{
+					nearest[q * stride] = static_cast<uint32_t>(-1);
+				}
+			}
+			return;
+		}
+
+		k = 0;
+		for (uint32_t q = 0; q < n; ++ q)
+		{
+			while (buffers.z[k + 1] < q)
+			{
+				++ k;
+			}
+
+			uint32_t const vk = buffers.v[k];
+			float const d = static_cast<float>(q) - vk;
+			f[q * stride] = d * d + buffers.f[vk];
+			if (nearest)
+			{
+				nearest[q * stride] = buffers.nearest[vk];
+			}
+		}
+	}
+}
+
+namespace KlayGE
+{
+	namespace MathLib
+	{
+		void squared_distance_transform(float* f, uint32_t* nearest, uint32_t width, uint32_t height, uint32_t depth,
+			uint32_t num_threads)
+		{
+			uint32_t const num_samples = width * height * depth;
+			if (0 == num_samples)
+			{
+				return;
+			}
+
+			if (nearest)
+			{
+				for (uint32_t i = 0; i < num_samples; ++ i)
+				{
+					nearest[i] = i;
+				}
+			}
+
+			if (0 == num_threads)
+			{
+				CPUInfo cpu;
+				num_threads = static_cast<uint32_t>(cpu.NumHWThreads());
+			}
+			num_threads = std::max(num_threads, 1U);
+
+			uint32_t const max_length = std::max(std::max(width, height), depth);
+			std::unique_ptr<thread_pool> tp;
+			if (num_threads > 1)
+			{
+				tp = MakeUniquePtr<thread_pool>(1, num_threads);
+			}
+
+			uint32_t const slice = width * height;
+			uint32_t const lengths[] = { width, height, depth };
+			uint32_t const strides[] = { 1, width, slice };
+			for (uint32_t axis = 0; axis < 3; ++ axis)
+			{
+				uint32_t const length = lengths[axis];
+				uint32_t const stride = strides[axis];
+				if (length <= 1)
+				{
+					// Nothing to spread along this axis
+					continue;
+				}
+
+				// Lines are handed out in groups, each with its own buffers
+				uint32_t const num_lines = num_samples / length;
+				uint32_t const num_groups = (num_lines + LINES_PER_GROUP - 1) / LINES_PER_GROUP;
+				auto transform_lines = [f, nearest, width, slice, axis, length, stride, num_lines, max_length](uint32_t group)
+				{
+					LineBuffers buffers(max_length);
+					uint32_t const group_end = std::min((group + 1) * LINES_PER_GROUP, num_lines);
+					for (uint32_t line = group * LINES_PER_GROUP; line < group_end; ++ line)
+					{
+						// The first sample of the line
+						uint32_t start;
+						switch (axis)
+						{
+						case 0:
+							start = line * length;
+							break;
+
+						case 1:
+							start = line / width * slice + line % width;
+							break;
+
+						default:
+							start = line;
+							break;
+						}
+
+						TransformLine(f + start, nearest ? nearest + start : nullptr, length, stride, buffers);
+					}
+				};
+
+				if (tp)
+				{
+					parallel_for(*tp, num_threads, num_groups, transform_lines);
+				}
+				else
+				{
+					for (uint32_t group = 0; group < num_groups; ++ group)
+					{
+						transform_lines(group);
+					}
+				}
+			}
+		}
+	}
+}
@@ -212,6 +212,20 @@ namespace KlayGE
 			return Sqr(x) * x;
 		}
 
+		SIMDVectorF4 Sqrt(SIMDVectorF4 const & x)
+		{
+			SIMDVectorF4 ret;
+#if defined(SIMD_MATH_SSE)
+			ret.Vec() = _mm_sqrt_ps(x.Vec());
+#else
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.Vec()[i] = MathLib::sqrt(x.Vec()[i]);
+			}
+#endif
+			return ret;
+		}
+
 		SIMDVectorF4 LoadVector1(float v)
 		{
 			SIMDVectorF4 ret;
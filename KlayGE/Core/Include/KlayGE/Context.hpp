@@ -57,6 +57,9 @@ namespace KlayGE
 
 		bool perf_profiler;
 		bool location_sensor;
+
+		// In MB. 0 turns texture streaming off.
+		uint32_t texture_streaming_budget;
 	};
 
 	class KLAYGE_CORE_API Context : boost::noncopyable
@@ -153,6 +156,11 @@ namespace KlayGE
 			return deferred_rendering_layer_.get();
 		}
 
+		TextureStreamer* TextureStreamerInstance()
+		{
+			return texture_streamer_.get();
+		}
+
 		thread_pool& ThreadPool()
 		{
 			return *gtp_instance_;
@@ -181,6 +189,7 @@ namespace KlayGE
 		std::unique_ptr<ScriptFactory> script_factory_;
 		std::unique_ptr<AudioDataSourceFactory> audio_data_src_factory_;
 		std::unique_ptr<DeferredRenderingLayer> deferred_rendering_layer_;
+		std::unique_ptr<TextureStreamer> texture_streamer_;
 
 		DllLoader render_loader_;
 		DllLoader audio_loader_;
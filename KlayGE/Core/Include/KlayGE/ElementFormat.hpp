@@ -671,6 +671,15 @@ namespace KlayGE
 	KLAYGE_CORE_API void ConvertToABGR32F(ElementFormat fmt, void const * input, uint32_t num_elems, Color* output);
 	KLAYGE_CORE_API void ConvertFromABGR32F(ElementFormat fmt, Color const * input, uint32_t num_elems, void* output);
 
+	typedef void (*FormatConverter)(void const * input, uint32_t num_elems, void* output);
+
+	// Returns a specialized converter between the two formats, or nullptr if the pair has to go through ABGR32F.
+	KLAYGE_CORE_API FormatConverter DirectFormatConverter(ElementFormat src_fmt, ElementFormat dst_fmt);
+	// Converts with a direct converter when there is one, otherwise through ABGR32F.
+	// The output can alias the input if the destination element is not larger than the source one.
+	KLAYGE_CORE_API void ConvertFormat(ElementFormat src_fmt, void const * input, uint32_t num_elems,
+		ElementFormat dst_fmt, void* output);
+
 
 	enum ElementAccessHint
 	{
@@ -20,8 +20,12 @@
 #include <KlayGE/RenderStateObject.hpp>
 #include <KlayGE/TexCompressionBC.hpp>
 
+#include <KFL/Thread.hpp>
+#include <KFL/Timer.hpp>
+
 #include <vector>
 #include <deque>
+#include <mutex>
 #include <unordered_map>
 
 #include <KlayGE/LZMACodec.hpp>
@@ -62,8 +66,23 @@ namespace KlayGE
 
 		static uint32_t const LEVEL_SHIFT = 28;
 
+	public:
+		struct CacheStatistics
+		{
+			uint64_t hits;
+			uint64_t misses;
+			uint64_t prefetches;
+			uint64_t prefetch_hits;
+			uint64_t uploads;
+			uint64_t prefetch_uploads;
+			// In seconds, from the first request of a tile to its upload. Prefetched tiles are not counted.
+			double total_latency;
+			double max_latency;
+		};
+
 	public:
 		JudaTexture(uint32_t num_tiles, uint32_t tile_size, ElementFormat format);
+		~JudaTexture();
 
 		uint32_t EncodeTileID(uint32_t level, uint32_t tile_x, uint32_t tile_y) const;
 		void DecodeTileID(uint32_t& level, uint32_t& tile_x, uint32_t& tile_y, uint32_t tile_id) const;
@@ -90,7 +109,30 @@ namespace KlayGE
 
 		void UpdateCache(std::vector<uint32_t> const & tile_ids);
 
+		// Decodes tiles on a background worker, and uploads at most UploadQuota() tiles per UpdateCache
+		void AsyncDecode(bool async);
+		bool AsyncDecode() const;
+		void UploadQuota(uint32_t num_tiles);
+		uint32_t UploadQuota() const;
+
+		CacheStatistics const & Statistics() const;
+		void ResetStatistics();
+
 	private:
+		struct PreparedTile
+		{
+			uint32_t tile_id;
+			uint32_t attr;
+			std::vector<std::vector<uint8_t>> mip_data;
+			std::vector<uint32_t> row_pitches;
+		};
+
+		void PrepareTiles(std::vector<PreparedTile>& tiles, std::vector<uint32_t> const & tile_ids);
+		void UploadTile(PreparedTile const & tile, uint64_t tick, bool prefetched);
+		void UploadReadyTiles(double now);
+		void QueuePrefetches(std::vector<uint32_t> const & tile_ids, uint32_t max_tiles, double now);
+		void DecodeWorker();
+
 		void DecodeATile(std::vector<uint8_t>* data, uint32_t shuff, uint32_t mipmaps);
 		uint32_t DecodeAAttr(uint32_t shuff);
 		uint8_t* RetriveATile(uint32_t data_index);
@@ -197,10 +239,40 @@ namespace KlayGE
 			uint32_t x, y, z;
 			uint32_t attr;
 			uint64_t tick;
+			bool prefetched;
 		};
 		std::unordered_map<uint32_t, TileInfo> tile_info_map_;
 		std::deque<std::pair<uint32_t, uint32_t>> tile_free_list_;
 		uint64_t tile_tick_;
+
+	private:
+		// Async decoding
+		bool async_decode_;
+		uint32_t upload_quota_;
+
+		// Guards input_file_, lzma_dec_ and decoded_block_cache_
+		std::mutex decode_mutex_;
+
+		// Guards the queues and the worker state
+		std::mutex queue_mutex_;
+		std::deque<uint32_t> demand_queue_;
+		std::deque<uint32_t> prefetch_queue_;
+		std::deque<PreparedTile> ready_tiles_;
+		bool worker_running_;
+		bool quit_;
+
+		struct PendingTile
+		{
+			double request_time;
+			bool prefetched;
+		};
+		std::unordered_map<uint32_t, PendingTile> pending_tiles_;
+
+		joiner<void> decode_worker_;
+		bool has_worker_;
+
+		Timer timer_;
+		CacheStatistics stats_;
 	};
 }
 
@@ -38,6 +38,19 @@
 
 namespace KlayGE
 {
+	// A range of the index buffer with a coarser version of a mesh, on the same vertices. The error is the RMS quadric
+	// error of the simplification in model space. It estimates how far the surface moved, it doesn't bound it.
+	struct MeshLod
+	{
+		uint32_t num_indices;
+		uint32_t start_index_location;
+		float error;
+	};
+
+	// The coarsest level whose error stays within max_pixel_error pixels, when a unit in model space covers
+	// pixels_per_unit pixels
+	KLAYGE_CORE_API uint32_t SelectMeshLod(std::vector<MeshLod> const & lods, float pixels_per_unit, float max_pixel_error);
+
 	class KLAYGE_CORE_API StaticMesh : public Renderable
 	{
 	public:
@@ -133,6 +146,29 @@ namespace KlayGE
 			return hw_res_ready_;
 		}
 
+		// Level 0 is the full detail mesh. Without levels, the index range set on the mesh is always drawn.
+		void Lods(std::vector<MeshLod> const & lods);
+		std::vector<MeshLod> const & Lods() const
+		{
+			return lods_;
+		}
+		void ActiveLod(uint32_t lod);
+		uint32_t ActiveLod() const
+		{
+			return active_lod_;
+		}
+		void MaxLodPixelError(float pixels)
+		{
+			max_lod_pixel_error_ = pixels;
+		}
+		float MaxLodPixelError() const
+		{
+			return max_lod_pixel_error_;
+		}
+
+		// Picks the level and requests the streamed textures
+		virtual void SelectDetail(FrameBuffer const & fb) override;
+
 	protected:
 		virtual void DoBuildMeshInfo();
 
@@ -141,6 +177,15 @@ namespace KlayGE
 
 		RenderLayoutPtr rl_;
 
+		std::vector<MeshLod> lods_;
+		uint32_t active_lod_;
+		float max_lod_pixel_error_;
+
+		// Handles in the texture streamer, -1 for textures not streamed. The streamed textures from the loader are kept,
+		// textures_ holds the ones with the resident levels.
+		std::array<uint32_t, RenderMaterial::TS_NumTextureSlots> stream_handles_;
+		std::array<TexturePtr, RenderMaterial::TS_NumTextureSlots> streamed_textures_;
+
 		AABBox pos_aabb_;
 		AABBox tc_aabb_;
 
@@ -442,6 +487,7 @@ namespace KlayGE
 		std::vector<AABBox>& pos_bbs, std::vector<AABBox>& tc_bbs,
 		std::vector<uint32_t>& mesh_num_vertices, std::vector<uint32_t>& mesh_base_vertices,
 		std::vector<uint32_t>& mesh_num_indices, std::vector<uint32_t>& mesh_base_indices,
+		std::vector<std::vector<MeshLod>>& mesh_lods,
 		std::vector<Joint>& joints, std::shared_ptr<AnimationActionsType>& actions,
 		std::shared_ptr<KeyFramesType>& kfs, uint32_t& num_frames, uint32_t& frame_rate,
 		std::vector<std::shared_ptr<AABBKeyFrames>>& frame_pos_bbs);
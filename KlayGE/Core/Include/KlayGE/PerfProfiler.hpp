@@ -66,6 +66,26 @@ namespace KlayGE
 		bool dirty_;
 	};
 
+	// Accumulates an amount, such as bytes uploaded. PerfProfiler records it and starts over every frame.
+	class KLAYGE_CORE_API PerfCounter : boost::noncopyable
+	{
+	public:
+		PerfCounter();
+
+		void Add(uint64_t value)
+		{
+			value_ += value;
+		}
+		uint64_t Value() const
+		{
+			return value_;
+		}
+		void Reset();
+
+	private:
+		uint64_t value_;
+	};
+
 	class KLAYGE_CORE_API PerfProfiler : boost::noncopyable
 	{
 	public:
@@ -78,6 +98,7 @@ namespace KlayGE
 		void Resume();
 
 		PerfRangePtr CreatePerfRange(int category, std::string const & name);
+		PerfCounterPtr CreatePerfCounter(int category, std::string const & name);
 		void CollectData();
 
 		void ExportToCSV(std::string const & file_name) const;
@@ -87,6 +108,8 @@ namespace KlayGE
 
 		std::vector<std::tuple<int, std::string, PerfRangePtr,
 			std::vector<std::tuple<uint32_t, double, double>>>> perf_ranges_;
+		std::vector<std::tuple<int, std::string, PerfCounterPtr,
+			std::vector<std::pair<uint32_t, uint64_t>>>> perf_counters_;
 		uint32_t frame_id_;
 	};
 }
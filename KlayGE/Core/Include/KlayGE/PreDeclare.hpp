@@ -42,6 +42,8 @@ namespace KlayGE
 	class ResLoader;
 	class PerfRange;
 	typedef std::shared_ptr<PerfRange> PerfRangePtr;
+	class PerfCounter;
+	typedef std::shared_ptr<PerfCounter> PerfCounterPtr;
 	class PerfProfiler;
 	typedef std::shared_ptr<PerfProfiler> PerfProfilerPtr;
 
@@ -118,6 +120,8 @@ namespace KlayGE
 	typedef std::shared_ptr<RenderStateObject> RenderStateObjectPtr;
 	class SamplerStateObject;
 	typedef std::shared_ptr<SamplerStateObject> SamplerStateObjectPtr;
+	class ShaderBinaryCache;
+	typedef std::shared_ptr<ShaderBinaryCache> ShaderBinaryCachePtr;
 	class ShaderObject;
 	typedef std::shared_ptr<ShaderObject> ShaderObjectPtr;
 	class Texture;
@@ -146,10 +150,16 @@ namespace KlayGE
 	typedef std::shared_ptr<TexCompressionETC2RGB8> TexCompressionETC2RGB8Ptr;
 	class TexCompressionETC2RGB8A1;
 	typedef std::shared_ptr<TexCompressionETC2RGB8A1> TexCompressionETC2RGB8A1Ptr;
+	class TexCompressionETC2RGBA8;
+	typedef std::shared_ptr<TexCompressionETC2RGBA8> TexCompressionETC2RGBA8Ptr;
 	class TexCompressionETC2R11;
 	typedef std::shared_ptr<TexCompressionETC2R11> TexCompressionETC2R11Ptr;
+	class TexCompressionETC2SignedR11;
+	typedef std::shared_ptr<TexCompressionETC2SignedR11> TexCompressionETC2SignedR11Ptr;
 	class TexCompressionETC2RG11;
 	typedef std::shared_ptr<TexCompressionETC2RG11> TexCompressionETC2RG11Ptr;
+	class TexCompressionETC2SignedRG11;
+	typedef std::shared_ptr<TexCompressionETC2SignedRG11> TexCompressionETC2SignedRG11Ptr;
 	class JudaTexture;
 	typedef std::shared_ptr<JudaTexture> JudaTexturePtr;
 	class FrameBuffer;
@@ -297,6 +307,10 @@ namespace KlayGE
 	typedef std::shared_ptr<SSRPostProcess> SSRPostProcessPtr;
 	class LightShaftPostProcess;
 	typedef std::shared_ptr<LightShaftPostProcess> LightShaftPostProcessPtr;
+	class TextureStreamingPolicy;
+	typedef std::shared_ptr<TextureStreamingPolicy> TextureStreamingPolicyPtr;
+	class TextureStreamer;
+	typedef std::shared_ptr<TextureStreamer> TextureStreamerPtr;
 	class TransientBuffer;
 	typedef std::shared_ptr<TransientBuffer> TransientBufferPtr;
 	class Fence;
@@ -92,6 +92,7 @@ namespace KlayGE
 		bool pack_to_rgba_required : 1;
 		bool draw_indirect_support : 1;
 		bool no_overwrite_support : 1;
+		bool partial_cbuffer_update_support : 1;
 		bool full_npot_texture_support : 1;
 		bool render_to_texture_array_support : 1;
 		bool load_from_buffer_support : 1;
@@ -58,6 +58,7 @@
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <unordered_map>
 
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/Texture.hpp>
@@ -66,6 +67,9 @@
 
 namespace KlayGE
 {
+	// Version of the .kfx format. A kfx of another version is built again from the .fxml.
+	uint32_t const KFX_VERSION = 0x0110;
+
 	enum RenderEffectDataType
 	{
 		REDT_bool = 0,
@@ -271,7 +275,7 @@ namespace KlayGE
 				if (val_in_cbuff != value)
 				{
 					val_in_cbuff = value;
-					data_.cbuff_desc.cbuff->Dirty(true);
+					data_.cbuff_desc.cbuff->Dirty(data_.cbuff_desc.offset, sizeof(T));
 				}
 			}
 			else
@@ -402,14 +406,27 @@ namespace KlayGE
 			if (this->in_cbuff_)
 			{
 				uint8_t* target = this->data_.cbuff_desc.cbuff->template VariableInBuff<uint8_t>(this->data_.cbuff_desc.offset);
+				uint32_t const stride = this->data_.cbuff_desc.stride;
 
+				// Only the span between the first and the last changed element is dirty
 				size_ = static_cast<uint32_t>(value.size());
-				for (size_t i = 0; i < value.size(); ++ i)
+				uint32_t first_changed = size_;
+				uint32_t last_changed = 0;
+				for (uint32_t i = 0; i < size_; ++ i)
 				{
-					memcpy(target + i * this->data_.cbuff_desc.stride, &value[i], sizeof(value[i]));
+					if (memcmp(target + i * stride, &value[i], sizeof(value[i])) != 0)
+					{
+						memcpy(target + i * stride, &value[i], sizeof(value[i]));
+						first_changed = std::min(first_changed, i);
+						last_changed = i;
+					}
 				}
 
-				this->data_.cbuff_desc.cbuff->Dirty(true);
+				if (first_changed < size_)
+				{
+					this->data_.cbuff_desc.cbuff->Dirty(this->data_.cbuff_desc.offset + first_changed * stride,
+						(last_changed - first_changed) * stride + sizeof(T));
+				}
 			}
 			else
 			{
@@ -604,10 +621,23 @@ namespace KlayGE
 		friend class RenderEffectTemplate;
 
 	public:
+		static uint32_t const INVALID_INDEX = static_cast<uint32_t>(-1);
+
+	public:
+		RenderEffect();
+
+		// PreLoad does the file reading and parsing of Load, without any GPU object. Load finishes it.
+		void PreLoad(std::string const & name);
 		void Load(std::string const & name);
 
 		RenderEffectPtr Clone();
 
+		// False until an effect from ASyncLoadRenderEffect finishes loading
+		bool HWResourceReady() const
+		{
+			return hw_res_ready_;
+		}
+
 		std::string const & ResName() const;
 		size_t ResNameHash() const;
 
@@ -617,6 +647,9 @@ namespace KlayGE
 		}
 		RenderEffectParameter* ParameterBySemantic(std::string const & semantic) const;
 		RenderEffectParameter* ParameterByName(std::string const & name) const;
+		// The index is the same in all clones of this effect, so it can be resolved once and bound with ParameterByIndex.
+		// Returns INVALID_INDEX if there is no such parameter.
+		uint32_t ParameterIndexByName(std::string const & name) const;
 		RenderEffectParameter* ParameterByIndex(uint32_t n) const
 		{
 			BOOST_ASSERT(n < this->NumParameters());
@@ -628,6 +661,7 @@ namespace KlayGE
 			return static_cast<uint32_t>(cbuffers_.size());
 		}
 		RenderEffectConstantBuffer* CBufferByName(std::string const & name) const;
+		uint32_t CBufferIndexByName(std::string const & name) const;
 		RenderEffectConstantBuffer* CBufferByIndex(uint32_t n) const
 		{
 			BOOST_ASSERT(n < this->NumCBuffers());
@@ -666,12 +700,24 @@ namespace KlayGE
 		std::vector<std::unique_ptr<RenderEffectParameter>> params_;
 		std::vector<std::unique_ptr<RenderEffectConstantBuffer>> cbuffers_;
 		std::vector<ShaderObjectPtr> shader_objs_;
+
+		bool hw_res_ready_;
 	};
 
 	class KLAYGE_CORE_API RenderEffectTemplate : boost::noncopyable
 	{
 	public:
+		RenderEffectTemplate();
+		~RenderEffectTemplate();
+
+		// Reads the .kfx and parses the .fxml with its includes. No GPU object is created, so it can run on any thread.
+		void PreLoad(std::string const & name);
+		// Runs PreLoad first if it hasn't, then creates the parameters, techniques and shaders
 		void Load(std::string const & name, RenderEffect& effect);
+		bool PreLoaded() const
+		{
+			return preloaded_;
+		}
 
 		bool StreamIn(ResIdentifierPtr const & source, RenderEffect& effect);
 #if KLAYGE_IS_DEV_PLATFORM
@@ -724,6 +770,10 @@ namespace KlayGE
 
 		std::string const & TypeName(uint32_t code) const;
 
+		uint32_t ParameterIndexByNameHash(size_t name_hash) const;
+		uint32_t ParameterIndexBySemanticHash(size_t semantic_hash) const;
+		uint32_t CBufferIndexByNameHash(size_t name_hash) const;
+
 #if KLAYGE_IS_DEV_PLATFORM
 		void GenHLSLShaderText(RenderEffect const & effect);
 		std::string const & HLSLShaderText() const
@@ -733,6 +783,8 @@ namespace KlayGE
 #endif
 
 	private:
+		void BuildIndices(RenderEffect const & effect);
+
 #if KLAYGE_IS_DEV_PLATFORM
 		void RecursiveIncludeNode(XMLNode const & root, std::vector<std::string>& include_names) const;
 		void InsertIncludeNodes(XMLDocument& target_doc, XMLNode& target_root,
@@ -746,6 +798,15 @@ namespace KlayGE
 		uint64_t timestamp_;
 #endif
 
+		// From PreLoad, released by Load
+		bool preloaded_;
+		std::string kfx_name_;
+		ResIdentifierPtr kfx_source_;
+#if KLAYGE_IS_DEV_PLATFORM
+		std::unique_ptr<XMLDocument> doc_;
+		XMLNodePtr root_;
+#endif
+
 		std::vector<std::unique_ptr<RenderTechnique>> techniques_;
 
 		std::shared_ptr<std::vector<std::pair<std::pair<std::string, std::string>, bool>>> macros_;
@@ -755,6 +816,11 @@ namespace KlayGE
 #endif
 
 		std::vector<ShaderDesc> shader_descs_;
+
+		// Hash to index of the first parameter or cbuffer with that hash, shared by all clones
+		std::unordered_map<size_t, uint32_t> param_name_indices_;
+		std::unordered_map<size_t, uint32_t> param_semantic_indices_;
+		std::unordered_map<size_t, uint32_t> cbuffer_name_indices_;
 	};
 
 	class KLAYGE_CORE_API RenderTechnique : boost::noncopyable
@@ -924,11 +990,6 @@ namespace KlayGE
 	class KLAYGE_CORE_API RenderEffectConstantBuffer : boost::noncopyable
 	{
 	public:
-		RenderEffectConstantBuffer()
-			: dirty_(true)
-		{
-		}
-
 #if KLAYGE_IS_DEV_PLATFORM
 		void Load(std::string const & name);
 #endif
@@ -985,15 +1046,21 @@ namespace KlayGE
 			return r2t.t;
 		}
 
-		void Dirty(bool dirty)
+		// Marks or clears the whole buffer, for code that writes through VariableInBuff directly
+		void Dirty(bool dirty);
+		// Marks [offset, offset + size) to be uploaded by the next Update. Nearby ranges are merged.
+		void Dirty(uint32_t offset, uint32_t size);
+		bool Dirty() const
 		{
-			dirty_ = dirty;
+			return !dirty_ranges_.empty();
 		}
-		bool Dirty() const
+		uint32_t DirtyBytes() const;
+		uint32_t NumDirtyRanges() const
 		{
-			return dirty_;
+			return static_cast<uint32_t>(dirty_ranges_.size());
 		}
 
+		// Uploads only the dirty ranges if the device supports partial constant buffer updates, the whole buffer if not
 		void Update();
 		GraphicsBufferPtr const & HWBuff() const
 		{
@@ -1007,7 +1074,8 @@ namespace KlayGE
 
 		GraphicsBufferPtr hw_buff_;
 		std::vector<uint8_t> buff_;
-		bool dirty_;
+		// Sorted, non-overlapping [begin, end) byte ranges
+		std::vector<std::pair<uint32_t, uint32_t>> dirty_ranges_;
 	};
 
 	class KLAYGE_CORE_API RenderEffectParameter : boost::noncopyable
@@ -160,6 +160,10 @@ namespace KlayGE
 
 		virtual void Render();
 
+		// Picks the detail to draw, such as the mesh level, from the main view. It's called once per frame before the
+		// passes, so all of them draw the same detail.
+		virtual void SelectDetail(FrameBuffer const & fb);
+
 		template <typename Iterator>
 		void AssignInstances(Iterator begin, Iterator end)
 		{
@@ -0,0 +1,91 @@
+/**
+ * @file ShaderBinaryCache.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _SHADERBINARYCACHE_HPP
+#define _SHADERBINARYCACHE_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+namespace KlayGE
+{
+	// A disk cache of shader build results that survives between runs, one file per entry. A key is any byte string that
+	// covers everything the result depends on, usually the shader code plus the compiler settings. The file name is a
+	// hash of the key, and the file keeps the whole key, the cache version and a checksum of the data. An entry that
+	// doesn't match on any of them is deleted and counts as a miss.
+	class KLAYGE_CORE_API ShaderBinaryCache : boost::noncopyable
+	{
+	public:
+		ShaderBinaryCache(std::string const & dir, uint32_t version);
+
+		bool Load(std::string const & key, std::vector<uint8_t>& data);
+		void Store(std::string const & key, std::vector<uint8_t> const & data);
+		// For entries that load fine but turn out to be unusable, such as a program binary the driver rejects
+		void Remove(std::string const & key);
+
+		std::string const & Directory() const
+		{
+			return dir_;
+		}
+		uint32_t Version() const
+		{
+			return version_;
+		}
+
+		uint32_t Hits() const
+		{
+			return hits_;
+		}
+		uint32_t Misses() const
+		{
+			return misses_;
+		}
+		void ResetStatistics();
+
+	private:
+		std::string EntryPath(std::string const & key) const;
+
+	private:
+		std::string dir_;
+		uint32_t version_;
+
+		std::atomic<uint32_t> hits_;
+		std::atomic<uint32_t> misses_;
+	};
+}
+
+#endif		// _SHADERBINARYCACHE_HPP
@@ -80,9 +80,18 @@ namespace KlayGE
 			return decoded_fmt_;
 		}
 
+		// Creates a codec of the same type. Each worker of EncodeMem/DecodeMem owns one, so the per-block
+		// scratch states inside the codecs are never shared between threads.
+		virtual std::unique_ptr<TexCompression> Clone() const = 0;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) = 0;
 		virtual void DecodeBlock(void* output, void const * input) = 0;
 
+		// Batched versions. The input/output are num_blocks tightly packed blocks. Codecs can override them
+		// to process several blocks at once.
+		virtual void EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method);
+		virtual void DecodeBlocks(void* output, void const * input, uint32_t num_blocks);
+
 		virtual void EncodeMem(uint32_t width, uint32_t height, 
 			void* output, uint32_t out_row_pitch, uint32_t out_slice_pitch,
 			void const * input, uint32_t in_row_pitch, uint32_t in_slice_pitch,
@@ -94,6 +103,15 @@ namespace KlayGE
 		virtual void EncodeTex(TexturePtr const & out_tex, TexturePtr const & in_tex, TexCompressionMethod method);
 		virtual void DecodeTex(TexturePtr const & out_tex, TexturePtr const & in_tex);
 
+	protected:
+		uint32_t NumWorkers(uint32_t width, uint32_t height) const;
+
+		void EncodeBlockRows(uint32_t width, uint32_t height, uint32_t start_block_row, uint32_t end_block_row,
+			void* output, uint32_t out_row_pitch, void const * input, uint32_t in_row_pitch,
+			TexCompressionMethod method);
+		void DecodeBlockRows(uint32_t width, uint32_t height, uint32_t start_block_row, uint32_t end_block_row,
+			void* output, uint32_t out_row_pitch, void const * input, uint32_t in_row_pitch);
+
 	protected:
 		uint32_t block_width_;
 		uint32_t block_height_;
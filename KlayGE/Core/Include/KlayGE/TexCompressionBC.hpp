@@ -80,9 +80,14 @@ namespace KlayGE
 	public:
 		TexCompressionBC1();
 
+		virtual std::unique_ptr<TexCompression> Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
 
+		virtual void EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method) override;
+		virtual void DecodeBlocks(void* output, void const * input, uint32_t num_blocks) override;
+
 		void EncodeBC1Internal(BC1Block& bc1, ARGBColor32 const * argb, bool alpha, TexCompressionMethod method) const;
 
 	private:
@@ -98,6 +103,8 @@ namespace KlayGE
 	public:
 		TexCompressionBC2();
 
+		virtual std::unique_ptr<TexCompression> Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
 
@@ -110,6 +117,8 @@ namespace KlayGE
 	public:
 		TexCompressionBC4();
 
+		virtual std::unique_ptr<TexCompression> Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
 	};
@@ -119,9 +128,14 @@ namespace KlayGE
 	public:
 		TexCompressionBC3();
 
+		virtual std::unique_ptr<TexCompression> Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
 
+		virtual void EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method) override;
+		virtual void DecodeBlocks(void* output, void const * input, uint32_t num_blocks) override;
+
 	private:
 		TexCompressionBC1 bc1_codec_;
 		TexCompressionBC4 bc4_codec_;
@@ -132,6 +146,8 @@ namespace KlayGE
 	public:
 		TexCompressionBC5();
 
+		virtual std::unique_ptr<TexCompression> Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
 
@@ -144,14 +160,18 @@ namespace KlayGE
 	public:
 		TexCompressionBC6U();
 
+		virtual std::unique_ptr<TexCompression> Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
 
+		void EncodeBC6Internal(void* output, void const * input, TexCompressionMethod method, bool signed_fmt);
 		void DecodeBC6Internal(void* output, void const * input, bool signed_fmt);
 
 	private:
-		int Unquantize(int comp, uint8_t bits_per_comp, bool signed_fmt);
-		int FinishUnquantize(int comp, bool signed_fmt);
+		int Quantize(int comp, uint8_t bits_per_comp, bool signed_fmt) const;
+		int Unquantize(int comp, uint8_t bits_per_comp, bool signed_fmt) const;
+		int FinishUnquantize(int comp, bool signed_fmt) const;
 
 	private:
 		static uint32_t const BC6_MAX_REGIONS = 2;
@@ -198,6 +218,20 @@ namespace KlayGE
 		static ModeDescriptor const mode_desc_[][82];
 		static ModeInfo const mode_info_[];
 		static int const mode_to_info_[];
+
+	private:
+		float RoughShapeError(int3 const * pixels, uint32_t shape, bool signed_fmt) const;
+		void OptimizeEndPoints(int3 const * pixels, uint32_t partitions, uint32_t shape, uint32_t region,
+			bool signed_fmt, std::pair<int3, int3>& end_pts) const;
+		bool EndPointsFit(ModeInfo const & info, std::pair<int3, int3> const * q_end_pts) const;
+		uint64_t AssignIndices(ModeInfo const & info, uint32_t shape, int3 const * pixels,
+			std::pair<int3, int3> const * q_end_pts, uint8_t* indices, bool signed_fmt) const;
+		bool SwapIndices(ModeInfo const & info, uint32_t shape, std::pair<int3, int3>* q_end_pts,
+			uint8_t* indices) const;
+		uint64_t TryMode(uint32_t mode_index, uint32_t shape, int3 const * pixels, int refine_iters,
+			std::pair<int3, int3>* q_end_pts, uint8_t* indices, bool signed_fmt) const;
+		void PackBC6Block(void* output, uint32_t mode_index, uint32_t shape,
+			std::pair<int3, int3> const * q_end_pts, uint8_t const * indices) const;
 	};
 
 	class KLAYGE_CORE_API TexCompressionBC6S : public TexCompression
@@ -205,6 +239,8 @@ namespace KlayGE
 	public:
 		TexCompressionBC6S();
 
+		virtual std::unique_ptr<TexCompression> Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
 
@@ -268,6 +304,8 @@ namespace KlayGE
 	public:
 		TexCompressionBC7();
 
+		virtual std::unique_ptr<TexCompression> Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
 
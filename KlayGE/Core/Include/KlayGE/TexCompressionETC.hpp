@@ -89,6 +89,25 @@ namespace KlayGE
 		ETC2HModeBlock etc2_h_mode;
 		ETC2PlanarModeBlock etc2_planar_mode;
 	};
+
+	struct EACBlock
+	{
+		uint8_t base;
+		uint8_t multiplier_table;
+		uint8_t indices[6];
+	};
+
+	struct ETC2RGBA8Block
+	{
+		EACBlock alpha;
+		ETC2Block etc2;
+	};
+
+	struct ETC2RG11Block
+	{
+		EACBlock red;
+		EACBlock green;
+	};
 #ifdef KLAYGE_HAS_STRUCT_PACK
 	#pragma pack(pop)
 #endif
@@ -129,10 +148,13 @@ namespace KlayGE
 	public:
 		TexCompressionETC1();
 
+		virtual std::unique_ptr<TexCompression> Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
 
-		uint64_t EncodeETC1BlockInternal(ETC1Block& output, ARGBColor32 const * argb, TexCompressionMethod method);
+		uint64_t EncodeETC1BlockInternal(ETC1Block& output, ARGBColor32 const * argb, TexCompressionMethod method,
+			bool allow_individual = true);
 		void DecodeETCIndividualModeInternal(ARGBColor32* argb, ETC1Block const & etc1) const;
 		void DecodeETCDifferentialModeInternal(ARGBColor32* argb, ETC1Block const & etc1, bool alpha) const;
 
@@ -206,9 +228,20 @@ namespace KlayGE
 	public:
 		TexCompressionETC2RGB8();
 
+		virtual std::unique_ptr<TexCompression> Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
 
+		uint64_t EncodeETC2BlockInternal(ETC2Block& output, ARGBColor32 const * argb, TexCompressionMethod method,
+			bool allow_individual);
+		uint64_t EncodeETCTModeInternal(ETC2TModeBlock& output, ARGBColor32 const * argb, uint16_t transparent_mask,
+			TexCompressionMethod method);
+		uint64_t EncodeETCHModeInternal(ETC2HModeBlock& output, ARGBColor32 const * argb, uint16_t transparent_mask,
+			TexCompressionMethod method);
+		uint64_t EncodeETCPlanarModeInternal(ETC2PlanarModeBlock& output, ARGBColor32 const * argb,
+			TexCompressionMethod method);
+
 		void DecodeETCTModeInternal(ARGBColor32* argb, ETC2TModeBlock const & etc2, bool alpha);
 		void DecodeETCHModeInternal(ARGBColor32* argb, ETC2HModeBlock const & etc2, bool alpha);
 		void DecodeETCPlanarModeInternal(ARGBColor32* argb, ETC2PlanarModeBlock const & etc2);
@@ -222,13 +255,99 @@ namespace KlayGE
 	public:
 		TexCompressionETC2RGB8A1();
 
+		virtual std::unique_ptr<TexCompression> Clone() const override;
+
 		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
 		virtual void DecodeBlock(void* output, void const * input) override;
 
+	private:
+		uint64_t EncodeETCDifferentialModeAlphaInternal(ETC1Block& output, ARGBColor32 const * argb,
+			uint16_t transparent_mask) const;
+
 	private:
 		TexCompressionETC1Ptr etc1_codec_;
 		TexCompressionETC2RGB8Ptr etc2_rgb8_codec_;
 	};
+
+	class KLAYGE_CORE_API TexCompressionETC2R11 : public TexCompression
+	{
+	public:
+		TexCompressionETC2R11();
+
+		virtual std::unique_ptr<TexCompression> Clone() const override;
+
+		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
+		virtual void DecodeBlock(void* output, void const * input) override;
+
+		// 16-bit texels, unsigned or signed
+		void EncodeR11Internal(void* output, void const * input, TexCompressionMethod method, bool signed_fmt) const;
+		void DecodeR11Internal(void* output, void const * input, bool signed_fmt) const;
+
+		// The values are 8-bit for alpha channel of RGBA8, 11-bit for R11 and RG11. Signed 11-bit values are in [-1023, 1023].
+		uint64_t EncodeEACBlockInternal(EACBlock& output, int const * values, bool eleven_bits, bool signed_fmt,
+			TexCompressionMethod method) const;
+		void DecodeEACBlockInternal(int* values, EACBlock const & eac, bool eleven_bits, bool signed_fmt) const;
+	};
+
+	class KLAYGE_CORE_API TexCompressionETC2SignedR11 : public TexCompression
+	{
+	public:
+		TexCompressionETC2SignedR11();
+
+		virtual std::unique_ptr<TexCompression> Clone() const override;
+
+		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
+		virtual void DecodeBlock(void* output, void const * input) override;
+
+	private:
+		TexCompressionETC2R11 r11_codec_;
+	};
+
+	class KLAYGE_CORE_API TexCompressionETC2RG11 : public TexCompression
+	{
+	public:
+		TexCompressionETC2RG11();
+
+		virtual std::unique_ptr<TexCompression> Clone() const override;
+
+		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
+		virtual void DecodeBlock(void* output, void const * input) override;
+
+		void EncodeRG11Internal(void* output, void const * input, TexCompressionMethod method, bool signed_fmt) const;
+		void DecodeRG11Internal(void* output, void const * input, bool signed_fmt) const;
+
+	private:
+		TexCompressionETC2R11 r11_codec_;
+	};
+
+	class KLAYGE_CORE_API TexCompressionETC2SignedRG11 : public TexCompression
+	{
+	public:
+		TexCompressionETC2SignedRG11();
+
+		virtual std::unique_ptr<TexCompression> Clone() const override;
+
+		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
+		virtual void DecodeBlock(void* output, void const * input) override;
+
+	private:
+		TexCompressionETC2RG11 rg11_codec_;
+	};
+
+	class KLAYGE_CORE_API TexCompressionETC2RGBA8 : public TexCompression
+	{
+	public:
+		TexCompressionETC2RGBA8();
+
+		virtual std::unique_ptr<TexCompression> Clone() const override;
+
+		virtual void EncodeBlock(void* output, void const * input, TexCompressionMethod method) override;
+		virtual void DecodeBlock(void* output, void const * input) override;
+
+	private:
+		TexCompressionETC2RGB8Ptr etc2_rgb8_codec_;
+		TexCompressionETC2R11Ptr eac_codec_;
+	};
 }
 
 #endif		// _TEXCOMPRESSIONETC_HPP
@@ -0,0 +1,215 @@
+/**
+ * @file TextureStreaming.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _TEXTURESTREAMING_HPP
+#define _TEXTURESTREAMING_HPP
+
+#pragma once
+
+#include <KlayGE/PreDeclare.hpp>
+#include <KlayGE/ElementFormat.hpp>
+#include <KlayGE/Texture.hpp>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace KlayGE
+{
+	// Decides which mips of streamed textures are resident. The small tail mips of a texture are resident as soon as it is
+	// added. Finer mips are made resident in the order of how much they are needed, within a global memory budget. Mips
+	// that don't fit any more are evicted, least needed first. It only keeps the books, the caller uploads and releases the
+	// mips whose residency changed after Update().
+	class KLAYGE_CORE_API TextureStreamingPolicy : boost::noncopyable
+	{
+	public:
+		// Levels with both sides not larger than tail_size are always resident
+		TextureStreamingPolicy(uint64_t budget, uint32_t tail_size);
+
+		void Budget(uint64_t budget);
+		uint64_t Budget() const
+		{
+			return budget_;
+		}
+
+		// array_size counts 2D slices, so it's 6 times the number of cube maps
+		uint32_t AddTexture(uint32_t width, uint32_t height, uint32_t depth, uint32_t num_mipmaps, uint32_t array_size,
+			ElementFormat format);
+		void RemoveTexture(uint32_t handle);
+
+		// The finest level the texture is sampled at, and how important it is compared to other textures. A texture
+		// with 0 priority only keeps its tail.
+		void Request(uint32_t handle, uint32_t wanted_level, float priority);
+		// Same as Request, with the level and priority estimated from the texture's size on screen in pixels
+		void RequestScreenSize(uint32_t handle, float screen_size);
+
+		// Evictions happen immediately. Mips are loaded coarse to fine in priority order, up to max_upload_bytes per
+		// update. At least one mip is loaded if any is pending, so large mips are never starved.
+		void Update(uint64_t max_upload_bytes = static_cast<uint64_t>(-1));
+
+		// The finest resident level. All coarser levels are resident too.
+		uint32_t ResidentLevel(uint32_t handle) const;
+		uint32_t TailLevel(uint32_t handle) const;
+		uint64_t ResidentBytes() const;
+
+		// The tail level a texture of this size would get
+		uint32_t TailLevel(uint32_t width, uint32_t height, uint32_t num_mipmaps) const;
+
+		static uint32_t LevelFromScreenSize(uint32_t width, uint32_t height, uint32_t num_mipmaps, float screen_size);
+
+	private:
+		struct StreamedTexture
+		{
+			bool valid;
+			uint32_t width;
+			uint32_t height;
+			std::vector<uint64_t> level_bytes;
+			uint32_t tail_level;
+			uint32_t wanted_level;
+			float priority;
+			uint32_t resident_level;
+		};
+
+		struct Candidate
+		{
+			float need;
+			uint32_t handle;
+			uint32_t level;
+		};
+
+	private:
+		uint64_t budget_;
+		uint32_t tail_size_;
+
+		std::vector<StreamedTexture> textures_;
+		std::vector<uint32_t> free_handles_;
+
+		std::vector<Candidate> candidates_;
+		std::vector<uint32_t> target_levels_;
+		std::vector<bool> blocked_;
+	};
+
+	// Drives a TextureStreamingPolicy with the textures from ASyncLoadTexture. A texture is created with only its tail,
+	// the whole mip chain stays in system memory once loaded. Meshes claim the textures they draw and request the size
+	// they are drawn at. Textures nobody claims are streamed at their full size. Update() replaces the textures whose
+	// resident level changed with new ones holding the resident levels.
+	class KLAYGE_CORE_API TextureStreamer : boost::noncopyable
+	{
+	public:
+		typedef std::function<TexturePtr(Texture::TextureType type, uint32_t width, uint32_t height, uint32_t num_mipmaps,
+			uint32_t array_size, ElementFormat format, uint32_t access_hint, ArrayRef<ElementInitData> init_data)>
+			TextureCreator;
+
+		TextureStreamer(uint64_t budget, uint32_t tail_size);
+		// The creator makes the textures of the resident levels, by default with the render factory
+		TextureStreamer(uint64_t budget, uint32_t tail_size, TextureCreator const & creator);
+
+		// Only immutable 2D and cube textures with mipmaps are streamed
+		static bool Streamable(Texture::TextureType type, uint32_t num_mipmaps, uint32_t access_hint);
+
+		// The loader creates the texture it returns with the levels from this one, before any data is loaded
+		uint32_t FirstLevel(uint32_t width, uint32_t height, uint32_t num_mipmaps) const;
+		// tex is the texture from the loader, with the full width, height and num_mipmaps given here. The streamer only
+		// refers to it weakly, the texture is removed once nobody else refers to it.
+		uint32_t AddTexture(TexturePtr const & tex, Texture::TextureType type, uint32_t width, uint32_t height,
+			uint32_t num_mipmaps, uint32_t array_size, ElementFormat format, uint32_t access_hint);
+		// Called when the whole mip chain is loaded. Creates the hardware resource of the loader's texture from the
+		// levels starting at FirstLevel().
+		void TextureLoaded(uint32_t handle, std::vector<ElementInitData> init_data, std::vector<uint8_t> data_block);
+		void RemoveTexture(uint32_t handle);
+
+		// Returns the handle of a texture from the loader, or -1 if it's not streamed
+		uint32_t Handle(TexturePtr const & tex) const;
+		// Same as Handle, and the caller requests the screen size of the texture from now on
+		uint32_t ClaimRequests(TexturePtr const & tex);
+
+		// The size of the texture on screen in pixels. The largest request of an update wins, and a texture keeps it
+		// for a while after it stops being requested.
+		void RequestScreenSize(uint32_t handle, float screen_size);
+
+		// Runs the policy, and replaces the textures whose resident level changed. Textures from the loader nobody
+		// refers to any more are removed.
+		void Update(uint64_t max_upload_bytes = static_cast<uint64_t>(-1));
+
+		TexturePtr CurrentTexture(uint32_t handle) const;
+		uint32_t CurrentLevel(uint32_t handle) const;
+
+		TextureStreamingPolicy const & Policy() const
+		{
+			return policy_;
+		}
+		void Budget(uint64_t budget);
+
+		// The init data of the levels from first_level of each slice
+		static std::vector<ElementInitData> LevelsFrom(std::vector<ElementInitData> const & init_data,
+			uint32_t num_mipmaps, uint32_t first_level);
+
+	private:
+		struct Entry
+		{
+			bool valid;
+			Texture::TextureType type;
+			uint32_t width;
+			uint32_t height;
+			uint32_t num_mipmaps;
+			uint32_t array_size;
+			ElementFormat format;
+			uint32_t access_hint;
+
+			// The texture from the loader holds the tail. current_tex is only set when other levels are resident.
+			std::weak_ptr<Texture> loaded_tex;
+			bool tracked;
+			TexturePtr current_tex;
+			uint32_t current_level;
+
+			bool data_ready;
+			std::vector<ElementInitData> init_data;
+			std::vector<uint8_t> data_block;
+
+			bool claimed;
+			float frame_screen_size;
+			float screen_size;
+			uint32_t idle_updates;
+		};
+
+	private:
+		TextureStreamingPolicy policy_;
+		TextureCreator creator_;
+
+		std::vector<Entry> entries_;
+		std::map<std::weak_ptr<Texture>, uint32_t, std::owner_less<std::weak_ptr<Texture>>> handles_;
+
+		mutable std::mutex mutex_;
+	};
+}
+
+#endif		// _TEXTURESTREAMING_HPP
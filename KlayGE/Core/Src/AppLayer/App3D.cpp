@@ -40,6 +40,7 @@
 #include <KlayGE/UI.hpp>
 #include <KlayGE/SceneManager.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
+#include <KlayGE/TextureStreaming.hpp>
 
 #include <boost/assert.hpp>
 
@@ -78,6 +79,12 @@ using namespace Microsoft::WRL::Wrappers;
 using namespace concurrency;
 #endif
 
+namespace
+{
+	// Spreads the texture uploads of streaming over frames
+	uint64_t const TEXTURE_STREAMING_UPLOAD_PER_FRAME = 8 * 1024 * 1024;
+}
+
 namespace KlayGE
 {
 #if defined KLAYGE_PLATFORM_WINDOWS_STORE
@@ -789,6 +796,12 @@ namespace KlayGE
 			this->DoUpdateOverlay();
 
 			ResLoader::Instance().Update();
+
+			TextureStreamer* streamer = Context::Instance().TextureStreamerInstance();
+			if (streamer)
+			{
+				streamer->Update(TEXTURE_STREAMING_UPLOAD_PER_FRAME);
+			}
 		}
 
 		return this->DoUpdate(pass);
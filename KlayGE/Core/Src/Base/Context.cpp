@@ -33,6 +33,7 @@
 #include <KlayGE/ResLoader.hpp>
 #include <KFL/XMLDom.hpp>
 #include <KlayGE/DeferredRenderingLayer.hpp>
+#include <KlayGE/TextureStreaming.hpp>
 #include <KFL/Thread.hpp>
 #include <KlayGE/PerfProfiler.hpp>
 #include <KlayGE/UI.hpp>
@@ -73,6 +74,9 @@
 namespace
 {
 	std::mutex singleton_mutex;
+
+	// Levels not larger than this are loaded with the texture
+	uint32_t const TEXTURE_STREAMING_TAIL_SIZE = 64;
 }
 
 namespace KlayGE
@@ -90,6 +94,8 @@ namespace KlayGE
 	Context::Context()
 		: app_(nullptr)
 	{
+		cfg_.texture_streaming_budget = 0;
+
 #ifdef KLAYGE_PLATFORM_ANDROID
 		state_ = get_app();
 #endif
@@ -116,6 +122,7 @@ namespace KlayGE
 		UIManager::Destroy();
 
 		deferred_rendering_layer_.reset();
+		texture_streamer_.reset();
 		show_factory_.reset();
 		render_factory_.reset();
 		audio_factory_.reset();
@@ -259,6 +266,7 @@ namespace KlayGE
 		std::vector<std::pair<std::string, std::string>> graphics_options;
 		bool perf_profiler = false;
 		bool location_sensor = false;
+		uint32_t texture_streaming_budget = 0;
 
 		std::string rf_name = "D3D11";
 		std::string af_name = "OpenAL";
@@ -331,6 +339,12 @@ namespace KlayGE
 				location_sensor = location_sensor_node->Attrib("enabled")->ValueInt() ? true : false;
 			}
 
+			XMLNodePtr texture_streaming_node = context_node->FirstNode("texture_streaming");
+			if (texture_streaming_node)
+			{
+				texture_streaming_budget = texture_streaming_node->Attrib("budget")->ValueUInt();
+			}
+
 			XMLNodePtr frame_node = graphics_node->FirstNode("frame");
 			XMLAttributePtr attr;
 			attr = frame_node->Attrib("width");
@@ -705,6 +719,7 @@ namespace KlayGE
 		cfg_.deferred_rendering = false;
 		cfg_.perf_profiler = perf_profiler;
 		cfg_.location_sensor = location_sensor;
+		cfg_.texture_streaming_budget = texture_streaming_budget;
 	}
 
 	void Context::SaveCfg(std::string const & cfg_file)
@@ -750,6 +765,10 @@ namespace KlayGE
 			XMLNodePtr location_sensor_node = cfg_doc.AllocNode(XNT_Element, "location_sensor");
 			location_sensor_node->AppendAttrib(cfg_doc.AllocAttribInt("enabled", cfg_.location_sensor));
 			context_node->AppendNode(location_sensor_node);
+
+			XMLNodePtr texture_streaming_node = cfg_doc.AllocNode(XNT_Element, "texture_streaming");
+			texture_streaming_node->AppendAttrib(cfg_doc.AllocAttribUInt("budget", cfg_.texture_streaming_budget));
+			context_node->AppendNode(texture_streaming_node);
 		}
 		root->AppendNode(context_node);
 
@@ -945,6 +964,24 @@ namespace KlayGE
 				deferred_rendering_layer_.reset();
 			}
 		}
+
+		if (cfg_.texture_streaming_budget > 0)
+		{
+			uint64_t const budget = static_cast<uint64_t>(cfg_.texture_streaming_budget) * 1024 * 1024;
+			if (texture_streamer_)
+			{
+				texture_streamer_->Budget(budget);
+			}
+			else
+			{
+				texture_streamer_ = MakeUniquePtr<TextureStreamer>(budget, TEXTURE_STREAMING_TAIL_SIZE);
+			}
+		}
+		else if (texture_streamer_)
+		{
+			// Textures already streamed still need the streamer, they get all their levels back
+			texture_streamer_->Budget(static_cast<uint64_t>(-1));
+		}
 	}
 
 	ContextCfg const & Context::Config() const
@@ -107,6 +107,17 @@ namespace KlayGE
 	}
 
 
+	PerfCounter::PerfCounter()
+		: value_(0)
+	{
+	}
+
+	void PerfCounter::Reset()
+	{
+		value_ = 0;
+	}
+
+
 	PerfProfiler::PerfProfiler()
 		: frame_id_(0)
 	{
@@ -147,6 +158,14 @@ namespace KlayGE
 		return range;
 	}
 
+	PerfCounterPtr PerfProfiler::CreatePerfCounter(int category, std::string const & name)
+	{
+		PerfCounterPtr counter = MakeSharedPtr<PerfCounter>();
+		typedef std::remove_reference<decltype(std::get<3>(perf_counters_[0]))>::type PerfDataType;
+		perf_counters_.push_back(std::make_tuple(category, name, counter, PerfDataType()));
+		return counter;
+	}
+
 	void PerfProfiler::CollectData()
 	{
 		if (Context::Instance().Config().perf_profiler)
@@ -165,6 +184,12 @@ namespace KlayGE
 				}
 			}
 
+			for (auto& counter : perf_counters_)
+			{
+				std::get<3>(counter).emplace_back(frame_id_, std::get<2>(counter)->Value());
+				std::get<2>(counter)->Reset();
+			}
+
 			++ frame_id_;
 		}
 	}
@@ -192,6 +217,22 @@ namespace KlayGE
 			}
 
 			ofs << std::endl;
+
+			if (!perf_counters_.empty())
+			{
+				ofs << "Frame" << ',' << "Category" << ',' << "Name" << ',' << "Value" << std::endl;
+
+				for (auto const & counter : perf_counters_)
+				{
+					for (auto const & data : std::get<3>(counter))
+					{
+						ofs << data.first << ',' << std::get<0>(counter) << ',' << std::get<1>(counter) << ','
+							<< data.second << std::endl;
+					}
+				}
+
+				ofs << std::endl;
+			}
 		}
 	}
 }
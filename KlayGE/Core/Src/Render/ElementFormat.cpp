@@ -37,10 +37,524 @@
 #include <KFL/Math.hpp>
 #include <KFL/Half.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+#include <emmintrin.h>
+#endif
+#if defined(KLAYGE_SSSE3_SUPPORT)
+#include <tmmintrin.h>
+#endif
+
+namespace
+{
+	using namespace KlayGE;
+
+	// Direct converters. They are bit-exact with going through ConvertToABGR32F/ConvertFromABGR32F for finite values.
+	// The output can alias the input, as long as the destination element is not larger than the source one.
+
+	uint8_t UNorm8FromFloat(float v)
+	{
+		return static_cast<uint8_t>(MathLib::clamp(static_cast<int>(v * 255.0f + 0.5f), 0, 255));
+	}
+
+	std::array<uint8_t, 256> const & SRGBToLinear8Lut()
+	{
+		static std::array<uint8_t, 256> const lut = []
+			{
+				std::array<uint8_t, 256> ret;
+				for (uint32_t i = 0; i < ret.size(); ++ i)
+				{
+					ret[i] = UNorm8FromFloat(MathLib::srgb_to_linear(i / 255.0f));
+				}
+				return ret;
+			}();
+		return lut;
+	}
+
+	std::array<uint8_t, 256> const & LinearToSRGB8Lut()
+	{
+		static std::array<uint8_t, 256> const lut = []
+			{
+				std::array<uint8_t, 256> ret;
+				for (uint32_t i = 0; i < ret.size(); ++ i)
+				{
+					ret[i] = static_cast<uint8_t>(MathLib::clamp(
+						static_cast<int>(MathLib::linear_to_srgb(i / 255.0f) * 255.0f + 0.5f), 0, 255));
+				}
+				return ret;
+			}();
+		return lut;
+	}
+
+	std::array<float, 256> const & SRGBToLinear32FLut()
+	{
+		static std::array<float, 256> const lut = []
+			{
+				std::array<float, 256> ret;
+				for (uint32_t i = 0; i < ret.size(); ++ i)
+				{
+					ret[i] = MathLib::srgb_to_linear(i / 255.0f);
+				}
+				return ret;
+			}();
+		return lut;
+	}
+
+	std::array<int8_t, 256> const & SNorm8Lut()
+	{
+		// The float path maps -128 to -127, and rounds the negative values toward zero
+		static std::array<int8_t, 256> const lut = []
+			{
+				std::array<int8_t, 256> ret;
+				for (int i = -128; i < 128; ++ i)
+				{
+					ret[static_cast<uint8_t>(i)] = static_cast<int8_t>(
+						MathLib::clamp(static_cast<int>(i / 127.0f * 127.0f + 0.5f), -127, 127));
+				}
+				return ret;
+			}();
+		return lut;
+	}
+
+#if defined(KLAYGE_SSE2_SUPPORT)
+	__m128i SwapRB8(__m128i v)
+	{
+#if defined(KLAYGE_SSSE3_SUPPORT)
+		return _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15));
+#else
+		__m128i const rb = _mm_and_si128(v, _mm_set1_epi32(0x00FF00FF));
+		return _mm_or_si128(_mm_and_si128(v, _mm_set1_epi32(static_cast<int>(0xFF00FF00))),
+			_mm_or_si128(_mm_slli_epi32(rb, 16), _mm_srli_epi32(rb, 16)));
+#endif
+	}
+
+	// Packs 16 int32 into 16 saturated uint8
+	__m128i PackUNorm8(__m128i v0, __m128i v1, __m128i v2, __m128i v3)
+	{
+		return _mm_packus_epi16(_mm_packs_epi32(v0, v1), _mm_packs_epi32(v2, v3));
+	}
+
+	__m128i FloatToUNorm8(__m128 v)
+	{
+		return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+	}
+
+	// 4 halves in the low 16 bits of each lane to 4 floats
+	__m128 HalfToFloat(__m128i h)
+	{
+		__m128i const no_sign = _mm_and_si128(h, _mm_set1_epi32(0x7FFF));
+		__m128i const sign = _mm_slli_epi32(_mm_xor_si128(h, no_sign), 16);
+		// Denormals are handled by the multiplication, inf and nan get their exponent from was_inf_nan
+		__m128 const scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(no_sign, 13)),
+			_mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+		__m128i const was_inf_nan = _mm_cmpgt_epi32(no_sign, _mm_set1_epi32(0x7BFF));
+		__m128i const inf_nan_exp = _mm_and_si128(was_inf_nan, _mm_set1_epi32(255 << 23));
+		return _mm_or_ps(scaled, _mm_castsi128_ps(_mm_or_si128(sign, inf_nan_exp)));
+	}
+
+	__m128i Select(__m128i mask, __m128i a, __m128i b)
+	{
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	}
+
+	// 4 floats to 4 halves in the low 16 bits of each lane, with the same rounding as half(float)
+	__m128i FloatToHalf(__m128 f)
+	{
+		__m128i const bits = _mm_castps_si128(f);
+		__m128i const abs_bits = _mm_and_si128(bits, _mm_set1_epi32(0x7FFFFFFF));
+		__m128i const sign = _mm_and_si128(_mm_srli_epi32(bits, 16), _mm_set1_epi32(0x8000));
+		__m128i const exp = _mm_srli_epi32(abs_bits, 23);
+
+		__m128i const normal = _mm_add_epi32(_mm_srli_epi32(_mm_sub_epi32(abs_bits, _mm_set1_epi32(112 << 23)), 13),
+			_mm_and_si128(_mm_srli_epi32(abs_bits, 12), _mm_set1_epi32(1)));
+		__m128i const denormal = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_castsi128_ps(abs_bits),
+			_mm_set1_ps(16777216.0f)), _mm_set1_ps(0.5f)));
+		__m128i const inf_nan = _mm_or_si128(_mm_set1_epi32(0x7C00),
+			_mm_srli_epi32(_mm_and_si128(abs_bits, _mm_set1_epi32(0x007FFFFF)), 13));
+
+		__m128i ret = Select(_mm_cmplt_epi32(exp, _mm_set1_epi32(113)), denormal, normal);
+		ret = Select(_mm_cmpgt_epi32(exp, _mm_set1_epi32(142)), _mm_set1_epi32(0x7C00), ret);
+		ret = Select(_mm_cmpeq_epi32(exp, _mm_set1_epi32(255)), inf_nan, ret);
+		return _mm_or_si128(ret, _mm_andnot_si128(_mm_cmpeq_epi32(ret, _mm_setzero_si128()), sign));
+	}
+
+	// 8 halves, sign extended in 32-bit lanes, to 8 packed halves
+	__m128i PackHalf(__m128i h0, __m128i h1)
+	{
+		return _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(h0, 16), 16), _mm_srai_epi32(_mm_slli_epi32(h1, 16), 16));
+	}
+#endif
+
+	// EF_ARGB8 <-> EF_ABGR8, and their sRGB versions
+	void SwapRB8Converter(void const * input, uint32_t num_elems, void* output)
+	{
+		uint8_t const * src = static_cast<uint8_t const *>(input);
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		uint32_t i = 0;
+#if defined(KLAYGE_SSE2_SUPPORT)
+		for (; i + 4 <= num_elems; i += 4)
+		{
+			__m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i * 4));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 4), SwapRB8(v));
+		}
+#endif
+		for (; i < num_elems; ++ i)
+		{
+			uint8_t const c0 = src[i * 4 + 0];
+			uint8_t const c2 = src[i * 4 + 2];
+			dst[i * 4 + 0] = c2;
+			dst[i * 4 + 1] = src[i * 4 + 1];
+			dst[i * 4 + 2] = c0;
+			dst[i * 4 + 3] = src[i * 4 + 3];
+		}
+	}
+
+	// EF_R8/EF_GR8 to EF_ABGR8 (R_OFFSET == 0) or EF_ARGB8 (R_OFFSET == 2)
+	template <uint32_t NUM_CHANNELS, uint32_t R_OFFSET>
+	void ExpandUNorm8Converter(void const * input, uint32_t num_elems, void* output)
+	{
+		static_assert((1 == NUM_CHANNELS) || (2 == NUM_CHANNELS), "Only R8 and GR8 are supported.");
+
+		uint8_t const * src = static_cast<uint8_t const *>(input);
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		uint32_t i = 0;
+#if defined(KLAYGE_SSE2_SUPPORT) && defined(KLAYGE_LITTLE_ENDIAN)
+		__m128i const zero = _mm_setzero_si128();
+		__m128i const alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+		for (; i + 16 / NUM_CHANNELS <= num_elems; i += 16 / NUM_CHANNELS)
+		{
+			__m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i * NUM_CHANNELS));
+			__m128i texels[4];
+			if (1 == NUM_CHANNELS)
+			{
+				__m128i const lo = _mm_unpacklo_epi8(v, zero);
+				__m128i const hi = _mm_unpackhi_epi8(v, zero);
+				texels[0] = _mm_unpacklo_epi16(lo, zero);
+				texels[1] = _mm_unpackhi_epi16(lo, zero);
+				texels[2] = _mm_unpacklo_epi16(hi, zero);
+				texels[3] = _mm_unpackhi_epi16(hi, zero);
+			}
+			else
+			{
+				texels[0] = _mm_unpacklo_epi16(v, zero);
+				texels[1] = _mm_unpackhi_epi16(v, zero);
+			}
+			for (uint32_t j = 0; j < 4 / NUM_CHANNELS; ++ j)
+			{
+				__m128i t = texels[j];
+				if (R_OFFSET != 0)
+				{
+					__m128i const r_mask = _mm_set1_epi32(0xFF);
+					t = _mm_or_si128(_mm_andnot_si128(r_mask, t), _mm_slli_epi32(_mm_and_si128(t, r_mask), R_OFFSET * 8));
+				}
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + (i + j * 4) * 4), _mm_or_si128(t, alpha));
+			}
+		}
+#endif
+		for (; i < num_elems; ++ i)
+		{
+			uint8_t texel[4] = { 0, 0, 0, 0xFF };
+			texel[R_OFFSET] = src[i * NUM_CHANNELS + 0];
+			if (2 == NUM_CHANNELS)
+			{
+				texel[1] = src[i * NUM_CHANNELS + 1];
+			}
+			std::memcpy(&dst[i * 4], texel, sizeof(texel));
+		}
+	}
+
+	// EF_SIGNED_R8/EF_SIGNED_GR8 to EF_SIGNED_ABGR8
+	template <uint32_t NUM_CHANNELS>
+	void ExpandSNorm8Converter(void const * input, uint32_t num_elems, void* output)
+	{
+		auto const & lut = SNorm8Lut();
+
+		uint8_t const * src = static_cast<uint8_t const *>(input);
+		int8_t* dst = static_cast<int8_t*>(output);
+		for (uint32_t i = 0; i < num_elems; ++ i)
+		{
+			int8_t texel[4] = { 0, 0, 0, 127 };
+			for (uint32_t c = 0; c < NUM_CHANNELS; ++ c)
+			{
+				texel[c] = lut[src[i * NUM_CHANNELS + c]];
+			}
+			std::memcpy(&dst[i * 4], texel, sizeof(texel));
+		}
+	}
+
+	// sRGB <-> linear between 8-bit 4 channel formats, optionally swapping R and B
+	template <bool TO_LINEAR, bool SWAP_RB>
+	void SRGB8Converter(void const * input, uint32_t num_elems, void* output)
+	{
+		auto const & lut = TO_LINEAR ? SRGBToLinear8Lut() : LinearToSRGB8Lut();
+
+		uint8_t const * src = static_cast<uint8_t const *>(input);
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		for (uint32_t i = 0; i < num_elems; ++ i, src += 4, dst += 4)
+		{
+			uint8_t const c0 = lut[src[0]];
+			uint8_t const c1 = lut[src[1]];
+			uint8_t const c2 = lut[src[2]];
+			uint8_t const c3 = lut[src[3]];
+			dst[0] = SWAP_RB ? c2 : c0;
+			dst[1] = c1;
+			dst[2] = SWAP_RB ? c0 : c2;
+			dst[3] = c3;
+		}
+	}
+
+	// EF_ARGB8_SRGB/EF_ABGR8_SRGB to EF_ABGR32F
+	template <bool SWAP_RB>
+	void SRGB8ToFloatConverter(void const * input, uint32_t num_elems, void* output)
+	{
+		auto const & lut = SRGBToLinear32FLut();
+
+		uint8_t const * src = static_cast<uint8_t const *>(input);
+		float* dst = static_cast<float*>(output);
+		for (uint32_t i = 0; i < num_elems; ++ i, src += 4, dst += 4)
+		{
+			dst[0] = lut[src[SWAP_RB ? 2 : 0]];
+			dst[1] = lut[src[1]];
+			dst[2] = lut[src[SWAP_RB ? 0 : 2]];
+			dst[3] = lut[src[3]];
+		}
+	}
+
+	// UNORM8 to float with the same channel count, optionally swapping R and B of 4 channel formats
+	template <uint32_t NUM_CHANNELS, bool SWAP_RB>
+	void UNorm8ToFloatConverter(void const * input, uint32_t num_elems, void* output)
+	{
+		uint8_t const * src = static_cast<uint8_t const *>(input);
+		float* dst = static_cast<float*>(output);
+		uint32_t const num_values = num_elems * NUM_CHANNELS;
+		uint32_t i = 0;
+#if defined(KLAYGE_SSE2_SUPPORT)
+		__m128i const zero = _mm_setzero_si128();
+		__m128 const scale = _mm_set1_ps(255.0f);
+		for (; i + 16 <= num_values; i += 16)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+			if (SWAP_RB)
+			{
+				v = SwapRB8(v);
+			}
+			__m128i const lo = _mm_unpacklo_epi8(v, zero);
+			__m128i const hi = _mm_unpackhi_epi8(v, zero);
+			_mm_storeu_ps(dst + i + 0, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+			_mm_storeu_ps(dst + i + 4, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+			_mm_storeu_ps(dst + i + 8, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+			_mm_storeu_ps(dst + i + 12, _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+		}
+#endif
+		for (; i < num_values; ++ i)
+		{
+			uint32_t src_index = i;
+			if (SWAP_RB && ((i & 1) == 0))
+			{
+				src_index ^= 2;
+			}
+			dst[i] = src[src_index] / 255.0f;
+		}
+	}
+
+	// Float to UNORM8 with the same channel count, optionally swapping R and B of 4 channel formats
+	template <uint32_t NUM_CHANNELS, bool SWAP_RB>
+	void FloatToUNorm8Converter(void const * input, uint32_t num_elems, void* output)
+	{
+		float const * src = static_cast<float const *>(input);
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		uint32_t const num_values = num_elems * NUM_CHANNELS;
+		uint32_t i = 0;
+#if defined(KLAYGE_SSE2_SUPPORT)
+		for (; i + 16 <= num_values; i += 16)
+		{
+			__m128i v = PackUNorm8(FloatToUNorm8(_mm_loadu_ps(src + i + 0)), FloatToUNorm8(_mm_loadu_ps(src + i + 4)),
+				FloatToUNorm8(_mm_loadu_ps(src + i + 8)), FloatToUNorm8(_mm_loadu_ps(src + i + 12)));
+			if (SWAP_RB)
+			{
+				v = SwapRB8(v);
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+		}
+#endif
+		for (; i < num_values; ++ i)
+		{
+			uint32_t src_index = i;
+			if (SWAP_RB && ((i & 1) == 0))
+			{
+				src_index ^= 2;
+			}
+			dst[i] = UNorm8FromFloat(src[src_index]);
+		}
+	}
+
+	// Half to float with the same channel count
+	void HalfToFloatConverter(void const * input, uint32_t num_values, void* output)
+	{
+		half const * src = static_cast<half const *>(input);
+		float* dst = static_cast<float*>(output);
+		uint32_t i = 0;
+#if defined(KLAYGE_SSE2_SUPPORT)
+		__m128i const zero = _mm_setzero_si128();
+		for (; i + 8 <= num_values; i += 8)
+		{
+			__m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+			_mm_storeu_ps(dst + i + 0, HalfToFloat(_mm_unpacklo_epi16(v, zero)));
+			_mm_storeu_ps(dst + i + 4, HalfToFloat(_mm_unpackhi_epi16(v, zero)));
+		}
+#endif
+		for (; i < num_values; ++ i)
+		{
+			dst[i] = src[i];
+		}
+	}
+
+	// Float to half with the same channel count
+	void FloatToHalfConverter(void const * input, uint32_t num_values, void* output)
+	{
+		float const * src = static_cast<float const *>(input);
+		half* dst = static_cast<half*>(output);
+		uint32_t i = 0;
+#if defined(KLAYGE_SSE2_SUPPORT)
+		for (; i + 8 <= num_values; i += 8)
+		{
+			__m128i const v = PackHalf(FloatToHalf(_mm_loadu_ps(src + i + 0)), FloatToHalf(_mm_loadu_ps(src + i + 4)));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), v);
+		}
+#endif
+		for (; i < num_values; ++ i)
+		{
+			dst[i] = half(src[i]);
+		}
+	}
+
+	template <uint32_t NUM_CHANNELS>
+	void HalfToFloatNConverter(void const * input, uint32_t num_elems, void* output)
+	{
+		HalfToFloatConverter(input, num_elems * NUM_CHANNELS, output);
+	}
+
+	template <uint32_t NUM_CHANNELS>
+	void FloatToHalfNConverter(void const * input, uint32_t num_elems, void* output)
+	{
+		FloatToHalfConverter(input, num_elems * NUM_CHANNELS, output);
+	}
+
+	// EF_R16 to EF_R16F
+	void R16ToR16FConverter(void const * input, uint32_t num_elems, void* output)
+	{
+		uint16_t const * src = static_cast<uint16_t const *>(input);
+		half* dst = static_cast<half*>(output);
+		uint32_t i = 0;
+#if defined(KLAYGE_SSE2_SUPPORT)
+		__m128i const zero = _mm_setzero_si128();
+		__m128 const scale = _mm_set1_ps(65535.0f);
+		for (; i + 8 <= num_elems; i += 8)
+		{
+			__m128i const v = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i));
+			__m128 const f0 = _mm_div_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(v, zero)), scale);
+			__m128 const f1 = _mm_div_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(v, zero)), scale);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), PackHalf(FloatToHalf(f0), FloatToHalf(f1)));
+		}
+#endif
+		for (; i < num_elems; ++ i)
+		{
+			dst[i] = half(src[i] / 65535.0f);
+		}
+	}
+
+	// EF_R16F to EF_R8
+	void R16FToR8Converter(void const * input, uint32_t num_elems, void* output)
+	{
+		half const * src = static_cast<half const *>(input);
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		uint32_t i = 0;
+#if defined(KLAYGE_SSE2_SUPPORT)
+		__m128i const zero = _mm_setzero_si128();
+		for (; i + 16 <= num_elems; i += 16)
+		{
+			__m128i const v0 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i + 0));
+			__m128i const v1 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + i + 8));
+			__m128i const r = PackUNorm8(FloatToUNorm8(HalfToFloat(_mm_unpacklo_epi16(v0, zero))),
+				FloatToUNorm8(HalfToFloat(_mm_unpackhi_epi16(v0, zero))),
+				FloatToUNorm8(HalfToFloat(_mm_unpacklo_epi16(v1, zero))),
+				FloatToUNorm8(HalfToFloat(_mm_unpackhi_epi16(v1, zero))));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), r);
+		}
+#endif
+		for (; i < num_elems; ++ i)
+		{
+			dst[i] = UNorm8FromFloat(src[i]);
+		}
+	}
+
+	struct DirectConverterEntry
+	{
+		ElementFormat src_fmt;
+		ElementFormat dst_fmt;
+		FormatConverter converter;
+	};
+
+	DirectConverterEntry const direct_converters[] =
+	{
+		{ EF_ARGB8, EF_ABGR8, SwapRB8Converter },
+		{ EF_ABGR8, EF_ARGB8, SwapRB8Converter },
+		{ EF_ARGB8_SRGB, EF_ABGR8_SRGB, SwapRB8Converter },
+		{ EF_ABGR8_SRGB, EF_ARGB8_SRGB, SwapRB8Converter },
+
+		{ EF_R8, EF_ABGR8, ExpandUNorm8Converter<1, 0> },
+		{ EF_R8, EF_ARGB8, ExpandUNorm8Converter<1, 2> },
+		{ EF_GR8, EF_ABGR8, ExpandUNorm8Converter<2, 0> },
+		{ EF_GR8, EF_ARGB8, ExpandUNorm8Converter<2, 2> },
+		{ EF_SIGNED_R8, EF_SIGNED_ABGR8, ExpandSNorm8Converter<1> },
+		{ EF_SIGNED_GR8, EF_SIGNED_ABGR8, ExpandSNorm8Converter<2> },
+
+		{ EF_ARGB8_SRGB, EF_ARGB8, SRGB8Converter<true, false> },
+		{ EF_ABGR8_SRGB, EF_ABGR8, SRGB8Converter<true, false> },
+		{ EF_ARGB8_SRGB, EF_ABGR8, SRGB8Converter<true, true> },
+		{ EF_ABGR8_SRGB, EF_ARGB8, SRGB8Converter<true, true> },
+		{ EF_ARGB8, EF_ARGB8_SRGB, SRGB8Converter<false, false> },
+		{ EF_ABGR8, EF_ABGR8_SRGB, SRGB8Converter<false, false> },
+		{ EF_ARGB8, EF_ABGR8_SRGB, SRGB8Converter<false, true> },
+		{ EF_ABGR8, EF_ARGB8_SRGB, SRGB8Converter<false, true> },
+		{ EF_ARGB8_SRGB, EF_ABGR32F, SRGB8ToFloatConverter<true> },
+		{ EF_ABGR8_SRGB, EF_ABGR32F, SRGB8ToFloatConverter<false> },
+
+		{ EF_R8, EF_R32F, UNorm8ToFloatConverter<1, false> },
+		{ EF_GR8, EF_GR32F, UNorm8ToFloatConverter<2, false> },
+		{ EF_ABGR8, EF_ABGR32F, UNorm8ToFloatConverter<4, false> },
+		{ EF_ARGB8, EF_ABGR32F, UNorm8ToFloatConverter<4, true> },
+		{ EF_R32F, EF_R8, FloatToUNorm8Converter<1, false> },
+		{ EF_GR32F, EF_GR8, FloatToUNorm8Converter<2, false> },
+		{ EF_ABGR32F, EF_ABGR8, FloatToUNorm8Converter<4, false> },
+		{ EF_ABGR32F, EF_ARGB8, FloatToUNorm8Converter<4, true> },
+
+		{ EF_R16F, EF_R32F, HalfToFloatNConverter<1> },
+		{ EF_GR16F, EF_GR32F, HalfToFloatNConverter<2> },
+		{ EF_ABGR16F, EF_ABGR32F, HalfToFloatNConverter<4> },
+		{ EF_R32F, EF_R16F, FloatToHalfNConverter<1> },
+		{ EF_GR32F, EF_GR16F, FloatToHalfNConverter<2> },
+		{ EF_ABGR32F, EF_ABGR16F, FloatToHalfNConverter<4> },
+
+		{ EF_R16, EF_R16F, R16ToR16FConverter },
+		{ EF_R16F, EF_R8, R16FToR8Converter },
+	};
+}
+
 namespace KlayGE
 {
 	void ConvertToABGR32F(ElementFormat fmt, void const * input, uint32_t num_elems, Color* output)
 	{
+		FormatConverter const converter = DirectFormatConverter(fmt, EF_ABGR32F);
+		if (converter)
+		{
+			converter(input, num_elems, output);
+			return;
+		}
+
 		uint8_t const * p = static_cast<uint8_t const *>(input);
 		uint32_t const elem_size = NumFormatBytes(fmt);
 
@@ -83,6 +597,14 @@ namespace KlayGE
 			}
 			break;
 
+		case EF_SIGNED_R8:
+			for (uint32_t i = 0; i < num_elems; ++ i, p += elem_size, ++ output)
+			{
+				int8_t const * s = reinterpret_cast<int8_t const *>(p);
+				*output = Color(s[0] / 127.0f, 0, 0, 1);
+			}
+			break;
+
 		case EF_GR8:
 			for (uint32_t i = 0; i < num_elems; ++ i, p += elem_size, ++ output)
 			{
@@ -746,6 +1268,13 @@ namespace KlayGE
 
 	void ConvertFromABGR32F(ElementFormat fmt, Color const * input, uint32_t num_elems, void* output)
 	{
+		FormatConverter const converter = DirectFormatConverter(EF_ABGR32F, fmt);
+		if (converter)
+		{
+			converter(input, num_elems, output);
+			return;
+		}
+
 		uint8_t* p = static_cast<uint8_t*>(output);
 		uint32_t const elem_size = NumFormatBytes(fmt);
 
@@ -800,6 +1329,13 @@ namespace KlayGE
 			}
 			break;
 
+		case EF_SIGNED_R8:
+			for (uint32_t i = 0; i < num_elems; ++ i, ++ input, p += elem_size)
+			{
+				p[0] = static_cast<int8_t>(MathLib::clamp(static_cast<int>(input->r() * 127.0f + 0.5f), -127, 127));
+			}
+			break;
+
 		case EF_GR8:
 			for (uint32_t i = 0; i < num_elems; ++ i, ++ input, p += elem_size)
 			{
@@ -1534,4 +2070,48 @@ namespace KlayGE
 			KFL_UNREACHABLE("Not supported element format");
 		}
 	}
+
+	FormatConverter DirectFormatConverter(ElementFormat src_fmt, ElementFormat dst_fmt)
+	{
+		for (auto const & entry : direct_converters)
+		{
+			if ((entry.src_fmt == src_fmt) && (entry.dst_fmt == dst_fmt))
+			{
+				return entry.converter;
+			}
+		}
+		return nullptr;
+	}
+
+	void ConvertFormat(ElementFormat src_fmt, void const * input, uint32_t num_elems,
+		ElementFormat dst_fmt, void* output)
+	{
+		if (src_fmt == dst_fmt)
+		{
+			std::memmove(output, input, num_elems * NumFormatBytes(src_fmt));
+			return;
+		}
+
+		FormatConverter const converter = DirectFormatConverter(src_fmt, dst_fmt);
+		if (converter)
+		{
+			converter(input, num_elems, output);
+		}
+		else
+		{
+			// Goes through ABGR32F in small batches, to keep the intermediate colors in cache
+			uint8_t const * src = static_cast<uint8_t const *>(input);
+			uint8_t* dst = static_cast<uint8_t*>(output);
+			uint32_t const src_elem_size = NumFormatBytes(src_fmt);
+			uint32_t const dst_elem_size = NumFormatBytes(dst_fmt);
+
+			std::array<Color, 256> colors;
+			for (uint32_t i = 0; i < num_elems; i += static_cast<uint32_t>(colors.size()))
+			{
+				uint32_t const n = std::min(num_elems - i, static_cast<uint32_t>(colors.size()));
+				ConvertToABGR32F(src_fmt, src + i * src_elem_size, n, &colors[0]);
+				ConvertFromABGR32F(dst_fmt, &colors[0], n, dst + i * dst_elem_size);
+			}
+		}
+	}
 }
@@ -17,6 +17,7 @@
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/RenderEffect.hpp>
 
+#include <algorithm>
 #include <fstream>
 #include <cstring>
 #include <boost/assert.hpp>
@@ -29,6 +30,7 @@ namespace
 	using namespace KlayGE;
 
 	uint32_t const JUDA_TEX_VERSION = 2;
+	uint32_t const DECODE_BATCH_SIZE = 4;
 
 	void u8_copy_1(uint8_t* output, uint8_t const * rhs)
 	{
@@ -117,7 +119,9 @@ namespace KlayGE
 		: root_(MakeSharedPtr<quadtree_node>()),
 			num_tiles_(num_tiles), tile_size_(tile_size), format_(format),
 			texel_size_(NumFormatBytes(format)),
-			decode_tick_(0), tile_tick_(0)
+			decode_tick_(0), tile_tick_(0),
+			async_decode_(false), upload_quota_(8), worker_running_(false), quit_(false), has_worker_(false),
+			stats_()
 	{
 		BOOST_ASSERT(num_tiles_ <= MAX_NUM_TILES);
 		BOOST_ASSERT(tile_size_ <= MAX_TILE_SIZE);
@@ -178,6 +182,18 @@ namespace KlayGE
 		}
 	}
 
+	JudaTexture::~JudaTexture()
+	{
+		{
+			std::lock_guard<std::mutex> lock(queue_mutex_);
+			quit_ = true;
+		}
+		if (has_worker_)
+		{
+			decode_worker_();
+		}
+	}
+
 	uint32_t JudaTexture::EncodeTileID(uint32_t level, uint32_t tile_x, uint32_t tile_y) const
 	{
 		BOOST_ASSERT(level <= MAX_TREE_LEVEL);
@@ -1247,27 +1263,72 @@ namespace KlayGE
 				static_cast<float>(cache_tile_border_size_));
 	}
 
+	void JudaTexture::AsyncDecode(bool async)
+	{
+		if (async_decode_ && !async)
+		{
+			// Drains the background worker. Tiles still in flight are requested again by the synchronous path.
+			{
+				std::lock_guard<std::mutex> lock(queue_mutex_);
+				quit_ = true;
+			}
+			if (has_worker_)
+			{
+				decode_worker_();
+				has_worker_ = false;
+			}
+
+			quit_ = false;
+			worker_running_ = false;
+			demand_queue_.clear();
+			prefetch_queue_.clear();
+			ready_tiles_.clear();
+			pending_tiles_.clear();
+		}
+
+		async_decode_ = async;
+	}
+
+	bool JudaTexture::AsyncDecode() const
+	{
+		return async_decode_;
+	}
+
+	void JudaTexture::UploadQuota(uint32_t num_tiles)
+	{
+		upload_quota_ = std::max(num_tiles, 1U);
+	}
+
+	uint32_t JudaTexture::UploadQuota() const
+	{
+		return upload_quota_;
+	}
+
+	JudaTexture::CacheStatistics const & JudaTexture::Statistics() const
+	{
+		return stats_;
+	}
+
+	void JudaTexture::ResetStatistics()
+	{
+		stats_ = CacheStatistics();
+	}
+
 	void JudaTexture::UpdateCache(std::vector<uint32_t> const & tile_ids)
 	{
 		BOOST_ASSERT(tex_cache_ || !tex_cache_array_.empty());
 
 		++ tile_tick_;
 
-		uint32_t const tex_width = tex_cache_ ? tex_cache_->Width(0) : tex_cache_array_[0]->Width(0);
-		uint32_t const tex_height = tex_cache_ ? tex_cache_->Height(0) : tex_cache_array_[0]->Height(0);
-		uint32_t const tex_layer = tex_cache_ ? tex_cache_->ArraySize() : static_cast<uint32_t>(tex_cache_array_.size());
-		uint32_t const tile_with_border_size = cache_tile_size_ + cache_tile_border_size_ * 2;
+		double const now = timer_.current_time();
 
-		uint32_t const num_cache_tiles_a_row = tex_width / tile_with_border_size;
-		uint32_t const num_cache_tiles_a_layer = num_cache_tiles_a_row * tex_height / tile_with_border_size;
-		uint32_t const num_cache_total_tiles = num_cache_tiles_a_layer * tex_layer;
+		if (async_decode_)
+		{
+			this->UploadReadyTiles(now);
+		}
 
-		std::unordered_map<uint32_t, uint32_t> neighbor_id_map;
-		std::vector<uint32_t> all_neighbor_ids;
-		std::vector<uint32_t> neighbor_ids;
-		std::vector<uint32_t> tile_attrs;
-		std::vector<bool> in_same_image;
 		auto& tim = tile_info_map_;
+		std::vector<uint32_t> missing_ids;
 		for (size_t i = 0; i < tile_ids.size(); ++ i)
 		{
 			auto tmiter = tim.find(tile_ids[i]);
@@ -1276,195 +1337,393 @@ namespace KlayGE
 				// Exists in cache
 
 				tmiter->second.tick = tile_tick_;
+
+				++ stats_.hits;
+				if (tmiter->second.prefetched)
+				{
+					++ stats_.prefetch_hits;
+					tmiter->second.prefetched = false;
+				}
 			}
 			else
 			{
-				uint32_t level, tile_x, tile_y;
-				this->DecodeTileID(level, tile_x, tile_y, tile_ids[i]);
-
-				std::array<uint32_t, 9> new_tile_id_with_neighbors;
-				new_tile_id_with_neighbors.fill(0xFFFFFFFF);
-				new_tile_id_with_neighbors[0] = tile_ids[i];
+				++ stats_.misses;
+				missing_ids.push_back(tile_ids[i]);
+			}
+		}
 
-				std::array<bool, 9> new_in_same_image;
-				new_in_same_image.fill(false);
-				new_in_same_image[0] = true;
+		if (!async_decode_)
+		{
+			if (!missing_ids.empty())
+			{
+				std::vector<PreparedTile> tiles;
+				{
+					std::lock_guard<std::mutex> lock(decode_mutex_);
+					this->PrepareTiles(tiles, missing_ids);
+				}
+				for (auto const & tile : tiles)
+				{
+					this->UploadTile(tile, tile_tick_, false);
+				}
 
-				uint32_t attr = this->DecodeAAttr(this->Pos2Shuff(level, tile_x, tile_y));
-				tile_attrs.push_back(attr);
-				if (attr != 0xFFFFFFFF)
+				double const latency = timer_.current_time() - now;
+				stats_.total_latency += latency * tiles.size();
+				stats_.max_latency = std::max(stats_.max_latency, latency);
+			}
+		}
+		else
+		{
+			std::vector<uint32_t> demand_ids;
+			std::vector<uint32_t> promoted_ids;
+			for (auto id : missing_ids)
+			{
+				auto piter = pending_tiles_.find(id);
+				if (piter == pending_tiles_.end())
+				{
+					pending_tiles_.emplace(id, PendingTile{ now, false });
+					demand_ids.push_back(id);
+				}
+				else if (piter->second.prefetched)
 				{
-					std::array<int32_t, 9> new_tile_id_x;
-					std::array<int32_t, 9> new_tile_id_y;
+					// A predicted tile is needed now
+					piter->second.request_time = now;
+					piter->second.prefetched = false;
+					promoted_ids.push_back(id);
+				}
+			}
 
-					int32_t left = tile_x - 1;
-					int32_t right = tile_x + 1;
-					int32_t up = tile_y - 1;
-					int32_t down = tile_y + 1;
+			bool start_worker = false;
+			{
+				std::lock_guard<std::mutex> lock(queue_mutex_);
 
-					ImageEntry const & entry = image_entries_[attr];
-					if (TAM_Wrap == (entry.addr_u_v & 0xF))
-					{
-						left = entry.x + (left - entry.x + entry.w) % entry.w;
-						right = entry.x + (right - entry.x + entry.w) % entry.w;
-					}
-					if (TAM_Wrap == ((entry.addr_u_v >> 4) & 0xF))
+				for (auto id : promoted_ids)
+				{
+					auto iter = std::find(prefetch_queue_.begin(), prefetch_queue_.end(), id);
+					if (iter != prefetch_queue_.end())
 					{
-						up = entry.y + (up - entry.y + entry.h) % entry.h;
-						down = entry.y + (down - entry.y + entry.h) % entry.h;
+						prefetch_queue_.erase(iter);
+						demand_queue_.push_back(id);
 					}
+				}
+				demand_queue_.insert(demand_queue_.end(), demand_ids.begin(), demand_ids.end());
 
-					new_tile_id_x[1] = left;
-					new_tile_id_y[1] = up;
-					new_tile_id_x[2] = tile_x;
-					new_tile_id_y[2] = up;
-					new_tile_id_x[3] = right;
-					new_tile_id_y[3] = up;
-
-					new_tile_id_x[4] = left;
-					new_tile_id_y[4] = tile_y;
-					new_tile_id_x[5] = right;
-					new_tile_id_y[5] = tile_y;
-
-					new_tile_id_x[6] = left;
-					new_tile_id_y[6] = down;
-					new_tile_id_x[7] = tile_x;
-					new_tile_id_y[7] = down;
-					new_tile_id_x[8] = right;
-					new_tile_id_y[8] = down;
-
-					for (int j = 1; j < 9; ++ j)
-					{
-						if ((new_tile_id_x[j] >= 0) && (new_tile_id_y[j] >= 0)
-							&& (new_tile_id_x[j] < static_cast<int32_t>(num_tiles_) - 1)
-							&& (new_tile_id_y[j] < static_cast<int32_t>(num_tiles_) - 1))
-						{
-							new_tile_id_with_neighbors[j] = this->EncodeTileID(level, new_tile_id_x[j], new_tile_id_y[j]);
-							if (new_tile_id_with_neighbors[j] != 0xFFFFFFFF)
-							{
-								if (attr == this->DecodeAAttr(this->Pos2Shuff(level, new_tile_id_x[j], new_tile_id_y[j])))
-								{
-									new_in_same_image[j] = true;
-								}
-							}
-						}
-						else
-						{
-							new_tile_id_with_neighbors[j] = 0xFFFFFFFF;
-						}
-					}
+				// Predictions from the previous frames are stale by now
+				for (auto id : prefetch_queue_)
+				{
+					pending_tiles_.erase(id);
 				}
+				prefetch_queue_.clear();
 
-				for (size_t j = 0; j < new_tile_id_with_neighbors.size(); ++ j)
+				if (demand_queue_.size() < upload_quota_)
 				{
-					if (new_tile_id_with_neighbors[j] != 0xFFFFFFFF)
-					{
-						if (neighbor_id_map.find(new_tile_id_with_neighbors[j]) == neighbor_id_map.end())
-						{
-							neighbor_id_map.emplace(new_tile_id_with_neighbors[j], static_cast<uint32_t>(neighbor_ids.size()));
-							neighbor_ids.push_back(new_tile_id_with_neighbors[j]);
-						}
-					}
-					all_neighbor_ids.push_back(new_tile_id_with_neighbors[j]);
-					in_same_image.push_back(new_in_same_image[j]);
+					this->QueuePrefetches(tile_ids, upload_quota_ - static_cast<uint32_t>(demand_queue_.size()), now);
+				}
+
+				if (!worker_running_ && !(demand_queue_.empty() && prefetch_queue_.empty()))
+				{
+					worker_running_ = true;
+					start_worker = true;
+				}
+			}
+
+			if (start_worker)
+			{
+				if (has_worker_)
+				{
+					// The previous worker has already run out of work, this only recycles it
+					decode_worker_();
 				}
+				decode_worker_ = Context::Instance().ThreadPool()(
+					[this]
+					{
+						this->DecodeWorker();
+					});
+				has_worker_ = true;
 			}
 		}
+	}
 
-		uint32_t mipmaps = tex_cache_->NumMipMaps();
-		std::vector<std::vector<uint8_t>> neighbor_data;
-		this->DecodeTiles(neighbor_data, neighbor_ids, mipmaps);
+	void JudaTexture::UploadReadyTiles(double now)
+	{
+		std::vector<PreparedTile> tiles;
+		{
+			std::lock_guard<std::mutex> lock(queue_mutex_);
 
-		TileInfo tile_info;
-		tile_info.tick = tile_tick_;
-		for (size_t i = 0; i < all_neighbor_ids.size(); i += 9)
+			uint32_t num_uploads = 0;
+			while (!ready_tiles_.empty() && (num_uploads < upload_quota_))
+			{
+				if (!ready_tiles_.front().mip_data.empty())
+				{
+					++ num_uploads;
+				}
+				tiles.push_back(std::move(ready_tiles_.front()));
+				ready_tiles_.pop_front();
+			}
+		}
+
+		for (auto const & tile : tiles)
 		{
-			tile_info.attr = tile_attrs[i / 9];
-			uint8_t border_clr[4];
-			TexAddressingMode addr_u, addr_v;
-			if (tile_info.attr != 0xFFFFFFFF)
+			auto piter = pending_tiles_.find(tile.tile_id);
+			if (piter == pending_tiles_.end())
 			{
-				ImageEntry const & entry = image_entries_[tile_info.attr];
-				addr_u = static_cast<TexAddressingMode>(entry.addr_u_v & 0xF);
-				addr_v = static_cast<TexAddressingMode>((entry.addr_u_v >> 4) & 0xF);
-				texel_op_.from_float4(border_clr, &entry.border_clr.r());
+				continue;
 			}
-			else
+
+			PendingTile const pending = piter->second;
+			pending_tiles_.erase(piter);
+
+			if (!tile.mip_data.empty() && (tile_info_map_.find(tile.tile_id) == tile_info_map_.end()))
 			{
-				addr_u = TAM_Clamp;
-				addr_v = TAM_Clamp;
-				border_clr[0] = border_clr[1] = border_clr[2] = border_clr[3] = 0;
+				// Predicted tiles are the first to go if nobody asks for them
+				this->UploadTile(tile, pending.prefetched ? tile_tick_ - 1 : tile_tick_, pending.prefetched);
+
+				if (!pending.prefetched)
+				{
+					double const latency = now - pending.request_time;
+					stats_.total_latency += latency;
+					stats_.max_latency = std::max(stats_.max_latency, latency);
+				}
 			}
+		}
+	}
 
-			if (tile_info_map_.size() < num_cache_total_tiles)
+	void JudaTexture::QueuePrefetches(std::vector<uint32_t> const & tile_ids, uint32_t max_tiles, double now)
+	{
+		uint32_t num_prefetches = 0;
+		auto try_prefetch = [this, &num_prefetches, now](uint32_t level, int32_t x, int32_t y)
+		{
+			uint32_t const level_tiles = (num_tiles_ + (1UL << (tree_levels_ - 1 - level)) - 1) >> (tree_levels_ - 1 - level);
+			if ((x >= 0) && (y >= 0) && (x < static_cast<int32_t>(level_tiles)) && (y < static_cast<int32_t>(level_tiles)))
 			{
-				// Still has space in cache
+				uint32_t const id = this->EncodeTileID(level, x, y);
+				if ((tile_info_map_.find(id) == tile_info_map_.end()) && (pending_tiles_.find(id) == pending_tiles_.end()))
+				{
+					pending_tiles_.emplace(id, PendingTile{ now, true });
+					prefetch_queue_.push_back(id);
+					++ num_prefetches;
+					++ stats_.prefetches;
+				}
+			}
+		};
 
-				uint32_t const s = tile_free_list_.front().first;
-				tile_info.z = s / num_cache_tiles_a_layer;
-				tile_info.y = (s - tile_info.z * num_cache_tiles_a_layer) / num_cache_tiles_a_row;
-				tile_info.x = s - tile_info.z * num_cache_tiles_a_layer - tile_info.y * num_cache_tiles_a_row;
+		// The next coarser tiles are the fallback when zooming out, and the ring of neighbors is where panning goes
+		for (size_t i = 0; (i < tile_ids.size()) && (num_prefetches < max_tiles); ++ i)
+		{
+			uint32_t level, tile_x, tile_y;
+			this->DecodeTileID(level, tile_x, tile_y, tile_ids[i]);
+			if (level > 0)
+			{
+				try_prefetch(level - 1, tile_x / 2, tile_y / 2);
+			}
+		}
+		for (size_t i = 0; (i < tile_ids.size()) && (num_prefetches < max_tiles); ++ i)
+		{
+			uint32_t level, tile_x, tile_y;
+			this->DecodeTileID(level, tile_x, tile_y, tile_ids[i]);
+			for (int32_t dy = -1; (dy <= 1) && (num_prefetches < max_tiles); ++ dy)
+			{
+				for (int32_t dx = -1; (dx <= 1) && (num_prefetches < max_tiles); ++ dx)
+				{
+					if ((dx != 0) || (dy != 0))
+					{
+						try_prefetch(level, static_cast<int32_t>(tile_x) + dx, static_cast<int32_t>(tile_y) + dy);
+					}
+				}
+			}
+		}
+	}
 
-				++ tile_free_list_.front().first;
-				if (tile_free_list_.front().first == tile_free_list_.front().second)
+	void JudaTexture::DecodeWorker()
+	{
+		for (;;)
+		{
+			std::vector<uint32_t> ids;
+			bool prefetch;
+			{
+				std::lock_guard<std::mutex> lock(queue_mutex_);
+				if (quit_ || (demand_queue_.empty() && prefetch_queue_.empty()))
 				{
-					tile_free_list_.pop_front();
+					worker_running_ = false;
+					break;
 				}
+
+				prefetch = demand_queue_.empty();
+				std::deque<uint32_t>& queue = prefetch ? prefetch_queue_ : demand_queue_;
+				size_t const n = std::min<size_t>(queue.size(), DECODE_BATCH_SIZE);
+				ids.assign(queue.begin(), queue.begin() + n);
+				queue.erase(queue.begin(), queue.begin() + n);
 			}
-			else
+
+			std::vector<PreparedTile> tiles;
 			{
-				// Find tiles that are not used for the longest time
+				std::lock_guard<std::mutex> lock(decode_mutex_);
 
-				uint64_t min_tick = tim.begin()->second.tick;
-				auto min_tileiter = tim.begin();
-				for (auto tileiter = tim.begin(); tileiter != tim.end(); ++ tileiter)
+				if (prefetch)
 				{
-					if (tileiter->second.tick < min_tick)
+					// Don't waste cache slots on predictions that fall outside of any image
+					std::vector<uint32_t> non_empty_ids;
+					for (auto id : ids)
 					{
-						min_tick = tileiter->second.tick;
-						min_tileiter = tileiter;
+						uint32_t level, tile_x, tile_y;
+						this->DecodeTileID(level, tile_x, tile_y, id);
+						if (this->DecodeAAttr(this->Pos2Shuff(level, tile_x, tile_y)) != 0xFFFFFFFF)
+						{
+							non_empty_ids.push_back(id);
+						}
+						else
+						{
+							tiles.emplace_back();
+							tiles.back().tile_id = id;
+							tiles.back().attr = 0xFFFFFFFF;
+						}
 					}
+					ids.swap(non_empty_ids);
 				}
 
-				tile_info.x = min_tileiter->second.x;
-				tile_info.y = min_tileiter->second.y;
-				tile_info.z = min_tileiter->second.z;
+				this->PrepareTiles(tiles, ids);
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(queue_mutex_);
+				for (auto& tile : tiles)
+				{
+					ready_tiles_.push_back(std::move(tile));
+				}
+			}
+		}
+	}
+
+	void JudaTexture::PrepareTiles(std::vector<PreparedTile>& tiles, std::vector<uint32_t> const & tile_ids)
+	{
+		uint32_t const tile_with_border_size = cache_tile_size_ + cache_tile_border_size_ * 2;
 
-				for (auto tileiter = tim.begin(); tileiter != tim.end();)
+		std::unordered_map<uint32_t, uint32_t> neighbor_id_map;
+		std::vector<uint32_t> all_neighbor_ids;
+		std::vector<uint32_t> neighbor_ids;
+		std::vector<uint32_t> tile_attrs;
+		std::vector<bool> in_same_image;
+		for (size_t i = 0; i < tile_ids.size(); ++ i)
+		{
+			uint32_t level, tile_x, tile_y;
+			this->DecodeTileID(level, tile_x, tile_y, tile_ids[i]);
+
+			std::array<uint32_t, 9> new_tile_id_with_neighbors;
+			new_tile_id_with_neighbors.fill(0xFFFFFFFF);
+			new_tile_id_with_neighbors[0] = tile_ids[i];
+
+			std::array<bool, 9> new_in_same_image;
+			new_in_same_image.fill(false);
+			new_in_same_image[0] = true;
+
+			uint32_t attr = this->DecodeAAttr(this->Pos2Shuff(level, tile_x, tile_y));
+			tile_attrs.push_back(attr);
+			if (attr != 0xFFFFFFFF)
+			{
+				std::array<int32_t, 9> new_tile_id_x;
+				std::array<int32_t, 9> new_tile_id_y;
+
+				int32_t left = tile_x - 1;
+				int32_t right = tile_x + 1;
+				int32_t up = tile_y - 1;
+				int32_t down = tile_y + 1;
+
+				ImageEntry const & entry = image_entries_[attr];
+				if (TAM_Wrap == (entry.addr_u_v & 0xF))
 				{
-					if (tileiter->second.tick == min_tick)
+					left = entry.x + (left - entry.x + entry.w) % entry.w;
+					right = entry.x + (right - entry.x + entry.w) % entry.w;
+				}
+				if (TAM_Wrap == ((entry.addr_u_v >> 4) & 0xF))
+				{
+					up = entry.y + (up - entry.y + entry.h) % entry.h;
+					down = entry.y + (down - entry.y + entry.h) % entry.h;
+				}
+
+				new_tile_id_x[1] = left;
+				new_tile_id_y[1] = up;
+				new_tile_id_x[2] = tile_x;
+				new_tile_id_y[2] = up;
+				new_tile_id_x[3] = right;
+				new_tile_id_y[3] = up;
+
+				new_tile_id_x[4] = left;
+				new_tile_id_y[4] = tile_y;
+				new_tile_id_x[5] = right;
+				new_tile_id_y[5] = tile_y;
+
+				new_tile_id_x[6] = left;
+				new_tile_id_y[6] = down;
+				new_tile_id_x[7] = tile_x;
+				new_tile_id_y[7] = down;
+				new_tile_id_x[8] = right;
+				new_tile_id_y[8] = down;
+
+				for (int j = 1; j < 9; ++ j)
+				{
+					if ((new_tile_id_x[j] >= 0) && (new_tile_id_y[j] >= 0)
+						&& (new_tile_id_x[j] < static_cast<int32_t>(num_tiles_) - 1)
+						&& (new_tile_id_y[j] < static_cast<int32_t>(num_tiles_) - 1))
 					{
-						uint32_t const id = tileiter->second.z * num_cache_tiles_a_layer + tileiter->second.y * num_cache_tiles_a_row + tileiter->second.x;
-						auto freeiter = tile_free_list_.begin();
-						while ((freeiter != tile_free_list_.end()) && (freeiter->second <= id))
+						new_tile_id_with_neighbors[j] = this->EncodeTileID(level, new_tile_id_x[j], new_tile_id_y[j]);
+						if (new_tile_id_with_neighbors[j] != 0xFFFFFFFF)
 						{
-							++ freeiter;
+							if (attr == this->DecodeAAttr(this->Pos2Shuff(level, new_tile_id_x[j], new_tile_id_y[j])))
+							{
+								new_in_same_image[j] = true;
+							}
 						}
-						tile_free_list_.emplace(freeiter, id, id + 1);
-
-						tileiter = tim.erase(tileiter);
 					}
 					else
 					{
-						 ++ tileiter;
+						new_tile_id_with_neighbors[j] = 0xFFFFFFFF;
 					}
 				}
-				for (auto freeiter = tile_free_list_.begin(); freeiter != tile_free_list_.end() - 1;)
-				{
-					auto nextiter = freeiter;
-					++ nextiter;
+			}
 
-					if (freeiter->second == nextiter->first)
-					{
-						freeiter->second = nextiter->second;
-						freeiter = tile_free_list_.erase(nextiter);
-						-- freeiter;
-					}
-					else
+			for (size_t j = 0; j < new_tile_id_with_neighbors.size(); ++ j)
+			{
+				if (new_tile_id_with_neighbors[j] != 0xFFFFFFFF)
+				{
+					if (neighbor_id_map.find(new_tile_id_with_neighbors[j]) == neighbor_id_map.end())
 					{
-						++ freeiter;
+						neighbor_id_map.emplace(new_tile_id_with_neighbors[j], static_cast<uint32_t>(neighbor_ids.size()));
+						neighbor_ids.push_back(new_tile_id_with_neighbors[j]);
 					}
 				}
+				all_neighbor_ids.push_back(new_tile_id_with_neighbors[j]);
+				in_same_image.push_back(new_in_same_image[j]);
+			}
+		}
+
+		TexturePtr const & cache_tex = tex_cache_ ? tex_cache_ : tex_cache_array_[0];
+		ElementFormat const format = cache_tex->Format();
+		uint32_t const mipmaps = cache_tex->NumMipMaps();
+		std::vector<std::vector<uint8_t>> neighbor_data;
+		this->DecodeTiles(neighbor_data, neighbor_ids, mipmaps);
+
+		for (size_t i = 0; i < all_neighbor_ids.size(); i += 9)
+		{
+			tiles.emplace_back();
+			PreparedTile& tile = tiles.back();
+			tile.tile_id = all_neighbor_ids[i];
+			tile.attr = tile_attrs[i / 9];
+			tile.mip_data.resize(mipmaps);
+			tile.row_pitches.resize(mipmaps);
+
+			uint8_t border_clr[4];
+			TexAddressingMode addr_u, addr_v;
+			if (tile.attr != 0xFFFFFFFF)
+			{
+				ImageEntry const & entry = image_entries_[tile.attr];
+				addr_u = static_cast<TexAddressingMode>(entry.addr_u_v & 0xF);
+				addr_v = static_cast<TexAddressingMode>((entry.addr_u_v >> 4) & 0xF);
+				texel_op_.from_float4(border_clr, &entry.border_clr.r());
+			}
+			else
+			{
+				addr_u = TAM_Clamp;
+				addr_v = TAM_Clamp;
+				border_clr[0] = border_clr[1] = border_clr[2] = border_clr[3] = 0;
 			}
 
 			std::array<uint32_t, 9> index_with_neighbors = { { 0 } };
@@ -1527,7 +1786,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (tile.attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_border_size);
@@ -1640,7 +1899,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (tile.attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_tile_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_tile_size * mip_border_size);
@@ -1750,7 +2009,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (tile.attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_border_size);
@@ -1864,7 +2123,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (tile.attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_tile_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_tile_size);
@@ -1977,7 +2236,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (tile.attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_tile_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_tile_size);
@@ -2091,7 +2350,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (tile.attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_border_size);
@@ -2204,7 +2463,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (tile.attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_tile_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_tile_size * mip_border_size);
@@ -2314,7 +2573,7 @@ namespace KlayGE
 					}
 					else
 					{
-						if (tile_info.attr != 0xFFFFFFFF)
+						if (tile.attr != 0xFFFFFFFF)
 						{
 							std::vector<int32_t> border_coords_x(mip_border_size * mip_border_size);
 							std::vector<int32_t> border_coords_y(mip_border_size * mip_border_size);
@@ -2419,29 +2678,6 @@ namespace KlayGE
 					}
 				}
 
-				ElementFormat format;
-				if (tex_cache_)
-				{
-					format = tex_cache_->Format();
-				}
-				else
-				{
-					format = tex_cache_array_[tile_info.z]->Format();
-				}
-
-				TexturePtr target_tex;
-				uint32_t target_array_index;
-				if (tex_cache_)
-				{
-					target_tex = tex_cache_;
-					target_array_index = tile_info.z;
-				}
-				else
-				{
-					target_tex = tex_cache_array_[tile_info.z];
-					target_array_index = 0;
-				}
-
 				if (IsCompressedFormat(format))
 				{
 					uint32_t const block_width = tex_codec_->BlockWidth();
@@ -2528,36 +2764,151 @@ namespace KlayGE
 							&bc[0], bc_row_pitch, bc_slice_pitch, p_argb, row_pitch, slice_pitch, TCM_Quality);
 					}
 
-					target_tex->UpdateSubresource2D(target_array_index, l,
-						tile_info.x * mip_tile_with_border_size, tile_info.y * mip_tile_with_border_size,
-						mip_tile_with_border_size, mip_tile_with_border_size,
-						&bc[0], bc_row_pitch);
+					tile.mip_data[l].swap(bc);
+					tile.row_pitches[l] = bc_row_pitch;
 				}
 				else
 				{
-					target_tex->UpdateSubresource2D(target_array_index, l,
-						tile_info.x * mip_tile_with_border_size, tile_info.y * mip_tile_with_border_size,
-						mip_tile_with_border_size, mip_tile_with_border_size,
-						&tex_a_tile_data[0], mip_tile_with_border_size * texel_size_);
+					tile.mip_data[l].swap(tex_a_tile_data);
+					tile.row_pitches[l] = mip_tile_with_border_size * texel_size_;
 				}
 
 				mip_tile_size /= 2;
 				mip_tile_with_border_size /= 2;
 				mip_border_size /= 2;
 			}
+		}
+	}
+
+	void JudaTexture::UploadTile(PreparedTile const & tile, uint64_t tick, bool prefetched)
+	{
+		uint32_t const tex_width = tex_cache_ ? tex_cache_->Width(0) : tex_cache_array_[0]->Width(0);
+		uint32_t const tex_height = tex_cache_ ? tex_cache_->Height(0) : tex_cache_array_[0]->Height(0);
+		uint32_t const tex_layer = tex_cache_ ? tex_cache_->ArraySize() : static_cast<uint32_t>(tex_cache_array_.size());
+		uint32_t const tile_with_border_size = cache_tile_size_ + cache_tile_border_size_ * 2;
 
-			uint8_t const a_tile_indirect[] =
+		uint32_t const num_cache_tiles_a_row = tex_width / tile_with_border_size;
+		uint32_t const num_cache_tiles_a_layer = num_cache_tiles_a_row * tex_height / tile_with_border_size;
+		uint32_t const num_cache_total_tiles = num_cache_tiles_a_layer * tex_layer;
+
+		auto& tim = tile_info_map_;
+
+		TileInfo tile_info;
+		tile_info.attr = tile.attr;
+		tile_info.tick = tick;
+		tile_info.prefetched = prefetched;
+		if (tile_info_map_.size() < num_cache_total_tiles)
+		{
+			// Still has space in cache
+
+			uint32_t const s = tile_free_list_.front().first;
+			tile_info.z = s / num_cache_tiles_a_layer;
+			tile_info.y = (s - tile_info.z * num_cache_tiles_a_layer) / num_cache_tiles_a_row;
+			tile_info.x = s - tile_info.z * num_cache_tiles_a_layer - tile_info.y * num_cache_tiles_a_row;
+
+			++ tile_free_list_.front().first;
+			if (tile_free_list_.front().first == tile_free_list_.front().second)
 			{
-				static_cast<uint8_t>(tile_info.x),
-				static_cast<uint8_t>(tile_info.y),
-				static_cast<uint8_t>(tile_info.z),
-				0
-			};
-			uint32_t level, tile_x, tile_y;
-			this->DecodeTileID(level, tile_x, tile_y, all_neighbor_ids[i]);
-			tex_indirect_->UpdateSubresource2D(0, 0, tile_x, tile_y, 1, 1, a_tile_indirect, sizeof(a_tile_indirect));
+				tile_free_list_.pop_front();
+			}
+		}
+		else
+		{
+			// Find tiles that are not used for the longest time
+
+			uint64_t min_tick = tim.begin()->second.tick;
+			auto min_tileiter = tim.begin();
+			for (auto tileiter = tim.begin(); tileiter != tim.end(); ++ tileiter)
+			{
+				if (tileiter->second.tick < min_tick)
+				{
+					min_tick = tileiter->second.tick;
+					min_tileiter = tileiter;
+				}
+			}
+
+			tile_info.x = min_tileiter->second.x;
+			tile_info.y = min_tileiter->second.y;
+			tile_info.z = min_tileiter->second.z;
+
+			for (auto tileiter = tim.begin(); tileiter != tim.end();)
+			{
+				if (tileiter->second.tick == min_tick)
+				{
+					uint32_t const id = tileiter->second.z * num_cache_tiles_a_layer + tileiter->second.y * num_cache_tiles_a_row + tileiter->second.x;
+					auto freeiter = tile_free_list_.begin();
+					while ((freeiter != tile_free_list_.end()) && (freeiter->second <= id))
+					{
+						++ freeiter;
+					}
+					tile_free_list_.emplace(freeiter, id, id + 1);
 
-			tim.emplace(all_neighbor_ids[i], tile_info);
+					tileiter = tim.erase(tileiter);
+				}
+				else
+				{
+					 ++ tileiter;
+				}
+			}
+			for (auto freeiter = tile_free_list_.begin(); freeiter != tile_free_list_.end() - 1;)
+			{
+				auto nextiter = freeiter;
+				++ nextiter;
+
+				if (freeiter->second == nextiter->first)
+				{
+					freeiter->second = nextiter->second;
+					freeiter = tile_free_list_.erase(nextiter);
+					-- freeiter;
+				}
+				else
+				{
+					++ freeiter;
+				}
+			}
+		}
+
+		TexturePtr target_tex;
+		uint32_t target_array_index;
+		if (tex_cache_)
+		{
+			target_tex = tex_cache_;
+			target_array_index = tile_info.z;
+		}
+		else
+		{
+			target_tex = tex_cache_array_[tile_info.z];
+			target_array_index = 0;
+		}
+
+		uint32_t mip_tile_with_border_size = tile_with_border_size;
+		for (uint32_t l = 0; l < tile.mip_data.size(); ++ l)
+		{
+			target_tex->UpdateSubresource2D(target_array_index, l,
+				tile_info.x * mip_tile_with_border_size, tile_info.y * mip_tile_with_border_size,
+				mip_tile_with_border_size, mip_tile_with_border_size,
+				&tile.mip_data[l][0], tile.row_pitches[l]);
+
+			mip_tile_with_border_size /= 2;
+		}
+
+		uint8_t const a_tile_indirect[] =
+		{
+			static_cast<uint8_t>(tile_info.x),
+			static_cast<uint8_t>(tile_info.y),
+			static_cast<uint8_t>(tile_info.z),
+			0
+		};
+		uint32_t level, tile_x, tile_y;
+		this->DecodeTileID(level, tile_x, tile_y, tile.tile_id);
+		tex_indirect_->UpdateSubresource2D(0, 0, tile_x, tile_y, 1, 1, a_tile_indirect, sizeof(a_tile_indirect));
+
+		tim.emplace(tile.tile_id, tile_info);
+
+		++ stats_.uploads;
+		if (prefetched)
+		{
+			++ stats_.prefetch_uploads;
 		}
 	}
 }
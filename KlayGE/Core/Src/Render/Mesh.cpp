@@ -23,6 +23,8 @@
 #include <KFL/Math.hpp>
 #include <KlayGE/Context.hpp>
 #include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/RenderEngine.hpp>
+#include <KlayGE/FrameBuffer.hpp>
 #include <KlayGE/Texture.hpp>
 #include <KlayGE/RenderEffect.hpp>
 #include <KlayGE/ResLoader.hpp>
@@ -32,6 +34,7 @@
 #include <KlayGE/LZMACodec.hpp>
 #include <KlayGE/Light.hpp>
 #include <KlayGE/RenderMaterial.hpp>
+#include <KlayGE/TextureStreaming.hpp>
 #include <KFL/Hash.hpp>
 
 #include <algorithm>
@@ -47,7 +50,7 @@ namespace
 {
 	using namespace KlayGE;
 
-	uint32_t const MODEL_BIN_VERSION = 14;
+	uint32_t const MODEL_BIN_VERSION = 16;
 
 	class RenderModelLoadingDesc : public ResLoadingDesc
 	{
@@ -76,6 +79,7 @@ namespace
 				std::vector<uint32_t> mesh_base_vertices;
 				std::vector<uint32_t> mesh_num_indices;
 				std::vector<uint32_t> mesh_start_indices;
+				std::vector<std::vector<MeshLod>> mesh_lods;
 				std::vector<Joint> joints;
 				std::shared_ptr<AnimationActionsType> actions;
 				std::shared_ptr<KeyFramesType> kfs;
@@ -128,6 +132,7 @@ namespace
 				model_desc_.model_data->pos_bbs, model_desc_.model_data->tc_bbs,
 				model_desc_.model_data->mesh_num_vertices, model_desc_.model_data->mesh_base_vertices,
 				model_desc_.model_data->mesh_num_indices, model_desc_.model_data->mesh_start_indices, 
+				model_desc_.model_data->mesh_lods,
 				model_desc_.model_data->joints, model_desc_.model_data->actions, model_desc_.model_data->kfs,
 				model_desc_.model_data->num_frames, model_desc_.model_data->frame_rate,
 				model_desc_.model_data->frame_pos_bbs);
@@ -235,6 +240,10 @@ namespace
 					mesh->NumIndices(rhs_mesh->NumIndices());
 					mesh->StartVertexLocation(rhs_mesh->StartVertexLocation());
 					mesh->StartIndexLocation(rhs_mesh->StartIndexLocation());
+					if (!rhs_mesh->Lods().empty())
+					{
+						mesh->Lods(rhs_mesh->Lods());
+					}
 				}
 
 				BOOST_ASSERT(model->IsSkinned() == rhs_model->IsSkinned());
@@ -327,6 +336,15 @@ namespace
 				mesh->NumIndices(model_desc_.model_data->mesh_num_indices[mesh_index]);
 				mesh->StartVertexLocation(model_desc_.model_data->mesh_base_vertices[mesh_index]);
 				mesh->StartIndexLocation(model_desc_.model_data->mesh_start_indices[mesh_index]);
+
+				auto const & lods = model_desc_.model_data->mesh_lods[mesh_index];
+				if (!lods.empty())
+				{
+					std::vector<MeshLod> all_lods;
+					all_lods.push_back({ mesh->NumIndices(), mesh->StartIndexLocation(), 0.0f });
+					all_lods.insert(all_lods.end(), lods.begin(), lods.end());
+					mesh->Lods(all_lods);
+				}
 			}
 
 			if (model_desc_.model_data->kfs && !model_desc_.model_data->kfs->empty())
@@ -502,12 +520,32 @@ namespace KlayGE
 	}
 
 
+	uint32_t SelectMeshLod(std::vector<MeshLod> const & lods, float pixels_per_unit, float max_pixel_error)
+	{
+		// Errors grow with the levels
+		uint32_t ret = 0;
+		for (uint32_t i = 1; i < lods.size(); ++ i)
+		{
+			if (lods[i].error * pixels_per_unit <= max_pixel_error)
+			{
+				ret = i;
+			}
+			else
+			{
+				break;
+			}
+		}
+		return ret;
+	}
+
 	StaticMesh::StaticMesh(RenderModelPtr const & model, std::wstring const & name)
-		: name_(name), model_(model),
+		: name_(name), active_lod_(0), max_lod_pixel_error_(1), model_(model),
 			hw_res_ready_(false)
 	{
 		rl_ = Context::Instance().RenderFactoryInstance().MakeRenderLayout();
 		rl_->TopologyType(RenderLayout::TT_TriangleList);
+
+		stream_handles_.fill(static_cast<uint32_t>(-1));
 	}
 
 	StaticMesh::~StaticMesh()
@@ -520,6 +558,7 @@ namespace KlayGE
 
 		mtl_ = model->GetMaterial(this->MaterialID());
 
+		TextureStreamer* streamer = Context::Instance().TextureStreamerInstance();
 		for (size_t i = 0; i < RenderMaterial::TS_NumTextureSlots; ++ i)
 		{
 			if (!mtl_->tex_names[i].empty())
@@ -527,6 +566,14 @@ namespace KlayGE
 				if (!ResLoader::Instance().Locate(mtl_->tex_names[i]).empty())
 				{
 					textures_[i] = ASyncLoadTexture(mtl_->tex_names[i], EAH_GPU_Read | EAH_Immutable);
+					if (streamer)
+					{
+						stream_handles_[i] = streamer->ClaimRequests(textures_[i]);
+						if (stream_handles_[i] != static_cast<uint32_t>(-1))
+						{
+							streamed_textures_[i] = textures_[i];
+						}
+					}
 				}
 			}
 		}
@@ -609,6 +656,76 @@ namespace KlayGE
 		rl_->BindIndexStream(index_stream, format);
 	}
 
+	void StaticMesh::Lods(std::vector<MeshLod> const & lods)
+	{
+		lods_ = lods;
+		active_lod_ = 0;
+		if (!lods_.empty())
+		{
+			this->ActiveLod(0);
+		}
+	}
+
+	void StaticMesh::ActiveLod(uint32_t lod)
+	{
+		BOOST_ASSERT(lod < lods_.size());
+
+		active_lod_ = lod;
+		rl_->NumIndices(lods_[lod].num_indices);
+		rl_->StartIndexLocation(lods_[lod].start_index_location);
+	}
+
+	void StaticMesh::SelectDetail(FrameBuffer const & fb)
+	{
+		TextureStreamer* streamer = Context::Instance().TextureStreamerInstance();
+		bool streamed = false;
+		if (streamer)
+		{
+			for (auto handle : stream_handles_)
+			{
+				streamed |= (handle != static_cast<uint32_t>(-1));
+			}
+		}
+
+		if ((lods_.size() > 1) || streamed)
+		{
+			Camera const & camera = *fb.GetViewport()->camera;
+			float4x4 const & proj = camera.ProjMatrix();
+			float4x4 const mv = model_mat_ * camera.ViewMatrix();
+
+			// The errors are in model space, scaled by the largest axis of the model matrix. The nearest point of the
+			// bounding sphere decides how large they get on screen.
+			float const scale = std::max(std::max(MathLib::length(float3(mv(0, 0), mv(0, 1), mv(0, 2))),
+				MathLib::length(float3(mv(1, 0), mv(1, 1), mv(1, 2)))), MathLib::length(float3(mv(2, 0), mv(2, 1), mv(2, 2))));
+			float3 const center = MathLib::transform_coord(pos_aabb_.Center(), mv);
+			float const nearest_z = center.z() - MathLib::length(pos_aabb_.HalfSize()) * scale;
+			float const w = proj(2, 3) * nearest_z + proj(3, 3);
+
+			float const pixels_per_unit = (w > 0) ? scale * proj(1, 1) * 0.5f * fb.Height() / w : 0;
+			if (lods_.size() > 1)
+			{
+				this->ActiveLod((w > 0) ? SelectMeshLod(lods_, pixels_per_unit, max_lod_pixel_error_) : 0);
+			}
+
+			if (streamed)
+			{
+				// The bounding sphere on screen, divided by how many times the texture repeats over it. A camera inside
+				// the sphere wants the full screen.
+				float const tc_extent = std::max(std::max(tc_aabb_.HalfSize().x(), tc_aabb_.HalfSize().y()) * 2, 1e-3f);
+				float const screen_size = ((w > 0) ? 2 * MathLib::length(pos_aabb_.HalfSize()) * pixels_per_unit
+					: static_cast<float>(std::max(fb.Width(), fb.Height()))) / tc_extent;
+				for (size_t i = 0; i < RenderMaterial::TS_NumTextureSlots; ++ i)
+				{
+					if (stream_handles_[i] != static_cast<uint32_t>(-1))
+					{
+						streamer->RequestScreenSize(stream_handles_[i], screen_size);
+						textures_[i] = streamer->CurrentTexture(stream_handles_[i]);
+					}
+				}
+			}
+		}
+	}
+
 
 	std::pair<std::pair<Quaternion, Quaternion>, float> KeyFrames::Frame(float frame) const
 	{
@@ -994,6 +1111,7 @@ namespace KlayGE
 		std::vector<AABBox>& pos_bbs, std::vector<AABBox>& tc_bbs,
 		std::vector<uint32_t>& mesh_num_vertices, std::vector<uint32_t>& mesh_base_vertices,
 		std::vector<uint32_t>& mesh_num_indices, std::vector<uint32_t>& mesh_base_indices,
+		std::vector<std::vector<MeshLod>>& mesh_lods,
 		std::vector<Joint>& joints, std::shared_ptr<AnimationActionsType>& actions,
 		std::shared_ptr<KeyFramesType>& kfs, uint32_t& num_frames, uint32_t& frame_rate,
 		std::vector<std::shared_ptr<AABBKeyFrames>>& frame_pos_bbs)
@@ -1219,6 +1337,7 @@ namespace KlayGE
 		mesh_base_vertices.resize(num_meshes);
 		mesh_num_indices.resize(num_meshes);
 		mesh_base_indices.resize(num_meshes);
+		mesh_lods.resize(num_meshes);
 		for (uint32_t mesh_index = 0; mesh_index < num_meshes; ++ mesh_index)
 		{
 			mesh_names[mesh_index] = ReadShortString(decoded);
@@ -1257,6 +1376,21 @@ namespace KlayGE
 			mesh_num_indices[mesh_index] = LE2Native(mesh_num_indices[mesh_index]);
 			decoded->read(&mesh_base_indices[mesh_index], sizeof(mesh_base_indices[mesh_index]));
 			mesh_base_indices[mesh_index] = LE2Native(mesh_base_indices[mesh_index]);
+
+			uint32_t num_lods;
+			decoded->read(&num_lods, sizeof(num_lods));
+			num_lods = LE2Native(num_lods);
+			mesh_lods[mesh_index].resize(num_lods);
+			for (uint32_t lod_index = 0; lod_index < num_lods; ++ lod_index)
+			{
+				MeshLod& lod = mesh_lods[mesh_index][lod_index];
+				decoded->read(&lod.num_indices, sizeof(lod.num_indices));
+				lod.num_indices = LE2Native(lod.num_indices);
+				decoded->read(&lod.start_index_location, sizeof(lod.start_index_location));
+				lod.start_index_location = LE2Native(lod.start_index_location);
+				decoded->read(&lod.error, sizeof(lod.error));
+				lod.error = LE2Native(lod.error);
+			}
 		}
 
 		joints.resize(num_joints);
@@ -1530,10 +1664,11 @@ namespace KlayGE
 							{
 								BOOST_ASSERT(EF_SIGNED_ABGR16 == merged_ves[ve].format);
 
+								// The same as the GPU reads SIGNED formats
 								int16_t const * p = reinterpret_cast<int16_t const *>(src);
-								pos.x() = (((p[0] + 32768) / 65536.0f) * 2 - 1) * pos_extent.x() + pos_center.x();
-								pos.y() = (((p[1] + 32768) / 65536.0f) * 2 - 1) * pos_extent.y() + pos_center.y();
-								pos.z() = (((p[2] + 32768) / 65536.0f) * 2 - 1) * pos_extent.z() + pos_center.z();
+								pos.x() = std::max(p[0] / 32767.0f, -1.0f) * pos_extent.x() + pos_center.x();
+								pos.y() = std::max(p[1] / 32767.0f, -1.0f) * pos_extent.y() + pos_center.y();
+								pos.z() = std::max(p[2] / 32767.0f, -1.0f) * pos_extent.z() + pos_center.z();
 							}
 							break;
 						}
@@ -1555,8 +1690,8 @@ namespace KlayGE
 								BOOST_ASSERT(EF_SIGNED_GR16 == merged_ves[ve].format);
 
 								int16_t const * p = reinterpret_cast<int16_t const *>(src);
-								texcoords.back().x() = (((p[0] + 32768) / 65536.0f) * 2 - 1) * tc_extent.x() + tc_center.x();
-								texcoords.back().y() = (((p[1] + 32768) / 65536.0f) * 2 - 1) * tc_extent.y() + tc_center.y();
+								texcoords.back().x() = std::max(p[0] / 32767.0f, -1.0f) * tc_extent.x() + tc_center.x();
+								texcoords.back().y() = std::max(p[1] / 32767.0f, -1.0f) * tc_extent.y() + tc_center.y();
 							}
 							break;
 						}
@@ -1843,8 +1978,17 @@ namespace KlayGE
 
 				mesh_num_vertices[mesh_index] = mesh.NumVertices();
 				mesh_base_vertices[mesh_index] = mesh.StartVertexLocation();
-				mesh_num_indices[mesh_index] = mesh.NumIndices();
-				mesh_base_indices[mesh_index] =  mesh.StartIndexLocation();
+				if (mesh.Lods().empty())
+				{
+					mesh_num_indices[mesh_index] = mesh.NumIndices();
+					mesh_base_indices[mesh_index] = mesh.StartIndexLocation();
+				}
+				else
+				{
+					// LOD levels are regenerated by MeshMLJIT
+					mesh_num_indices[mesh_index] = mesh.Lods()[0].num_indices;
+					mesh_base_indices[mesh_index] = mesh.Lods()[0].start_index_location;
+				}
 			}
 		}
 
@@ -56,18 +56,14 @@
 #include <KFL/XMLDom.hpp>
 #include <KFL/Thread.hpp>
 #include <KFL/Hash.hpp>
+#include <KlayGE/PerfProfiler.hpp>
 
+#include <cstring>
 #include <fstream>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
 #include <boost/assert.hpp>
-#if defined(KLAYGE_COMPILER_GCC)
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wdeprecated-declarations" // Ignore auto_ptr declaration
-#endif
-#include <boost/algorithm/string/split.hpp>
-#if defined(KLAYGE_COMPILER_GCC)
-#pragma GCC diagnostic pop
-#endif
-#include <boost/algorithm/string/trim.hpp>
 #include <boost/lexical_cast.hpp>
 
 #include <KlayGE/RenderEffect.hpp>
@@ -76,7 +72,41 @@ namespace
 {
 	using namespace KlayGE;
 
-	uint32_t const KFX_VERSION = 0x0110;
+#if KLAYGE_IS_DEV_PLATFORM
+	// A parsed include file. It's only read after parsing, so all the effects that include it can share it.
+	struct IncludeDoc
+	{
+		uint64_t timestamp;
+		std::unique_ptr<XMLDocument> doc;
+		XMLNodePtr root;
+	};
+
+	std::shared_ptr<IncludeDoc const> LoadIncludeDoc(std::string const & name)
+	{
+		static std::mutex cache_mutex;
+		static std::unordered_map<std::string, std::shared_ptr<IncludeDoc const>> cache;
+
+		ResIdentifierPtr source = ResLoader::Instance().Open(name);
+		uint64_t const timestamp = source ? source->Timestamp() : 0;
+		{
+			std::lock_guard<std::mutex> lock(cache_mutex);
+			auto iter = cache.find(name);
+			if ((iter != cache.end()) && (iter->second->timestamp == timestamp))
+			{
+				return iter->second;
+			}
+		}
+
+		auto include_doc = MakeSharedPtr<IncludeDoc>();
+		include_doc->timestamp = timestamp;
+		include_doc->doc = MakeUniquePtr<XMLDocument>();
+		include_doc->root = include_doc->doc->Parse(source);
+
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		cache[name] = include_doc;
+		return include_doc;
+	}
+#endif
 
 	std::mutex singleton_mutex;
 
@@ -699,13 +729,7 @@ namespace
 
 	int get_index(XMLNodePtr const & node)
 	{
-		int index = 0;
-		XMLAttributePtr attr = node->Attrib("index");
-		if (attr)
-		{
-			index = attr->ValueInt();
-		}
-		return index;
+		return node->AttribInt("index", 0);
 	}
 
 	std::string get_profile(XMLNodePtr const & node)
@@ -727,6 +751,25 @@ namespace
 		return value.substr(0, value.find("("));
 	}
 
+	// Array values are comma separated lists. They are parsed in place, without splitting into strings. T is the type of
+	// the components, ElemT the type of the array elements.
+	template <typename T, typename ElemT>
+	std::vector<ElemT> read_array_value(XMLNode const & value_node, uint32_t array_size)
+	{
+		uint32_t const num_comps = sizeof(ElemT) / sizeof(T);
+		static_assert(num_comps * sizeof(T) == sizeof(ElemT), "ElemT must be made of T");
+
+		std::vector<T> vals(array_size * num_comps, 0);
+		uint32_t const num_vals = value_node.ValueArray(&vals[0], static_cast<uint32_t>(vals.size()));
+
+		std::vector<ElemT> ret((num_vals + num_comps - 1) / num_comps);
+		if (!ret.empty())
+		{
+			std::memcpy(&ret[0], &vals[0], ret.size() * sizeof(ret[0]));
+		}
+		return ret;
+	}
+
 	std::unique_ptr<RenderVariable> read_var(XMLNodePtr const & node, uint32_t type, uint32_t array_size)
 	{
 		std::unique_ptr<RenderVariable> var;
@@ -753,15 +796,8 @@ namespace
 		case REDT_uint:
 			if (0 == array_size)
 			{
-				attr = node->Attrib("value");
-				uint32_t tmp = 0;
-				if (attr)
-				{
-					tmp = attr->ValueInt();
-				}
-
 				var = MakeUniquePtr<RenderVariableUInt>();
-				*var = tmp;
+				*var = node->AttribUInt("value", 0);
 			}
 			else
 			{
@@ -773,19 +809,7 @@ namespace
 					value_node = value_node->FirstNode();
 					if (value_node && (XNT_CData == value_node->Type()))
 					{
-						std::string value_str = value_node->ValueString();
-						std::vector<std::string> strs;
-						boost::algorithm::split(strs, value_str, boost::is_any_of(","));
-						std::vector<uint32_t> init_val(std::min(array_size, static_cast<uint32_t>(strs.size())), 0);
-						for (size_t index = 0; index < init_val.size(); ++ index)
-						{
-							if (index < strs.size())
-							{
-								boost::algorithm::trim(strs[index]);
-								init_val[index] = boost::lexical_cast<uint32_t>(strs[index]);
-							}
-						}
-						*var = init_val;
+						*var = read_array_value<uint32_t, uint32_t>(*value_node, array_size);
 					}
 				}
 			}
@@ -794,15 +818,8 @@ namespace
 		case REDT_int:
 			if (0 == array_size)
 			{
-				attr = node->Attrib("value");
-				int32_t tmp = 0;
-				if (attr)
-				{
-					tmp = attr->ValueInt();
-				}
-
 				var = MakeUniquePtr<RenderVariableInt>();
-				*var = tmp;
+				*var = node->AttribInt("value", 0);
 			}
 			else
 			{
@@ -814,19 +831,7 @@ namespace
 					value_node = value_node->FirstNode();
 					if (value_node && (XNT_CData == value_node->Type()))
 					{
-						std::string value_str = value_node->ValueString();
-						std::vector<std::string> strs;
-						boost::algorithm::split(strs, value_str, boost::is_any_of(","));
-						std::vector<int32_t> init_val(std::min(array_size, static_cast<uint32_t>(strs.size())), 0);
-						for (size_t index = 0; index < init_val.size(); ++ index)
-						{
-							if (index < strs.size())
-							{
-								boost::algorithm::trim(strs[index]);
-								init_val[index] = boost::lexical_cast<int32_t>(strs[index]);
-							}
-						}
-						*var = init_val;
+						*var = read_array_value<int32_t, int32_t>(*value_node, array_size);
 					}
 				}
 			}
@@ -970,15 +975,8 @@ namespace
 		case REDT_float:
 			if (0 == array_size)
 			{
-				float tmp = 0;
-				attr = node->Attrib("value");
-				if (attr)
-				{
-					tmp = attr->ValueFloat();
-				}
-
 				var = MakeUniquePtr<RenderVariableFloat>();
-				*var = tmp;
+				*var = node->AttribFloat("value", 0);
 			}
 			else
 			{
@@ -990,19 +988,7 @@ namespace
 					value_node = value_node->FirstNode();
 					if (value_node && (XNT_CData == value_node->Type()))
 					{
-						std::string value_str = value_node->ValueString();
-						std::vector<std::string> strs;
-						boost::algorithm::split(strs, value_str, boost::is_any_of(","));
-						std::vector<float> init_val(std::min(array_size, static_cast<uint32_t>(strs.size())), 0.0f);
-						for (size_t index = 0; index < init_val.size(); ++ index)
-						{
-							if (index < strs.size())
-							{
-								boost::algorithm::trim(strs[index]);
-								init_val[index] = boost::lexical_cast<float>(strs[index]);
-							}
-						}
-						*var = init_val;
+						*var = read_array_value<float, float>(*value_node, array_size);
 					}
 				}
 			}
@@ -1012,16 +998,8 @@ namespace
 			if (0 == array_size)
 			{
 				uint2 tmp(0, 0);
-				attr = node->Attrib("x");
-				if (attr)
-				{
-					tmp.x() = attr->ValueUInt();
-				}
-				attr = node->Attrib("y");
-				if (attr)
-				{
-					tmp.y() = attr->ValueUInt();
-				}
+				tmp.x() = node->AttribUInt("x", 0);
+				tmp.y() = node->AttribUInt("y", 0);
 
 				var = MakeUniquePtr<RenderVariableUInt2>();
 				*var = tmp;
@@ -1036,22 +1014,7 @@ namespace
 					value_node = value_node->FirstNode();
 					if (value_node && (XNT_CData == value_node->Type()))
 					{
-						std::string value_str = value_node->ValueString();
-						std::vector<std::string> strs;
-						boost::algorithm::split(strs, value_str, boost::is_any_of(","));
-						std::vector<uint2> init_val(std::min(array_size, static_cast<uint32_t>((strs.size() + 1) / 2)), int2(0, 0));
-						for (size_t index = 0; index < init_val.size(); ++ index)
-						{
-							for (size_t j = 0; j < 2; ++ j)
-							{
-								if (index * 2 + j < strs.size())
-								{
-									boost::algorithm::trim(strs[index * 2 + j]);
-									init_val[index][j] = boost::lexical_cast<uint32_t>(strs[index * 2 + j]);
-								}
-							}
-						}
-						*var = init_val;
+						*var = read_array_value<uint32_t, int2>(*value_node, array_size);
 					}
 				}
 			}
@@ -1061,21 +1024,9 @@ namespace
 			if (0 == array_size)
 			{
 				uint3 tmp(0, 0, 0);
-				attr = node->Attrib("x");
-				if (attr)
-				{
-					tmp.x() = attr->ValueUInt();
-				}
-				attr = node->Attrib("y");
-				if (attr)
-				{
-					tmp.y() = attr->ValueUInt();
-				}
-				attr = node->Attrib("z");
-				if (attr)
-				{
-					tmp.z() = attr->ValueUInt();
-				}
+				tmp.x() = node->AttribUInt("x", 0);
+				tmp.y() = node->AttribUInt("y", 0);
+				tmp.z() = node->AttribUInt("z", 0);
 
 				var = MakeUniquePtr<RenderVariableUInt3>();
 				*var = tmp;
@@ -1090,22 +1041,7 @@ namespace
 					value_node = value_node->FirstNode();
 					if (value_node && (XNT_CData == value_node->Type()))
 					{
-						std::string value_str = value_node->ValueString();
-						std::vector<std::string> strs;
-						boost::algorithm::split(strs, value_str, boost::is_any_of(","));
-						std::vector<uint3> init_val(std::min(array_size, static_cast<uint32_t>((strs.size() + 2) / 3)), int3(0, 0, 0));
-						for (size_t index = 0; index < init_val.size(); ++ index)
-						{
-							for (size_t j = 0; j < 3; ++ j)
-							{
-								if (index * 3 + j < strs.size())
-								{
-									boost::algorithm::trim(strs[index * 3 + j]);
-									init_val[index][j] = boost::lexical_cast<uint32_t>(strs[index * 3 + j]);
-								}
-							}
-						}
-						*var = init_val;
+						*var = read_array_value<uint32_t, int3>(*value_node, array_size);
 					}
 				}
 			}
@@ -1115,26 +1051,10 @@ namespace
 			if (0 == array_size)
 			{
 				uint4 tmp(0, 0, 0, 0);
-				attr = node->Attrib("x");
-				if (attr)
-				{
-					tmp.x() = attr->ValueUInt();
-				}
-				attr = node->Attrib("y");
-				if (attr)
-				{
-					tmp.y() = attr->ValueUInt();
-				}
-				attr = node->Attrib("z");
-				if (attr)
-				{
-					tmp.z() = attr->ValueUInt();
-				}
-				attr = node->Attrib("w");
-				if (attr)
-				{
-					tmp.w() = attr->ValueUInt();
-				}
+				tmp.x() = node->AttribUInt("x", 0);
+				tmp.y() = node->AttribUInt("y", 0);
+				tmp.z() = node->AttribUInt("z", 0);
+				tmp.w() = node->AttribUInt("w", 0);
 
 				var = MakeUniquePtr<RenderVariableUInt4>();
 				*var = tmp;
@@ -1149,22 +1069,7 @@ namespace
 					value_node = value_node->FirstNode();
 					if (value_node && (XNT_CData == value_node->Type()))
 					{
-						std::string value_str = value_node->ValueString();
-						std::vector<std::string> strs;
-						boost::algorithm::split(strs, value_str, boost::is_any_of(","));
-						std::vector<int4> init_val(std::min(array_size, static_cast<uint32_t>((strs.size() + 3) / 4)), int4(0, 0, 0, 0));
-						for (size_t index = 0; index < init_val.size(); ++ index)
-						{
-							for (size_t j = 0; j < 4; ++ j)
-							{
-								if (index * 4 + j < strs.size())
-								{
-									boost::algorithm::trim(strs[index * 4 + j]);
-									init_val[index][j] = boost::lexical_cast<uint32_t>(strs[index * 4 + j]);
-								}
-							}
-						}
-						*var = init_val;
+						*var = read_array_value<uint32_t, int4>(*value_node, array_size);
 					}
 				}
 			}
@@ -1174,16 +1079,8 @@ namespace
 			if (0 == array_size)
 			{
 				int2 tmp(0, 0);
-				attr = node->Attrib("x");
-				if (attr)
-				{
-					tmp.x() = attr->ValueInt();
-				}
-				attr = node->Attrib("y");
-				if (attr)
-				{
-					tmp.y() = attr->ValueInt();
-				}
+				tmp.x() = node->AttribInt("x", 0);
+				tmp.y() = node->AttribInt("y", 0);
 
 				var = MakeUniquePtr<RenderVariableInt2>();
 				*var = tmp;
@@ -1198,22 +1095,7 @@ namespace
 					value_node = value_node->FirstNode();
 					if (value_node && (XNT_CData == value_node->Type()))
 					{
-						std::string value_str = value_node->ValueString();
-						std::vector<std::string> strs;
-						boost::algorithm::split(strs, value_str, boost::is_any_of(","));
-						std::vector<int2> init_val(std::min(array_size, static_cast<uint32_t>((strs.size() + 1) / 2)), int2(0, 0));
-						for (size_t index = 0; index < init_val.size(); ++ index)
-						{
-							for (size_t j = 0; j < 2; ++ j)
-							{
-								if (index * 2 + j < strs.size())
-								{
-									boost::algorithm::trim(strs[index * 2 + j]);
-									init_val[index][j] = boost::lexical_cast<int32_t>(strs[index * 2 + j]);
-								}
-							}
-						}
-						*var = init_val;
+						*var = read_array_value<int32_t, int2>(*value_node, array_size);
 					}
 				}
 			}
@@ -1223,21 +1105,9 @@ namespace
 			if (0 == array_size)
 			{
 				int3 tmp(0, 0, 0);
-				attr = node->Attrib("x");
-				if (attr)
-				{
-					tmp.x() = attr->ValueInt();
-				}
-				attr = node->Attrib("y");
-				if (attr)
-				{
-					tmp.y() = attr->ValueInt();
-				}
-				attr = node->Attrib("z");
-				if (attr)
-				{
-					tmp.z() = attr->ValueInt();
-				}
+				tmp.x() = node->AttribInt("x", 0);
+				tmp.y() = node->AttribInt("y", 0);
+				tmp.z() = node->AttribInt("z", 0);
 
 				var = MakeUniquePtr<RenderVariableInt3>();
 				*var = tmp;
@@ -1252,22 +1122,7 @@ namespace
 					value_node = value_node->FirstNode();
 					if (value_node && (XNT_CData == value_node->Type()))
 					{
-						std::string value_str = value_node->ValueString();
-						std::vector<std::string> strs;
-						boost::algorithm::split(strs, value_str, boost::is_any_of(","));
-						std::vector<int3> init_val(std::min(array_size, static_cast<uint32_t>((strs.size() + 2) / 3)), int3(0, 0, 0));
-						for (size_t index = 0; index < init_val.size(); ++ index)
-						{
-							for (size_t j = 0; j < 3; ++ j)
-							{
-								if (index * 3 + j < strs.size())
-								{
-									boost::algorithm::trim(strs[index * 3 + j]);
-									init_val[index][j] = boost::lexical_cast<int32_t>(strs[index * 3 + j]);
-								}
-							}
-						}
-						*var = init_val;
+						*var = read_array_value<int32_t, int3>(*value_node, array_size);
 					}
 				}
 			}
@@ -1277,26 +1132,10 @@ namespace
 			if (0 == array_size)
 			{
 				int4 tmp(0, 0, 0, 0);
-				attr = node->Attrib("x");
-				if (attr)
-				{
-					tmp.x() = attr->ValueInt();
-				}
-				attr = node->Attrib("y");
-				if (attr)
-				{
-					tmp.y() = attr->ValueInt();
-				}
-				attr = node->Attrib("z");
-				if (attr)
-				{
-					tmp.z() = attr->ValueInt();
-				}
-				attr = node->Attrib("w");
-				if (attr)
-				{
-					tmp.w() = attr->ValueInt();
-				}
+				tmp.x() = node->AttribInt("x", 0);
+				tmp.y() = node->AttribInt("y", 0);
+				tmp.z() = node->AttribInt("z", 0);
+				tmp.w() = node->AttribInt("w", 0);
 
 				var = MakeUniquePtr<RenderVariableInt4>();
 				*var = tmp;
@@ -1311,22 +1150,7 @@ namespace
 					value_node = value_node->FirstNode();
 					if (value_node && (XNT_CData == value_node->Type()))
 					{
-						std::string value_str = value_node->ValueString();
-						std::vector<std::string> strs;
-						boost::algorithm::split(strs, value_str, boost::is_any_of(","));
-						std::vector<int4> init_val(std::min(array_size, static_cast<uint32_t>((strs.size() + 3) / 4)), int4(0, 0, 0, 0));
-						for (size_t index = 0; index < init_val.size(); ++ index)
-						{
-							for (size_t j = 0; j < 4; ++ j)
-							{
-								if (index * 4 + j < strs.size())
-								{
-									boost::algorithm::trim(strs[index * 4 + j]);
-									init_val[index][j] = boost::lexical_cast<int32_t>(strs[index * 4 + j]);
-								}
-							}
-						}
-						*var = init_val;
+						*var = read_array_value<int32_t, int4>(*value_node, array_size);
 					}
 				}
 			}
@@ -1336,16 +1160,8 @@ namespace
 			if (0 == array_size)
 			{
 				float2 tmp(0, 0);
-				attr = node->Attrib("x");
-				if (attr)
-				{
-					tmp.x() = attr->ValueFloat();
-				}
-				attr = node->Attrib("y");
-				if (attr)
-				{
-					tmp.y() = attr->ValueFloat();
-				}
+				tmp.x() = node->AttribFloat("x", 0);
+				tmp.y() = node->AttribFloat("y", 0);
 
 				var = MakeUniquePtr<RenderVariableFloat2>();
 				*var = tmp;
@@ -1360,22 +1176,7 @@ namespace
 					value_node = value_node->FirstNode();
 					if (value_node && (XNT_CData == value_node->Type()))
 					{
-						std::string value_str = value_node->ValueString();
-						std::vector<std::string> strs;
-						boost::algorithm::split(strs, value_str, boost::is_any_of(","));
-						std::vector<float2> init_val(std::min(array_size, static_cast<uint32_t>((strs.size() + 1) / 2)), float2(0, 0));
-						for (size_t index = 0; index < init_val.size(); ++ index)
-						{
-							for (size_t j = 0; j < 2; ++ j)
-							{
-								if (index * 2 + j < strs.size())
-								{
-									boost::algorithm::trim(strs[index * 2 + j]);
-									init_val[index][j] = boost::lexical_cast<float>(strs[index * 2 + j]);
-								}
-							}
-						}
-						*var = init_val;
+						*var = read_array_value<float, float2>(*value_node, array_size);
 					}
 				}
 			}
@@ -1385,21 +1186,9 @@ namespace
 			if (0 == array_size)
 			{
 				float3 tmp(0, 0, 0);
-				attr = node->Attrib("x");
-				if (attr)
-				{
-					tmp.x() = attr->ValueFloat();
-				}
-				attr = node->Attrib("y");
-				if (attr)
-				{
-					tmp.y() = attr->ValueFloat();
-				}
-				attr = node->Attrib("z");
-				if (attr)
-				{
-					tmp.z() = attr->ValueFloat();
-				}
+				tmp.x() = node->AttribFloat("x", 0);
+				tmp.y() = node->AttribFloat("y", 0);
+				tmp.z() = node->AttribFloat("z", 0);
 
 				var = MakeUniquePtr<RenderVariableFloat3>();
 				*var = tmp;
@@ -1414,22 +1203,7 @@ namespace
 					value_node = value_node->FirstNode();
 					if (value_node && (XNT_CData == value_node->Type()))
 					{
-						std::string value_str = value_node->ValueString();
-						std::vector<std::string> strs;
-						boost::algorithm::split(strs, value_str, boost::is_any_of(","));
-						std::vector<float3> init_val(std::min(array_size, static_cast<uint32_t>((strs.size() + 2) / 3)), float3(0, 0, 0));
-						for (size_t index = 0; index < init_val.size(); ++ index)
-						{
-							for (size_t j = 0; j < 3; ++ j)
-							{
-								if (index * 3 + j < strs.size())
-								{
-									boost::algorithm::trim(strs[index * 3 + j]);
-									init_val[index][j] = boost::lexical_cast<float>(strs[index * 3 + j]);
-								}
-							}
-						}
-						*var = init_val;
+						*var = read_array_value<float, float3>(*value_node, array_size);
 					}
 				}
 			}
@@ -1439,26 +1213,10 @@ namespace
 			if (0 == array_size)
 			{
 				float4 tmp(0, 0, 0, 0);
-				attr = node->Attrib("x");
-				if (attr)
-				{
-					tmp.x() = attr->ValueFloat();
-				}
-				attr = node->Attrib("y");
-				if (attr)
-				{
-					tmp.y() = attr->ValueFloat();
-				}
-				attr = node->Attrib("z");
-				if (attr)
-				{
-					tmp.z() = attr->ValueFloat();
-				}
-				attr = node->Attrib("w");
-				if (attr)
-				{
-					tmp.w() = attr->ValueFloat();
-				}
+				tmp.x() = node->AttribFloat("x", 0);
+				tmp.y() = node->AttribFloat("y", 0);
+				tmp.z() = node->AttribFloat("z", 0);
+				tmp.w() = node->AttribFloat("w", 0);
 
 				var = MakeUniquePtr<RenderVariableFloat4>();
 				*var = tmp;
@@ -1473,22 +1231,7 @@ namespace
 					value_node = value_node->FirstNode();
 					if (value_node && (XNT_CData == value_node->Type()))
 					{
-						std::string value_str = value_node->ValueString();
-						std::vector<std::string> strs;
-						boost::algorithm::split(strs, value_str, boost::is_any_of(","));
-						std::vector<float4> init_val(std::min(array_size, static_cast<uint32_t>((strs.size() + 3) / 4)), float4(0, 0, 0, 0));
-						for (size_t index = 0; index < init_val.size(); ++ index)
-						{
-							for (size_t j = 0; j < 4; ++ j)
-							{
-								if (index * 4 + j < strs.size())
-								{
-									boost::algorithm::trim(strs[index * 4 + j]);
-									init_val[index][j] = boost::lexical_cast<float>(strs[index * 4 + j]);
-								}
-							}
-						}
-						*var = init_val;
+						*var = read_array_value<float, float4>(*value_node, array_size);
 					}
 				}
 			}
@@ -1502,12 +1245,8 @@ namespace
 				{
 					for (int x = 0; x < 4; ++ x)
 					{
-						attr = node->Attrib(std::string("_")
-							+ static_cast<char>('0' + y) + static_cast<char>('0' + x));
-						if (attr)
-						{
-							tmp[y * 4 + x] = attr->ValueFloat();
-						}
+						tmp[y * 4 + x] = node->AttribFloat(std::string("_")
+							+ static_cast<char>('0' + y) + static_cast<char>('0' + x), 0);
 					}
 				}
 
@@ -1524,22 +1263,7 @@ namespace
 					value_node = value_node->FirstNode();
 					if (value_node && (XNT_CData == value_node->Type()))
 					{
-						std::string value_str = value_node->ValueString();
-						std::vector<std::string> strs;
-						boost::algorithm::split(strs, value_str, boost::is_any_of(","));
-						std::vector<float4> init_val(std::min(array_size, static_cast<uint32_t>((strs.size() + 3) / 4)), float4(0, 0, 0, 0));
-						for (size_t index = 0; index < init_val.size(); ++ index)
-						{
-							for (size_t j = 0; j < 16; ++ j)
-							{
-								if (index * 16 + j < strs.size())
-								{
-									boost::algorithm::trim(strs[index * 16 + j]);
-									init_val[index][j] = boost::lexical_cast<float>(strs[index * 16 + j]);
-								}
-							}
-						}
-						*var = init_val;
+						*var = read_array_value<float, float4x4>(*value_node, array_size);
 					}
 				}
 			}
@@ -2647,6 +2371,28 @@ namespace
 		}
 	}
 #endif
+
+	// Dirty ranges of a constant buffer closer than this are uploaded as one. One float4 register.
+	uint32_t const CBUFFER_RANGE_MERGE_GAP = 16;
+	// Above this the ranges are collapsed into one, to bound the number of upload calls
+	size_t const MAX_CBUFFER_DIRTY_RANGES = 8;
+
+	// What RenderEffectConstantBuffer::Update uploaded, and what uploading whole buffers would have been
+	struct CBufferCounters
+	{
+		PerfCounterPtr uploaded_bytes;
+		PerfCounterPtr full_upload_bytes;
+
+		static CBufferCounters const & Instance()
+		{
+			static CBufferCounters const counters =
+			{
+				PerfProfiler::Instance().CreatePerfCounter(0, "CBuffer uploaded bytes"),
+				PerfProfiler::Instance().CreatePerfCounter(0, "CBuffer full upload bytes")
+			};
+			return counters;
+		}
+	};
 }
 
 namespace KlayGE
@@ -2658,13 +2404,14 @@ namespace KlayGE
 		{
 			std::string res_name;
 
-			RenderEffectPtr effect;
+			std::shared_ptr<RenderEffectPtr> effect;
 		};
 
 	public:
 		explicit EffectLoadingDesc(std::string const & name)
 		{
 			effect_desc_.res_name = name;
+			effect_desc_.effect = MakeSharedPtr<RenderEffectPtr>();
 		}
 
 		uint64_t Type() const
@@ -2678,20 +2425,50 @@ namespace KlayGE
 			return false;
 		}
 
+		virtual std::shared_ptr<void> CreateResource() override
+		{
+			RenderEffectPtr effect = MakeSharedPtr<RenderEffect>();
+			*effect_desc_.effect = effect;
+			return effect;
+		}
+
 		void SubThreadStage()
 		{
+			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+			RenderDeviceCaps const & caps = rf.RenderEngineInstance().DeviceCaps();
+			if (caps.multithread_res_creating_support)
+			{
+				this->MainThreadStage();
+			}
+			else
+			{
+				// Without multithreaded resource creation (OpenGL), the file reading and parsing still happen here.
+				// Only creating the parameters, techniques and shaders waits for the main thread.
+				std::lock_guard<std::mutex> lock(main_thread_stage_mutex_);
+
+				RenderEffectPtr const & effect = *effect_desc_.effect;
+				if (!effect->HWResourceReady())
+				{
+					effect->PreLoad(effect_desc_.res_name);
+				}
+			}
 		}
 
 		std::shared_ptr<void> MainThreadStage()
 		{
-			effect_desc_.effect = MakeSharedPtr<RenderEffect>();
-			effect_desc_.effect->Load(effect_desc_.res_name);
-			return std::static_pointer_cast<void>(effect_desc_.effect);
+			std::lock_guard<std::mutex> lock(main_thread_stage_mutex_);
+
+			RenderEffectPtr const & effect = *effect_desc_.effect;
+			if (!effect->HWResourceReady())
+			{
+				effect->Load(effect_desc_.res_name);
+			}
+			return std::static_pointer_cast<void>(effect);
 		}
 
 		bool HasSubThreadStage() const
 		{
-			return false;
+			return true;
 		}
 
 		bool Match(ResLoadingDesc const & rhs) const
@@ -2710,21 +2487,23 @@ namespace KlayGE
 
 			EffectLoadingDesc const & eld = static_cast<EffectLoadingDesc const &>(rhs);
 			effect_desc_.res_name = eld.effect_desc_.res_name;
+			effect_desc_.effect = eld.effect_desc_.effect;
 		}
 
 		std::shared_ptr<void> CloneResourceFrom(std::shared_ptr<void> const & resource)
 		{
-			effect_desc_.effect = std::static_pointer_cast<RenderEffect>(resource)->Clone();
-			return std::static_pointer_cast<void>(effect_desc_.effect);
+			*effect_desc_.effect = std::static_pointer_cast<RenderEffect>(resource)->Clone();
+			return std::static_pointer_cast<void>(*effect_desc_.effect);
 		}
 
 		virtual std::shared_ptr<void> Resource() const override
 		{
-			return effect_desc_.effect;
+			return *effect_desc_.effect;
 		}
 
 	private:
 		EffectDesc effect_desc_;
+		std::mutex main_thread_stage_mutex_;
 	};
 
 
@@ -2756,10 +2535,26 @@ namespace KlayGE
 #endif
 
 
-	void RenderEffect::Load(std::string const & name)
+	RenderEffect::RenderEffect()
+		: hw_res_ready_(false)
+	{
+	}
+
+	void RenderEffect::PreLoad(std::string const & name)
 	{
 		effect_template_ = MakeSharedPtr<RenderEffectTemplate>();
+		effect_template_->PreLoad(name);
+	}
+
+	void RenderEffect::Load(std::string const & name)
+	{
+		if (!effect_template_ || !effect_template_->PreLoaded())
+		{
+			effect_template_ = MakeSharedPtr<RenderEffectTemplate>();
+		}
 		effect_template_->Load(name, *this);
+
+		hw_res_ready_ = true;
 	}
 
 	RenderEffectPtr RenderEffect::Clone()
@@ -2767,6 +2562,7 @@ namespace KlayGE
 		RenderEffectPtr ret = MakeSharedPtr<RenderEffect>();
 
 		ret->effect_template_ = effect_template_;
+		ret->hw_res_ready_ = hw_res_ready_;
 
 		ret->params_.resize(params_.size());
 		for (size_t i = 0; i < params_.size(); ++ i)
@@ -2801,41 +2597,30 @@ namespace KlayGE
 
 	RenderEffectParameter* RenderEffect::ParameterByName(std::string const & name) const
 	{
-		size_t const name_hash = HashRange(name.begin(), name.end());
-		for (auto const & param : params_)
-		{
-			if (name_hash == param->NameHash())
-			{
-				return param.get();
-			}
-		}
-		return nullptr;
+		uint32_t const index = this->ParameterIndexByName(name);
+		return (index != INVALID_INDEX) ? params_[index].get() : nullptr;
+	}
+
+	uint32_t RenderEffect::ParameterIndexByName(std::string const & name) const
+	{
+		return effect_template_->ParameterIndexByNameHash(HashRange(name.begin(), name.end()));
 	}
 
 	RenderEffectParameter* RenderEffect::ParameterBySemantic(std::string const & semantic) const
 	{
-		size_t const semantic_hash = HashRange(semantic.begin(), semantic.end());
-		for (auto const & param : params_)
-		{
-			if (semantic_hash == param->SemanticHash())
-			{
-				return param.get();
-			}
-		}
-		return nullptr;
+		uint32_t const index = effect_template_->ParameterIndexBySemanticHash(HashRange(semantic.begin(), semantic.end()));
+		return (index != INVALID_INDEX) ? params_[index].get() : nullptr;
 	}
 
 	RenderEffectConstantBuffer* RenderEffect::CBufferByName(std::string const & name) const
 	{
-		size_t const name_hash = HashRange(name.begin(), name.end());
-		for (auto const & cbuffer : cbuffers_)
-		{
-			if (name_hash == cbuffer->NameHash())
-			{
-				return cbuffer.get();
-			}
-		}
-		return nullptr;
+		uint32_t const index = this->CBufferIndexByName(name);
+		return (index != INVALID_INDEX) ? cbuffers_[index].get() : nullptr;
+	}
+
+	uint32_t RenderEffect::CBufferIndexByName(std::string const & name) const
+	{
+		return effect_template_->CBufferIndexByNameHash(HashRange(name.begin(), name.end()));
 	}
 
 	uint32_t RenderEffect::NumTechniques() const
@@ -2918,9 +2703,8 @@ namespace KlayGE
 
 			std::string include_name = attr->ValueString();
 
-			XMLDocument include_doc;
-			XMLNodePtr include_root = include_doc.Parse(ResLoader::Instance().Open(include_name));
-			this->RecursiveIncludeNode(*include_root, include_names);
+			auto include_doc = LoadIncludeDoc(include_name);
+			this->RecursiveIncludeNode(*include_doc->root, include_names);
 
 			bool found = false;
 			for (size_t i = 0; i < include_names.size(); ++ i)
@@ -2952,37 +2736,59 @@ namespace KlayGE
 	}
 #endif
 
-	void RenderEffectTemplate::Load(std::string const & name, RenderEffect& effect)
+	RenderEffectTemplate::RenderEffectTemplate()
+		: preloaded_(false)
+	{
+	}
+
+	RenderEffectTemplate::~RenderEffectTemplate()
+	{
+	}
+
+	void RenderEffectTemplate::PreLoad(std::string const & name)
 	{
 		std::string fxml_name = ResLoader::Instance().Locate(name);
 		if (fxml_name.empty())
 		{
 			fxml_name = name;
 		}
-		std::string kfx_name = fxml_name.substr(0, fxml_name.rfind(".")) + ".kfx";
+		kfx_name_ = fxml_name.substr(0, fxml_name.rfind(".")) + ".kfx";
 
 #if KLAYGE_IS_DEV_PLATFORM
 		ResIdentifierPtr source = ResLoader::Instance().Open(fxml_name);
 #endif
-		ResIdentifierPtr kfx_source = ResLoader::Instance().Open(kfx_name);
 
-#if KLAYGE_IS_DEV_PLATFORM
-		std::unique_ptr<XMLDocument> doc;
-		XMLNodePtr root;
-#endif
+		// Read completely, so Load doesn't touch the file system
+		kfx_source_.reset();
+		ResIdentifierPtr kfx_source = ResLoader::Instance().Open(kfx_name_);
+		if (kfx_source)
+		{
+			kfx_source->seekg(0, std::ios_base::end);
+			std::string content(static_cast<size_t>(kfx_source->tellg()), '\0');
+			kfx_source->seekg(0, std::ios_base::beg);
+			if (!content.empty())
+			{
+				kfx_source->read(&content[0], content.size());
+			}
+			kfx_source_ = MakeSharedPtr<ResIdentifier>(kfx_source->ResName(), kfx_source->Timestamp(),
+				MakeSharedPtr<std::stringstream>(std::move(content)));
+		}
 
 		res_name_ = fxml_name;
 		res_name_hash_ = HashRange(fxml_name.begin(), fxml_name.end());
 #if KLAYGE_IS_DEV_PLATFORM
+		doc_.reset();
+		root_.reset();
 		if (source)
 		{
 			timestamp_ = source->Timestamp();
 
-			doc = MakeUniquePtr<XMLDocument>();
-			root = doc->Parse(source);
+			doc_ = MakeUniquePtr<XMLDocument>();
+			root_ = doc_->Parse(source);
 
+			// Parses the includes into the shared cache too
 			std::vector<std::string> include_names;
-			this->RecursiveIncludeNode(*root, include_names);
+			this->RecursiveIncludeNode(*root_, include_names);
 
 			for (auto const & include_name : include_names)
 			{
@@ -2999,10 +2805,28 @@ namespace KlayGE
 		}
 #endif
 
+		preloaded_ = true;
+	}
+
+	void RenderEffectTemplate::Load(std::string const & name, RenderEffect& effect)
+	{
+		if (!preloaded_)
+		{
+			this->PreLoad(name);
+		}
+		preloaded_ = false;
+
+		std::string const kfx_name = std::move(kfx_name_);
+		ResIdentifierPtr const kfx_source = std::move(kfx_source_);
+#if KLAYGE_IS_DEV_PLATFORM
+		std::unique_ptr<XMLDocument> const doc = std::move(doc_);
+		XMLNodePtr const root = std::move(root_);
+#endif
+
 		if (!this->StreamIn(kfx_source, effect))
 		{
 #if KLAYGE_IS_DEV_PLATFORM
-			if (source)
+			if (root)
 			{
 				effect.params_.clear();
 				effect.cbuffers_.clear();
@@ -3017,7 +2841,7 @@ namespace KlayGE
 
 				XMLAttributePtr attr;
 
-				std::vector<std::unique_ptr<XMLDocument>> include_docs;
+				std::vector<std::shared_ptr<IncludeDoc const>> include_docs;
 				std::vector<std::string> whole_include_names;
 				for (XMLNodePtr node = root->FirstNode("include"); node;)
 				{
@@ -3025,8 +2849,8 @@ namespace KlayGE
 					BOOST_ASSERT(attr);
 					std::string include_name = attr->ValueString();
 
-					include_docs.push_back(MakeUniquePtr<XMLDocument>());
-					XMLNodePtr include_root = include_docs.back()->Parse(ResLoader::Instance().Open(include_name));
+					include_docs.push_back(LoadIncludeDoc(include_name));
+					XMLNodePtr const & include_root = include_docs.back()->root;
 
 					std::vector<std::string> include_names;
 					this->RecursiveIncludeNode(*include_root, include_names);
@@ -3051,8 +2875,8 @@ namespace KlayGE
 							}
 							else
 							{
-								include_docs.push_back(MakeUniquePtr<XMLDocument>());
-								XMLNodePtr recursive_include_root = include_docs.back()->Parse(ResLoader::Instance().Open(*iter));
+								include_docs.push_back(LoadIncludeDoc(*iter));
+								XMLNodePtr const & recursive_include_root = include_docs.back()->root;
 								this->InsertIncludeNodes(*doc, *root, node, *recursive_include_root);
 
 								whole_include_names.push_back(*iter);
@@ -3158,6 +2982,8 @@ namespace KlayGE
 					effect.params_.back()->Load(node);
 				}
 
+				this->BuildIndices(effect);
+
 				for (XMLNodePtr shader_node = root->FirstNode("shader"); shader_node; shader_node = shader_node->NextSibling("shader"))
 				{
 					shader_frags_.push_back(RenderShaderFragment());
@@ -3263,6 +3089,8 @@ namespace KlayGE
 							}
 						}
 
+						this->BuildIndices(effect);
+
 						{
 							uint16_t num_shader_frags;
 							source->read(&num_shader_frags, sizeof(num_shader_frags));
@@ -3454,6 +3282,42 @@ namespace KlayGE
 		return nullptr;
 	}
 
+	void RenderEffectTemplate::BuildIndices(RenderEffect const & effect)
+	{
+		param_name_indices_.clear();
+		param_semantic_indices_.clear();
+		cbuffer_name_indices_.clear();
+
+		// emplace keeps the first one, which is what a linear search would find on hash collisions
+		for (uint32_t i = 0; i < effect.params_.size(); ++ i)
+		{
+			param_name_indices_.emplace(effect.params_[i]->NameHash(), i);
+			param_semantic_indices_.emplace(effect.params_[i]->SemanticHash(), i);
+		}
+		for (uint32_t i = 0; i < effect.cbuffers_.size(); ++ i)
+		{
+			cbuffer_name_indices_.emplace(effect.cbuffers_[i]->NameHash(), i);
+		}
+	}
+
+	uint32_t RenderEffectTemplate::ParameterIndexByNameHash(size_t name_hash) const
+	{
+		auto iter = param_name_indices_.find(name_hash);
+		return (iter != param_name_indices_.end()) ? iter->second : RenderEffect::INVALID_INDEX;
+	}
+
+	uint32_t RenderEffectTemplate::ParameterIndexBySemanticHash(size_t semantic_hash) const
+	{
+		auto iter = param_semantic_indices_.find(semantic_hash);
+		return (iter != param_semantic_indices_.end()) ? iter->second : RenderEffect::INVALID_INDEX;
+	}
+
+	uint32_t RenderEffectTemplate::CBufferIndexByNameHash(size_t name_hash) const
+	{
+		auto iter = cbuffer_name_indices_.find(name_hash);
+		return (iter != cbuffer_name_indices_.end()) ? iter->second : RenderEffect::INVALID_INDEX;
+	}
+
 	uint32_t RenderEffectTemplate::AddShaderDesc(ShaderDesc const & sd)
 	{
 		for (uint32_t i = 0; i < shader_descs_.size(); ++ i)
@@ -4911,16 +4775,100 @@ namespace KlayGE
 			}
 		}
 
-		dirty_ = true;
+		this->Dirty(true);
+	}
+
+	void RenderEffectConstantBuffer::Dirty(bool dirty)
+	{
+		dirty_ranges_.clear();
+		if (dirty && !buff_.empty())
+		{
+			dirty_ranges_.emplace_back(0, static_cast<uint32_t>(buff_.size()));
+		}
+	}
+
+	void RenderEffectConstantBuffer::Dirty(uint32_t offset, uint32_t size)
+	{
+		if (0 == size)
+		{
+			return;
+		}
+
+		uint32_t begin = offset;
+		uint32_t end = offset + size;
+
+		// The first range that ends close enough to be merged
+		auto first = std::lower_bound(dirty_ranges_.begin(), dirty_ranges_.end(), begin,
+			[](std::pair<uint32_t, uint32_t> const & range, uint32_t value)
+			{
+				return range.second + CBUFFER_RANGE_MERGE_GAP < value;
+			});
+		auto last = first;
+		while ((last != dirty_ranges_.end()) && (last->first <= end + CBUFFER_RANGE_MERGE_GAP))
+		{
+			begin = std::min(begin, last->first);
+			end = std::max(end, last->second);
+			++ last;
+		}
+
+		if (first == last)
+		{
+			dirty_ranges_.emplace(first, begin, end);
+		}
+		else
+		{
+			first->first = begin;
+			first->second = end;
+			dirty_ranges_.erase(first + 1, last);
+		}
+
+		if (dirty_ranges_.size() > MAX_CBUFFER_DIRTY_RANGES)
+		{
+			dirty_ranges_.front().second = dirty_ranges_.back().second;
+			dirty_ranges_.resize(1);
+		}
+	}
+
+	uint32_t RenderEffectConstantBuffer::DirtyBytes() const
+	{
+		uint32_t bytes = 0;
+		for (auto const & range : dirty_ranges_)
+		{
+			bytes += range.second - range.first;
+		}
+		return bytes;
 	}
 
 	void RenderEffectConstantBuffer::Update()
 	{
-		if (dirty_)
+		if (!dirty_ranges_.empty())
 		{
-			hw_buff_->UpdateSubresource(0, static_cast<uint32_t>(buff_.size()), &buff_[0]);
+			uint32_t const buff_size = static_cast<uint32_t>(buff_.size());
+			uint32_t uploaded = 0;
 
-			dirty_ = false;
+			auto const & caps = Context::Instance().RenderFactoryInstance().RenderEngineInstance().DeviceCaps();
+			if (caps.partial_cbuffer_update_support)
+			{
+				for (auto const & range : dirty_ranges_)
+				{
+					uint32_t const end = std::min(range.second, buff_size);
+					if (range.first < end)
+					{
+						hw_buff_->UpdateSubresource(range.first, end - range.first, &buff_[range.first]);
+						uploaded += end - range.first;
+					}
+				}
+			}
+			else
+			{
+				hw_buff_->UpdateSubresource(0, buff_size, &buff_[0]);
+				uploaded = buff_size;
+			}
+
+			CBufferCounters::Instance().uploaded_bytes->Add(uploaded);
+			CBufferCounters::Instance().full_upload_bytes->Add(buff_size);
+
+			dirty_ranges_.clear();
 		}
 	}
 
@@ -5690,12 +5638,24 @@ namespace KlayGE
 			float4x4* target = data_.cbuff_desc.cbuff->VariableInBuff<float4x4>(data_.cbuff_desc.offset);
 
 			size_ = static_cast<uint32_t>(value.size());
-			for (size_t i = 0; i < value.size(); ++ i)
+			uint32_t first_changed = size_;
+			uint32_t last_changed = 0;
+			for (uint32_t i = 0; i < size_; ++ i)
 			{
-				target[i] = MathLib::transpose(value[i]);
+				float4x4 const transposed = MathLib::transpose(value[i]);
+				if (target[i] != transposed)
+				{
+					target[i] = transposed;
+					first_changed = std::min(first_changed, i);
+					last_changed = i;
+				}
 			}
 
-			data_.cbuff_desc.cbuff->Dirty(true);
+			if (first_changed < size_)
+			{
+				data_.cbuff_desc.cbuff->Dirty(data_.cbuff_desc.offset + first_changed * sizeof(float4x4),
+					(last_changed - first_changed + 1) * sizeof(float4x4));
+			}
 		}
 		else
 		{
@@ -5862,7 +5822,6 @@ namespace KlayGE
 
 	RenderEffectPtr ASyncLoadRenderEffect(std::string const & effect_name)
 	{
-		// TODO: Make it really async
-		return ResLoader::Instance().SyncQueryT<RenderEffect>(MakeSharedPtr<EffectLoadingDesc>(effect_name));
+		return ResLoader::Instance().ASyncQueryT<RenderEffect>(MakeSharedPtr<EffectLoadingDesc>(effect_name));
 	}
 }
@@ -187,6 +187,14 @@ namespace KlayGE
 		Context::Instance().SceneManagerInstance().AddRenderable(this);
 	}
 
+	void Renderable::SelectDetail(FrameBuffer const & fb)
+	{
+		for (auto const & renderable : subrenderables_)
+		{
+			renderable->SelectDetail(fb);
+		}
+	}
+
 	void Renderable::Render()
 	{
 		this->UpdateInstanceStream();
@@ -0,0 +1,192 @@
+/**
+ * @file ShaderBinaryCache.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Hash.hpp>
+#include <KFL/Util.hpp>
+#include <KFL/CXX17/filesystem.hpp>
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <sstream>
+
+#include <KlayGE/ShaderBinaryCache.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	uint32_t const SHADER_BINARY_CACHE_FOURCC = MakeFourCC<'K', 'S', 'B', 'C'>::value;
+
+	// FNV-1a. Only has to catch damaged files, not attacks.
+	uint32_t Checksum(uint8_t const * data, size_t size)
+	{
+		uint32_t hash = 2166136261U;
+		for (size_t i = 0; i < size; ++ i)
+		{
+			hash ^= data[i];
+			hash *= 16777619U;
+		}
+		return hash;
+	}
+
+	void WriteUInt32(std::ostream& os, uint32_t v)
+	{
+		v = Native2LE(v);
+		os.write(reinterpret_cast<char const *>(&v), sizeof(v));
+	}
+
+	bool ReadUInt32(std::istream& is, uint32_t& v)
+	{
+		is.read(reinterpret_cast<char*>(&v), sizeof(v));
+		v = LE2Native(v);
+		return !is.fail();
+	}
+}
+
+namespace KlayGE
+{
+	ShaderBinaryCache::ShaderBinaryCache(std::string const & dir, uint32_t version)
+		: dir_(dir), version_(version), hits_(0), misses_(0)
+	{
+		if (!dir_.empty() && (dir_.back() != '/') && (dir_.back() != '\\'))
+		{
+			dir_ += '/';
+		}
+	}
+
+	bool ShaderBinaryCache::Load(std::string const & key, std::vector<uint8_t>& data)
+	{
+		std::string const path = this->EntryPath(key);
+
+		bool valid = false;
+		bool exists = false;
+		{
+			std::ifstream ifs(path.c_str(), std::ios_base::binary);
+			if (ifs)
+			{
+				exists = true;
+
+				uint32_t fourcc, version, key_len;
+				if (ReadUInt32(ifs, fourcc) && (SHADER_BINARY_CACHE_FOURCC == fourcc)
+					&& ReadUInt32(ifs, version) && (version_ == version)
+					&& ReadUInt32(ifs, key_len) && (key.size() == key_len))
+				{
+					std::string stored_key(key_len, '\0');
+					if (key_len > 0)
+					{
+						ifs.read(&stored_key[0], key_len);
+					}
+
+					uint32_t data_len, checksum;
+					if (!ifs.fail() && (stored_key == key)
+						&& ReadUInt32(ifs, data_len) && ReadUInt32(ifs, checksum))
+					{
+						data.resize(data_len);
+						if (data_len > 0)
+						{
+							ifs.read(reinterpret_cast<char*>(&data[0]), data_len);
+						}
+
+						// Nothing may follow the data, or the file was damaged or appended to
+						valid = !ifs.fail() && (ifs.peek() == std::char_traits<char>::eof())
+							&& (Checksum(data.empty() ? nullptr : &data[0], data.size()) == checksum);
+					}
+				}
+			}
+		}
+
+		if (valid)
+		{
+			++ hits_;
+		}
+		else
+		{
+			data.clear();
+			if (exists)
+			{
+				std::remove(path.c_str());
+			}
+			++ misses_;
+		}
+
+		return valid;
+	}
+
+	void ShaderBinaryCache::Store(std::string const & key, std::vector<uint8_t> const & data)
+	{
+		std::string const path = this->EntryPath(key);
+
+		// Written atomically, an interrupted write or a concurrent Load never sees a half written entry. The cache is
+		// optional, if it's not written the next run builds the shader again.
+		WriteFileAtomically(path, [this, &key, &data](std::string const & tmp_name)
+			{
+				std::filesystem::create_directories(std::filesystem::path(dir_));
+
+				std::ofstream ofs(tmp_name.c_str(), std::ios_base::binary);
+				WriteUInt32(ofs, SHADER_BINARY_CACHE_FOURCC);
+				WriteUInt32(ofs, version_);
+				WriteUInt32(ofs, static_cast<uint32_t>(key.size()));
+				ofs.write(key.data(), key.size());
+				WriteUInt32(ofs, static_cast<uint32_t>(data.size()));
+				WriteUInt32(ofs, Checksum(data.empty() ? nullptr : &data[0], data.size()));
+				if (!data.empty())
+				{
+					ofs.write(reinterpret_cast<char const *>(&data[0]), data.size());
+				}
+				if (!ofs)
+				{
+					throw std::ios_base::failure("Failed to write the shader binary cache");
+				}
+			});
+	}
+
+	void ShaderBinaryCache::Remove(std::string const & key)
+	{
+		std::remove(this->EntryPath(key).c_str());
+	}
+
+	void ShaderBinaryCache::ResetStatistics()
+	{
+		hits_ = 0;
+		misses_ = 0;
+	}
+
+	std::string ShaderBinaryCache::EntryPath(std::string const & key) const
+	{
+		std::ostringstream oss;
+		oss << dir_ << std::hex << std::setfill('0') << std::setw(sizeof(size_t) * 2)
+			<< HashRange(key.begin(), key.end()) << ".bin";
+		return oss.str();
+	}
+}
@@ -29,6 +29,8 @@
 */
 
 #include <KlayGE/KlayGE.hpp>
+#include <KFL/CpuInfo.hpp>
+#include <KFL/Thread.hpp>
 #include <KlayGE/Context.hpp>
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/Texture.hpp>
@@ -40,6 +42,34 @@
 
 namespace KlayGE
 {
+	void TexCompression::EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method)
+	{
+		uint32_t const in_block_size = block_width_ * block_height_ * NumFormatBytes(decoded_fmt_);
+
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		uint8_t const * src = static_cast<uint8_t const *>(input);
+		for (uint32_t i = 0; i < num_blocks; ++ i)
+		{
+			this->EncodeBlock(dst, src, method);
+			dst += block_bytes_;
+			src += in_block_size;
+		}
+	}
+
+	void TexCompression::DecodeBlocks(void* output, void const * input, uint32_t num_blocks)
+	{
+		uint32_t const out_block_size = block_width_ * block_height_ * NumFormatBytes(decoded_fmt_);
+
+		uint8_t* dst = static_cast<uint8_t*>(output);
+		uint8_t const * src = static_cast<uint8_t const *>(input);
+		for (uint32_t i = 0; i < num_blocks; ++ i)
+		{
+			this->DecodeBlock(dst, src);
+			dst += out_block_size;
+			src += block_bytes_;
+		}
+	}
+
 	void TexCompression::EncodeMem(uint32_t width, uint32_t height,
 		void* output, uint32_t out_row_pitch, uint32_t out_slice_pitch,
 		void const * input, uint32_t in_row_pitch, uint32_t in_slice_pitch,
@@ -48,37 +78,39 @@ namespace KlayGE
 		KFL_UNUSED(out_slice_pitch);
 		KFL_UNUSED(in_slice_pitch);
 
-		uint32_t const elem_size = NumFormatBytes(decoded_fmt_);
-
-		uint8_t const * src = static_cast<uint8_t const *>(input);
-
-		std::vector<uint8_t> uncompressed(block_width_ * block_height_ * elem_size);
-		for (uint32_t y_base = 0; y_base < height; y_base += block_height_)
+		uint32_t const num_block_rows = (height + block_height_ - 1) / block_height_;
+		uint32_t const num_workers = this->NumWorkers(width, height);
+		if (num_workers <= 1)
 		{
-			uint8_t* dst = static_cast<uint8_t*>(output) + (y_base / block_height_) * out_row_pitch;
+			this->EncodeBlockRows(width, height, 0, num_block_rows, output, out_row_pitch, input, in_row_pitch, method);
+		}
+		else
+		{
+			uint32_t const rows_per_band = (num_block_rows + num_workers - 1) / num_workers;
 
-			for (uint32_t x_base = 0; x_base < width; x_base += block_width_)
+			std::vector<std::unique_ptr<TexCompression>> codecs(num_workers - 1);
+			std::vector<joiner<void>> joiners(num_workers - 1);
+			for (uint32_t i = 1; i < num_workers; ++ i)
 			{
-				for (uint32_t y = 0; y < block_height_; ++ y)
-				{
-					for (uint32_t x = 0; x < block_width_; ++ x)
+				uint32_t const start_row = std::min(i * rows_per_band, num_block_rows);
+				uint32_t const end_row = std::min(start_row + rows_per_band, num_block_rows);
+
+				codecs[i - 1] = this->Clone();
+				TexCompression* codec = codecs[i - 1].get();
+				joiners[i - 1] = Context::Instance().ThreadPool()(
+					[codec, width, height, start_row, end_row, output, out_row_pitch, input, in_row_pitch, method]
 					{
-						if ((x_base + x < width) && (y_base + y < height))
-						{
-							memcpy(&uncompressed[(y * block_width_ + x) * elem_size],
-								&src[(y_base + y) * in_row_pitch + (x_base + x) * elem_size],
-								elem_size);
-						}
-						else
-						{
-							memset(&uncompressed[(y * block_width_ + x) * elem_size],
-								0, elem_size);
-						}
-					}
-				}
+						codec->EncodeBlockRows(width, height, start_row, end_row, output, out_row_pitch,
+							input, in_row_pitch, method);
+					});
+			}
 
-				this->EncodeBlock(dst, &uncompressed[0], method);
-				dst += block_bytes_;
+			this->EncodeBlockRows(width, height, 0, std::min(rows_per_band, num_block_rows), output, out_row_pitch,
+				input, in_row_pitch, method);
+
+			for (auto& worker : joiners)
+			{
+				worker();
 			}
 		}
 	}
@@ -90,30 +122,129 @@ namespace KlayGE
 		KFL_UNUSED(out_slice_pitch);
 		KFL_UNUSED(in_slice_pitch);
 
+		uint32_t const num_block_rows = (height + block_height_ - 1) / block_height_;
+		uint32_t const num_workers = this->NumWorkers(width, height);
+		if (num_workers <= 1)
+		{
+			this->DecodeBlockRows(width, height, 0, num_block_rows, output, out_row_pitch, input, in_row_pitch);
+		}
+		else
+		{
+			uint32_t const rows_per_band = (num_block_rows + num_workers - 1) / num_workers;
+
+			std::vector<std::unique_ptr<TexCompression>> codecs(num_workers - 1);
+			std::vector<joiner<void>> joiners(num_workers - 1);
+			for (uint32_t i = 1; i < num_workers; ++ i)
+			{
+				uint32_t const start_row = std::min(i * rows_per_band, num_block_rows);
+				uint32_t const end_row = std::min(start_row + rows_per_band, num_block_rows);
+
+				codecs[i - 1] = this->Clone();
+				TexCompression* codec = codecs[i - 1].get();
+				joiners[i - 1] = Context::Instance().ThreadPool()(
+					[codec, width, height, start_row, end_row, output, out_row_pitch, input, in_row_pitch]
+					{
+						codec->DecodeBlockRows(width, height, start_row, end_row, output, out_row_pitch,
+							input, in_row_pitch);
+					});
+			}
+
+			this->DecodeBlockRows(width, height, 0, std::min(rows_per_band, num_block_rows), output, out_row_pitch,
+				input, in_row_pitch);
+
+			for (auto& worker : joiners)
+			{
+				worker();
+			}
+		}
+	}
+
+	uint32_t TexCompression::NumWorkers(uint32_t width, uint32_t height) const
+	{
+		// Small images are not worth the cost of waking up the worker threads
+		uint32_t const MIN_BLOCKS_PER_WORKER = 256;
+
+		static CPUInfo const cpu;
+
+		uint32_t const num_blocks_x = (width + block_width_ - 1) / block_width_;
+		uint32_t const num_blocks_y = (height + block_height_ - 1) / block_height_;
+		uint32_t num_workers = std::min(static_cast<uint32_t>(std::max(cpu.NumHWThreads(), 1)), num_blocks_y);
+		num_workers = std::min(num_workers, num_blocks_x * num_blocks_y / MIN_BLOCKS_PER_WORKER);
+		return std::max(num_workers, 1U);
+	}
+
+	void TexCompression::EncodeBlockRows(uint32_t width, uint32_t height, uint32_t start_block_row, uint32_t end_block_row,
+		void* output, uint32_t out_row_pitch, void const * input, uint32_t in_row_pitch,
+		TexCompressionMethod method)
+	{
 		uint32_t const elem_size = NumFormatBytes(decoded_fmt_);
+		uint32_t const block_row_bytes = block_width_ * elem_size;
+		uint32_t const block_size = block_height_ * block_row_bytes;
+		uint32_t const num_blocks_x = (width + block_width_ - 1) / block_width_;
+		bool const partial_x = (width % block_width_ != 0);
 
-		uint8_t * dst = static_cast<uint8_t*>(output);
+		uint8_t const * src = static_cast<uint8_t const *>(input);
 
-		std::vector<uint8_t> uncompressed(block_width_ * block_height_ * elem_size);
-		for (uint32_t y_base = 0; y_base < height; y_base += block_height_)
+		std::vector<uint8_t> uncompressed(num_blocks_x * block_size);
+		for (uint32_t block_y = start_block_row; block_y < end_block_row; ++ block_y)
 		{
-			uint8_t const * src = static_cast<uint8_t const *>(input) + in_row_pitch * (y_base / block_height_);
-
+			uint32_t const y_base = block_y * block_height_;
 			uint32_t const block_h = std::min(block_height_, height - y_base);
-			for (uint32_t x_base = 0; x_base < width; x_base += block_width_)
+			if (partial_x || (block_h < block_height_))
 			{
-				uint32_t const block_w = std::min(block_width_, width - x_base);
+				memset(&uncompressed[0], 0, uncompressed.size());
+			}
 
-				this->DecodeBlock(&uncompressed[0], src);
-				src += block_bytes_;
+			for (uint32_t block_x = 0; block_x < num_blocks_x; ++ block_x)
+			{
+				uint32_t const x_base = block_x * block_width_;
+				uint32_t const copy_bytes = std::min(block_width_, width - x_base) * elem_size;
 
+				uint8_t* block = &uncompressed[block_x * block_size];
+				uint8_t const * block_src = src + y_base * in_row_pitch + x_base * elem_size;
 				for (uint32_t y = 0; y < block_h; ++ y)
 				{
-					for (uint32_t x = 0; x < block_w; ++ x)
-					{
-						memcpy(&dst[(y_base + y) * out_row_pitch + (x_base + x) * elem_size],
-							&uncompressed[(y * block_width_ + x) * elem_size], elem_size);
-					}
+					memcpy(block, block_src, copy_bytes);
+					block += block_row_bytes;
+					block_src += in_row_pitch;
+				}
+			}
+
+			this->EncodeBlocks(static_cast<uint8_t*>(output) + block_y * out_row_pitch, &uncompressed[0],
+				num_blocks_x, method);
+		}
+	}
+
+	void TexCompression::DecodeBlockRows(uint32_t width, uint32_t height, uint32_t start_block_row, uint32_t end_block_row,
+		void* output, uint32_t out_row_pitch, void const * input, uint32_t in_row_pitch)
+	{
+		uint32_t const elem_size = NumFormatBytes(decoded_fmt_);
+		uint32_t const block_row_bytes = block_width_ * elem_size;
+		uint32_t const block_size = block_height_ * block_row_bytes;
+		uint32_t const num_blocks_x = (width + block_width_ - 1) / block_width_;
+
+		uint8_t* dst = static_cast<uint8_t*>(output);
+
+		std::vector<uint8_t> uncompressed(num_blocks_x * block_size);
+		for (uint32_t block_y = start_block_row; block_y < end_block_row; ++ block_y)
+		{
+			this->DecodeBlocks(&uncompressed[0], static_cast<uint8_t const *>(input) + block_y * in_row_pitch,
+				num_blocks_x);
+
+			uint32_t const y_base = block_y * block_height_;
+			uint32_t const block_h = std::min(block_height_, height - y_base);
+			for (uint32_t block_x = 0; block_x < num_blocks_x; ++ block_x)
+			{
+				uint32_t const x_base = block_x * block_width_;
+				uint32_t const copy_bytes = std::min(block_width_, width - x_base) * elem_size;
+
+				uint8_t const * block = &uncompressed[block_x * block_size];
+				uint8_t* block_dst = dst + y_base * out_row_pitch + x_base * elem_size;
+				for (uint32_t y = 0; y < block_h; ++ y)
+				{
+					memcpy(block_dst, block, copy_bytes);
+					block += block_row_bytes;
+					block_dst += out_row_pitch;
 				}
 			}
 		}
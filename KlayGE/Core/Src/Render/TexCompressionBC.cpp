@@ -38,7 +38,9 @@
 #include <KFL/Half.hpp>
 
 #include <vector>
+#include <algorithm>
 #include <cstring>
+#include <limits>
 #include <boost/assert.hpp>
 #ifdef KLAYGE_COMPILER_MSVC
 	#include <intrin.h>		// For _BitScanForward
@@ -310,6 +312,25 @@ namespace
 		f16.z() = Int2F16(clr.z(), signed_fmt);
 	}
 
+	int F162Int(uint16_t input, bool signed_fmt)
+	{
+		int out;
+		if (signed_fmt)
+		{
+			out = std::min(input & 0x7FFF, 0x7BFF);
+			if (input & 0x8000)
+			{
+				out = -out;
+			}
+		}
+		else
+		{
+			// Negative values can't be represented in unsigned BC6H
+			out = (input & 0x8000) ? 0 : std::min<int>(input, 0x7BFF);
+		}
+		return out;
+	}
+
 	void TransformInverse(std::pair<int3, int3>* end_pts, ARGBColor32 const & prec, bool signed_fmt)
 	{
 		int3 wrap_mask((1 << prec.r()) - 1, (1 << prec.g()) - 1, (1 << prec.b()) - 1);
@@ -894,6 +915,11 @@ namespace KlayGE
 		decoded_fmt_ = EF_ARGB8;
 	}
 
+	std::unique_ptr<TexCompression> TexCompressionBC1::Clone() const
+	{
+		return MakeUniquePtr<TexCompressionBC1>();
+	}
+
 	void TexCompressionBC1::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
 		BOOST_ASSERT(output);
@@ -963,6 +989,27 @@ namespace KlayGE
 		}
 	}
 
+	// Qualified calls bypass the virtual dispatch, so the per-block work is inlined into one loop over the row
+	void TexCompressionBC1::EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method)
+	{
+		BC1Block* bc1 = static_cast<BC1Block*>(output);
+		ARGBColor32 const * argb = static_cast<ARGBColor32 const *>(input);
+		for (uint32_t i = 0; i < num_blocks; ++ i, ++ bc1, argb += 16)
+		{
+			this->TexCompressionBC1::EncodeBlock(bc1, argb, method);
+		}
+	}
+
+	void TexCompressionBC1::DecodeBlocks(void* output, void const * input, uint32_t num_blocks)
+	{
+		ARGBColor32* argb = static_cast<ARGBColor32*>(output);
+		BC1Block const * bc1 = static_cast<BC1Block const *>(input);
+		for (uint32_t i = 0; i < num_blocks; ++ i, argb += 16, ++ bc1)
+		{
+			this->TexCompressionBC1::DecodeBlock(argb, bc1);
+		}
+	}
+
 	ARGBColor32 TexCompressionBC1::RGB565To888(uint16_t rgb) const
 	{
 		return ARGBColor32(255, EXPAND5[(rgb >> 11) & 0x1F], EXPAND6[(rgb >> 5) & 0x3F],
@@ -1384,6 +1431,11 @@ namespace KlayGE
 		decoded_fmt_ = EF_ARGB8;
 	}
 
+	std::unique_ptr<TexCompression> TexCompressionBC2::Clone() const
+	{
+		return MakeUniquePtr<TexCompressionBC2>();
+	}
+
 	void TexCompressionBC2::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
 		BOOST_ASSERT(output);
@@ -1438,6 +1490,11 @@ namespace KlayGE
 		decoded_fmt_ = EF_ARGB8;
 	}
 
+	std::unique_ptr<TexCompression> TexCompressionBC3::Clone() const
+	{
+		return MakeUniquePtr<TexCompressionBC3>();
+	}
+
 	void TexCompressionBC3::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
 		BOOST_ASSERT(output);
@@ -1456,7 +1513,7 @@ namespace KlayGE
 		}
 
 		bc1_codec_.EncodeBC1Internal(bc3.bc1, &xrgb[0], false, method);
-		bc4_codec_.EncodeBlock(&bc3.alpha, &alpha[0], method);
+		bc4_codec_.TexCompressionBC4::EncodeBlock(&bc3.alpha, &alpha[0], method);
 	}
 
 	void TexCompressionBC3::DecodeBlock(void* output, void const * input)
@@ -1467,10 +1524,10 @@ namespace KlayGE
 		ARGBColor32* argb = static_cast<ARGBColor32*>(output);
 		BC3Block const * bc3_block = static_cast<BC3Block const *>(input);
 
-		bc1_codec_.DecodeBlock(argb, &bc3_block->bc1);
+		bc1_codec_.TexCompressionBC1::DecodeBlock(argb, &bc3_block->bc1);
 
 		std::array<uint8_t, 16> alpha_block;
-		bc4_codec_.DecodeBlock(&alpha_block[0], &bc3_block->alpha);
+		bc4_codec_.TexCompressionBC4::DecodeBlock(&alpha_block[0], &bc3_block->alpha);
 
 		for (size_t i = 0; i < alpha_block.size(); ++ i)
 		{
@@ -1478,6 +1535,26 @@ namespace KlayGE
 		}
 	}
 
+	void TexCompressionBC3::EncodeBlocks(void* output, void const * input, uint32_t num_blocks, TexCompressionMethod method)
+	{
+		BC3Block* bc3 = static_cast<BC3Block*>(output);
+		ARGBColor32 const * argb = static_cast<ARGBColor32 const *>(input);
+		for (uint32_t i = 0; i < num_blocks; ++ i, ++ bc3, argb += 16)
+		{
+			this->TexCompressionBC3::EncodeBlock(bc3, argb, method);
+		}
+	}
+
+	void TexCompressionBC3::DecodeBlocks(void* output, void const * input, uint32_t num_blocks)
+	{
+		ARGBColor32* argb = static_cast<ARGBColor32*>(output);
+		BC3Block const * bc3 = static_cast<BC3Block const *>(input);
+		for (uint32_t i = 0; i < num_blocks; ++ i, argb += 16, ++ bc3)
+		{
+			this->TexCompressionBC3::DecodeBlock(argb, bc3);
+		}
+	}
+
 
 	TexCompressionBC4::TexCompressionBC4()
 	{
@@ -1487,6 +1564,11 @@ namespace KlayGE
 		decoded_fmt_ = EF_R8;
 	}
 
+	std::unique_ptr<TexCompression> TexCompressionBC4::Clone() const
+	{
+		return MakeUniquePtr<TexCompressionBC4>();
+	}
+
 	// Alpha block compression (this is easy for a change)
 	void TexCompressionBC4::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
@@ -1596,6 +1678,11 @@ namespace KlayGE
 		decoded_fmt_ = EF_GR8;
 	}
 
+	std::unique_ptr<TexCompression> TexCompressionBC5::Clone() const
+	{
+		return MakeUniquePtr<TexCompressionBC5>();
+	}
+
 	void TexCompressionBC5::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
 		BOOST_ASSERT(output);
@@ -1899,13 +1986,14 @@ namespace KlayGE
 		decoded_fmt_ = EF_ABGR16F;
 	}
 
-	void TexCompressionBC6U::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	std::unique_ptr<TexCompression> TexCompressionBC6U::Clone() const
 	{
-		KFL_UNUSED(output);
-		KFL_UNUSED(input);
-		KFL_UNUSED(method);
+		return MakeUniquePtr<TexCompressionBC6U>();
+	}
 
-		// TODO
+	void TexCompressionBC6U::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	{
+		this->EncodeBC6Internal(output, input, method, false);
 	}
 
 	void TexCompressionBC6U::DecodeBlock(void* output, void const * input)
@@ -2072,7 +2160,125 @@ namespace KlayGE
 		}
 	}
 
-	int TexCompressionBC6U::Unquantize(int comp, uint8_t bits_per_comp, bool signed_fmt)
+	void TexCompressionBC6U::EncodeBC6Internal(void* output, void const * input, TexCompressionMethod method, bool signed_fmt)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		uint16_t const * abgr = static_cast<uint16_t const *>(input);
+
+		std::array<int3, 16> pixels;
+		for (uint32_t i = 0; i < pixels.size(); ++ i)
+		{
+			pixels[i] = int3(F162Int(abgr[i * 4 + 0], signed_fmt), F162Int(abgr[i * 4 + 1], signed_fmt),
+				F162Int(abgr[i * 4 + 2], signed_fmt));
+		}
+
+		// The number of 2-region shapes that are fully evaluated, and the number of endpoint refinement passes
+		uint32_t num_shapes;
+		int refine_iters;
+		switch (method)
+		{
+		case TCM_Speed:
+			num_shapes = 1;
+			refine_iters = 0;
+			break;
+
+		case TCM_Balanced:
+			num_shapes = 2;
+			refine_iters = 8;
+			break;
+
+		default:
+			num_shapes = 6;
+			refine_iters = 8;
+			break;
+		}
+
+		std::array<std::pair<float, uint32_t>, 32> shape_errors;
+		for (uint32_t shape = 0; shape < shape_errors.size(); ++ shape)
+		{
+			shape_errors[shape] = std::make_pair(this->RoughShapeError(&pixels[0], shape, signed_fmt), shape);
+		}
+		std::partial_sort(shape_errors.begin(), shape_errors.begin() + num_shapes, shape_errors.end());
+
+		uint64_t best_err = std::numeric_limits<uint64_t>::max();
+		uint32_t best_mode = 0;
+		uint32_t best_shape = 0;
+		std::array<std::pair<int3, int3>, BC6_MAX_REGIONS> best_end_pts;
+		std::array<uint8_t, 16> best_indices;
+
+		uint32_t const num_modes = sizeof(mode_info_) / sizeof(mode_info_[0]);
+		for (uint32_t mode_index = 0; (mode_index < num_modes) && (best_err > 0); ++ mode_index)
+		{
+			uint32_t const num_tries = (mode_info_[mode_index].partitions > 1) ? num_shapes : 1;
+			for (uint32_t s = 0; (s < num_tries) && (best_err > 0); ++ s)
+			{
+				uint32_t const shape = (mode_info_[mode_index].partitions > 1) ? shape_errors[s].second : 0;
+
+				std::array<std::pair<int3, int3>, BC6_MAX_REGIONS> end_pts;
+				std::array<uint8_t, 16> indices;
+				uint64_t const err = this->TryMode(mode_index, shape, &pixels[0], refine_iters, &end_pts[0], &indices[0],
+					signed_fmt);
+				if (err < best_err)
+				{
+					best_err = err;
+					best_mode = mode_index;
+					best_shape = shape;
+					best_end_pts = end_pts;
+					best_indices = indices;
+				}
+			}
+		}
+
+		// Untransformed modes always fit, so there is a valid candidate
+		BOOST_ASSERT(best_err != std::numeric_limits<uint64_t>::max());
+
+		this->PackBC6Block(output, best_mode, best_shape, &best_end_pts[0], &best_indices[0]);
+	}
+
+	int TexCompressionBC6U::Quantize(int comp, uint8_t bits_per_comp, bool signed_fmt) const
+	{
+		int q;
+		if (signed_fmt)
+		{
+			int s = 0;
+			if (comp < 0)
+			{
+				s = 1;
+				comp = -comp;
+			}
+
+			if (bits_per_comp >= 16)
+			{
+				q = std::min((comp * 32 + 15) / 31, 0x7FFF);
+			}
+			else
+			{
+				q = std::min((comp << (bits_per_comp - 1)) / (0x7BFF + 1), (1 << (bits_per_comp - 1)) - 1);
+			}
+
+			if (s)
+			{
+				q = -q;
+			}
+		}
+		else
+		{
+			if (bits_per_comp >= 15)
+			{
+				q = std::min((comp * 64 + 15) / 31, 0xFFFF);
+			}
+			else
+			{
+				q = std::min((comp << bits_per_comp) / (0x7BFF + 1), (1 << bits_per_comp) - 1);
+			}
+		}
+
+		return q;
+	}
+
+	int TexCompressionBC6U::Unquantize(int comp, uint8_t bits_per_comp, bool signed_fmt) const
 	{
 		int unq = 0;
 		if (signed_fmt)
@@ -2132,7 +2338,7 @@ namespace KlayGE
 		return unq;
 	}
 
-	int TexCompressionBC6U::FinishUnquantize(int comp, bool signed_fmt)
+	int TexCompressionBC6U::FinishUnquantize(int comp, bool signed_fmt) const
 	{
 		if (signed_fmt)
 		{
@@ -2144,6 +2350,404 @@ namespace KlayGE
 		}
 	}
 
+	float TexCompressionBC6U::RoughShapeError(int3 const * pixels, uint32_t shape, bool signed_fmt) const
+	{
+		float err = 0;
+		for (uint32_t p = 0; p < 2; ++ p)
+		{
+			std::pair<int3, int3> end_pts;
+			this->OptimizeEndPoints(pixels, 2, shape, p, signed_fmt, end_pts);
+
+			float3 const a(static_cast<float>(end_pts.first.x()), static_cast<float>(end_pts.first.y()),
+				static_cast<float>(end_pts.first.z()));
+			float3 const b(static_cast<float>(end_pts.second.x()), static_cast<float>(end_pts.second.y()),
+				static_cast<float>(end_pts.second.z()));
+			float3 const dir = b - a;
+			float const len_sq = MathLib::dot(dir, dir);
+
+			// Project onto the 8 points of the line, ignoring the endpoint quantization
+			for (uint32_t i = 0; i < 16; ++ i)
+			{
+				if (GetPartition(2, shape, i) == p)
+				{
+					float3 const clr(static_cast<float>(pixels[i].x()), static_cast<float>(pixels[i].y()),
+						static_cast<float>(pixels[i].z()));
+					float t = 0;
+					if (len_sq > 0)
+					{
+						t = MathLib::clamp(MathLib::dot(clr - a, dir) / len_sq, 0.0f, 1.0f);
+						t = MathLib::round(t * 7) / 7;
+					}
+					float3 const diff = clr - (a + dir * t);
+					err += MathLib::dot(diff, diff);
+				}
+			}
+		}
+
+		return err;
+	}
+
+	void TexCompressionBC6U::OptimizeEndPoints(int3 const * pixels, uint32_t partitions, uint32_t shape, uint32_t region,
+		bool signed_fmt, std::pair<int3, int3>& end_pts) const
+	{
+		std::array<float3, 16> clrs;
+		uint32_t num = 0;
+		float3 avg(0, 0, 0);
+		float3 min_clr(+1e10f, +1e10f, +1e10f);
+		float3 max_clr(-1e10f, -1e10f, -1e10f);
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			if (GetPartition(partitions, shape, i) == region)
+			{
+				float3 const clr(static_cast<float>(pixels[i].x()), static_cast<float>(pixels[i].y()),
+					static_cast<float>(pixels[i].z()));
+				clrs[num] = clr;
+				avg += clr;
+				min_clr = MathLib::minimize(min_clr, clr);
+				max_clr = MathLib::maximize(max_clr, clr);
+				++ num;
+			}
+		}
+		BOOST_ASSERT(num > 0);
+		avg /= static_cast<float>(num);
+
+		float3 axis = max_clr - min_clr;
+		if (MathLib::dot(axis, axis) > 0)
+		{
+			// Principal axis of the covariance matrix, by power iteration
+			float cov[6] = { 0, 0, 0, 0, 0, 0 };
+			for (uint32_t i = 0; i < num; ++ i)
+			{
+				float3 const diff = clrs[i] - avg;
+				cov[0] += diff.x() * diff.x();
+				cov[1] += diff.x() * diff.y();
+				cov[2] += diff.x() * diff.z();
+				cov[3] += diff.y() * diff.y();
+				cov[4] += diff.y() * diff.z();
+				cov[5] += diff.z() * diff.z();
+			}
+
+			axis = MathLib::normalize(axis);
+			for (int iter = 0; iter < 8; ++ iter)
+			{
+				float3 const new_axis(cov[0] * axis.x() + cov[1] * axis.y() + cov[2] * axis.z(),
+					cov[1] * axis.x() + cov[3] * axis.y() + cov[4] * axis.z(),
+					cov[2] * axis.x() + cov[4] * axis.y() + cov[5] * axis.z());
+				float const len = MathLib::length(new_axis);
+				if (len < 1e-6f)
+				{
+					break;
+				}
+				axis = new_axis / len;
+			}
+		}
+
+		float min_t = 0;
+		float max_t = 0;
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			float const t = MathLib::dot(clrs[i] - avg, axis);
+			min_t = std::min(min_t, t);
+			max_t = std::max(max_t, t);
+		}
+
+		float const min_val = signed_fmt ? -0x7BFF : 0;
+		float const max_val = 0x7BFF;
+		float3 const a = avg + axis * min_t;
+		float3 const b = avg + axis * max_t;
+		for (uint32_t c = 0; c < 3; ++ c)
+		{
+			end_pts.first[c] = static_cast<int>(MathLib::round(MathLib::clamp(a[c], min_val, max_val)));
+			end_pts.second[c] = static_cast<int>(MathLib::round(MathLib::clamp(b[c], min_val, max_val)));
+		}
+	}
+
+	bool TexCompressionBC6U::EndPointsFit(ModeInfo const & info, std::pair<int3, int3> const * q_end_pts) const
+	{
+		if (!info.transformed)
+		{
+			return true;
+		}
+
+		// Every endpoint but the first is stored as a delta to the first one
+		int3 const & base = q_end_pts[0].first;
+		for (uint32_t p = 0; p < info.partitions; ++ p)
+		{
+			for (uint32_t e = 0; e < 2; ++ e)
+			{
+				if ((p > 0) || (e > 0))
+				{
+					ARGBColor32 const & prec = info.rgba_prec[p][e];
+					int3 const & pt = e ? q_end_pts[p].second : q_end_pts[p].first;
+					for (uint32_t c = 0; c < 3; ++ c)
+					{
+						int const delta = pt[c] - base[c];
+						int const half_range = 1 << (prec[ARGBColor32::RChannel - c] - 1);
+						if ((delta < -half_range) || (delta >= half_range))
+						{
+							return false;
+						}
+					}
+				}
+			}
+		}
+
+		return true;
+	}
+
+	uint64_t TexCompressionBC6U::AssignIndices(ModeInfo const & info, uint32_t shape, int3 const * pixels,
+		std::pair<int3, int3> const * q_end_pts, uint8_t* indices, bool signed_fmt) const
+	{
+		ARGBColor32 const & prec = info.rgba_prec[0][0];
+		int const * weights = BC67_PREC_WEIGHTS[1 + (1 == info.partitions)];
+		uint32_t const num_indices = 1U << info.index_prec;
+
+		// Same interpolation as the decoder, so the error is exact
+		std::array<std::array<int3, 16>, BC6_MAX_REGIONS> palettes;
+		for (uint32_t p = 0; p < info.partitions; ++ p)
+		{
+			int3 unq_a, unq_b;
+			for (uint32_t c = 0; c < 3; ++ c)
+			{
+				unq_a[c] = this->Unquantize(q_end_pts[p].first[c], prec[ARGBColor32::RChannel - c], signed_fmt);
+				unq_b[c] = this->Unquantize(q_end_pts[p].second[c], prec[ARGBColor32::RChannel - c], signed_fmt);
+			}
+			for (uint32_t i = 0; i < num_indices; ++ i)
+			{
+				for (uint32_t c = 0; c < 3; ++ c)
+				{
+					palettes[p][i][c] = this->FinishUnquantize((unq_a[c] * (BC6_WEIGHT_MAX - weights[i])
+						+ unq_b[c] * weights[i] + BC6_WEIGHT_ROUND) >> BC6_WEIGHT_SHIFT, signed_fmt);
+				}
+			}
+		}
+
+		uint64_t total_err = 0;
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			uint32_t const region = GetPartition(info.partitions, shape, i);
+
+			uint64_t best_err = std::numeric_limits<uint64_t>::max();
+			uint8_t best_index = 0;
+			for (uint32_t j = 0; j < num_indices; ++ j)
+			{
+				int3 const diff = pixels[i] - palettes[region][j];
+				uint64_t const err = static_cast<int64_t>(diff.x()) * diff.x()
+					+ static_cast<int64_t>(diff.y()) * diff.y() + static_cast<int64_t>(diff.z()) * diff.z();
+				if (err < best_err)
+				{
+					best_err = err;
+					best_index = static_cast<uint8_t>(j);
+				}
+			}
+
+			indices[i] = best_index;
+			total_err += best_err;
+		}
+
+		return total_err;
+	}
+
+	bool TexCompressionBC6U::SwapIndices(ModeInfo const & info, uint32_t shape, std::pair<int3, int3>* q_end_pts,
+		uint8_t* indices) const
+	{
+		// The MSB of the index at each anchor pixel is implicitly 0. The weights are symmetric, so swapping the endpoints
+		// and inverting the indices doesn't change the error.
+		uint32_t const num_indices = 1U << info.index_prec;
+		uint32_t const high_bit = num_indices >> 1;
+		uint32_t const fix_up = (info.partitions > 1) ? FIX_UP_TABLE[info.partitions - 2][shape] : 0;
+		for (uint32_t p = 0; p < info.partitions; ++ p)
+		{
+			uint32_t const anchor = (fix_up >> (p * 4)) & 0xF;
+			if (indices[anchor] & high_bit)
+			{
+				std::swap(q_end_pts[p].first, q_end_pts[p].second);
+				for (uint32_t i = 0; i < 16; ++ i)
+				{
+					if (GetPartition(info.partitions, shape, i) == p)
+					{
+						indices[i] = static_cast<uint8_t>(num_indices - 1 - indices[i]);
+					}
+				}
+			}
+		}
+
+		return this->EndPointsFit(info, q_end_pts);
+	}
+
+	uint64_t TexCompressionBC6U::TryMode(uint32_t mode_index, uint32_t shape, int3 const * pixels, int refine_iters,
+		std::pair<int3, int3>* q_end_pts, uint8_t* indices, bool signed_fmt) const
+	{
+		ModeInfo const & info = mode_info_[mode_index];
+		ARGBColor32 const & prec = info.rgba_prec[0][0];
+
+		for (uint32_t p = 0; p < info.partitions; ++ p)
+		{
+			std::pair<int3, int3> end_pts;
+			this->OptimizeEndPoints(pixels, info.partitions, shape, p, signed_fmt, end_pts);
+			for (uint32_t c = 0; c < 3; ++ c)
+			{
+				q_end_pts[p].first[c] = this->Quantize(end_pts.first[c], prec[ARGBColor32::RChannel - c], signed_fmt);
+				q_end_pts[p].second[c] = this->Quantize(end_pts.second[c], prec[ARGBColor32::RChannel - c], signed_fmt);
+			}
+		}
+		for (uint32_t p = info.partitions; p < BC6_MAX_REGIONS; ++ p)
+		{
+			q_end_pts[p].first = q_end_pts[p].second = int3(0, 0, 0);
+		}
+
+		uint64_t err = this->AssignIndices(info, shape, pixels, q_end_pts, indices, signed_fmt);
+		if (!this->SwapIndices(info, shape, q_end_pts, indices))
+		{
+			return std::numeric_limits<uint64_t>::max();
+		}
+
+		// Greedy refinement, moves one endpoint component one step at a time in the quantized space
+		for (int iter = 0; (iter < refine_iters) && (err > 0); ++ iter)
+		{
+			bool improved = false;
+			for (uint32_t p = 0; p < info.partitions; ++ p)
+			{
+				for (uint32_t e = 0; e < 2; ++ e)
+				{
+					for (uint32_t c = 0; c < 3; ++ c)
+					{
+						uint8_t const bits = prec[ARGBColor32::RChannel - c];
+						int const max_q = signed_fmt ? (1 << (bits - 1)) - 1 : (1 << bits) - 1;
+						int const min_q = signed_fmt ? -max_q : 0;
+
+						for (int step = -1; step <= 1; step += 2)
+						{
+							std::array<std::pair<int3, int3>, BC6_MAX_REGIONS> trial_end_pts;
+							std::copy(q_end_pts, q_end_pts + BC6_MAX_REGIONS, trial_end_pts.begin());
+							int& v = e ? trial_end_pts[p].second[c] : trial_end_pts[p].first[c];
+							v += step;
+							if ((v < min_q) || (v > max_q))
+							{
+								continue;
+							}
+
+							std::array<uint8_t, 16> trial_indices;
+							uint64_t const trial_err = this->AssignIndices(info, shape, pixels, &trial_end_pts[0],
+								&trial_indices[0], signed_fmt);
+							if ((trial_err < err) && this->SwapIndices(info, shape, &trial_end_pts[0], &trial_indices[0]))
+							{
+								err = trial_err;
+								std::copy(trial_end_pts.begin(), trial_end_pts.end(), q_end_pts);
+								std::copy(trial_indices.begin(), trial_indices.end(), indices);
+								improved = true;
+							}
+						}
+					}
+				}
+			}
+
+			if (!improved)
+			{
+				break;
+			}
+		}
+
+		return err;
+	}
+
+	void TexCompressionBC6U::PackBC6Block(void* output, uint32_t mode_index, uint32_t shape,
+		std::pair<int3, int3> const * q_end_pts, uint8_t const * indices) const
+	{
+		ModeDescriptor const * desc = mode_desc_[mode_index];
+		ModeInfo const & info = mode_info_[mode_index];
+
+		// Endpoints as they are stored in the block
+		std::array<std::pair<int3, int3>, BC6_MAX_REGIONS> end_pts;
+		memset(&end_pts[0], 0, BC6_MAX_REGIONS * sizeof(end_pts[0]));
+		for (uint32_t p = 0; p < info.partitions; ++ p)
+		{
+			for (uint32_t e = 0; e < 2; ++ e)
+			{
+				ARGBColor32 const & prec = info.rgba_prec[p][e];
+				int3 pt = e ? q_end_pts[p].second : q_end_pts[p].first;
+				if (info.transformed && ((p > 0) || (e > 0)))
+				{
+					pt -= q_end_pts[0].first;
+				}
+				for (uint32_t c = 0; c < 3; ++ c)
+				{
+					pt[c] &= (1 << prec[ARGBColor32::RChannel - c]) - 1;
+				}
+				(e ? end_pts[p].second : end_pts[p].first) = pt;
+			}
+		}
+
+		memset(output, 0, block_bytes_);
+
+		size_t start_bit = 0;
+		size_t const header_bits = info.partitions > 1 ? 82 : 65;
+		while (start_bit < header_bits)
+		{
+			ModeDescriptor const & d = desc[start_bit];
+			uint32_t val;
+			switch (d.field)
+			{
+			case M:
+				val = info.mode;
+				break;
+			case D:
+				val = shape;
+				break;
+			case RW:
+				val = end_pts[0].first.x();
+				break;
+			case RX:
+				val = end_pts[0].second.x();
+				break;
+			case RY:
+				val = end_pts[1].first.x();
+				break;
+			case RZ:
+				val = end_pts[1].second.x();
+				break;
+			case GW:
+				val = end_pts[0].first.y();
+				break;
+			case GX:
+				val = end_pts[0].second.y();
+				break;
+			case GY:
+				val = end_pts[1].first.y();
+				break;
+			case GZ:
+				val = end_pts[1].second.y();
+				break;
+			case BW:
+				val = end_pts[0].first.z();
+				break;
+			case BX:
+				val = end_pts[0].second.z();
+				break;
+			case BY:
+				val = end_pts[1].first.z();
+				break;
+			case BZ:
+				val = end_pts[1].second.z();
+				break;
+
+			default:
+				val = 0;
+				break;
+			}
+
+			WriteBit(output, start_bit, static_cast<uint8_t>((val >> d.bit) & 1));
+		}
+
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			size_t const num_bits = IsFixUpOffset(info.partitions, shape, i) ? info.index_prec - 1 : info.index_prec;
+			WriteBits(output, start_bit, num_bits, indices[i]);
+		}
+		BOOST_ASSERT(128 == start_bit);
+	}
+
+
 
 	TexCompressionBC6S::TexCompressionBC6S()
 	{
@@ -2153,13 +2757,14 @@ namespace KlayGE
 		decoded_fmt_ = EF_ABGR16F;
 	}
 
-	void TexCompressionBC6S::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	std::unique_ptr<TexCompression> TexCompressionBC6S::Clone() const
 	{
-		KFL_UNUSED(output);
-		KFL_UNUSED(input);
-		KFL_UNUSED(method);
+		return MakeUniquePtr<TexCompressionBC6S>();
+	}
 
-		// TODO
+	void TexCompressionBC6S::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	{
+		bc6u_codec_.EncodeBC6Internal(output, input, method, true);
 	}
 
 	void TexCompressionBC6S::DecodeBlock(void* output, void const * input)
@@ -2198,6 +2803,11 @@ namespace KlayGE
 		decoded_fmt_ = EF_ARGB8;
 	}
 
+	std::unique_ptr<TexCompression> TexCompressionBC7::Clone() const
+	{
+		return MakeUniquePtr<TexCompressionBC7>();
+	}
+
 	void TexCompressionBC7::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
 		BOOST_ASSERT(output);
@@ -29,6 +29,7 @@
 */
 
 #include <KlayGE/KlayGE.hpp>
+#include <KFL/ErrorHandling.hpp>
 #include <KlayGE/Context.hpp>
 #include <KlayGE/RenderFactory.hpp>
 #include <KFL/Color.hpp>
@@ -36,7 +37,10 @@
 #include <KFL/Thread.hpp>
 
 #include <vector>
+#include <algorithm>
+#include <array>
 #include <cstring>
+#include <limits>
 #include <boost/assert.hpp>
 
 #include <KlayGE/TexCompressionETC.hpp>
@@ -503,6 +507,373 @@ namespace
 
 		return cur_ind;
 	}
+
+	static int const etc2_distance_table[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+	static int const eac_modifier_table[16][8] =
+	{
+		{ -3, -6, -9, -15, 2, 5, 8, 14 },
+		{ -3, -7, -10, -13, 2, 6, 9, 12 },
+		{ -2, -5, -8, -13, 1, 4, 7, 12 },
+		{ -2, -4, -6, -13, 1, 3, 5, 12 },
+		{ -3, -6, -8, -12, 2, 5, 7, 11 },
+		{ -3, -7, -9, -11, 2, 6, 8, 10 },
+		{ -4, -7, -8, -11, 3, 6, 7, 10 },
+		{ -3, -5, -8, -11, 2, 4, 7, 10 },
+		{ -2, -6, -8, -10, 1, 5, 7, 9 },
+		{ -2, -5, -8, -10, 1, 4, 7, 9 },
+		{ -2, -4, -8, -10, 1, 3, 7, 9 },
+		{ -2, -5, -7, -10, 1, 4, 6, 9 },
+		{ -3, -4, -7, -10, 2, 3, 6, 9 },
+		{ -1, -2, -3, -10, 0, 1, 2, 9 },
+		{ -4, -6, -8, -9, 3, 5, 7, 8 },
+		{ -3, -5, -7, -9, 2, 4, 6, 8 }
+	};
+
+	// T, H and planar modes are signaled by an overflow of the R, G or B in the differential mode
+	bool DifferentialOverflow(uint8_t packed)
+	{
+		int const d = packed & 0x7;
+		int const c = (packed >> 3) - (d & 0x4) + (d & 0x3);
+		return (c & 0xFFE0) != 0;
+	}
+
+	// Sets the bits in free_mask, which are not used by the mode, to make the differential overflow or not
+	uint8_t FixDifferentialOverflow(uint8_t packed, uint8_t free_mask, bool overflow)
+	{
+		packed &= ~free_mask;
+		uint8_t bits = 0;
+		do
+		{
+			if (DifferentialOverflow(packed | bits) == overflow)
+			{
+				return packed | bits;
+			}
+			bits = (bits - free_mask) & free_mask;
+		} while (bits != 0);
+
+		KFL_UNREACHABLE("No valid combination of free bits");
+	}
+
+	void PackETCIndices(uint16_t& msb, uint16_t& lsb, uint8_t const * indices)
+	{
+		msb = 0;
+		lsb = 0;
+		for (int y = 0; y < 4; ++ y)
+		{
+			for (int x = 0; x < 4; ++ x)
+			{
+				int const bit_index = (x * 4 + y) ^ 0x8;
+				msb |= static_cast<uint16_t>(((indices[y * 4 + x] >> 1) & 0x1) << bit_index);
+				lsb |= static_cast<uint16_t>((indices[y * 4 + x] & 0x1) << bit_index);
+			}
+		}
+	}
+
+	int3 ClampColor(int3 const & clr)
+	{
+		return int3(MathLib::clamp(clr.x(), 0, 255), MathLib::clamp(clr.y(), 0, 255), MathLib::clamp(clr.z(), 0, 255));
+	}
+
+	int3 ExtendColor4To8Bits(int3 const & clr)
+	{
+		return int3(Extend4To8Bits(clr.x()), Extend4To8Bits(clr.y()), Extend4To8Bits(clr.z()));
+	}
+
+	int3 QuantizeTo4Bits(float3 const & clr)
+	{
+		return int3(MathLib::clamp(static_cast<int>(clr.x() * 15 / 255 + 0.5f), 0, 15),
+			MathLib::clamp(static_cast<int>(clr.y() * 15 / 255 + 0.5f), 0, 15),
+			MathLib::clamp(static_cast<int>(clr.z() * 15 / 255 + 0.5f), 0, 15));
+	}
+
+	uint32_t ColorDistance(int3 const & lhs, int3 const & rhs)
+	{
+		int3 const diff = lhs - rhs;
+		return diff.x() * diff.x() + diff.y() * diff.y() + diff.z() * diff.z();
+	}
+
+	// Picks the closest of the 4 paint colors for each pixel. Transparent pixels always use index 2,
+	// which can't be used by opaque ones.
+	uint64_t ChoosePaintColors(int3 const * pixels, uint16_t transparent_mask, int3 const * paint_clrs, uint8_t* indices)
+	{
+		uint64_t total_err = 0;
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			if (transparent_mask & (1U << i))
+			{
+				indices[i] = 2;
+			}
+			else
+			{
+				uint32_t best_err = std::numeric_limits<uint32_t>::max();
+				for (uint32_t j = 0; j < 4; ++ j)
+				{
+					if ((j != 2) || !transparent_mask)
+					{
+						uint32_t const err = ColorDistance(pixels[i], paint_clrs[j]);
+						if (err < best_err)
+						{
+							best_err = err;
+							indices[i] = static_cast<uint8_t>(j);
+						}
+					}
+				}
+				total_err += best_err;
+			}
+		}
+		return total_err;
+	}
+
+	uint64_t EvaluateTMode(int3 const * pixels, uint16_t transparent_mask, int3 const & c1, int3 const & c2,
+		uint32_t distance_index, uint8_t* indices)
+	{
+		int3 const base_clr1 = ExtendColor4To8Bits(c1);
+		int3 const base_clr2 = ExtendColor4To8Bits(c2);
+		int const distance = etc2_distance_table[distance_index];
+		int3 const paint_clrs[] =
+		{
+			base_clr1,
+			ClampColor(base_clr2 + int3(distance, distance, distance)),
+			base_clr2,
+			ClampColor(base_clr2 - int3(distance, distance, distance))
+		};
+		return ChoosePaintColors(pixels, transparent_mask, paint_clrs, indices);
+	}
+
+	bool HModeOrdering(int3 const & c1, int3 const & c2)
+	{
+		int3 const base_clr1 = ExtendColor4To8Bits(c1);
+		int3 const base_clr2 = ExtendColor4To8Bits(c2);
+		return ((base_clr1.x() << 16) | (base_clr1.y() << 8) | base_clr1.z())
+			>= ((base_clr2.x() << 16) | (base_clr2.y() << 8) | base_clr2.z());
+	}
+
+	uint64_t EvaluateHMode(int3 const * pixels, uint16_t transparent_mask, int3 const & c1, int3 const & c2,
+		uint32_t distance_index, uint8_t* indices)
+	{
+		// The LSB of the distance index is implied by the order of the base colors
+		if (HModeOrdering(c1, c2) != ((distance_index & 0x1) != 0))
+		{
+			return std::numeric_limits<uint64_t>::max();
+		}
+
+		int3 const base_clr1 = ExtendColor4To8Bits(c1);
+		int3 const base_clr2 = ExtendColor4To8Bits(c2);
+		int const distance = etc2_distance_table[distance_index];
+		int3 const paint_clrs[] =
+		{
+			ClampColor(base_clr1 + int3(distance, distance, distance)),
+			ClampColor(base_clr1 - int3(distance, distance, distance)),
+			ClampColor(base_clr2 + int3(distance, distance, distance)),
+			ClampColor(base_clr2 - int3(distance, distance, distance))
+		};
+		return ChoosePaintColors(pixels, transparent_mask, paint_clrs, indices);
+	}
+
+	// Splits the opaque pixels into 2 clusters along the principal axis. Speed method only takes the split at the mean,
+	// other methods take all the split points.
+	void TwoClusterCandidates(int3 const * pixels, uint16_t transparent_mask, TexCompressionMethod method,
+		std::vector<std::pair<float3, float3>>& candidates)
+	{
+		candidates.clear();
+
+		std::array<float3, 16> clrs;
+		uint32_t num = 0;
+		float3 avg(0, 0, 0);
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			if (!(transparent_mask & (1U << i)))
+			{
+				clrs[num] = float3(static_cast<float>(pixels[i].x()), static_cast<float>(pixels[i].y()),
+					static_cast<float>(pixels[i].z()));
+				avg += clrs[num];
+				++ num;
+			}
+		}
+		if (0 == num)
+		{
+			return;
+		}
+		avg /= static_cast<float>(num);
+
+		float cov[6] = { 0, 0, 0, 0, 0, 0 };
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			float3 const diff = clrs[i] - avg;
+			cov[0] += diff.x() * diff.x();
+			cov[1] += diff.x() * diff.y();
+			cov[2] += diff.x() * diff.z();
+			cov[3] += diff.y() * diff.y();
+			cov[4] += diff.y() * diff.z();
+			cov[5] += diff.z() * diff.z();
+		}
+
+		float3 axis(1, 1, 1);
+		for (int iter = 0; iter < 8; ++ iter)
+		{
+			float3 const new_axis(cov[0] * axis.x() + cov[1] * axis.y() + cov[2] * axis.z(),
+				cov[1] * axis.x() + cov[3] * axis.y() + cov[4] * axis.z(),
+				cov[2] * axis.x() + cov[4] * axis.y() + cov[5] * axis.z());
+			float const len = MathLib::length(new_axis);
+			if (len < 1e-6f)
+			{
+				break;
+			}
+			axis = new_axis / len;
+		}
+
+		std::array<std::pair<float, uint32_t>, 16> projs;
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			projs[i] = std::make_pair(MathLib::dot(clrs[i] - avg, axis), i);
+		}
+		std::sort(projs.begin(), projs.begin() + num);
+
+		if (1 == num)
+		{
+			candidates.emplace_back(clrs[0], clrs[0]);
+			return;
+		}
+
+		std::array<float3, 17> prefix_sums;
+		prefix_sums[0] = float3(0, 0, 0);
+		for (uint32_t i = 0; i < num; ++ i)
+		{
+			prefix_sums[i + 1] = prefix_sums[i] + clrs[projs[i].second];
+		}
+
+		uint32_t begin_split = 1;
+		uint32_t end_split = num;
+		if (TCM_Speed == method)
+		{
+			begin_split = 1;
+			while ((begin_split < num - 1) && (projs[begin_split].first < 0))
+			{
+				++ begin_split;
+			}
+			end_split = begin_split + 1;
+		}
+		for (uint32_t split = begin_split; split < end_split; ++ split)
+		{
+			candidates.emplace_back(prefix_sums[split] / static_cast<float>(split),
+				(prefix_sums[num] - prefix_sums[split]) / static_cast<float>(num - split));
+		}
+	}
+
+	// Greedily moves the 4-bit base colors of T or H mode by one step, until the error stops decreasing
+	template <typename EvaluateFunc>
+	uint64_t RefineTwoBaseColors(int3& c1, int3& c2, uint32_t& distance_index, uint8_t* indices, uint64_t err,
+		int passes, EvaluateFunc const & evaluate)
+	{
+		for (int pass = 0; (pass < passes) && (err > 0); ++ pass)
+		{
+			bool improved = false;
+			for (uint32_t c = 0; c < 6; ++ c)
+			{
+				for (int step = -1; step <= 1; step += 2)
+				{
+					int3 trial_c1 = c1;
+					int3 trial_c2 = c2;
+					int& v = (c < 3) ? trial_c1[c] : trial_c2[c - 3];
+					v += step;
+					if ((v < 0) || (v > 15))
+					{
+						continue;
+					}
+
+					for (uint32_t d = 0; d < 8; ++ d)
+					{
+						std::array<uint8_t, 16> trial_indices;
+						uint64_t const trial_err = evaluate(trial_c1, trial_c2, d, &trial_indices[0]);
+						if (trial_err < err)
+						{
+							err = trial_err;
+							c1 = trial_c1;
+							c2 = trial_c2;
+							distance_index = d;
+							std::copy(trial_indices.begin(), trial_indices.end(), indices);
+							improved = true;
+						}
+					}
+				}
+			}
+
+			if (!improved)
+			{
+				break;
+			}
+		}
+
+		return err;
+	}
+
+	uint64_t EvaluatePlanarMode(int3 const * pixels, int const * o, int const * h, int const * v)
+	{
+		uint64_t err = 0;
+		for (int c = 0; c < 3; ++ c)
+		{
+			int const oc = (1 == c) ? Extend7To8Bits(o[c]) : Extend6To8Bits(o[c]);
+			int const hc = (1 == c) ? Extend7To8Bits(h[c]) : Extend6To8Bits(h[c]);
+			int const vc = (1 == c) ? Extend7To8Bits(v[c]) : Extend6To8Bits(v[c]);
+			for (int y = 0; y < 4; ++ y)
+			{
+				for (int x = 0; x < 4; ++ x)
+				{
+					int const decoded = MathLib::clamp((x * (hc - oc) + y * (vc - oc) + 4 * oc + 2) >> 2, 0, 255);
+					err += MathLib::sqr(decoded - pixels[y * 4 + x][c]);
+				}
+			}
+		}
+		return err;
+	}
+
+	// The base is -127 to 127 in signed formats
+	int DecodeEACValue(int base, int multiplier, int modifier, bool eleven_bits, bool signed_fmt)
+	{
+		if (eleven_bits)
+		{
+			int const scaled_modifier = modifier * (multiplier ? multiplier * 8 : 1);
+			if (signed_fmt)
+			{
+				return MathLib::clamp(base * 8 + scaled_modifier, -1023, 1023);
+			}
+			else
+			{
+				return MathLib::clamp(base * 8 + 4 + scaled_modifier, 0, 2047);
+			}
+		}
+		else
+		{
+			return MathLib::clamp(base + modifier * multiplier, 0, 255);
+		}
+	}
+
+	uint64_t EvaluateEAC(int const * values, int base, int multiplier, int table, bool eleven_bits, bool signed_fmt,
+		uint8_t* indices, uint64_t best_err)
+	{
+		int const * modifiers = eac_modifier_table[table];
+
+		uint64_t total_err = 0;
+		for (uint32_t i = 0; (i < 16) && (total_err < best_err); ++ i)
+		{
+			uint32_t best_pixel_err = std::numeric_limits<uint32_t>::max();
+			for (uint32_t j = 0; j < 8; ++ j)
+			{
+				int const decoded = DecodeEACValue(base, multiplier, modifiers[j], eleven_bits, signed_fmt);
+
+				uint32_t const err = MathLib::sqr(decoded - values[i]);
+				if (err < best_pixel_err)
+				{
+					best_pixel_err = err;
+					indices[i] = static_cast<uint8_t>(j);
+				}
+			}
+			total_err += best_pixel_err;
+		}
+
+		return total_err;
+	}
 }
 
 namespace KlayGE
@@ -655,6 +1026,11 @@ namespace KlayGE
 		sorted_luma_indices_ = nullptr;
 	}
 
+	std::unique_ptr<TexCompression> TexCompressionETC1::Clone() const
+	{
+		return MakeUniquePtr<TexCompressionETC1>();
+	}
+
 	void TexCompressionETC1::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
 	{
 		BOOST_ASSERT(output);
@@ -663,7 +1039,8 @@ namespace KlayGE
 		this->EncodeETC1BlockInternal(*static_cast<ETC1Block*>(output), static_cast<ARGBColor32 const *>(input), method);
 	}
 
-	uint64_t TexCompressionETC1::EncodeETC1BlockInternal(ETC1Block& dst_block, ARGBColor32 const * argb, TexCompressionMethod method)
+	uint64_t TexCompressionETC1::EncodeETC1BlockInternal(ETC1Block& dst_block, ARGBColor32 const * argb, TexCompressionMethod method,
+		bool allow_individual)
 	{
 		BOOST_ASSERT(argb);
 
@@ -679,7 +1056,11 @@ namespace KlayGE
 		}
 		if (uniform_block)
 		{
-			return 16 * this->PackETC1UniformBlock(dst_block, argb);
+			uint64_t const err = 16 * this->PackETC1UniformBlock(dst_block, argb);
+			if (allow_individual || (dst_block.cw_diff_flip & 0x2))
+			{
+				return err;
+			}
 		}
 
 		uint64_t best_err = std::numeric_limits<uint64_t>::max();
@@ -697,7 +1078,7 @@ namespace KlayGE
 
 		for (uint32_t flip = 0; flip < 2; ++ flip)
 		{
-			for (uint32_t use_color4 = 0; use_color4 < 2; ++ use_color4)
+			for (uint32_t use_color4 = 0; use_color4 < (allow_individual ? 2U : 1U); ++ use_color4)
 			{
 				uint64_t trial_err = 0;
 
@@ -835,6 +1216,13 @@ namespace KlayGE
 			} // use_color4
 		} // flip
 
+		if (std::numeric_limits<uint64_t>::max() == best_err)
+		{
+			// Only happens when the individual mode is not allowed, and no differential solution is in range
+			BOOST_ASSERT(!allow_individual);
+			return best_err;
+		}
+
 		int dr = best_results[1].block_color_unscaled_.r() - best_results[0].block_color_unscaled_.r();
 		int dg = best_results[1].block_color_unscaled_.g() - best_results[0].block_color_unscaled_.g();
 		int db = best_results[1].block_color_unscaled_.b() - best_results[0].block_color_unscaled_.b();
@@ -1035,7 +1423,8 @@ namespace KlayGE
 				int modifier;
 				if (alpha)
 				{
-					modifier = (mod & 0x1) ? GetModifier(cw, mod) : 0;
+					// Pixel index 0 uses the base color, and 2 is transparent
+					modifier = ((1 == mod) || (2 == mod)) ? 0 : GetModifier(cw, mod);
 				}
 				else
 				{
@@ -1834,15 +2223,282 @@ namespace KlayGE
 		etc1_codec_ = MakeSharedPtr<TexCompressionETC1>();
 	}
 
-	void TexCompressionETC2RGB8::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	std::unique_ptr<TexCompression> TexCompressionETC2RGB8::Clone() const
 	{
-		KFL_UNUSED(output);
-		KFL_UNUSED(input);
-		KFL_UNUSED(method);
-
-		// TODO
+		return MakeUniquePtr<TexCompressionETC2RGB8>();
 	}
 
+	void TexCompressionETC2RGB8::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		this->EncodeETC2BlockInternal(*static_cast<ETC2Block*>(output), static_cast<ARGBColor32 const *>(input), method, true);
+	}
+
+	uint64_t TexCompressionETC2RGB8::EncodeETC2BlockInternal(ETC2Block& output, ARGBColor32 const * argb,
+		TexCompressionMethod method, bool allow_individual)
+	{
+		BOOST_ASSERT(argb);
+
+		uint64_t best_err = etc1_codec_->EncodeETC1BlockInternal(output.etc1, argb, method, allow_individual);
+		if (best_err > 0)
+		{
+			ETC2Block trial;
+			uint64_t err = this->EncodeETCPlanarModeInternal(trial.etc2_planar_mode, argb, method);
+			if (err < best_err)
+			{
+				best_err = err;
+				output = trial;
+			}
+
+			err = this->EncodeETCTModeInternal(trial.etc2_t_mode, argb, 0, method);
+			if (err < best_err)
+			{
+				best_err = err;
+				output = trial;
+			}
+
+			err = this->EncodeETCHModeInternal(trial.etc2_h_mode, argb, 0, method);
+			if (err < best_err)
+			{
+				best_err = err;
+				output = trial;
+			}
+		}
+
+		return best_err;
+	}
+
+	uint64_t TexCompressionETC2RGB8::EncodeETCTModeInternal(ETC2TModeBlock& output, ARGBColor32 const * argb,
+		uint16_t transparent_mask, TexCompressionMethod method)
+	{
+		BOOST_ASSERT(argb);
+
+		std::array<int3, 16> pixels;
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			pixels[i] = int3(argb[i].r(), argb[i].g(), argb[i].b());
+		}
+
+		std::vector<std::pair<float3, float3>> candidates;
+		TwoClusterCandidates(&pixels[0], transparent_mask, method, candidates);
+
+		uint64_t best_err = std::numeric_limits<uint64_t>::max();
+		int3 best_c1(0, 0, 0);
+		int3 best_c2(0, 0, 0);
+		uint32_t best_distance = 0;
+		std::array<uint8_t, 16> best_indices;
+		std::array<uint8_t, 16> indices;
+		for (auto const & candidate : candidates)
+		{
+			// Either cluster can be the one represented by the single base color
+			for (uint32_t role = 0; role < 2; ++ role)
+			{
+				int3 const c1 = QuantizeTo4Bits(role ? candidate.second : candidate.first);
+				int3 const c2 = QuantizeTo4Bits(role ? candidate.first : candidate.second);
+				for (uint32_t d = 0; d < 8; ++ d)
+				{
+					uint64_t const err = EvaluateTMode(&pixels[0], transparent_mask, c1, c2, d, &indices[0]);
+					if (err < best_err)
+					{
+						best_err = err;
+						best_c1 = c1;
+						best_c2 = c2;
+						best_distance = d;
+						best_indices = indices;
+					}
+				}
+			}
+		}
+
+		if (candidates.empty())
+		{
+			return best_err;
+		}
+
+		if (TCM_Quality == method)
+		{
+			best_err = RefineTwoBaseColors(best_c1, best_c2, best_distance, &best_indices[0], best_err, 4,
+				[&pixels, transparent_mask](int3 const & c1, int3 const & c2, uint32_t d, uint8_t* trial_indices)
+				{
+					return EvaluateTMode(&pixels[0], transparent_mask, c1, c2, d, trial_indices);
+				});
+		}
+
+		output.r1 = FixDifferentialOverflow(static_cast<uint8_t>(((best_c1.x() & 0xC) << 1) | (best_c1.x() & 0x3)),
+			0xE4, true);
+		output.g1_b1 = static_cast<uint8_t>((best_c1.y() << 4) | best_c1.z());
+		output.r2_g2 = static_cast<uint8_t>((best_c2.x() << 4) | best_c2.y());
+		output.b2_d = static_cast<uint8_t>((best_c2.z() << 4) | ((best_distance >> 1) << 2)
+			| (transparent_mask ? 0 : 2) | (best_distance & 0x1));
+		PackETCIndices(output.msb, output.lsb, &best_indices[0]);
+
+		return best_err;
+	}
+
+	uint64_t TexCompressionETC2RGB8::EncodeETCHModeInternal(ETC2HModeBlock& output, ARGBColor32 const * argb,
+		uint16_t transparent_mask, TexCompressionMethod method)
+	{
+		BOOST_ASSERT(argb);
+
+		std::array<int3, 16> pixels;
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			pixels[i] = int3(argb[i].r(), argb[i].g(), argb[i].b());
+		}
+
+		std::vector<std::pair<float3, float3>> candidates;
+		TwoClusterCandidates(&pixels[0], transparent_mask, method, candidates);
+
+		uint64_t best_err = std::numeric_limits<uint64_t>::max();
+		int3 best_c1(0, 0, 0);
+		int3 best_c2(0, 0, 0);
+		uint32_t best_distance = 0;
+		std::array<uint8_t, 16> best_indices;
+		std::array<uint8_t, 16> indices;
+		for (auto const & candidate : candidates)
+		{
+			// The order of the base colors encodes the LSB of the distance index, so both orders are needed
+			for (uint32_t role = 0; role < 2; ++ role)
+			{
+				int3 const c1 = QuantizeTo4Bits(role ? candidate.second : candidate.first);
+				int3 const c2 = QuantizeTo4Bits(role ? candidate.first : candidate.second);
+				for (uint32_t d = 0; d < 8; ++ d)
+				{
+					uint64_t const err = EvaluateHMode(&pixels[0], transparent_mask, c1, c2, d, &indices[0]);
+					if (err < best_err)
+					{
+						best_err = err;
+						best_c1 = c1;
+						best_c2 = c2;
+						best_distance = d;
+						best_indices = indices;
+					}
+				}
+			}
+		}
+
+		if (best_err == std::numeric_limits<uint64_t>::max())
+		{
+			return best_err;
+		}
+
+		if (TCM_Quality == method)
+		{
+			best_err = RefineTwoBaseColors(best_c1, best_c2, best_distance, &best_indices[0], best_err, 4,
+				[&pixels, transparent_mask](int3 const & c1, int3 const & c2, uint32_t d, uint8_t* trial_indices)
+				{
+					return EvaluateHMode(&pixels[0], transparent_mask, c1, c2, d, trial_indices);
+				});
+		}
+
+		output.r1_g1 = FixDifferentialOverflow(static_cast<uint8_t>((best_c1.x() << 3) | (best_c1.y() >> 1)), 0x80, false);
+		output.g1_b1 = FixDifferentialOverflow(static_cast<uint8_t>(((best_c1.y() & 0x1) << 4) | (best_c1.z() & 0x8)
+			| ((best_c1.z() >> 1) & 0x3)), 0xE4, true);
+		output.b1_r2_g2 = static_cast<uint8_t>(((best_c1.z() & 0x1) << 7) | (best_c2.x() << 3) | (best_c2.y() >> 1));
+		output.g2_b2_d = static_cast<uint8_t>(((best_c2.y() & 0x1) << 7) | (best_c2.z() << 3) | (best_distance & 0x4)
+			| (transparent_mask ? 0 : 2) | ((best_distance >> 1) & 0x1));
+		PackETCIndices(output.msb, output.lsb, &best_indices[0]);
+
+		return best_err;
+	}
+
+	uint64_t TexCompressionETC2RGB8::EncodeETCPlanarModeInternal(ETC2PlanarModeBlock& output, ARGBColor32 const * argb,
+		TexCompressionMethod method)
+	{
+		BOOST_ASSERT(argb);
+
+		std::array<int3, 16> pixels;
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			pixels[i] = int3(argb[i].r(), argb[i].g(), argb[i].b());
+		}
+
+		// Least squares fit of c = a + b * x + d * y, then O = a, H = a + 4 * b, V = a + 4 * d
+		int o[3];
+		int h[3];
+		int v[3];
+		for (int c = 0; c < 3; ++ c)
+		{
+			float sum = 0;
+			float sum_x = 0;
+			float sum_y = 0;
+			for (int y = 0; y < 4; ++ y)
+			{
+				for (int x = 0; x < 4; ++ x)
+				{
+					float const p = static_cast<float>(pixels[y * 4 + x][c]);
+					sum += p;
+					sum_x += (x - 1.5f) * p;
+					sum_y += (y - 1.5f) * p;
+				}
+			}
+
+			float const slope_x = sum_x / 20;
+			float const slope_y = sum_y / 20;
+			float const a = sum / 16 - 1.5f * (slope_x + slope_y);
+
+			float const scale = (1 == c) ? 127.0f / 255 : 63.0f / 255;
+			int const max_val = (1 == c) ? 127 : 63;
+			o[c] = MathLib::clamp(static_cast<int>(a * scale + 0.5f), 0, max_val);
+			h[c] = MathLib::clamp(static_cast<int>((a + 4 * slope_x) * scale + 0.5f), 0, max_val);
+			v[c] = MathLib::clamp(static_cast<int>((a + 4 * slope_y) * scale + 0.5f), 0, max_val);
+		}
+
+		uint64_t err = EvaluatePlanarMode(&pixels[0], o, h, v);
+		if (method != TCM_Speed)
+		{
+			int* comps[] = { &o[0], &o[1], &o[2], &h[0], &h[1], &h[2], &v[0], &v[1], &v[2] };
+			int const passes = (TCM_Quality == method) ? 4 : 1;
+			for (int pass = 0; (pass < passes) && (err > 0); ++ pass)
+			{
+				bool improved = false;
+				for (uint32_t i = 0; i < sizeof(comps) / sizeof(comps[0]); ++ i)
+				{
+					int const max_val = (1 == i % 3) ? 127 : 63;
+					for (int step = -1; step <= 1; step += 2)
+					{
+						int const old_val = *comps[i];
+						int const new_val = old_val + step;
+						if ((new_val < 0) || (new_val > max_val))
+						{
+							continue;
+						}
+
+						*comps[i] = new_val;
+						uint64_t const trial_err = EvaluatePlanarMode(&pixels[0], o, h, v);
+						if (trial_err < err)
+						{
+							err = trial_err;
+							improved = true;
+						}
+						else
+						{
+							*comps[i] = old_val;
+						}
+					}
+				}
+
+				if (!improved)
+				{
+					break;
+				}
+			}
+		}
+
+		output.ro_go = FixDifferentialOverflow(static_cast<uint8_t>((o[0] << 1) | (o[1] >> 6)), 0x80, false);
+		output.go_bo = FixDifferentialOverflow(static_cast<uint8_t>(((o[1] & 0x3F) << 1) | (o[2] >> 5)), 0x80, false);
+		output.bo = FixDifferentialOverflow(static_cast<uint8_t>((o[2] & 0x18) | ((o[2] >> 1) & 0x3)), 0xE4, true);
+		output.bo_rh = static_cast<uint8_t>(((o[2] & 0x1) << 7) | ((h[0] >> 1) << 2) | 2 | (h[0] & 0x1));
+		output.gh_bh = static_cast<uint8_t>((h[1] << 1) | (h[2] >> 5));
+		output.bh_rv = static_cast<uint8_t>(((h[2] & 0x1F) << 3) | (v[0] >> 3));
+		output.rv_gv = static_cast<uint8_t>(((v[0] & 0x7) << 5) | (v[1] >> 2));
+		output.gv_bv = static_cast<uint8_t>(((v[1] & 0x3) << 6) | v[2]);
+
+		return err;
+	}
+
 	void TexCompressionETC2RGB8::DecodeBlock(void* output, void const * input)
 	{
 		BOOST_ASSERT(output);
@@ -1887,8 +2543,6 @@ namespace KlayGE
 	{
 		BOOST_ASSERT(argb);
 
-		static int const distance_table[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
-
 		int const r1 = ((etc2.r1 >> 1) & 0xC) | (etc2.r1 & 0x3);
 		int const g1 = etc2.g1_b1 >> 4;
 		int const b1 = etc2.g1_b1 & 0xF;
@@ -1912,7 +2566,7 @@ namespace KlayGE
 			Extend4To8Bits(b2)
 		};
 
-		int const distance = distance_table[da | db];
+		int const distance = etc2_distance_table[da | db];
 		ARGBColor32 const modified_clr[] =
 		{
 			From4Ints(255, base_clr1[0], base_clr1[1], base_clr1[2]),
@@ -1945,8 +2599,6 @@ namespace KlayGE
 	{
 		BOOST_ASSERT(argb);
 
-		static int const distance_table[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
-
 		int const r1 = (etc2.r1_g1 >> 3) & 0xF;
 		int const g1 = ((etc2.r1_g1 & 0x7) << 1) | ((etc2.g1_b1 >> 4) & 0x1);
 		int const b1 = (etc2.g1_b1 & 0x8) | ((etc2.g1_b1 & 0x3) << 1) | ((etc2.b1_r2_g2 >> 7) & 0x1);
@@ -1972,7 +2624,7 @@ namespace KlayGE
 
 		int const ordering = ARGBColor32(0, base_clr1[0], base_clr1[1], base_clr1[2]).ARGB()
 			>= ARGBColor32(0, base_clr2[0], base_clr2[1], base_clr2[2]).ARGB();
-		int distance = distance_table[da | (db << 1) | ordering];
+		int distance = etc2_distance_table[da | (db << 1) | ordering];
 		ARGBColor32 const modified_clr[] =
 		{
 			From4Ints(255, base_clr1[0] + distance, base_clr1[1] + distance, base_clr1[2] + distance),
@@ -2058,15 +2710,55 @@ namespace KlayGE
 		etc2_rgb8_codec_ = MakeSharedPtr<TexCompressionETC2RGB8>();
 	}
 
-	void TexCompressionETC2RGB8A1::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	std::unique_ptr<TexCompression> TexCompressionETC2RGB8A1::Clone() const
 	{
-		KFL_UNUSED(output);
-		KFL_UNUSED(input);
-		KFL_UNUSED(method);
-
-		// TODO
+		return MakeUniquePtr<TexCompressionETC2RGB8A1>();
 	}
 
+	void TexCompressionETC2RGB8A1::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		ETC2Block& etc2 = *static_cast<ETC2Block*>(output);
+		ARGBColor32 const * argb = static_cast<ARGBColor32 const *>(input);
+
+		uint16_t transparent_mask = 0;
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			if (argb[i].a() < 128)
+			{
+				transparent_mask |= 1U << i;
+			}
+		}
+
+		if (0 == transparent_mask)
+		{
+			// The opaque flag takes the place of the diff bit, so the individual mode is not available
+			etc2_rgb8_codec_->EncodeETC2BlockInternal(etc2, argb, method, false);
+		}
+		else
+		{
+			uint64_t best_err = this->EncodeETCDifferentialModeAlphaInternal(etc2.etc1, argb, transparent_mask);
+			if (best_err > 0)
+			{
+				ETC2Block trial;
+				uint64_t err = etc2_rgb8_codec_->EncodeETCTModeInternal(trial.etc2_t_mode, argb, transparent_mask, method);
+				if (err < best_err)
+				{
+					best_err = err;
+					etc2 = trial;
+				}
+
+				err = etc2_rgb8_codec_->EncodeETCHModeInternal(trial.etc2_h_mode, argb, transparent_mask, method);
+				if (err < best_err)
+				{
+					etc2 = trial;
+				}
+			}
+		}
+	}
+
 	void TexCompressionETC2RGB8A1::DecodeBlock(void* output, void const * input)
 	{
 		BOOST_ASSERT(output);
@@ -2100,4 +2792,513 @@ namespace KlayGE
 			etc1_codec_->DecodeETCDifferentialModeInternal(argb, etc2.etc1, !op);
 		}
 	}
+
+	uint64_t TexCompressionETC2RGB8A1::EncodeETCDifferentialModeAlphaInternal(ETC1Block& output, ARGBColor32 const * argb,
+		uint16_t transparent_mask) const
+	{
+		BOOST_ASSERT(argb);
+
+		// Without the opaque flag, pixel index 0 is the base color, 1 and 3 are base color -/+ the large modifier,
+		// and 2 is transparent.
+		uint64_t best_err = std::numeric_limits<uint64_t>::max();
+		for (uint32_t flip = 0; flip < 2; ++ flip)
+		{
+			std::array<uint32_t, 16> sub_blocks;
+			for (uint32_t i = 0; i < 16; ++ i)
+			{
+				sub_blocks[i] = (flip ? (i >> 2) : (i & 3)) >> 1;
+			}
+
+			int3 base_clrs[2];
+			for (uint32_t sub = 0; sub < 2; ++ sub)
+			{
+				int3 sum(0, 0, 0);
+				int num = 0;
+				for (uint32_t i = 0; i < 16; ++ i)
+				{
+					if ((sub_blocks[i] == sub) && !(transparent_mask & (1U << i)))
+					{
+						sum += int3(argb[i].r(), argb[i].g(), argb[i].b());
+						++ num;
+					}
+				}
+
+				if (num > 0)
+				{
+					for (uint32_t c = 0; c < 3; ++ c)
+					{
+						base_clrs[sub][c] = MathLib::clamp((sum[c] * 31 + num * 255 / 2) / (num * 255), 0, 31);
+					}
+				}
+				else
+				{
+					base_clrs[sub] = sub ? base_clrs[0] : int3(0, 0, 0);
+				}
+			}
+
+			int3 delta;
+			for (uint32_t c = 0; c < 3; ++ c)
+			{
+				delta[c] = MathLib::clamp(base_clrs[1][c] - base_clrs[0][c], -4, 3);
+				base_clrs[1][c] = base_clrs[0][c] + delta[c];
+			}
+
+			uint64_t err = 0;
+			uint32_t cws[2];
+			std::array<uint8_t, 16> indices;
+			for (uint32_t sub = 0; sub < 2; ++ sub)
+			{
+				int3 const clr(Extend5To8Bits(base_clrs[sub].x()), Extend5To8Bits(base_clrs[sub].y()),
+					Extend5To8Bits(base_clrs[sub].z()));
+
+				uint64_t best_sub_err = std::numeric_limits<uint64_t>::max();
+				for (uint32_t cw = 0; cw < 8; ++ cw)
+				{
+					int const modifier = TexCompressionETC1::GetModifier(cw, 3);
+					int3 const paint_clrs[] =
+					{
+						clr,
+						ClampColor(clr + int3(modifier, modifier, modifier)),
+						clr,
+						ClampColor(clr - int3(modifier, modifier, modifier))
+					};
+
+					uint64_t sub_err = 0;
+					std::array<uint8_t, 16> sub_indices;
+					for (uint32_t i = 0; i < 16; ++ i)
+					{
+						if (sub_blocks[i] == sub)
+						{
+							if (transparent_mask & (1U << i))
+							{
+								sub_indices[i] = 2;
+							}
+							else
+							{
+								int3 const pixel(argb[i].r(), argb[i].g(), argb[i].b());
+								uint32_t best_pixel_err = std::numeric_limits<uint32_t>::max();
+								for (uint32_t j = 0; j < 4; ++ j)
+								{
+									if (j != 2)
+									{
+										uint32_t const pixel_err = ColorDistance(pixel, paint_clrs[j]);
+										if (pixel_err < best_pixel_err)
+										{
+											best_pixel_err = pixel_err;
+											sub_indices[i] = static_cast<uint8_t>(j);
+										}
+									}
+								}
+								sub_err += best_pixel_err;
+							}
+						}
+					}
+
+					if (sub_err < best_sub_err)
+					{
+						best_sub_err = sub_err;
+						cws[sub] = cw;
+						for (uint32_t i = 0; i < 16; ++ i)
+						{
+							if (sub_blocks[i] == sub)
+							{
+								indices[i] = sub_indices[i];
+							}
+						}
+					}
+				}
+
+				err += best_sub_err;
+			}
+
+			if (err < best_err)
+			{
+				best_err = err;
+
+				output.r = static_cast<uint8_t>((base_clrs[0].x() << 3) | (delta.x() & 0x7));
+				output.g = static_cast<uint8_t>((base_clrs[0].y() << 3) | (delta.y() & 0x7));
+				output.b = static_cast<uint8_t>((base_clrs[0].z() << 3) | (delta.z() & 0x7));
+				output.cw_diff_flip = static_cast<uint8_t>((cws[0] << 5) | (cws[1] << 2) | flip);
+				PackETCIndices(output.msb, output.lsb, &indices[0]);
+			}
+		}
+
+		return best_err;
+	}
+
+
+	TexCompressionETC2R11::TexCompressionETC2R11()
+	{
+		block_width_ = block_height_ = 4;
+		block_depth_ = 1;
+		block_bytes_ = NumFormatBytes(EF_ETC2_R11) * 4;
+		decoded_fmt_ = EF_R16;
+	}
+
+	std::unique_ptr<TexCompression> TexCompressionETC2R11::Clone() const
+	{
+		return MakeUniquePtr<TexCompressionETC2R11>();
+	}
+
+	void TexCompressionETC2R11::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	{
+		this->EncodeR11Internal(output, input, method, false);
+	}
+
+	void TexCompressionETC2R11::DecodeBlock(void* output, void const * input)
+	{
+		this->DecodeR11Internal(output, input, false);
+	}
+
+	void TexCompressionETC2R11::EncodeR11Internal(void* output, void const * input, TexCompressionMethod method,
+		bool signed_fmt) const
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		int values[16];
+		if (signed_fmt)
+		{
+			int16_t const * r = static_cast<int16_t const *>(input);
+			for (uint32_t i = 0; i < 16; ++ i)
+			{
+				int const v = std::max(static_cast<int>(r[i]), -32767);
+				values[i] = (v >= 0) ? (v * 1023 + 16383) / 32767 : -((-v * 1023 + 16383) / 32767);
+			}
+		}
+		else
+		{
+			uint16_t const * r = static_cast<uint16_t const *>(input);
+			for (uint32_t i = 0; i < 16; ++ i)
+			{
+				values[i] = (r[i] * 2047 + 32767) / 65535;
+			}
+		}
+
+		this->EncodeEACBlockInternal(*static_cast<EACBlock*>(output), values, true, signed_fmt, method);
+	}
+
+	void TexCompressionETC2R11::DecodeR11Internal(void* output, void const * input, bool signed_fmt) const
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		int values[16];
+		this->DecodeEACBlockInternal(values, *static_cast<EACBlock const *>(input), true, signed_fmt);
+
+		// Extends the 11 bits to 16 bits by replicating the high bits, as the spec does
+		if (signed_fmt)
+		{
+			int16_t* r = static_cast<int16_t*>(output);
+			for (uint32_t i = 0; i < 16; ++ i)
+			{
+				int const v = std::abs(values[i]);
+				int const extended = (v << 5) | (v >> 5);
+				r[i] = static_cast<int16_t>((values[i] < 0) ? -extended : extended);
+			}
+		}
+		else
+		{
+			uint16_t* r = static_cast<uint16_t*>(output);
+			for (uint32_t i = 0; i < 16; ++ i)
+			{
+				r[i] = static_cast<uint16_t>((values[i] << 5) | (values[i] >> 6));
+			}
+		}
+	}
+
+	uint64_t TexCompressionETC2R11::EncodeEACBlockInternal(EACBlock& output, int const * values, bool eleven_bits,
+		bool signed_fmt, TexCompressionMethod method) const
+	{
+		BOOST_ASSERT(values);
+
+		int min_val = values[0];
+		int max_val = values[0];
+		for (uint32_t i = 1; i < 16; ++ i)
+		{
+			min_val = std::min(min_val, values[i]);
+			max_val = std::max(max_val, values[i]);
+		}
+
+		int multiplier_radius;
+		int base_radius;
+		switch (method)
+		{
+		case TCM_Speed:
+			multiplier_radius = 0;
+			base_radius = 0;
+			break;
+
+		case TCM_Balanced:
+			multiplier_radius = 1;
+			base_radius = 1;
+			break;
+
+		default:
+			multiplier_radius = 2;
+			base_radius = 3;
+			break;
+		}
+
+		// Multiplier 0 is only valid in 11-bit formats
+		int const min_multiplier = eleven_bits ? 0 : 1;
+		// -128 isn't used in signed formats
+		int const min_base = signed_fmt ? -127 : 0;
+		int const max_base = signed_fmt ? 127 : 255;
+
+		uint64_t best_err = std::numeric_limits<uint64_t>::max();
+		int best_base = 0;
+		int best_multiplier = 1;
+		int best_table = 0;
+		std::array<uint8_t, 16> best_indices;
+		std::array<uint8_t, 16> indices;
+		for (int table = 0; (table < 16) && (best_err > 0); ++ table)
+		{
+			int const * modifiers = eac_modifier_table[table];
+			int const modifier_span = modifiers[7] - modifiers[3];
+			int const ideal_multiplier = static_cast<int>(static_cast<float>(max_val - min_val)
+				/ (modifier_span * (eleven_bits ? 8 : 1)) + 0.5f);
+			for (int multiplier = std::max(ideal_multiplier - multiplier_radius, min_multiplier);
+				(multiplier <= std::min(ideal_multiplier + multiplier_radius, 15)) && (best_err > 0); ++ multiplier)
+			{
+				// Centers the modifier range on the value range
+				int const scale = eleven_bits ? (multiplier ? multiplier * 8 : 1) : multiplier;
+				float const center = (min_val + max_val) / 2.0f - (modifiers[3] + modifiers[7]) * scale / 2.0f;
+				int ideal_base;
+				if (eleven_bits)
+				{
+					ideal_base = signed_fmt ? static_cast<int>(MathLib::round(center / 8))
+						: static_cast<int>((center - 4) / 8 + 0.5f);
+				}
+				else
+				{
+					ideal_base = static_cast<int>(center + 0.5f);
+				}
+				for (int base = std::max(ideal_base - base_radius, min_base);
+					(base <= std::min(ideal_base + base_radius, max_base)) && (best_err > 0); ++ base)
+				{
+					uint64_t const err = EvaluateEAC(values, base, multiplier, table, eleven_bits, signed_fmt,
+						&indices[0], best_err);
+					if (err < best_err)
+					{
+						best_err = err;
+						best_base = base;
+						best_multiplier = multiplier;
+						best_table = table;
+						best_indices = indices;
+					}
+				}
+			}
+		}
+
+		output.base = static_cast<uint8_t>(static_cast<int8_t>(best_base));
+		output.multiplier_table = static_cast<uint8_t>((best_multiplier << 4) | best_table);
+
+		// 16 3-bit indices in column-major order, stored as a big-endian 48-bit integer
+		uint64_t bits = 0;
+		for (uint32_t x = 0; x < 4; ++ x)
+		{
+			for (uint32_t y = 0; y < 4; ++ y)
+			{
+				bits = (bits << 3) | best_indices[y * 4 + x];
+			}
+		}
+		for (uint32_t i = 0; i < 6; ++ i)
+		{
+			output.indices[i] = static_cast<uint8_t>(bits >> (40 - i * 8));
+		}
+
+		return best_err;
+	}
+
+	void TexCompressionETC2R11::DecodeEACBlockInternal(int* values, EACBlock const & eac, bool eleven_bits,
+		bool signed_fmt) const
+	{
+		BOOST_ASSERT(values);
+
+		int const base = signed_fmt ? std::max(static_cast<int>(static_cast<int8_t>(eac.base)), -127) : eac.base;
+		int const multiplier = eac.multiplier_table >> 4;
+		int const * modifiers = eac_modifier_table[eac.multiplier_table & 0xF];
+
+		uint64_t bits = 0;
+		for (uint32_t i = 0; i < 6; ++ i)
+		{
+			bits = (bits << 8) | eac.indices[i];
+		}
+
+		for (uint32_t x = 0; x < 4; ++ x)
+		{
+			for (uint32_t y = 0; y < 4; ++ y)
+			{
+				int const modifier = modifiers[(bits >> (45 - (x * 4 + y) * 3)) & 0x7];
+				values[y * 4 + x] = DecodeEACValue(base, multiplier, modifier, eleven_bits, signed_fmt);
+			}
+		}
+	}
+
+
+	TexCompressionETC2RG11::TexCompressionETC2RG11()
+	{
+		block_width_ = block_height_ = 4;
+		block_depth_ = 1;
+		block_bytes_ = NumFormatBytes(EF_ETC2_GR11) * 4;
+		decoded_fmt_ = EF_GR16;
+	}
+
+	std::unique_ptr<TexCompression> TexCompressionETC2RG11::Clone() const
+	{
+		return MakeUniquePtr<TexCompressionETC2RG11>();
+	}
+
+	void TexCompressionETC2RG11::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	{
+		this->EncodeRG11Internal(output, input, method, false);
+	}
+
+	void TexCompressionETC2RG11::DecodeBlock(void* output, void const * input)
+	{
+		this->DecodeRG11Internal(output, input, false);
+	}
+
+	void TexCompressionETC2RG11::EncodeRG11Internal(void* output, void const * input, TexCompressionMethod method,
+		bool signed_fmt) const
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		ETC2RG11Block& rg11 = *static_cast<ETC2RG11Block*>(output);
+		uint32_t const * gr = static_cast<uint32_t const *>(input);
+
+		// The channels are 16-bit, signed or not, so they are only moved around here
+		std::array<uint16_t, 16> r;
+		std::array<uint16_t, 16> g;
+		for (size_t i = 0; i < r.size(); ++ i)
+		{
+			r[i] = static_cast<uint16_t>(gr[i] & 0xFFFF);
+			g[i] = static_cast<uint16_t>(gr[i] >> 16);
+		}
+
+		r11_codec_.EncodeR11Internal(&rg11.red, &r[0], method, signed_fmt);
+		r11_codec_.EncodeR11Internal(&rg11.green, &g[0], method, signed_fmt);
+	}
+
+	void TexCompressionETC2RG11::DecodeRG11Internal(void* output, void const * input, bool signed_fmt) const
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		uint32_t* gr = static_cast<uint32_t*>(output);
+		ETC2RG11Block const & rg11 = *static_cast<ETC2RG11Block const *>(input);
+
+		std::array<uint16_t, 16> r;
+		r11_codec_.DecodeR11Internal(&r[0], &rg11.red, signed_fmt);
+		std::array<uint16_t, 16> g;
+		r11_codec_.DecodeR11Internal(&g[0], &rg11.green, signed_fmt);
+
+		for (size_t i = 0; i < r.size(); ++ i)
+		{
+			gr[i] = r[i] | (static_cast<uint32_t>(g[i]) << 16);
+		}
+	}
+
+
+	TexCompressionETC2SignedR11::TexCompressionETC2SignedR11()
+	{
+		block_width_ = block_height_ = 4;
+		block_depth_ = 1;
+		block_bytes_ = NumFormatBytes(EF_SIGNED_ETC2_R11) * 4;
+		decoded_fmt_ = EF_SIGNED_R16;
+	}
+
+	std::unique_ptr<TexCompression> TexCompressionETC2SignedR11::Clone() const
+	{
+		return MakeUniquePtr<TexCompressionETC2SignedR11>();
+	}
+
+	void TexCompressionETC2SignedR11::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	{
+		r11_codec_.EncodeR11Internal(output, input, method, true);
+	}
+
+	void TexCompressionETC2SignedR11::DecodeBlock(void* output, void const * input)
+	{
+		r11_codec_.DecodeR11Internal(output, input, true);
+	}
+
+
+	TexCompressionETC2SignedRG11::TexCompressionETC2SignedRG11()
+	{
+		block_width_ = block_height_ = 4;
+		block_depth_ = 1;
+		block_bytes_ = NumFormatBytes(EF_SIGNED_ETC2_GR11) * 4;
+		decoded_fmt_ = EF_SIGNED_GR16;
+	}
+
+	std::unique_ptr<TexCompression> TexCompressionETC2SignedRG11::Clone() const
+	{
+		return MakeUniquePtr<TexCompressionETC2SignedRG11>();
+	}
+
+	void TexCompressionETC2SignedRG11::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	{
+		rg11_codec_.EncodeRG11Internal(output, input, method, true);
+	}
+
+	void TexCompressionETC2SignedRG11::DecodeBlock(void* output, void const * input)
+	{
+		rg11_codec_.DecodeRG11Internal(output, input, true);
+	}
+
+
+	TexCompressionETC2RGBA8::TexCompressionETC2RGBA8()
+	{
+		block_width_ = block_height_ = 4;
+		block_depth_ = 1;
+		block_bytes_ = NumFormatBytes(EF_ETC2_ABGR8) * 4;
+		decoded_fmt_ = EF_ARGB8;
+
+		etc2_rgb8_codec_ = MakeSharedPtr<TexCompressionETC2RGB8>();
+		eac_codec_ = MakeSharedPtr<TexCompressionETC2R11>();
+	}
+
+	std::unique_ptr<TexCompression> TexCompressionETC2RGBA8::Clone() const
+	{
+		return MakeUniquePtr<TexCompressionETC2RGBA8>();
+	}
+
+	void TexCompressionETC2RGBA8::EncodeBlock(void* output, void const * input, TexCompressionMethod method)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		ETC2RGBA8Block& rgba8 = *static_cast<ETC2RGBA8Block*>(output);
+		ARGBColor32 const * argb = static_cast<ARGBColor32 const *>(input);
+
+		int alpha[16];
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			alpha[i] = argb[i].a();
+		}
+
+		eac_codec_->EncodeEACBlockInternal(rgba8.alpha, alpha, false, false, method);
+		etc2_rgb8_codec_->EncodeETC2BlockInternal(rgba8.etc2, argb, method, true);
+	}
+
+	void TexCompressionETC2RGBA8::DecodeBlock(void* output, void const * input)
+	{
+		BOOST_ASSERT(output);
+		BOOST_ASSERT(input);
+
+		ARGBColor32* argb = static_cast<ARGBColor32*>(output);
+		ETC2RGBA8Block const & rgba8 = *static_cast<ETC2RGBA8Block const *>(input);
+
+		etc2_rgb8_codec_->DecodeBlock(argb, &rgba8.etc2);
+
+		int alpha[16];
+		eac_codec_->DecodeEACBlockInternal(alpha, rgba8.alpha, false, false);
+		for (uint32_t i = 0; i < 16; ++ i)
+		{
+			argb[i].a() = static_cast<uint8_t>(alpha[i]);
+		}
+	}
 }
@@ -37,11 +37,17 @@
 #include <KFL/Util.hpp>
 #include <KlayGE/TexCompressionBC.hpp>
 #include <KlayGE/TexCompressionETC.hpp>
+#include <KlayGE/TextureStreaming.hpp>
 #include <KFL/Half.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/CpuInfo.hpp>
+#include <KFL/Thread.hpp>
+#include <KFL/CXX17/filesystem.hpp>
 
+#include <atomic>
 #include <cstring>
 #include <fstream>
+#include <functional>
 #include <system_error>
 
 #include <KlayGE/Texture.hpp>
@@ -50,6 +56,9 @@ namespace
 {
 	using namespace KlayGE;
 
+	// Bump it when the output of BlockTranscode or Transcode changes, to invalidate the transcoded caches
+	uint32_t const TRANSCODED_CACHE_VERSION = 2;
+
 #ifdef KLAYGE_HAS_STRUCT_PACK
 #pragma pack(push, 1)
 #endif
@@ -879,20 +888,23 @@ namespace
 
 		case EF_ETC2_ABGR8:
 		case EF_ETC2_ABGR8_SRGB:
-			// TODO
-			KFL_UNREACHABLE("Not implemented");
+			codec = MakeUniquePtr<TexCompressionETC2RGBA8>();
 			break;
 
 		case EF_ETC2_R11:
+			codec = MakeUniquePtr<TexCompressionETC2R11>();
+			break;
+
 		case EF_SIGNED_ETC2_R11:
-			// TODO
-			KFL_UNREACHABLE("Not implemented");
+			codec = MakeUniquePtr<TexCompressionETC2SignedR11>();
 			break;
 
 		case EF_ETC2_GR11:
+			codec = MakeUniquePtr<TexCompressionETC2RG11>();
+			break;
+
 		case EF_SIGNED_ETC2_GR11:
-			// TODO
-			KFL_UNREACHABLE("Not implemented");
+			codec = MakeUniquePtr<TexCompressionETC2SignedRG11>();
 			break;
 
 		default:
@@ -931,19 +943,24 @@ namespace
 			break;
 				
 		case EF_BC4:
-		case EF_ETC2_R11:
 			dst_format = EF_R8;
 			break;
 
 		case EF_BC5:
-		case EF_ETC2_GR11:
 			dst_format = EF_GR8;
 			break;
 
+		case EF_ETC2_R11:
+			dst_format = EF_R16;
+			break;
+
+		case EF_ETC2_GR11:
+			dst_format = EF_GR16;
+			break;
+
 		case EF_SIGNED_BC1:
 		case EF_SIGNED_BC2:
 		case EF_SIGNED_BC3:
-		case EF_SIGNED_ETC2_R11:
 			dst_format = EF_SIGNED_ABGR8;
 			break;
 
@@ -955,6 +972,14 @@ namespace
 			dst_format = EF_SIGNED_GR8;
 			break;
 
+		case EF_SIGNED_ETC2_R11:
+			dst_format = EF_SIGNED_R16;
+			break;
+
+		case EF_SIGNED_ETC2_GR11:
+			dst_format = EF_SIGNED_GR16;
+			break;
+
 		case EF_BC1_SRGB:
 		case EF_BC2_SRGB:
 		case EF_BC3_SRGB:
@@ -1038,20 +1063,23 @@ namespace
 
 		case EF_ETC2_ABGR8:
 		case EF_ETC2_ABGR8_SRGB:
-			// TODO
-			KFL_UNREACHABLE("Not implemented");
+			codec = MakeUniquePtr<TexCompressionETC2RGBA8>();
 			break;
 
 		case EF_ETC2_R11:
+			codec = MakeUniquePtr<TexCompressionETC2R11>();
+			break;
+
 		case EF_SIGNED_ETC2_R11:
-			// TODO
-			KFL_UNREACHABLE("Not implemented");
+			codec = MakeUniquePtr<TexCompressionETC2SignedR11>();
 			break;
 
 		case EF_ETC2_GR11:
+			codec = MakeUniquePtr<TexCompressionETC2RG11>();
+			break;
+
 		case EF_SIGNED_ETC2_GR11:
-			// TODO
-			KFL_UNREACHABLE("Not implemented");
+			codec = MakeUniquePtr<TexCompressionETC2SignedRG11>();
 			break;
 
 		default:
@@ -1096,6 +1124,11 @@ namespace
 			std::shared_ptr<TexData> tex_data;
 
 			std::shared_ptr<TexturePtr> tex;
+			// A streamed texture is only referred to weakly once it's loaded, so the streamer sees when it's dropped
+			std::shared_ptr<std::weak_ptr<Texture>> streamed_tex;
+
+			// -1 if the texture is not streamed
+			uint32_t stream_handle;
 		};
 
 	public:
@@ -1105,6 +1138,8 @@ namespace
 			tex_desc_.access_hint = access_hint;
 			tex_desc_.tex_data = MakeSharedPtr<TexDesc::TexData>();
 			tex_desc_.tex = MakeSharedPtr<TexturePtr>();
+			tex_desc_.streamed_tex = MakeSharedPtr<std::weak_ptr<Texture>>();
+			tex_desc_.stream_handle = static_cast<uint32_t>(-1);
 		}
 
 		uint64_t Type() const
@@ -1141,93 +1176,26 @@ namespace
 				tex_data.init_data.resize(1);
 			}
 
-			uint32_t array_size = tex_data.array_size;
-			if (Texture::TT_Cube == tex_data.type)
+			tex_data.format = TargetFormat(tex_data.format, caps);
+			if (!caps.texture_format_support(tex_data.format))
 			{
-				array_size *= 6;
+				LogError("%s's format (%ld) is not supported.",
+					tex_desc_.res_name.c_str(), tex_data.format);
 			}
 
-			if (((EF_BC5 == tex_data.format) && !caps.texture_format_support(EF_BC5))
-				|| ((EF_BC5_SRGB == tex_data.format) && !caps.texture_format_support(EF_BC5_SRGB)))
-			{
-				if (IsSRGB(tex_data.format))
-				{
-					tex_data.format = EF_BC3_SRGB;
-				}
-				else
-				{
-					tex_data.format = EF_BC3;
-				}
-			}
-			if (((EF_BC4 == tex_data.format) && !caps.texture_format_support(EF_BC4))
-				|| ((EF_BC4_SRGB == tex_data.format) && !caps.texture_format_support(EF_BC4_SRGB)))
+			// A streamed texture starts with its tail, the streamer replaces it with finer ones when they are needed
+			TextureStreamer* streamer = Context::Instance().TextureStreamerInstance();
+			if (streamer && TextureStreamer::Streamable(tex_data.type, tex_data.num_mipmaps, tex_desc_.access_hint))
 			{
-				if (IsSRGB(tex_data.format))
-				{
-					tex_data.format = EF_BC1_SRGB;
-				}
-				else
-				{
-					tex_data.format = EF_BC1;
-				}
+				*tex_desc_.tex = this->CreateTexture(streamer->FirstLevel(tex_data.width, tex_data.height,
+					tex_data.num_mipmaps));
+				tex_desc_.stream_handle = streamer->AddTexture(*tex_desc_.tex, tex_data.type, tex_data.width, tex_data.height,
+					tex_data.num_mipmaps, tex_data.array_size, tex_data.format, tex_desc_.access_hint);
 			}
-
-			static ElementFormat const convert_fmts[][2] =
-			{
-				{ EF_BC1, EF_ARGB8 },
-				{ EF_BC1_SRGB, EF_ARGB8_SRGB },
-				{ EF_BC2, EF_ARGB8 },
-				{ EF_BC2_SRGB, EF_ARGB8_SRGB },
-				{ EF_BC3, EF_ARGB8 },
-				{ EF_BC3_SRGB, EF_ARGB8_SRGB },
-				{ EF_BC4, EF_R8 },
-				{ EF_BC4_SRGB, EF_R8 },
-				{ EF_SIGNED_BC4, EF_SIGNED_R8 },
-				{ EF_BC5, EF_GR8 },
-				{ EF_BC5_SRGB, EF_GR8 },
-				{ EF_SIGNED_BC5, EF_SIGNED_GR8 },
-				{ EF_BC6, EF_ABGR16F },
-				{ EF_SIGNED_BC6, EF_ABGR16F },
-				{ EF_BC7, EF_ARGB8 },
-				{ EF_BC7_SRGB, EF_ARGB8 },
-				{ EF_ETC1, EF_ARGB8 },
-				{ EF_ETC2_BGR8, EF_ARGB8 },
-				{ EF_ETC2_BGR8_SRGB, EF_ARGB8_SRGB },
-				{ EF_ETC2_A1BGR8, EF_ARGB8 },
-				{ EF_ETC2_A1BGR8_SRGB, EF_ARGB8_SRGB },
-				{ EF_ETC2_ABGR8, EF_ARGB8 },
-				{ EF_ETC2_ABGR8_SRGB, EF_ARGB8_SRGB },
-				{ EF_R8, EF_ARGB8 },
-				{ EF_SIGNED_R8, EF_SIGNED_ABGR8 },
-				{ EF_GR8, EF_ARGB8 },
-				{ EF_SIGNED_GR8, EF_SIGNED_ABGR8 },
-				{ EF_ARGB8_SRGB, EF_ARGB8 },
-				{ EF_ARGB8, EF_ABGR8 },
-				{ EF_R16, EF_R16F },
-				{ EF_R16F, EF_R8 },
-			};
-			while (!caps.texture_format_support(tex_data.format))
+			else
 			{
-				bool found = false;
-				for (size_t i = 0; i < sizeof(convert_fmts) / sizeof(convert_fmts[0][0]) / 2; ++ i)
-				{
-					if (convert_fmts[i][0] == tex_data.format)
-					{
-						tex_data.format = convert_fmts[i][1];
-						found = true;
-						break;
-					}
-				}
-
-				if (!found)
-				{
-					LogError("%s's format (%ld) is not supported.",
-						tex_desc_.res_name.c_str(), tex_data.format);
-					break;
-				}
+				*tex_desc_.tex = this->CreateTexture(0);
 			}
-
-			*tex_desc_.tex = this->CreateTexture();
 			return *tex_desc_.tex;
 		}
 
@@ -1240,10 +1208,27 @@ namespace
 		{
 			std::lock_guard<std::mutex> lock(main_thread_stage_mutex_);
 
-			TexturePtr const & tex = *tex_desc_.tex;
-			if (!tex || !tex->HWResourceReady())
+			TexturePtr const tex = *tex_desc_.tex;
+			if (!tex)
+			{
+				// A streamed texture, loaded through another desc
+				return std::static_pointer_cast<void>(tex_desc_.streamed_tex->lock());
+			}
+			if (!tex->HWResourceReady())
 			{
-				tex->CreateHWResource(tex_desc_.tex_data->init_data);
+				TextureStreamer* streamer = Context::Instance().TextureStreamerInstance();
+				if (streamer && (tex_desc_.stream_handle != static_cast<uint32_t>(-1)))
+				{
+					// The streamer keeps the whole mip chain
+					streamer->TextureLoaded(tex_desc_.stream_handle, std::move(tex_desc_.tex_data->init_data),
+						std::move(tex_desc_.tex_data->data_block));
+					*tex_desc_.streamed_tex = tex;
+					tex_desc_.tex->reset();
+				}
+				else
+				{
+					tex->CreateHWResource(tex_desc_.tex_data->init_data);
+				}
 				tex_desc_.tex_data.reset();
 			}
 			return std::static_pointer_cast<void>(tex);
@@ -1274,6 +1259,8 @@ namespace
 			tex_desc_.access_hint = tld.tex_desc_.access_hint;
 			tex_desc_.tex_data = tld.tex_desc_.tex_data;
 			tex_desc_.tex = tld.tex_desc_.tex;
+			tex_desc_.streamed_tex = tld.tex_desc_.streamed_tex;
+			tex_desc_.stream_handle = tld.tex_desc_.stream_handle;
 		}
 
 		std::shared_ptr<void> CloneResourceFrom(std::shared_ptr<void> const & resource)
@@ -1283,7 +1270,14 @@ namespace
 
 		virtual std::shared_ptr<void> Resource() const override
 		{
-			return *tex_desc_.tex;
+			if (*tex_desc_.tex)
+			{
+				return *tex_desc_.tex;
+			}
+			else
+			{
+				return tex_desc_.streamed_tex->lock();
+			}
 		}
 
 	private:
@@ -1291,77 +1285,106 @@ namespace
 		{
 			TexDesc::TexData& tex_data = *tex_desc_.tex_data;
 
-			LoadTexture(tex_desc_.res_name, tex_data.type,
-				tex_data.width, tex_data.height, tex_data.depth,
-				tex_data.num_mipmaps, tex_data.array_size, tex_data.format,
-				tex_data.init_data, tex_data.data_block);
-
 			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 			RenderDeviceCaps const & caps = rf.RenderEngineInstance().DeviceCaps();
-			if ((Texture::TT_3D == tex_data.type) && (caps.max_texture_depth < tex_data.depth))
-			{
-				tex_data.type = Texture::TT_2D;
-				tex_data.height *= tex_data.depth;
-				tex_data.depth = 1;
-				tex_data.num_mipmaps = 1;
-				tex_data.init_data.resize(1);
-			}
 
-			uint32_t array_size = tex_data.array_size;
-			if (Texture::TT_Cube == tex_data.type)
+			ResIdentifierPtr tex_res = ResLoader::Instance().Open(tex_desc_.res_name);
+			ElementFormat target_format;
+			bool flatten_3d;
 			{
-				array_size *= 6;
-			}
+				Texture::TextureType type;
+				uint32_t width, height, depth, num_mipmaps, array_size;
+				ElementFormat format;
+				uint32_t row_pitch, slice_pitch;
+				GetImageInfo(tex_res, type, width, height, depth, num_mipmaps, array_size, format,
+					row_pitch, slice_pitch);
+				tex_res->seekg(0, std::ios_base::beg);
 
-			if (((EF_BC5 == tex_data.format) && !caps.texture_format_support(EF_BC5))
-				|| ((EF_BC5_SRGB == tex_data.format) && !caps.texture_format_support(EF_BC5_SRGB)))
-			{
-				BC1Block tmp;
-				for (size_t i = 0; i < tex_data.init_data.size(); ++ i)
+				target_format = TargetFormat(format, caps);
+				if (format == target_format)
 				{
-					for (size_t j = 0; j < tex_data.init_data[i].slice_pitch; j += sizeof(BC4Block) * 2)
-					{
-						char* p = static_cast<char*>(const_cast<void*>(tex_data.init_data[i].data)) + j;
-
-						BC4ToBC1G(tmp, *reinterpret_cast<BC4Block const *>(p + sizeof(BC4Block)));
-						std::memcpy(p + sizeof(BC4Block), &tmp, sizeof(BC1Block));
-					}
+					target_format = EF_Unknown;
 				}
+				flatten_3d = (Texture::TT_3D == type) && (caps.max_texture_depth < depth);
+			}
 
-				if (IsSRGB(tex_data.format))
-				{
-					tex_data.format = EF_BC3_SRGB;
-				}
-				else
+			// Transcoded data from an earlier run, if it is newer than the source
+			std::string cache_name;
+			ResIdentifierPtr cache_res;
+			if (target_format != EF_Unknown)
+			{
+				cache_name = this->TranscodedCacheName(target_format, flatten_3d);
+				cache_res = ResLoader::Instance().Open(cache_name);
+				if (cache_res && (cache_res->Timestamp() < tex_res->Timestamp()))
 				{
-					tex_data.format = EF_BC3;
+					cache_res.reset();
 				}
 			}
-			if (((EF_BC4 == tex_data.format) && !caps.texture_format_support(EF_BC4))
-				|| ((EF_BC4_SRGB == tex_data.format) && !caps.texture_format_support(EF_BC4_SRGB)))
-			{
-				BC1Block tmp;
-				for (size_t i = 0; i < tex_data.init_data.size(); ++ i)
-				{
-					for (size_t j = 0; j < tex_data.init_data[i].slice_pitch; j += sizeof(BC4Block))
-					{
-						char* p = static_cast<char*>(const_cast<void*>(tex_data.init_data[i].data)) + j;
 
-						BC4ToBC1G(tmp, *reinterpret_cast<BC4Block const *>(p));
-						std::memcpy(p, &tmp, sizeof(BC1Block));
-					}
-				}
+			if (cache_res)
+			{
+				LoadTexture(cache_res, tex_data.type,
+					tex_data.width, tex_data.height, tex_data.depth,
+					tex_data.num_mipmaps, tex_data.array_size, tex_data.format,
+					tex_data.init_data, tex_data.data_block);
+			}
+			else
+			{
+				LoadTexture(tex_res, tex_data.type,
+					tex_data.width, tex_data.height, tex_data.depth,
+					tex_data.num_mipmaps, tex_data.array_size, tex_data.format,
+					tex_data.init_data, tex_data.data_block);
 
-				if (IsSRGB(tex_data.format))
+				if (flatten_3d)
 				{
-					tex_data.format = EF_BC1_SRGB;
+					tex_data.type = Texture::TT_2D;
+					tex_data.height *= tex_data.depth;
+					tex_data.depth = 1;
+					tex_data.num_mipmaps = 1;
+					tex_data.init_data.resize(1);
 				}
-				else
+
+				if (target_format != EF_Unknown)
 				{
-					tex_data.format = EF_BC1;
+					ElementFormat const block_format = BlockTranscodedFormat(tex_data.format, caps);
+					if (block_format != tex_data.format)
+					{
+						this->BlockTranscode(block_format);
+					}
+					if (target_format != tex_data.format)
+					{
+						this->Transcode(target_format);
+					}
+
+					this->SaveTranscodedCache(cache_name);
 				}
 			}
 
+			if (caps.multithread_res_creating_support)
+			{
+				this->MainThreadStage();
+			}
+		}
+
+		// BC5 -> BC3 and BC4 -> BC1 are done directly on the blocks
+		static ElementFormat BlockTranscodedFormat(ElementFormat format, RenderDeviceCaps const & caps)
+		{
+			if (((EF_BC5 == format) && !caps.texture_format_support(EF_BC5))
+				|| ((EF_BC5_SRGB == format) && !caps.texture_format_support(EF_BC5_SRGB)))
+			{
+				format = IsSRGB(format) ? EF_BC3_SRGB : EF_BC3;
+			}
+			if (((EF_BC4 == format) && !caps.texture_format_support(EF_BC4))
+				|| ((EF_BC4_SRGB == format) && !caps.texture_format_support(EF_BC4_SRGB)))
+			{
+				format = IsSRGB(format) ? EF_BC1_SRGB : EF_BC1;
+			}
+			return format;
+		}
+
+		// Follows the fallback chain until a supported format, so the data is converted only once
+		static ElementFormat TargetFormat(ElementFormat format, RenderDeviceCaps const & caps)
+		{
 			static ElementFormat const convert_fmts[][2] =
 			{
 				{ EF_BC1, EF_ARGB8 },
@@ -1387,6 +1410,10 @@ namespace
 				{ EF_ETC2_A1BGR8_SRGB, EF_ARGB8_SRGB },
 				{ EF_ETC2_ABGR8, EF_ARGB8 },
 				{ EF_ETC2_ABGR8_SRGB, EF_ARGB8_SRGB },
+				{ EF_ETC2_R11, EF_R16 },
+				{ EF_SIGNED_ETC2_R11, EF_SIGNED_R16 },
+				{ EF_ETC2_GR11, EF_GR16 },
+				{ EF_SIGNED_ETC2_GR11, EF_SIGNED_GR16 },
 				{ EF_R8, EF_ARGB8 },
 				{ EF_SIGNED_R8, EF_SIGNED_ABGR8 },
 				{ EF_GR8, EF_ARGB8 },
@@ -1395,150 +1422,218 @@ namespace
 				{ EF_ARGB8, EF_ABGR8 },
 				{ EF_R16, EF_R16F },
 				{ EF_R16F, EF_R8 },
+				{ EF_SIGNED_R16, EF_SIGNED_R8 },
+				{ EF_GR16, EF_GR8 },
+				{ EF_SIGNED_GR16, EF_SIGNED_GR8 },
 			};
-			while (!caps.texture_format_support(tex_data.format))
+
+			format = BlockTranscodedFormat(format, caps);
+			while (!caps.texture_format_support(format))
 			{
 				bool found = false;
 				for (size_t i = 0; i < sizeof(convert_fmts) / sizeof(convert_fmts[0][0]) / 2; ++ i)
 				{
-					if (convert_fmts[i][0] == tex_data.format)
+					if (convert_fmts[i][0] == format)
 					{
-						uint32_t const src_elem_size = NumFormatBytes(convert_fmts[i][0]);
-						uint32_t const dst_elem_size = NumFormatBytes(convert_fmts[i][1]);
+						format = convert_fmts[i][1];
+						found = true;
+						break;
+					}
+				}
 
-						bool needs_new_data_block = (src_elem_size < dst_elem_size)
-							|| (IsCompressedFormat(convert_fmts[i][0]) && !IsCompressedFormat(convert_fmts[i][1]));
+				if (!found)
+				{
+					break;
+				}
+			}
+			return format;
+		}
 
-						std::vector<uint8_t> new_data_block;
-						std::vector<uint32_t> new_sub_res_start;
-						if (needs_new_data_block)
-						{
-							uint32_t new_data_block_size = 0;
-							new_sub_res_start.resize(array_size * tex_data.num_mipmaps);
+		// Runs func(sub_res, level) on all sub resources, largest levels first, spread over the thread pool
+		template <typename Func>
+		void ParallelForSubresources(Func const & func)
+		{
+			TexDesc::TexData const & tex_data = *tex_desc_.tex_data;
+			uint32_t const num_mipmaps = tex_data.num_mipmaps;
+			uint32_t const num_sub_res = static_cast<uint32_t>(tex_data.init_data.size());
+			uint32_t const num_slices = num_sub_res / num_mipmaps;
 
-							for (size_t index = 0; index < array_size; ++ index)
-							{
-								uint32_t width = tex_data.width;
-								uint32_t height = tex_data.height;
-								for (size_t level = 0; level < tex_data.num_mipmaps; ++ level)
-								{
-									uint32_t slice_pitch;
-									if (IsCompressedFormat(convert_fmts[i][1]))
-									{
-										slice_pitch = ((width + 3) & ~3) * (height + 3) / 4 * dst_elem_size;
-									}
-									else
-									{
-										slice_pitch = width * height * dst_elem_size;
-									}
+			static CPUInfo const cpu;
+			parallel_for(Context::Instance().ThreadPool(), static_cast<uint32_t>(std::max(cpu.NumHWThreads(), 1)), num_sub_res,
+				[&func, num_mipmaps, num_slices](uint32_t task)
+				{
+					uint32_t const level = task / num_slices;
+					uint32_t const slice = task % num_slices;
+					func(slice * num_mipmaps + level, level);
+				});
+		}
 
-									size_t sub_res = index * tex_data.num_mipmaps + level;
-									new_sub_res_start[sub_res] = new_data_block_size;
-									new_data_block_size += slice_pitch;
+		void BlockTranscode(ElementFormat block_format)
+		{
+			TexDesc::TexData& tex_data = *tex_desc_.tex_data;
 
-									width = std::max<uint32_t>(1U, width / 2);
-									height = std::max<uint32_t>(1U, height / 2);
-								}
-							}
+			bool const bc5 = (EF_BC5 == tex_data.format) || (EF_BC5_SRGB == tex_data.format);
+			this->ParallelForSubresources([&tex_data, bc5](uint32_t sub_res, uint32_t level)
+				{
+					KFL_UNUSED(level);
 
-							new_data_block.resize(new_data_block_size);
-						}
+					ElementInitData const & init_data = tex_data.init_data[sub_res];
+					uint32_t const block_size = bc5 ? sizeof(BC4Block) * 2 : sizeof(BC4Block);
+					uint32_t const bc4_offset = bc5 ? sizeof(BC4Block) : 0;
+					BC1Block tmp;
+					for (size_t j = 0; j < init_data.slice_pitch; j += block_size)
+					{
+						char* p = static_cast<char*>(const_cast<void*>(init_data.data)) + j + bc4_offset;
 
-						for (size_t index = 0; index < array_size; ++ index)
-						{
-							uint32_t width = tex_data.width;
-							uint32_t height = tex_data.height;
-							uint32_t depth = tex_data.depth;
-							for (size_t level = 0; level < tex_data.num_mipmaps; ++ level)
-							{
-								uint32_t row_pitch, slice_pitch;
-								if (IsCompressedFormat(convert_fmts[i][1]))
-								{
-									row_pitch = ((width + 3) & ~3) * dst_elem_size;
-									slice_pitch = (height + 3) / 4 * row_pitch;
-								}
-								else
-								{
-									row_pitch = width * dst_elem_size;
-									slice_pitch = height * row_pitch;
-								}
+						BC4ToBC1G(tmp, *reinterpret_cast<BC4Block const *>(p));
+						std::memcpy(p, &tmp, sizeof(BC1Block));
+					}
+				});
 
-								size_t sub_res = index * tex_data.num_mipmaps + level;
-								uint8_t* sub_data_block;
-								if (needs_new_data_block)
-								{
-									sub_data_block = &new_data_block[new_sub_res_start[sub_res]];
-								}
-								else
-								{
-									sub_data_block = static_cast<uint8_t*>(
-										const_cast<void*>(tex_data.init_data[sub_res].data));
-								}
-								ResizeTexture(sub_data_block, row_pitch, slice_pitch,
-									convert_fmts[i][1], width, height, depth,
-									tex_data.init_data[sub_res].data,
-									tex_data.init_data[sub_res].row_pitch,
-									tex_data.init_data[sub_res].slice_pitch,
-									convert_fmts[i][0], width, height, depth, false);
-
-								width = std::max<uint32_t>(1U, width / 2);
-								height = std::max<uint32_t>(1U, height / 2);
-								depth = std::max<uint32_t>(1U, depth / 2);
-
-								tex_data.init_data[sub_res].row_pitch = row_pitch;
-								tex_data.init_data[sub_res].slice_pitch = slice_pitch;
-								tex_data.init_data[sub_res].data = sub_data_block;
-							}
-						}
+			tex_data.format = block_format;
+		}
 
-						if (needs_new_data_block)
-						{
-							tex_data.data_block.swap(new_data_block);
-						}
+		void Transcode(ElementFormat target_format)
+		{
+			TexDesc::TexData& tex_data = *tex_desc_.tex_data;
 
-						tex_data.format = convert_fmts[i][1];
-						found = true;
-						break;
+			ElementFormat const src_format = tex_data.format;
+			uint32_t const src_elem_size = NumFormatBytes(src_format);
+			uint32_t const dst_elem_size = NumFormatBytes(target_format);
+			bool const dst_compressed = IsCompressedFormat(target_format);
+
+			auto sub_res_pitches = [&tex_data, dst_elem_size, dst_compressed](uint32_t level,
+				uint32_t& width, uint32_t& height, uint32_t& depth, uint32_t& row_pitch, uint32_t& slice_pitch)
+				{
+					width = std::max<uint32_t>(1U, tex_data.width >> level);
+					height = std::max<uint32_t>(1U, tex_data.height >> level);
+					depth = std::max<uint32_t>(1U, tex_data.depth >> level);
+					if (dst_compressed)
+					{
+						row_pitch = ((width + 3) & ~3) * dst_elem_size;
+						slice_pitch = (height + 3) / 4 * row_pitch;
 					}
-				}
+					else
+					{
+						row_pitch = width * dst_elem_size;
+						slice_pitch = height * row_pitch;
+					}
+				};
 
-				if (!found)
+			// Converts in place if the new elements are not larger
+			bool const needs_new_data_block = (src_elem_size < dst_elem_size)
+				|| (IsCompressedFormat(src_format) && !dst_compressed);
+
+			uint32_t const num_sub_res = static_cast<uint32_t>(tex_data.init_data.size());
+			std::vector<uint8_t> new_data_block;
+			std::vector<size_t> new_sub_res_start(num_sub_res);
+			if (needs_new_data_block)
+			{
+				size_t new_data_block_size = 0;
+				for (uint32_t sub_res = 0; sub_res < num_sub_res; ++ sub_res)
 				{
-					break;
+					uint32_t width, height, depth, row_pitch, slice_pitch;
+					sub_res_pitches(sub_res % tex_data.num_mipmaps, width, height, depth, row_pitch, slice_pitch);
+
+					new_sub_res_start[sub_res] = new_data_block_size;
+					new_data_block_size += slice_pitch * depth;
 				}
+
+				new_data_block.resize(new_data_block_size);
 			}
 
-			if (caps.multithread_res_creating_support)
+			this->ParallelForSubresources([&tex_data, &new_data_block, &new_sub_res_start, &sub_res_pitches,
+					needs_new_data_block, src_format, target_format](uint32_t sub_res, uint32_t level)
+				{
+					uint32_t width, height, depth, row_pitch, slice_pitch;
+					sub_res_pitches(level, width, height, depth, row_pitch, slice_pitch);
+
+					ElementInitData& init_data = tex_data.init_data[sub_res];
+					uint8_t* sub_data_block;
+					if (needs_new_data_block)
+					{
+						sub_data_block = &new_data_block[new_sub_res_start[sub_res]];
+					}
+					else
+					{
+						sub_data_block = static_cast<uint8_t*>(const_cast<void*>(init_data.data));
+					}
+					ResizeTexture(sub_data_block, row_pitch, slice_pitch, target_format, width, height, depth,
+						init_data.data, init_data.row_pitch, init_data.slice_pitch, src_format, width, height, depth,
+						false);
+
+					init_data.row_pitch = row_pitch;
+					init_data.slice_pitch = slice_pitch;
+					init_data.data = sub_data_block;
+				});
+
+			if (needs_new_data_block)
 			{
-				this->MainThreadStage();
+				tex_data.data_block.swap(new_data_block);
 			}
+			tex_data.format = target_format;
+		}
+
+		// The source, the transcoder version and everything in the caps that changes the output are in the name
+		std::string TranscodedCacheName(ElementFormat target_format, bool flatten_3d) const
+		{
+			std::string res_name = ResLoader::Instance().Locate(tex_desc_.res_name);
+			if (res_name.empty())
+			{
+				res_name = tex_desc_.res_name;
+			}
+
+			return ResLoader::Instance().LocalFolder() + "TexCache/"
+				+ std::to_string(HashRange(res_name.begin(), res_name.end())) + "_"
+				+ std::to_string(static_cast<uint64_t>(target_format))
+				+ (flatten_3d ? "_2d" : "") + "_v" + std::to_string(TRANSCODED_CACHE_VERSION) + ".dds";
+		}
+
+		void SaveTranscodedCache(std::string const & cache_name) const
+		{
+			TexDesc::TexData const & tex_data = *tex_desc_.tex_data;
+
+			// An interrupted write never leaves a truncated cache behind, and two loaders of the same texture don't write
+			// into the same file. The cache is optional, if it's not written the next run transcodes again.
+			WriteFileAtomically(cache_name, [&cache_name, &tex_data](std::string const & tmp_name)
+				{
+					std::filesystem::create_directories(std::filesystem::path(cache_name).parent_path());
+					SaveTexture(tmp_name, tex_data.type, tex_data.width, tex_data.height, tex_data.depth,
+						tex_data.num_mipmaps, tex_data.array_size, tex_data.format, tex_data.init_data);
+				});
 		}
 
-		TexturePtr CreateTexture()
+		// Without the levels finer than first_level
+		TexturePtr CreateTexture(uint32_t first_level)
 		{
 			TexDesc::TexData const & tex_data = *tex_desc_.tex_data;
 
+			uint32_t const width = std::max(1U, tex_data.width >> first_level);
+			uint32_t const height = std::max(1U, tex_data.height >> first_level);
+			uint32_t const depth = std::max(1U, tex_data.depth >> first_level);
+			uint32_t const num_mipmaps = tex_data.num_mipmaps - first_level;
+
 			TexturePtr texture;
 			RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 			switch (tex_data.type)
 			{
 			case Texture::TT_1D:
-				texture = rf.MakeDelayCreationTexture1D(tex_data.width, tex_data.num_mipmaps, tex_data.array_size,
+				texture = rf.MakeDelayCreationTexture1D(width, num_mipmaps, tex_data.array_size,
 					tex_data.format, 1, 0, tex_desc_.access_hint);
 				break;
 
 			case Texture::TT_2D:
-				texture = rf.MakeDelayCreationTexture2D(tex_data.width, tex_data.height, tex_data.num_mipmaps, tex_data.array_size,
+				texture = rf.MakeDelayCreationTexture2D(width, height, num_mipmaps, tex_data.array_size,
 					tex_data.format, 1, 0, tex_desc_.access_hint);
 				break;
 
 			case Texture::TT_3D:
-				texture = rf.MakeDelayCreationTexture3D(tex_data.width, tex_data.height, tex_data.depth, tex_data.num_mipmaps,
+				texture = rf.MakeDelayCreationTexture3D(width, height, depth, num_mipmaps,
 					tex_data.array_size, tex_data.format, 1, 0, tex_desc_.access_hint);
 				break;
 
 			case Texture::TT_Cube:
-				texture = rf.MakeDelayCreationTextureCube(tex_data.width, tex_data.num_mipmaps, tex_data.array_size,
+				texture = rf.MakeDelayCreationTextureCube(width, num_mipmaps, tex_data.array_size,
 					tex_data.format, 1, 0, tex_desc_.access_hint);
 				break;
 
@@ -3352,15 +3447,21 @@ namespace KlayGE
 				break;
 				
 			case EF_BC4:
-			case EF_ETC2_R11:
 				dst_cpu_format = EF_R8;
 				break;
 
 			case EF_BC5:
-			case EF_ETC2_GR11:
 				dst_cpu_format = EF_GR8;
 				break;
 
+			case EF_ETC2_R11:
+				dst_cpu_format = EF_R16;
+				break;
+
+			case EF_ETC2_GR11:
+				dst_cpu_format = EF_GR16;
+				break;
+
 			case EF_SIGNED_BC1:
 			case EF_SIGNED_BC2:
 			case EF_SIGNED_BC3:
@@ -3368,7 +3469,6 @@ namespace KlayGE
 				break;
 
 			case EF_SIGNED_BC4:
-			case EF_SIGNED_ETC2_R11:
 				dst_cpu_format = EF_SIGNED_R8;
 				break;
 
@@ -3376,6 +3476,14 @@ namespace KlayGE
 				dst_cpu_format = EF_SIGNED_GR8;
 				break;
 
+			case EF_SIGNED_ETC2_R11:
+				dst_cpu_format = EF_SIGNED_R16;
+				break;
+
+			case EF_SIGNED_ETC2_GR11:
+				dst_cpu_format = EF_SIGNED_GR16;
+				break;
+
 			case EF_BC1_SRGB:
 			case EF_BC2_SRGB:
 			case EF_BC3_SRGB:
@@ -3397,7 +3505,7 @@ namespace KlayGE
 				KFL_UNREACHABLE("Invalid destination format");
 			}
 
-			dst_cpu_row_pitch = dst_width * NumFormatBytes(src_cpu_format);
+			dst_cpu_row_pitch = dst_width * NumFormatBytes(dst_cpu_format);
 			dst_cpu_slice_pitch = dst_cpu_row_pitch * dst_height;
 			dst_cpu_data_block.resize(dst_depth * dst_cpu_slice_pitch);
 			dst_cpu_data = &dst_cpu_data_block[0];
@@ -3413,10 +3521,17 @@ namespace KlayGE
 		uint8_t const * src_ptr = static_cast<uint8_t const *>(src_cpu_data);
 		uint8_t* dst_ptr = static_cast<uint8_t*>(dst_cpu_data);
 		uint32_t const src_elem_size = NumFormatBytes(src_cpu_format);
-		uint32_t const dst_elem_size = NumFormatBytes(dst_cpu_format);
 
-		if (!linear && (src_cpu_format == dst_cpu_format))
+		bool const same_size = (src_width == dst_width) && (src_height == dst_height) && (src_depth == dst_depth);
+		if (!linear || same_size)
 		{
+			// Point sampling, or no resampling at all. Converts row by row, using a direct converter when there is one.
+			std::vector<uint8_t> sampled_row;
+			if ((src_width != dst_width) && (src_cpu_format != dst_cpu_format))
+			{
+				sampled_row.resize(dst_width * src_elem_size);
+			}
+
 			for (uint32_t z = 0; z < dst_depth; ++ z)
 			{
 				float fz = static_cast<float>(z + 0.5f) / dst_depth * src_depth;
@@ -3432,15 +3547,20 @@ namespace KlayGE
 
 					if (src_width == dst_width)
 					{
-						std::memcpy(dst_p, src_p, src_width * src_elem_size);
+						ConvertFormat(src_cpu_format, src_p, src_width, dst_cpu_format, dst_p);
 					}
 					else
 					{
-						for (uint32_t x = 0; x < dst_width; ++ x, dst_p += dst_elem_size)
+						uint8_t* sampled_p = sampled_row.empty() ? dst_p : &sampled_row[0];
+						for (uint32_t x = 0; x < dst_width; ++ x, sampled_p += src_elem_size)
 						{
 							float fx = static_cast<float>(x + 0.5f) / dst_width * src_width;
 							uint32_t sx = std::min(static_cast<uint32_t>(fx), src_width - 1);
-							std::memcpy(dst_p, src_p + sx * src_elem_size, src_elem_size);
+							std::memcpy(sampled_p, src_p + sx * src_elem_size, src_elem_size);
+						}
+						if (!sampled_row.empty())
+						{
+							ConvertFormat(src_cpu_format, &sampled_row[0], dst_width, dst_cpu_format, dst_p);
 						}
 					}
 				}
@@ -3460,62 +3580,39 @@ namespace KlayGE
 				}
 			}
 
+			// Only bilinear resampling gets here, point sampling is handled above
 			std::vector<Color> dst_32f(dst_width * dst_height * dst_depth);
-			if (linear)
-			{
-				for (uint32_t z = 0; z < dst_depth; ++ z)
-				{
-					float fz = static_cast<float>(z) / dst_depth * src_depth;
-					uint32_t sz0 = static_cast<uint32_t>(fz);
-					uint32_t sz1 = MathLib::clamp<uint32_t>(sz0 + 1, 0, src_depth - 1);
-					float weight_z = fz - sz0;
-							
-					for (uint32_t y = 0; y < dst_height; ++ y)
-					{
-						float fy = static_cast<float>(y) / dst_height * src_height;
-						uint32_t sy0 = static_cast<uint32_t>(fy);
-						uint32_t sy1 = MathLib::clamp<uint32_t>(sy0 + 1, 0, src_height - 1);
-						float weight_y = fy - sy0;
-							
-						for (uint32_t x = 0; x < dst_width; ++ x)
-						{
-							float fx = static_cast<float>(x) / dst_width * src_width;
-							uint32_t sx0 = static_cast<uint32_t>(fx);
-							uint32_t sx1 = MathLib::clamp<uint32_t>(sx0 + 1, 0, src_width - 1);
-							float weight_x = fx - sx0;
-							Color clr_x00 = MathLib::lerp(src_32f[(sz0 * src_height + sy0) * src_width + sx0],
-								src_32f[(sz0 * src_height + sy0) * src_width + sx1], weight_x);
-							Color clr_x01 = MathLib::lerp(src_32f[(sz0 * src_height + sy1) * src_width + sx0],
-								src_32f[(sz0 * src_height + sy1) * src_width + sx1], weight_x);
-							Color clr_y0 = MathLib::lerp(clr_x00, clr_x01, weight_y);
-							Color clr_x10 = MathLib::lerp(src_32f[(sz1 * src_height + sy0) * src_width + sx0],
-								src_32f[(sz1 * src_height + sy0) * src_width + sx1], weight_x);
-							Color clr_x11 = MathLib::lerp(src_32f[(sz1 * src_height + sy1) * src_width + sx0],
-								src_32f[(sz1 * src_height + sy1) * src_width + sx1], weight_x);
-							Color clr_y1 = MathLib::lerp(clr_x10, clr_x11, weight_y);
-							dst_32f[(z * dst_height + y) * dst_width + x] = MathLib::lerp(clr_y0, clr_y1, weight_z);
-						}
-					}
-				}
-			}
-			else
+			for (uint32_t z = 0; z < dst_depth; ++ z)
 			{
-				for (uint32_t z = 0; z < dst_depth; ++ z)
+				float fz = static_cast<float>(z) / dst_depth * src_depth;
+				uint32_t sz0 = static_cast<uint32_t>(fz);
+				uint32_t sz1 = MathLib::clamp<uint32_t>(sz0 + 1, 0, src_depth - 1);
+				float weight_z = fz - sz0;
+						
+				for (uint32_t y = 0; y < dst_height; ++ y)
 				{
-					float fz = static_cast<float>(z + 0.5f) / dst_depth * src_depth;
-					uint32_t sz = std::min(static_cast<uint32_t>(fz), src_depth - 1);
-
-					for (uint32_t y = 0; y < dst_height; ++ y)
+					float fy = static_cast<float>(y) / dst_height * src_height;
+					uint32_t sy0 = static_cast<uint32_t>(fy);
+					uint32_t sy1 = MathLib::clamp<uint32_t>(sy0 + 1, 0, src_height - 1);
+					float weight_y = fy - sy0;
+						
+					for (uint32_t x = 0; x < dst_width; ++ x)
 					{
-						float fy = static_cast<float>(y + 0.5f) / dst_height * src_height;
-						uint32_t sy = std::min(static_cast<uint32_t>(fy), src_height - 1);
-
-						for (uint32_t x = 0; x < dst_width; ++ x)
-						{
-							float fx = static_cast<float>(x + 0.5f) / dst_width * src_width;
-							uint32_t sx = std::min(static_cast<uint32_t>(fx), src_width - 1);
-							dst_32f[(z * dst_height + y) * dst_width + x] = src_32f[(sz * src_height + sy) * src_width + sx];
-						}
+						float fx = static_cast<float>(x) / dst_width * src_width;
+						uint32_t sx0 = static_cast<uint32_t>(fx);
+						uint32_t sx1 = MathLib::clamp<uint32_t>(sx0 + 1, 0, src_width - 1);
+						float weight_x = fx - sx0;
+						Color clr_x00 = MathLib::lerp(src_32f[(sz0 * src_height + sy0) * src_width + sx0],
+							src_32f[(sz0 * src_height + sy0) * src_width + sx1], weight_x);
+						Color clr_x01 = MathLib::lerp(src_32f[(sz0 * src_height + sy1) * src_width + sx0],
+							src_32f[(sz0 * src_height + sy1) * src_width + sx1], weight_x);
+						Color clr_y0 = MathLib::lerp(clr_x00, clr_x01, weight_y);
+						Color clr_x10 = MathLib::lerp(src_32f[(sz1 * src_height + sy0) * src_width + sx0],
+							src_32f[(sz1 * src_height + sy0) * src_width + sx1], weight_x);
+						Color clr_x11 = MathLib::lerp(src_32f[(sz1 * src_height + sy1) * src_width + sx0],
+							src_32f[(sz1 * src_height + sy1) * src_width + sx1], weight_x);
+						Color clr_y1 = MathLib::lerp(clr_x10, clr_x11, weight_y);
+						dst_32f[(z * dst_height + y) * dst_width + x] = MathLib::lerp(clr_y0, clr_y1, weight_z);
 					}
 				}
 			}
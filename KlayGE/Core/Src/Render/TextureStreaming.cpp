@@ -0,0 +1,531 @@
+/**
+ * @file TextureStreaming.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#include <KlayGE/TextureStreaming.hpp>
+
+namespace KlayGE
+{
+	TextureStreamingPolicy::TextureStreamingPolicy(uint64_t budget, uint32_t tail_size)
+		: budget_(budget), tail_size_(tail_size)
+	{
+	}
+
+	void TextureStreamingPolicy::Budget(uint64_t budget)
+	{
+		budget_ = budget;
+	}
+
+	uint32_t TextureStreamingPolicy::AddTexture(uint32_t width, uint32_t height, uint32_t depth, uint32_t num_mipmaps,
+		uint32_t array_size, ElementFormat format)
+	{
+		BOOST_ASSERT(num_mipmaps > 0);
+
+		StreamedTexture tex;
+		tex.valid = true;
+		tex.width = width;
+		tex.height = height;
+		tex.level_bytes.resize(num_mipmaps);
+		tex.tail_level = this->TailLevel(width, height, num_mipmaps);
+
+		uint32_t const elem_size = NumFormatBytes(format);
+		bool const compressed = IsCompressedFormat(format);
+		for (uint32_t level = 0; level < num_mipmaps; ++ level)
+		{
+			uint32_t const w = std::max(1U, width >> level);
+			uint32_t const h = std::max(1U, height >> level);
+			uint32_t const d = std::max(1U, depth >> level);
+
+			uint64_t slice_bytes;
+			if (compressed)
+			{
+				slice_bytes = static_cast<uint64_t>((w + 3) & ~3) * elem_size * ((h + 3) / 4);
+			}
+			else
+			{
+				slice_bytes = static_cast<uint64_t>(w) * h * elem_size;
+			}
+			tex.level_bytes[level] = slice_bytes * d * array_size;
+		}
+
+		tex.wanted_level = tex.tail_level;
+		tex.priority = 0;
+		tex.resident_level = tex.tail_level;
+
+		uint32_t handle;
+		if (free_handles_.empty())
+		{
+			handle = static_cast<uint32_t>(textures_.size());
+			textures_.push_back(tex);
+		}
+		else
+		{
+			handle = free_handles_.back();
+			free_handles_.pop_back();
+			textures_[handle] = tex;
+		}
+		return handle;
+	}
+
+	void TextureStreamingPolicy::RemoveTexture(uint32_t handle)
+	{
+		BOOST_ASSERT(textures_[handle].valid);
+
+		textures_[handle].valid = false;
+		textures_[handle].level_bytes.clear();
+		free_handles_.push_back(handle);
+	}
+
+	void TextureStreamingPolicy::Request(uint32_t handle, uint32_t wanted_level, float priority)
+	{
+		StreamedTexture& tex = textures_[handle];
+		BOOST_ASSERT(tex.valid);
+
+		tex.wanted_level = std::min(wanted_level, tex.tail_level);
+		tex.priority = std::max(priority, 0.0f);
+	}
+
+	void TextureStreamingPolicy::RequestScreenSize(uint32_t handle, float screen_size)
+	{
+		StreamedTexture const & tex = textures_[handle];
+		this->Request(handle, LevelFromScreenSize(tex.width, tex.height, static_cast<uint32_t>(tex.level_bytes.size()),
+			screen_size), screen_size);
+	}
+
+	void TextureStreamingPolicy::Update(uint64_t max_upload_bytes)
+	{
+		uint64_t tail_bytes = 0;
+		candidates_.clear();
+		target_levels_.resize(textures_.size());
+		for (uint32_t handle = 0; handle < textures_.size(); ++ handle)
+		{
+			StreamedTexture const & tex = textures_[handle];
+			if (tex.valid)
+			{
+				for (uint32_t level = tex.tail_level; level < tex.level_bytes.size(); ++ level)
+				{
+					tail_bytes += tex.level_bytes[level];
+				}
+
+				// Each level coarser than the wanted one is twice as needed
+				if (tex.priority > 0)
+				{
+					for (uint32_t level = tex.wanted_level; level < tex.tail_level; ++ level)
+					{
+						candidates_.push_back({ std::ldexp(tex.priority, static_cast<int>(level - tex.wanted_level)), handle, level });
+					}
+				}
+
+				target_levels_[handle] = tex.tail_level;
+			}
+		}
+
+		std::sort(candidates_.begin(), candidates_.end(),
+			[](Candidate const & lhs, Candidate const & rhs)
+			{
+				if (lhs.need != rhs.need)
+				{
+					return lhs.need > rhs.need;
+				}
+				if (lhs.level != rhs.level)
+				{
+					return lhs.level > rhs.level;
+				}
+				return lhs.handle < rhs.handle;
+			});
+
+		// The most needed mips that fit in the budget. A texture that misses one level gets none finer.
+		uint64_t remaining = (budget_ > tail_bytes) ? budget_ - tail_bytes : 0;
+		blocked_.assign(textures_.size(), false);
+		auto accepted_end = candidates_.begin();
+		for (auto const & candidate : candidates_)
+		{
+			uint32_t& target_level = target_levels_[candidate.handle];
+			if (!blocked_[candidate.handle] && (target_level == candidate.level + 1))
+			{
+				uint64_t const bytes = textures_[candidate.handle].level_bytes[candidate.level];
+				if (bytes <= remaining)
+				{
+					remaining -= bytes;
+					target_level = candidate.level;
+					*accepted_end = candidate;
+					++ accepted_end;
+				}
+				else
+				{
+					blocked_[candidate.handle] = true;
+				}
+			}
+		}
+
+		// Evict first, so the loads below never go over the budget
+		for (uint32_t handle = 0; handle < textures_.size(); ++ handle)
+		{
+			StreamedTexture& tex = textures_[handle];
+			if (tex.valid)
+			{
+				tex.resident_level = std::max(tex.resident_level, target_levels_[handle]);
+			}
+		}
+
+		uint64_t uploaded = 0;
+		for (auto iter = candidates_.begin(); iter != accepted_end; ++ iter)
+		{
+			StreamedTexture& tex = textures_[iter->handle];
+			if (tex.resident_level == iter->level + 1)
+			{
+				uint64_t const bytes = tex.level_bytes[iter->level];
+				if ((uploaded > 0) && (uploaded + bytes > max_upload_bytes))
+				{
+					break;
+				}
+
+				uploaded += bytes;
+				tex.resident_level = iter->level;
+			}
+		}
+	}
+
+	uint32_t TextureStreamingPolicy::ResidentLevel(uint32_t handle) const
+	{
+		BOOST_ASSERT(textures_[handle].valid);
+		return textures_[handle].resident_level;
+	}
+
+	uint32_t TextureStreamingPolicy::TailLevel(uint32_t handle) const
+	{
+		BOOST_ASSERT(textures_[handle].valid);
+		return textures_[handle].tail_level;
+	}
+
+	uint32_t TextureStreamingPolicy::TailLevel(uint32_t width, uint32_t height, uint32_t num_mipmaps) const
+	{
+		uint32_t level = 0;
+		while ((level + 1 < num_mipmaps) && (((width >> level) > tail_size_) || ((height >> level) > tail_size_)))
+		{
+			++ level;
+		}
+		return level;
+	}
+
+	uint64_t TextureStreamingPolicy::ResidentBytes() const
+	{
+		uint64_t ret = 0;
+		for (auto const & tex : textures_)
+		{
+			if (tex.valid)
+			{
+				for (uint32_t level = tex.resident_level; level < tex.level_bytes.size(); ++ level)
+				{
+					ret += tex.level_bytes[level];
+				}
+			}
+		}
+		return ret;
+	}
+
+	uint32_t TextureStreamingPolicy::LevelFromScreenSize(uint32_t width, uint32_t height, uint32_t num_mipmaps,
+		float screen_size)
+	{
+		uint32_t const size = std::max(width, height);
+		uint32_t level = 0;
+		while ((level + 1 < num_mipmaps) && ((size >> (level + 1)) >= screen_size))
+		{
+			++ level;
+		}
+		return level;
+	}
+
+
+	// Textures no longer requested keep their size for this many updates, so they don't thrash when out of view briefly
+	uint32_t const STREAMING_IDLE_UPDATES = 60;
+
+	TextureStreamer::TextureStreamer(uint64_t budget, uint32_t tail_size)
+		: TextureStreamer(budget, tail_size,
+			[](Texture::TextureType type, uint32_t width, uint32_t height, uint32_t num_mipmaps, uint32_t array_size,
+				ElementFormat format, uint32_t access_hint, ArrayRef<ElementInitData> init_data)
+			{
+				RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+				if (Texture::TT_Cube == type)
+				{
+					return rf.MakeTextureCube(width, num_mipmaps, array_size, format, 1, 0, access_hint, init_data);
+				}
+				else
+				{
+					return rf.MakeTexture2D(width, height, num_mipmaps, array_size, format, 1, 0, access_hint, init_data);
+				}
+			})
+	{
+	}
+
+	TextureStreamer::TextureStreamer(uint64_t budget, uint32_t tail_size, TextureCreator const & creator)
+		: policy_(budget, tail_size), creator_(creator)
+	{
+	}
+
+	bool TextureStreamer::Streamable(Texture::TextureType type, uint32_t num_mipmaps, uint32_t access_hint)
+	{
+		return ((Texture::TT_2D == type) || (Texture::TT_Cube == type)) && (num_mipmaps > 1)
+			&& (access_hint & EAH_Immutable) && !(access_hint & ~(EAH_GPU_Read | EAH_Immutable));
+	}
+
+	uint32_t TextureStreamer::FirstLevel(uint32_t width, uint32_t height, uint32_t num_mipmaps) const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return policy_.TailLevel(width, height, num_mipmaps);
+	}
+
+	uint32_t TextureStreamer::AddTexture(TexturePtr const & tex, Texture::TextureType type, uint32_t width, uint32_t height,
+		uint32_t num_mipmaps, uint32_t array_size, ElementFormat format, uint32_t access_hint)
+	{
+		BOOST_ASSERT(Streamable(type, num_mipmaps, access_hint));
+
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		uint32_t const num_slices = (Texture::TT_Cube == type) ? array_size * 6 : array_size;
+		uint32_t const handle = policy_.AddTexture(width, height, 1, num_mipmaps, num_slices, format);
+		if (handle >= entries_.size())
+		{
+			entries_.resize(handle + 1);
+		}
+
+		Entry& entry = entries_[handle];
+		entry.valid = true;
+		entry.type = type;
+		entry.width = width;
+		entry.height = height;
+		entry.num_mipmaps = num_mipmaps;
+		entry.array_size = array_size;
+		entry.format = format;
+		entry.access_hint = access_hint;
+		entry.loaded_tex = tex;
+		entry.tracked = static_cast<bool>(tex);
+		entry.current_tex.reset();
+		entry.current_level = policy_.TailLevel(handle);
+		entry.data_ready = false;
+		entry.init_data.clear();
+		entry.data_block.clear();
+		entry.claimed = false;
+		entry.frame_screen_size = 0;
+		entry.screen_size = 0;
+		entry.idle_updates = 0;
+
+		if (tex)
+		{
+			handles_[tex] = handle;
+		}
+		return handle;
+	}
+
+	void TextureStreamer::TextureLoaded(uint32_t handle, std::vector<ElementInitData> init_data,
+		std::vector<uint8_t> data_block)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		Entry& entry = entries_[handle];
+		BOOST_ASSERT(entry.valid);
+
+		TexturePtr const loaded_tex = entry.loaded_tex.lock();
+		if (loaded_tex)
+		{
+			loaded_tex->CreateHWResource(LevelsFrom(init_data, entry.num_mipmaps, policy_.TailLevel(handle)));
+		}
+		entry.init_data = std::move(init_data);
+		entry.data_block = std::move(data_block);
+		entry.data_ready = true;
+	}
+
+	void TextureStreamer::RemoveTexture(uint32_t handle)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		Entry& entry = entries_[handle];
+		BOOST_ASSERT(entry.valid);
+
+		if (entry.tracked)
+		{
+			handles_.erase(entry.loaded_tex);
+		}
+		entry = Entry();
+		entry.valid = false;
+		policy_.RemoveTexture(handle);
+	}
+
+	uint32_t TextureStreamer::Handle(TexturePtr const & tex) const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		auto iter = handles_.find(tex);
+		return (iter == handles_.end()) ? static_cast<uint32_t>(-1) : iter->second;
+	}
+
+	uint32_t TextureStreamer::ClaimRequests(TexturePtr const & tex)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		auto iter = handles_.find(tex);
+		if (iter == handles_.end())
+		{
+			return static_cast<uint32_t>(-1);
+		}
+
+		entries_[iter->second].claimed = true;
+		return iter->second;
+	}
+
+	void TextureStreamer::RequestScreenSize(uint32_t handle, float screen_size)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		Entry& entry = entries_[handle];
+		entry.claimed = true;
+		entry.frame_screen_size = std::max(entry.frame_screen_size, screen_size);
+	}
+
+	void TextureStreamer::Update(uint64_t max_upload_bytes)
+	{
+		std::vector<uint32_t> unused;
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+
+			for (uint32_t handle = 0; handle < entries_.size(); ++ handle)
+			{
+				Entry& entry = entries_[handle];
+				if (!entry.valid)
+				{
+					continue;
+				}
+
+				// Everybody dropped the texture from the loader
+				if (entry.tracked && entry.loaded_tex.expired())
+				{
+					unused.push_back(handle);
+					continue;
+				}
+
+				if (!entry.claimed)
+				{
+					entry.frame_screen_size = static_cast<float>(std::max(entry.width, entry.height));
+				}
+				if (entry.frame_screen_size > 0)
+				{
+					entry.screen_size = entry.frame_screen_size;
+					entry.idle_updates = 0;
+				}
+				else if (entry.idle_updates < STREAMING_IDLE_UPDATES)
+				{
+					++ entry.idle_updates;
+				}
+				else
+				{
+					entry.screen_size = 0;
+				}
+				entry.frame_screen_size = 0;
+
+				// Nothing finer than the tail can be made before the data is there
+				policy_.RequestScreenSize(handle, entry.data_ready ? entry.screen_size : 0);
+			}
+		}
+
+		for (auto handle : unused)
+		{
+			this->RemoveTexture(handle);
+		}
+
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		policy_.Update(max_upload_bytes);
+
+		for (uint32_t handle = 0; handle < entries_.size(); ++ handle)
+		{
+			Entry& entry = entries_[handle];
+			if (entry.valid && entry.data_ready)
+			{
+				uint32_t const level = policy_.ResidentLevel(handle);
+				if (level != entry.current_level)
+				{
+					if (!entry.loaded_tex.expired() && (level == policy_.TailLevel(handle)))
+					{
+						entry.current_tex.reset();
+					}
+					else
+					{
+						entry.current_tex = creator_(entry.type, std::max(1U, entry.width >> level),
+							std::max(1U, entry.height >> level), entry.num_mipmaps - level, entry.array_size, entry.format,
+							entry.access_hint, LevelsFrom(entry.init_data, entry.num_mipmaps, level));
+					}
+					entry.current_level = level;
+				}
+			}
+		}
+	}
+
+	TexturePtr TextureStreamer::CurrentTexture(uint32_t handle) const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+
+		Entry const & entry = entries_[handle];
+		return entry.current_tex ? entry.current_tex : entry.loaded_tex.lock();
+	}
+
+	uint32_t TextureStreamer::CurrentLevel(uint32_t handle) const
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		return entries_[handle].current_level;
+	}
+
+	void TextureStreamer::Budget(uint64_t budget)
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		policy_.Budget(budget);
+	}
+
+	std::vector<ElementInitData> TextureStreamer::LevelsFrom(std::vector<ElementInitData> const & init_data,
+		uint32_t num_mipmaps, uint32_t first_level)
+	{
+		BOOST_ASSERT(first_level < num_mipmaps);
+
+		std::vector<ElementInitData> ret;
+		ret.reserve(init_data.size() / num_mipmaps * (num_mipmaps - first_level));
+		for (size_t slice = 0; slice < init_data.size() / num_mipmaps; ++ slice)
+		{
+			ret.insert(ret.end(), init_data.begin() + slice * num_mipmaps + first_level,
+				init_data.begin() + (slice + 1) * num_mipmaps);
+		}
+		return ret;
+	}
+}
@@ -741,6 +741,27 @@ namespace KlayGE
 
 		visible_marks_map_.clear();
 
+		{
+			std::lock_guard<std::mutex> lock(update_mutex_);
+
+			// Once per frame from the main view, instead of per pass from the shadow or reflection cameras
+			FrameBufferPtr const & fb = re.DefaultFrameBuffer();
+			if (fb && fb->GetViewport()->camera)
+			{
+				for (auto const & obj : scene_objs_)
+				{
+					if (obj->Visible() && (0 == obj->NumChildren()))
+					{
+						auto renderable = obj->GetRenderable().get();
+						if (renderable)
+						{
+							renderable->SelectDetail(*fb);
+						}
+					}
+				}
+			}
+		}
+
 		uint32_t urt;
 		App3DFramework& app = Context::Instance().AppInstance();
 		for (uint32_t pass = 0;; ++ pass)
@@ -1062,6 +1062,7 @@ namespace KlayGE
 			user_export_settings |= MeshMLObj::UES_CombineMeshes;
 		}
 		user_export_settings |= MeshMLObj::UES_SortMeshes;
+		user_export_settings |= MeshMLObj::UES_OptimizeMeshes;
 
 		meshml_obj_.WriteMeshML(ofs, vertex_export_settings, user_export_settings);
 	}
@@ -101,6 +101,8 @@ namespace KlayGE
 	private:
 		void AttachGLSL(uint32_t type);
 		void LinkGLSL();
+		std::string ProgramBinaryKey() const;
+		bool LoadProgramBinary(std::string const & key);
 		void AttachUBOs(RenderEffect const & effect);
 		void FillTFBVaryings(ShaderDesc const & sd);
 		void PrintGLSLError(ShaderType type, char const * info);
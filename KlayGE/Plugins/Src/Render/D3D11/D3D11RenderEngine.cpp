@@ -1068,6 +1068,7 @@ namespace KlayGE
 		caps_.independent_blend_support = true;
 		caps_.draw_indirect_support = true;
 		caps_.no_overwrite_support = true;
+		caps_.partial_cbuffer_update_support = false;
 		if (d3d_11_runtime_sub_ver_ >= 1)
 		{
 			D3D11_FEATURE_DATA_D3D9_OPTIONS d3d11_feature;
@@ -1368,6 +1368,7 @@ namespace KlayGE
 		caps_.independent_blend_support = true;
 		caps_.draw_indirect_support = true;
 		caps_.no_overwrite_support = true;
+		caps_.partial_cbuffer_update_support = false;
 		caps_.full_npot_texture_support = true;
 		caps_.render_to_texture_array_support = true;
 		caps_.load_from_buffer_support = true;
@@ -22,6 +22,8 @@
 #include <KFL/Matrix.hpp>
 #include <KlayGE/RenderEngine.hpp>
 #include <KlayGE/RenderEffect.hpp>
+#include <KlayGE/ResLoader.hpp>
+#include <KlayGE/ShaderBinaryCache.hpp>
 #include <KFL/Hash.hpp>
 
 #include <cstdio>
@@ -161,6 +163,52 @@ namespace
 		RenderEffectParameter* tex_param_;
 		RenderEffectParameter* sampler_param_;
 	};
+
+#if KLAYGE_IS_DEV_PLATFORM
+	// Bump when DXBC2GLSL or the native shader block changes
+	uint32_t const GLSL_CACHE_VERSION = 1;
+
+	ShaderBinaryCache& GLSLCache()
+	{
+		static ShaderBinaryCache cache(ResLoader::Instance().LocalFolder() + "ShaderCache/OGLES/GLSL/", GLSL_CACHE_VERSION);
+		return cache;
+	}
+#endif
+
+	uint32_t const PROGRAM_BINARY_CACHE_VERSION = 1;
+
+	ShaderBinaryCache& ProgramBinaryCache()
+	{
+		static ShaderBinaryCache cache(ResLoader::Instance().LocalFolder() + "ShaderCache/OGLES/Program/", PROGRAM_BINARY_CACHE_VERSION);
+		return cache;
+	}
+
+	template <typename T>
+	void AppendToKey(std::string& key, T const & v)
+	{
+		key.append(reinterpret_cast<char const *>(&v), sizeof(v));
+	}
+
+	// Program binaries are only valid on the driver that made them
+	std::string const & DriverIdentity()
+	{
+		static std::string const identity = []
+			{
+				std::string ret;
+				GLenum const names[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+				for (auto name : names)
+				{
+					char const * str = reinterpret_cast<char const *>(glGetString(name));
+					if (str)
+					{
+						ret += str;
+					}
+					ret += '\n';
+				}
+				return ret;
+			}();
+		return identity;
+	}
 }
 
 namespace KlayGE
@@ -337,7 +385,6 @@ namespace KlayGE
 			}
 
 			this->FillTFBVaryings(sd);
-			this->AttachGLSL(type);
 
 			ret = is_shader_validate_[type];
 		}
@@ -630,6 +677,31 @@ namespace KlayGE
 						{
 							rules |= static_cast<uint32_t>(GSR_EXTTessellationShader);
 						}
+
+						// The tessellator settings from a hull shader go to so_template_ instead of the native block,
+						// so hull shaders are always translated
+						std::string glsl_key;
+						if (ST_HullShader != type)
+						{
+							glsl_key.assign(code.begin(), code.end());
+							AppendToKey(glsl_key, static_cast<uint32_t>(type));
+							AppendToKey(glsl_key, static_cast<uint32_t>(gsv));
+							AppendToKey(glsl_key, rules);
+							AppendToKey(glsl_key, has_ps);
+							AppendToKey(glsl_key, so_template_->ds_partitioning_);
+							AppendToKey(glsl_key, so_template_->ds_output_primitive_);
+
+							std::vector<uint8_t> native_shader_block;
+							if (GLSLCache().Load(glsl_key, native_shader_block))
+							{
+								if (this->AttachNativeShader(type, effect, shader_desc_ids, native_shader_block))
+								{
+									return;
+								}
+								is_shader_validate_[type] = true;
+							}
+						}
+
 						dxbc2glsl.FeedDXBC(&code[0],
 							false, has_ps, static_cast<ShaderTessellatorPartitioning>(so_template_->ds_partitioning_),
 							static_cast<ShaderTessellatorOutputPrimitive>(so_template_->ds_output_primitive_),
@@ -786,6 +858,15 @@ namespace KlayGE
 							so_template_->ds_partitioning_ = dxbc2glsl.DSPartitioning();
 							so_template_->ds_output_primitive_ = dxbc2glsl.DSOutputPrimitive();
 						}
+
+						if (!glsl_key.empty())
+						{
+							std::ostringstream oss(std::ios_base::binary | std::ios_base::out);
+							this->StreamOut(oss, type);
+							std::string const block = oss.str();
+							// Without the length in front
+							GLSLCache().Store(glsl_key, std::vector<uint8_t>(block.begin() + sizeof(uint32_t), block.end()));
+						}
 					}
 					catch (std::exception& ex)
 					{
@@ -806,7 +887,6 @@ namespace KlayGE
 		if (is_shader_validate_[type])
 		{
 			this->FillTFBVaryings(sd);
-			this->AttachGLSL(type);
 		}
 	}
 
@@ -865,8 +945,6 @@ namespace KlayGE
 					}
 				}
 			}
-
-			this->AttachGLSL(type);
 		}
 	}
 
@@ -885,21 +963,55 @@ namespace KlayGE
 		{
 			glProgramParameteri(glsl_program_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
-			this->LinkGLSL();
-			this->AttachUBOs(effect);
+			GLint num_bin_formats = 0;
+			glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_bin_formats);
+
+			std::string bin_key;
+			bool bin_loaded = false;
+			if (num_bin_formats > 0)
+			{
+				bin_key = this->ProgramBinaryKey();
+				bin_loaded = this->LoadProgramBinary(bin_key);
+			}
 
-			if (is_validate_)
+			if (!bin_loaded)
 			{
-				GLint num = 0;
-				glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num);
-				if (num > 0)
+				// Shaders are compiled here instead of when attached, so a cached program binary skips the compiling too
+				for (size_t type = 0; type < ST_NumShaderTypes; ++ type)
 				{
-					GLint len = 0;
-					glGetProgramiv(glsl_program_, GL_PROGRAM_BINARY_LENGTH, &len);
-					so_template_->glsl_bin_program_ = MakeSharedPtr<std::vector<uint8_t>>(len);
-					glGetProgramBinary(glsl_program_, len, nullptr, &so_template_->glsl_bin_format_,
-						&(*so_template_->glsl_bin_program_)[0]);
+					if (is_shader_validate_[type] && (*so_template_->glsl_srcs_)[type] && !(*so_template_->glsl_srcs_)[type]->empty())
+					{
+						this->AttachGLSL(static_cast<uint32_t>(type));
+						is_validate_ &= is_shader_validate_[type];
+					}
 				}
+
+				if (is_validate_)
+				{
+					this->LinkGLSL();
+				}
+			}
+			if (!is_validate_)
+			{
+				// A failed link has no uniform blocks or locations to query
+				return;
+			}
+
+			this->AttachUBOs(effect);
+
+			if (!bin_loaded && (num_bin_formats > 0))
+			{
+				GLint len = 0;
+				glGetProgramiv(glsl_program_, GL_PROGRAM_BINARY_LENGTH, &len);
+				so_template_->glsl_bin_program_ = MakeSharedPtr<std::vector<uint8_t>>(len);
+				glGetProgramBinary(glsl_program_, len, nullptr, &so_template_->glsl_bin_format_,
+					&(*so_template_->glsl_bin_program_)[0]);
+
+				std::vector<uint8_t> blob(sizeof(uint32_t) + len);
+				uint32_t const format = Native2LE(static_cast<uint32_t>(so_template_->glsl_bin_format_));
+				std::memcpy(&blob[0], &format, sizeof(format));
+				std::memcpy(&blob[sizeof(format)], &(*so_template_->glsl_bin_program_)[0], len);
+				ProgramBinaryCache().Store(bin_key, blob);
 			}
 
 			for (int type = 0; type < ST_NumShaderTypes; ++ type)
@@ -1001,9 +1113,9 @@ namespace KlayGE
 				glProgramBinary(ret->glsl_program_, so_template_->glsl_bin_format_,
 					&(*so_template_->glsl_bin_program_)[0], static_cast<GLsizei>(so_template_->glsl_bin_program_->size()));
 
-#ifdef KLAYGE_DEBUG
 				GLint linked = false;
 				glGetProgramiv(ret->glsl_program_, GL_LINK_STATUS, &linked);
+#ifdef KLAYGE_DEBUG
 				if (!linked)
 				{
 					GLint len = 0;
@@ -1016,6 +1128,7 @@ namespace KlayGE
 					}
 				}
 #endif
+				ret->is_validate_ &= linked ? true : false;
 			}
 			else
 			{
@@ -1032,7 +1145,10 @@ namespace KlayGE
 
 				ret->LinkGLSL();
 			}
+		}
 
+		if (ret->is_validate_)
+		{
 			ret->AttachUBOs(effect);
 			ret->attrib_locs_ = attrib_locs_;
 			for (auto const & pb : param_binds_)
@@ -1095,6 +1211,58 @@ namespace KlayGE
 		return ret;
 	}
 
+	std::string OGLESShaderObject::ProgramBinaryKey() const
+	{
+		std::string key = DriverIdentity();
+		for (uint32_t type = 0; type < ST_NumShaderTypes; ++ type)
+		{
+			auto const & glsl = (*so_template_->glsl_srcs_)[type];
+			if (is_shader_validate_[type] && glsl && !glsl->empty())
+			{
+				AppendToKey(key, type);
+				AppendToKey(key, static_cast<uint32_t>(glsl->size()));
+				key += *glsl;
+			}
+		}
+		if (so_template_->glsl_tfb_varyings_ && !so_template_->glsl_tfb_varyings_->empty())
+		{
+			AppendToKey(key, so_template_->tfb_separate_attribs_);
+			for (auto const & varying : *so_template_->glsl_tfb_varyings_)
+			{
+				key += varying;
+				key += '\0';
+			}
+		}
+		return key;
+	}
+
+	bool OGLESShaderObject::LoadProgramBinary(std::string const & key)
+	{
+		std::vector<uint8_t> blob;
+		if (ProgramBinaryCache().Load(key, blob) && (blob.size() > sizeof(uint32_t)))
+		{
+			uint32_t format;
+			std::memcpy(&format, &blob[0], sizeof(format));
+			format = LE2Native(format);
+
+			glProgramBinary(glsl_program_, format, &blob[sizeof(format)], static_cast<GLsizei>(blob.size() - sizeof(format)));
+
+			GLint linked = false;
+			glGetProgramiv(glsl_program_, GL_LINK_STATUS, &linked);
+			if (linked)
+			{
+				so_template_->glsl_bin_format_ = format;
+				so_template_->glsl_bin_program_ = MakeSharedPtr<std::vector<uint8_t>>(blob.begin() + sizeof(format), blob.end());
+				return true;
+			}
+
+			// Drivers can reject their own binaries, after a minor update for example
+			ProgramBinaryCache().Remove(key);
+		}
+
+		return false;
+	}
+
 	GLint OGLESShaderObject::GetAttribLocation(VertexElementUsage usage, uint8_t usage_index)
 	{
 		auto iter = attrib_locs_.find(std::make_pair(usage, usage_index));
@@ -391,6 +391,7 @@ void JudaTexViewer::OpenJudaTex(std::string const & name)
 		fmt = EF_ARGB8;
 	}
 	juda_tex_->CacheProperty(1024, fmt, BORDER_SIZE);
+	juda_tex_->AsyncDecode(true);
 
 	num_tiles_ = juda_tex_->NumTiles();
 	tile_size_ = juda_tex_->TileSize();
@@ -461,6 +462,14 @@ void JudaTexViewer::DoUpdateOverlay()
 	font_->RenderText(0, 0, Color(1, 1, 0, 1), L"Juda Texture Viewer", 16);
 	font_->RenderText(0, 18, Color(1, 1, 0, 1), stream.str(), 16);
 
+	JudaTexture::CacheStatistics const & stats = juda_tex_->Statistics();
+	uint64_t const requests = std::max<uint64_t>(stats.hits + stats.misses, 1);
+	stream.str(L"");
+	stream << L"Hit rate: " << 100.0 * stats.hits / requests << L"%, "
+		<< L"Prefetch hits: " << stats.prefetch_hits << '/' << stats.prefetches << L", "
+		<< L"Avg latency: " << 1000.0 * stats.total_latency / std::max<uint64_t>(stats.uploads - stats.prefetch_uploads, 1) << L" ms";
+	font_->RenderText(0, 36, Color(1, 1, 0, 1), stream.str(), 16);
+
 	if (tile_size_ * scale_ > 64)
 	{
 		for (uint32_t y = sy_; y < ey_; ++ y)
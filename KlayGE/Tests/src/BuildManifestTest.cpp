@@ -0,0 +1,222 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/CXX17/filesystem.hpp>
+#include <KlayGE/ResLoader.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BuildManifest.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	std::string const MANIFEST_HEADER = "BuildManifestTest manifest 1";
+
+	std::string ManifestName()
+	{
+		std::string const dir = ResLoader::Instance().LocalFolder() + "BuildManifestTest/";
+		std::filesystem::remove_all(dir);
+		std::filesystem::create_directories(dir);
+		return dir + "Test.manifest";
+	}
+
+	uint32_t NumFiles(std::string const & dir)
+	{
+		uint32_t ret = 0;
+		for (std::filesystem::directory_iterator iter(dir), end; iter != end; ++ iter)
+		{
+			++ ret;
+		}
+		return ret;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(BuildManifestRoundTrip)
+{
+	std::string const name = ManifestName();
+
+	{
+		BuildManifest manifest(name, MANIFEST_HEADER);
+		BOOST_CHECK(manifest.Entries().empty());
+		BOOST_CHECK(!manifest.UpToDate("a.fxml", "0123"));
+
+		manifest.Built("a.fxml", "0123", { "b.fxml", "c.fxml" });
+		manifest.Built("d.fxml", "4567");
+		manifest.Save();
+	}
+
+	// The tmp file is renamed, nothing else is left in the folder
+	BOOST_CHECK_EQUAL(NumFiles(std::filesystem::path(name).parent_path().string()), 1U);
+
+	BuildManifest manifest(name, MANIFEST_HEADER);
+	BOOST_CHECK_EQUAL(manifest.Entries().size(), 2U);
+	BOOST_CHECK(manifest.UpToDate("a.fxml", "0123"));
+	BOOST_CHECK(!manifest.UpToDate("a.fxml", "4567"));
+	BOOST_CHECK(manifest.UpToDate("d.fxml", "4567"));
+
+	std::vector<std::string> const& deps = manifest.Entries().at("a.fxml").dependencies;
+	BOOST_REQUIRE_EQUAL(deps.size(), 2U);
+	BOOST_CHECK_EQUAL(deps[0], "b.fxml");
+	BOOST_CHECK_EQUAL(deps[1], "c.fxml");
+	BOOST_CHECK(manifest.Entries().at("d.fxml").dependencies.empty());
+}
+
+BOOST_AUTO_TEST_CASE(BuildManifestKeepsOtherEntries)
+{
+	std::string const name = ManifestName();
+
+	{
+		BuildManifest manifest(name, MANIFEST_HEADER);
+		manifest.Built("a.fxml", "0123");
+		manifest.Built("b.fxml", "4567");
+		manifest.Save();
+	}
+
+	// A later batch with other items and a failed one
+	{
+		BuildManifest manifest(name, MANIFEST_HEADER);
+		manifest.Built("c.fxml", "89ab");
+		manifest.Failed("b.fxml");
+		manifest.Save();
+	}
+
+	BuildManifest manifest(name, MANIFEST_HEADER);
+	BOOST_CHECK_EQUAL(manifest.Entries().size(), 2U);
+	BOOST_CHECK(manifest.UpToDate("a.fxml", "0123"));
+	BOOST_CHECK(manifest.Entries().find("b.fxml") == manifest.Entries().end());
+	BOOST_CHECK(manifest.UpToDate("c.fxml", "89ab"));
+}
+
+BOOST_AUTO_TEST_CASE(BuildManifestInterleavedSaves)
+{
+	std::string const name = ManifestName();
+
+	// Both are loaded before either is saved, like two processes building at the same time
+	BuildManifest manifest0(name, MANIFEST_HEADER);
+	BuildManifest manifest1(name, MANIFEST_HEADER);
+	manifest0.Built("a.fxml", "0123");
+	manifest1.Built("b.fxml", "4567");
+	manifest0.Save();
+	manifest1.Save();
+
+	BuildManifest manifest(name, MANIFEST_HEADER);
+	BOOST_CHECK(manifest.UpToDate("a.fxml", "0123"));
+	BOOST_CHECK(manifest.UpToDate("b.fxml", "4567"));
+}
+
+BOOST_AUTO_TEST_CASE(BuildManifestConcurrentSaves)
+{
+	std::string const name = ManifestName();
+
+	// Every thread merges into the file at the same time as the others, the lock has to keep all the entries
+	uint32_t const NUM_THREADS = 8;
+	uint32_t const NUM_ROUNDS = 16;
+	std::vector<std::thread> threads;
+	for (uint32_t t = 0; t < NUM_THREADS; ++ t)
+	{
+		threads.emplace_back([&name, t]
+			{
+				for (uint32_t r = 0; r < NUM_ROUNDS; ++ r)
+				{
+					BuildManifest manifest(name, MANIFEST_HEADER);
+					manifest.Built(std::to_string(t) + "_" + std::to_string(r) + ".fxml", std::to_string(r));
+					manifest.Save();
+				}
+			});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	BuildManifest manifest(name, MANIFEST_HEADER);
+	BOOST_CHECK_EQUAL(manifest.Entries().size(), NUM_THREADS * NUM_ROUNDS);
+	BOOST_CHECK(!std::filesystem::exists(name + ".lock"));
+}
+
+BOOST_AUTO_TEST_CASE(BuildManifestStaleLock)
+{
+	std::string const name = ManifestName();
+
+	// Left by a process that crashed while saving
+	std::ofstream(name + ".lock").close();
+	{
+		BuildFileLock lock(name, std::chrono::milliseconds(100));
+		BOOST_CHECK(std::filesystem::exists(name + ".lock"));
+	}
+	BOOST_CHECK(!std::filesystem::exists(name + ".lock"));
+}
+
+BOOST_AUTO_TEST_CASE(BuildManifestOtherVersion)
+{
+	std::string const name = ManifestName();
+
+	{
+		BuildManifest manifest(name, "BuildManifestTest manifest 0");
+		manifest.Built("a.fxml", "0123");
+		manifest.Save();
+	}
+
+	{
+		BuildManifest manifest(name, MANIFEST_HEADER);
+		BOOST_CHECK(manifest.Entries().empty());
+		manifest.Built("b.fxml", "4567");
+		manifest.Save();
+	}
+
+	BuildManifest manifest(name, MANIFEST_HEADER);
+	BOOST_CHECK_EQUAL(manifest.Entries().size(), 1U);
+	BOOST_CHECK(manifest.UpToDate("b.fxml", "4567"));
+}
+
+BOOST_AUTO_TEST_CASE(BuildManifestDigest)
+{
+	// The FNV-1a offset basis
+	BOOST_CHECK_EQUAL(BuildDigest().Str(), "cbf29ce484222325");
+	BOOST_CHECK_EQUAL(BuildDigest().AddBytes("a", 1).Str(), "af63dc4c8601ec8c");
+
+	// Fields don't run into each other
+	BOOST_CHECK_NE(BuildDigest().AddString("ab").AddString("c").Str(), BuildDigest().AddString("a").AddString("bc").Str());
+
+	std::string const name = ManifestName() + ".txt";
+	std::string content(10000, '\0');
+	for (size_t i = 0; i < content.size(); ++ i)
+	{
+		content[i] = static_cast<char>(i * 7);
+	}
+	{
+		std::ofstream ofs(name.c_str(), std::ios_base::binary);
+		ofs.write(content.data(), content.size());
+	}
+	BuildDigest file_digest;
+	BOOST_CHECK(file_digest.AddFile(name));
+	BOOST_CHECK_EQUAL(file_digest.Str(),
+		BuildDigest().AddBytes(content.data(), content.size()).AddValue(static_cast<uint64_t>(content.size())).Str());
+	BOOST_CHECK(!BuildDigest().AddFile(name + ".missing"));
+}
+
+BOOST_AUTO_TEST_CASE(BuildManifestUniqueBuildTag)
+{
+	std::string tags[2];
+	std::thread other([&tags] { tags[1] = UniqueBuildTag(); });
+	tags[0] = UniqueBuildTag();
+	other.join();
+
+	BOOST_CHECK(!tags[0].empty());
+	BOOST_CHECK_NE(tags[0], tags[1]);
+}
@@ -0,0 +1,313 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/DistanceTransform.hpp>
+#include <KFL/Timer.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "GlyphDistance.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Features at random places, 0 on them and infinity elsewhere
+	std::vector<float> RandomFeatures(uint32_t width, uint32_t height, uint32_t depth, uint32_t num_features,
+		std::vector<uint32_t>& features)
+	{
+		std::vector<float> ret(width * height * depth, std::numeric_limits<float>::infinity());
+
+		std::ranlux24_base gen(42);
+		std::uniform_int_distribution<uint32_t> dis(0, static_cast<uint32_t>(ret.size() - 1));
+		features.clear();
+		for (uint32_t i = 0; i < num_features; ++ i)
+		{
+			uint32_t const index = dis(gen);
+			ret[index] = 0;
+			features.push_back(index);
+		}
+
+		return ret;
+	}
+
+	uint32_t SquaredDistance(uint32_t a, uint32_t b, uint32_t width, uint32_t height)
+	{
+		int const dx = static_cast<int>(a % width) - static_cast<int>(b % width);
+		int const dy = static_cast<int>(a / width % height) - static_cast<int>(b / width % height);
+		int const dz = static_cast<int>(a / width / height) - static_cast<int>(b / width / height);
+		return dx * dx + dy * dy + dz * dz;
+	}
+
+	// Distances are integers far below 2^24, so the transform has to match the brute force exactly
+	void CheckAgainstBruteForce(uint32_t width, uint32_t height, uint32_t depth, uint32_t num_features, uint32_t num_threads)
+	{
+		std::vector<uint32_t> features;
+		std::vector<float> dist = RandomFeatures(width, height, depth, num_features, features);
+		std::vector<uint32_t> nearest(dist.size());
+		MathLib::squared_distance_transform(&dist[0], &nearest[0], width, height, depth, num_threads);
+
+		for (uint32_t i = 0; i < dist.size(); ++ i)
+		{
+			uint32_t expected = std::numeric_limits<uint32_t>::max();
+			for (auto const feature : features)
+			{
+				expected = std::min(expected, SquaredDistance(i, feature, width, height));
+			}
+
+			BOOST_CHECK_EQUAL(dist[i], static_cast<float>(expected));
+			BOOST_CHECK_EQUAL(SquaredDistance(i, nearest[i], width, height), expected);
+		}
+	}
+
+	// What KFontGen used to do. 8-neighbour sweeps, repeated until nothing changes.
+	bool SweepUpdateDistance(int x, int y, int dx, int dy, std::vector<float> const & img, int width,
+		std::vector<float2> const & grad, std::vector<int2>& dist_xy, std::vector<float>& dist)
+	{
+		float const EPSILON = 1e-3f;
+
+		bool changed = false;
+		int addr = y * width + x;
+		float old_dist = dist[addr];
+		if (old_dist > 0)
+		{
+			int offset_addr = (y + dy) * width + (x + dx);
+			int2 new_dist_xy = dist_xy[offset_addr] - int2(dx, dy);
+			float new_dist = AADist(img, grad, width, offset_addr, dist_xy[offset_addr], new_dist_xy);
+			if (new_dist < old_dist - EPSILON)
+			{
+				dist_xy[addr] = new_dist_xy;
+				dist[addr] = new_dist;
+				changed = true;
+			}
+		}
+
+		return changed;
+	}
+
+	void SweepAAEuclideanDistance(std::vector<float> const & img, std::vector<float2> const & grad,
+		int width, int height, std::vector<float>& dist)
+	{
+		std::vector<int2> dist_xy(img.size(), int2(0, 0));
+
+		for (size_t i = 0; i < img.size(); ++ i)
+		{
+			if (img[i] <= 0)
+			{
+				dist[i] = 1e10f;
+			}
+			else if (img[i] < 1)
+			{
+				dist[i] = EdgeDistance(grad[i], img[i]);
+			}
+			else
+			{
+				dist[i] = 0;
+			}
+		}
+
+		bool changed;
+		do
+		{
+			changed = false;
+
+			for (int y = 1; y < height; ++ y)
+			{
+				for (int x = 0; x < width; ++ x)
+				{
+					if (x > 0)
+					{
+						changed |= SweepUpdateDistance(x, y, -1, +0, img, width, grad, dist_xy, dist);
+						changed |= SweepUpdateDistance(x, y, -1, -1, img, width, grad, dist_xy, dist);
+					}
+					changed |= SweepUpdateDistance(x, y, +0, -1, img, width, grad, dist_xy, dist);
+					if (x < width - 1)
+					{
+						changed |= SweepUpdateDistance(x, y, +1, -1, img, width, grad, dist_xy, dist);
+					}
+				}
+
+				for (int x = width - 2; x >= 0; -- x)
+				{
+					changed |= SweepUpdateDistance(x, y, +1, +0, img, width, grad, dist_xy, dist);
+				}
+			}
+
+			for (int y = height - 2; y >= 0; -- y)
+			{
+				for (int x = width - 1; x >= 0; -- x)
+				{
+					if (x < width - 1)
+					{
+						changed |= SweepUpdateDistance(x, y, +1, +0, img, width, grad, dist_xy, dist);
+						changed |= SweepUpdateDistance(x, y, +1, +1, img, width, grad, dist_xy, dist);
+					}
+					changed |= SweepUpdateDistance(x, y, +0, +1, img, width, grad, dist_xy, dist);
+					if (x > 0)
+					{
+						changed |= SweepUpdateDistance(x, y, -1, +1, img, width, grad, dist_xy, dist);
+					}
+				}
+
+				for (int x = 1; x < width; ++ x)
+				{
+					changed |= SweepUpdateDistance(x, y, -1, +0, img, width, grad, dist_xy, dist);
+				}
+			}
+		} while (changed);
+	}
+
+	// A ring and a slanted bar, covered by 8x8 samples per texel at twice the size, with the 2 texel border KFontGen
+	// leaves empty
+	std::vector<float> SyntheticGlyph2x(int size)
+	{
+		int const SAMPLES = 8;
+		float const center = size * 0.5f;
+
+		std::vector<float> ret(size * size * 4, 0);
+		for (int y = 2; y < size * 2 - 2; ++ y)
+		{
+			for (int x = 2; x < size * 2 - 2; ++ x)
+			{
+				int covered = 0;
+				for (int sy = 0; sy < SAMPLES; ++ sy)
+				{
+					for (int sx = 0; sx < SAMPLES; ++ sx)
+					{
+						float const px = (x + (sx + 0.5f) / SAMPLES) * 0.5f;
+						float const py = (y + (sy + 0.5f) / SAMPLES) * 0.5f;
+						float const r = std::sqrt((px - center) * (px - center) + (py - center) * (py - center));
+						bool const ring = (r > size * 0.2f) && (r < size * 0.35f);
+						bool const bar = (std::abs((px - center) * 0.8f - (py - center) * 0.6f) < size * 0.05f)
+							&& (std::abs(py - center) < size * 0.4f);
+						if (ring || bar)
+						{
+							++ covered;
+						}
+					}
+				}
+				ret[y * size * 2 + x] = static_cast<float>(covered) / (SAMPLES * SAMPLES);
+			}
+		}
+		return ret;
+	}
+
+	std::vector<float> Downsample(std::vector<float> const & img_2x, int size)
+	{
+		std::vector<float> ret(size * size);
+		for (int y = 0; y < size; ++ y)
+		{
+			for (int x = 0; x < size; ++ x)
+			{
+				ret[y * size + x] = (img_2x[(y * 2 + 0) * size * 2 + (x * 2 + 0)] + img_2x[(y * 2 + 0) * size * 2 + (x * 2 + 1)]
+					+ img_2x[(y * 2 + 1) * size * 2 + (x * 2 + 0)] + img_2x[(y * 2 + 1) * size * 2 + (x * 2 + 1)]) * 0.25f;
+			}
+		}
+		return ret;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(DistanceTransform2D)
+{
+	CheckAgainstBruteForce(67, 45, 1, 24, 1);
+}
+
+BOOST_AUTO_TEST_CASE(DistanceTransform3D)
+{
+	CheckAgainstBruteForce(23, 17, 13, 20, 0);
+}
+
+BOOST_AUTO_TEST_CASE(DistanceTransformNoFeature)
+{
+	std::vector<float> dist(16 * 8, std::numeric_limits<float>::infinity());
+	std::vector<uint32_t> nearest(dist.size());
+	MathLib::squared_distance_transform(&dist[0], &nearest[0], 16, 8, 1);
+
+	for (size_t i = 0; i < dist.size(); ++ i)
+	{
+		BOOST_CHECK_EQUAL(dist[i], std::numeric_limits<float>::infinity());
+		BOOST_CHECK_EQUAL(nearest[i], static_cast<uint32_t>(-1));
+	}
+}
+
+// A 128^3 volume on one thread and on all of them. They have to agree, and the time of both is reported.
+BOOST_AUTO_TEST_CASE(DistanceTransformThroughput)
+{
+	uint32_t const SIZE = 128;
+
+	std::vector<uint32_t> features;
+	std::vector<float> const volume = RandomFeatures(SIZE, SIZE, SIZE, 1000, features);
+
+	std::vector<float> serial = volume;
+	Timer timer;
+	MathLib::squared_distance_transform(&serial[0], nullptr, SIZE, SIZE, SIZE, 1);
+	double const serial_time = timer.elapsed();
+
+	std::vector<float> parallel = volume;
+	timer.restart();
+	MathLib::squared_distance_transform(&parallel[0], nullptr, SIZE, SIZE, SIZE);
+	double const parallel_time = timer.elapsed();
+
+	BOOST_CHECK(serial == parallel);
+	BOOST_TEST_MESSAGE("Distance transform of " << SIZE << "^3: " << serial_time * 1000 << " ms on 1 thread, "
+		<< parallel_time * 1000 << " ms on all threads, " << serial_time / parallel_time << "x");
+}
+
+// KFontGen's output changed with the exact transform. The sweeps keep the smallest anti-aliased distance they propagate
+// to a texel, the transform takes the texels around the nearest covered one. The signed distances of a glyph may differ
+// by at most 0.6 texel anywhere and 0.01 texel on average. It's 0.57 and 0.006 here, 0.82 and 0.08 without the texels
+// around the nearest one.
+BOOST_AUTO_TEST_CASE(DistanceTransformGlyphAgainstSweeps)
+{
+	int const SIZE = 32;
+	float const MAX_TOLERANCE = 0.6f;
+	float const MEAN_TOLERANCE = 0.01f;
+
+	std::vector<float> const aa_bitmap_2x = SyntheticGlyph2x(SIZE);
+
+	std::vector<float> aa_bitmap = Downsample(aa_bitmap_2x, SIZE);
+	std::vector<float2> grad(SIZE * SIZE);
+	std::vector<float> outside(SIZE * SIZE);
+	std::vector<float> inside(SIZE * SIZE);
+	std::vector<uint32_t> nearest(SIZE * SIZE);
+	std::vector<float> signed_dist(SIZE * SIZE);
+	GlyphSignedDistance(aa_bitmap_2x, SIZE, aa_bitmap, grad, outside, inside, nearest, signed_dist);
+
+	aa_bitmap = Downsample(aa_bitmap_2x, SIZE);
+	ComputeGradient(aa_bitmap_2x, SIZE, SIZE, grad);
+	SweepAAEuclideanDistance(aa_bitmap, grad, SIZE, SIZE, outside);
+	for (size_t i = 0; i < grad.size(); ++ i)
+	{
+		aa_bitmap[i] = 1 - aa_bitmap[i];
+		grad[i] = -grad[i];
+	}
+	SweepAAEuclideanDistance(aa_bitmap, grad, SIZE, SIZE, inside);
+
+	float max_diff = 0;
+	float sum_diff = 0;
+	for (size_t i = 0; i < signed_dist.size(); ++ i)
+	{
+		float const sweep_dist = std::max(inside[i], 0.0f) - std::max(outside[i], 0.0f);
+		float const diff = std::abs(signed_dist[i] - sweep_dist);
+		max_diff = std::max(max_diff, diff);
+		sum_diff += diff;
+	}
+	float const mean_diff = sum_diff / signed_dist.size();
+
+	BOOST_TEST_MESSAGE("Glyph distance against the sweeps: " << max_diff << " texel max, " << mean_diff << " texel mean");
+	BOOST_CHECK_LE(max_diff, MAX_TOLERANCE);
+	BOOST_CHECK_LE(mean_diff, MEAN_TOLERANCE);
+}
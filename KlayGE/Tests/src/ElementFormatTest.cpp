@@ -0,0 +1,253 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Color.hpp>
+#include <KFL/Half.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/ElementFormat.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Odd count to cover both the vectorized part and the tail of the converters
+	uint32_t const NUM_ELEMS = 67;
+
+	std::vector<uint8_t> RandomBytes(uint32_t size)
+	{
+		std::ranlux24_base gen(size);
+		std::vector<uint8_t> ret(size);
+		for (auto& b : ret)
+		{
+			b = static_cast<uint8_t>(gen());
+		}
+		return ret;
+	}
+
+	std::vector<float> RandomFloats(uint32_t size)
+	{
+		std::ranlux24_base gen(size);
+		std::uniform_real_distribution<float> dis(-0.5f, 1.5f);
+		std::vector<float> ret(size);
+		for (uint32_t i = 0; i < size; ++ i)
+		{
+			ret[i] = dis(gen);
+			if (i % 5 == 0)
+			{
+				// Half denormals
+				ret[i] *= 1e-5f;
+			}
+		}
+		return ret;
+	}
+
+	uint8_t ToUNorm8(float v)
+	{
+		return static_cast<uint8_t>(MathLib::clamp(static_cast<int>(v * 255.0f + 0.5f), 0, 255));
+	}
+
+	// A scalar copy of the per-texel float round trip ElementFormat used before the direct converters.
+	// It's kept here so the converters aren't checked against ConvertToABGR32F/ConvertFromABGR32F, which
+	// share their code.
+	Color ReferenceToColor(ElementFormat fmt, uint8_t const * p)
+	{
+		switch (fmt)
+		{
+		case EF_R8:
+			return Color(p[0] / 255.0f, 0, 0, 1);
+
+		case EF_GR8:
+			return Color(p[0] / 255.0f, p[1] / 255.0f, 0, 1);
+
+		case EF_ARGB8:
+			return Color(p[2] / 255.0f, p[1] / 255.0f, p[0] / 255.0f, p[3] / 255.0f);
+
+		case EF_ARGB8_SRGB:
+			return Color(MathLib::srgb_to_linear(p[2] / 255.0f), MathLib::srgb_to_linear(p[1] / 255.0f),
+				MathLib::srgb_to_linear(p[0] / 255.0f), MathLib::srgb_to_linear(p[3] / 255.0f));
+
+		case EF_R16F:
+			return Color(*reinterpret_cast<half const *>(p), 0, 0, 1);
+
+		default:
+			BOOST_ASSERT(false);
+			return Color(0, 0, 0, 0);
+		}
+	}
+
+	void ReferenceFromColor(ElementFormat fmt, Color const & clr, uint8_t* p)
+	{
+		switch (fmt)
+		{
+		case EF_R8:
+			p[0] = ToUNorm8(clr.r());
+			break;
+
+		case EF_ARGB8:
+			p[0] = ToUNorm8(clr.b());
+			p[1] = ToUNorm8(clr.g());
+			p[2] = ToUNorm8(clr.r());
+			p[3] = ToUNorm8(clr.a());
+			break;
+
+		case EF_ABGR8:
+			p[0] = ToUNorm8(clr.r());
+			p[1] = ToUNorm8(clr.g());
+			p[2] = ToUNorm8(clr.b());
+			p[3] = ToUNorm8(clr.a());
+			break;
+
+		case EF_ARGB8_SRGB:
+			p[0] = ToUNorm8(MathLib::linear_to_srgb(clr.b()));
+			p[1] = ToUNorm8(MathLib::linear_to_srgb(clr.g()));
+			p[2] = ToUNorm8(MathLib::linear_to_srgb(clr.r()));
+			p[3] = ToUNorm8(MathLib::linear_to_srgb(clr.a()));
+			break;
+
+		default:
+			BOOST_ASSERT(false);
+			break;
+		}
+	}
+
+	void TestAgainstReference(ElementFormat src_fmt, ElementFormat dst_fmt, void const * input)
+	{
+		BOOST_CHECK(DirectFormatConverter(src_fmt, dst_fmt) != nullptr);
+
+		uint32_t const src_elem_size = NumFormatBytes(src_fmt);
+		uint32_t const dst_elem_size = NumFormatBytes(dst_fmt);
+
+		std::vector<uint8_t> direct(NUM_ELEMS * dst_elem_size);
+		ConvertFormat(src_fmt, input, NUM_ELEMS, dst_fmt, &direct[0]);
+
+		std::vector<uint8_t> expected(direct.size());
+		uint8_t const * src = static_cast<uint8_t const *>(input);
+		for (uint32_t i = 0; i < NUM_ELEMS; ++ i)
+		{
+			ReferenceFromColor(dst_fmt, ReferenceToColor(src_fmt, src + i * src_elem_size), &expected[i * dst_elem_size]);
+		}
+
+		BOOST_CHECK(direct == expected);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(ConvertFormatSwizzle)
+{
+	std::vector<uint8_t> const argb = RandomBytes(NUM_ELEMS * 4);
+	std::vector<uint8_t> abgr(argb.size());
+	ConvertFormat(EF_ARGB8, &argb[0], NUM_ELEMS, EF_ABGR8, &abgr[0]);
+
+	bool same = true;
+	for (uint32_t i = 0; i < NUM_ELEMS; ++ i)
+	{
+		same &= (abgr[i * 4 + 0] == argb[i * 4 + 2]) && (abgr[i * 4 + 1] == argb[i * 4 + 1])
+			&& (abgr[i * 4 + 2] == argb[i * 4 + 0]) && (abgr[i * 4 + 3] == argb[i * 4 + 3]);
+	}
+	BOOST_CHECK(same);
+}
+
+BOOST_AUTO_TEST_CASE(ConvertFormatExpandUNorm8)
+{
+	std::vector<uint8_t> const input = RandomBytes(NUM_ELEMS * 2);
+	TestAgainstReference(EF_R8, EF_ARGB8, &input[0]);
+	TestAgainstReference(EF_R8, EF_ABGR8, &input[0]);
+	TestAgainstReference(EF_GR8, EF_ARGB8, &input[0]);
+	TestAgainstReference(EF_GR8, EF_ABGR8, &input[0]);
+}
+
+BOOST_AUTO_TEST_CASE(ConvertFormatSRGB)
+{
+	std::vector<uint8_t> const input = RandomBytes(NUM_ELEMS * 4);
+	TestAgainstReference(EF_ARGB8_SRGB, EF_ARGB8, &input[0]);
+	TestAgainstReference(EF_ARGB8, EF_ARGB8_SRGB, &input[0]);
+	TestAgainstReference(EF_ARGB8_SRGB, EF_ABGR8, &input[0]);
+
+	std::vector<float> linear(NUM_ELEMS * 4);
+	ConvertFormat(EF_ABGR8_SRGB, &input[0], NUM_ELEMS, EF_ABGR32F, &linear[0]);
+	bool same = true;
+	for (uint32_t i = 0; i < NUM_ELEMS * 4; ++ i)
+	{
+		same &= (linear[i] == MathLib::srgb_to_linear(input[i] / 255.0f));
+	}
+	BOOST_CHECK(same);
+}
+
+BOOST_AUTO_TEST_CASE(ConvertFormatUNorm8Float)
+{
+	std::vector<uint8_t> const input = RandomBytes(NUM_ELEMS * 4);
+	std::vector<float> const input_f32 = RandomFloats(NUM_ELEMS * 4);
+
+	std::vector<float> f32(NUM_ELEMS * 4);
+	ConvertFormat(EF_ARGB8, &input[0], NUM_ELEMS, EF_ABGR32F, &f32[0]);
+	bool same = true;
+	for (uint32_t i = 0; i < NUM_ELEMS; ++ i)
+	{
+		same &= (f32[i * 4 + 0] == input[i * 4 + 2] / 255.0f) && (f32[i * 4 + 1] == input[i * 4 + 1] / 255.0f)
+			&& (f32[i * 4 + 2] == input[i * 4 + 0] / 255.0f) && (f32[i * 4 + 3] == input[i * 4 + 3] / 255.0f);
+	}
+	BOOST_CHECK(same);
+
+	std::vector<uint8_t> argb(NUM_ELEMS * 4);
+	ConvertFormat(EF_ABGR32F, &input_f32[0], NUM_ELEMS, EF_ARGB8, &argb[0]);
+	same = true;
+	for (uint32_t i = 0; i < NUM_ELEMS * 4; ++ i)
+	{
+		int const expected = MathLib::clamp(static_cast<int>(input_f32[i ^ ((i & 1) ? 0 : 2)] * 255.0f + 0.5f), 0, 255);
+		same &= (argb[i] == expected);
+	}
+	BOOST_CHECK(same);
+}
+
+BOOST_AUTO_TEST_CASE(ConvertFormatHalf)
+{
+	std::vector<float> const input = RandomFloats(NUM_ELEMS * 4);
+
+	std::vector<half> f16(NUM_ELEMS * 4);
+	ConvertFormat(EF_ABGR32F, &input[0], NUM_ELEMS, EF_ABGR16F, &f16[0]);
+	bool same = true;
+	for (uint32_t i = 0; i < NUM_ELEMS * 4; ++ i)
+	{
+		half const expected(input[i]);
+		same &= (std::memcmp(&f16[i], &expected, sizeof(half)) == 0);
+	}
+	BOOST_CHECK(same);
+
+	std::vector<float> f32(NUM_ELEMS * 4);
+	ConvertFormat(EF_ABGR16F, &f16[0], NUM_ELEMS, EF_ABGR32F, &f32[0]);
+	same = true;
+	for (uint32_t i = 0; i < NUM_ELEMS * 4; ++ i)
+	{
+		same &= (f32[i] == static_cast<float>(f16[i]));
+	}
+	BOOST_CHECK(same);
+
+	TestAgainstReference(EF_R16F, EF_R8, &f16[0]);
+}
+
+BOOST_AUTO_TEST_CASE(ConvertFormatFallback)
+{
+	BOOST_CHECK(DirectFormatConverter(EF_R5G6B5, EF_ARGB8) == nullptr);
+
+	std::vector<uint8_t> const input = RandomBytes(NUM_ELEMS * 2);
+	std::vector<uint8_t> direct(NUM_ELEMS * 4);
+	ConvertFormat(EF_R5G6B5, &input[0], NUM_ELEMS, EF_ARGB8, &direct[0]);
+
+	std::vector<Color> colors(NUM_ELEMS);
+	ConvertToABGR32F(EF_R5G6B5, &input[0], NUM_ELEMS, &colors[0]);
+	std::vector<uint8_t> expected(direct.size());
+	ConvertFromABGR32F(EF_ARGB8, &colors[0], NUM_ELEMS, &expected[0]);
+	BOOST_CHECK(direct == expected);
+}
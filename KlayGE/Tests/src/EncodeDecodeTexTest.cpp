@@ -61,6 +61,26 @@ void TestEncodeDecodeTex(std::string const & input_name, std::string const & tc_
 		codec = MakeUniquePtr<TexCompressionETC1>();
 		break;
 
+	case EF_ETC2_BGR8:
+		codec = MakeUniquePtr<TexCompressionETC2RGB8>();
+		break;
+
+	case EF_ETC2_A1BGR8:
+		codec = MakeUniquePtr<TexCompressionETC2RGB8A1>();
+		break;
+
+	case EF_ETC2_ABGR8:
+		codec = MakeUniquePtr<TexCompressionETC2RGBA8>();
+		break;
+
+	case EF_ETC2_R11:
+		codec = MakeUniquePtr<TexCompressionETC2R11>();
+		break;
+
+	case EF_ETC2_GR11:
+		codec = MakeUniquePtr<TexCompressionETC2RG11>();
+		break;
+
 	default:
 		KFL_UNREACHABLE("Unsupported compression format");
 	}
@@ -77,7 +97,8 @@ void TestEncodeDecodeTex(std::string const & input_name, std::string const & tc_
 		LoadTexture(input_name, type, width, height, depth, num_mipmaps, array_size,
 			format, init_data, data_block);
 
-		BOOST_ASSERT(pixel_size == NumFormatBytes(format));
+		uint32_t const src_pixel_size = NumFormatBytes(format);
+		BOOST_ASSERT((pixel_size == src_pixel_size) || (EF_ARGB8 == format));
 
 		input_argb.resize(width * height * pixel_size);
 		array<uint8_t, 16> pixel;
@@ -88,8 +109,19 @@ void TestEncodeDecodeTex(std::string const & input_name, std::string const & tc_
 		{
 			for (uint32_t x = 0; x < width; ++ x)
 			{
-				memcpy(&pixel[0], &src[x * pixel_size], pixel_size);
-				if (EF_BC1 == bc_fmt)
+				memcpy(&pixel[0], &src[x * src_pixel_size], src_pixel_size);
+				if ((EF_R8 == decoded_fmt) || (EF_GR8 == decoded_fmt))
+				{
+					// Takes the R (and G) channel from an ARGB8 source
+					pixel[0] = pixel[2];
+				}
+				else if ((EF_R16 == decoded_fmt) || (EF_GR16 == decoded_fmt))
+				{
+					// Expands the R (and G) channel of an ARGB8 source to 16 bits
+					uint16_t const rg[] = { static_cast<uint16_t>(pixel[2] * 257), static_cast<uint16_t>(pixel[1] * 257) };
+					memcpy(&pixel[0], rg, sizeof(rg));
+				}
+				else if ((EF_BC1 == bc_fmt) || (EF_ETC2_A1BGR8 == bc_fmt))
 				{
 					if (pixel[3] < 128)
 					{
@@ -212,32 +244,38 @@ void TestEncodeDecodeTex(std::string const & input_name, std::string const & tc_
 			}
 		}
 	}
+	else if ((EF_R16 == decoded_fmt) || (EF_GR16 == decoded_fmt))
+	{
+		// In 8-bit units, as the other formats
+		uint16_t const * input_rg = reinterpret_cast<uint16_t const *>(&input_argb[0]);
+		uint16_t const * restored_rg = reinterpret_cast<uint16_t const *>(&restored_argb[0]);
+		for (uint32_t i = 0; i < width * height * pixel_size / 2; ++ i)
+		{
+			float const diff = (static_cast<float>(input_rg[i]) - restored_rg[i]) / 257;
+			mse += diff * diff;
+		}
+	}
 	else
 	{
-		for (uint32_t y = 0; y < height; ++y)
+		for (uint32_t i = 0; i < width * height * pixel_size; ++ i)
 		{
-			for (uint32_t x = 0; x < width; ++x)
-			{
-				float const a0 = input_argb[(y * width + x) * 4 + 3];
-				float const r0 = input_argb[(y * width + x) * 4 + 2];
-				float const g0 = input_argb[(y * width + x) * 4 + 1];
-				float const b0 = input_argb[(y * width + x) * 4 + 0];
-				float const a1 = restored_argb[(y * width + x) * 4 + 3];
-				float const r1 = restored_argb[(y * width + x) * 4 + 2];
-				float const g1 = restored_argb[(y * width + x) * 4 + 1];
-				float const b1 = restored_argb[(y * width + x) * 4 + 0];
-
-				float diff_a = a0 - a1;
-				float diff_r = r0 - r1;
-				float diff_g = g0 - g1;
-				float diff_b = b0 - b1;
-
-				mse += diff_a * diff_a + diff_r * diff_r + diff_g * diff_g + diff_b * diff_b;
-			}
+			float const diff = static_cast<float>(input_argb[i]) - restored_argb[i];
+			mse += diff * diff;
 		}
 	}
 
-	mse = sqrt(mse / (width * height) / 4);
+	if (EF_ABGR16F == decoded_fmt)
+	{
+		mse = sqrt(mse / (width * height) / 4);
+	}
+	else if ((EF_R16 == decoded_fmt) || (EF_GR16 == decoded_fmt))
+	{
+		mse = sqrt(mse / (width * height) / (pixel_size / 2));
+	}
+	else
+	{
+		mse = sqrt(mse / (width * height) / pixel_size);
+	}
 	BOOST_CHECK(mse < threshold);
 }
 
@@ -291,6 +329,16 @@ BOOST_AUTO_TEST_CASE(EncodeDecodeBC3)
 	TestEncodeDecodeTex("leaf_v3_green_tex.dds", "", EF_BC3, 8.9f);
 }
 
+BOOST_AUTO_TEST_CASE(EncodeDecodeBC6U)
+{
+	TestEncodeDecodeTex("memorial.dds", "", EF_BC6, 0.1f);
+}
+
+BOOST_AUTO_TEST_CASE(EncodeDecodeBC6S)
+{
+	TestEncodeDecodeTex("uffizi_probe.dds", "", EF_SIGNED_BC6, 0.1f);
+}
+
 BOOST_AUTO_TEST_CASE(EncodeDecodeBC7XRGB)
 {
 	TestEncodeDecodeTex("Lenna.dds", "", EF_BC7, 1.8f);
@@ -305,3 +353,266 @@ BOOST_AUTO_TEST_CASE(EncodeDecodeETC1)
 {
 	TestEncodeDecodeTex("Lenna.dds", "", EF_ETC1, 4.8f);
 }
+
+BOOST_AUTO_TEST_CASE(EncodeDecodeETC2RGB8)
+{
+	TestEncodeDecodeTex("Lenna.dds", "", EF_ETC2_BGR8, 4.8f);
+}
+
+BOOST_AUTO_TEST_CASE(EncodeDecodeETC2RGB8A1)
+{
+	TestEncodeDecodeTex("leaf_v3_green_tex.dds", "", EF_ETC2_A1BGR8, 8.9f);
+}
+
+BOOST_AUTO_TEST_CASE(EncodeDecodeETC2RGBA8)
+{
+	TestEncodeDecodeTex("leaf_v3_green_tex.dds", "", EF_ETC2_ABGR8, 8.9f);
+}
+
+BOOST_AUTO_TEST_CASE(EncodeDecodeETC2R11)
+{
+	TestEncodeDecodeTex("Lenna.dds", "", EF_ETC2_R11, 3.2f);
+}
+
+BOOST_AUTO_TEST_CASE(EncodeDecodeETC2RG11)
+{
+	TestEncodeDecodeTex("Lenna.dds", "", EF_ETC2_GR11, 3.2f);
+}
+
+// Smooth 16-bit ramps, which 8-bit decoding can't represent. Returns the RMS error in 11-bit units.
+float TestEncodeDecodeEAC(ElementFormat bc_fmt)
+{
+	std::unique_ptr<TexCompression> codec;
+	switch (bc_fmt)
+	{
+	case EF_ETC2_R11:
+		codec = MakeUniquePtr<TexCompressionETC2R11>();
+		break;
+
+	case EF_SIGNED_ETC2_R11:
+		codec = MakeUniquePtr<TexCompressionETC2SignedR11>();
+		break;
+
+	case EF_ETC2_GR11:
+		codec = MakeUniquePtr<TexCompressionETC2RG11>();
+		break;
+
+	case EF_SIGNED_ETC2_GR11:
+		codec = MakeUniquePtr<TexCompressionETC2SignedRG11>();
+		break;
+
+	default:
+		KFL_UNREACHABLE("Unsupported compression format");
+	}
+
+	bool const signed_fmt = IsSigned(codec->DecodedFormat());
+	uint32_t const num_channels = NumComponents(codec->DecodedFormat());
+
+	float mse = 0;
+	uint32_t num_values = 0;
+	for (uint32_t block = 0; block < 64; ++ block)
+	{
+		// Each block is a ramp in x, with a different start and slope. Signed blocks cross 0.
+		std::array<uint16_t, 32> input;
+		for (uint32_t y = 0; y < 4; ++ y)
+		{
+			for (uint32_t x = 0; x < 4; ++ x)
+			{
+				for (uint32_t ch = 0; ch < num_channels; ++ ch)
+				{
+					float const t = (block * 4 + x + y * 0.25f + ch * 7) / 300.0f;
+					float const v = signed_fmt ? MathLib::clamp(t * 2 - 1.1f, -1.0f, 1.0f) : MathLib::clamp(t, 0.0f, 1.0f);
+					int const quantized = static_cast<int>(MathLib::round(v * (signed_fmt ? 32767 : 65535)));
+					input[(y * 4 + x) * num_channels + ch] = static_cast<uint16_t>(quantized);
+				}
+			}
+		}
+
+		std::array<uint8_t, 16> bc_block;
+		codec->EncodeBlock(&bc_block[0], &input[0], TCM_Balanced);
+		std::array<uint16_t, 32> restored;
+		codec->DecodeBlock(&restored[0], &bc_block[0]);
+
+		for (uint32_t i = 0; i < 16 * num_channels; ++ i)
+		{
+			float diff;
+			if (signed_fmt)
+			{
+				int16_t const in = static_cast<int16_t>(input[i]);
+				int16_t const out = static_cast<int16_t>(restored[i]);
+				BOOST_CHECK((in < -64) ? (out < 0) : ((in > 64) ? (out > 0) : true));
+				diff = (static_cast<float>(in) - out) * 1023 / 32767;
+			}
+			else
+			{
+				diff = (static_cast<float>(input[i]) - restored[i]) * 2047 / 65535;
+			}
+			mse += diff * diff;
+			++ num_values;
+		}
+	}
+
+	// The ends of the range survive
+	if (signed_fmt)
+	{
+		std::array<uint16_t, 32> input;
+		for (uint32_t i = 0; i < input.size(); ++ i)
+		{
+			input[i] = static_cast<uint16_t>((i & 1) ? 32767 : -32767);
+		}
+		std::array<uint8_t, 16> bc_block;
+		codec->EncodeBlock(&bc_block[0], &input[0], TCM_Balanced);
+		std::array<uint16_t, 32> restored;
+		codec->DecodeBlock(&restored[0], &bc_block[0]);
+		for (uint32_t i = 0; i < 16 * num_channels; ++ i)
+		{
+			BOOST_CHECK_EQUAL(static_cast<int16_t>(restored[i]), static_cast<int16_t>(input[i]));
+		}
+	}
+
+	return sqrt(mse / num_values);
+}
+
+BOOST_AUTO_TEST_CASE(EncodeDecodeETC2R11Ramps)
+{
+	// Rounding the output to 8 bits alone would add an error of about 2.3
+	BOOST_CHECK_LT(TestEncodeDecodeEAC(EF_ETC2_R11), 1.5f);
+	BOOST_CHECK_LT(TestEncodeDecodeEAC(EF_ETC2_GR11), 1.5f);
+}
+
+BOOST_AUTO_TEST_CASE(EncodeDecodeETC2SignedR11Ramps)
+{
+	BOOST_CHECK_LT(TestEncodeDecodeEAC(EF_SIGNED_ETC2_R11), 1.5f);
+	BOOST_CHECK_LT(TestEncodeDecodeEAC(EF_SIGNED_ETC2_GR11), 1.5f);
+}
+
+void TestEncodeDecodeMem(std::string const & input_name, ElementFormat bc_fmt)
+{
+	std::unique_ptr<TexCompression> codec;
+	switch (bc_fmt)
+	{
+	case EF_BC1:
+		codec = MakeUniquePtr<TexCompressionBC1>();
+		break;
+
+	case EF_BC3:
+		codec = MakeUniquePtr<TexCompressionBC3>();
+		break;
+
+	case EF_ETC1:
+		codec = MakeUniquePtr<TexCompressionETC1>();
+		break;
+
+	case EF_ETC2_ABGR8:
+		codec = MakeUniquePtr<TexCompressionETC2RGBA8>();
+		break;
+
+	default:
+		KFL_UNREACHABLE("Unsupported compression format");
+	}
+
+	Texture::TextureType type;
+	uint32_t width, height, depth, num_mipmaps, array_size;
+	ElementFormat format;
+	std::vector<ElementInitData> init_data;
+	std::vector<uint8_t> data_block;
+	LoadTexture(input_name, type, width, height, depth, num_mipmaps, array_size,
+		format, init_data, data_block);
+
+	uint32_t const pixel_size = NumFormatBytes(codec->DecodedFormat());
+	BOOST_ASSERT(pixel_size == NumFormatBytes(format));
+
+	// Odd sizes to cover the partial blocks on the right and bottom edges
+	width -= 3;
+	height -= 1;
+
+	uint32_t const block_width = codec->BlockWidth();
+	uint32_t const block_height = codec->BlockHeight();
+	uint32_t const block_bytes = codec->BlockBytes();
+	uint32_t const num_blocks_x = (width + block_width - 1) / block_width;
+	uint32_t const num_blocks_y = (height + block_height - 1) / block_height;
+	uint32_t const bc_row_pitch = num_blocks_x * block_bytes;
+
+	uint8_t const * src = static_cast<uint8_t const *>(init_data[0].data);
+	uint32_t const src_pitch = init_data[0].row_pitch;
+
+	std::vector<uint8_t> ref_blocks(num_blocks_y * bc_row_pitch);
+	std::vector<uint8_t> uncompressed(block_width * block_height * pixel_size);
+	for (uint32_t by = 0; by < num_blocks_y; ++ by)
+	{
+		for (uint32_t bx = 0; bx < num_blocks_x; ++ bx)
+		{
+			for (uint32_t y = 0; y < block_height; ++ y)
+			{
+				for (uint32_t x = 0; x < block_width; ++ x)
+				{
+					uint32_t const sx = bx * block_width + x;
+					uint32_t const sy = by * block_height + y;
+					if ((sx < width) && (sy < height))
+					{
+						memcpy(&uncompressed[(y * block_width + x) * pixel_size], &src[sy * src_pitch + sx * pixel_size], pixel_size);
+					}
+					else
+					{
+						memset(&uncompressed[(y * block_width + x) * pixel_size], 0, pixel_size);
+					}
+				}
+			}
+
+			codec->EncodeBlock(&ref_blocks[by * bc_row_pitch + bx * block_bytes], &uncompressed[0], TCM_Balanced);
+		}
+	}
+
+	std::vector<uint8_t> bc_blocks(ref_blocks.size());
+	codec->EncodeMem(width, height, &bc_blocks[0], bc_row_pitch, static_cast<uint32_t>(bc_blocks.size()),
+		src, src_pitch, src_pitch * height, TCM_Balanced);
+	BOOST_CHECK(bc_blocks == ref_blocks);
+
+	std::vector<uint8_t> restored(width * height * pixel_size);
+	codec->DecodeMem(width, height, &restored[0], width * pixel_size, static_cast<uint32_t>(restored.size()),
+		&bc_blocks[0], bc_row_pitch, static_cast<uint32_t>(bc_blocks.size()));
+
+	bool same = true;
+	std::vector<uint8_t> decoded(block_width * block_height * pixel_size);
+	for (uint32_t by = 0; (by < num_blocks_y) && same; ++ by)
+	{
+		for (uint32_t bx = 0; (bx < num_blocks_x) && same; ++ bx)
+		{
+			codec->DecodeBlock(&decoded[0], &bc_blocks[by * bc_row_pitch + bx * block_bytes]);
+			for (uint32_t y = 0; y < block_height; ++ y)
+			{
+				for (uint32_t x = 0; x < block_width; ++ x)
+				{
+					uint32_t const sx = bx * block_width + x;
+					uint32_t const sy = by * block_height + y;
+					if ((sx < width) && (sy < height))
+					{
+						same &= (memcmp(&restored[(sy * width + sx) * pixel_size],
+							&decoded[(y * block_width + x) * pixel_size], pixel_size) == 0);
+					}
+				}
+			}
+		}
+	}
+	BOOST_CHECK(same);
+}
+
+BOOST_AUTO_TEST_CASE(EncodeDecodeMemBC1)
+{
+	TestEncodeDecodeMem("Lenna.dds", EF_BC1);
+}
+
+BOOST_AUTO_TEST_CASE(EncodeDecodeMemBC3)
+{
+	TestEncodeDecodeMem("leaf_v3_green_tex.dds", EF_BC3);
+}
+
+BOOST_AUTO_TEST_CASE(EncodeDecodeMemETC1)
+{
+	TestEncodeDecodeMem("Lenna.dds", EF_ETC1);
+}
+
+BOOST_AUTO_TEST_CASE(EncodeDecodeMemETC2RGBA8)
+{
+	TestEncodeDecodeMem("leaf_v3_green_tex.dds", EF_ETC2_ABGR8);
+}
@@ -0,0 +1,154 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/CXX17/filesystem.hpp>
+#include <KFL/Util.hpp>
+#include <KlayGE/RenderEffect.hpp>
+#include <KlayGE/ResLoader.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "BuildManifest.hpp"
+#include "ToolRunner.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	std::string const MANIFEST_HEADER = "FXMLJIT manifest 1";
+
+	std::string const PLATFORM = "d3d_11_0";
+
+	// Effects with parameters only. Without shaders the kfx is built without a shader compiler.
+	void WriteEffect(std::string const & name, std::string const & include_name, std::string const & param_name)
+	{
+		std::ofstream ofs(name.c_str());
+		ofs << "<?xml version='1.0'?>" << endl << endl;
+		ofs << "<effect>" << endl;
+		if (!include_name.empty())
+		{
+			ofs << "\t<include name=\"" << include_name << "\"/>" << endl;
+		}
+		ofs << "\t<cbuffer name=\"" << param_name << "_cb\">" << endl;
+		ofs << "\t\t<parameter type=\"float4\" name=\"" << param_name << "\"/>" << endl;
+		ofs << "\t</cbuffer>" << endl;
+		ofs << "</effect>" << endl;
+	}
+
+	int RunBatch(std::string const & tool_name, std::string const & batch)
+	{
+		return RunTool(tool_name, { PLATFORM, "-batch", batch });
+	}
+
+	void CheckKfxHeader(std::string const & kfx_name)
+	{
+		std::ifstream ifs(kfx_name.c_str(), std::ios_base::binary);
+		BOOST_REQUIRE(ifs);
+
+		uint32_t fourcc;
+		ifs.read(reinterpret_cast<char*>(&fourcc), sizeof(fourcc));
+		BOOST_CHECK_EQUAL(LE2Native(fourcc), (MakeFourCC<'K', 'F', 'X', ' '>::value));
+
+		uint32_t ver;
+		ifs.read(reinterpret_cast<char*>(&ver), sizeof(ver));
+		BOOST_CHECK_EQUAL(LE2Native(ver), KFX_VERSION);
+
+		uint32_t shader_fourcc;
+		ifs.read(reinterpret_cast<char*>(&shader_fourcc), sizeof(shader_fourcc));
+		BOOST_CHECK_EQUAL(LE2Native(shader_fourcc), (MakeFourCC<'D', 'X', 'B', 'C'>::value));
+
+		uint32_t shader_ver;
+		ifs.read(reinterpret_cast<char*>(&shader_ver), sizeof(shader_ver));
+
+		uint8_t platform_name_len;
+		ifs.read(reinterpret_cast<char*>(&platform_name_len), sizeof(platform_name_len));
+		std::string platform_name(platform_name_len, '\0');
+		ifs.read(&platform_name[0], platform_name_len);
+		BOOST_CHECK_EQUAL(platform_name, PLATFORM);
+		BOOST_CHECK(ifs);
+	}
+}
+
+// Runs the tool in batch mode on effects written by the test. Needs the tools to be built.
+BOOST_AUTO_TEST_CASE(FXMLJITBatchKfxAndManifest)
+{
+	std::string const tool_name = LocateTool("FXMLJIT");
+	BOOST_REQUIRE_MESSAGE(!tool_name.empty(), "FXMLJIT is not built.");
+
+	std::filesystem::path const dir = ResLoader::Instance().LocalFolder() + "FXMLJITTest";
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir / "Batch");
+	std::filesystem::create_directories(dir / "Single");
+
+	std::string const include_name = "FXMLJITTestInclude.fxml";
+	std::string const effect_name = (dir / "Batch" / "FXMLJITTestEffect.fxml").string();
+	std::string const kfx_name = (dir / "Batch" / "FXMLJITTestEffect.kfx").string();
+	std::string const other_effect_name = (dir / "Single" / "FXMLJITTestOther.fxml").string();
+	std::string const manifest_name = (dir / "Batch" / ("FXMLJIT_" + PLATFORM + ".manifest")).string();
+	WriteEffect((dir / "Batch" / include_name).string(), "", "included_color");
+	WriteEffect(effect_name, include_name, "color");
+	WriteEffect(other_effect_name, "", "other_color");
+
+	// The whole folder, the include is built as an effect too
+	BOOST_REQUIRE_EQUAL(RunBatch(tool_name, (dir / "Batch").string()), 0);
+	CheckKfxHeader(kfx_name);
+
+	std::string digest;
+	{
+		BuildManifest manifest(manifest_name, MANIFEST_HEADER);
+		BOOST_CHECK_EQUAL(manifest.Entries().size(), 2U);
+		auto iter = manifest.Entries().find(effect_name);
+		BOOST_REQUIRE(iter != manifest.Entries().end());
+		BOOST_REQUIRE_EQUAL(iter->second.dependencies.size(), 1U);
+		BOOST_CHECK_EQUAL(iter->second.dependencies[0], include_name);
+		digest = iter->second.digest;
+	}
+
+	// Unchanged, not built again. A rebuild would drop the mark.
+	uint64_t const kfx_size = std::filesystem::file_size(kfx_name);
+	{
+		std::ofstream ofs(kfx_name.c_str(), std::ios_base::binary | std::ios_base::app);
+		ofs.put('\0');
+	}
+	BOOST_REQUIRE_EQUAL(RunBatch(tool_name, (dir / "Batch").string()), 0);
+	BOOST_CHECK_EQUAL(std::filesystem::file_size(kfx_name), kfx_size + 1);
+
+	// A list in the same folder builds another effect. The entries of the first batch are kept.
+	std::string const list_name = (dir / "Batch" / "List.txt").string();
+	{
+		std::ofstream ofs(list_name.c_str());
+		ofs << other_effect_name << endl;
+	}
+	BOOST_REQUIRE_EQUAL(RunBatch(tool_name, list_name), 0);
+	CheckKfxHeader((dir / "Single" / "FXMLJITTestOther.kfx").string());
+	{
+		BuildManifest manifest(manifest_name, MANIFEST_HEADER);
+		BOOST_CHECK_EQUAL(manifest.Entries().size(), 3U);
+		BOOST_CHECK(manifest.UpToDate(effect_name, digest));
+		BOOST_CHECK(manifest.Entries().find(other_effect_name) != manifest.Entries().end());
+	}
+
+	// A change in the include makes the effect dirty
+	WriteEffect((dir / "Batch" / include_name).string(), "", "changed_color");
+	BOOST_REQUIRE_EQUAL(RunBatch(tool_name, (dir / "Batch").string()), 0);
+	CheckKfxHeader(kfx_name);
+	{
+		BuildManifest manifest(manifest_name, MANIFEST_HEADER);
+		BOOST_CHECK(!manifest.UpToDate(effect_name, digest));
+		BOOST_CHECK(manifest.Entries().find(effect_name) != manifest.Entries().end());
+	}
+
+	std::filesystem::remove_all(dir);
+}
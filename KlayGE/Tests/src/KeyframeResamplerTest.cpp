@@ -0,0 +1,259 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Timer.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "KeyframeResampler.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Resampling frame by frame, as MeshConv did before, with the rotations of the translation keys at their own times
+	template <typename T>
+	float ReferenceInterpTime(std::vector<T> const & vec, float time, size_t& itime_lower, size_t& itime_upper)
+	{
+		if (vec.size() == 1)
+		{
+			itime_lower = 0;
+			itime_upper = 0;
+			return 0;
+		}
+
+		size_t vec_size = vec.size();
+		size_t i = 0;
+		for (i = itime_upper; i < vec_size; ++ i)
+		{
+			if (vec[i].first >= time)
+			{
+				break;
+			}
+		}
+
+		if (i == 0)
+		{
+			itime_lower = 0;
+			itime_upper = 1;
+		}
+		else if (i >= vec.size() - 1)
+		{
+			itime_lower = vec_size - 2;
+			itime_upper = vec_size - 1;
+		}
+		else
+		{
+			itime_lower = i - 1;
+			itime_upper = i;
+		}
+
+		float diff = vec[itime_upper].first - vec[itime_lower].first;
+		return MathLib::clamp((diff == 0) ? 0 : (time - vec[itime_lower].first) / diff, 0.0f, 1.0f);
+	}
+
+	Quaternion ReferenceRotation(JointKeyframe const & okf, float time)
+	{
+		if (okf.quats.empty())
+		{
+			return Quaternion(0, 0, 0, 1);
+		}
+
+		size_t lower = 0;
+		size_t upper = 0;
+		float const fraction = ReferenceInterpTime(okf.quats, time, lower, upper);
+		return MathLib::slerp(okf.quats[lower].second, okf.quats[upper].second, fraction);
+	}
+
+	void ReferenceResample(int start_frame, int end_frame, float fps_scale, JointKeyframe const & okf,
+		JointResampledKeyframe& rkf)
+	{
+		size_t i_pos = 0;
+		size_t i_rot = 0;
+		size_t i_scale = 0;
+		for (int i = start_frame; i < end_frame; ++ i)
+		{
+			float time = i * fps_scale;
+			size_t prev_i = 0;
+			float fraction = 0.0f;
+			float3 scale_resampled(1, 1, 1);
+			Quaternion bind_real_resampled(0, 0, 0, 1);
+			Quaternion bind_dual_resampled(0, 0, 0, 0);
+
+			if (!okf.scale.empty())
+			{
+				fraction = ReferenceInterpTime(okf.scale, time, prev_i, i_scale);
+				scale_resampled = MathLib::lerp(okf.scale[prev_i].second, okf.scale[i_scale].second, fraction);
+			}
+			if (!okf.quats.empty())
+			{
+				fraction = ReferenceInterpTime(okf.quats, time, prev_i, i_rot);
+				bind_real_resampled = MathLib::slerp(okf.quats[prev_i].second, okf.quats[i_rot].second, fraction);
+			}
+			if (!okf.pos.empty())
+			{
+				fraction = ReferenceInterpTime(okf.pos, time, prev_i, i_pos);
+
+				Quaternion const bind_real_prev_i = ReferenceRotation(okf, okf.pos[prev_i].first);
+				Quaternion const bind_real_i_pos = ReferenceRotation(okf, okf.pos[i_pos].first);
+				auto bind_dual_prev_i = MathLib::quat_trans_to_udq(bind_real_prev_i, okf.pos[prev_i].second);
+				auto bind_dual_i_pos = MathLib::quat_trans_to_udq(bind_real_i_pos, okf.pos[i_pos].second);
+
+				auto bind_dq_resampled = MathLib::sclerp(bind_real_prev_i, bind_dual_prev_i,
+					bind_real_i_pos, bind_dual_i_pos, fraction);
+
+				bind_dual_resampled = MathLib::quat_trans_to_udq(bind_real_resampled,
+					MathLib::udq_to_trans(bind_dq_resampled.first, bind_dq_resampled.second));
+			}
+
+			if (MathLib::SignBit(bind_real_resampled.w()) < 0)
+			{
+				bind_real_resampled = -bind_real_resampled;
+				bind_dual_resampled = -bind_dual_resampled;
+			}
+
+			rkf.push_back({ i, bind_real_resampled, bind_dual_resampled, scale_resampled.x() });
+		}
+	}
+
+	// Keys at random times, some of them at the same time, and rotations that sometimes flip sign
+	JointKeyframe RandomKeys(std::mt19937& gen, uint32_t num_pos, uint32_t num_quats, uint32_t num_scale, float duration)
+	{
+		std::uniform_real_distribution<float> dist(-1, 1);
+		std::uniform_real_distribution<float> step(0, 2 * duration / std::max(std::max(num_pos, num_quats), 1U));
+
+		JointKeyframe kf;
+		float time = 0;
+		for (uint32_t i = 0; i < num_pos; ++ i)
+		{
+			kf.pos.emplace_back(time, float3(dist(gen), dist(gen), dist(gen)) * 10.0f);
+			time += (i % 7 == 3) ? 0 : step(gen);
+		}
+		time = 0;
+		for (uint32_t i = 0; i < num_quats; ++ i)
+		{
+			Quaternion q = MathLib::normalize(Quaternion(dist(gen), dist(gen), dist(gen), dist(gen)));
+			kf.quats.emplace_back(time, q);
+			if (i % 5 == 2)
+			{
+				// Almost the same rotation again, which is linearly interpolated
+				kf.quats.emplace_back(time + 0.5f, q);
+				++ i;
+			}
+			time += step(gen);
+		}
+		time = 0;
+		for (uint32_t i = 0; i < num_scale; ++ i)
+		{
+			float const s = 1 + dist(gen) * 0.5f;
+			kf.scale.emplace_back(time, float3(s, s, s));
+			time += step(gen);
+		}
+		return kf;
+	}
+
+	bool SameBits(JointResampledKeyframe const & lhs, JointResampledKeyframe const & rhs)
+	{
+		if (lhs.size() != rhs.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < lhs.size(); ++ i)
+		{
+			if ((lhs[i].frame != rhs[i].frame)
+				|| (std::memcmp(&lhs[i].bind_real, &rhs[i].bind_real, sizeof(lhs[i].bind_real)) != 0)
+				|| (std::memcmp(&lhs[i].bind_dual, &rhs[i].bind_dual, sizeof(lhs[i].bind_dual)) != 0)
+				|| (std::memcmp(&lhs[i].scale, &rhs[i].scale, sizeof(lhs[i].scale)) != 0))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(KeyframeResamplerSameAsFrameByFrame)
+{
+	std::mt19937 gen(7);
+	uint32_t const key_counts[][3] = { { 1, 1, 1 }, { 2, 2, 0 }, { 0, 5, 0 }, { 0, 0, 3 }, { 5, 0, 0 }, { 30, 30, 30 },
+		{ 4, 90, 1 }, { 7, 200, 0 }, { 200, 7, 0 }, { 500, 500, 2 } };
+	for (auto const & counts : key_counts)
+	{
+		JointKeyframe const kf = RandomKeys(gen, counts[0], counts[1], counts[2], 100);
+		for (float const fps_scale : { 0.04f, 1.0f, 3.3f })
+		{
+			JointResampledKeyframe expected;
+			ReferenceResample(0, 250, fps_scale, kf, expected);
+			JointResampledKeyframe resampled;
+			ResampleJointTransform(0, 250, fps_scale, kf, resampled);
+			BOOST_CHECK(SameBits(resampled, expected));
+		}
+	}
+
+	// Appends after what is already there, starting from any frame
+	JointKeyframe const kf = RandomKeys(gen, 10, 10, 10, 10);
+	JointResampledKeyframe expected;
+	ReferenceResample(0, 20, 0.5f, kf, expected);
+	ReferenceResample(20, 40, 0.5f, kf, expected);
+	JointResampledKeyframe resampled;
+	ResampleJointTransform(0, 20, 0.5f, kf, resampled);
+	ResampleJointTransform(20, 40, 0.5f, kf, resampled);
+	BOOST_CHECK(SameBits(resampled, expected));
+}
+
+BOOST_AUTO_TEST_CASE(KeyframeResamplerTiming)
+{
+	// An animated character, 60 joints for 2 minutes. Captured with a key every 1/30 s and resampled at 25 fps, and
+	// hand animated with a key every 1/5 s and resampled at 60 fps, where many frames are between the same keys.
+	// Keys per second, frames per second
+	uint32_t const rates[][2] = { { 30, 25 }, { 5, 60 } };
+	for (auto const & rate : rates)
+	{
+		std::mt19937 gen(11);
+		uint32_t const num_joints = 60;
+		uint32_t const num_keys = rate[0] * 120;
+		int const num_frames = static_cast<int>(rate[1] * 120);
+		std::vector<JointKeyframe> kfs;
+		for (uint32_t i = 0; i < num_joints; ++ i)
+		{
+			kfs.push_back(RandomKeys(gen, num_keys, num_keys, num_keys / 10, 120));
+		}
+
+		Timer timer;
+		std::vector<JointResampledKeyframe> expected(num_joints);
+		for (uint32_t i = 0; i < num_joints; ++ i)
+		{
+			ReferenceResample(0, num_frames, 120.0f / num_frames, kfs[i], expected[i]);
+		}
+		double const reference_time = timer.elapsed();
+
+		timer.restart();
+		std::vector<JointResampledKeyframe> resampled(num_joints);
+		for (uint32_t i = 0; i < num_joints; ++ i)
+		{
+			ResampleJointTransform(0, num_frames, 120.0f / num_frames, kfs[i], resampled[i]);
+		}
+		double const resample_time = timer.elapsed();
+
+		BOOST_TEST_MESSAGE("Resampling " << num_joints << " joints, " << num_keys << " keys, " << num_frames
+			<< " frames: frame by frame " << reference_time * 1000 << " ms, by key intervals " << resample_time * 1000
+			<< " ms");
+
+		for (uint32_t i = 0; i < num_joints; ++ i)
+		{
+			BOOST_CHECK(SameBits(resampled[i], expected[i]));
+		}
+	}
+}
@@ -0,0 +1,301 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/CXX17/filesystem.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/ResIdentifier.hpp>
+#include <KFL/Timer.hpp>
+#include <KFL/XMLDom.hpp>
+#include <KlayGE/ResLoader.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ToolRunner.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+// The scene is a skinned mesh with a quad for each joint, and an animation with a key every 1/30 s for a minute. Each
+// joint rotates around its own axis and moves along it. Whatever axes the handedness conversions of the importers end
+// up with, the cos of half the rotation angle and the length of the translation of every frame stay the same, so the
+// key frames written by MeshConv can be checked against the keys resampled frame by frame.
+namespace
+{
+	uint32_t const NUM_JOINTS = 40;
+	uint32_t const TICKS_PER_SECOND = 30;
+	uint32_t const NUM_KEYS = TICKS_PER_SECOND * 60;
+
+	// The same as in MeshConv
+	int const RESAMPLE_FPS = 25;
+
+	// Of the values of a frame, well above the keys dropped by MeshMLObj and the precision of the meshml
+	float const TOLERANCE = 0.005f;
+
+	struct JointKeys
+	{
+		float3 axis;
+		std::vector<Quaternion> quats;
+		std::vector<float3> pos;
+	};
+
+	std::vector<JointKeys> SceneKeys()
+	{
+		std::mt19937 gen(13);
+		std::uniform_real_distribution<float> dist(-1, 1);
+
+		std::vector<JointKeys> ret(NUM_JOINTS);
+		for (auto& joint : ret)
+		{
+			joint.axis = MathLib::normalize(float3(dist(gen), dist(gen), dist(gen) + 2));
+			for (uint32_t i = 0; i < NUM_KEYS; ++ i)
+			{
+				joint.quats.push_back(MathLib::rotation_axis(joint.axis, dist(gen) * 2));
+				joint.pos.push_back(joint.axis * (dist(gen) * 2));
+			}
+		}
+		return ret;
+	}
+
+	// A DirectX text file, which assimp reads with its skin and its animation
+	void WriteScene(std::string const & name, std::vector<JointKeys> const & keys)
+	{
+		std::ofstream ofs(name.c_str());
+		ofs.precision(9);
+
+		ofs << "xof 0303txt 0032" << endl << endl;
+		ofs << "AnimTicksPerSecond {" << endl << "\t" << TICKS_PER_SECOND << ";" << endl << "}" << endl << endl;
+
+		ofs << "Frame Root {" << endl;
+		ofs << "\tFrameTransformMatrix {" << endl;
+		ofs << "\t\t1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1;;" << endl;
+		ofs << "\t}" << endl;
+
+		ofs << "\tMesh Quads {" << endl;
+		ofs << "\t\t" << NUM_JOINTS * 4 << ";" << endl;
+		for (uint32_t j = 0; j < NUM_JOINTS; ++ j)
+		{
+			ofs << "\t\t" << j << ";0;0;," << endl;
+			ofs << "\t\t" << j + 1 << ";0;0;," << endl;
+			ofs << "\t\t" << j + 1 << ";1;0;," << endl;
+			ofs << "\t\t" << j << ";1;0;" << ((j == NUM_JOINTS - 1) ? ";" : ",") << endl;
+		}
+		ofs << "\t\t" << NUM_JOINTS * 2 << ";" << endl;
+		for (uint32_t j = 0; j < NUM_JOINTS; ++ j)
+		{
+			ofs << "\t\t3;" << j * 4 + 0 << "," << j * 4 + 1 << "," << j * 4 + 2 << ";," << endl;
+			ofs << "\t\t3;" << j * 4 + 0 << "," << j * 4 + 2 << "," << j * 4 + 3 << ";"
+				<< ((j == NUM_JOINTS - 1) ? ";" : ",") << endl;
+		}
+		for (uint32_t j = 0; j < NUM_JOINTS; ++ j)
+		{
+			ofs << "\t\tSkinWeights {" << endl;
+			ofs << "\t\t\t\"Joint" << j << "\";" << endl;
+			ofs << "\t\t\t4;" << endl;
+			ofs << "\t\t\t" << j * 4 + 0 << "," << j * 4 + 1 << "," << j * 4 + 2 << "," << j * 4 + 3 << ";" << endl;
+			ofs << "\t\t\t1,1,1,1;" << endl;
+			ofs << "\t\t\t1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1;;" << endl;
+			ofs << "\t\t}" << endl;
+		}
+		ofs << "\t}" << endl;
+
+		for (uint32_t j = 0; j < NUM_JOINTS; ++ j)
+		{
+			ofs << "\tFrame Joint" << j << " {" << endl;
+			ofs << "\t\tFrameTransformMatrix {" << endl;
+			ofs << "\t\t\t1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1;;" << endl;
+			ofs << "\t\t}" << endl;
+			ofs << "\t}" << endl;
+		}
+		ofs << "}" << endl << endl;
+
+		ofs << "AnimationSet Wave {" << endl;
+		for (uint32_t j = 0; j < NUM_JOINTS; ++ j)
+		{
+			ofs << "\tAnimation {" << endl;
+			ofs << "\t\t{ Joint" << j << " }" << endl;
+
+			ofs << "\t\tAnimationKey {" << endl;
+			ofs << "\t\t\t0;" << endl;
+			ofs << "\t\t\t" << NUM_KEYS << ";" << endl;
+			for (uint32_t i = 0; i < NUM_KEYS; ++ i)
+			{
+				Quaternion const & q = keys[j].quats[i];
+				ofs << "\t\t\t" << i << ";4;" << q.w() << "," << q.x() << "," << q.y() << "," << q.z() << ";;"
+					<< ((i == NUM_KEYS - 1) ? ";" : ",") << endl;
+			}
+			ofs << "\t\t}" << endl;
+
+			ofs << "\t\tAnimationKey {" << endl;
+			ofs << "\t\t\t2;" << endl;
+			ofs << "\t\t\t" << NUM_KEYS << ";" << endl;
+			for (uint32_t i = 0; i < NUM_KEYS; ++ i)
+			{
+				float3 const & p = keys[j].pos[i];
+				ofs << "\t\t\t" << i << ";3;" << p.x() << "," << p.y() << "," << p.z() << ";;"
+					<< ((i == NUM_KEYS - 1) ? ";" : ",") << endl;
+			}
+			ofs << "\t\t}" << endl;
+
+			ofs << "\t}" << endl;
+		}
+		ofs << "}" << endl;
+	}
+
+	// The cos of half the rotation angle and the length of the translation
+	float2 Invariants(Quaternion const & real, Quaternion const & dual)
+	{
+		float const scale = MathLib::length(real);
+		return float2(MathLib::abs(real.w()) / scale, 2 * MathLib::length(dual) / scale);
+	}
+
+	// The frame of the keys, resampled frame by frame as MeshConv has always done it
+	float2 ReferenceFrame(JointKeys const & keys, float time)
+	{
+		uint32_t upper = 0;
+		while ((upper < NUM_KEYS) && !(upper >= time))
+		{
+			++ upper;
+		}
+		upper = std::min(std::max(upper, 1U), NUM_KEYS - 1);
+		uint32_t const lower = upper - 1;
+		float const fraction = MathLib::clamp(time - lower, 0.0f, 1.0f);
+
+		Quaternion const & lhs_real = keys.quats[lower];
+		Quaternion const & rhs_real = keys.quats[upper];
+		auto const dq = MathLib::sclerp(lhs_real, MathLib::quat_trans_to_udq(lhs_real, keys.pos[lower]),
+			rhs_real, MathLib::quat_trans_to_udq(rhs_real, keys.pos[upper]), fraction);
+		return Invariants(MathLib::slerp(lhs_real, rhs_real, fraction), dq.second);
+	}
+
+	struct WrittenKeys
+	{
+		std::vector<int> frames;
+		std::vector<Quaternion> reals;
+		std::vector<Quaternion> duals;
+	};
+
+	// The key frames of the joints by name
+	std::map<std::string, WrittenKeys> ReadKeyframes(std::string const & meshml_name, int& num_frames)
+	{
+		std::vector<std::string> joint_names;
+		std::map<std::string, WrittenKeys> ret;
+		num_frames = 0;
+
+		XMLReader reader(MakeSharedPtr<ResIdentifier>(meshml_name, 0,
+			MakeSharedPtr<std::ifstream>(meshml_name.c_str(), std::ios_base::binary)));
+		WrittenKeys* joint_keys = nullptr;
+		while (reader.Read())
+		{
+			std::string const & name = reader.Name();
+			if (!reader.IsStartElement())
+			{
+				// The keys of the bounding boxes are not for joints
+				if ("key_frame" == name)
+				{
+					joint_keys = nullptr;
+				}
+				continue;
+			}
+
+			if ("bone" == name)
+			{
+				joint_names.push_back(reader.AttribString("name", ""));
+			}
+			else if ("key_frames_chunk" == name)
+			{
+				num_frames = reader.AttribInt("num_frames", 0);
+			}
+			else if ("key_frame" == name)
+			{
+				uint32_t const joint = reader.AttribUInt("joint", 0);
+				BOOST_REQUIRE_LT(joint, joint_names.size());
+				joint_keys = &ret[joint_names[joint]];
+			}
+			else if (("key" == name) && joint_keys)
+			{
+				joint_keys->frames.push_back(reader.AttribInt("id", 0));
+			}
+			else if ((("real" == name) || ("dual" == name)) && joint_keys)
+			{
+				float v[4] = { 0, 0, 0, 0 };
+				reader.AttribArray("v", v, 4);
+				(("real" == name) ? joint_keys->reals : joint_keys->duals).push_back(Quaternion(v));
+			}
+		}
+		return ret;
+	}
+
+	// The frame the engine interpolates from the keys MeshMLObj kept
+	float2 WrittenFrame(WrittenKeys const & keys, int frame)
+	{
+		size_t upper = std::upper_bound(keys.frames.begin(), keys.frames.end(), frame) - keys.frames.begin();
+		upper = std::min(std::max<size_t>(upper, 1), keys.frames.size() - 1);
+		size_t const lower = upper - 1;
+		float const factor = MathLib::clamp(static_cast<float>(frame - keys.frames[lower])
+			/ (keys.frames[upper] - keys.frames[lower]), 0.0f, 1.0f);
+		auto const dq = MathLib::sclerp(MathLib::normalize(keys.reals[lower]), keys.duals[lower],
+			MathLib::normalize(keys.reals[upper]), keys.duals[upper], factor);
+		return Invariants(dq.first, dq.second);
+	}
+}
+
+// Imports an animated scene written by the test. Needs the tools, with assimp, to be built.
+BOOST_AUTO_TEST_CASE(MeshConvAnimatedSceneTiming)
+{
+	std::string const tool_name = LocateTool("MeshConv");
+	BOOST_REQUIRE_MESSAGE(!tool_name.empty(), "MeshConv is not built.");
+
+	std::filesystem::path const dir = ResLoader::Instance().LocalFolder() + "MeshConvTest";
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir);
+	std::string const scene_name = (dir / "MeshConvTestScene.x").string();
+	std::string const meshml_name = (dir / "MeshConvTestScene.meshml").string();
+
+	std::vector<JointKeys> const keys = SceneKeys();
+	WriteScene(scene_name, keys);
+
+	Timer timer;
+	BOOST_REQUIRE_EQUAL(RunTool(tool_name, { "-I", scene_name, "-T", dir.string(), "-q" }), 0);
+	BOOST_TEST_MESSAGE("Importing " << NUM_JOINTS << " joints with " << NUM_KEYS << " keys each: " << timer.elapsed()
+		<< " s");
+
+	int num_frames;
+	std::map<std::string, WrittenKeys> const written = ReadKeyframes(meshml_name, num_frames);
+	float const fps_scale = static_cast<float>(TICKS_PER_SECOND) / RESAMPLE_FPS;
+	float const duration = static_cast<float>(NUM_KEYS - 1) / TICKS_PER_SECOND;
+	BOOST_CHECK_EQUAL(num_frames, static_cast<int>(ceilf(duration * RESAMPLE_FPS)));
+
+	for (uint32_t j = 0; j < NUM_JOINTS; ++ j)
+	{
+		auto iter = written.find("Joint" + std::to_string(j));
+		BOOST_REQUIRE(iter != written.end());
+		WrittenKeys const & joint_keys = iter->second;
+		BOOST_REQUIRE_GE(joint_keys.frames.size(), 2U);
+		BOOST_REQUIRE_EQUAL(joint_keys.reals.size(), joint_keys.frames.size());
+		BOOST_REQUIRE_EQUAL(joint_keys.duals.size(), joint_keys.frames.size());
+
+		float max_error = 0;
+		for (int f = 0; f < num_frames; ++ f)
+		{
+			float2 const diff = WrittenFrame(joint_keys, f) - ReferenceFrame(keys[j], f * fps_scale);
+			max_error = std::max(max_error, std::max(MathLib::abs(diff.x()), MathLib::abs(diff.y())));
+		}
+		BOOST_CHECK_LE(max_error, TOLERANCE);
+	}
+
+	std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,205 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <MeshMLLib/MeshOptimizer.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// A grid with triangles in random order, like what exporters of large scanned or sculpted meshes produce
+	void ShuffledGrid(uint32_t size, std::vector<float3>& positions, std::vector<uint32_t>& indices)
+	{
+		positions.clear();
+		for (uint32_t y = 0; y <= size; ++ y)
+		{
+			for (uint32_t x = 0; x <= size; ++ x)
+			{
+				positions.push_back(float3(static_cast<float>(x), static_cast<float>(y), 0));
+			}
+		}
+
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (uint32_t y = 0; y < size; ++ y)
+		{
+			for (uint32_t x = 0; x < size; ++ x)
+			{
+				uint32_t const v0 = y * (size + 1) + x;
+				uint32_t const v1 = v0 + 1;
+				uint32_t const v2 = v0 + size + 1;
+				uint32_t const v3 = v2 + 1;
+				triangles.push_back({ { v0, v1, v2 } });
+				triangles.push_back({ { v1, v3, v2 } });
+			}
+		}
+		std::shuffle(triangles.begin(), triangles.end(), std::ranlux24_base(size));
+
+		indices.clear();
+		for (auto const & tri : triangles)
+		{
+			indices.insert(indices.end(), tri.begin(), tri.end());
+		}
+	}
+
+	// Triangles as vertex positions, so orders with different vertex numbering compare equal. Triangles are moved
+	// around as a whole, the first vertex and the winding never change.
+	std::vector<std::array<float, 9>> SortedTriangles(std::vector<uint32_t> const & indices, std::vector<float3> const & positions)
+	{
+		std::vector<std::array<float, 9>> ret;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			std::array<float, 9> tri;
+			for (uint32_t j = 0; j < 3; ++ j)
+			{
+				float3 const & p = positions[indices[i + j]];
+				tri[j * 3 + 0] = p.x();
+				tri[j * 3 + 1] = p.y();
+				tri[j * 3 + 2] = p.z();
+			}
+			ret.push_back(tri);
+		}
+		std::sort(ret.begin(), ret.end());
+		return ret;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(MeshOptimizerAnalyze)
+{
+	std::vector<uint32_t> indices = { 0, 1, 2 };
+	VertexCacheStatistics stats = AnalyzeVertexCache(indices, 3);
+	BOOST_CHECK_EQUAL(stats.acmr, 3.0f);
+	BOOST_CHECK_EQUAL(stats.atvr, 1.0f);
+
+	// The second triangle shares an edge
+	indices = { 0, 1, 2, 2, 1, 3 };
+	stats = AnalyzeVertexCache(indices, 4);
+	BOOST_CHECK_EQUAL(stats.acmr, 2.0f);
+	BOOST_CHECK_EQUAL(stats.atvr, 1.0f);
+
+	// Vertex 0 is pushed out by 3 others with a cache of 3
+	indices = { 0, 1, 2, 3, 4, 5, 0, 4, 5 };
+	stats = AnalyzeVertexCache(indices, 6, 3);
+	BOOST_CHECK_EQUAL(stats.acmr, 7.0f / 3);
+	BOOST_CHECK_EQUAL(stats.atvr, 7.0f / 6);
+}
+
+BOOST_AUTO_TEST_CASE(MeshOptimizerVertexFetch)
+{
+	std::vector<uint32_t> indices = { 4, 2, 5, 5, 2, 0 };
+	std::vector<uint32_t> remap;
+	uint32_t const num_vertices = OptimizeVertexFetch(remap, indices, 7);
+
+	BOOST_CHECK_EQUAL(num_vertices, 4U);
+	std::vector<uint32_t> const expected_indices = { 0, 1, 2, 2, 1, 3 };
+	BOOST_CHECK(indices == expected_indices);
+	std::vector<uint32_t> const expected_remap = { 3, UNUSED_VERTEX, 1, UNUSED_VERTEX, 0, 2, UNUSED_VERTEX };
+	BOOST_CHECK(remap == expected_remap);
+
+	std::vector<float> attribs = { 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6 };
+	RemapVertices(attribs, remap, num_vertices);
+	std::vector<float> const expected_attribs = { 4, 4, 2, 2, 5, 5, 0, 0 };
+	BOOST_CHECK(attribs == expected_attribs);
+}
+
+BOOST_AUTO_TEST_CASE(MeshOptimizerVertexCache)
+{
+	std::vector<float3> positions;
+	std::vector<uint32_t> indices;
+	ShuffledGrid(64, positions, indices);
+	uint32_t const num_vertices = static_cast<uint32_t>(positions.size());
+
+	std::vector<uint32_t> const original = indices;
+	VertexCacheStatistics const before = AnalyzeVertexCache(indices, num_vertices);
+
+	std::vector<uint32_t> const clusters = OptimizeVertexCache(indices, num_vertices);
+	VertexCacheStatistics const after = AnalyzeVertexCache(indices, num_vertices);
+
+	BOOST_CHECK(SortedTriangles(indices, positions) == SortedTriangles(original, positions));
+	BOOST_CHECK(!clusters.empty() && (0 == clusters[0]));
+	BOOST_CHECK(std::adjacent_find(clusters.begin(), clusters.end(), std::greater_equal<uint32_t>()) == clusters.end());
+	BOOST_CHECK_LT(clusters.back(), indices.size() / 3);
+
+	// Random order misses on nearly every vertex
+	BOOST_CHECK_GT(before.acmr, 2.5f);
+	BOOST_CHECK_LT(after.acmr, 0.8f);
+	BOOST_CHECK_LT(after.atvr, 1.5f);
+}
+
+BOOST_AUTO_TEST_CASE(MeshOptimizerOverdrawWithoutClusters)
+{
+	std::vector<float3> positions;
+	std::vector<uint32_t> indices;
+	ShuffledGrid(16, positions, indices);
+
+	// The whole mesh is one cluster, no triangle is lost
+	std::vector<uint32_t> const original = indices;
+	OptimizeOverdraw(indices, std::vector<uint32_t>(), positions);
+	BOOST_CHECK(SortedTriangles(indices, positions) == SortedTriangles(original, positions));
+}
+
+BOOST_AUTO_TEST_CASE(MeshOptimizerFullPipeline)
+{
+	std::vector<float3> positions;
+	std::vector<uint32_t> indices;
+	ShuffledGrid(64, positions, indices);
+
+	// Pushes the grid onto a half sphere, so clusters face different ways
+	for (auto& pos : positions)
+	{
+		float const theta = pos.x() / 64 * PI;
+		float const phi = (pos.y() / 64 * 0.8f + 0.1f) * PI;
+		pos = float3(MathLib::cos(theta) * MathLib::sin(phi), MathLib::sin(theta) * MathLib::sin(phi), MathLib::cos(phi));
+	}
+	// An extra vertex no triangle uses
+	positions.push_back(float3(10, 10, 10));
+
+	std::vector<uint32_t> const original = indices;
+
+	std::vector<uint32_t> vcache_only = indices;
+	OptimizeVertexCache(vcache_only, static_cast<uint32_t>(positions.size()));
+	VertexCacheStatistics const vcache_only_stats = AnalyzeVertexCache(vcache_only, static_cast<uint32_t>(positions.size()));
+
+	std::vector<uint32_t> remap;
+	MeshOptimizationResult const result = OptimizeMesh(remap, indices, positions);
+
+	BOOST_CHECK_EQUAL(result.num_vertices, positions.size() - 1);
+	BOOST_CHECK_EQUAL(remap.back(), UNUSED_VERTEX);
+	BOOST_CHECK_LT(result.after.acmr, result.before.acmr / 3);
+	BOOST_CHECK_LT(result.after.atvr, result.before.atvr / 3);
+
+	// Splitting clusters for overdraw costs only a little of the cache efficiency
+	BOOST_CHECK_LT(result.after.acmr, vcache_only_stats.acmr * 1.1f);
+
+	// The vertex buffer is read in order
+	uint32_t next_new = 0;
+	bool first_use_order = true;
+	for (auto const index : indices)
+	{
+		first_use_order &= (index <= next_new);
+		if (index == next_new)
+		{
+			++ next_new;
+		}
+	}
+	BOOST_CHECK(first_use_order);
+
+	std::vector<float3> remapped_positions = positions;
+	RemapVertices(remapped_positions, remap, result.num_vertices);
+	BOOST_CHECK(SortedTriangles(indices, remapped_positions) == SortedTriangles(original, positions));
+}
@@ -0,0 +1,256 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/Mesh.hpp>
+#include <MeshMLLib/MeshSimplifier.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	uint32_t const SPHERE_SLICES = 64;
+	uint32_t const SPHERE_STACKS = 32;
+
+	// A unit UV sphere. The first and last columns are at the same positions with different texcoords, and so are the
+	// vertices at each pole. Attributes are the normal and the texcoord.
+	void UVSphere(std::vector<float3>& positions, std::vector<float>& attribs, std::vector<uint32_t>& indices)
+	{
+		positions.clear();
+		attribs.clear();
+		for (uint32_t y = 0; y <= SPHERE_STACKS; ++ y)
+		{
+			for (uint32_t x = 0; x <= SPHERE_SLICES; ++ x)
+			{
+				float const u = static_cast<float>(x) / SPHERE_SLICES;
+				float const v = static_cast<float>(y) / SPHERE_STACKS;
+				// Both ends of the seam have to be exactly at the same place
+				float const theta = (x == SPHERE_SLICES) ? 0 : u * 2 * PI;
+				float const phi = v * PI;
+				float3 p(MathLib::cos(theta) * MathLib::sin(phi), MathLib::sin(theta) * MathLib::sin(phi), MathLib::cos(phi));
+				if ((0 == y) || (SPHERE_STACKS == y))
+				{
+					p = float3(0, 0, (0 == y) ? 1.0f : -1.0f);
+				}
+				positions.push_back(p);
+				attribs.push_back(p.x());
+				attribs.push_back(p.y());
+				attribs.push_back(p.z());
+				attribs.push_back(u);
+				attribs.push_back(v);
+			}
+		}
+
+		indices.clear();
+		for (uint32_t y = 0; y < SPHERE_STACKS; ++ y)
+		{
+			for (uint32_t x = 0; x < SPHERE_SLICES; ++ x)
+			{
+				uint32_t const v0 = y * (SPHERE_SLICES + 1) + x;
+				uint32_t const v1 = v0 + 1;
+				uint32_t const v2 = v0 + SPHERE_SLICES + 1;
+				uint32_t const v3 = v2 + 1;
+				if (y != 0)
+				{
+					indices.insert(indices.end(), { v0, v2, v1 });
+				}
+				if (y != SPHERE_STACKS - 1)
+				{
+					indices.insert(indices.end(), { v1, v2, v3 });
+				}
+			}
+		}
+	}
+
+	float PointTriangleDistance(float3 const & p, float3 const & a, float3 const & b, float3 const & c)
+	{
+		float3 const ab = b - a;
+		float3 const ac = c - a;
+		float3 const n = MathLib::cross(ab, ac);
+		float const n_len_sq = MathLib::length_sq(n);
+		if (n_len_sq > 0)
+		{
+			// Inside the triangle, the distance to the plane
+			float3 const ap = p - a;
+			float const w1 = MathLib::dot(MathLib::cross(ap, ac), n) / n_len_sq;
+			float const w2 = MathLib::dot(MathLib::cross(ab, ap), n) / n_len_sq;
+			if ((w1 >= 0) && (w2 >= 0) && (w1 + w2 <= 1))
+			{
+				return MathLib::abs(MathLib::dot(ap, n)) / MathLib::sqrt(n_len_sq);
+			}
+		}
+
+		float ret = std::numeric_limits<float>::max();
+		float3 const * edges[][2] = { { &a, &b }, { &b, &c }, { &c, &a } };
+		for (auto const & edge : edges)
+		{
+			float3 const d = *edge[1] - *edge[0];
+			float const d_len_sq = MathLib::length_sq(d);
+			float const t = (d_len_sq > 0) ? MathLib::clamp(MathLib::dot(p - *edge[0], d) / d_len_sq, 0.0f, 1.0f) : 0.0f;
+			ret = std::min(ret, MathLib::length(p - (*edge[0] + d * t)));
+		}
+		return ret;
+	}
+
+	// Both ways: from the original vertices to the simplified triangles, and from points on the simplified triangles to
+	// the sphere
+	float SphereHausdorffDistance(std::vector<float3> const & positions, std::vector<uint32_t> const & simplified)
+	{
+		float ret = 0;
+		for (auto const & p : positions)
+		{
+			float dist = std::numeric_limits<float>::max();
+			for (size_t i = 0; i < simplified.size(); i += 3)
+			{
+				dist = std::min(dist, PointTriangleDistance(p, positions[simplified[i + 0]], positions[simplified[i + 1]],
+					positions[simplified[i + 2]]));
+			}
+			ret = std::max(ret, dist);
+		}
+
+		for (size_t i = 0; i < simplified.size(); i += 3)
+		{
+			float3 const & a = positions[simplified[i + 0]];
+			float3 const & b = positions[simplified[i + 1]];
+			float3 const & c = positions[simplified[i + 2]];
+			for (uint32_t s = 0; s <= 4; ++ s)
+			{
+				for (uint32_t t = 0; s + t <= 4; ++ t)
+				{
+					float3 const p = a + (b - a) * (s / 4.0f) + (c - a) * (t / 4.0f);
+					ret = std::max(ret, MathLib::abs(1 - MathLib::length(p)));
+				}
+			}
+		}
+
+		return ret;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(MeshSimplifierTriangleCounts)
+{
+	std::vector<float3> positions;
+	std::vector<float> attribs;
+	std::vector<uint32_t> indices;
+	UVSphere(positions, attribs, indices);
+	uint32_t const num_triangles = static_cast<uint32_t>(indices.size() / 3);
+
+	std::vector<LodLevel> const lods = GenerateLods(indices, positions, attribs, 5, 4);
+	BOOST_REQUIRE_EQUAL(lods.size(), 4U);
+
+	uint32_t target = num_triangles;
+	float last_error = 0;
+	for (auto const & lod : lods)
+	{
+		target /= 2;
+		uint32_t const lod_num_triangles = static_cast<uint32_t>(lod.indices.size() / 3);
+		BOOST_CHECK_LE(lod_num_triangles, target);
+		BOOST_CHECK_GE(lod_num_triangles, target - 2);
+		BOOST_CHECK_GE(lod.error, last_error);
+		last_error = lod.error;
+
+		for (auto const index : lod.indices)
+		{
+			BOOST_CHECK_LT(index, positions.size());
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(MeshSimplifierHausdorff)
+{
+	std::vector<float3> positions;
+	std::vector<float> attribs;
+	std::vector<uint32_t> indices;
+	UVSphere(positions, attribs, indices);
+
+	std::vector<LodLevel> const lods = GenerateLods(indices, positions, attribs, 5, 4);
+	BOOST_REQUIRE_EQUAL(lods.size(), 4U);
+
+	// A regular icosphere with as many triangles is off by about 1 / triangles. Quadrics are allowed to be 4 times worse.
+	for (auto const & lod : lods)
+	{
+		float const dist = SphereHausdorffDistance(positions, lod.indices);
+		BOOST_CHECK_LT(dist, 4 * 4 * PI / (lod.indices.size() / 3));
+		// The error stored is in the same range, so it can choose levels
+		BOOST_CHECK_LT(dist, lod.error * 4);
+		BOOST_CHECK_GT(dist, lod.error / 4);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(MeshSimplifierSeams)
+{
+	std::vector<float3> positions;
+	std::vector<float> attribs;
+	std::vector<uint32_t> indices;
+	UVSphere(positions, attribs, indices);
+
+	MeshSimplifier simplifier(indices, positions, attribs, 5);
+	simplifier.Simplify(static_cast<uint32_t>(indices.size() / 3 / 16));
+	std::vector<uint32_t> const simplified = simplifier.Indices();
+
+	// Triangles don't stretch across the seam in texture space. It would take a triangle with vertices at both u = 0
+	// and u = 1.
+	for (size_t i = 0; i < simplified.size(); i += 3)
+	{
+		float min_u = 1;
+		float max_u = 0;
+		for (uint32_t j = 0; j < 3; ++ j)
+		{
+			float const u = attribs[simplified[i + j] * 5 + 3];
+			min_u = std::min(min_u, u);
+			max_u = std::max(max_u, u);
+		}
+		BOOST_CHECK_LT(max_u - min_u, 0.5f);
+	}
+
+	// Still closed, every edge is shared by 2 triangles with opposite directions
+	std::vector<std::pair<float3, float3>> edges;
+	for (size_t i = 0; i < simplified.size(); i += 3)
+	{
+		for (uint32_t j = 0; j < 3; ++ j)
+		{
+			edges.emplace_back(positions[simplified[i + j]], positions[simplified[i + (j + 1) % 3]]);
+		}
+	}
+	uint32_t num_open = 0;
+	for (auto const & edge : edges)
+	{
+		bool found = false;
+		for (auto const & other : edges)
+		{
+			if ((other.first == edge.second) && (other.second == edge.first))
+			{
+				found = true;
+				break;
+			}
+		}
+		if (!found)
+		{
+			++ num_open;
+		}
+	}
+	BOOST_CHECK_EQUAL(num_open, 0U);
+}
+
+BOOST_AUTO_TEST_CASE(MeshSimplifierSelectLod)
+{
+	std::vector<MeshLod> const lods = { { 3000, 0, 0.0f }, { 1500, 3000, 0.01f }, { 750, 4500, 0.04f } };
+
+	BOOST_CHECK_EQUAL(SelectMeshLod(lods, 1000.0f, 1.0f), 0U);
+	BOOST_CHECK_EQUAL(SelectMeshLod(lods, 100.0f, 1.0f), 1U);
+	BOOST_CHECK_EQUAL(SelectMeshLod(lods, 10.0f, 1.0f), 2U);
+	BOOST_CHECK_EQUAL(SelectMeshLod(lods, 10.0f, 0.01f), 0U);
+}
@@ -0,0 +1,199 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/CXX17/filesystem.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/RenderMaterial.hpp>
+#include <KlayGE/ResLoader.hpp>
+#include <KlayGE/Texture.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ToolRunner.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+// The input is a small cube with a radiance linear in the direction, 1 + d / 2. A lobe symmetric around n averages d to
+// k * n, so the reference cube of each level has a closed form:
+//  - level 0 is the input,
+//  - the specular levels are 1 + k * n / 2, k the mean cos of the Blinn-Phong lobe of PrefilterCubeSpecularPS,
+//  - the diffuse level is 1 + n / 3, k = 2 / 3 for the cosine lobe.
+// What's left is the bilinear sampling, the clamped face edges and the ABGR16F output.
+namespace
+{
+	uint32_t const CUBE_SIZE = 64;
+
+	// The same as PrefilterCube.fxml
+	uint32_t const NUM_SAMPLES = 1024;
+
+	// The relative RMS error of a level the tool has to be within
+	float const TOLERANCE = 0.005f;
+
+	int RunCPU(std::string const & tool_name, std::string const & in_name, std::string const & out_name,
+		std::string const & ref_name)
+	{
+		std::ostringstream ss;
+		ss << TOLERANCE;
+		return RunTool(tool_name, { in_name, out_name, "-cpu", "-ref", ref_name, ss.str() });
+	}
+
+	uint32_t NumPrefilteredMipmaps(uint32_t width)
+	{
+		uint32_t num_mipmaps = 1;
+		while (width > 8)
+		{
+			++ num_mipmaps;
+			width /= 2;
+		}
+		return num_mipmaps;
+	}
+
+	// ToDir in PrefilterCube.fxml
+	float3 ToDir(uint32_t face, float x, float y)
+	{
+		float3 dir;
+		switch (face)
+		{
+		case Texture::CF_Positive_X:
+			dir = float3(+1, 1 - y * 2, 1 - x * 2);
+			break;
+
+		case Texture::CF_Negative_X:
+			dir = float3(-1, 1 - y * 2, x * 2 - 1);
+			break;
+
+		case Texture::CF_Positive_Y:
+			dir = float3(x * 2 - 1, +1, y * 2 - 1);
+			break;
+
+		case Texture::CF_Negative_Y:
+			dir = float3(x * 2 - 1, -1, 1 - y * 2);
+			break;
+
+		case Texture::CF_Positive_Z:
+			dir = float3(x * 2 - 1, 1 - y * 2, +1);
+			break;
+
+		default:
+			dir = float3(1 - x * 2, 1 - y * 2, -1);
+			break;
+		}
+
+		return MathLib::normalize(dir);
+	}
+
+	// The mean n dot l weighted cos of the light directions of PrefilterCubeSpecularPS, with its Hammersley points and
+	// ImportanceSampleBP
+	float BlinnPhongMeanCos(float shininess)
+	{
+		double sum_cos = 0;
+		double sum_weight = 0;
+		for (uint32_t i = 0; i < NUM_SAMPLES; ++ i)
+		{
+			uint32_t bits = i;
+			bits = (bits << 16) | (bits >> 16);
+			bits = ((bits & 0x55555555) << 1) | ((bits & 0xAAAAAAAA) >> 1);
+			bits = ((bits & 0x33333333) << 2) | ((bits & 0xCCCCCCCC) >> 2);
+			bits = ((bits & 0x0F0F0F0F) << 4) | ((bits & 0xF0F0F0F0) >> 4);
+			bits = ((bits & 0x00FF00FF) << 8) | ((bits & 0xFF00FF00) >> 8);
+			float const xi_y = bits * 2.3283064365386963e-10f;
+
+			float const cos_theta = pow(1 - xi_y * (shininess + 1) / (shininess + 2), 1 / (shininess + 1));
+			float const n_dot_l = 2 * cos_theta * cos_theta - 1;
+			if (n_dot_l > 0)
+			{
+				sum_cos += n_dot_l * n_dot_l;
+				sum_weight += n_dot_l;
+			}
+		}
+		return static_cast<float>(sum_cos / sum_weight);
+	}
+
+	// Each level of a cube in ABGR32F, texel = 1 + k * dir / 2
+	void SaveLinearCube(std::string const & name, uint32_t size, std::vector<float> const & level_k)
+	{
+		uint32_t const num_mipmaps = static_cast<uint32_t>(level_k.size());
+
+		std::vector<ElementInitData> init_data(6 * num_mipmaps);
+		std::vector<std::vector<float>> data_block(init_data.size());
+		for (uint32_t face = 0; face < 6; ++ face)
+		{
+			for (uint32_t level = 0; level < num_mipmaps; ++ level)
+			{
+				uint32_t const width = std::max(size >> level, 1U);
+
+				std::vector<float>& block = data_block[face * num_mipmaps + level];
+				block.resize(width * width * 4);
+				for (uint32_t y = 0; y < width; ++ y)
+				{
+					for (uint32_t x = 0; x < width; ++ x)
+					{
+						float3 const dir = ToDir(face, (x + 0.5f) / width, (y + 0.5f) / width);
+						float* texel = &block[(y * width + x) * 4];
+						texel[0] = 1 + level_k[level] * dir.x() / 2;
+						texel[1] = 1 + level_k[level] * dir.y() / 2;
+						texel[2] = 1 + level_k[level] * dir.z() / 2;
+						texel[3] = 1;
+					}
+				}
+
+				ElementInitData& data = init_data[face * num_mipmaps + level];
+				data.data = &block[0];
+				data.row_pitch = width * sizeof(float) * 4;
+				data.slice_pitch = data.row_pitch * width;
+			}
+		}
+
+		SaveTexture(name, Texture::TT_Cube, size, size, 1, num_mipmaps, 1, EF_ABGR32F, init_data);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(PrefilterCubeCPUAgainstReference)
+{
+	std::string const tool_name = LocateTool("PrefilterCube");
+	BOOST_REQUIRE_MESSAGE(!tool_name.empty(), "PrefilterCube is not built.");
+
+	std::filesystem::path const dir = ResLoader::Instance().LocalFolder() + "PrefilterCubeTest";
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir);
+	std::string const in_name = (dir / "Linear.dds").string();
+	std::string const out_name = (dir / "Linear_filtered.dds").string();
+	std::string const ref_name = (dir / "Linear_reference.dds").string();
+
+	uint32_t const num_mipmaps = NumPrefilteredMipmaps(CUBE_SIZE);
+	BOOST_REQUIRE_GE(num_mipmaps, 4U);
+
+	SaveLinearCube(in_name, CUBE_SIZE, std::vector<float>(1, 1.0f));
+
+	// The glossiness of each level as in PrefilterCubeCPU and PrefilterCubeGPU
+	std::vector<float> level_k(num_mipmaps);
+	level_k[0] = 1;
+	for (uint32_t level = 1; level < num_mipmaps - 1; ++ level)
+	{
+		float const shininess = Glossiness2Shininess(static_cast<float>(num_mipmaps - 2 - level) / (num_mipmaps - 2));
+		level_k[level] = BlinnPhongMeanCos(shininess);
+	}
+	level_k[num_mipmaps - 1] = 2 / 3.0f;
+
+	SaveLinearCube(ref_name, CUBE_SIZE, level_k);
+	BOOST_CHECK_EQUAL(RunCPU(tool_name, in_name, out_name, ref_name), 0);
+
+	// The tolerance tells a rough lobe from no filtering at all
+	level_k[num_mipmaps - 2] = 1;
+	SaveLinearCube(ref_name, CUBE_SIZE, level_k);
+	BOOST_CHECK_NE(RunCPU(tool_name, in_name, out_name, ref_name), 0);
+
+	std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,399 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Hash.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Timer.hpp>
+#include <KFL/XMLDom.hpp>
+#include <KFL/CXX17/filesystem.hpp>
+#include <KlayGE/RenderEffect.hpp>
+#include <KlayGE/ResLoader.hpp>
+
+#include <boost/assert.hpp>
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/lexical_cast.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	char const * const TEST_EFFECTS[] =
+	{
+		"Blitter.fxml",
+		"PostProcess.fxml",
+		"RenderableHelper.fxml",
+		"SkyBox.fxml",
+		"DeferredRendering.fxml"
+	};
+
+	// What ParameterByName used to do
+	RenderEffectParameter* ParameterByNameLinear(RenderEffect const & effect, std::string const & name)
+	{
+		size_t const name_hash = HashRange(name.begin(), name.end());
+		for (uint32_t i = 0; i < effect.NumParameters(); ++ i)
+		{
+			if (name_hash == effect.ParameterByIndex(i)->NameHash())
+			{
+				return effect.ParameterByIndex(i);
+			}
+		}
+		return nullptr;
+	}
+
+	// What read_var used to do with array values
+	template <typename T>
+	std::vector<T> ParseArraySplit(XMLNode const & value_node, uint32_t max_count)
+	{
+		std::string value_str = value_node.ValueString();
+		std::vector<std::string> strs;
+		boost::algorithm::split(strs, value_str, boost::is_any_of(","));
+		std::vector<T> ret(std::min(max_count, static_cast<uint32_t>(strs.size())));
+		for (size_t i = 0; i < ret.size(); ++ i)
+		{
+			boost::algorithm::trim(strs[i]);
+			ret[i] = boost::lexical_cast<T>(strs[i]);
+		}
+		return ret;
+	}
+
+	template <typename T>
+	std::vector<T> ParseArrayInPlace(XMLNode const & value_node, uint32_t max_count)
+	{
+		std::vector<T> ret(max_count);
+		ret.resize(value_node.ValueArray(&ret[0], max_count));
+		return ret;
+	}
+
+	void CollectParameters(XMLNodePtr const & node, std::vector<XMLNodePtr>& params)
+	{
+		for (XMLNodePtr child = node->FirstNode(); child; child = child->NextSibling())
+		{
+			if (XNT_Element == child->Type())
+			{
+				if ("parameter" == child->Name())
+				{
+					params.push_back(child);
+				}
+				CollectParameters(child, params);
+			}
+		}
+	}
+
+	template <typename T>
+	void CompareArrayParsing(XMLNode const & value_node, uint32_t max_count, double& split_time, double& in_place_time)
+	{
+		int const NUM_ITERATIONS = 100;
+
+		std::vector<T> expected;
+		Timer timer;
+		for (int i = 0; i < NUM_ITERATIONS; ++ i)
+		{
+			expected = ParseArraySplit<T>(value_node, max_count);
+		}
+		split_time += timer.elapsed();
+
+		std::vector<T> vals;
+		timer.restart();
+		for (int i = 0; i < NUM_ITERATIONS; ++ i)
+		{
+			vals = ParseArrayInPlace<T>(value_node, max_count);
+		}
+		in_place_time += timer.elapsed();
+
+		BOOST_CHECK(vals == expected);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(RenderEffectParameterLookup)
+{
+	for (auto const & effect_name : TEST_EFFECTS)
+	{
+		RenderEffectPtr effect = SyncLoadRenderEffect(effect_name);
+		BOOST_REQUIRE(effect);
+
+		for (uint32_t i = 0; i < effect->NumParameters(); ++ i)
+		{
+			std::string const & name = effect->ParameterByIndex(i)->Name();
+			BOOST_CHECK(effect->ParameterByName(name) == ParameterByNameLinear(*effect, name));
+			BOOST_CHECK(effect->ParameterByIndex(effect->ParameterIndexByName(name))->Name() == name);
+		}
+		for (uint32_t i = 0; i < effect->NumCBuffers(); ++ i)
+		{
+			std::string const & name = effect->CBufferByIndex(i)->Name();
+			BOOST_CHECK(effect->CBufferByName(name) == effect->CBufferByIndex(i));
+			BOOST_CHECK(effect->CBufferIndexByName(name) == i);
+		}
+
+		BOOST_CHECK(effect->ParameterByName("no_such_parameter") == nullptr);
+		BOOST_CHECK(effect->ParameterIndexByName("no_such_parameter") == RenderEffect::INVALID_INDEX);
+		BOOST_CHECK(effect->CBufferByName("no_such_cbuffer") == nullptr);
+		BOOST_CHECK(effect->CBufferIndexByName("no_such_cbuffer") == RenderEffect::INVALID_INDEX);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(RenderEffectParameterHandleInClone)
+{
+	RenderEffectPtr effect = SyncLoadRenderEffect("PostProcess.fxml");
+	BOOST_REQUIRE(effect && (effect->NumParameters() > 0));
+	RenderEffectPtr clone = effect->Clone();
+
+	for (uint32_t i = 0; i < effect->NumParameters(); ++ i)
+	{
+		std::string const & name = effect->ParameterByIndex(i)->Name();
+		uint32_t const handle = effect->ParameterIndexByName(name);
+		BOOST_CHECK(clone->ParameterByIndex(handle) == clone->ParameterByName(name));
+		BOOST_CHECK(clone->ParameterByIndex(handle) != effect->ParameterByIndex(handle));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(RenderEffectASyncLoad)
+{
+	RenderEffectPtr effect = ASyncLoadRenderEffect("Resizer.fxml");
+	BOOST_REQUIRE(effect);
+	while (!effect->HWResourceReady())
+	{
+		ResLoader::Instance().Update();
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	RenderEffectPtr sync_effect = SyncLoadRenderEffect("Resizer.fxml");
+	BOOST_REQUIRE(sync_effect && sync_effect->HWResourceReady());
+	BOOST_CHECK_EQUAL(effect->NumParameters(), sync_effect->NumParameters());
+	BOOST_CHECK_EQUAL(effect->NumCBuffers(), sync_effect->NumCBuffers());
+	BOOST_CHECK_EQUAL(effect->NumTechniques(), sync_effect->NumTechniques());
+	BOOST_CHECK(effect->ParameterByIndex(0) != sync_effect->ParameterByIndex(0));
+}
+
+BOOST_AUTO_TEST_CASE(RenderEffectCBufferDirtyRanges)
+{
+	RenderEffectConstantBuffer cbuff;
+	BOOST_CHECK(!cbuff.Dirty());
+
+	cbuff.Dirty(0, 4);
+	cbuff.Dirty(4, 12);
+	BOOST_CHECK_EQUAL(cbuff.NumDirtyRanges(), 1U);
+	BOOST_CHECK_EQUAL(cbuff.DirtyBytes(), 16U);
+
+	// A gap of up to one float4 is uploaded along with the ranges around it
+	cbuff.Dirty(32, 16);
+	BOOST_CHECK_EQUAL(cbuff.NumDirtyRanges(), 1U);
+	BOOST_CHECK_EQUAL(cbuff.DirtyBytes(), 48U);
+
+	cbuff.Dirty(256, 16);
+	cbuff.Dirty(128, 16);
+	BOOST_CHECK_EQUAL(cbuff.NumDirtyRanges(), 3U);
+	BOOST_CHECK_EQUAL(cbuff.DirtyBytes(), 80U);
+
+	cbuff.Dirty(40, 100);
+	BOOST_CHECK_EQUAL(cbuff.NumDirtyRanges(), 2U);
+	BOOST_CHECK_EQUAL(cbuff.DirtyBytes(), 160U);
+
+	cbuff.Dirty(false);
+	BOOST_CHECK(!cbuff.Dirty());
+
+	// Scattered writes don't turn into an unbounded number of uploads
+	for (uint32_t i = 0; i < 32; ++ i)
+	{
+		cbuff.Dirty(i * 64, 4);
+	}
+	BOOST_CHECK(cbuff.NumDirtyRanges() <= 8);
+	BOOST_CHECK(cbuff.DirtyBytes() >= 32 * 4);
+	cbuff.Dirty(false);
+}
+
+BOOST_AUTO_TEST_CASE(RenderEffectCBufferParameterDirty)
+{
+	uint32_t num_tested = 0;
+	for (auto const & effect_name : TEST_EFFECTS)
+	{
+		RenderEffectPtr effect = SyncLoadRenderEffect(effect_name);
+		BOOST_REQUIRE(effect);
+
+		for (uint32_t i = 0; i < effect->NumParameters(); ++ i)
+		{
+			RenderEffectParameter& param = *effect->ParameterByIndex(i);
+			if (param.InCBuffer() && (REDT_float4 == param.Type()))
+			{
+				RenderEffectConstantBuffer& cbuff = param.CBuffer();
+				cbuff.Update();
+				BOOST_CHECK(!cbuff.Dirty());
+
+				float4 value;
+				param.Value(value);
+				param = value;
+				BOOST_CHECK(!cbuff.Dirty());
+
+				param = value + float4(1, 1, 1, 1);
+				BOOST_CHECK_EQUAL(cbuff.NumDirtyRanges(), 1U);
+				BOOST_CHECK_EQUAL(cbuff.DirtyBytes(), sizeof(float4));
+				cbuff.Update();
+				BOOST_CHECK(!cbuff.Dirty());
+
+				param = value;
+				cbuff.Update();
+
+				++ num_tested;
+			}
+		}
+	}
+	BOOST_CHECK(num_tested > 0);
+}
+
+BOOST_AUTO_TEST_CASE(RenderEffectParameterLookupPerf)
+{
+	int const NUM_ITERATIONS = 1000;
+
+	for (auto const & effect_name : TEST_EFFECTS)
+	{
+		RenderEffectPtr effect = SyncLoadRenderEffect(effect_name);
+		BOOST_REQUIRE(effect);
+
+		std::vector<std::string> names(effect->NumParameters());
+		for (uint32_t i = 0; i < effect->NumParameters(); ++ i)
+		{
+			names[i] = effect->ParameterByIndex(i)->Name();
+		}
+
+		size_t found = 0;
+		Timer timer;
+		for (int i = 0; i < NUM_ITERATIONS; ++ i)
+		{
+			for (auto const & name : names)
+			{
+				found += (ParameterByNameLinear(*effect, name) != nullptr);
+			}
+		}
+		double const linear_time = timer.elapsed();
+
+		timer.restart();
+		for (int i = 0; i < NUM_ITERATIONS; ++ i)
+		{
+			for (auto const & name : names)
+			{
+				found += (effect->ParameterByName(name) != nullptr);
+			}
+		}
+		double const indexed_time = timer.elapsed();
+
+		BOOST_CHECK_EQUAL(found, names.size() * NUM_ITERATIONS * 2);
+		BOOST_TEST_MESSAGE(effect_name << ": " << names.size() << " parameters, linear "
+			<< linear_time * 1e9 / (NUM_ITERATIONS * std::max<size_t>(names.size(), 1)) << " ns, indexed "
+			<< indexed_time * 1e9 / (NUM_ITERATIONS * std::max<size_t>(names.size(), 1)) << " ns per lookup");
+	}
+}
+
+BOOST_AUTO_TEST_CASE(RenderEffectFXMLParsePerf)
+{
+	std::filesystem::path const fx_dir
+		= std::filesystem::path(ResLoader::Instance().Locate("Blitter.fxml")).parent_path();
+	BOOST_REQUIRE(!fx_dir.empty());
+
+	uint32_t num_files = 0;
+	uint32_t num_arrays = 0;
+	double doc_time = 0;
+	double split_time = 0;
+	double in_place_time = 0;
+	double attrib_time = 0;
+	double attrib_in_place_time = 0;
+	for (std::filesystem::directory_iterator iter(fx_dir), end; iter != end; ++ iter)
+	{
+		if (iter->path().extension() != ".fxml")
+		{
+			continue;
+		}
+
+		ResIdentifierPtr source = ResLoader::Instance().Open(iter->path().string());
+		BOOST_REQUIRE(source);
+
+		Timer timer;
+		XMLDocument doc;
+		XMLNodePtr root = doc.Parse(source);
+		doc_time += timer.elapsed();
+
+		std::vector<XMLNodePtr> params;
+		CollectParameters(root, params);
+
+		// array_size can also be a macro, which doesn't convert
+		uint32_t sum = 0;
+		timer.restart();
+		for (auto const & param : params)
+		{
+			uint32_t array_size = 0;
+			XMLAttributePtr attr = param->Attrib("array_size");
+			if (attr && attr->TryConvert(array_size))
+			{
+				sum += array_size;
+			}
+		}
+		attrib_time += timer.elapsed();
+		uint32_t sum_in_place = 0;
+		timer.restart();
+		for (auto const & param : params)
+		{
+			uint32_t array_size;
+			if (param->TryConvertAttrib("array_size", array_size, 0))
+			{
+				sum_in_place += array_size;
+			}
+		}
+		attrib_in_place_time += timer.elapsed();
+		BOOST_CHECK_EQUAL(sum, sum_in_place);
+
+		for (auto const & param : params)
+		{
+			uint32_t array_size;
+			if (!param->TryConvertAttrib("array_size", array_size, 0))
+			{
+				continue;
+			}
+
+			XMLNodePtr value_node = param->FirstNode("value");
+			if ((array_size > 0) && value_node)
+			{
+				value_node = value_node->FirstNode();
+				if (value_node && (XNT_CData == value_node->Type()))
+				{
+					std::string const type = param->AttribString("type", "");
+					uint32_t const max_count = array_size * 16;
+					if (0 == type.find("float"))
+					{
+						CompareArrayParsing<float>(*value_node, max_count, split_time, in_place_time);
+					}
+					else if (0 == type.find("uint"))
+					{
+						CompareArrayParsing<uint32_t>(*value_node, max_count, split_time, in_place_time);
+					}
+					else
+					{
+						CompareArrayParsing<int32_t>(*value_node, max_count, split_time, in_place_time);
+					}
+					++ num_arrays;
+				}
+			}
+		}
+
+		++ num_files;
+	}
+
+	BOOST_CHECK(num_files > 0);
+	BOOST_TEST_MESSAGE(num_files << " files, XML parsing " << doc_time * 1000 << " ms");
+	BOOST_TEST_MESSAGE("array_size attributes: XMLAttribute " << attrib_time * 1e6 << " us, in place "
+		<< attrib_in_place_time * 1e6 << " us");
+	BOOST_TEST_MESSAGE(num_arrays << " array values x 100: split " << split_time * 1000 << " ms, in place "
+		<< in_place_time * 1000 << " ms");
+}
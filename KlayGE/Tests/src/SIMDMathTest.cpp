@@ -19,6 +19,15 @@
 using namespace std;
 using namespace KlayGE;
 
+BOOST_AUTO_TEST_CASE(Sqrt)
+{
+	SIMDVectorF4 v = SIMDMathLib::Sqrt(SIMDMathLib::SetVector(0, 1, 4, 9));
+	for (size_t i = 0; i < 4; ++ i)
+	{
+		BOOST_CHECK(MathLib::abs(SIMDMathLib::GetByIndex(v, i) - i) < 1e-6f);
+	}
+}
+
 BOOST_AUTO_TEST_CASE(NormalizeVector2)
 {
 	SIMDVectorF4 v = SIMDMathLib::SetVector(1, 2, 0, 0);
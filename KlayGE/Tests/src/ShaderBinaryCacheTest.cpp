@@ -0,0 +1,178 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/CXX17/filesystem.hpp>
+#include <KlayGE/ResLoader.hpp>
+#include <KlayGE/ShaderBinaryCache.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	uint32_t const CACHE_VERSION = 1;
+
+	std::string CacheDir()
+	{
+		std::string const dir = ResLoader::Instance().LocalFolder() + "ShaderBinaryCacheTest/";
+		std::filesystem::remove_all(dir);
+		return dir;
+	}
+
+	// Stands in for a translated shader. Binary, so it covers embedded zeros.
+	std::vector<uint8_t> FakeShader(uint32_t seed, uint32_t size)
+	{
+		std::vector<uint8_t> ret(size);
+		for (uint32_t i = 0; i < size; ++ i)
+		{
+			ret[i] = static_cast<uint8_t>((i * 31 + seed * 7) ^ (i >> 3));
+		}
+		return ret;
+	}
+
+	std::string OnlyEntry(std::string const & dir)
+	{
+		std::string ret;
+		for (std::filesystem::directory_iterator iter(dir), end; iter != end; ++ iter)
+		{
+			BOOST_REQUIRE(ret.empty());
+			ret = iter->path().string();
+		}
+		BOOST_REQUIRE(!ret.empty());
+		return ret;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(ShaderBinaryCacheRoundTrip)
+{
+	std::string const dir = CacheDir();
+
+	std::vector<std::string> keys;
+	std::vector<std::vector<uint8_t>> shaders;
+	for (uint32_t i = 0; i < 8; ++ i)
+	{
+		std::string key = "vs_5_0";
+		key.push_back('\0');
+		key += std::to_string(i);
+		keys.push_back(key);
+		shaders.push_back(FakeShader(i, 1000 + i * 123));
+	}
+
+	{
+		ShaderBinaryCache cache(dir, CACHE_VERSION);
+		std::vector<uint8_t> data;
+		for (size_t i = 0; i < keys.size(); ++ i)
+		{
+			BOOST_CHECK(!cache.Load(keys[i], data));
+			cache.Store(keys[i], shaders[i]);
+		}
+		BOOST_CHECK_EQUAL(cache.Hits(), 0U);
+		BOOST_CHECK_EQUAL(cache.Misses(), keys.size());
+	}
+
+	// Like a second run of the application
+	ShaderBinaryCache cache(dir, CACHE_VERSION);
+	for (int pass = 0; pass < 2; ++ pass)
+	{
+		for (size_t i = 0; i < keys.size(); ++ i)
+		{
+			std::vector<uint8_t> data;
+			BOOST_CHECK(cache.Load(keys[i], data));
+			BOOST_CHECK(data == shaders[i]);
+		}
+	}
+	std::vector<uint8_t> data;
+	BOOST_CHECK(!cache.Load("ps_5_0", data));
+	BOOST_CHECK(data.empty());
+	BOOST_CHECK_EQUAL(cache.Hits(), keys.size() * 2);
+	BOOST_CHECK_EQUAL(cache.Misses(), 1U);
+
+	cache.ResetStatistics();
+	cache.Remove(keys[0]);
+	BOOST_CHECK(!cache.Load(keys[0], data));
+	BOOST_CHECK(cache.Load(keys[1], data));
+	BOOST_CHECK_EQUAL(cache.Hits(), 1U);
+	BOOST_CHECK_EQUAL(cache.Misses(), 1U);
+
+	std::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(ShaderBinaryCacheVersion)
+{
+	std::string const dir = CacheDir();
+	std::vector<uint8_t> const shader = FakeShader(0, 4096);
+
+	ShaderBinaryCache(dir, CACHE_VERSION).Store("key", shader);
+
+	std::vector<uint8_t> data;
+	ShaderBinaryCache new_cache(dir, CACHE_VERSION + 1);
+	BOOST_CHECK(!new_cache.Load("key", data));
+	BOOST_CHECK_EQUAL(new_cache.Misses(), 1U);
+
+	// Stale entries are removed when found
+	BOOST_CHECK(std::filesystem::is_empty(dir));
+
+	new_cache.Store("key", shader);
+	BOOST_CHECK(new_cache.Load("key", data));
+	BOOST_CHECK(data == shader);
+
+	std::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(ShaderBinaryCacheCorruption)
+{
+	std::string const dir = CacheDir();
+	std::vector<uint8_t> const shader = FakeShader(1, 4096);
+	std::vector<uint8_t> data;
+
+	ShaderBinaryCache cache(dir, CACHE_VERSION);
+
+	// A flipped bit in the data
+	cache.Store("key", shader);
+	{
+		std::string const entry = OnlyEntry(dir);
+		std::fstream fs(entry.c_str(), std::ios_base::binary | std::ios_base::in | std::ios_base::out);
+		fs.seekp(-100, std::ios_base::end);
+		char const c = 0x55;
+		fs.write(&c, 1);
+	}
+	BOOST_CHECK(!cache.Load("key", data));
+	BOOST_CHECK(std::filesystem::is_empty(dir));
+
+	// A truncated file
+	cache.Store("key", shader);
+	{
+		std::string const entry = OnlyEntry(dir);
+		std::filesystem::resize_file(entry, std::filesystem::file_size(entry) - 1);
+	}
+	BOOST_CHECK(!cache.Load("key", data));
+
+	// Garbage appended
+	cache.Store("key", shader);
+	{
+		std::ofstream ofs(OnlyEntry(dir).c_str(), std::ios_base::binary | std::ios_base::app);
+		ofs.write("garbage", 7);
+	}
+	BOOST_CHECK(!cache.Load("key", data));
+
+	BOOST_CHECK_EQUAL(cache.Hits(), 0U);
+	BOOST_CHECK_EQUAL(cache.Misses(), 3U);
+
+	cache.Store("key", shader);
+	BOOST_CHECK(cache.Load("key", data));
+	BOOST_CHECK(data == shader);
+
+	std::filesystem::remove_all(dir);
+}
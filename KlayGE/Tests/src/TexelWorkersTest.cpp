@@ -0,0 +1,221 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Thread.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "TexelWorkers.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// A height map to normal map kernel, the same kind of math the tools run on each texel
+	void HeightToNormal(std::vector<float> const & heights, uint32_t width, uint32_t height, uint32_t x, uint32_t y,
+		uint8_t* normal)
+	{
+		float const dx = heights[y * width + (x + 1) % width] - heights[y * width + x];
+		float const dy = heights[(y + 1) % height * width + x] - heights[y * width + x];
+		float3 const n = MathLib::normalize(float3(-dx, -dy, 0.125f)) * 0.5f + float3(0.5f, 0.5f, 0.5f);
+		normal[0] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(n.x() * 255 + 0.5f), 0, 255));
+		normal[1] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(n.y() * 255 + 0.5f), 0, 255));
+		normal[2] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(n.z() * 255 + 0.5f), 0, 255));
+		normal[3] = 255;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TexelWorkersEachTexelOnce)
+{
+	// Not a multiple of the tile height
+	uint32_t const WIDTH = 37;
+	uint32_t const HEIGHT = TexelWorkers::TILE_ROWS * 3 + 5;
+
+	TexelWorkers workers;
+	std::vector<std::atomic<uint32_t>> visits(WIDTH * HEIGHT);
+	for (auto& visit : visits)
+	{
+		visit = 0;
+	}
+	workers.ForEachTexel(WIDTH, HEIGHT, [&visits](uint32_t x, uint32_t y)
+		{
+			++ visits[y * WIDTH + x];
+		});
+
+	for (auto const & visit : visits)
+	{
+		BOOST_CHECK_EQUAL(visit.load(), 1U);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TexelWorkersEachTexelRunOnce)
+{
+	// The last run of a row is partial
+	uint32_t const WIDTH = 37;
+	uint32_t const HEIGHT = TexelWorkers::TILE_ROWS + 3;
+
+	TexelWorkers workers;
+	std::vector<std::atomic<uint32_t>> visits(WIDTH * HEIGHT);
+	for (auto& visit : visits)
+	{
+		visit = 0;
+	}
+	workers.ForEachTexelRun(WIDTH, HEIGHT, [&visits](uint32_t x, uint32_t y, uint32_t n)
+		{
+			BOOST_ASSERT((x % TexelWorkers::RUN_TEXELS == 0) && (n > 0) && (n <= TexelWorkers::RUN_TEXELS));
+			BOOST_ASSERT((n == TexelWorkers::RUN_TEXELS) || (x + n == WIDTH));
+			for (uint32_t i = 0; i < n; ++ i)
+			{
+				++ visits[y * WIDTH + x + i];
+			}
+		});
+
+	for (auto const & visit : visits)
+	{
+		BOOST_CHECK_EQUAL(visit.load(), 1U);
+	}
+
+	// The lanes past the run are 0 when loaded, and are not stored
+	uint8_t const src[] = { 0, 255, 51, 102 };
+	uint8_t dst[] = { 7, 7, 7, 7 };
+	TexelWorkers::StoreUNorm8Lanes(dst, 1, 3, TexelWorkers::LoadUNorm8Lanes(src, 1, 3));
+	BOOST_CHECK_EQUAL(dst[0], 0);
+	BOOST_CHECK_EQUAL(dst[1], 255);
+	BOOST_CHECK_EQUAL(dst[2], 51);
+	BOOST_CHECK_EQUAL(dst[3], 7);
+	float lanes[TexelWorkers::RUN_TEXELS];
+	TexelWorkers::LoadUNorm8Lanes(src, 1, 3).Store(lanes);
+	BOOST_CHECK_EQUAL(lanes[3], 0.0f);
+}
+
+BOOST_AUTO_TEST_CASE(TexelWorkersEachBlockOnce)
+{
+	// Partial blocks on the right and the bottom
+	uint32_t const WIDTH = 70;
+	uint32_t const HEIGHT = 133;
+	uint32_t const BLOCKS_X = (WIDTH + 3) / 4;
+	uint32_t const BLOCKS_Y = (HEIGHT + 3) / 4;
+
+	TexelWorkers workers;
+	std::vector<std::atomic<uint32_t>> visits(BLOCKS_X * BLOCKS_Y);
+	for (auto& visit : visits)
+	{
+		visit = 0;
+	}
+	workers.ForEachBlock(WIDTH, HEIGHT, 4, 4, [&visits](uint32_t block_x, uint32_t block_y)
+		{
+			BOOST_ASSERT((block_x < BLOCKS_X) && (block_y < BLOCKS_Y));
+			++ visits[block_y * BLOCKS_X + block_x];
+		});
+
+	for (auto const & visit : visits)
+	{
+		BOOST_CHECK_EQUAL(visit.load(), 1U);
+	}
+}
+
+// The output of a tool kernel on a sample image has to be the same bytes as the serial loop it replaces
+BOOST_AUTO_TEST_CASE(TexelWorkersMatchSerial)
+{
+	uint32_t const WIDTH = 256;
+	uint32_t const HEIGHT = 200;
+
+	std::vector<float> heights(WIDTH * HEIGHT);
+	std::ranlux24_base gen(7);
+	std::uniform_real_distribution<float> dis(0, 1);
+	for (auto& h : heights)
+	{
+		h = dis(gen);
+	}
+
+	std::vector<uint8_t> serial(WIDTH * HEIGHT * 4);
+	for (uint32_t y = 0; y < HEIGHT; ++ y)
+	{
+		for (uint32_t x = 0; x < WIDTH; ++ x)
+		{
+			HeightToNormal(heights, WIDTH, HEIGHT, x, y, &serial[(y * WIDTH + x) * 4]);
+		}
+	}
+
+	TexelWorkers workers;
+	std::vector<uint8_t> parallel(WIDTH * HEIGHT * 4);
+	workers.ForEachTexel(WIDTH, HEIGHT, [&heights, &parallel](uint32_t x, uint32_t y)
+		{
+			HeightToNormal(heights, WIDTH, HEIGHT, x, y, &parallel[(y * WIDTH + x) * 4]);
+		});
+
+	BOOST_CHECK(serial == parallel);
+
+	std::vector<uint32_t> sub_res_sums(5, 0);
+	workers.ForEachSubresource(static_cast<uint32_t>(sub_res_sums.size()), [&parallel, &sub_res_sums](uint32_t sub_res)
+		{
+			for (size_t i = sub_res; i < parallel.size(); i += 5)
+			{
+				sub_res_sums[sub_res] += parallel[i];
+			}
+		});
+	for (uint32_t sub_res = 0; sub_res < sub_res_sums.size(); ++ sub_res)
+	{
+		uint32_t sum = 0;
+		for (size_t i = sub_res; i < serial.size(); i += 5)
+		{
+			sum += serial[i];
+		}
+		BOOST_CHECK_EQUAL(sub_res_sums[sub_res], sum);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TexelWorkersParallelForRethrowAfterJoin)
+{
+	uint32_t const NUM_THREADS = 4;
+	uint32_t const NUM_TASKS = 256;
+
+	// The calling thread throws on its first task, while the other threads are still in theirs
+	std::thread::id const caller = std::this_thread::get_id();
+	std::atomic<uint32_t> running(0);
+	std::atomic<uint32_t> num_done(0);
+	bool thrown = false;
+	thread_pool tp(1, NUM_THREADS);
+	try
+	{
+		parallel_for(tp, NUM_THREADS, NUM_TASKS, [caller, &running, &num_done](uint32_t i)
+			{
+				KFL_UNUSED(i);
+
+				if (std::this_thread::get_id() == caller)
+				{
+					throw std::runtime_error("Task failed");
+				}
+
+				++ running;
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				-- running;
+				++ num_done;
+			});
+	}
+	catch (std::runtime_error const & e)
+	{
+		thrown = true;
+		BOOST_CHECK_EQUAL(std::string(e.what()), "Task failed");
+		BOOST_CHECK_EQUAL(running.load(), 0U);
+	}
+	BOOST_CHECK(thrown);
+	// The tasks not started yet are skipped
+	BOOST_CHECK_LT(num_done.load(), NUM_TASKS - 1);
+}
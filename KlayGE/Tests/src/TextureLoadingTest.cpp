@@ -0,0 +1,118 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/CXX17/filesystem.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderEngine.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/ResLoader.hpp>
+#include <KlayGE/Texture.hpp>
+
+#include <boost/assert.hpp>
+#include <boost/noncopyable.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Takes formats away from the device while it's alive, so the loader has to fall back
+	class UnsupportedFormats : boost::noncopyable
+	{
+	public:
+		UnsupportedFormats(RenderDeviceCaps& caps, std::vector<ElementFormat> const & formats)
+			: caps_(caps), texture_format_support_(caps.texture_format_support)
+		{
+			auto const supported = texture_format_support_;
+			caps_.texture_format_support = [supported, formats](ElementFormat fmt)
+				{
+					return (std::find(formats.begin(), formats.end(), fmt) == formats.end()) && supported(fmt);
+				};
+		}
+
+		~UnsupportedFormats()
+		{
+			caps_.texture_format_support = texture_format_support_;
+		}
+
+	private:
+		RenderDeviceCaps& caps_;
+		std::function<bool(ElementFormat)> texture_format_support_;
+	};
+}
+
+BOOST_AUTO_TEST_CASE(TextureLoadingSignedR16ToSignedR8)
+{
+	RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+	RenderDeviceCaps& caps = const_cast<RenderDeviceCaps&>(rf.RenderEngineInstance().DeviceCaps());
+	if (!caps.texture_format_support(EF_SIGNED_R8))
+	{
+		BOOST_WARN_MESSAGE(false, "The device doesn't support EF_SIGNED_R8, the fallback is not tested.");
+		return;
+	}
+
+	uint32_t const WIDTH = 16;
+	uint32_t const HEIGHT = 4;
+	std::vector<int16_t> texels(WIDTH * HEIGHT);
+	for (uint32_t i = 0; i < texels.size(); ++ i)
+	{
+		texels[i] = static_cast<int16_t>(static_cast<int32_t>(i * 65534 / (texels.size() - 1)) - 32767);
+	}
+
+	std::filesystem::path const dir = ResLoader::Instance().LocalFolder() + "TextureLoadingTest";
+	std::filesystem::remove_all(dir);
+	std::filesystem::create_directories(dir);
+	std::string const tex_name = (dir / "SignedR16.dds").string();
+	{
+		ElementInitData init_data;
+		init_data.data = &texels[0];
+		init_data.row_pitch = WIDTH * sizeof(texels[0]);
+		init_data.slice_pitch = init_data.row_pitch * HEIGHT;
+		SaveTexture(tex_name, Texture::TT_2D, WIDTH, HEIGHT, 1, 1, 1, EF_SIGNED_R16,
+			std::vector<ElementInitData>(1, init_data));
+	}
+
+	{
+		UnsupportedFormats unsupported(caps, { EF_SIGNED_R16 });
+
+		TexturePtr const tex = SyncLoadTexture(tex_name, EAH_GPU_Read | EAH_Immutable);
+		BOOST_REQUIRE(tex);
+		BOOST_REQUIRE_EQUAL(tex->Format(), EF_SIGNED_R8);
+		BOOST_CHECK_EQUAL(tex->Width(0), WIDTH);
+		BOOST_CHECK_EQUAL(tex->Height(0), HEIGHT);
+
+		TexturePtr const tex_cpu = rf.MakeTexture2D(WIDTH, HEIGHT, 1, 1, EF_SIGNED_R8, 1, 0, EAH_CPU_Read);
+		tex->CopyToTexture(*tex_cpu);
+		{
+			Texture::Mapper mapper(*tex_cpu, 0, 0, TMA_Read_Only, 0, 0, WIDTH, HEIGHT);
+			int8_t const * p = mapper.Pointer<int8_t>();
+			for (uint32_t y = 0; y < HEIGHT; ++ y)
+			{
+				for (uint32_t x = 0; x < WIDTH; ++ x)
+				{
+					// Within a step of the nearest SNORM8 value
+					int16_t const texel = texels[y * WIDTH + x];
+					int const expected = static_cast<int>(std::lround(texel / 32767.0 * 127));
+					BOOST_CHECK_LE(std::abs(p[y * mapper.RowPitch() + x] - expected), 1);
+				}
+			}
+		}
+
+		ResLoader::Instance().Unload(tex);
+	}
+
+	std::filesystem::remove_all(dir);
+}
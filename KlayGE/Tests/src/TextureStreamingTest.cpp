@@ -0,0 +1,328 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KlayGE/Context.hpp>
+#include <KlayGE/RenderFactory.hpp>
+#include <KlayGE/TextureStreaming.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	// Bytes of the levels [first_level, 11) of a 1024x1024 ARGB8 texture
+	uint64_t Bytes1024(uint32_t first_level)
+	{
+		uint64_t ret = 0;
+		for (uint32_t level = first_level; level < 11; ++ level)
+		{
+			uint64_t const size = 1024 >> level;
+			ret += size * size * 4;
+		}
+		return ret;
+	}
+
+	// The levels of a 1024x1024 ARGB8 texture in one block
+	void MakeLevels1024(std::vector<ElementInitData>& init_data, std::vector<uint8_t>& data_block)
+	{
+		data_block.assign(static_cast<size_t>(Bytes1024(0)), 0);
+		init_data.resize(11);
+		size_t offset = 0;
+		for (uint32_t level = 0; level < 11; ++ level)
+		{
+			uint32_t const size = 1024 >> level;
+			init_data[level].data = &data_block[offset];
+			init_data[level].row_pitch = size * 4;
+			init_data[level].slice_pitch = size * size * 4;
+			offset += init_data[level].slice_pitch;
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TextureStreamingTail)
+{
+	TextureStreamingPolicy policy(0, 64);
+	uint32_t const tex = policy.AddTexture(1024, 1024, 1, 11, 1, EF_ARGB8);
+	BOOST_CHECK_EQUAL(policy.TailLevel(tex), 4U);
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex), 4U);
+
+	// The tail stays even if it's over the budget
+	policy.Request(tex, 0, 1);
+	policy.Update();
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex), 4U);
+	BOOST_CHECK_EQUAL(policy.ResidentBytes(), Bytes1024(4));
+
+	uint32_t const bc1_tex = policy.AddTexture(256, 256, 1, 9, 6, EF_BC1);
+	BOOST_CHECK_EQUAL(policy.TailLevel(bc1_tex), 2U);
+	BOOST_CHECK_EQUAL(policy.ResidentBytes(), Bytes1024(4) + (64 * 64 / 2 + 32 * 32 / 2 + 16 * 16 / 2 + 8 * 8 / 2
+		+ 8 * 3) * 6);
+}
+
+BOOST_AUTO_TEST_CASE(TextureStreamingPriority)
+{
+	TextureStreamingPolicy policy(Bytes1024(1) + Bytes1024(4), 64);
+	uint32_t const near_tex = policy.AddTexture(1024, 1024, 1, 11, 1, EF_ARGB8);
+	uint32_t const far_tex = policy.AddTexture(1024, 1024, 1, 11, 1, EF_ARGB8);
+
+	// Without requests, only the tails are resident
+	policy.Update();
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(near_tex), 4U);
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(far_tex), 4U);
+
+	// Even level 1 of the near one is more needed than level 3 of the far one
+	policy.Request(near_tex, 0, 64);
+	policy.Request(far_tex, 0, 1);
+	policy.Update();
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(near_tex), 1U);
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(far_tex), 4U);
+	BOOST_CHECK(policy.ResidentBytes() <= policy.Budget());
+
+	// Swapping the priorities moves the memory to the other texture
+	policy.Request(near_tex, 0, 1);
+	policy.Request(far_tex, 0, 64);
+	policy.Update();
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(near_tex), 4U);
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(far_tex), 1U);
+
+	// Never finer than wanted, the rest goes to the other texture
+	policy.Request(far_tex, 2, 64);
+	policy.Update();
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(far_tex), 2U);
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(near_tex), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(TextureStreamingEviction)
+{
+	TextureStreamingPolicy policy(2 * Bytes1024(0), 64);
+	uint32_t const tex0 = policy.AddTexture(1024, 1024, 1, 11, 1, EF_ARGB8);
+	uint32_t const tex1 = policy.AddTexture(1024, 1024, 1, 11, 1, EF_ARGB8);
+	policy.Request(tex0, 0, 2);
+	policy.Request(tex1, 0, 1);
+	policy.Update();
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex0), 0U);
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex1), 0U);
+
+	// The less important texture loses its finest mip first
+	policy.Budget(Bytes1024(0) + Bytes1024(1));
+	policy.Update();
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex0), 0U);
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex1), 1U);
+
+	policy.Budget(Bytes1024(1) + Bytes1024(2));
+	policy.Update();
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex0), 1U);
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex1), 2U);
+	BOOST_CHECK(policy.ResidentBytes() <= policy.Budget());
+
+	// Removing a texture frees its memory for the others
+	policy.RemoveTexture(tex0);
+	policy.Update();
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex1), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(TextureStreamingUploadLimit)
+{
+	TextureStreamingPolicy policy(static_cast<uint64_t>(-1), 64);
+	uint32_t const tex0 = policy.AddTexture(1024, 1024, 1, 11, 1, EF_ARGB8);
+	uint32_t const tex1 = policy.AddTexture(1024, 1024, 1, 11, 1, EF_ARGB8);
+	policy.Request(tex0, 0, 2);
+	policy.Request(tex1, 0, 1);
+
+	// Coarse to fine in priority order, 128 KB per update
+	uint64_t const limit = 128 * 128 * 4 * 2;
+	policy.Update(limit);
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex0), 3U);
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex1), 3U);
+
+	// A mip larger than the limit still goes alone
+	policy.Update(limit);
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex0), 2U);
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex1), 3U);
+
+	policy.Update(limit);
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex0), 2U);
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex1), 2U);
+
+	policy.Update(limit);
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex0), 1U);
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex1), 2U);
+
+	for (int i = 0; i < 8; ++ i)
+	{
+		policy.Update(limit);
+	}
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex0), 0U);
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex1), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(TextureStreamingScreenSize)
+{
+	BOOST_CHECK_EQUAL(TextureStreamingPolicy::LevelFromScreenSize(1024, 1024, 11, 2000), 0U);
+	BOOST_CHECK_EQUAL(TextureStreamingPolicy::LevelFromScreenSize(1024, 512, 11, 256), 2U);
+	BOOST_CHECK_EQUAL(TextureStreamingPolicy::LevelFromScreenSize(1024, 1024, 11, 200), 2U);
+	BOOST_CHECK_EQUAL(TextureStreamingPolicy::LevelFromScreenSize(1024, 1024, 5, 1), 4U);
+
+	TextureStreamingPolicy policy(static_cast<uint64_t>(-1), 64);
+	uint32_t const tex = policy.AddTexture(1024, 1024, 1, 11, 1, EF_ARGB8);
+	policy.RequestScreenSize(tex, 300);
+	policy.Update();
+	BOOST_CHECK_EQUAL(policy.ResidentLevel(tex), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(TextureStreamerDropRestore)
+{
+	BOOST_CHECK(TextureStreamer::Streamable(Texture::TT_2D, 11, EAH_GPU_Read | EAH_Immutable));
+	BOOST_CHECK(!TextureStreamer::Streamable(Texture::TT_2D, 1, EAH_GPU_Read | EAH_Immutable));
+	BOOST_CHECK(!TextureStreamer::Streamable(Texture::TT_3D, 11, EAH_GPU_Read | EAH_Immutable));
+	BOOST_CHECK(!TextureStreamer::Streamable(Texture::TT_2D, 11, EAH_GPU_Read | EAH_GPU_Write));
+
+	// Records the textures the streamer would create
+	struct CreatedTexture
+	{
+		uint32_t width;
+		uint32_t num_mipmaps;
+		std::vector<ElementInitData> init_data;
+	};
+	std::vector<CreatedTexture> created;
+	auto creator = [&created](Texture::TextureType type, uint32_t width, uint32_t height, uint32_t num_mipmaps,
+			uint32_t array_size, ElementFormat format, uint32_t access_hint, ArrayRef<ElementInitData> init_data)
+		{
+			BOOST_CHECK_EQUAL(type, Texture::TT_2D);
+			BOOST_CHECK_EQUAL(width, height);
+			BOOST_CHECK_EQUAL(array_size, 1U);
+			BOOST_CHECK_EQUAL(format, EF_ARGB8);
+			BOOST_CHECK_EQUAL(access_hint, static_cast<uint32_t>(EAH_GPU_Read | EAH_Immutable));
+			created.push_back({ width, num_mipmaps, std::vector<ElementInitData>(init_data.begin(), init_data.end()) });
+			return TexturePtr();
+		};
+
+	// Room for the tail and level 1, not for level 0
+	TextureStreamer streamer(Bytes1024(1), 64, creator);
+	BOOST_CHECK_EQUAL(streamer.FirstLevel(1024, 1024, 11), 4U);
+	uint32_t const handle = streamer.AddTexture(TexturePtr(), Texture::TT_2D, 1024, 1024, 11, 1, EF_ARGB8,
+		EAH_GPU_Read | EAH_Immutable);
+	BOOST_CHECK_EQUAL(streamer.CurrentLevel(handle), 4U);
+
+	std::vector<uint8_t> data_block;
+	std::vector<ElementInitData> init_data;
+	MakeLevels1024(init_data, data_block);
+	std::vector<ElementInitData> const loaded_init_data = init_data;
+
+	// Nothing finer than the tail before the data is loaded
+	streamer.RequestScreenSize(handle, 1024);
+	streamer.Update();
+	BOOST_CHECK_EQUAL(streamer.CurrentLevel(handle), 4U);
+	BOOST_CHECK(created.empty());
+
+	streamer.TextureLoaded(handle, std::move(init_data), std::move(data_block));
+
+	// Level 0 is wanted, the budget drops it
+	streamer.RequestScreenSize(handle, 1024);
+	streamer.Update();
+	BOOST_CHECK_EQUAL(streamer.CurrentLevel(handle), 1U);
+	BOOST_REQUIRE_EQUAL(created.size(), 1U);
+	BOOST_CHECK_EQUAL(created.back().width, 512U);
+	BOOST_CHECK_EQUAL(created.back().num_mipmaps, 10U);
+	BOOST_REQUIRE_EQUAL(created.back().init_data.size(), 10U);
+	BOOST_CHECK_EQUAL(created.back().init_data[0].data, loaded_init_data[1].data);
+	BOOST_CHECK(streamer.Policy().ResidentBytes() <= streamer.Policy().Budget());
+
+	// A larger budget restores it
+	streamer.Budget(Bytes1024(0));
+	streamer.RequestScreenSize(handle, 1024);
+	streamer.Update();
+	BOOST_CHECK_EQUAL(streamer.CurrentLevel(handle), 0U);
+	BOOST_REQUIRE_EQUAL(created.size(), 2U);
+	BOOST_CHECK_EQUAL(created.back().width, 1024U);
+	BOOST_CHECK_EQUAL(created.back().num_mipmaps, 11U);
+	BOOST_CHECK_EQUAL(created.back().init_data[0].data, loaded_init_data[0].data);
+
+	// Shrinking the budget drops all but the tail
+	streamer.Budget(Bytes1024(4));
+	streamer.RequestScreenSize(handle, 1024);
+	streamer.Update();
+	BOOST_CHECK_EQUAL(streamer.CurrentLevel(handle), 4U);
+	BOOST_CHECK_EQUAL(created.back().width, 64U);
+	BOOST_CHECK_EQUAL(created.back().num_mipmaps, 7U);
+
+	// Once not requested for a while, a texture goes back to its tail even within the budget
+	streamer.Budget(Bytes1024(0));
+	streamer.RequestScreenSize(handle, 1024);
+	streamer.Update();
+	BOOST_CHECK_EQUAL(streamer.CurrentLevel(handle), 0U);
+	streamer.Update();
+	BOOST_CHECK_EQUAL(streamer.CurrentLevel(handle), 0U);
+	for (int i = 0; i < 100; ++ i)
+	{
+		streamer.Update();
+	}
+	BOOST_CHECK_EQUAL(streamer.CurrentLevel(handle), 4U);
+}
+
+BOOST_AUTO_TEST_CASE(TextureStreamerDropTexture)
+{
+	RenderFactory& rf = Context::Instance().RenderFactoryInstance();
+	uint32_t const access_hint = EAH_GPU_Read | EAH_Immutable;
+
+	std::vector<std::weak_ptr<Texture>> created;
+	auto creator = [&rf, &created](Texture::TextureType type, uint32_t width, uint32_t height, uint32_t num_mipmaps,
+			uint32_t array_size, ElementFormat format, uint32_t access_hint, ArrayRef<ElementInitData> init_data)
+		{
+			KFL_UNUSED(type);
+			KFL_UNUSED(init_data);
+
+			TexturePtr tex = rf.MakeDelayCreationTexture2D(width, height, num_mipmaps, array_size, format, 1, 0,
+				access_hint);
+			created.push_back(tex);
+			return tex;
+		};
+	TextureStreamer streamer(Bytes1024(0) * 2, 64, creator);
+
+	// Like the loader, the textures start with their tails
+	TexturePtr claimed_tex = rf.MakeDelayCreationTexture2D(64, 64, 7, 1, EF_ARGB8, 1, 0, access_hint);
+	TexturePtr unclaimed_tex = rf.MakeDelayCreationTexture2D(64, 64, 7, 1, EF_ARGB8, 1, 0, access_hint);
+	uint32_t const claimed = streamer.AddTexture(claimed_tex, Texture::TT_2D, 1024, 1024, 11, 1, EF_ARGB8, access_hint);
+	uint32_t const unclaimed = streamer.AddTexture(unclaimed_tex, Texture::TT_2D, 1024, 1024, 11, 1, EF_ARGB8,
+		access_hint);
+	BOOST_CHECK_EQUAL(streamer.ClaimRequests(claimed_tex), claimed);
+	BOOST_CHECK_EQUAL(streamer.Handle(unclaimed_tex), unclaimed);
+	BOOST_CHECK(streamer.CurrentTexture(claimed) == claimed_tex);
+
+	for (auto handle : { claimed, unclaimed })
+	{
+		std::vector<uint8_t> data_block;
+		std::vector<ElementInitData> init_data;
+		MakeLevels1024(init_data, data_block);
+		streamer.TextureLoaded(handle, std::move(init_data), std::move(data_block));
+	}
+	BOOST_CHECK(claimed_tex->HWResourceReady());
+
+	// A claimed texture without requests keeps its tail, an unclaimed one is streamed at its full size
+	streamer.Update();
+	BOOST_CHECK_EQUAL(streamer.CurrentLevel(claimed), 4U);
+	BOOST_CHECK(streamer.CurrentTexture(claimed) == claimed_tex);
+	BOOST_CHECK_EQUAL(streamer.CurrentLevel(unclaimed), 0U);
+	BOOST_REQUIRE_EQUAL(created.size(), 1U);
+	BOOST_CHECK(streamer.CurrentTexture(unclaimed) == created[0].lock());
+	uint64_t const resident_bytes = streamer.Policy().ResidentBytes();
+
+	// Once dropped, the texture and the levels made for it go away
+	unclaimed_tex.reset();
+	streamer.Update();
+	BOOST_CHECK(created[0].expired());
+	BOOST_CHECK_EQUAL(streamer.Policy().ResidentBytes(), resident_bytes - Bytes1024(0));
+
+	// Its handle is free again
+	TexturePtr new_tex = rf.MakeDelayCreationTexture2D(64, 64, 7, 1, EF_ARGB8, 1, 0, access_hint);
+	BOOST_CHECK_EQUAL(streamer.AddTexture(new_tex, Texture::TT_2D, 1024, 1024, 11, 1, EF_ARGB8, access_hint), unclaimed);
+	BOOST_CHECK_EQUAL(streamer.Handle(new_tex), unclaimed);
+	BOOST_CHECK_EQUAL(streamer.Handle(claimed_tex), claimed);
+}
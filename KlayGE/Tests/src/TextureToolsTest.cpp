@@ -0,0 +1,501 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/CXX17/filesystem.hpp>
+#include <KFL/Half.hpp>
+#include <KFL/Math.hpp>
+#include <KlayGE/ResLoader.hpp>
+#include <KlayGE/TexCompressionBC.hpp>
+#include <KlayGE/Texture.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "ToolRunner.hpp"
+
+using namespace std;
+using namespace KlayGE;
+
+// Each tool runs on a sample image written by the test. Its output is compared with the serial code the tool had before
+// it ran on TexelWorkers, kept here as the reference. Bytes may differ by the tolerance of each tool. The tools are built
+// with the tests.
+namespace
+{
+	// Bump2Normal normalizes in SIMD lanes with an exact square root, where the reference uses the approximation of
+	// MathLib::recip_sqrt. Rounded to 8 bits, that moves a byte by 1 at most. The other tools are bit-identical.
+	int const BUMP2NORMAL_MAX_BYTE_DIFF = 1;
+
+	std::filesystem::path TestFolder()
+	{
+		std::filesystem::path const dir = ResLoader::Instance().LocalFolder() + "TextureToolsTest";
+		std::filesystem::remove_all(dir);
+		std::filesystem::create_directories(dir);
+		return dir;
+	}
+
+	// A smooth pattern with some noise, so neighbours differ in every direction
+	std::vector<float> SampleImage(uint32_t width, uint32_t height, uint32_t channels)
+	{
+		std::ranlux24_base gen(42);
+		std::uniform_real_distribution<float> dis(-0.1f, 0.1f);
+
+		std::vector<float> ret(width * height * channels);
+		for (uint32_t y = 0; y < height; ++ y)
+		{
+			for (uint32_t x = 0; x < width; ++ x)
+			{
+				for (uint32_t c = 0; c < channels; ++ c)
+				{
+					float const v = 0.5f + 0.35f * std::sin(x * 0.31f + c * 1.7f) * std::cos(y * 0.23f - c * 0.9f);
+					ret[(y * width + x) * channels + c] = MathLib::clamp(v + dis(gen), 0.0f, 1.0f);
+				}
+			}
+		}
+		return ret;
+	}
+
+	std::vector<uint8_t> ToUNorm8(std::vector<float> const & image)
+	{
+		std::vector<uint8_t> ret(image.size());
+		for (size_t i = 0; i < image.size(); ++ i)
+		{
+			ret[i] = static_cast<uint8_t>(image[i] * 255 + 0.5f);
+		}
+		return ret;
+	}
+
+	void SaveSample(std::string const & name, uint32_t width, uint32_t height, ElementFormat format, void const * data)
+	{
+		ElementInitData init_data;
+		init_data.data = data;
+		init_data.row_pitch = width * NumFormatBytes(format);
+		init_data.slice_pitch = init_data.row_pitch * height;
+		SaveTexture(name, Texture::TT_2D, width, height, 1, 1, 1, format, init_data);
+	}
+
+	// The first subresource, without the row padding
+	std::vector<uint8_t> LoadOutput(std::string const & name, ElementFormat expected_format, uint32_t expected_width,
+		uint32_t expected_height)
+	{
+		Texture::TextureType type;
+		uint32_t width, height, depth;
+		uint32_t num_mipmaps;
+		uint32_t array_size;
+		ElementFormat format;
+		std::vector<ElementInitData> init_data;
+		std::vector<uint8_t> data_block;
+		LoadTexture(name, type, width, height, depth, num_mipmaps, array_size, format, init_data, data_block);
+
+		BOOST_CHECK_EQUAL(format, expected_format);
+		BOOST_CHECK_EQUAL(width, expected_width);
+		BOOST_CHECK_EQUAL(height, expected_height);
+
+		uint32_t row_bytes;
+		uint32_t num_rows;
+		if (IsCompressedFormat(format))
+		{
+			row_bytes = (width + 3) / 4 * NumFormatBytes(format) * 4;
+			num_rows = (height + 3) / 4;
+		}
+		else
+		{
+			row_bytes = width * NumFormatBytes(format);
+			num_rows = height;
+		}
+
+		std::vector<uint8_t> ret(row_bytes * num_rows);
+		for (uint32_t y = 0; y < num_rows; ++ y)
+		{
+			std::memcpy(&ret[y * row_bytes], static_cast<uint8_t const *>(init_data[0].data) + y * init_data[0].row_pitch,
+				row_bytes);
+		}
+		return ret;
+	}
+
+	void CheckBytes(std::vector<uint8_t> const & output, std::vector<uint8_t> const & expected, int max_byte_diff = 0)
+	{
+		BOOST_REQUIRE_EQUAL(output.size(), expected.size());
+
+		int max_diff = 0;
+		for (size_t i = 0; i < output.size(); ++ i)
+		{
+			max_diff = std::max(max_diff, std::abs(output[i] - expected[i]));
+		}
+		BOOST_CHECK_LE(max_diff, max_byte_diff);
+	}
+
+	uint8_t Quantize(float v)
+	{
+		return static_cast<uint8_t>(MathLib::clamp(static_cast<int>(v * 255 + 0.5f), 0, 255));
+	}
+
+
+	std::vector<uint8_t> ReferenceFakeHeight(std::vector<uint8_t> const & rgba, uint32_t width, uint32_t height)
+	{
+		float3 const RGB_TO_LUM(0.2126f, 0.7152f, 0.0722f);
+
+		std::vector<uint8_t> ret(width * height);
+		for (uint32_t i = 0; i < width * height; ++ i)
+		{
+			float const r = rgba[i * 4 + 0] / 255.0f;
+			float const g = rgba[i * 4 + 1] / 255.0f;
+			float const b = rgba[i * 4 + 2] / 255.0f;
+			ret[i] = Quantize(MathLib::dot(float3(r, g, b), RGB_TO_LUM));
+		}
+		return ret;
+	}
+
+	// ARGB8, so z, y, x, a in memory
+	std::vector<uint8_t> ReferenceNormalMap(std::vector<uint8_t> const & heights, uint32_t width, uint32_t height)
+	{
+		std::vector<uint8_t> ret(width * height * 4);
+		for (uint32_t y = 0; y < height; ++ y)
+		{
+			for (uint32_t x = 0; x < width; ++ x)
+			{
+				int const dx = heights[y * width + (x + 1) % width] - heights[y * width + x];
+				int const dy = heights[(y + 1) % height * width + x] - heights[y * width + x];
+
+				float3 normal = MathLib::normalize(float3(static_cast<float>(-dx), static_cast<float>(-dy), 8));
+				normal = normal * 0.5f + float3(0.5f, 0.5f, 0.5f);
+
+				uint8_t* dst = &ret[(y * width + x) * 4];
+				dst[0] = Quantize(normal.z());
+				dst[1] = Quantize(normal.y());
+				dst[2] = Quantize(normal.x());
+				dst[3] = 255;
+			}
+		}
+		return ret;
+	}
+
+	std::vector<uint8_t> ReferenceBump2Normal(std::vector<uint8_t> const & rgba, uint32_t width, uint32_t height, float offset)
+	{
+		std::vector<Color> colors(width * height);
+		ConvertToABGR32F(EF_ABGR8, &rgba[0], width * height, &colors[0]);
+
+		std::vector<uint8_t> ret(width * height * 4);
+		for (uint32_t i = 0; i < width * height; ++ i)
+		{
+			float3 n;
+			n.x() = (colors[i].r() * 2 - 1) * offset;
+			n.y() = (colors[i].g() * 2 - 1) * offset;
+			n.z() = 1;
+			n = MathLib::normalize(n);
+
+			ret[i * 4 + 0] = Quantize(n.x() * 0.5f + 0.5f);
+			ret[i * 4 + 1] = Quantize(n.y() * 0.5f + 0.5f);
+			ret[i * 4 + 2] = Quantize(n.z() * 0.5f + 0.5f);
+			ret[i * 4 + 3] = 255;
+		}
+		return ret;
+	}
+
+	std::vector<uint8_t> ReferenceNormal2Height(std::vector<uint8_t> const & rgba, uint32_t width, uint32_t height, float min_z)
+	{
+		int const DIRECTIONS = 4;
+		int const RINGS = 9;
+
+		std::vector<float2> ddm(width * height);
+		for (uint32_t i = 0; i < width * height; ++ i)
+		{
+			float3 n(rgba[i * 4 + 0] / 255.0f * 2 - 1, rgba[i * 4 + 1] / 255.0f * 2 - 1, rgba[i * 4 + 2] / 255.0f * 2 - 1);
+			n.z() = std::max(n.z(), min_z);
+			ddm[i].x() = n.x() / n.z();
+			ddm[i].y() = n.y() / n.z();
+		}
+
+		float const step = 2 * PI / DIRECTIONS;
+		std::vector<float2> dxdy(DIRECTIONS);
+		for (int i = 0; i < DIRECTIONS; ++ i)
+		{
+			MathLib::sincos(-i * step, dxdy[i].y(), dxdy[i].x());
+		}
+
+		std::vector<float2> tmp_hm[2];
+		tmp_hm[0].resize(ddm.size(), float2(0, 0));
+		tmp_hm[1].resize(ddm.size(), float2(0, 0));
+		int active = 0;
+		for (int i = 1; i < RINGS; ++ i)
+		{
+			for (size_t j = 0; j < ddm.size(); ++ j)
+			{
+				int y = static_cast<int>(j / width);
+				int x = static_cast<int>(j - y * width);
+
+				for (int k = 0; k < DIRECTIONS; ++ k)
+				{
+					float2 delta = dxdy[k] * static_cast<float>(i);
+					float sample_x = x + delta.x();
+					float sample_y = y + delta.y();
+					int sample_x0 = static_cast<int>(floor(sample_x));
+					int sample_y0 = static_cast<int>(floor(sample_y));
+					int sample_x1 = sample_x0 + 1;
+					int sample_y1 = sample_y0 + 1;
+					float weight_x = sample_x - sample_x0;
+					float weight_y = sample_y - sample_y0;
+
+					sample_x0 %= width;
+					sample_y0 %= height;
+					sample_x1 %= width;
+					sample_y1 %= height;
+
+					std::vector<float2> const & hm = tmp_hm[active];
+					float2 hl0 = MathLib::lerp(hm[sample_y0 * width + sample_x0], hm[sample_y0 * width + sample_x1], weight_x);
+					float2 hl1 = MathLib::lerp(hm[sample_y1 * width + sample_x0], hm[sample_y1 * width + sample_x1], weight_x);
+					float2 h = MathLib::lerp(hl0, hl1, weight_y);
+					float2 ddl0 = MathLib::lerp(ddm[sample_y0 * width + sample_x0], ddm[sample_y0 * width + sample_x1], weight_x);
+					float2 ddl1 = MathLib::lerp(ddm[sample_y1 * width + sample_x0], ddm[sample_y1 * width + sample_x1], weight_x);
+					float2 dd = MathLib::lerp(ddl0, ddl1, weight_y);
+
+					tmp_hm[!active][j] += h + dd * delta;
+				}
+			}
+
+			active = !active;
+		}
+
+		float const scale = 0.5f / (DIRECTIONS * RINGS);
+
+		std::vector<float> heights(ddm.size());
+		float min_height = +1e10f;
+		float max_height = -1e10f;
+		for (size_t i = 0; i < ddm.size(); ++ i)
+		{
+			float2 const & h = tmp_hm[active][i];
+			heights[i] = (h.x() + h.y()) * scale;
+			min_height = std::min(min_height, heights[i]);
+			max_height = std::max(max_height, heights[i]);
+		}
+
+		std::vector<uint8_t> ret(heights.size());
+		for (size_t i = 0; i < heights.size(); ++ i)
+		{
+			ret[i] = Quantize((heights[i] - min_height) / (max_height - min_height));
+		}
+		return ret;
+	}
+
+	float HDRLum(float r, float g, float b)
+	{
+		float y = 0.2126f * r + 0.7152f * g + 0.0722f * b;
+		if (abs(y) < 0.0001f)
+		{
+			y = (y > 0) ? 0.0001f : -0.0001f;
+		}
+		return y;
+	}
+
+	std::vector<uint8_t> ReferenceHDRY(std::vector<float> const & hdr, uint32_t width, uint32_t height)
+	{
+		float const log2 = log(2.0f);
+
+		std::vector<uint8_t> ret(width * height * sizeof(uint16_t));
+		uint16_t* y_dst = reinterpret_cast<uint16_t*>(&ret[0]);
+		for (uint32_t i = 0; i < width * height; ++ i)
+		{
+			float const log_y = log(HDRLum(hdr[i * 4 + 0], hdr[i * 4 + 1], hdr[i * 4 + 2])) / log2 + 16;
+			y_dst[i] = static_cast<uint16_t>(MathLib::clamp<uint32_t>(static_cast<uint32_t>(log_y * 2048), 0, 65535));
+		}
+		return ret;
+	}
+
+	// BC5 blocks of the chroma at half the size
+	std::vector<uint8_t> ReferenceHDRC(std::vector<float> const & hdr, uint32_t width, uint32_t height)
+	{
+		uint32_t const c_width = std::max(width / 2, 1U);
+		uint32_t const c_height = std::max(height / 2, 1U);
+
+		TexCompressionBC4 bc4_codec;
+
+		std::vector<uint8_t> ret;
+		for (uint32_t y_base = 0; y_base < c_height; y_base += 4)
+		{
+			for (uint32_t x_base = 0; x_base < c_width; x_base += 4)
+			{
+				uint8_t uncom_u[16];
+				uint8_t uncom_v[16];
+				for (uint32_t y = 0; y < 4; ++ y)
+				{
+					uint32_t const y0 = MathLib::clamp((y_base + y) * 2 + 0, 0U, height - 1);
+					uint32_t const y1 = MathLib::clamp((y_base + y) * 2 + 1, 0U, height - 1);
+
+					for (uint32_t x = 0; x < 4; ++ x)
+					{
+						uint32_t const x0 = MathLib::clamp((x_base + x) * 2 + 0, 0U, width - 1);
+						uint32_t const x1 = MathLib::clamp((x_base + x) * 2 + 1, 0U, width - 1);
+
+						float rgb[3];
+						for (uint32_t c = 0; c < 3; ++ c)
+						{
+							rgb[c] = hdr[(y0 * width + x0) * 4 + c] + hdr[(y0 * width + x1) * 4 + c]
+								+ hdr[(y1 * width + x0) * 4 + c] + hdr[(y1 * width + x1) * 4 + c];
+						}
+						float const lum = HDRLum(rgb[0], rgb[1], rgb[2]);
+
+						float const log_u = sqrt(0.0722f * rgb[2] / lum);
+						float const log_v = sqrt(0.2126f * rgb[0] / lum);
+						uncom_u[y * 4 + x] = static_cast<uint8_t>(MathLib::clamp(log_u * 256 + 0.5f, 0.0f, 255.0f));
+						uncom_v[y * 4 + x] = static_cast<uint8_t>(MathLib::clamp(log_v * 256 + 0.5f, 0.0f, 255.0f));
+					}
+				}
+
+				BC5Block com_bc5;
+				bc4_codec.EncodeBlock(&com_bc5.red, uncom_u, TCM_Quality);
+				bc4_codec.EncodeBlock(&com_bc5.green, uncom_v, TCM_Quality);
+
+				size_t const offset = ret.size();
+				ret.resize(offset + sizeof(com_bc5));
+				std::memcpy(&ret[offset], &com_bc5, sizeof(com_bc5));
+			}
+		}
+		return ret;
+	}
+}
+
+// Odd sizes, so the last row tile and the last texels of a row are partial
+BOOST_AUTO_TEST_CASE(TextureToolsRGB2FakeHeight)
+{
+	std::string const tool_name = LocateTool("RGB2FakeHeight");
+	BOOST_REQUIRE_MESSAGE(!tool_name.empty(), "RGB2FakeHeight is not built.");
+
+	uint32_t const WIDTH = 53;
+	uint32_t const HEIGHT = 37;
+
+	std::filesystem::path const dir = TestFolder();
+	std::string const in_name = (dir / "RGB.dds").string();
+	std::string const out_name = (dir / "FakeHeight.dds").string();
+
+	std::vector<uint8_t> const rgba = ToUNorm8(SampleImage(WIDTH, HEIGHT, 4));
+	SaveSample(in_name, WIDTH, HEIGHT, EF_ABGR8, &rgba[0]);
+
+	BOOST_REQUIRE_EQUAL(RunTool(tool_name, { in_name, out_name }), 0);
+	CheckBytes(LoadOutput(out_name, EF_R8, WIDTH, HEIGHT), ReferenceFakeHeight(rgba, WIDTH, HEIGHT));
+
+	std::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(TextureToolsNormalMapGen)
+{
+	std::string const tool_name = LocateTool("NormalMapGen");
+	BOOST_REQUIRE_MESSAGE(!tool_name.empty(), "NormalMapGen is not built.");
+
+	uint32_t const WIDTH = 53;
+	uint32_t const HEIGHT = 37;
+
+	std::filesystem::path const dir = TestFolder();
+	std::string const in_name = (dir / "Height.dds").string();
+	std::string const out_name = (dir / "Normal.dds").string();
+
+	std::vector<uint8_t> const heights = ToUNorm8(SampleImage(WIDTH, HEIGHT, 1));
+	SaveSample(in_name, WIDTH, HEIGHT, EF_R8, &heights[0]);
+
+	BOOST_REQUIRE_EQUAL(RunTool(tool_name, { in_name, out_name }), 0);
+	CheckBytes(LoadOutput(out_name, EF_ARGB8, WIDTH, HEIGHT), ReferenceNormalMap(heights, WIDTH, HEIGHT));
+
+	std::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(TextureToolsBump2Normal)
+{
+	std::string const tool_name = LocateTool("Bump2Normal");
+	BOOST_REQUIRE_MESSAGE(!tool_name.empty(), "Bump2Normal is not built.");
+
+	uint32_t const WIDTH = 53;
+	uint32_t const HEIGHT = 37;
+	float const OFFSET = 0.7f;
+
+	std::filesystem::path const dir = TestFolder();
+	std::string const in_name = (dir / "Bump.dds").string();
+	std::string const out_name = (dir / "Normal.dds").string();
+
+	std::vector<uint8_t> const rgba = ToUNorm8(SampleImage(WIDTH, HEIGHT, 4));
+	SaveSample(in_name, WIDTH, HEIGHT, EF_ABGR8, &rgba[0]);
+
+	BOOST_REQUIRE_EQUAL(RunTool(tool_name, { in_name, out_name, "0.7" }), 0);
+	CheckBytes(LoadOutput(out_name, EF_ABGR8, WIDTH, HEIGHT), ReferenceBump2Normal(rgba, WIDTH, HEIGHT, OFFSET),
+		BUMP2NORMAL_MAX_BYTE_DIFF);
+
+	std::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(TextureToolsNormal2Height)
+{
+	std::string const tool_name = LocateTool("Normal2Height");
+	BOOST_REQUIRE_MESSAGE(!tool_name.empty(), "Normal2Height is not built.");
+
+	uint32_t const WIDTH = 53;
+	uint32_t const HEIGHT = 37;
+
+	std::filesystem::path const dir = TestFolder();
+	std::string const in_name = (dir / "Normal.dds").string();
+	std::string const out_name = (dir / "Height.dds").string();
+
+	// The normals of the sample as a height field
+	std::vector<float> const heights = SampleImage(WIDTH, HEIGHT, 1);
+	std::vector<uint8_t> normals(WIDTH * HEIGHT * 4);
+	for (uint32_t y = 0; y < HEIGHT; ++ y)
+	{
+		for (uint32_t x = 0; x < WIDTH; ++ x)
+		{
+			float const dx = heights[y * WIDTH + (x + 1) % WIDTH] - heights[y * WIDTH + x];
+			float const dy = heights[(y + 1) % HEIGHT * WIDTH + x] - heights[y * WIDTH + x];
+			float3 const n = MathLib::normalize(float3(-dx * 4, -dy * 4, 1));
+
+			uint8_t* dst = &normals[(y * WIDTH + x) * 4];
+			dst[0] = Quantize(n.x() * 0.5f + 0.5f);
+			dst[1] = Quantize(n.y() * 0.5f + 0.5f);
+			dst[2] = Quantize(n.z() * 0.5f + 0.5f);
+			dst[3] = 255;
+		}
+	}
+	SaveSample(in_name, WIDTH, HEIGHT, EF_ABGR8, &normals[0]);
+
+	BOOST_REQUIRE_EQUAL(RunTool(tool_name, { in_name, out_name }), 0);
+	CheckBytes(LoadOutput(out_name, EF_R8, WIDTH, HEIGHT), ReferenceNormal2Height(normals, WIDTH, HEIGHT, 1e-6f));
+
+	std::filesystem::remove_all(dir);
+}
+
+BOOST_AUTO_TEST_CASE(TextureToolsHDRCompressor)
+{
+	std::string const tool_name = LocateTool("HDRCompressor");
+	BOOST_REQUIRE_MESSAGE(!tool_name.empty(), "HDRCompressor is not built.");
+
+	uint32_t const WIDTH = 53;
+	uint32_t const HEIGHT = 37;
+
+	std::filesystem::path const dir = TestFolder();
+	std::string const in_name = (dir / "HDR.dds").string();
+	// Written to the current folder
+	std::string const y_name = "HDR_y.dds";
+	std::string const c_name = "HDR_c.dds";
+
+	// Up to 2^6, as in a light probe
+	std::vector<float> hdr = SampleImage(WIDTH, HEIGHT, 4);
+	for (auto& v : hdr)
+	{
+		v = std::exp2(v * 12 - 6);
+	}
+	SaveSample(in_name, WIDTH, HEIGHT, EF_ABGR32F, &hdr[0]);
+
+	BOOST_REQUIRE_EQUAL(RunTool(tool_name, { in_name }), 0);
+	CheckBytes(LoadOutput(y_name, EF_R16, WIDTH, HEIGHT), ReferenceHDRY(hdr, WIDTH, HEIGHT));
+	CheckBytes(LoadOutput(c_name, EF_BC5, (WIDTH / 2 + 3) & ~3U, (HEIGHT / 2 + 3) & ~3U), ReferenceHDRC(hdr, WIDTH, HEIGHT));
+
+	std::filesystem::remove(y_name);
+	std::filesystem::remove(c_name);
+	std::filesystem::remove_all(dir);
+}
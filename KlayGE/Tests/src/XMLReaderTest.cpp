@@ -0,0 +1,213 @@
+#include <KlayGE/KlayGE.hpp>
+#include <KFL/ResIdentifier.hpp>
+#include <KFL/XMLDom.hpp>
+
+#include <boost/assert.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic push
+#pragma clang diagnostic ignored "-Wunused-parameter" // Ignore unused parameter in boost
+#endif
+#include <boost/test/unit_test.hpp>
+#ifdef KLAYGE_COMPILER_CLANG
+#pragma clang diagnostic pop
+#endif
+
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace KlayGE;
+
+namespace
+{
+	ResIdentifierPtr MakeSource(std::string const & xml)
+	{
+		return MakeSharedPtr<ResIdentifier>("test.xml", 0, MakeSharedPtr<std::stringstream>(xml));
+	}
+
+	// The names and depths of all tags, with a / in front of end tags
+	std::vector<std::string> Tags(std::string const & xml)
+	{
+		std::vector<std::string> ret;
+		XMLReader reader(MakeSource(xml));
+		while (reader.Read())
+		{
+			ret.push_back((reader.IsStartElement() ? "" : "/") + reader.Name() + std::to_string(reader.Depth()));
+		}
+		return ret;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(XMLReaderTags)
+{
+	std::vector<std::string> const expected = { "a0", "b1", "/b1", "c1", "d2", "/d2", "/c1", "/a0" };
+	BOOST_CHECK(Tags("<a><b/><c><d></d></c></a>") == expected);
+
+	// Everything but elements is skipped, even if it looks like tags
+	BOOST_CHECK(Tags("<?xml version=\"1.0\"?>\n<!DOCTYPE a>\n<!-- <x/> -->\n<a>text<![CDATA[ <y/> ]]>"
+		"<b t=\"<z/>\" u='>'/><c >text<d></d ></c ><!----></a>") == expected);
+}
+
+BOOST_AUTO_TEST_CASE(XMLReaderAttributes)
+{
+	XMLReader reader(MakeSource("<a i=\"-12\" u = '34' f=\"0.125\" s=\"&lt;&amp;&gt;&quot;&apos;&#65;&#xE9;\" "
+		"v=\"1 2,3\t4\" bad=\"x\"/>"));
+	BOOST_REQUIRE(reader.Read());
+
+	BOOST_CHECK(reader.HasAttrib("i"));
+	BOOST_CHECK(!reader.HasAttrib("j"));
+	BOOST_CHECK_EQUAL(reader.AttribInt("i", 0), -12);
+	BOOST_CHECK_EQUAL(reader.AttribUInt("u", 0), 34U);
+	BOOST_CHECK_EQUAL(reader.AttribFloat("f", 0), 0.125f);
+	BOOST_CHECK_EQUAL(reader.AttribInt("j", 7), 7);
+	BOOST_CHECK_EQUAL(reader.AttribString("s", ""), "<&>\"'A\xC3\xA9");
+	BOOST_CHECK_EQUAL(reader.AttribString("j", "default"), "default");
+
+	float v[5] = { 0, 0, 0, 0, 0 };
+	BOOST_CHECK_EQUAL(reader.AttribArray("v", v, 5), 4U);
+	BOOST_CHECK_EQUAL(v[0], 1.0f);
+	BOOST_CHECK_EQUAL(v[3], 4.0f);
+	BOOST_CHECK_EQUAL(v[4], 0.0f);
+	uint32_t u[2];
+	BOOST_CHECK_EQUAL(reader.AttribArray("v", u, 2), 2U);
+	BOOST_CHECK_EQUAL(u[1], 2U);
+
+	int32_t i;
+	BOOST_CHECK(reader.TryConvertAttrib("i", i, 0));
+	BOOST_CHECK_EQUAL(i, -12);
+	BOOST_CHECK(!reader.TryConvertAttrib("bad", i, 0));
+	BOOST_CHECK(reader.TryConvertAttrib("j", i, 5));
+	BOOST_CHECK_EQUAL(i, 5);
+}
+
+BOOST_AUTO_TEST_CASE(XMLReaderChildren)
+{
+	XMLReader reader(MakeSource("<a><b><x/><y><z/></y></b><c n=\"1\"/><b/><c n=\"2\"><c n=\"3\"/></c></a>"));
+	BOOST_REQUIRE(reader.Read());
+
+	// Grandchildren and the rest of skipped children are passed over
+	std::vector<int32_t> ns;
+	uint32_t const depth = reader.Depth();
+	while (reader.ReadChild(depth))
+	{
+		if ("c" == reader.Name())
+		{
+			ns.push_back(reader.AttribInt("n", 0));
+		}
+	}
+	BOOST_CHECK(ns == std::vector<int32_t>({ 1, 2 }));
+	BOOST_CHECK(!reader.Read());
+}
+
+BOOST_AUTO_TEST_CASE(XMLReaderElementSource)
+{
+	XMLReader reader(MakeSource("<a><m k=\"1\"><n/></m><o/></a>"));
+	BOOST_REQUIRE(reader.Read());
+	BOOST_REQUIRE(reader.ReadChild(0));
+	BOOST_CHECK_EQUAL(reader.ReadElementSource(), "<m k=\"1\"><n/></m>");
+	BOOST_REQUIRE(reader.ReadChild(0));
+	BOOST_CHECK_EQUAL(reader.ReadElementSource(), "<o/>");
+	BOOST_CHECK(!reader.ReadChild(0));
+}
+
+BOOST_AUTO_TEST_CASE(XMLReaderLargeDocument)
+{
+	// Much bigger than the buffer, with a tag that doesn't fit in it
+	std::string const long_value(200 * 1024, 'x');
+	std::ostringstream ss;
+	ss << "<a>";
+	uint32_t const num_elements = 20000;
+	for (uint32_t i = 0; i < num_elements; ++ i)
+	{
+		ss << "<v i=\"" << i << "\"><!-- comment --></v>";
+		if (i == num_elements / 2)
+		{
+			ss << "<long s=\"" << long_value << "\"/>";
+		}
+	}
+	ss << "</a>";
+	std::string const xml = ss.str();
+
+	XMLDocument doc;
+	XMLNodePtr root = doc.Parse(MakeSource(xml));
+
+	XMLReader reader(MakeSource(xml));
+	BOOST_REQUIRE(reader.Read());
+	XMLNodePtr node = root->FirstNode();
+	uint32_t const depth = reader.Depth();
+	while (reader.ReadChild(depth))
+	{
+		BOOST_REQUIRE(node);
+		BOOST_CHECK_EQUAL(reader.Name(), node->Name());
+		if ("long" == reader.Name())
+		{
+			BOOST_CHECK(reader.AttribString("s", "") == long_value);
+		}
+		else
+		{
+			BOOST_CHECK_EQUAL(reader.AttribUInt("i", 0), node->Attrib("i")->ValueUInt());
+		}
+		node = node->NextSibling();
+	}
+	BOOST_CHECK(!node);
+
+	// A source spanning many refills
+	XMLReader all_reader(MakeSource(xml));
+	BOOST_REQUIRE(all_reader.Read());
+	BOOST_CHECK(all_reader.ReadElementSource() == xml);
+}
+
+BOOST_AUTO_TEST_CASE(XMLReaderBufferBoundary)
+{
+	// Tags ending right at the end of the 64KB buffer, and a few bytes around it
+	uint32_t const buffer_size = 64 * 1024;
+	for (uint32_t end = buffer_size - 2; end <= buffer_size + 2; ++ end)
+	{
+		std::string const prefix = "<a><!--";
+		std::string const elem = "<e><x/></e>";
+		std::string const padding(end - prefix.size() - 3 - elem.size(), 'x');
+
+		std::string const empty_xml = prefix + padding + "-->" + std::string(elem.size() - 4, ' ') + "<x/></a>";
+		std::vector<std::string> const expected = { "a0", "x1", "/x1", "/a0" };
+		BOOST_CHECK(Tags(empty_xml) == expected);
+
+		XMLReader reader(MakeSource(prefix + padding + "-->" + elem + "</a>"));
+		BOOST_REQUIRE(reader.Read());
+		BOOST_REQUIRE(reader.ReadChild(0));
+		BOOST_CHECK_EQUAL(reader.ReadElementSource(), elem);
+		BOOST_CHECK(!reader.ReadChild(0));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(XMLReaderMalformed)
+{
+	// Empty or complete documents end with false
+	BOOST_CHECK(Tags("").empty());
+	BOOST_CHECK(Tags("<!-- only a comment -->").empty());
+	BOOST_CHECK_EQUAL(Tags("<a/>\n").size(), 2U);
+
+	BOOST_CHECK_THROW(Tags("<a><b></b>"), std::runtime_error);
+	BOOST_CHECK_THROW(Tags("<a><b x=\"1\""), std::runtime_error);
+	BOOST_CHECK_THROW(Tags("<a><b x=\"/>\"/></a"), std::runtime_error);
+	BOOST_CHECK_THROW(Tags("<a><!-- <b/> </a>"), std::runtime_error);
+	BOOST_CHECK_THROW(Tags("<a><![CDATA[ <b/> </a>"), std::runtime_error);
+	BOOST_CHECK_THROW(Tags("<?xml version=\"1.0\""), std::runtime_error);
+	BOOST_CHECK_THROW(Tags("</a>"), std::runtime_error);
+	BOOST_CHECK_THROW(Tags("<a/></a>"), std::runtime_error);
+	BOOST_CHECK_THROW(Tags("<a></b>"), std::runtime_error);
+	BOOST_CHECK_THROW(Tags("<a><b></a></b>"), std::runtime_error);
+
+	// Cut after many refills
+	BOOST_CHECK_THROW(Tags("<a><!--" + std::string(200 * 1024, 'x')), std::runtime_error);
+
+	// The children of a cut element are read before the end of the input is found
+	XMLReader reader(MakeSource("<a><b/><c n=\"1\">"));
+	BOOST_REQUIRE(reader.Read());
+	BOOST_REQUIRE(reader.ReadChild(0));
+	BOOST_CHECK_EQUAL(reader.Name(), "b");
+	BOOST_REQUIRE(reader.ReadChild(0));
+	BOOST_CHECK_EQUAL(reader.AttribInt("n", 0), 1);
+	BOOST_CHECK_THROW(reader.ReadChild(0), std::runtime_error);
+}
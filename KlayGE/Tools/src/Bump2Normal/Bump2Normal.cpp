@@ -8,12 +8,14 @@
 #include <fstream>
 #include <vector>
 
+#include "TexelWorkers.hpp"
+
 using namespace std;
 using namespace KlayGE;
 
 namespace
 {
-	void Bump2NormalMapSubresource(uint32_t width, uint32_t height, std::vector<Color>& in_data,
+	void Bump2NormalMapSubresource(TexelWorkers& workers, uint32_t width, uint32_t height, std::vector<Color> const & in_data,
 		ElementInitData& new_data, std::vector<uint8_t>& new_data_block, float offset)
 	{
 		new_data.row_pitch = width * 4;
@@ -23,22 +25,25 @@ namespace
 
 		uint8_t* normals = &new_data_block[0];
 
-		for (uint32_t y = 0; y < height; ++ y)
-		{
-			for (uint32_t x = 0; x < width; ++ x)
+		workers.ForEachTexelRun(width, height, [&in_data, normals, width, offset](uint32_t x, uint32_t y, uint32_t n)
 			{
-				float3 n;
-				n.x() = (in_data[y * width + x].r() * 2 - 1) * offset;
-				n.y() = (in_data[y * width + x].g() * 2 - 1) * offset;
-				n.z() = 1;
-				n = MathLib::normalize(n);
-
-				normals[(y * width + x) * 4 + 0] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>((n.x() * 0.5f + 0.5f) * 255.0f + 0.5f), 0, 255));
-				normals[(y * width + x) * 4 + 1] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>((n.y() * 0.5f + 0.5f) * 255.0f + 0.5f), 0, 255));
-				normals[(y * width + x) * 4 + 2] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>((n.z() * 0.5f + 0.5f) * 255.0f + 0.5f), 0, 255));
-				normals[(y * width + x) * 4 + 3] = 255;
-			}
-		}
+				Color const & src = in_data[y * width + x];
+				TexelLanes const one(1.0f);
+				TexelLanes const two(2.0f);
+				TexelLanes const one_half(0.5f);
+				TexelLanes const nx = (TexelWorkers::LoadLanes(&src.r(), 4, n) * two - one) * TexelLanes(offset);
+				TexelLanes const ny = (TexelWorkers::LoadLanes(&src.g(), 4, n) * two - one) * TexelLanes(offset);
+				TexelLanes const inv_len = one / Sqrt(nx * nx + (ny * ny + one));
+
+				uint8_t* dst = normals + (y * width + x) * 4;
+				TexelWorkers::StoreUNorm8Lanes(dst + 0, 4, n, nx * inv_len * one_half + one_half);
+				TexelWorkers::StoreUNorm8Lanes(dst + 1, 4, n, ny * inv_len * one_half + one_half);
+				TexelWorkers::StoreUNorm8Lanes(dst + 2, 4, n, inv_len * one_half + one_half);
+				for (uint32_t i = 0; i < n; ++ i)
+				{
+					dst[i * 4 + 3] = 255;
+				}
+			});
 	}
 
 	void Bump2NormalMap(std::string const & in_file, std::string const & out_file, float offset)
@@ -54,22 +59,24 @@ namespace
 
 		uint32_t const elem_size = NumFormatBytes(in_format);
 
-		std::vector<std::vector<Color>> in_color(in_data.size());
-		for (size_t sub_res = 0; sub_res < in_color.size(); ++ sub_res)
-		{
-			uint32_t the_width = in_data[sub_res].row_pitch / elem_size;
-			uint32_t the_height = in_data[sub_res].slice_pitch / in_data[sub_res].row_pitch;
-			in_color[sub_res].resize(the_width * the_height);
+		TexelWorkers workers;
 
-			uint8_t const * src = static_cast<uint8_t const *>(in_data[sub_res].data);
-			Color* dst = &in_color[sub_res][0];
-			for (uint32_t y = 0; y < the_height; ++ y)
+		std::vector<std::vector<Color>> in_color(in_data.size());
+		workers.ForEachSubresource(static_cast<uint32_t>(in_color.size()), [&in_data, &in_color, in_format, elem_size](uint32_t sub_res)
 			{
-				ConvertToABGR32F(in_format, src, the_width, dst);
-				src += in_data[sub_res].row_pitch;
-				dst += the_width;
-			}
-		}
+				uint32_t the_width = in_data[sub_res].row_pitch / elem_size;
+				uint32_t the_height = in_data[sub_res].slice_pitch / in_data[sub_res].row_pitch;
+				in_color[sub_res].resize(the_width * the_height);
+
+				uint8_t const * src = static_cast<uint8_t const *>(in_data[sub_res].data);
+				Color* dst = &in_color[sub_res][0];
+				for (uint32_t y = 0; y < the_height; ++ y)
+				{
+					ConvertToABGR32F(in_format, src, the_width, dst);
+					src += in_data[sub_res].row_pitch;
+					dst += the_width;
+				}
+			});
 
 		std::vector<ElementInitData> new_data(in_data.size());
 		std::vector<std::vector<uint8_t>> new_data_block(in_data.size());
@@ -79,7 +86,8 @@ namespace
 			uint32_t the_width = in_data[sub_res].row_pitch / 4;
 			uint32_t the_height = in_data[sub_res].slice_pitch / in_data[sub_res].row_pitch;
 
-			Bump2NormalMapSubresource(the_width, the_height, in_color[sub_res], new_data[sub_res], new_data_block[sub_res], offset);
+			Bump2NormalMapSubresource(workers, the_width, the_height, in_color[sub_res], new_data[sub_res], new_data_block[sub_res],
+				offset);
 		}
 
 		SaveTexture(out_file, in_type, in_width, in_height, in_depth, in_num_mipmaps, in_array_size, EF_ABGR8, new_data);
@@ -0,0 +1,293 @@
+/**
+ * @file BuildManifest.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KLAYGE_TOOLS_BUILD_MANIFEST_HPP
+#define _KLAYGE_TOOLS_BUILD_MANIFEST_HPP
+
+#pragma once
+
+#include <KFL/Util.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <boost/noncopyable.hpp>
+
+namespace KlayGE
+{
+	// 64-bit FNV-1a of the inputs of a build item. Unlike std::hash, it's the same width and the same value in every build
+	// of the tools, so a manifest written by one is valid for the others. Strings are prefixed with their length, a name
+	// and a content can't run into each other.
+	class BuildDigest final
+	{
+	public:
+		BuildDigest& AddBytes(void const * data, size_t size)
+		{
+			uint8_t const * p = static_cast<uint8_t const *>(data);
+			for (size_t i = 0; i < size; ++ i)
+			{
+				hash_ = (hash_ ^ p[i]) * 1099511628211ULL;
+			}
+			return *this;
+		}
+
+		template <typename T>
+		BuildDigest& AddValue(T value)
+		{
+			static_assert(std::is_arithmetic<T>::value, "Only numbers have a fixed representation");
+			return this->AddBytes(&value, sizeof(value));
+		}
+
+		BuildDigest& AddString(std::string const & str)
+		{
+			this->AddValue(static_cast<uint64_t>(str.size()));
+			return this->AddBytes(str.data(), str.size());
+		}
+
+		// False if the file can't be read
+		bool AddFile(std::string const & name)
+		{
+			std::ifstream ifs(name.c_str(), std::ios_base::binary);
+			if (!ifs)
+			{
+				return false;
+			}
+
+			uint64_t size = 0;
+			char buf[4096];
+			do
+			{
+				ifs.read(buf, sizeof(buf));
+				this->AddBytes(buf, static_cast<size_t>(ifs.gcount()));
+				size += ifs.gcount();
+			} while (ifs);
+			this->AddValue(size);
+			return true;
+		}
+
+		std::string Str() const
+		{
+			std::ostringstream ss;
+			ss << std::hex << std::setfill('0') << std::setw(16) << hash_;
+			return ss.str();
+		}
+
+	private:
+		uint64_t hash_ = 14695981039346656037ULL;
+	};
+
+	// Held by one process at a time, by creating the lock file exclusively. A lock still held after the timeout is left
+	// by a process that crashed, it's taken over.
+	class BuildFileLock final : boost::noncopyable
+	{
+	public:
+		explicit BuildFileLock(std::string const & name, std::chrono::milliseconds timeout = std::chrono::seconds(30))
+			: name_(name + ".lock")
+		{
+			auto const start = std::chrono::steady_clock::now();
+			for (;;)
+			{
+				if (FILE* fp = std::fopen(name_.c_str(), "wx"))
+				{
+					std::fclose(fp);
+					break;
+				}
+
+				if (std::chrono::steady_clock::now() - start > timeout)
+				{
+					std::remove(name_.c_str());
+				}
+				else
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			}
+		}
+
+		~BuildFileLock()
+		{
+			std::remove(name_.c_str());
+		}
+
+	private:
+		std::string name_;
+	};
+
+	// Digests of the inputs the items of an incremental batch build were built from. One item per line, with the digest,
+	// the item and the files it depends on, separated by tabs. A file with another header is from another version and is
+	// ignored as a whole.
+	//
+	// Only the items built or failed in this run are changed. All other entries, from earlier runs on other batches or
+	// from processes running at the same time, are kept.
+	class BuildManifest final : boost::noncopyable
+	{
+	public:
+		struct Entry
+		{
+			std::string digest;
+			std::vector<std::string> dependencies;
+		};
+
+	public:
+		BuildManifest(std::string const & name, std::string const & header)
+			: name_(name), header_(header)
+		{
+			this->Load(entries_);
+		}
+
+		std::string const & Name() const
+		{
+			return name_;
+		}
+
+		std::map<std::string, Entry> const & Entries() const
+		{
+			return entries_;
+		}
+
+		bool UpToDate(std::string const & item, std::string const & digest) const
+		{
+			auto iter = entries_.find(item);
+			return (iter != entries_.end()) && (iter->second.digest == digest);
+		}
+
+		void Built(std::string const & item, std::string const & digest,
+			std::vector<std::string> const & dependencies = std::vector<std::string>())
+		{
+			Entry& entry = changes_[item];
+			entry.digest = digest;
+			entry.dependencies = dependencies;
+			entries_[item] = entry;
+		}
+
+		// Built again next time
+		void Failed(std::string const & item)
+		{
+			changes_[item] = Entry();
+			entries_.erase(item);
+		}
+
+		// The file is read again, so the entries written by other processes since the load are kept too. Reading, merging
+		// and writing are under a lock, two processes saving at the same time can't drop each other's entries. It's
+		// written atomically, a reader never sees a half written manifest. If it can't be written, everything is built
+		// again next time.
+		void Save()
+		{
+			BuildFileLock lock(name_);
+
+			std::map<std::string, Entry> entries;
+			this->Load(entries);
+			for (auto const & change : changes_)
+			{
+				if (change.second.digest.empty())
+				{
+					entries.erase(change.first);
+				}
+				else
+				{
+					entries[change.first] = change.second;
+				}
+			}
+
+			WriteFileAtomically(name_, [this, &entries](std::string const & tmp_name)
+				{
+					std::ofstream ofs(tmp_name.c_str());
+					ofs << header_ << std::endl;
+					for (auto const & entry : entries)
+					{
+						ofs << entry.second.digest << '\t' << entry.first;
+						for (auto const & dependency : entry.second.dependencies)
+						{
+							ofs << '\t' << dependency;
+						}
+						ofs << std::endl;
+					}
+					if (!ofs)
+					{
+						throw std::ios_base::failure("Failed to write the manifest");
+					}
+				});
+
+			entries_ = std::move(entries);
+			changes_.clear();
+		}
+
+	private:
+		void Load(std::map<std::string, Entry>& entries) const
+		{
+			entries.clear();
+
+			std::ifstream ifs(name_.c_str());
+			std::string line;
+			if (std::getline(ifs, line) && (header_ == line))
+			{
+				while (std::getline(ifs, line))
+				{
+					std::vector<std::string> fields;
+					for (size_t begin = 0; begin <= line.size();)
+					{
+						size_t end = line.find('\t', begin);
+						if (std::string::npos == end)
+						{
+							end = line.size();
+						}
+						fields.push_back(line.substr(begin, end - begin));
+						begin = end + 1;
+					}
+
+					if ((fields.size() >= 2) && !fields[0].empty())
+					{
+						Entry& entry = entries[fields[1]];
+						entry.digest = fields[0];
+						entry.dependencies.assign(fields.begin() + 2, fields.end());
+					}
+				}
+			}
+		}
+
+	private:
+		std::string name_;
+		std::string header_;
+
+		std::map<std::string, Entry> entries_;
+		// An empty digest means failed
+		std::map<std::string, Entry> changes_;
+	};
+}
+
+#endif		// _KLAYGE_TOOLS_BUILD_MANIFEST_HPP
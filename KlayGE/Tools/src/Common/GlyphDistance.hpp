@@ -0,0 +1,219 @@
+/**
+ * @file GlyphDistance.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KLAYGE_TOOLS_GLYPH_DISTANCE_HPP
+#define _KLAYGE_TOOLS_GLYPH_DISTANCE_HPP
+
+#pragma once
+
+#include <KFL/Math.hpp>
+#include <KFL/DistanceTransform.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <boost/assert.hpp>
+
+// The anti-aliased distance fields of KFontGen, from "Anti-aliased Euclidean distance transform" by Gustavson and
+// Strand. Distances are in texels of the glyph.
+namespace KlayGE
+{
+	inline float EdgeDistance(float2 const & grad, float val)
+	{
+		float df;
+		if ((0 == grad.x()) || (0 == grad.y()))
+		{
+			df = 0.5f - val;
+		}
+		else
+		{
+			float2 n_grad = MathLib::abs(MathLib::normalize(grad));
+			if (n_grad.x() < n_grad.y())
+			{
+				std::swap(n_grad.x(), n_grad.y());
+			}
+
+			float v1 = 0.5f * n_grad.y() / n_grad.x();
+			if (val < v1)
+			{
+				df = 0.5f * (n_grad.x() + n_grad.y()) - MathLib::sqrt(2 * n_grad.x() * n_grad.y() * val);
+			}
+			else if (val < 1 - v1)
+			{
+				df = (0.5f - val) * n_grad.x();
+			}
+			else
+			{
+				df = -0.5f * (n_grad.x() + n_grad.y()) + MathLib::sqrt(2 * n_grad.x() * n_grad.y() * (1 - val));
+			}
+		}
+		return df;
+	}
+
+	inline float AADist(std::vector<float> const & img, std::vector<float2> const & grad,
+		int width, int offset_addr, int2 const & offset_dist_xy, float2 const & new_dist)
+	{
+		int closest = offset_addr - offset_dist_xy.y() * width - offset_dist_xy.x(); // Index to the edge pixel pointed to from c
+		float val = img[closest];
+		if (0 == val)
+		{
+			return 1e10f;
+		}
+
+		float di = MathLib::length(new_dist);
+		float df;
+		if (0 == di)
+		{
+			df = EdgeDistance(grad[closest], val);
+		}
+		else
+		{
+			df = EdgeDistance(new_dist, val);
+		}
+		return di + df;
+	}
+
+	// Outside the glyph, the distance comes from the nearest covered texel, found by the exact transform, or one of the
+	// texels around it. The anti-aliased coverage of that texel puts the edge inside it.
+	inline void AAEuclideanDistance(std::vector<float> const & img, std::vector<float2> const & grad,
+		int width, int height, std::vector<float>& dist, std::vector<uint32_t>& nearest)
+	{
+		int const SEARCH_RADIUS = 1;
+
+		for (size_t i = 0; i < img.size(); ++ i)
+		{
+			dist[i] = (img[i] > 0) ? 0 : std::numeric_limits<float>::infinity();
+		}
+
+		// Glyphs are already spread over the threads
+		MathLib::squared_distance_transform(&dist[0], &nearest[0], width, height, 1, 1);
+
+		for (int y = 0; y < height; ++ y)
+		{
+			for (int x = 0; x < width; ++ x)
+			{
+				int const addr = y * width + x;
+				if (img[addr] <= 0)
+				{
+					uint32_t const closest = nearest[addr];
+					if (static_cast<uint32_t>(-1) == closest)
+					{
+						dist[addr] = 1e10f;
+					}
+					else
+					{
+						// The nearest covered texel can be only partly covered. A more covered one next to it can
+						// be closer to the edge.
+						int const cx = static_cast<int>(closest % width);
+						int const cy = static_cast<int>(closest / width);
+						float d = 1e10f;
+						for (int ny = std::max(cy - SEARCH_RADIUS, 0); ny <= std::min(cy + SEARCH_RADIUS, height - 1); ++ ny)
+						{
+							for (int nx = std::max(cx - SEARCH_RADIUS, 0); nx <= std::min(cx + SEARCH_RADIUS, width - 1); ++ nx)
+							{
+								int2 const offset(x - nx, y - ny);
+								d = std::min(d, AADist(img, grad, width, addr, offset,
+									float2(static_cast<float>(offset.x()), static_cast<float>(offset.y()))));
+							}
+						}
+						dist[addr] = d;
+					}
+				}
+				else if (img[addr] < 1)
+				{
+					dist[addr] = EdgeDistance(grad[addr], img[addr]);
+				}
+				else
+				{
+					dist[addr] = 0;
+				}
+			}
+		}
+	}
+
+	inline void ComputeGradient(std::vector<float> const & img_2x, int w, int h, std::vector<float2>& grad)
+	{
+		BOOST_ASSERT(img_2x.size() == static_cast<size_t>(w * h * 4));
+		BOOST_ASSERT(grad.size() == static_cast<size_t>(w * h));
+
+		std::vector<float2> grad_2x(w * h * 4, float2(0, 0));
+		for (int y = 1; y < h * 2 - 1; ++ y)
+		{
+			for (int x = 1; x < w * 2 - 1; ++ x)
+			{
+				int addr = y * w * 2 + x;
+				if ((img_2x[addr] > 0) && (img_2x[addr] < 1))
+				{
+					float s = -img_2x[addr - w * 2 - 1] - img_2x[addr + w * 2 - 1] + img_2x[addr - w * 2 + 1] + img_2x[addr + w * 2 + 1];
+					grad_2x[addr] = MathLib::normalize(float2(s - SQRT2 * (img_2x[addr - 1] - img_2x[addr + 1]),
+						s - SQRT2 * (img_2x[addr - w * 2] - img_2x[addr + w * 2])));
+				}
+			}
+		}
+
+		for (int y = 0; y < h; ++ y)
+		{
+			for (int x = 0; x < w; ++ x)
+			{
+				grad[y * w + x] = (grad_2x[(y * 2 + 0) * w * 2 + (x * 2 + 0)]
+					+ grad_2x[(y * 2 + 0) * w * 2 + (x * 2 + 1)]
+					+ grad_2x[(y * 2 + 1) * w * 2 + (x * 2 + 0)]
+					+ grad_2x[(y * 2 + 1) * w * 2 + (x * 2 + 1)]) * 0.25f;
+			}
+		}
+	}
+
+	// Signed distance of a glyph from its coverage at twice the size, positive inside. aa_bitmap is the coverage at the
+	// size, it's inverted for the inside. All the others are scratch buffers.
+	inline void GlyphSignedDistance(std::vector<float> const & aa_bitmap_2x, int size, std::vector<float>& aa_bitmap,
+		std::vector<float2>& grad, std::vector<float>& outside, std::vector<float>& inside, std::vector<uint32_t>& nearest,
+		std::vector<float>& signed_dist)
+	{
+		ComputeGradient(aa_bitmap_2x, size, size, grad);
+
+		AAEuclideanDistance(aa_bitmap, grad, size, size, outside, nearest);
+
+		for (size_t i = 0; i < grad.size(); ++ i)
+		{
+			aa_bitmap[i] = 1 - aa_bitmap[i];
+			grad[i] = -grad[i];
+		}
+
+		AAEuclideanDistance(aa_bitmap, grad, size, size, inside, nearest);
+
+		for (size_t i = 0; i < outside.size(); ++ i)
+		{
+			signed_dist[i] = std::max(inside[i], 0.0f) - std::max(outside[i], 0.0f);
+		}
+	}
+}
+
+#endif		// _KLAYGE_TOOLS_GLYPH_DISTANCE_HPP
@@ -0,0 +1,473 @@
+/**
+ * @file KeyframeResampler.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KLAYGE_TOOLS_KEYFRAME_RESAMPLER_HPP
+#define _KLAYGE_TOOLS_KEYFRAME_RESAMPLER_HPP
+
+#pragma once
+
+#include <KFL/Math.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <boost/assert.hpp>
+
+#if defined(KLAYGE_SSE_SUPPORT)
+#include <xmmintrin.h>
+#endif
+
+namespace KlayGE
+{
+	struct ResampledTransform
+	{
+		int frame;
+		Quaternion bind_real;
+		Quaternion bind_dual;
+		float scale;
+	};
+
+	typedef std::vector<ResampledTransform> JointResampledKeyframe;
+
+	// Keys of a joint from an importer, each with its own times
+	struct JointKeyframe
+	{
+		std::vector<std::pair<float, float3>> pos;
+		std::vector<std::pair<float, Quaternion>> quats;
+		std::vector<std::pair<float, float3>> scale;
+	};
+
+	// The interval of keys around each time, and the position in it. Times only go forward, so each search starts from
+	// the last interval. Positions are computed in a second loop over the arrays, without the search in it.
+	template <typename T>
+	void KeyframeIntervals(std::vector<std::pair<float, T>> const & keys, std::vector<float> const & times,
+		std::vector<uint32_t>& lowers, std::vector<uint32_t>& uppers, std::vector<float>& fractions)
+	{
+		BOOST_ASSERT(!keys.empty());
+
+		size_t const num_frames = times.size();
+		lowers.assign(num_frames, 0);
+		uppers.assign(num_frames, 0);
+		fractions.assign(num_frames, 0.0f);
+		if (keys.size() == 1)
+		{
+			return;
+		}
+
+		uint32_t const num_keys = static_cast<uint32_t>(keys.size());
+		uint32_t hint = 0;
+		for (size_t f = 0; f < num_frames; ++ f)
+		{
+			uint32_t i = hint;
+			while ((i < num_keys) && !(keys[i].first >= times[f]))
+			{
+				++ i;
+			}
+
+			if (0 == i)
+			{
+				lowers[f] = 0;
+				uppers[f] = 1;
+			}
+			else if (i >= num_keys - 1)
+			{
+				lowers[f] = num_keys - 2;
+				uppers[f] = num_keys - 1;
+			}
+			else
+			{
+				lowers[f] = i - 1;
+				uppers[f] = i;
+			}
+			hint = uppers[f];
+		}
+
+		for (size_t f = 0; f < num_frames; ++ f)
+		{
+			float const lower_time = keys[lowers[f]].first;
+			float const diff = keys[uppers[f]].first - lower_time;
+			fractions[f] = MathLib::clamp((diff == 0) ? 0 : (times[f] - lower_time) / diff, 0.0f, 1.0f);
+		}
+	}
+
+	// MathLib::slerp, with the parts that only depend on the two keys computed once for all frames between them
+	class QuaternionSlerp
+	{
+	public:
+		void Keys(Quaternion const & lhs, Quaternion const & rhs)
+		{
+			lhs_ = lhs;
+			rhs_ = rhs;
+
+			float cosom = MathLib::dot(lhs, rhs);
+			dir_ = 1;
+			if (cosom < 0)
+			{
+				dir_ = -1;
+				cosom = -cosom;
+			}
+
+			lerp_ = !(cosom < 1 - std::numeric_limits<float>::epsilon());
+			if (!lerp_)
+			{
+				omega_ = MathLib::acos(cosom);
+				isinom_ = 1 / MathLib::sin(omega_);
+			}
+		}
+
+		Quaternion operator()(float s) const
+		{
+			float scale0, scale1;
+			if (lerp_)
+			{
+				scale0 = 1 - s;
+				scale1 = s;
+			}
+			else
+			{
+				scale0 = MathLib::sin((1 - s) * omega_) * isinom_;
+				scale1 = MathLib::sin(s * omega_) * isinom_;
+			}
+			return scale0 * lhs_ + dir_ * scale1 * rhs_;
+		}
+
+		// The rotations of frames between the two keys. With SSE 4 frames are interpolated at a time. The sines are
+		// still taken one by one, so the results are the same as operator().
+		void Interpolate(float const * fractions, uint32_t num_frames, ResampledTransform* frames) const
+		{
+			uint32_t f = 0;
+#if defined(KLAYGE_SSE_SUPPORT)
+			__m128 const one = _mm_set1_ps(1);
+			__m128 const dir = _mm_set1_ps(dir_);
+			__m128 const omega = _mm_set1_ps(omega_);
+			__m128 const isinom = _mm_set1_ps(isinom_);
+			for (; f + 4 <= num_frames; f += 4)
+			{
+				__m128 const s = _mm_loadu_ps(fractions + f);
+				__m128 scale0, scale1;
+				if (lerp_)
+				{
+					scale0 = _mm_sub_ps(one, s);
+					scale1 = s;
+				}
+				else
+				{
+					alignas(16) float sin0[4];
+					alignas(16) float sin1[4];
+					_mm_store_ps(sin0, _mm_mul_ps(_mm_sub_ps(one, s), omega));
+					_mm_store_ps(sin1, _mm_mul_ps(s, omega));
+					for (int i = 0; i < 4; ++ i)
+					{
+						sin0[i] = MathLib::sin(sin0[i]);
+						sin1[i] = MathLib::sin(sin1[i]);
+					}
+					scale0 = _mm_mul_ps(_mm_load_ps(sin0), isinom);
+					scale1 = _mm_mul_ps(_mm_load_ps(sin1), isinom);
+				}
+				scale1 = _mm_mul_ps(dir, scale1);
+
+				__m128 x = _mm_add_ps(_mm_mul_ps(scale0, _mm_set1_ps(lhs_.x())), _mm_mul_ps(scale1, _mm_set1_ps(rhs_.x())));
+				__m128 y = _mm_add_ps(_mm_mul_ps(scale0, _mm_set1_ps(lhs_.y())), _mm_mul_ps(scale1, _mm_set1_ps(rhs_.y())));
+				__m128 z = _mm_add_ps(_mm_mul_ps(scale0, _mm_set1_ps(lhs_.z())), _mm_mul_ps(scale1, _mm_set1_ps(rhs_.z())));
+				__m128 w = _mm_add_ps(_mm_mul_ps(scale0, _mm_set1_ps(lhs_.w())), _mm_mul_ps(scale1, _mm_set1_ps(rhs_.w())));
+				_MM_TRANSPOSE4_PS(x, y, z, w);
+				_mm_storeu_ps(&frames[f + 0].bind_real[0], x);
+				_mm_storeu_ps(&frames[f + 1].bind_real[0], y);
+				_mm_storeu_ps(&frames[f + 2].bind_real[0], z);
+				_mm_storeu_ps(&frames[f + 3].bind_real[0], w);
+			}
+#endif
+			for (; f < num_frames; ++ f)
+			{
+				frames[f].bind_real = (*this)(fractions[f]);
+			}
+		}
+
+	private:
+		Quaternion lhs_;
+		Quaternion rhs_;
+		float dir_;
+		bool lerp_;
+		float omega_;
+		float isinom_;
+	};
+
+	// MathLib::sclerp, with the screw between the two transforms computed once
+	class DualQuaternionSclerp
+	{
+	public:
+		void Keys(Quaternion const & lhs_real, Quaternion const & lhs_dual,
+			Quaternion const & rhs_real, Quaternion const & rhs_dual)
+		{
+			lhs_real_ = lhs_real;
+			lhs_dual_ = lhs_dual;
+
+			Quaternion to_sign_corrected_real = rhs_real;
+			Quaternion to_sign_corrected_dual = rhs_dual;
+			if (MathLib::dot(lhs_real, rhs_real) < 0)
+			{
+				to_sign_corrected_real = -to_sign_corrected_real;
+				to_sign_corrected_dual = -to_sign_corrected_dual;
+			}
+
+			std::pair<Quaternion, Quaternion> dif_dq = MathLib::inverse(lhs_real, lhs_dual);
+			dif_dq.second = MathLib::mul_dual(dif_dq.first, dif_dq.second, to_sign_corrected_real, to_sign_corrected_dual);
+			dif_dq.first = MathLib::mul_real(dif_dq.first, to_sign_corrected_real);
+
+			MathLib::udq_to_screw(angle_, pitch_, direction_, moment_, dif_dq.first, dif_dq.second);
+		}
+
+		std::pair<Quaternion, Quaternion> operator()(float s) const
+		{
+			std::pair<Quaternion, Quaternion> const dif_dq = MathLib::udq_from_screw(angle_ * s, pitch_ * s,
+				direction_, moment_);
+			return std::make_pair(MathLib::mul_real(lhs_real_, dif_dq.first),
+				MathLib::mul_dual(lhs_real_, lhs_dual_, dif_dq.first, dif_dq.second));
+		}
+
+		// The transforms of frames between the two keys, 4 frames at a time with SSE. Everything but sincos is done in
+		// the same order as MathLib::udq_from_screw, MathLib::mul_real and MathLib::mul_dual, so the results are the
+		// same as operator().
+		void Interpolate(float const * fractions, uint32_t num_frames, ResampledTransform* frames) const
+		{
+			uint32_t f = 0;
+#if defined(KLAYGE_SSE_SUPPORT)
+			__m128 const one_half = _mm_set1_ps(0.5f);
+			__m128 const sign = _mm_set1_ps(-0.0f);
+			__m128 const dir_x = _mm_set1_ps(direction_.x());
+			__m128 const dir_y = _mm_set1_ps(direction_.y());
+			__m128 const dir_z = _mm_set1_ps(direction_.z());
+			for (; f + 4 <= num_frames; f += 4)
+			{
+				__m128 const s = _mm_loadu_ps(fractions + f);
+				__m128 const angle = _mm_mul_ps(_mm_set1_ps(angle_), s);
+				__m128 const pitch = _mm_mul_ps(_mm_set1_ps(pitch_), s);
+
+				alignas(16) float sa_lanes[4];
+				alignas(16) float ca_lanes[4];
+				_mm_store_ps(sa_lanes, _mm_mul_ps(angle, one_half));
+				for (int i = 0; i < 4; ++ i)
+				{
+					MathLib::sincos(sa_lanes[i], sa_lanes[i], ca_lanes[i]);
+				}
+				__m128 const sa = _mm_load_ps(sa_lanes);
+				__m128 const ca = _mm_load_ps(ca_lanes);
+
+				// udq_from_screw
+				__m128 const screw_real[] = { _mm_mul_ps(dir_x, sa), _mm_mul_ps(dir_y, sa), _mm_mul_ps(dir_z, sa), ca };
+				__m128 const half_pitch_ca = _mm_mul_ps(_mm_mul_ps(one_half, pitch), ca);
+				__m128 const screw_dual[] =
+				{
+					_mm_add_ps(_mm_mul_ps(sa, _mm_set1_ps(moment_.x())), _mm_mul_ps(half_pitch_ca, dir_x)),
+					_mm_add_ps(_mm_mul_ps(sa, _mm_set1_ps(moment_.y())), _mm_mul_ps(half_pitch_ca, dir_y)),
+					_mm_add_ps(_mm_mul_ps(sa, _mm_set1_ps(moment_.z())), _mm_mul_ps(half_pitch_ca, dir_z)),
+					_mm_mul_ps(_mm_mul_ps(_mm_xor_ps(pitch, sign), sa), one_half)
+				};
+
+				// mul_real
+				__m128 real[4];
+				MulLanes(lhs_real_, screw_real, real);
+				_MM_TRANSPOSE4_PS(real[0], real[1], real[2], real[3]);
+				_mm_storeu_ps(&frames[f + 0].bind_real[0], real[0]);
+				_mm_storeu_ps(&frames[f + 1].bind_real[0], real[1]);
+				_mm_storeu_ps(&frames[f + 2].bind_real[0], real[2]);
+				_mm_storeu_ps(&frames[f + 3].bind_real[0], real[3]);
+
+				// mul_dual
+				__m128 lhs_real_screw_dual[4];
+				MulLanes(lhs_real_, screw_dual, lhs_real_screw_dual);
+				__m128 lhs_dual_screw_real[4];
+				MulLanes(lhs_dual_, screw_real, lhs_dual_screw_real);
+				__m128 x = _mm_add_ps(lhs_real_screw_dual[0], lhs_dual_screw_real[0]);
+				__m128 y = _mm_add_ps(lhs_real_screw_dual[1], lhs_dual_screw_real[1]);
+				__m128 z = _mm_add_ps(lhs_real_screw_dual[2], lhs_dual_screw_real[2]);
+				__m128 w = _mm_add_ps(lhs_real_screw_dual[3], lhs_dual_screw_real[3]);
+				_MM_TRANSPOSE4_PS(x, y, z, w);
+				_mm_storeu_ps(&frames[f + 0].bind_dual[0], x);
+				_mm_storeu_ps(&frames[f + 1].bind_dual[0], y);
+				_mm_storeu_ps(&frames[f + 2].bind_dual[0], z);
+				_mm_storeu_ps(&frames[f + 3].bind_dual[0], w);
+			}
+#endif
+			for (; f < num_frames; ++ f)
+			{
+				std::tie(frames[f].bind_real, frames[f].bind_dual) = (*this)(fractions[f]);
+			}
+		}
+
+	private:
+#if defined(KLAYGE_SSE_SUPPORT)
+		// MathLib::mul of a quaternion and 4 quaternions in lanes of x, y, z and w
+		static void MulLanes(Quaternion const & lhs, __m128 const rhs[4], __m128 ret[4])
+		{
+			__m128 const lx = _mm_set1_ps(lhs.x());
+			__m128 const ly = _mm_set1_ps(lhs.y());
+			__m128 const lz = _mm_set1_ps(lhs.z());
+			__m128 const lw = _mm_set1_ps(lhs.w());
+			ret[0] = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(lx, rhs[3]), _mm_mul_ps(ly, rhs[2])),
+				_mm_mul_ps(lz, rhs[1])), _mm_mul_ps(lw, rhs[0]));
+			ret[1] = _mm_add_ps(_mm_sub_ps(_mm_add_ps(_mm_mul_ps(lx, rhs[2]), _mm_mul_ps(ly, rhs[3])),
+				_mm_mul_ps(lz, rhs[0])), _mm_mul_ps(lw, rhs[1]));
+			ret[2] = _mm_add_ps(_mm_add_ps(_mm_sub_ps(_mm_mul_ps(ly, rhs[0]), _mm_mul_ps(lx, rhs[1])),
+				_mm_mul_ps(lz, rhs[3])), _mm_mul_ps(lw, rhs[2]));
+			ret[3] = _mm_sub_ps(_mm_sub_ps(_mm_sub_ps(_mm_mul_ps(lw, rhs[3]), _mm_mul_ps(lx, rhs[0])),
+				_mm_mul_ps(ly, rhs[1])), _mm_mul_ps(lz, rhs[2]));
+		}
+#endif
+
+	private:
+		Quaternion lhs_real_;
+		Quaternion lhs_dual_;
+		float angle_;
+		float pitch_;
+		float3 direction_;
+		float3 moment_;
+	};
+
+	// Samples the keys at frames [start_frame, end_frame), frame i at time i * fps_scale. Each kind of key is resampled
+	// in its own pass over all frames, and the interpolation between two keys is set up once for the run of frames
+	// between them. The results are the same as interpolating frame by frame with MathLib::slerp and MathLib::sclerp.
+	// Translations are interpolated with MathLib::sclerp between the transforms at the two translation keys, with the
+	// rotations at those times from the rotation keys. The translation it gives is then combined with the rotation of
+	// the frame. Without rotation keys the rotation is the identity.
+	inline void ResampleJointTransform(int start_frame, int end_frame, float fps_scale, JointKeyframe const & okf,
+		JointResampledKeyframe& rkf)
+	{
+		uint32_t const num_frames = static_cast<uint32_t>(std::max(end_frame - start_frame, 0));
+
+		std::vector<float> times(num_frames);
+		for (uint32_t f = 0; f < num_frames; ++ f)
+		{
+			times[f] = (start_frame + static_cast<int>(f)) * fps_scale;
+		}
+
+		size_t const base = rkf.size();
+		rkf.resize(base + num_frames);
+		ResampledTransform* frames = rkf.data() + base;
+		for (uint32_t f = 0; f < num_frames; ++ f)
+		{
+			frames[f].frame = start_frame + static_cast<int>(f);
+			frames[f].bind_real = Quaternion(0, 0, 0, 1);
+			frames[f].bind_dual = Quaternion(0, 0, 0, 0);
+			frames[f].scale = 1;
+		}
+
+		std::vector<uint32_t> lowers;
+		std::vector<uint32_t> uppers;
+		std::vector<float> fractions;
+
+		if (!okf.scale.empty())
+		{
+			KeyframeIntervals(okf.scale, times, lowers, uppers, fractions);
+			for (uint32_t f = 0; f < num_frames; ++ f)
+			{
+				frames[f].scale = MathLib::lerp(okf.scale[lowers[f]].second, okf.scale[uppers[f]].second, fractions[f]).x();
+			}
+		}
+
+		QuaternionSlerp slerp;
+		if (!okf.quats.empty())
+		{
+			KeyframeIntervals(okf.quats, times, lowers, uppers, fractions);
+			for (uint32_t f = 0; f < num_frames;)
+			{
+				uint32_t run_end = f + 1;
+				while ((run_end < num_frames) && (lowers[run_end] == lowers[f]) && (uppers[run_end] == uppers[f]))
+				{
+					++ run_end;
+				}
+
+				slerp.Keys(okf.quats[lowers[f]].second, okf.quats[uppers[f]].second);
+				slerp.Interpolate(&fractions[f], run_end - f, &frames[f]);
+				f = run_end;
+			}
+		}
+
+		if (!okf.pos.empty())
+		{
+			// The rotations at the times of the translation keys
+			std::vector<Quaternion> pos_reals(okf.pos.size(), Quaternion(0, 0, 0, 1));
+			if (!okf.quats.empty())
+			{
+				std::vector<float> pos_times(okf.pos.size());
+				for (size_t i = 0; i < okf.pos.size(); ++ i)
+				{
+					pos_times[i] = okf.pos[i].first;
+				}
+				KeyframeIntervals(okf.quats, pos_times, lowers, uppers, fractions);
+				for (size_t i = 0; i < okf.pos.size(); ++ i)
+				{
+					slerp.Keys(okf.quats[lowers[i]].second, okf.quats[uppers[i]].second);
+					pos_reals[i] = slerp(fractions[i]);
+				}
+			}
+
+			KeyframeIntervals(okf.pos, times, lowers, uppers, fractions);
+
+			std::vector<ResampledTransform> screws(num_frames);
+			DualQuaternionSclerp sclerp;
+			for (uint32_t f = 0; f < num_frames;)
+			{
+				uint32_t run_end = f + 1;
+				while ((run_end < num_frames) && (lowers[run_end] == lowers[f]) && (uppers[run_end] == uppers[f]))
+				{
+					++ run_end;
+				}
+
+				Quaternion const & lhs_real = pos_reals[lowers[f]];
+				Quaternion const & rhs_real = pos_reals[uppers[f]];
+				sclerp.Keys(lhs_real, MathLib::quat_trans_to_udq(lhs_real, okf.pos[lowers[f]].second),
+					rhs_real, MathLib::quat_trans_to_udq(rhs_real, okf.pos[uppers[f]].second));
+				sclerp.Interpolate(&fractions[f], run_end - f, &screws[f]);
+				f = run_end;
+			}
+
+			for (uint32_t f = 0; f < num_frames; ++ f)
+			{
+				frames[f].bind_dual = MathLib::quat_trans_to_udq(frames[f].bind_real,
+					MathLib::udq_to_trans(screws[f].bind_real, screws[f].bind_dual));
+			}
+		}
+
+		for (uint32_t f = 0; f < num_frames; ++ f)
+		{
+			if (MathLib::SignBit(frames[f].bind_real.w()) < 0)
+			{
+				frames[f].bind_real = -frames[f].bind_real;
+				frames[f].bind_dual = -frames[f].bind_dual;
+			}
+		}
+	}
+}
+
+#endif		// _KLAYGE_TOOLS_KEYFRAME_RESAMPLER_HPP
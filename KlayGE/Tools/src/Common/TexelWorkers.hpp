@@ -0,0 +1,332 @@
+/**
+ * @file TexelWorkers.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KLAYGE_TOOLS_TEXEL_WORKERS_HPP
+#define _KLAYGE_TOOLS_TEXEL_WORKERS_HPP
+
+#pragma once
+
+#include <KFL/CpuInfo.hpp>
+#include <KFL/Math.hpp>
+#include <KFL/Thread.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(KLAYGE_SSE_SUPPORT)
+#include <xmmintrin.h>
+#endif
+
+#include <boost/noncopyable.hpp>
+
+namespace KlayGE
+{
+	// 4 floats, in an SSE register where it's supported. The operations are inline and work lane by lane with IEEE float
+	// math, so a kernel gets the same bits as the scalar code doing the same operations in the same order.
+	class TexelLanes final
+	{
+	public:
+		TexelLanes()
+		{
+		}
+		explicit TexelLanes(float v)
+		{
+#if defined(KLAYGE_SSE_SUPPORT)
+			v_ = _mm_set1_ps(v);
+#else
+			v_[0] = v_[1] = v_[2] = v_[3] = v;
+#endif
+		}
+
+		static TexelLanes Load(float const * src)
+		{
+			TexelLanes ret;
+#if defined(KLAYGE_SSE_SUPPORT)
+			ret.v_ = _mm_loadu_ps(src);
+#else
+			std::copy(src, src + 4, ret.v_);
+#endif
+			return ret;
+		}
+
+		void Store(float* dst) const
+		{
+#if defined(KLAYGE_SSE_SUPPORT)
+			_mm_storeu_ps(dst, v_);
+#else
+			std::copy(v_, v_ + 4, dst);
+#endif
+		}
+
+		friend TexelLanes operator+(TexelLanes const & lhs, TexelLanes const & rhs)
+		{
+			TexelLanes ret;
+#if defined(KLAYGE_SSE_SUPPORT)
+			ret.v_ = _mm_add_ps(lhs.v_, rhs.v_);
+#else
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.v_[i] = lhs.v_[i] + rhs.v_[i];
+			}
+#endif
+			return ret;
+		}
+		friend TexelLanes operator-(TexelLanes const & lhs, TexelLanes const & rhs)
+		{
+			TexelLanes ret;
+#if defined(KLAYGE_SSE_SUPPORT)
+			ret.v_ = _mm_sub_ps(lhs.v_, rhs.v_);
+#else
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.v_[i] = lhs.v_[i] - rhs.v_[i];
+			}
+#endif
+			return ret;
+		}
+		friend TexelLanes operator*(TexelLanes const & lhs, TexelLanes const & rhs)
+		{
+			TexelLanes ret;
+#if defined(KLAYGE_SSE_SUPPORT)
+			ret.v_ = _mm_mul_ps(lhs.v_, rhs.v_);
+#else
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.v_[i] = lhs.v_[i] * rhs.v_[i];
+			}
+#endif
+			return ret;
+		}
+		friend TexelLanes operator/(TexelLanes const & lhs, TexelLanes const & rhs)
+		{
+			TexelLanes ret;
+#if defined(KLAYGE_SSE_SUPPORT)
+			ret.v_ = _mm_div_ps(lhs.v_, rhs.v_);
+#else
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.v_[i] = lhs.v_[i] / rhs.v_[i];
+			}
+#endif
+			return ret;
+		}
+		friend TexelLanes Max(TexelLanes const & lhs, TexelLanes const & rhs)
+		{
+			TexelLanes ret;
+#if defined(KLAYGE_SSE_SUPPORT)
+			ret.v_ = _mm_max_ps(lhs.v_, rhs.v_);
+#else
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.v_[i] = std::max(lhs.v_[i], rhs.v_[i]);
+			}
+#endif
+			return ret;
+		}
+		friend TexelLanes Sqrt(TexelLanes const & rhs)
+		{
+			TexelLanes ret;
+#if defined(KLAYGE_SSE_SUPPORT)
+			ret.v_ = _mm_sqrt_ps(rhs.v_);
+#else
+			for (int i = 0; i < 4; ++ i)
+			{
+				ret.v_[i] = std::sqrt(rhs.v_[i]);
+			}
+#endif
+			return ret;
+		}
+
+		// lhs + (rhs - lhs) * s, as MathLib::lerp
+		friend TexelLanes Lerp(TexelLanes const & lhs, TexelLanes const & rhs, TexelLanes const & s)
+		{
+			return lhs + (rhs - lhs) * s;
+		}
+
+	private:
+#if defined(KLAYGE_SSE_SUPPORT)
+		__m128 v_;
+#else
+		float v_[4];
+#endif
+	};
+
+	// Spreads the loops of the offline texture tools over all cores. Texels are handed out in tiles of whole rows, so
+	// each thread walks memory in order. Kernels write only their own texels or blocks, so the result doesn't depend on
+	// the number of threads.
+	//
+	// The loops don't nest. A kernel running on the workers mustn't start another loop.
+	//
+	// ForEachTexelRun hands out runs of texels of a row, for kernels working on one texel in each lane of a TexelLanes.
+	class TexelWorkers final : boost::noncopyable
+	{
+	public:
+		static uint32_t const TILE_ROWS = 16;
+		static uint32_t const RUN_TEXELS = 4;
+
+		TexelWorkers()
+			: num_threads_(std::max(static_cast<uint32_t>(CPUInfo().NumHWThreads()), 1U)),
+				tp_(1, num_threads_)
+		{
+		}
+
+		uint32_t NumThreads() const
+		{
+			return num_threads_;
+		}
+
+		// task(i) for i in [0, num_tasks)
+		template <typename Task>
+		void ForEach(uint32_t num_tasks, Task const & task)
+		{
+			parallel_for(tp_, num_threads_, num_tasks, task);
+		}
+
+		// kernel(sub_res) for each subresource
+		template <typename Kernel>
+		void ForEachSubresource(uint32_t num_sub_res, Kernel const & kernel)
+		{
+			this->ForEach(num_sub_res, kernel);
+		}
+
+		// kernel(y_begin, y_end) for tiles of up to TILE_ROWS rows
+		template <typename Kernel>
+		void ForEachRowTile(uint32_t height, Kernel const & kernel)
+		{
+			uint32_t const num_tiles = (height + TILE_ROWS - 1) / TILE_ROWS;
+			this->ForEach(num_tiles, [&kernel, height](uint32_t tile)
+				{
+					uint32_t const y_begin = tile * TILE_ROWS;
+					kernel(y_begin, std::min(y_begin + TILE_ROWS, height));
+				});
+		}
+
+		// kernel(x, y) for each texel
+		template <typename Kernel>
+		void ForEachTexel(uint32_t width, uint32_t height, Kernel const & kernel)
+		{
+			this->ForEachRowTile(height, [&kernel, width](uint32_t y_begin, uint32_t y_end)
+				{
+					for (uint32_t y = y_begin; y < y_end; ++ y)
+					{
+						for (uint32_t x = 0; x < width; ++ x)
+						{
+							kernel(x, y);
+						}
+					}
+				});
+		}
+
+		// kernel(x, y, n) for each run of n texels from (x, y). n is RUN_TEXELS, except in the last run of a row.
+		template <typename Kernel>
+		void ForEachTexelRun(uint32_t width, uint32_t height, Kernel const & kernel)
+		{
+			this->ForEachRowTile(height, [&kernel, width](uint32_t y_begin, uint32_t y_end)
+				{
+					for (uint32_t y = y_begin; y < y_end; ++ y)
+					{
+						for (uint32_t x = 0; x < width; x += RUN_TEXELS)
+						{
+							kernel(x, y, std::min(RUN_TEXELS, width - x));
+						}
+					}
+				});
+		}
+
+		// Lane i is src[i * stride] for i < n. The lanes past the run are 0.
+		static TexelLanes LoadLanes(float const * src, uint32_t stride, uint32_t n)
+		{
+			float lanes[RUN_TEXELS] = { 0, 0, 0, 0 };
+			for (uint32_t i = 0; i < n; ++ i)
+			{
+				lanes[i] = src[i * stride];
+			}
+			return TexelLanes::Load(lanes);
+		}
+
+		// As LoadLanes, with 0 to 255 mapped to 0 to 1
+		static TexelLanes LoadUNorm8Lanes(uint8_t const * src, uint32_t stride, uint32_t n)
+		{
+			float lanes[RUN_TEXELS] = { 0, 0, 0, 0 };
+			for (uint32_t i = 0; i < n; ++ i)
+			{
+				lanes[i] = src[i * stride];
+			}
+			return TexelLanes::Load(lanes) / TexelLanes(255.0f);
+		}
+
+		// dst[i * stride] is lane i for i < n
+		static void StoreLanes(float* dst, uint32_t stride, uint32_t n, TexelLanes const & v)
+		{
+			float lanes[RUN_TEXELS];
+			v.Store(lanes);
+			for (uint32_t i = 0; i < n; ++ i)
+			{
+				dst[i * stride] = lanes[i];
+			}
+		}
+
+		// As StoreLanes, with 0 to 1 rounded to 0 to 255
+		static void StoreUNorm8Lanes(uint8_t* dst, uint32_t stride, uint32_t n, TexelLanes const & v)
+		{
+			float lanes[RUN_TEXELS];
+			(v * TexelLanes(255.0f) + TexelLanes(0.5f)).Store(lanes);
+			for (uint32_t i = 0; i < n; ++ i)
+			{
+				dst[i * stride] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(lanes[i]), 0, 255));
+			}
+		}
+
+		// kernel(block_x, block_y) for each block of block_width x block_height texels. The last blocks of a row or a
+		// column can be partly outside.
+		template <typename Kernel>
+		void ForEachBlock(uint32_t width, uint32_t height, uint32_t block_width, uint32_t block_height, Kernel const & kernel)
+		{
+			uint32_t const blocks_x = (width + block_width - 1) / block_width;
+			uint32_t const blocks_y = (height + block_height - 1) / block_height;
+			this->ForEachRowTile(blocks_y, [&kernel, blocks_x](uint32_t by_begin, uint32_t by_end)
+				{
+					for (uint32_t by = by_begin; by < by_end; ++ by)
+					{
+						for (uint32_t bx = 0; bx < blocks_x; ++ bx)
+						{
+							kernel(bx, by);
+						}
+					}
+				});
+		}
+
+	private:
+		uint32_t num_threads_;
+		thread_pool tp_;
+	};
+}
+
+#endif		// _KLAYGE_TOOLS_TEXEL_WORKERS_HPP
@@ -0,0 +1,78 @@
+/**
+ * @file ToolRunner.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _KLAYGE_TOOLS_TOOL_RUNNER_HPP
+#define _KLAYGE_TOOLS_TOOL_RUNNER_HPP
+
+#pragma once
+
+#include <KFL/Util.hpp>
+#include <KlayGE/ResLoader.hpp>
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace KlayGE
+{
+	// The path of a tool built with the caller, or an empty string if it's not found
+	inline std::string LocateTool(std::string const & name)
+	{
+		std::string tool_name = name + KLAYGE_DBG_SUFFIX;
+#ifdef KLAYGE_PLATFORM_WINDOWS_DESKTOP
+		tool_name += ".exe";
+#endif
+		tool_name = ResLoader::Instance().Locate(tool_name);
+#ifndef KLAYGE_PLATFORM_WINDOWS
+		if (!tool_name.empty() && (std::string::npos == tool_name.find("/")))
+		{
+			tool_name = "./" + tool_name;
+		}
+#endif
+		return tool_name;
+	}
+
+	// Each argument is quoted, so paths may have spaces. Returns the exit code of the tool.
+	inline int RunTool(std::string const & tool_name, std::vector<std::string> const & args)
+	{
+		std::string cmd = "\"" + tool_name + "\"";
+		for (auto const & arg : args)
+		{
+			cmd += " \"" + arg + "\"";
+		}
+#ifdef KLAYGE_PLATFORM_WINDOWS
+		// cmd.exe strips the first and the last quotes
+		cmd = "\"" + cmd + "\"";
+#endif
+		return std::system(cmd.c_str());
+	}
+}
+
+#endif		// _KLAYGE_TOOLS_TOOL_RUNNER_HPP
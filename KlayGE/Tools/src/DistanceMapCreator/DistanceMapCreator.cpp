@@ -4,6 +4,11 @@
 
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/Math.hpp>
+#include <KFL/SIMDMath.hpp>
+#include <KFL/SIMDVector.hpp>
+#include <KFL/AlignedAllocator.hpp>
+#include <KFL/DistanceTransform.hpp>
+#include <KFL/Timer.hpp>
 #include <KlayGE/App3D.hpp>
 #include <KlayGE/RenderFactory.hpp>
 #include <KlayGE/Context.hpp>
@@ -11,6 +16,7 @@
 
 #include <cmath>
 #include <iostream>
+#include <limits>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -21,196 +27,36 @@
 using namespace std;
 using namespace KlayGE;
 
-// A type to hold the distance map while it's being constructed
-template <typename DistanceType>
-class DistanceMap
-{
-public:
-	DistanceMap(int width, int height, int depth)
-		: data_(width * height * depth * 3),
-			width_(width), height_(height), depth_(depth)
-	{
-	}
-
-	DistanceType& operator()(int x, int y, int z, int i)
-	{
-		return data_[((z * height_ + y) * width_ + x) * 3 + i];
-	}
-
-	DistanceType const & operator()(int x, int y, int z, int i) const
-	{
-		return data_[((z * height_ + y) * width_ + x) * 3 + i];
-	}
-
-	bool inside(int x, int y, int z) const
-	{
-		return (0 <= x) && (x < width_)
-			&& (0 <= y) && (y < height_)
-			&& (0 <= z) && (z < depth_);
-	}
-
-	// Do a single pass over the data.
-	// Start at (x,y,z) and walk in the direction (cx,cy,cz)
-	// Combine each pixel (x,y,z) with the value at (x+dx,y+dy,z+dz)
-	void combine(int dx, int dy, int dz,
-		int cx, int cy, int cz,
-		int x, int y, int z)
-	{
-		while (inside(x, y, z) && inside(x + dx, y + dy, z + dz))
-		{
-			int d[3] =
-			{
-				abs(dx),
-				abs(dy),
-				abs(dz)
-			};
-
-			uint32_t v1[3], v2[3];
-			for (int i = 0; i < 3; ++ i)
-			{
-				v1[i] = operator()(x, y, z, i);
-				v2[i] = operator()(x + dx, y + dy, z + dz, i) + d[i];
-			}
-
-			if (v1[0] * v1[0] + v1[1] * v1[1] + v1[2] * v1[2] > v2[0] * v2[0] + v2[1] * v2[1] + v2[2] * v2[2])
-			{
-				for (int i = 0; i < 3; ++ i)
-				{
-					operator()(x, y, z, i) = static_cast<DistanceType>(v2[i]);
-				}
-			}
-
-			x += cx;
-			y += cy;
-			z += cz;
-		}
-	}
-
-private:
-	std::vector<DistanceType> data_;
-	int width_, height_, depth_;
-};
-
 void ComputeDistanceField(std::vector<uint8_t>& distances, int width, int height, int depth,
 						std::vector<uint8_t> const & volume)
 {
-	// and +infinity above
-	DistanceMap<uint16_t> dmap(width, height, depth);
-	for (int z = 0; z < depth; ++ z)
+	// 0 on the surface, and +infinity above
+	std::vector<float, aligned_allocator<float, 16>> dmap(volume.size());
+	for (size_t i = 0; i < volume.size(); ++ i)
 	{
-		for (int y = 0; y < height; ++ y)
-		{
-			for (int x = 0; x < width; ++ x)
-			{
-				for (int i = 0; i < 3; ++ i)
-				{
-					if (volume[(z * height + y) * width + x] != 0)
-					{
-						dmap(x, y, z, i) = 0;
-					}
-					else
-					{
-						dmap(x, y, z, i) = std::numeric_limits<uint16_t>::max();
-					}
-				}
-			}
-		}
+		dmap[i] = (volume[i] != 0) ? 0 : std::numeric_limits<float>::infinity();
 	}
 
+	MathLib::squared_distance_transform(&dmap[0], nullptr, width, height, depth);
 
-	// Compute the rest of dmap by sequential sweeps over the data
-	// using a 3d variant of Danielsson's algorithm
-
-	for (int z = 1; z < depth; ++ z)
-	{
-		// combine with everything with dz = -1
-		for (int y = 0; y < height; ++ y)
-		{
-			dmap.combine(0, 0, -1,
-				1, 0, 0,
-				0, y, z);
-		}
-
-		for (int y = 1; y < height; ++ y)
-		{
-			dmap.combine(0, -1, 0,
-				1, 0, 0,
-				0, y, z);
-			dmap.combine(-1, 0, 0,
-				1, 0, 0,
-				1, y, z);
-			dmap.combine(+1, 0, 0,
-				-1, 0, 0,
-				width - 2, y, z);
-		}
-
-		for (int y = height - 1; y >= 0; -- y)
-		{
-			dmap.combine(0, +1, 0,
-				1, 0, 0,
-				0, y, z);
-			dmap.combine(-1, 0, 0,
-				1, 0, 0,
-				1, y, z);
-			dmap.combine(+1, 0, 0,
-				-1, 0, 0,
-				width - 1, y, z);
-		}
-	}
-
-	for (int z = depth - 1; z >= 0; -- z)
+	// Normalize 4 texels at a time
+	SIMDVectorF4 const scale = SIMDMathLib::SetVector(255.0f / depth);
+	SIMDVectorF4 const max_value = SIMDMathLib::SetVector(255.0f);
+	size_t const num_texels = dmap.size();
+	size_t i = 0;
+	for (; i + 4 <= num_texels; i += 4)
 	{
-		cout << ".";
-
-		// combine with everything with dz = +1
-		for (int y = 0; y < height; ++ y)
-		{
-			dmap.combine(0, 0, +1,
-				1, 0, 0,
-				0, y, z);
-		}
-
-		for (int y = 1; y < height; ++ y)
-		{
-			dmap.combine(0, -1, 0,
-				1, 0, 0,
-				0, y, z);
-			dmap.combine(-1, 0, 0,
-				1, 0, 0,
-				1, y, z);
-			dmap.combine(+1, 0, 0,
-				-1, 0, 0,
-				width - 2, y, z);
-		}
-		for (int y = height - 1; y >= 0; -- y)
-		{
-			dmap.combine(0, +1, 0,
-				1, 0, 0,
-				0, y, z);
-			dmap.combine(-1, 0, 0,
-				1, 0, 0,
-				1, y, z);
-			dmap.combine(+1, 0, 0,
-				-1, 0, 0,
-				width - 1, y, z);
-		}
+		SIMDVectorF4 v = SIMDMathLib::LoadVector4(&dmap[i]);
+		v = SIMDMathLib::Minimize(SIMDMathLib::Multiply(SIMDMathLib::Sqrt(v), scale), max_value);
+		// StoreVector4 needs an aligned float4, so the lanes are read one by one
+		distances[i + 0] = static_cast<uint8_t>(SIMDMathLib::GetX(v));
+		distances[i + 1] = static_cast<uint8_t>(SIMDMathLib::GetY(v));
+		distances[i + 2] = static_cast<uint8_t>(SIMDMathLib::GetZ(v));
+		distances[i + 3] = static_cast<uint8_t>(SIMDMathLib::GetW(v));
 	}
-
-	for (int z = 0; z < depth; ++ z)
+	for (; i < num_texels; ++ i)
 	{
-		for (int y = 0; y < height; ++ y)
-		{
-			for (int x = 0; x < width; ++ x)
-			{
-				float value = 0;
-				for (int i = 0; i < 3; ++ i)
-				{
-					value += dmap(x, y, z, i) * dmap(x, y, z, i);
-				}
-				distances[(z * height + y) * width + x]
-					= static_cast<uint8_t>(MathLib::clamp(sqrt(value) / depth, 0.0f, 1.0f) * 255);
-			}
-		}
+		distances[i] = static_cast<uint8_t>(std::min(sqrt(dmap[i]) * 255 / depth, 255.0f));
 	}
 }
 
@@ -334,12 +180,12 @@ int main(int argc, char* argv[])
 		}
 	}
 
-	clock_t start = clock();
+	Timer timer;
 
 	std::vector<uint8_t> distances(width * height * depth);
 	ComputeDistanceField(distances, width, height, depth, volume);
 
-	cout << endl << "Computing time: " << clock() - start << " ms" << endl;
+	cout << "Computing time: " << timer.elapsed() * 1000 << " ms" << endl;
 
 	TexturePtr distance_map_texture = render_factory.MakeTexture3D(width, height, depth, 1, 1, EF_R8, 1, 0, EAH_CPU_Read | EAH_CPU_Write);
 
@@ -30,21 +30,32 @@
 
 #include <KlayGE/KlayGE.hpp>
 #include <KlayGE/Context.hpp>
+#include <KlayGE/RenderEffect.hpp>
 #include <KlayGE/ResLoader.hpp>
+#include <KFL/CpuInfo.hpp>
+#include <KFL/Thread.hpp>
 #include <KFL/XMLDom.hpp>
 #include <KFL/CXX17/filesystem.hpp>
 
+#include <atomic>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <mutex>
+#include <set>
+#include <sstream>
 
 #include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/trim.hpp>
 
+#include "BuildManifest.hpp"
 #include "OfflineRenderEffect.hpp"
+#include "OfflineShaderObject.hpp"
 
 using namespace std;
 using namespace KlayGE;
 
-uint32_t const KFX_VERSION = 0x0110;
-
 int RetrieveAttrValue(XMLNodePtr node, std::string const & attr_name, int default_value)
 {
 	XMLAttributePtr attr = node->Attrib(attr_name);
@@ -132,11 +143,271 @@ Offline::OfflineRenderDeviceCaps LoadPlatformConfig(std::string const & platform
 	return caps;
 }
 
+void CopyKfx(filesystem::path const & from, filesystem::path const & to)
+{
+	filesystem::copy_file(from, to,
+#if defined(KLAYGE_CXX17_LIBRARY_FILESYSTEM_SUPPORT) || defined(KLAYGE_TS_LIBRARY_FILESYSTEM_SUPPORT)
+		filesystem::copy_options::overwrite_existing);
+#else
+		filesystem::copy_option::overwrite_if_exists);
+#endif
+}
+
+namespace
+{
+	// Bump it when the output changes without a change in the inputs, to rebuild everything
+	uint32_t const MANIFEST_VERSION = 1;
+
+	struct EffectJob
+	{
+		std::string fxml_name;
+		filesystem::path kfx_path;
+		filesystem::path target_kfx_path;
+
+		std::vector<std::string> include_names;
+		std::string digest;
+
+		bool built;
+	};
+
+	std::string ReadResource(std::string const & name)
+	{
+		std::string ret;
+		ResIdentifierPtr res = ResLoader::Instance().Open(name);
+		if (res)
+		{
+			ret.assign(std::istreambuf_iterator<char>(res->input_stream()), std::istreambuf_iterator<char>());
+		}
+		return ret;
+	}
+
+	// All files included by an effect, directly or through other includes
+	void CollectIncludes(std::string const & name, std::vector<std::string>& include_names)
+	{
+		ResIdentifierPtr source = ResLoader::Instance().Open(name);
+		if (!source)
+		{
+			return;
+		}
+
+		KlayGE::XMLDocument doc;
+		XMLNodePtr root = doc.Parse(source);
+		for (XMLNodePtr node = root->FirstNode("include"); node; node = node->NextSibling("include"))
+		{
+			std::string const include_name = node->AttribString("name", "");
+			if (std::find(include_names.begin(), include_names.end(), include_name) == include_names.end())
+			{
+				include_names.push_back(include_name);
+				CollectIncludes(include_name, include_names);
+			}
+		}
+	}
+
+	// Covers the content of the effect and all its includes, so changes in macros or shared code are seen too. The
+	// platform config decides the device caps the shaders are built for.
+	std::string InputDigest(std::string const & plat_conf, EffectJob const & job)
+	{
+		BuildDigest digest;
+		digest.AddValue(KFX_VERSION).AddValue(MANIFEST_VERSION).AddString(plat_conf);
+		digest.AddString(ReadResource(job.fxml_name));
+		for (auto const & include_name : job.include_names)
+		{
+			digest.AddString(include_name).AddString(ReadResource(include_name));
+		}
+		return digest.Str();
+	}
+
+	// A directory means all the .fxml files in it, anything else is a text file with one effect per line
+	std::vector<std::string> CollectBatchFiles(std::string const & batch)
+	{
+		std::vector<std::string> ret;
+		if (filesystem::is_directory(batch))
+		{
+			for (filesystem::directory_iterator iter(batch), end; iter != end; ++ iter)
+			{
+				std::string ext = iter->path().extension().string();
+				boost::algorithm::to_lower(ext);
+				if (filesystem::is_regular_file(iter->path()) && (".fxml" == ext))
+				{
+					ret.push_back(iter->path().string());
+				}
+			}
+		}
+		else
+		{
+			std::ifstream ifs(batch.c_str());
+			std::string line;
+			while (std::getline(ifs, line))
+			{
+				boost::algorithm::trim(line);
+				if (!line.empty())
+				{
+					std::string const file = ResLoader::Instance().Locate(line);
+					if (file.empty())
+					{
+						cout << "Couldn't locate " << line << endl;
+					}
+					else
+					{
+						ret.push_back(file);
+					}
+				}
+			}
+		}
+
+		return ret;
+	}
+
+	// Effects are independent, so they are built on all cores. Shaders shared by several effects are compiled once.
+	int CompileBatch(std::string const & platform, Offline::OfflineRenderDeviceCaps const & caps,
+		std::string const & batch, filesystem::path const & target_folder)
+	{
+		std::vector<std::string> const fxml_names = CollectBatchFiles(batch);
+		if (fxml_names.empty())
+		{
+			cout << "No effect to compile." << endl;
+			return 1;
+		}
+
+		filesystem::path manifest_folder = target_folder;
+		if (manifest_folder.empty())
+		{
+			manifest_folder = filesystem::is_directory(batch) ? filesystem::path(batch) : filesystem::path(batch).parent_path();
+		}
+		else
+		{
+			filesystem::create_directories(target_folder);
+		}
+		BuildManifest manifest((manifest_folder / ("FXMLJIT_" + platform + ".manifest")).string(),
+			"FXMLJIT manifest " + std::to_string(MANIFEST_VERSION));
+
+		// Includes are searched next to the effects
+		std::set<std::string> folders;
+		for (auto const & fxml_name : fxml_names)
+		{
+			std::string const folder = filesystem::path(fxml_name).parent_path().string();
+			if (folders.insert(folder).second)
+			{
+				ResLoader::Instance().AddPath(folder);
+			}
+		}
+
+		std::string const plat_conf = ReadResource("PlatConf/" + platform + ".plat");
+
+		std::vector<EffectJob> jobs(fxml_names.size());
+		std::vector<uint32_t> dirty_jobs;
+		for (size_t i = 0; i < fxml_names.size(); ++ i)
+		{
+			EffectJob& job = jobs[i];
+			job.fxml_name = fxml_names[i];
+
+			filesystem::path const fxml_path(job.fxml_name);
+			filesystem::path const kfx_name(fxml_path.stem().string() + ".kfx");
+			job.kfx_path = fxml_path.parent_path() / kfx_name;
+			job.target_kfx_path = target_folder.empty() ? job.kfx_path : target_folder / kfx_name;
+
+			CollectIncludes(job.fxml_name, job.include_names);
+			job.digest = InputDigest(plat_conf, job);
+
+			job.built = manifest.UpToDate(job.fxml_name, job.digest) && filesystem::exists(job.target_kfx_path);
+			if (job.built)
+			{
+				cout << "Up to date: " << job.fxml_name << endl;
+			}
+			else
+			{
+				dirty_jobs.push_back(static_cast<uint32_t>(i));
+			}
+		}
+
+		if (!dirty_jobs.empty())
+		{
+			std::atomic<uint32_t> num_done(0);
+			std::mutex output_mutex;
+
+			CPUInfo cpu;
+			uint32_t const num_threads = std::min(static_cast<uint32_t>(cpu.NumHWThreads()),
+				static_cast<uint32_t>(dirty_jobs.size()));
+			thread_pool tp(1, num_threads);
+			parallel_for(tp, num_threads, static_cast<uint32_t>(dirty_jobs.size()), [&](uint32_t i)
+				{
+					EffectJob& job = jobs[dirty_jobs[i]];
+
+					// A broken effect fails its own job, the others are still built
+					std::string error;
+					try
+					{
+						// An old kfx must not look like the result of this build
+						if (filesystem::exists(job.kfx_path))
+						{
+							filesystem::remove(job.kfx_path);
+						}
+
+						{
+							Offline::RenderEffect effect(caps);
+							effect.Load(job.fxml_name);
+						}
+
+						job.built = filesystem::exists(job.kfx_path);
+						if (job.built && (job.target_kfx_path != job.kfx_path))
+						{
+							CopyKfx(job.kfx_path, job.target_kfx_path);
+						}
+					}
+					catch (std::exception const & e)
+					{
+						job.built = false;
+						error = e.what();
+					}
+					catch (...)
+					{
+						job.built = false;
+						error = "Unknown error";
+					}
+
+					uint32_t const done = ++ num_done;
+					std::lock_guard<std::mutex> lock(output_mutex);
+					cout << "[" << done << "/" << dirty_jobs.size() << "] " << (job.built ? "" : "Failed: ")
+						<< job.fxml_name;
+					if (!error.empty())
+					{
+						cout << " (" << error << ")";
+					}
+					cout << endl;
+				});
+		}
+
+		// Failed effects are built again next time. Entries of effects not in this batch are kept.
+		uint32_t num_failed = 0;
+		for (auto const & job : jobs)
+		{
+			if (job.built)
+			{
+				manifest.Built(job.fxml_name, job.digest, job.include_names);
+			}
+			else
+			{
+				manifest.Failed(job.fxml_name);
+				++ num_failed;
+			}
+		}
+		manifest.Save();
+		cout << dirty_jobs.size() - num_failed << " compiled, " << jobs.size() - dirty_jobs.size() << " up to date, "
+			<< num_failed << " failed. " << Offline::ShaderObject::NumCompiledShaders() << " shaders compiled, "
+			<< Offline::ShaderObject::NumReusedShaders() << " reused." << endl;
+
+		return (0 == num_failed) ? 0 : 1;
+	}
+}
+
 int main(int argc, char* argv[])
 {
-	if (argc < 2)
+	if (argc < 3)
 	{
 		cout << "Usage: FXMLJIT pc_dx11|pc_dx10|pc_dx9|win_tegra3|pc_gl4|pc_gl3|pc_gl2|android_tegra3|ios xxx.fxml [target folder]" << endl;
+		cout << "       FXMLJIT platform -batch dir|list.txt [target folder]" << endl;
+		cout << "\tIn batch mode, effects with the same inputs as in the last build, including the included files, are skipped."
+			<< endl;
 		return 1;
 	}
 
@@ -196,6 +467,27 @@ int main(int argc, char* argv[])
 
 	Offline::OfflineRenderDeviceCaps caps = LoadPlatformConfig(platform);
 
+	if ("-batch" == std::string(argv[2]))
+	{
+		if (argc < 4)
+		{
+			cout << "No batch given." << endl;
+			return 1;
+		}
+
+		filesystem::path batch_target_folder;
+		if (argc >= 5)
+		{
+			batch_target_folder = argv[4];
+		}
+
+		int const ret = CompileBatch(platform, caps, argv[3], batch_target_folder);
+
+		Context::Destroy();
+
+		return ret;
+	}
+
 	std::string fxml_name(argv[2]);
 	filesystem::path fxml_path(fxml_name);
 	std::string const base_name = fxml_path.stem().string();
@@ -250,12 +542,7 @@ int main(int argc, char* argv[])
 	}
 	if (!target_folder.empty())
 	{
-		filesystem::copy_file(kfx_path, target_folder / kfx_name,
-#if defined(KLAYGE_CXX17_LIBRARY_FILESYSTEM_SUPPORT) || defined(KLAYGE_TS_LIBRARY_FILESYSTEM_SUPPORT)
-			filesystem::copy_options::overwrite_existing);
-#else
-			filesystem::copy_option::overwrite_if_exists);
-#endif
+		CopyKfx(kfx_path, target_folder / kfx_name);
 		kfx_path = target_folder / kfx_name;
 	}
 
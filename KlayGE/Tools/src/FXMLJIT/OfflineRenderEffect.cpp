@@ -62,6 +62,8 @@ namespace
 	using namespace KlayGE;
 	using namespace KlayGE::Offline;
 
+	// The same as in KlayGE/RenderEffect.hpp, which can't be included with the offline classes of the same names.
+	// FXMLJITTest checks the written kfx against it.
 	uint32_t const KFX_VERSION = 0x0110;
 
 	std::mutex singleton_mutex;
@@ -33,11 +33,16 @@
 #include <KFL/Util.hpp>
 #include <KlayGE/ResLoader.hpp>
 
+#include <atomic>
 #include <string>
 #include <vector>
 #include <map>
+#include <future>
+#include <mutex>
 #include <sstream>
 #include <fstream>
+#include <thread>
+#include <unordered_map>
 
 #include <boost/lexical_cast.hpp>
 
@@ -138,7 +143,10 @@ namespace
 			}
 			return hr;
 #else
-			std::string mark = boost::lexical_cast<std::string>(static_cast<void const *>(src_data.c_str()));
+			// Effects are compiled on several threads, so the thread is a part of the file names
+			std::ostringstream mark_ss;
+			mark_ss << static_cast<void const *>(src_data.c_str()) << '_' << std::this_thread::get_id();
+			std::string const mark = mark_ss.str();
 			std::string compile_input_file = entry_point + mark + "Input.tmp";
 			std::string compile_output_file = entry_point + mark + "Output.tmp";
 
@@ -176,15 +184,14 @@ namespace
 #ifdef KLAYGE_PLATFORM_WINDOWS
 			ss << d3dcompiler_wrapper_name << ".exe";
 #else
-			static bool first = true;
-			if (first)
-			{
-				ss << WINE_PATH << "wineserver -p";
-				system(ss.str().c_str());
-				// We should hold on a persistant wineserver, or XCode will lost connection after wineserver instance close and wine may not be able to find '.exe.so' file
-				first = false;
-				ss.str(std::string());
-			}
+			static std::once_flag wineserver_flag;
+			std::call_once(wineserver_flag, [&ss]
+				{
+					ss << WINE_PATH << "wineserver -p";
+					system(ss.str().c_str());
+					// We should hold on a persistant wineserver, or XCode will lost connection after wineserver instance close and wine may not be able to find '.exe.so' file
+					ss.str(std::string());
+				});
 			d3dcompiler_wrapper_name += ".exe.so";
 			std::string wrapper_path = ResLoader::Instance().Locate(d3dcompiler_wrapper_name);
 			ss << WINE_PATH << "wine " << wrapper_path;
@@ -235,6 +242,34 @@ namespace
 #endif
 		}
 
+		// The source after the preprocessor, or an empty string if it's not available
+		std::string D3DPreprocess(std::string const & src_data, D3D_SHADER_MACRO const * defines) const
+		{
+#ifdef CALL_D3DCOMPILER_DIRECTLY
+			std::string ret;
+			ID3DBlob* text_blob = nullptr;
+			ID3DBlob* error_msgs_blob = nullptr;
+			DynamicD3DPreprocess_(src_data.c_str(), static_cast<UINT>(src_data.size()), nullptr, defines, nullptr,
+				&text_blob, &error_msgs_blob);
+			if (text_blob)
+			{
+				char const * p = static_cast<char const *>(text_blob->GetBufferPointer());
+				ret.assign(p, p + text_blob->GetBufferSize());
+				text_blob->Release();
+			}
+			if (error_msgs_blob)
+			{
+				error_msgs_blob->Release();
+			}
+			return ret;
+#else
+			// It would take another process, as expensive as compiling
+			KFL_UNUSED(src_data);
+			KFL_UNUSED(defines);
+			return std::string();
+#endif
+		}
+
 		HRESULT D3DReflect(std::vector<uint8_t> const & shader_code, void** reflector)
 		{
 #ifdef CALL_D3DCOMPILER_DIRECTLY
@@ -278,6 +313,7 @@ namespace
 			KLAYGE_ASSUME(mod_d3dcompiler_ != nullptr);
 
 			DynamicD3DCompile_ = reinterpret_cast<pD3DCompile>(::GetProcAddress(mod_d3dcompiler_, "D3DCompile"));
+			DynamicD3DPreprocess_ = reinterpret_cast<pD3DPreprocess>(::GetProcAddress(mod_d3dcompiler_, "D3DPreprocess"));
 			DynamicD3DReflect_ = reinterpret_cast<D3DReflectFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DReflect"));
 			DynamicD3DStripShader_ = reinterpret_cast<D3DStripShaderFunc>(::GetProcAddress(mod_d3dcompiler_, "D3DStripShader"));
 #endif
@@ -291,10 +327,101 @@ namespace
 
 		HMODULE mod_d3dcompiler_;
 		pD3DCompile DynamicD3DCompile_;
+		pD3DPreprocess DynamicD3DPreprocess_;
 		D3DReflectFunc DynamicD3DReflect_;
 		D3DStripShaderFunc DynamicD3DStripShader_;
 #endif
 	};
+
+	struct CompiledShader
+	{
+		std::vector<uint8_t> code;
+		std::string err_msg;
+	};
+
+	// Effects include the same files and often compile the same shader with the same macros. The first request for a key
+	// compiles, the others get its result, waiting for it if the compile is still running on another thread.
+	class CompiledShaderCache
+	{
+	public:
+		static CompiledShaderCache& Instance()
+		{
+			static CompiledShaderCache cache;
+			return cache;
+		}
+
+		// The same text gets the same id. The texts are compared in full, the ids keep the keys short.
+		uint32_t TextId(std::string const & text)
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			return texts_.emplace(text, static_cast<uint32_t>(texts_.size())).first->second;
+		}
+
+		template <typename CompileFunc>
+		CompiledShader const & Compile(std::string const & key, CompileFunc compile)
+		{
+			std::promise<CompiledShader> promise;
+			std::shared_future<CompiledShader> future;
+			bool compiled_here;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				auto iter = shaders_.find(key);
+				compiled_here = (iter == shaders_.end());
+				if (compiled_here)
+				{
+					future = promise.get_future().share();
+					shaders_.emplace(key, future);
+				}
+				else
+				{
+					future = iter->second;
+				}
+			}
+
+			if (compiled_here)
+			{
+				try
+				{
+					promise.set_value(compile());
+				}
+				catch (...)
+				{
+					promise.set_exception(std::current_exception());
+				}
+				++ num_compiled_;
+			}
+			else
+			{
+				++ num_reused_;
+			}
+
+			// The shared state is owned by the map too, so the reference stays valid
+			return future.get();
+		}
+
+		uint32_t NumCompiled() const
+		{
+			return num_compiled_;
+		}
+		uint32_t NumReused() const
+		{
+			return num_reused_;
+		}
+
+	private:
+		CompiledShaderCache()
+			: num_compiled_(0), num_reused_(0)
+		{
+		}
+
+	private:
+		std::mutex mutex_;
+		std::unordered_map<std::string, uint32_t> texts_;
+		std::unordered_map<std::string, std::shared_future<CompiledShader>> shaders_;
+
+		std::atomic<uint32_t> num_compiled_;
+		std::atomic<uint32_t> num_reused_;
+	};
 }
 
 namespace KlayGE
@@ -416,14 +543,47 @@ namespace KlayGE
 				macros.push_back(macro);
 			}
 
+			size_t const num_macros = macros.size();
 			{
 				D3D_SHADER_MACRO macro_end = { nullptr, nullptr };
 				macros.push_back(macro_end);
 			}
 
-			D3DCompilerLoader::Instance().D3DCompile(hlsl_shader_text, &macros[0],
-				func_name, shader_profile,
-				flags, 0, code, err_msg);
+			// Everything D3DCompile sees. The source after the preprocessor only has what these macros enable, so
+			// effects sharing a shader share it, whatever else they have. Without a preprocessor it's the effect's
+			// text. Either is in by its id.
+			std::string key;
+			{
+				std::string const preprocessed = D3DCompilerLoader::Instance().D3DPreprocess(hlsl_shader_text, &macros[0]);
+				uint32_t const text_id = CompiledShaderCache::Instance().TextId(
+					preprocessed.empty() ? hlsl_shader_text : preprocessed);
+				key.append(reinterpret_cast<char const *>(&text_id), sizeof(text_id));
+				for (size_t i = 0; i < num_macros; ++ i)
+				{
+					key += macros[i].Name;
+					key.push_back('\0');
+					key += macros[i].Definition;
+					key.push_back('\0');
+				}
+				key += func_name;
+				key.push_back('\0');
+				key += shader_profile;
+				key.push_back('\0');
+				key.append(reinterpret_cast<char const *>(&flags), sizeof(flags));
+			}
+
+			CompiledShader const & compiled = CompiledShaderCache::Instance().Compile(key,
+				[&hlsl_shader_text, &macros, func_name, shader_profile, flags]
+				{
+					CompiledShader ret;
+					D3DCompilerLoader::Instance().D3DCompile(hlsl_shader_text, &macros[0],
+						func_name, shader_profile,
+						flags, 0, ret.code, ret.err_msg);
+					return ret;
+				});
+			// Warnings and errors are replayed for every effect using the shader, so the log of each one is complete
+			code = compiled.code;
+			err_msg = compiled.err_msg;
 			if (!err_msg.empty())
 			{
 				LogError("Error when compiling %s:", func_name);
@@ -514,6 +674,16 @@ namespace KlayGE
 			return code;
 		}
 
+		uint32_t ShaderObject::NumCompiledShaders()
+		{
+			return CompiledShaderCache::Instance().NumCompiled();
+		}
+
+		uint32_t ShaderObject::NumReusedShaders()
+		{
+			return CompiledShaderCache::Instance().NumReused();
+		}
+
 		void ShaderObject::ReflectDXBC(std::vector<uint8_t> const & code, void** reflector)
 		{
 			D3DCompilerLoader::Instance().D3DReflect(code, reflector);
@@ -186,6 +186,10 @@ namespace KlayGE
 				return cs_block_size_z_;
 			}
 
+			// Compiled shaders are shared by content between all effects of the process
+			static uint32_t NumCompiledShaders();
+			static uint32_t NumReusedShaders();
+
 		protected:
 			std::vector<uint8_t> CompileToDXBC(ShaderType type, RenderEffect const & effect,
 				RenderTechnique const & tech, RenderPass const & pass,
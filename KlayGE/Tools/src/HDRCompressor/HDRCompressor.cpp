@@ -14,6 +14,8 @@
 
 #include <boost/assert.hpp>
 
+#include "TexelWorkers.hpp"
+
 using namespace std;
 
 namespace
@@ -40,7 +42,8 @@ namespace
 		return y;
 	}
 
-	void CompressHDRSubresource(ElementInitData& y_data, ElementInitData& c_data, std::vector<uint8_t>& y_data_block, std::vector<uint8_t>& c_data_block,
+	void CompressHDRSubresource(TexelWorkers& workers, ElementInitData& y_data, ElementInitData& c_data,
+		std::vector<uint8_t>& y_data_block, std::vector<uint8_t>& c_data_block,
 		ElementInitData const & hdr_data, ElementFormat y_format, ElementFormat c_format)
 	{
 		float const log2 = log(2.0f);
@@ -58,9 +61,7 @@ namespace
 		{
 			uint16_t* y_dst = reinterpret_cast<uint16_t*>(&y_data_block[0]);
 
-			for (uint32_t y = 0; y < height; ++ y)
-			{
-				for (uint32_t x = 0; x < width; ++ x)
+			workers.ForEachTexel(width, height, [hdr_src, y_dst, width, log2](uint32_t x, uint32_t y)
 				{
 					float R = hdr_src[(y * width + x) * 4 + 0];
 					float G = hdr_src[(y * width + x) * 4 + 1];
@@ -70,16 +71,13 @@ namespace
 					float log_y = log(Y) / log2 + 16;
 
 					y_dst[y * width + x] = static_cast<uint16_t>(MathLib::clamp<uint32_t>(static_cast<uint32_t>(log_y * 2048), 0, 65535));
-				}
-			}
+				});
 		}
 		else
 		{
 			half* y_dst = reinterpret_cast<half*>(&y_data_block[0]);
 
-			for (uint32_t y = 0; y < height; ++ y)
-			{
-				for (uint32_t x = 0; x < width; ++ x)
+			workers.ForEachTexel(width, height, [hdr_src, y_dst, width, log2](uint32_t x, uint32_t y)
 				{
 					float R = hdr_src[(y * width + x) * 4 + 0];
 					float G = hdr_src[(y * width + x) * 4 + 1];
@@ -89,8 +87,7 @@ namespace
 					float log_y = log(Y) / log2 + 16;
 
 					y_dst[y * width + x] = half(log_y * 2048 / 65535);
-				}
-			}
+				});
 		}
 
 		uint32_t c_width = std::max(width / 2, 1U);
@@ -100,15 +97,20 @@ namespace
 		c_data.slice_pitch = c_data.row_pitch * (c_height + 3) / 4;
 		c_data_block.resize(c_data.slice_pitch);
 		c_data.data = &c_data_block[0];
-		uint8_t* c_dst = &c_data_block[0];
-
-		TexCompressionBC3 bc3_codec;
-		TexCompressionBC4 bc4_codec;
+		uint8_t* c_data_dst = &c_data_block[0];
+		uint32_t const c_row_pitch = c_data.row_pitch;
 
-		for (uint32_t y_base = 0; y_base < c_height; y_base += 4)
-		{
-			for (uint32_t x_base = 0; x_base < c_width; x_base += 4)
+		// Codecs are cheap to make, one per block keeps the threads apart
+		workers.ForEachBlock(c_width, c_height, 4, 4, [hdr_src, c_data_dst, c_row_pitch, width, height, c_format](uint32_t block_x,
+			uint32_t block_y)
 			{
+				uint32_t const x_base = block_x * 4;
+				uint32_t const y_base = block_y * 4;
+				uint8_t* c_dst = c_data_dst + block_y * c_row_pitch + block_x * 16;
+
+				TexCompressionBC3 bc3_codec;
+				TexCompressionBC4 bc4_codec;
+
 				uint8_t uncom_u[16];
 				uint8_t uncom_v[16];
 				for (int y = 0; y < 4; ++ y)
@@ -150,7 +152,6 @@ namespace
 					bc4_codec.EncodeBlock(&com_bc5.green, uncom_v, TCM_Quality);
 
 					std::memcpy(c_dst, &com_bc5, sizeof(com_bc5));
-					c_dst += sizeof(com_bc5);
 				}
 				else
 				{
@@ -167,10 +168,8 @@ namespace
 					bc3_codec.EncodeBlock(&com_bc3, uncom_argb, TCM_Quality);
 
 					std::memcpy(c_dst, &com_bc3, sizeof(com_bc3));
-					c_dst += sizeof(com_bc3);
 				}
-			}
-		}
+			});
 	}
 
 	void DecompressHDRSubresource(ElementInitData& hdr_data, std::vector<uint8_t>& hdr_data_block, ElementInitData const & y_data, ElementInitData const & c_data,
@@ -362,13 +361,15 @@ namespace
 			-- in_num_mipmaps;
 		}
 
+		TexelWorkers workers;
+
 		std::vector<ElementInitData> y_data(in_data.size());
 		std::vector<ElementInitData> c_data(in_data.size());
 		std::vector<std::vector<uint8_t>> y_data_block(in_data.size());
 		std::vector<std::vector<uint8_t>> c_data_block(in_data.size());
 		for (size_t i = 0; i < in_data.size(); ++ i)
 		{
-			CompressHDRSubresource(y_data[i], c_data[i], y_data_block[i], c_data_block[i], in_data[i], y_format, c_format);
+			CompressHDRSubresource(workers, y_data[i], c_data[i], y_data_block[i], c_data_block[i], in_data[i], y_format, c_format);
 		}
 
 		SaveTexture(out_y_file, in_type, in_width, in_height, in_depth, in_num_mipmaps, in_array_size, y_format, y_data);
@@ -382,20 +383,25 @@ namespace
 		}
 		SaveTexture(out_c_file, in_type, c_width, c_height, in_depth, in_num_mipmaps, in_array_size, c_format, c_data);
 
+		// Subresources are restored in parallel, the error is summed in the same order as before
+		std::vector<ElementInitData> restored_data(in_data.size());
+		std::vector<std::vector<uint8_t>> restored_data_block(in_data.size());
+		workers.ForEachSubresource(static_cast<uint32_t>(in_data.size()),
+			[&restored_data, &restored_data_block, &y_data, &c_data, y_format, c_format](uint32_t i)
+			{
+				DecompressHDRSubresource(restored_data[i], restored_data_block[i], y_data[i], c_data[i], y_format, c_format);
+			});
+
 		float mse = 0;
 		int n = 0;
 		{
 			for (size_t i = 0; i < in_data.size(); ++ i)
 			{
-				ElementInitData restored_data;
-				std::vector<uint8_t> restored_data_block;
-				DecompressHDRSubresource(restored_data, restored_data_block, y_data[i], c_data[i], y_format, c_format);
-
 				uint32_t width = in_data[i].row_pitch / (sizeof(float) * 4);
 				uint32_t height = in_data[i].slice_pitch / in_data[i].row_pitch;
 
 				float const * org = static_cast<float const *>(in_data[i].data);
-				float const * restored = static_cast<float const *>(restored_data.data);
+				float const * restored = static_cast<float const *>(restored_data[i].data);
 
 				for (uint32_t y = 0; y < height; ++ y)
 				{
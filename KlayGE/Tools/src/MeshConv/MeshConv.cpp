@@ -7,6 +7,9 @@
 #include <KlayGE/Renderable.hpp>
 #include <KlayGE/Mesh.hpp>
 #include <KlayGE/RenderMaterial.hpp>
+#include <KFL/CpuInfo.hpp>
+#include <KFL/Thread.hpp>
+#include <KFL/Timer.hpp>
 #include <KFL/CXX17/filesystem.hpp>
 
 #include <iostream>
@@ -41,6 +44,8 @@
 
 #include <MeshMLLib/MeshMLLib.hpp>
 
+#include "KeyframeResampler.hpp"
+
 using namespace std;
 using namespace KlayGE;
 
@@ -102,7 +107,17 @@ namespace
 
 	typedef std::map<std::string, Joint> JointsMap;
 
-	void RecursiveTransformMesh(MeshMLObj& meshml_obj, float4x4 const & parent_mat, aiNode const * node, std::vector<Mesh> const & meshes)
+	// A mesh referenced by a node, in world space
+	struct MeshInstance
+	{
+		int mesh_id;
+		uint32_t mesh_index;
+		float4x4 trans_mat;
+		Quaternion trans_quat;
+	};
+
+	void RecursiveAllocMesh(MeshMLObj& meshml_obj, float4x4 const & parent_mat, aiNode const * node, std::vector<Mesh> const & meshes,
+		std::vector<MeshInstance>& instances)
 	{
 		auto const trans_mat = MathLib::transpose(float4x4(&node->mTransformation.a1)) * parent_mat;
 		auto const trans_quat = MathLib::to_quaternion(trans_mat);
@@ -114,51 +129,70 @@ namespace
 			int mesh_id = meshml_obj.AllocMesh();
 			meshml_obj.SetMesh(mesh_id, mesh.mtl_id, mesh.name);
 
-			for (unsigned int ti = 0; ti < mesh.indices.size(); ti += 3)
-			{
-				int tri_id = meshml_obj.AllocTriangle(mesh_id);
-				meshml_obj.SetTriangle(mesh_id, tri_id, mesh.indices[ti + 0],
-					mesh.indices[ti + 1], mesh.indices[ti + 2]);
-			}
+			instances.push_back({ mesh_id, node->mMeshes[n], trans_mat, trans_quat });
+		}
+
+		for (unsigned int i = 0; i < node->mNumChildren; ++ i)
+		{
+			RecursiveAllocMesh(meshml_obj, trans_mat, node->mChildren[i], meshes, instances);
+		}
+	}
+
+	// All meshes are allocated first. After that, filling a mesh only changes that mesh in meshml_obj, so the meshes are
+	// filled in parallel.
+	void TransformMeshes(MeshMLObj& meshml_obj, aiNode const * root, std::vector<Mesh> const & meshes,
+		thread_pool& tp, uint32_t num_threads)
+	{
+		std::vector<MeshInstance> instances;
+		RecursiveAllocMesh(meshml_obj, float4x4::Identity(), root, meshes, instances);
 
-			for (unsigned int vi = 0; vi < mesh.positions.size(); ++ vi)
+		parallel_for(tp, num_threads, static_cast<uint32_t>(instances.size()), [&meshml_obj, &meshes, &instances](uint32_t ii)
 			{
-				int vertex_id = meshml_obj.AllocVertex(mesh_id);
+				int const mesh_id = instances[ii].mesh_id;
+				auto const & mesh = meshes[instances[ii].mesh_index];
+				auto const & trans_mat = instances[ii].trans_mat;
+				auto const & trans_quat = instances[ii].trans_quat;
 
-				std::vector<float3> texcoords;
-				for (unsigned int tci = 0; tci < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++ tci)
+				for (unsigned int ti = 0; ti < mesh.indices.size(); ti += 3)
 				{
-					if (mesh.has_texcoord[tci])
-					{
-						texcoords.push_back(mesh.texcoords[tci][vi]);
-					}
+					int tri_id = meshml_obj.AllocTriangle(mesh_id);
+					meshml_obj.SetTriangle(mesh_id, tri_id, mesh.indices[ti + 0],
+						mesh.indices[ti + 1], mesh.indices[ti + 2]);
 				}
 
-				auto const pos = MathLib::transform_coord(mesh.positions[vi], trans_mat);
-				if (mesh.has_tangent_frame)
+				for (unsigned int vi = 0; vi < mesh.positions.size(); ++ vi)
 				{
-					auto const quat = mesh.tangent_quats[vi] * trans_quat;
-					meshml_obj.SetVertex(mesh_id, vertex_id, pos, quat, 2, texcoords);
+					int vertex_id = meshml_obj.AllocVertex(mesh_id);
+
+					std::vector<float3> texcoords;
+					for (unsigned int tci = 0; tci < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++ tci)
+					{
+						if (mesh.has_texcoord[tci])
+						{
+							texcoords.push_back(mesh.texcoords[tci][vi]);
+						}
+					}
+
+					auto const pos = MathLib::transform_coord(mesh.positions[vi], trans_mat);
+					if (mesh.has_tangent_frame)
+					{
+						auto const quat = mesh.tangent_quats[vi] * trans_quat;
+						meshml_obj.SetVertex(mesh_id, vertex_id, pos, quat, 2, texcoords);
+					}
+					else
+					{
+						auto const normal = MathLib::transform_normal(mesh.normals[vi], trans_mat);
+						meshml_obj.SetVertex(mesh_id, vertex_id, pos, normal, 2, texcoords);
+					}
 				}
-				else
+
+				for (unsigned int wi = 0; wi < mesh.joint_binding.size(); ++wi)
 				{
-					auto const normal = MathLib::transform_normal(mesh.normals[vi], trans_mat);
-					meshml_obj.SetVertex(mesh_id, vertex_id, pos, normal, 2, texcoords);
+					auto binding = mesh.joint_binding[wi];
+					int bind_id = meshml_obj.AllocJointBinding(mesh_id, binding.vertex_id);
+					meshml_obj.SetJointBinding(mesh_id, binding.vertex_id, bind_id, binding.joint_id, binding.weight);
 				}
-			}
-
-			for (unsigned int wi = 0; wi < mesh.joint_binding.size(); ++wi)
-			{
-				auto binding = mesh.joint_binding[wi];
-				int bind_id = meshml_obj.AllocJointBinding(mesh_id, binding.vertex_id);
-				meshml_obj.SetJointBinding(mesh_id, binding.vertex_id, bind_id, binding.joint_id, binding.weight);
-			}
-		}
-
-		for (unsigned int i = 0; i < node->mNumChildren; ++ i)
-		{
-			RecursiveTransformMesh(meshml_obj, trans_mat, node->mChildren[i], meshes);
-		}
+			});
 	}
 
 	void ConvertMaterials(MeshMLObj& meshml_obj, aiScene const * scene)
@@ -281,160 +315,169 @@ namespace
 		}
 	}
 
-	void BuildMeshData(std::vector<Mesh>& meshes, int& vertex_export_settings, JointsMap const& joint_nodes, aiScene const * scene, bool swap_yz, bool inverse_z)
+	// Meshes are independent, so each of them is built on its own thread
+	void BuildMeshData(std::vector<Mesh>& meshes, int& vertex_export_settings, JointsMap const& joint_nodes, aiScene const * scene, bool swap_yz, bool inverse_z,
+		thread_pool& tp, uint32_t num_threads)
 	{
-		vertex_export_settings = MeshMLObj::VES_None;
-		for (unsigned int mi = 0; mi < scene->mNumMeshes; ++ mi)
-		{
-			aiMesh const * mesh = scene->mMeshes[mi];
-
-			meshes[mi].mtl_id = mesh->mMaterialIndex;
-			meshes[mi].name = mesh->mName.C_Str();
-
-			auto& indices = meshes[mi].indices;
-			for (unsigned int fi = 0; fi < mesh->mNumFaces; ++ fi)
+		std::vector<int> mesh_settings(scene->mNumMeshes, MeshMLObj::VES_None);
+		parallel_for(tp, num_threads, scene->mNumMeshes,
+			[&meshes, &mesh_settings, &joint_nodes, scene, swap_yz, inverse_z](uint32_t mi)
 			{
-				BOOST_ASSERT(3 == mesh->mFaces[fi].mNumIndices);
+				aiMesh const * mesh = scene->mMeshes[mi];
 
-				indices.push_back(mesh->mFaces[fi].mIndices[0]);
-				indices.push_back(mesh->mFaces[fi].mIndices[1]);
-				indices.push_back(mesh->mFaces[fi].mIndices[2]);
-			}
+				meshes[mi].mtl_id = mesh->mMaterialIndex;
+				meshes[mi].name = mesh->mName.C_Str();
 
-			bool has_normal = (mesh->mNormals != nullptr);
-			bool has_tangent = (mesh->mTangents != nullptr);
-			bool has_binormal = (mesh->mBitangents != nullptr);
-			auto& has_texcoord = meshes[mi].has_texcoord;
-			uint32_t first_texcoord = AI_MAX_NUMBER_OF_TEXTURECOORDS;
-			for (unsigned int tci = 0; tci < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++ tci)
-			{
-				has_texcoord[tci] = (mesh->mTextureCoords[tci] != nullptr);
-				if (has_texcoord[tci] && (AI_MAX_NUMBER_OF_TEXTURECOORDS == first_texcoord))
+				auto& indices = meshes[mi].indices;
+				for (unsigned int fi = 0; fi < mesh->mNumFaces; ++ fi)
 				{
-					first_texcoord = tci;
+					BOOST_ASSERT(3 == mesh->mFaces[fi].mNumIndices);
+
+					indices.push_back(mesh->mFaces[fi].mIndices[0]);
+					indices.push_back(mesh->mFaces[fi].mIndices[1]);
+					indices.push_back(mesh->mFaces[fi].mIndices[2]);
 				}
-			}
 
-			auto& positions = meshes[mi].positions;
-			auto& normals = meshes[mi].normals;
-			std::vector<float3> tangents(mesh->mNumVertices);
-			std::vector<float3> binormals(mesh->mNumVertices);
-			auto& texcoords = meshes[mi].texcoords;
-			positions.resize(mesh->mNumVertices);
-			normals.resize(mesh->mNumVertices);
-			for (unsigned int tci = 0; tci < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++ tci)
-			{
-				texcoords[tci].resize(mesh->mNumVertices);
-			}
-			for (unsigned int vi = 0; vi < mesh->mNumVertices; ++ vi)
-			{
-				positions[vi] = float3(&mesh->mVertices[vi].x);
-				if (inverse_z)
+				bool has_normal = (mesh->mNormals != nullptr);
+				bool has_tangent = (mesh->mTangents != nullptr);
+				bool has_binormal = (mesh->mBitangents != nullptr);
+				auto& has_texcoord = meshes[mi].has_texcoord;
+				uint32_t first_texcoord = AI_MAX_NUMBER_OF_TEXTURECOORDS;
+				for (unsigned int tci = 0; tci < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++ tci)
 				{
-					positions[vi].z() = -positions[vi].z();
+					has_texcoord[tci] = (mesh->mTextureCoords[tci] != nullptr);
+					if (has_texcoord[tci] && (AI_MAX_NUMBER_OF_TEXTURECOORDS == first_texcoord))
+					{
+						first_texcoord = tci;
+					}
 				}
-				if (swap_yz)
+
+				auto& positions = meshes[mi].positions;
+				auto& normals = meshes[mi].normals;
+				std::vector<float3> tangents(mesh->mNumVertices);
+				std::vector<float3> binormals(mesh->mNumVertices);
+				auto& texcoords = meshes[mi].texcoords;
+				positions.resize(mesh->mNumVertices);
+				normals.resize(mesh->mNumVertices);
+				for (unsigned int tci = 0; tci < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++ tci)
 				{
-					std::swap(positions[vi].y(), positions[vi].z());
+					texcoords[tci].resize(mesh->mNumVertices);
 				}
-
-				if (has_normal)
+				for (unsigned int vi = 0; vi < mesh->mNumVertices; ++ vi)
 				{
-					normals[vi] = float3(&mesh->mNormals[vi].x);
+					positions[vi] = float3(&mesh->mVertices[vi].x);
 					if (inverse_z)
 					{
-						normals[vi].z() = -normals[vi].z();
+						positions[vi].z() = -positions[vi].z();
 					}
 					if (swap_yz)
 					{
-						std::swap(normals[vi].y(), normals[vi].z());
+						std::swap(positions[vi].y(), positions[vi].z());
 					}
-				}
-				if (has_tangent)
-				{
-					tangents[vi] = float3(&mesh->mTangents[vi].x);
-					if (inverse_z)
-					{
-						tangents[vi].z() = -tangents[vi].z();
-					}
-					if (swap_yz)
+
+					if (has_normal)
 					{
-						std::swap(tangents[vi].y(), tangents[vi].z());
+						normals[vi] = float3(&mesh->mNormals[vi].x);
+						if (inverse_z)
+						{
+							normals[vi].z() = -normals[vi].z();
+						}
+						if (swap_yz)
+						{
+							std::swap(normals[vi].y(), normals[vi].z());
+						}
 					}
-				}
-				if (has_binormal)
-				{
-					binormals[vi] = float3(&mesh->mBitangents[vi].x);
-					if (inverse_z)
+					if (has_tangent)
 					{
-						binormals[vi].z() = -binormals[vi].z();
+						tangents[vi] = float3(&mesh->mTangents[vi].x);
+						if (inverse_z)
+						{
+							tangents[vi].z() = -tangents[vi].z();
+						}
+						if (swap_yz)
+						{
+							std::swap(tangents[vi].y(), tangents[vi].z());
+						}
 					}
-					if (swap_yz)
+					if (has_binormal)
 					{
-						std::swap(binormals[vi].y(), binormals[vi].z());
+						binormals[vi] = float3(&mesh->mBitangents[vi].x);
+						if (inverse_z)
+						{
+							binormals[vi].z() = -binormals[vi].z();
+						}
+						if (swap_yz)
+						{
+							std::swap(binormals[vi].y(), binormals[vi].z());
+						}
 					}
-				}
 
-				for (unsigned int tci = 0; tci < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++ tci)
-				{
-					if (has_texcoord[tci])
+					for (unsigned int tci = 0; tci < AI_MAX_NUMBER_OF_TEXTURECOORDS; ++ tci)
 					{
-						BOOST_ASSERT(mesh->mTextureCoords[tci] != nullptr);
-						KLAYGE_ASSUME(mesh->mTextureCoords[tci] != nullptr);
+						if (has_texcoord[tci])
+						{
+							BOOST_ASSERT(mesh->mTextureCoords[tci] != nullptr);
+							KLAYGE_ASSUME(mesh->mTextureCoords[tci] != nullptr);
 
-						texcoords[tci][vi] = float3(&mesh->mTextureCoords[tci][vi].x);
+							texcoords[tci][vi] = float3(&mesh->mTextureCoords[tci][vi].x);
+						}
 					}
 				}
-			}
-
-			if (!has_normal)
-			{
-				MathLib::compute_normal(normals.begin(), indices.begin(), indices.end(), positions.begin(), positions.end());
 
-				has_normal = true;
-			}
+				if (!has_normal)
+				{
+					MathLib::compute_normal(normals.begin(), indices.begin(), indices.end(), positions.begin(), positions.end());
 
-			auto& tangent_quats = meshes[mi].tangent_quats;
-			tangent_quats.resize(mesh->mNumVertices);
-			if ((!has_tangent || !has_binormal) && (first_texcoord != AI_MAX_NUMBER_OF_TEXTURECOORDS))
-			{
-				MathLib::compute_tangent(tangents.begin(), binormals.begin(), indices.begin(), indices.end(),
-					positions.begin(), positions.end(), texcoords[first_texcoord].begin(), normals.begin());
+					has_normal = true;
+				}
 
-				for (size_t i = 0; i < positions.size(); ++ i)
+				auto& tangent_quats = meshes[mi].tangent_quats;
+				tangent_quats.resize(mesh->mNumVertices);
+				if ((!has_tangent || !has_binormal) && (first_texcoord != AI_MAX_NUMBER_OF_TEXTURECOORDS))
 				{
-					tangent_quats[i] = MathLib::to_quaternion(tangents[i], binormals[i], normals[i], 8);
-				}
+					MathLib::compute_tangent(tangents.begin(), binormals.begin(), indices.begin(), indices.end(),
+						positions.begin(), positions.end(), texcoords[first_texcoord].begin(), normals.begin());
 
-				has_tangent = true;
-			}
+					for (size_t i = 0; i < positions.size(); ++ i)
+					{
+						tangent_quats[i] = MathLib::to_quaternion(tangents[i], binormals[i], normals[i], 8);
+					}
 
-			meshes[mi].has_normal = has_normal;
-			meshes[mi].has_tangent_frame = has_tangent || has_binormal;
+					has_tangent = true;
+				}
 
-			if (has_tangent || has_binormal)
-			{
-				vertex_export_settings |= MeshMLObj::VES_TangentQuat;
-			}
-			if (first_texcoord != AI_MAX_NUMBER_OF_TEXTURECOORDS)
-			{
-				vertex_export_settings |= MeshMLObj::VES_Texcoord;
-			}
+				meshes[mi].has_normal = has_normal;
+				meshes[mi].has_tangent_frame = has_tangent || has_binormal;
 
-			for (unsigned int bi = 0; bi < mesh->mNumBones; ++ bi)
-			{
-				aiBone* bone = mesh->mBones[bi];
-				auto iter = joint_nodes.find(bone->mName.C_Str());
-				BOOST_ASSERT_MSG(iter != joint_nodes.end(), "Joint not found!");
+				if (has_tangent || has_binormal)
+				{
+					mesh_settings[mi] |= MeshMLObj::VES_TangentQuat;
+				}
+				if (first_texcoord != AI_MAX_NUMBER_OF_TEXTURECOORDS)
+				{
+					mesh_settings[mi] |= MeshMLObj::VES_Texcoord;
+				}
 
-				int joint_id = iter->second.id;
-				for (unsigned int wi = 0; wi < bone->mNumWeights; ++ wi)
+				for (unsigned int bi = 0; bi < mesh->mNumBones; ++ bi)
 				{
-					int vertex_id = bone->mWeights[wi].mVertexId;
-					float weight = bone->mWeights[wi].mWeight;
-					meshes[mi].joint_binding.push_back({joint_id, vertex_id, weight});
+					aiBone* bone = mesh->mBones[bi];
+					auto iter = joint_nodes.find(bone->mName.C_Str());
+					BOOST_ASSERT_MSG(iter != joint_nodes.end(), "Joint not found!");
+
+					int joint_id = iter->second.id;
+					for (unsigned int wi = 0; wi < bone->mNumWeights; ++ wi)
+					{
+						int vertex_id = bone->mWeights[wi].mVertexId;
+						float weight = bone->mWeights[wi].mWeight;
+						meshes[mi].joint_binding.push_back({joint_id, vertex_id, weight});
+					}
 				}
-			}
+			});
+
+		vertex_export_settings = MeshMLObj::VES_None;
+		for (auto const settings : mesh_settings)
+		{
+			vertex_export_settings |= settings;
 		}
 
 		for (unsigned int mi = 0; mi < scene->mNumMeshes; ++ mi)
@@ -528,23 +571,6 @@ namespace
 		alloc_joints(scene->mRootNode, -1);
 	}
 
-	struct ResampledTransform
-	{
-		int frame;
-		Quaternion bind_real;
-		Quaternion bind_dual;
-		float scale;
-	};
-
-	typedef std::vector<ResampledTransform> JointResampledKeyframe;
-
-	struct JointKeyframe
-	{
-		std::vector<std::pair<float, float3>> pos;
-		std::vector<std::pair<float, Quaternion>> quats;
-		std::vector<std::pair<float, float3>> scale;
-	};
-
 	struct Animation
 	{
 		std::string name;
@@ -552,118 +578,48 @@ namespace
 		std::map<int/*joint_id*/, JointResampledKeyframe> resampled_frames;
 	};
 
-	template <typename T>
-	float GetInterpTime(std::vector<T> const & vec, float time, size_t& itime_lower, size_t& itime_upper)
+	// Channels are resampled on all threads, and put into the animations in their order afterwards
+	void BuildActions(MeshMLObj& meshml_obj, JointsMap const & joint_nodes, aiScene const * scene,
+		thread_pool& tp, uint32_t num_threads)
 	{
-		BOOST_ASSERT(!vec.empty());
-
-		if (vec.size() == 1)
-		{
-			itime_lower = 0;
-			itime_upper = 0;
-			return 0;
-		}
-
-		// use @itime_upper as a hint to speed up find
-		size_t vec_size = vec.size();
-		size_t i = 0;
-		for (i = itime_upper; i < vec_size; ++i)
-		{
-			if (vec[i].first >= time)
-			{
-				break;
-			}
-		}
-
-		if (i == 0)
-		{
-			itime_lower = 0;
-			itime_upper = 1;
-		}
-		else if (i >= vec.size() - 1)
-		{
-			itime_lower = vec_size - 2;
-			itime_upper = vec_size - 1;
-		}
-		else
-		{
-			itime_lower = i -1;
-			itime_upper = i;
-		}
-
-		float diff = vec[itime_upper].first - vec[itime_lower].first;
-		return MathLib::clamp((diff == 0) ? 0 : (time - vec[itime_lower].first) / diff, 0.0f, 1.0f);
-	}
-
-	void ResampleJointTransform(int start_frame, int end_frame, float fps_scale, JointKeyframe const & okf, JointResampledKeyframe& rkf)
-	{
-		size_t i_pos = 0;
-		size_t i_rot = 0;
-		size_t i_scale = 0;
-		for (int i = start_frame; i < end_frame; ++ i)
-		{
-			float time = i * fps_scale;
-			size_t prev_i = 0;
-			float fraction = 0.0f;
-			float3 scale_resampled(1, 1, 1);
-			Quaternion bind_real_resampled(0, 0, 0, 1);
-			Quaternion bind_dual_resampled(0, 0, 0, 0);
-
-			if (!okf.scale.empty())
-			{
-				fraction = GetInterpTime(okf.scale, time, prev_i, i_scale);
-				scale_resampled = MathLib::lerp(okf.scale[prev_i].second, okf.scale[i_scale].second, fraction);
-			}
-			if (!okf.quats.empty())
-			{
-				fraction = GetInterpTime(okf.quats, time, prev_i, i_rot);
-				bind_real_resampled = MathLib::slerp(okf.quats[prev_i].second, okf.quats[i_rot].second, fraction);
-			}
-			if (!okf.pos.empty())
-			{
-				fraction = GetInterpTime(okf.pos, time, prev_i, i_pos);
-
-				auto bind_dual_prev_i = MathLib::quat_trans_to_udq(okf.quats[prev_i].second, okf.pos[prev_i].second);
-				auto bind_dual_i_pos = MathLib::quat_trans_to_udq(okf.quats[i_rot].second, okf.pos[i_pos].second);
-
-				auto bind_dq_resampled = MathLib::sclerp(okf.quats[prev_i].second, bind_dual_prev_i,
-					okf.quats[i_rot].second, bind_dual_i_pos,
-					fraction);
-
-				bind_dual_resampled = bind_dq_resampled.second;
-			}
-
-			if (MathLib::SignBit(bind_real_resampled.w()) < 0)
-			{
-				bind_real_resampled = -bind_real_resampled;
-				bind_dual_resampled = -bind_dual_resampled;
-			}
-
-			rkf.push_back({i, bind_real_resampled, bind_dual_resampled, scale_resampled.x()});
-		}
-	}
-
-	void BuildActions(MeshMLObj& meshml_obj, JointsMap const & joint_nodes, aiScene const * scene)
-	{
-		std::vector<Animation> animations;
+		std::vector<Animation> animations(scene->mNumAnimations);
 
 		int const resample_fps = 25;
-		// for actions
+
+		std::vector<float> fps_scales(scene->mNumAnimations);
+		std::vector<std::pair<uint32_t, uint32_t>> channels;
 		for (unsigned int ianim = 0; ianim < scene->mNumAnimations; ++ ianim)
 		{
 			aiAnimation const * cur_anim = scene->mAnimations[ianim];
 			float duration = static_cast<float>(cur_anim->mDuration / cur_anim->mTicksPerSecond);
-			Animation anim;
+			Animation& anim = animations[ianim];
 			anim.name = cur_anim->mName.C_Str();
 			anim.frame_num = static_cast<int>(ceilf(duration * resample_fps));
 			if (anim.frame_num == 0)
 			{
 				anim.frame_num = 1;
 			}
+			fps_scales[ianim] = static_cast<float>(cur_anim->mTicksPerSecond / resample_fps);
 
-			// import joints animation
 			for (unsigned int ichannel = 0; ichannel < cur_anim->mNumChannels; ++ ichannel)
 			{
+				channels.emplace_back(ianim, ichannel);
+			}
+		}
+
+		std::vector<std::vector<std::pair<int, JointResampledKeyframe>>> resampled(scene->mNumAnimations);
+		for (unsigned int ianim = 0; ianim < scene->mNumAnimations; ++ ianim)
+		{
+			resampled[ianim].resize(scene->mAnimations[ianim]->mNumChannels, std::make_pair(-1, JointResampledKeyframe()));
+		}
+
+		// import joints animation
+		parallel_for(tp, num_threads, static_cast<uint32_t>(channels.size()),
+			[&animations, &joint_nodes, scene, &fps_scales, &channels, &resampled](uint32_t ci)
+			{
+				uint32_t const ianim = channels[ci].first;
+				uint32_t const ichannel = channels[ci].second;
+				aiAnimation const * cur_anim = scene->mAnimations[ianim];
 				aiNodeAnim const * cur_joint = cur_anim->mChannels[ichannel];
 				int joint_id = -1;
 				auto iter = joint_nodes.find(cur_joint->mNodeName.C_Str());
@@ -695,11 +651,20 @@ namespace
 					}
 
 					// resample
-					JointResampledKeyframe resampled_kf;
-					ResampleJointTransform(0, anim.frame_num, static_cast<float>(cur_anim->mTicksPerSecond / resample_fps),
-						kf, resampled_kf);
+					auto& channel_resampled = resampled[ianim][ichannel];
+					channel_resampled.first = joint_id;
+					ResampleJointTransform(0, animations[ianim].frame_num, fps_scales[ianim], kf, channel_resampled.second);
+				}
+			});
 
-					anim.resampled_frames[joint_id] = resampled_kf;
+		for (unsigned int ianim = 0; ianim < scene->mNumAnimations; ++ ianim)
+		{
+			Animation& anim = animations[ianim];
+			for (auto& channel_resampled : resampled[ianim])
+			{
+				if (channel_resampled.first > 0)
+				{
+					anim.resampled_frames[channel_resampled.first] = std::move(channel_resampled.second);
 				}
 			}
 
@@ -725,10 +690,8 @@ namespace
 					anim.resampled_frames[joint_id].push_back(default_tf);
 				}
 			}
-
-			animations.push_back(anim);
 		}
-		
+
 		int action_frame_offset = 0;
 		for (auto const & anim : animations)
 		{
@@ -757,8 +720,11 @@ namespace
 		meshml_obj.NumFrames(action_frame_offset);
 	}
 
-	bool ConvertScene(std::string const & in_name, std::string const & out_name, float scale, bool swap_yz, bool inverse_z)
+	bool ConvertScene(std::string const & in_name, std::string const & out_name, float scale, bool swap_yz, bool inverse_z,
+		bool fast_import, bool quiet)
 	{
+		Timer timer;
+
 		aiPropertyStore* props = aiCreatePropertyStore();
 		aiSetImportPropertyInteger(props, AI_CONFIG_IMPORT_TER_MAKE_UVS, 1);
 		aiSetImportPropertyFloat(props, AI_CONFIG_PP_GSN_MAX_SMOOTHING_ANGLE, 80);
@@ -767,17 +733,19 @@ namespace
 		aiSetImportPropertyInteger(props, AI_CONFIG_GLOB_MEASURE_TIME, 1);
 
 		unsigned int ppsteps = aiProcess_JoinIdenticalVertices // join identical vertices/ optimize indexing
-			| aiProcess_ValidateDataStructure // perform a full validation of the loader's output
 			| aiProcess_RemoveRedundantMaterials // remove redundant materials
-			| aiProcess_FindInstances; // search for instanced meshes and remove them by references to one master
-
-		aiScene const * scene = aiImportFileExWithProperties(in_name.c_str(),
-			ppsteps // configurable pp steps
-			| aiProcess_GenSmoothNormals // generate smooth normal vectors if not existing
 			| aiProcess_Triangulate // triangulate polygons with more than 3 edges
-			| aiProcess_ConvertToLeftHanded // convert everything to D3D left handed space
-			| aiProcess_FixInfacingNormals, // find normals facing inwards and inverts them
-			nullptr, props);
+			| aiProcess_ConvertToLeftHanded; // convert everything to D3D left handed space
+		if (!fast_import)
+		{
+			// Without them, missing normals come from BuildMeshData instead, without the smoothing angle
+			ppsteps |= aiProcess_ValidateDataStructure // perform a full validation of the loader's output
+				| aiProcess_FindInstances // search for instanced meshes and remove them by references to one master
+				| aiProcess_GenSmoothNormals // generate smooth normal vectors if not existing
+				| aiProcess_FixInfacingNormals; // find normals facing inwards and inverts them
+		}
+
+		aiScene const * scene = aiImportFileExWithProperties(in_name.c_str(), ppsteps, nullptr, props);
 
 		aiReleasePropertyStore(props);
 
@@ -787,6 +755,12 @@ namespace
 			return false;
 		}
 
+		double const import_time = timer.elapsed();
+		timer.restart();
+
+		uint32_t const num_threads = std::max(static_cast<uint32_t>(CPUInfo().NumHWThreads()), 1U);
+		thread_pool tp(1, num_threads);
+
 		MeshMLObj meshml_obj(scale);
 		ConvertMaterials(meshml_obj, scene);
 
@@ -795,12 +769,24 @@ namespace
 
 		int vertex_export_settings;
 		BuildJoints(meshml_obj, joint_nodes, scene);
-		BuildMeshData(meshes, vertex_export_settings, joint_nodes, scene, swap_yz, inverse_z);
-		RecursiveTransformMesh(meshml_obj, float4x4::Identity(), scene->mRootNode, meshes);
-		BuildActions(meshml_obj, joint_nodes, scene);
+		BuildMeshData(meshes, vertex_export_settings, joint_nodes, scene, swap_yz, inverse_z, tp, num_threads);
+		TransformMeshes(meshml_obj, scene->mRootNode, meshes, tp, num_threads);
+		BuildActions(meshml_obj, joint_nodes, scene, tp, num_threads);
+
+		double const process_time = timer.elapsed();
 
 		std::ofstream ofs(out_name.c_str());
-		meshml_obj.WriteMeshML(ofs, vertex_export_settings, 0);
+		meshml_obj.WriteMeshML(ofs, vertex_export_settings, MeshMLObj::UES_OptimizeMeshes);
+
+		if (!quiet)
+		{
+			cout << "Import: " << import_time << " s, processing: " << process_time << " s" << endl;
+			for (auto const & result : meshml_obj.MeshOptimizationResults())
+			{
+				cout << result.first << ": ACMR " << result.second.before.acmr << " -> " << result.second.after.acmr
+					<< ", ATVR " << result.second.before.atvr << " -> " << result.second.after.atvr << endl;
+			}
+		}
 
 		aiReleaseImport(scene);
 
@@ -815,6 +801,7 @@ int main(int argc, char* argv[])
 	float scale = 1;
 	bool swap_yz = false;
 	bool inverse_z = false;
+	bool fast_import = false;
 	bool quiet = false;
 
 	boost::program_options::options_description desc("Allowed options");
@@ -825,6 +812,7 @@ int main(int argc, char* argv[])
 		("scale,S", boost::program_options::value<float>(), "Scale.")
 		("swap-yz,W", "Swap Y and Z axis.")
 		("inverse-z,Z", "Inverse Z axis.")
+		("fast-import,F", "Skip assimp's validation, instancing and normal generation steps.")
 		("quiet,q", boost::program_options::value<bool>()->implicit_value(true), "Quiet mode.")
 		("version,v", "Version.");
 
@@ -839,7 +827,7 @@ int main(int argc, char* argv[])
 	}
 	if (vm.count("version") > 0)
 	{
-		cout << "KlayGE Mesh Converter, Version 1.0.0" << endl;
+		cout << "KlayGE Mesh Converter, Version 1.1.0" << endl;
 		return 1;
 	}
 	if (vm.count("input-path") > 0)
@@ -867,6 +855,10 @@ int main(int argc, char* argv[])
 	{
 		inverse_z = true;
 	}
+	if (vm.count("fast-import") > 0)
+	{
+		fast_import = true;
+	}
 	if (vm.count("quiet") > 0)
 	{
 		quiet = vm["quiet"].as<bool>();
@@ -889,7 +881,7 @@ int main(int argc, char* argv[])
 
 	std::string output_name = (target_folder / base_name).string() + ".meshml";
 
-	bool succ = ConvertScene(file_name, output_name, scale, swap_yz, inverse_z);
+	bool succ = ConvertScene(file_name, output_name, scale, swap_yz, inverse_z, fast_import, quiet);
 
 	if (succ && !quiet)
 	{
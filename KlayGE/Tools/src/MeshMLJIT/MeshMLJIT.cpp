@@ -1,4 +1,5 @@
 #include <KlayGE/KlayGE.hpp>
+#include <KFL/ErrorHandling.hpp>
 #include <KFL/Math.hpp>
 #include <KFL/Util.hpp>
 #include <KFL/XMLDom.hpp>
@@ -9,10 +10,22 @@
 #include <KlayGE/Renderable.hpp>
 #include <KlayGE/Mesh.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/Timer.hpp>
+#include <KFL/CpuInfo.hpp>
+#include <KFL/Thread.hpp>
 #include <KFL/CXX17/filesystem.hpp>
+#include <MeshMLLib/MeshOptimizer.hpp>
+#include <MeshMLLib/MeshSimplifier.hpp>
 
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <iterator>
 #include <fstream>
+#include <map>
+#include <mutex>
 #include <sstream>
 #include <vector>
 #include <cstring>
@@ -26,6 +39,8 @@
 #pragma GCC diagnostic pop
 #endif
 #include <boost/algorithm/string/trim.hpp>
+#include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/classification.hpp>
 
 #if defined(KLAYGE_COMPILER_GCC)
 #pragma GCC diagnostic push
@@ -36,6 +51,8 @@
 #pragma GCC diagnostic pop
 #endif
 
+#include "BuildManifest.hpp"
+
 using namespace std;
 using namespace KlayGE;
 
@@ -76,7 +93,7 @@ namespace
 	}
 
 	std::string const JIT_EXT_NAME = ".model_bin";
-	uint32_t const MODEL_BIN_VERSION = 14;
+	uint32_t const MODEL_BIN_VERSION = 16;
 
 	struct KeyFrames
 	{
@@ -92,6 +109,90 @@ namespace
 		std::vector<AABBox> bb;
 	};
 
+	// The largest differences between the MeshML data and what the GPU reads back
+	struct MeshQuantizationError
+	{
+		float position;		// In model space
+		float tex_coord;
+		float normal;		// In degrees, the normal of the tangent frame if there is one
+		float blend_weight;
+	};
+
+	// Signed 16-bit formats are read as max(s / 32767, -1), unsigned 8-bit ones as u / 255. Rounding to the same scale
+	// keeps the error within half a step.
+	int16_t QuantizeSNorm16(float v)
+	{
+		return static_cast<int16_t>(MathLib::clamp<int32_t>(static_cast<int32_t>(std::floor(v * 32767 + 0.5f)), -32767, 32767));
+	}
+
+	float DequantizeSNorm16(int16_t s)
+	{
+		return std::max(s / 32767.0f, -1.0f);
+	}
+
+	uint32_t QuantizeUNorm8(float v)
+	{
+		return MathLib::clamp<uint32_t>(static_cast<uint32_t>(std::max(std::floor(v * 255 + 0.5f), 0.0f)), 0, 255);
+	}
+
+	float DequantizeUNorm8(uint32_t u)
+	{
+		return (u & 0xFF) / 255.0f;
+	}
+
+	// Normalized and rounded so they still sum to 255. The rounding goes to the weights with the largest remainders.
+	void QuantizeBlendWeights(float const * weights, uint8_t* quantized)
+	{
+		float sum = 0;
+		for (uint32_t j = 0; j < 4; ++ j)
+		{
+			sum += std::max(weights[j], 0.0f);
+		}
+		if (sum <= 0)
+		{
+			std::fill(quantized, quantized + 4, static_cast<uint8_t>(0));
+			return;
+		}
+
+		float remainders[4];
+		uint32_t total = 0;
+		for (uint32_t j = 0; j < 4; ++ j)
+		{
+			float const w = std::max(weights[j], 0.0f) / sum * 255;
+			quantized[j] = static_cast<uint8_t>(std::min(std::floor(w), 255.0f));
+			remainders[j] = w - quantized[j];
+			total += quantized[j];
+		}
+		while (total < 255)
+		{
+			uint32_t const j = static_cast<uint32_t>(std::max_element(remainders, remainders + 4) - remainders);
+			++ quantized[j];
+			remainders[j] = -1;
+			++ total;
+		}
+	}
+
+	std::vector<float3> DequantizePositions(AABBox const & pos_bb, std::vector<int16_t> const & positions)
+	{
+		float3 const pos_center = pos_bb.Center();
+		float3 const pos_extent = pos_bb.HalfSize();
+
+		std::vector<float3> ret(positions.size() / 4);
+		for (uint32_t index = 0; index < ret.size(); ++ index)
+		{
+			float3 const pos(DequantizeSNorm16(positions[index * 4 + 0]), DequantizeSNorm16(positions[index * 4 + 1]),
+				DequantizeSNorm16(positions[index * 4 + 2]));
+			ret[index] = pos * pos_extent + pos_center;
+		}
+		return ret;
+	}
+
+	// Tangent frames keep the normal in z
+	float3 TangentQuatNormal(Quaternion const & tangent_quat)
+	{
+		return MathLib::transform_quat(float3(0, 0, 1), tangent_quat);
+	}
+
 	template <int N>
 	void ExtractFVector(std::string const & value_str, float* v)
 	{
@@ -111,21 +212,59 @@ namespace
 		}
 	}
 
+	template <int N, typename T>
+	void ExtractVector(XMLReader const & reader, std::string const & name, T* v)
+	{
+		for (uint32_t i = reader.AttribArray(name, v, N); i < N; ++ i)
+		{
+			v[i] = 0;
+		}
+	}
+
+	// All components in the v attribute, or one attribute for each, named by a character of comp_names
 	template <int N>
-	void ExtractUIVector(std::string const & value_str, uint32_t* v)
+	void ReadFVector(XMLReader const & reader, char const * comp_names, float* v, float default_val = 0)
 	{
-		std::vector<std::string> strs;
-		boost::algorithm::split(strs, value_str, boost::is_any_of(" "));
-		for (size_t i = 0; i < N; ++ i)
+		if (reader.HasAttrib("v"))
 		{
-			if (i < strs.size())
+			ExtractVector<N>(reader, "v", v);
+		}
+		else
+		{
+			for (int i = 0; i < N; ++ i)
 			{
-				boost::algorithm::trim(strs[i]);
-				v[i] = static_cast<uint32_t>(atoi(strs[i].c_str()));
+				v[i] = reader.AttribFloat(std::string(1, comp_names[i]), default_val);
 			}
-			else
+		}
+	}
+
+	// The corners in the min and max attributes, or in the min and max child nodes
+	template <int N>
+	void ReadBoundingBox(XMLReader& reader, float* bb_min, float* bb_max)
+	{
+		bool found_min = reader.HasAttrib("min");
+		bool found_max = reader.HasAttrib("max");
+		if (found_min)
+		{
+			ExtractVector<N>(reader, "min", bb_min);
+		}
+		if (found_max)
+		{
+			ExtractVector<N>(reader, "max", bb_max);
+		}
+
+		uint32_t const depth = reader.Depth();
+		while (reader.ReadChild(depth))
+		{
+			if (!found_min && ("min" == reader.Name()))
 			{
-				v[i] = 0;
+				ReadFVector<N>(reader, "xyz", bb_min);
+				found_min = true;
+			}
+			else if (!found_max && ("max" == reader.Name()))
+			{
+				ReadFVector<N>(reader, "xyz", bb_max);
+				found_max = true;
 			}
 		}
 	}
@@ -480,13 +619,14 @@ namespace
 		}
 	}
 
-	void CompileMeshesVerticesChunk(XMLNodePtr const & vertices_chunk,
+	void CompileMeshesVerticesChunk(XMLReader& reader,
 		AABBox& pos_bb, AABBox& tc_bb, std::vector<VertexElement>& vertex_elements,
 		std::vector<int16_t>& positions, std::vector<uint32_t>& normals,
 		std::vector<uint32_t>& tangent_quats, 
 		std::vector<uint32_t>& diffuses, std::vector<uint32_t>& speculars,
 		std::vector<int16_t>& tex_coords, 
-		std::vector<uint32_t>& bone_indices, std::vector<uint32_t>& bone_weights)
+		std::vector<uint32_t>& bone_indices, std::vector<uint32_t>& bone_weights,
+		MeshQuantizationError& quant_error)
 	{
 		std::vector<float3> mesh_positions;
 		std::vector<float3> mesh_normals;
@@ -499,90 +639,8 @@ namespace
 		std::vector<uint32_t> mesh_bone_indices;
 		std::vector<uint32_t> mesh_bone_weights;
 
-		bool recompute_pos_bb;
-		XMLNodePtr pos_bb_node = vertices_chunk->FirstNode("pos_bb");
-		if (pos_bb_node)
-		{
-			float3 pos_min_bb, pos_max_bb;
-			{
-				XMLAttributePtr attr = pos_bb_node->Attrib("min");
-				if (attr)
-				{
-					ExtractFVector<3>(attr->ValueString(), &pos_min_bb[0]);
-				}
-				else
-				{
-					XMLNodePtr pos_min_node = pos_bb_node->FirstNode("min");
-					pos_min_bb.x() = pos_min_node->Attrib("x")->ValueFloat();
-					pos_min_bb.y() = pos_min_node->Attrib("y")->ValueFloat();
-					pos_min_bb.z() = pos_min_node->Attrib("z")->ValueFloat();
-				}
-			}
-			{
-				XMLAttributePtr attr = pos_bb_node->Attrib("max");
-				if (attr)
-				{
-					ExtractFVector<3>(attr->ValueString(), &pos_max_bb[0]);
-				}
-				else
-				{
-					XMLNodePtr pos_max_node = pos_bb_node->FirstNode("max");
-					pos_max_bb.x() = pos_max_node->Attrib("x")->ValueFloat();
-					pos_max_bb.y() = pos_max_node->Attrib("y")->ValueFloat();
-					pos_max_bb.z() = pos_max_node->Attrib("z")->ValueFloat();
-				}
-			}
-			pos_bb = AABBox(pos_min_bb, pos_max_bb);
-
-			recompute_pos_bb = false;
-		}
-		else
-		{
-			recompute_pos_bb = true;
-		}
-
-		bool recompute_tc_bb;
-		XMLNodePtr tc_bb_node = vertices_chunk->FirstNode("tc_bb");
-		if (tc_bb_node)
-		{
-			float3 tc_min_bb, tc_max_bb;
-			{
-				XMLAttributePtr attr = tc_bb_node->Attrib("min");
-				if (attr)
-				{
-					ExtractFVector<2>(attr->ValueString(), &tc_min_bb[0]);
-				}
-				else
-				{
-					XMLNodePtr tc_min_node = tc_bb_node->FirstNode("min");
-					tc_min_bb.x() = tc_min_node->Attrib("x")->ValueFloat();
-					tc_min_bb.y() = tc_min_node->Attrib("y")->ValueFloat();
-				}
-			}
-			{
-				XMLAttributePtr attr = tc_bb_node->Attrib("max");
-				if (attr)
-				{
-					ExtractFVector<2>(attr->ValueString(), &tc_max_bb[0]);
-				}
-				else
-				{
-					XMLNodePtr tc_max_node = tc_bb_node->FirstNode("max");							
-					tc_max_bb.x() = tc_max_node->Attrib("x")->ValueFloat();
-					tc_max_bb.y() = tc_max_node->Attrib("y")->ValueFloat();
-				}
-			}
-
-			tc_min_bb.z() = 0;
-			tc_max_bb.z() = 0;
-			tc_bb = AABBox(tc_min_bb, tc_max_bb);
-
-			recompute_tc_bb = false;
-		}
-		else
-		{
-			recompute_tc_bb = true;
-		}
+		bool recompute_pos_bb = true;
+		bool recompute_tc_bb = true;
 
 		bool has_normal = false;
 		bool has_diffuse = false;
@@ -593,246 +651,184 @@ namespace
 		bool has_binormal = false;
 		bool has_tangent_quat = false;
 
-		for (XMLNodePtr vertex_node = vertices_chunk->FirstNode("vertex"); vertex_node; vertex_node = vertex_node->NextSibling("vertex"))
+		uint32_t const chunk_depth = reader.Depth();
+		while (reader.ReadChild(chunk_depth))
 		{
+			if ("vertex" == reader.Name())
 			{
-				float3 pos;
-				XMLAttributePtr attr = vertex_node->Attrib("x");
-				if (attr)
-				{
-					pos.x() = vertex_node->Attrib("x")->ValueFloat();
-					pos.y() = vertex_node->Attrib("y")->ValueFloat();
-					pos.z() = vertex_node->Attrib("z")->ValueFloat();
-
-					attr = vertex_node->Attrib("u");
-					if (attr)
-					{
-						float2 tex_coord;
-						tex_coord.x() = vertex_node->Attrib("u")->ValueFloat();
-						tex_coord.y() = vertex_node->Attrib("v")->ValueFloat();
-						mesh_tex_coords.push_back(tex_coord);
-					}
-				}
-				else
-				{
-					ExtractFVector<3>(vertex_node->Attrib("v")->ValueString(), &pos[0]);
-				}
-				mesh_positions.push_back(pos);
-			}
-
-			XMLNodePtr diffuse_node = vertex_node->FirstNode("diffuse");
-			if (diffuse_node)
-			{
-				has_diffuse = true;
-
-				float4 diffuse;
-				XMLAttributePtr attr = diffuse_node->Attrib("v");
-				if (attr)
-				{
-					ExtractFVector<4>(attr->ValueString(), &diffuse[0]);
-				}
-				else
-				{
-					diffuse.x() = diffuse_node->Attrib("r")->ValueFloat();
-					diffuse.y() = diffuse_node->Attrib("g")->ValueFloat();
-					diffuse.z() = diffuse_node->Attrib("b")->ValueFloat();
-					diffuse.w() = diffuse_node->Attrib("a")->ValueFloat();										
-				}
-				mesh_diffuses.push_back(diffuse);
-			}
-
-			XMLNodePtr specular_node = vertex_node->FirstNode("specular");
-			if (specular_node)
-			{
-				has_specular = true;
-
-				float3 specular;
-				XMLAttributePtr attr = specular_node->Attrib("v");
-				if (attr)
-				{
-					ExtractFVector<3>(attr->ValueString(), &specular[0]);
-				}
-				else
-				{
-					specular.x() = specular_node->Attrib("r")->ValueFloat();
-					specular.y() = specular_node->Attrib("g")->ValueFloat();
-					specular.z() = specular_node->Attrib("b")->ValueFloat();
-				}
-				mesh_speculars.push_back(specular);
-			}
+				bool const has_vertex_tex_coord = reader.HasAttrib("u");
 
-			if (!vertex_node->Attrib("u"))
-			{
-				XMLNodePtr tex_coord_node = vertex_node->FirstNode("tex_coord");
-				if (tex_coord_node)
 				{
-					has_tex_coord = true;
-
-					float2 tex_coord;
-					XMLAttributePtr attr = tex_coord_node->Attrib("u");
-					if (attr)
+					float3 pos;
+					if (reader.HasAttrib("x"))
 					{
-						tex_coord.x() = tex_coord_node->Attrib("u")->ValueFloat();
-						tex_coord.y() = tex_coord_node->Attrib("v")->ValueFloat();
+						pos.x() = reader.AttribFloat("x", 0);
+						pos.y() = reader.AttribFloat("y", 0);
+						pos.z() = reader.AttribFloat("z", 0);
+
+						if (has_vertex_tex_coord)
+						{
+							float2 tex_coord;
+							tex_coord.x() = reader.AttribFloat("u", 0);
+							tex_coord.y() = reader.AttribFloat("v", 0);
+							mesh_tex_coords.push_back(tex_coord);
+						}
 					}
 					else
 					{
-						ExtractFVector<2>(tex_coord_node->Attrib("v")->ValueString(), &tex_coord[0]);
+						ExtractVector<3>(reader, "v", &pos[0]);
 					}
-					mesh_tex_coords.push_back(tex_coord);
+					mesh_positions.push_back(pos);
 				}
-			}
-
-			XMLNodePtr weight_node = vertex_node->FirstNode("weight");
-			if (weight_node)
-			{
-				has_weight = true;
 
-				uint32_t bone_index32[4] = { 0, 0, 0, 0 };
-				float bone_weight32[4] = { 0, 0, 0, 0 };
+				// Only the first child of each kind counts
+				bool found_diffuse = false;
+				bool found_specular = false;
+				bool found_tex_coord = has_vertex_tex_coord;
+				bool found_weight = false;
+				bool found_normal = false;
+				bool found_tangent = false;
+				bool found_binormal = false;
+				bool found_tangent_quat = false;
 
-				uint32_t num_blend = 0;
-				XMLAttributePtr attr = weight_node->Attrib("joint");
-				if (!attr)
-				{
-					attr = weight_node->Attrib("bone_index");
-				}
-				if (attr)
+				uint32_t const vertex_depth = reader.Depth();
+				while (reader.ReadChild(vertex_depth))
 				{
-					XMLAttributePtr weight_attr = weight_node->Attrib("weight");
+					std::string const & name = reader.Name();
+					if (!found_diffuse && ("diffuse" == name))
+					{
+						has_diffuse = true;
+						found_diffuse = true;
+
+						float4 diffuse;
+						ReadFVector<4>(reader, "rgba", &diffuse[0]);
+						mesh_diffuses.push_back(diffuse);
+					}
+					else if (!found_specular && ("specular" == name))
+					{
+						has_specular = true;
+						found_specular = true;
 
-					std::vector<std::string> index_strs;
-					std::vector<std::string> weight_strs;
-					boost::algorithm::split(index_strs, attr->ValueString(), boost::is_any_of(" "));
-					boost::algorithm::split(weight_strs, weight_attr->ValueString(), boost::is_any_of(" "));
-					
-					for (num_blend = 0; num_blend < 4; ++ num_blend)
+						float3 specular;
+						ReadFVector<3>(reader, "rgb", &specular[0]);
+						mesh_speculars.push_back(specular);
+					}
+					else if (!found_tex_coord && ("tex_coord" == name))
 					{
-						if ((num_blend < index_strs.size()) && (num_blend < weight_strs.size()))
+						has_tex_coord = true;
+						found_tex_coord = true;
+
+						float2 tex_coord;
+						if (reader.HasAttrib("u"))
 						{
-							bone_index32[num_blend] = static_cast<uint32_t>(atoi(index_strs[num_blend].c_str()));
-							bone_weight32[num_blend] = static_cast<float>(atof(weight_strs[num_blend].c_str()));
+							tex_coord.x() = reader.AttribFloat("u", 0);
+							tex_coord.y() = reader.AttribFloat("v", 0);
 						}
 						else
 						{
-							break;
+							ExtractVector<2>(reader, "v", &tex_coord[0]);
 						}
+						mesh_tex_coords.push_back(tex_coord);
 					}
-				}
-				else
-				{
-					while (weight_node && (num_blend < 4))
+					else if (!found_weight && ("weight" == name))
 					{
-						bone_index32[num_blend] = weight_node->Attrib("bone_index")->ValueUInt();
-						bone_weight32[num_blend] = weight_node->Attrib("weight")->ValueFloat();
+						has_weight = true;
+						found_weight = true;
 
-						weight_node = weight_node->NextSibling("weight");
-						++ num_blend;
-					}
-				}
+						uint32_t bone_index32[4] = { 0, 0, 0, 0 };
+						float bone_weight32[4] = { 0, 0, 0, 0 };
 
-				uint32_t index32 = 0;
-				uint32_t weight32 = 0;
-				for (size_t j = 0; j < 4; ++ j)
-				{
-					uint8_t bone_index = static_cast<uint8_t>(bone_index32[j]);
-					uint8_t bone_weight = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(bone_weight32[j] * 255), 0, 255));
+						uint32_t const num_indices = reader.AttribArray(reader.HasAttrib("joint") ? "joint" : "bone_index",
+							bone_index32, 4);
+						uint32_t const num_weights = reader.AttribArray("weight", bone_weight32, 4);
+						for (uint32_t num_blend = std::min(num_indices, num_weights); num_blend < 4; ++ num_blend)
+						{
+							bone_index32[num_blend] = 0;
+							bone_weight32[num_blend] = 0;
+						}
 
-					index32 |= (bone_index << (j * 8));
-					weight32 |= (bone_weight << (j * 8));
-				}
-				mesh_bone_indices.push_back(index32);
-				mesh_bone_weights.push_back(weight32);
-			}
-						
-			XMLNodePtr normal_node = vertex_node->FirstNode("normal");
-			if (normal_node)
-			{
-				has_normal = true;
+						uint8_t bone_weight8[4];
+						QuantizeBlendWeights(bone_weight32, bone_weight8);
 
-				float3 normal;
-				XMLAttributePtr attr = normal_node->Attrib("v");
-				if (attr)
-				{
-					ExtractFVector<3>(attr->ValueString(), &normal[0]);
-				}
-				else
-				{
-					normal.x() = normal_node->Attrib("x")->ValueFloat();
-					normal.y() = normal_node->Attrib("y")->ValueFloat();
-					normal.z() = normal_node->Attrib("z")->ValueFloat();
-				}
-				mesh_normals.push_back(normal);
-			}
+						float weight_sum = 0;
+						for (size_t j = 0; j < 4; ++ j)
+						{
+							weight_sum += std::max(bone_weight32[j], 0.0f);
+						}
 
-			XMLNodePtr tangent_node = vertex_node->FirstNode("tangent");
-			if (tangent_node)
-			{
-				has_tangent = true;
+						uint32_t index32 = 0;
+						uint32_t weight32 = 0;
+						for (size_t j = 0; j < 4; ++ j)
+						{
+							uint8_t bone_index = static_cast<uint8_t>(bone_index32[j]);
 
-				float4 tangent;
-				XMLAttributePtr attr = tangent_node->Attrib("v");
-				if (attr)
-				{
-					ExtractFVector<4>(attr->ValueString(), &tangent[0]);
-				}
-				else
-				{
-					tangent.x() = tangent_node->Attrib("x")->ValueFloat();
-					tangent.y() = tangent_node->Attrib("y")->ValueFloat();
-					tangent.z() = tangent_node->Attrib("z")->ValueFloat();
-					attr = tangent_node->Attrib("w");
-					if (attr)
+							index32 |= (bone_index << (j * 8));
+							weight32 |= (bone_weight8[j] << (j * 8));
+
+							if (weight_sum > 0)
+							{
+								quant_error.blend_weight = std::max(quant_error.blend_weight,
+									MathLib::abs(std::max(bone_weight32[j], 0.0f) / weight_sum - DequantizeUNorm8(bone_weight8[j])));
+							}
+						}
+						mesh_bone_indices.push_back(index32);
+						mesh_bone_weights.push_back(weight32);
+					}
+					else if (!found_normal && ("normal" == name))
 					{
-						tangent.w() = attr->ValueFloat();
+						has_normal = true;
+						found_normal = true;
+
+						float3 normal;
+						ReadFVector<3>(reader, "xyz", &normal[0]);
+						mesh_normals.push_back(normal);
 					}
-					else
+					else if (!found_tangent && ("tangent" == name))
+					{
+						has_tangent = true;
+						found_tangent = true;
+
+						float4 tangent;
+						ReadFVector<4>(reader, "xyzw", &tangent[0], 1);
+						mesh_tangents.push_back(tangent);
+					}
+					else if (!found_binormal && ("binormal" == name))
+					{
+						has_binormal = true;
+						found_binormal = true;
+
+						float3 binormal;
+						ReadFVector<3>(reader, "xyz", &binormal[0]);
+						mesh_binormals.push_back(binormal);
+					}
+					else if (!found_tangent_quat && ("tangent_quat" == name))
 					{
-						tangent.w() = 1;
+						has_tangent_quat = true;
+						found_tangent_quat = true;
+
+						Quaternion tangent_quat;
+						ReadFVector<4>(reader, "xyzw", &tangent_quat[0]);
+						mesh_tangent_quats.push_back(tangent_quat);
 					}
 				}
-				mesh_tangents.push_back(tangent);
 			}
-
-			XMLNodePtr binormal_node = vertex_node->FirstNode("binormal");
-			if (binormal_node)
+			else if (recompute_pos_bb && ("pos_bb" == reader.Name()))
 			{
-				has_binormal = true;
+				float3 pos_min_bb, pos_max_bb;
+				ReadBoundingBox<3>(reader, &pos_min_bb[0], &pos_max_bb[0]);
+				pos_bb = AABBox(pos_min_bb, pos_max_bb);
 
-				float3 binormal;
-				XMLAttributePtr attr = binormal_node->Attrib("v");
-				if (attr)
-				{
-					ExtractFVector<3>(attr->ValueString(), &binormal[0]);
-				}
-				else
-				{
-					binormal.x() = binormal_node->Attrib("x")->ValueFloat();
-					binormal.y() = binormal_node->Attrib("y")->ValueFloat();
-					binormal.z() = binormal_node->Attrib("z")->ValueFloat();
-				}
-				mesh_binormals.push_back(binormal);
+				recompute_pos_bb = false;
 			}
-
-			XMLNodePtr tangent_quat_node = vertex_node->FirstNode("tangent_quat");
-			if (tangent_quat_node)
+			else if (recompute_tc_bb && ("tc_bb" == reader.Name()))
 			{
-				has_tangent_quat = true;
+				float3 tc_min_bb, tc_max_bb;
+				ReadBoundingBox<2>(reader, &tc_min_bb[0], &tc_max_bb[0]);
+				tc_min_bb.z() = 0;
+				tc_max_bb.z() = 0;
+				tc_bb = AABBox(tc_min_bb, tc_max_bb);
 
-				Quaternion tangent_quat;
-				XMLAttributePtr const & attr = tangent_quat_node->Attrib("v");
-				if (attr)
-				{
-					ExtractFVector<4>(attr->ValueString(), &tangent_quat[0]);
-				}
-				else
-				{
-					tangent_quat.x() = tangent_quat_node->Attrib("x")->ValueFloat();
-					tangent_quat.y() = tangent_quat_node->Attrib("y")->ValueFloat();
-					tangent_quat.z() = tangent_quat_node->Attrib("z")->ValueFloat();
-					tangent_quat.w() = tangent_quat_node->Attrib("w")->ValueFloat();
-				}
-				mesh_tangent_quats.push_back(tangent_quat);
+				recompute_tc_bb = false;
 			}
 		}
 
@@ -922,9 +918,9 @@ namespace
 
 		if (recompute_pos_bb)
 		{
+			float3 pos_min_bb, pos_max_bb;
 			for (uint32_t index = 0; index < mesh_positions.size(); ++ index)
 			{
-				float3 pos_min_bb, pos_max_bb;
 				float3 const & pos = mesh_positions[index];
 				if (0 == index)
 				{
@@ -941,9 +937,9 @@ namespace
 		}
 		if (recompute_tc_bb)
 		{
+			float3 tc_min_bb, tc_max_bb;
 			for (uint32_t index = 0; index < mesh_tex_coords.size(); ++ index)
 			{
-				float3 tc_min_bb, tc_max_bb;
 				float3 tex_coord = float3(mesh_tex_coords[index].x(), mesh_tex_coords[index].y(), 0.0f);
 				if (0 == index)
 				{
@@ -1005,16 +1001,19 @@ namespace
 		float3 const pos_extent = pos_bb.HalfSize();
 		float3 const tc_center = tc_bb.Center();
 		float3 const tc_extent = tc_bb.HalfSize();
+		// Flat meshes have no extent on an axis, all of their values are at the center
+		float3 const pos_scale(pos_extent.x() > 0 ? 1 / pos_extent.x() : 0, pos_extent.y() > 0 ? 1 / pos_extent.y() : 0,
+			pos_extent.z() > 0 ? 1 / pos_extent.z() : 0);
+		float2 const tc_scale(tc_extent.x() > 0 ? 1 / tc_extent.x() : 0, tc_extent.y() > 0 ? 1 / tc_extent.y() : 0);
 
 		for (uint32_t index = 0; index < mesh_positions.size(); ++ index)
 		{
-			float3 pos = mesh_positions[index];
-			pos = (pos - pos_center) / pos_extent * 0.5f + 0.5f;
+			float3 const pos = (mesh_positions[index] - pos_center) * pos_scale;
 			int16_t s_pos[4] = 
 			{
-				static_cast<int16_t>(MathLib::clamp<int32_t>(static_cast<int32_t>(pos.x() * 65535 - 32768), -32768, 32767)),
-				static_cast<int16_t>(MathLib::clamp<int32_t>(static_cast<int32_t>(pos.y() * 65535 - 32768), -32768, 32767)),
-				static_cast<int16_t>(MathLib::clamp<int32_t>(static_cast<int32_t>(pos.z() * 65535 - 32768), -32768, 32767)),
+				QuantizeSNorm16(pos.x()),
+				QuantizeSNorm16(pos.y()),
+				QuantizeSNorm16(pos.z()),
 				32767
 			};
 
@@ -1022,103 +1021,234 @@ namespace
 			positions.push_back(s_pos[1]);
 			positions.push_back(s_pos[2]);
 			positions.push_back(s_pos[3]);
+
+			for (uint32_t j = 0; j < 3; ++ j)
+			{
+				quant_error.position = std::max(quant_error.position,
+					MathLib::abs(DequantizeSNorm16(s_pos[j]) * pos_extent[j] + pos_center[j] - mesh_positions[index][j]));
+			}
 		}
 		for (uint32_t index = 0; index < mesh_diffuses.size(); ++ index)
 		{
 			float4 const & diffuse = mesh_diffuses[index];
-			uint32_t compact = (MathLib::clamp<uint32_t>(static_cast<uint32_t>((diffuse.x() * 0.5f + 0.5f) * 255), 0, 255) << 0)
-				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((diffuse.y() * 0.5f + 0.5f) * 255), 0, 255) << 8)
-				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((diffuse.z() * 0.5f + 0.5f) * 255), 0, 255) << 16)
-				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((diffuse.w() * 0.5f + 0.5f) * 255), 0, 255) << 24);
+			uint32_t compact = (QuantizeUNorm8(diffuse.x() * 0.5f + 0.5f) << 0)
+				| (QuantizeUNorm8(diffuse.y() * 0.5f + 0.5f) << 8)
+				| (QuantizeUNorm8(diffuse.z() * 0.5f + 0.5f) << 16)
+				| (QuantizeUNorm8(diffuse.w() * 0.5f + 0.5f) << 24);
 			diffuses.push_back(compact);
 		}
 		for (uint32_t index = 0; index < mesh_speculars.size(); ++ index)
 		{
 			float3 const & specular = mesh_speculars[index];
-			uint32_t compact = (MathLib::clamp<uint32_t>(static_cast<uint32_t>((specular.x() * 0.5f + 0.5f) * 255), 0, 255) << 0)
-				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((specular.y() * 0.5f + 0.5f) * 255), 0, 255) << 8)
-				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((specular.z() * 0.5f + 0.5f) * 255), 0, 255) << 16)
+			uint32_t compact = (QuantizeUNorm8(specular.x() * 0.5f + 0.5f) << 0)
+				| (QuantizeUNorm8(specular.y() * 0.5f + 0.5f) << 8)
+				| (QuantizeUNorm8(specular.z() * 0.5f + 0.5f) << 16)
 				| 0xFF000000;
 			speculars.push_back(compact);
 		}
 		for (uint32_t index = 0; index < mesh_tex_coords.size(); ++ index)
 		{
-			float3 tex_coord = float3(mesh_tex_coords[index].x(), mesh_tex_coords[index].y(), 0.0f);
-			tex_coord = (tex_coord - tc_center) / tc_extent * 0.5f + 0.5f;
+			float2 const tex_coord = (mesh_tex_coords[index] - float2(tc_center.x(), tc_center.y())) * tc_scale;
 			int16_t s_tc[2] = 
 			{
-				static_cast<int16_t>(MathLib::clamp<int32_t>(static_cast<int32_t>(tex_coord.x() * 65535 - 32768), -32768, 32767)),
-				static_cast<int16_t>(MathLib::clamp<int32_t>(static_cast<int32_t>(tex_coord.y() * 65535 - 32768), -32768, 32767)),
+				QuantizeSNorm16(tex_coord.x()),
+				QuantizeSNorm16(tex_coord.y())
 			};
 
 			tex_coords.push_back(s_tc[0]);
 			tex_coords.push_back(s_tc[1]);
+
+			for (uint32_t j = 0; j < 2; ++ j)
+			{
+				quant_error.tex_coord = std::max(quant_error.tex_coord,
+					MathLib::abs(DequantizeSNorm16(s_tc[j]) * tc_extent[j] + tc_center[j] - mesh_tex_coords[index][j]));
+			}
 		}
 		for (uint32_t index = 0; index < mesh_tangent_quats.size(); ++ index)
 		{
 			Quaternion const & tangent_quat = mesh_tangent_quats[index];
-			uint32_t compact = (MathLib::clamp<uint32_t>(static_cast<uint32_t>((tangent_quat.x() * 0.5f + 0.5f) * 255), 0, 255) << 0)
-				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((tangent_quat.y() * 0.5f + 0.5f) * 255), 0, 255) << 8)
-				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((tangent_quat.z() * 0.5f + 0.5f) * 255), 0, 255) << 16)
-				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>((tangent_quat.w() * 0.5f + 0.5f) * 255), 0, 255) << 24);
+			uint32_t compact = (QuantizeUNorm8(tangent_quat.x() * 0.5f + 0.5f) << 0)
+				| (QuantizeUNorm8(tangent_quat.y() * 0.5f + 0.5f) << 8)
+				| (QuantizeUNorm8(tangent_quat.z() * 0.5f + 0.5f) << 16)
+				| (QuantizeUNorm8(tangent_quat.w() * 0.5f + 0.5f) << 24);
 			tangent_quats.push_back(compact);
+
+			Quaternion const decoded(DequantizeUNorm8(compact >> 0) * 2 - 1, DequantizeUNorm8(compact >> 8) * 2 - 1,
+				DequantizeUNorm8(compact >> 16) * 2 - 1, DequantizeUNorm8(compact >> 24) * 2 - 1);
+			float const cos_angle = MathLib::dot(MathLib::normalize(TangentQuatNormal(MathLib::normalize(tangent_quat))),
+				MathLib::normalize(TangentQuatNormal(MathLib::normalize(decoded))));
+			quant_error.normal = std::max(quant_error.normal, MathLib::acos(MathLib::clamp(cos_angle, -1.0f, 1.0f)) * RAD2DEG);
 		}
 		for (uint32_t index = 0; index < mesh_normals.size(); ++ index)
 		{
-			float3 const normal = MathLib::normalize(mesh_normals[index]) * 0.5f + 0.5f;
-			uint32_t compact = MathLib::clamp<uint32_t>(static_cast<uint32_t>(normal.x() * 255), 0, 255)
-				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>(normal.y() * 255), 0, 255) << 8)
-				| (MathLib::clamp<uint32_t>(static_cast<uint32_t>(normal.z() * 255), 0, 255) << 16);
-			normals.push_back(compact);					
+			float3 const normal = MathLib::normalize(mesh_normals[index]);
+			float3 const biased_normal = normal * 0.5f + 0.5f;
+			uint32_t compact = QuantizeUNorm8(biased_normal.x())
+				| (QuantizeUNorm8(biased_normal.y()) << 8)
+				| (QuantizeUNorm8(biased_normal.z()) << 16);
+			normals.push_back(compact);
+
+			if (mesh_tangent_quats.empty())
+			{
+				float3 const decoded(DequantizeUNorm8(compact >> 0) * 2 - 1, DequantizeUNorm8(compact >> 8) * 2 - 1,
+					DequantizeUNorm8(compact >> 16) * 2 - 1);
+				float const cos_angle = MathLib::dot(normal, MathLib::normalize(decoded));
+				quant_error.normal = std::max(quant_error.normal, MathLib::acos(MathLib::clamp(cos_angle, -1.0f, 1.0f)) * RAD2DEG);
+			}
 		}
 		bone_indices = mesh_bone_indices;
 		bone_weights = mesh_bone_weights;
 	}
 
-	void CompileMeshesTrianglesChunk(XMLNodePtr const & triangles_chunk,
-		std::vector<uint8_t>& triangle_indices, char& is_index_16)
+	void CompileMeshesTrianglesChunk(XMLReader& reader, std::vector<uint32_t>& triangle_indices)
 	{
-		std::vector<uint32_t> mesh_triangle_indices;
-
-		is_index_16 = true;
-		for (XMLNodePtr tri_node = triangles_chunk->FirstNode("triangle"); tri_node; tri_node = tri_node->NextSibling("triangle"))
+		uint32_t const chunk_depth = reader.Depth();
+		while (reader.ReadChild(chunk_depth))
 		{
-			uint32_t ind[3];
-			XMLAttributePtr attr = tri_node->Attrib("index");
-			if (attr)
+			if (reader.Name() != "triangle")
 			{
-				ExtractUIVector<3>(attr->ValueString(), &ind[0]);
+				continue;
 			}
-			else
+
+			uint32_t ind[3];
+			if (reader.HasAttrib("index"))
 			{
-				ind[0] = tri_node->Attrib("a")->ValueUInt();
-				ind[1] = tri_node->Attrib("b")->ValueUInt();
-				ind[2] = tri_node->Attrib("c")->ValueUInt();
+				ExtractVector<3>(reader, "index", &ind[0]);
 			}
-			mesh_triangle_indices.push_back(ind[0]);
-			mesh_triangle_indices.push_back(ind[1]);
-			mesh_triangle_indices.push_back(ind[2]);
-
-			if ((ind[0] > 0xFFFF) || (ind[1] > 0xFFFF) || (ind[2] > 0xFFFF))
+			else
 			{
-				is_index_16 = false;
+				ind[0] = reader.AttribUInt("a", 0);
+				ind[1] = reader.AttribUInt("b", 0);
+				ind[2] = reader.AttribUInt("c", 0);
 			}
+			triangle_indices.push_back(ind[0]);
+			triangle_indices.push_back(ind[1]);
+			triangle_indices.push_back(ind[2]);
 		}
+	}
 
-		if (is_index_16)
-		{
-			triangle_indices.resize(mesh_triangle_indices.size() * 2);
-			for (uint32_t index = 0; index < mesh_triangle_indices.size(); ++ index)
+	// Triangles are reordered for the vertex cache and overdraw, then vertices for the order they are fetched in
+	MeshOptimizationResult OptimizeMeshData(AABBox const & pos_bb, std::vector<uint32_t>& triangle_indices,
+		std::vector<int16_t>& positions, std::vector<uint32_t>& normals,
+		std::vector<uint32_t>& tangent_quats,
+		std::vector<uint32_t>& diffuses, std::vector<uint32_t>& speculars,
+		std::vector<int16_t>& tex_coords,
+		std::vector<uint32_t>& bone_indices, std::vector<uint32_t>& bone_weights)
+	{
+		std::vector<float3> const mesh_positions = DequantizePositions(pos_bb, positions);
+
+		std::vector<uint32_t> remap;
+		MeshOptimizationResult const result = OptimizeMesh(remap, triangle_indices, mesh_positions);
+
+		RemapVertices(positions, remap, result.num_vertices);
+		RemapVertices(normals, remap, result.num_vertices);
+		RemapVertices(tangent_quats, remap, result.num_vertices);
+		RemapVertices(diffuses, remap, result.num_vertices);
+		RemapVertices(speculars, remap, result.num_vertices);
+		RemapVertices(tex_coords, remap, result.num_vertices);
+		RemapVertices(bone_indices, remap, result.num_vertices);
+		RemapVertices(bone_weights, remap, result.num_vertices);
+
+		return result;
+	}
+
+	// Levels are simplified with the packed attributes decoded back to floats, then reordered for the vertex cache. They
+	// use the vertices of the full detail mesh.
+	std::vector<LodLevel> GenerateMeshLods(AABBox const & pos_bb, std::vector<uint32_t> const & triangle_indices,
+		std::vector<int16_t> const & positions, std::vector<uint32_t> const & normals,
+		std::vector<uint32_t> const & tangent_quats, std::vector<uint32_t> const & diffuses,
+		std::vector<int16_t> const & tex_coords,
+		std::vector<uint32_t> const & bone_indices, std::vector<uint32_t> const & bone_weights,
+		uint32_t num_lods)
+	{
+		uint32_t const num_vertices = static_cast<uint32_t>(positions.size() / 4);
+		std::vector<float3> const mesh_positions = DequantizePositions(pos_bb, positions);
+
+		// Attribute differences cost as much as moving a small part of the mesh size away from the surface. Texcoords
+		// are in [0, 1] of their bounding box.
+		float const radius = MathLib::length(pos_bb.HalfSize());
+		float const shading_weight = 0.05f * radius;
+		float const skinning_weight = 0.1f * radius;
+
+		// Skinning weights as one dense vector over the joints the mesh uses, so vertices with different bone orders
+		// compare correctly
+		std::vector<uint32_t> joint_slots;
+		if (!bone_indices.empty())
+		{
+			for (uint32_t index = 0; index < num_vertices; ++ index)
 			{
-				*reinterpret_cast<uint16_t*>(&triangle_indices[index * 2])
-					= static_cast<uint16_t>(mesh_triangle_indices[index]);
+				for (uint32_t j = 0; j < 4; ++ j)
+				{
+					if ((bone_weights[index] >> (j * 8)) & 0xFF)
+					{
+						joint_slots.push_back((bone_indices[index] >> (j * 8)) & 0xFF);
+					}
+				}
 			}
+			std::sort(joint_slots.begin(), joint_slots.end());
+			joint_slots.erase(std::unique(joint_slots.begin(), joint_slots.end()), joint_slots.end());
 		}
-		else
+
+		uint32_t const num_shading_attribs = (tangent_quats.empty() ? (normals.empty() ? 0 : 3) : 4)
+			+ (diffuses.empty() ? 0 : 4) + (tex_coords.empty() ? 0 : 2);
+		uint32_t const num_attribs = num_shading_attribs + static_cast<uint32_t>(joint_slots.size());
+		std::vector<float> attribs(num_vertices * num_attribs, 0.0f);
+		for (uint32_t index = 0; index < num_vertices; ++ index)
+		{
+			float* attrib = &attribs[index * num_attribs];
+			if (!tangent_quats.empty())
+			{
+				for (uint32_t j = 0; j < 4; ++ j)
+				{
+					*attrib = (DequantizeUNorm8(tangent_quats[index] >> (j * 8)) * 2 - 1) * shading_weight;
+					++ attrib;
+				}
+			}
+			else if (!normals.empty())
+			{
+				for (uint32_t j = 0; j < 3; ++ j)
+				{
+					*attrib = (DequantizeUNorm8(normals[index] >> (j * 8)) * 2 - 1) * shading_weight;
+					++ attrib;
+				}
+			}
+			if (!diffuses.empty())
+			{
+				for (uint32_t j = 0; j < 4; ++ j)
+				{
+					*attrib = DequantizeUNorm8(diffuses[index] >> (j * 8)) * shading_weight;
+					++ attrib;
+				}
+			}
+			if (!tex_coords.empty())
+			{
+				for (uint32_t j = 0; j < 2; ++ j)
+				{
+					*attrib = (DequantizeSNorm16(tex_coords[index * 2 + j]) * 0.5f + 0.5f) * shading_weight;
+					++ attrib;
+				}
+			}
+			if (!joint_slots.empty())
+			{
+				for (uint32_t j = 0; j < 4; ++ j)
+				{
+					uint32_t const weight = (bone_weights[index] >> (j * 8)) & 0xFF;
+					if (weight > 0)
+					{
+						uint32_t const slot = static_cast<uint32_t>(std::lower_bound(joint_slots.begin(), joint_slots.end(),
+							(bone_indices[index] >> (j * 8)) & 0xFF) - joint_slots.begin());
+						attrib[slot] += DequantizeUNorm8(weight) * skinning_weight;
+					}
+				}
+			}
+		}
+
+		std::vector<LodLevel> lods = GenerateLods(triangle_indices, mesh_positions, attribs, num_attribs, num_lods);
+		for (auto& lod : lods)
 		{
-			triangle_indices.resize(mesh_triangle_indices.size() * 4);
-			std::memcpy(&triangle_indices[0], &mesh_triangle_indices[0], triangle_indices.size());
+			OptimizeVertexCache(lod.indices, num_vertices);
 		}
+		return lods;
 	}
 
 	void AppendMeshVertices(std::vector<VertexElement> const & ves,
@@ -1297,15 +1427,13 @@ namespace
 		}
 	}
 
-	void AppendMeshIndices(std::vector<uint8_t> const & triangle_indices, char is_index_16s,
+	void AppendMeshIndices(std::vector<uint32_t> const & triangle_indices,
 		std::vector<uint32_t>& mesh_num_indices,
 		std::vector<uint32_t>& mesh_start_indices,
 		std::vector<uint8_t>& merged_indices,
 		char& is_index_16_bit)
 	{
-		is_index_16_bit &= is_index_16s;
-
-		uint32_t num_indices = static_cast<uint32_t>(triangle_indices.size() / (is_index_16s ? 2 : 4));
+		uint32_t num_indices = static_cast<uint32_t>(triangle_indices.size());
 		uint32_t start_indicees = mesh_start_indices.back();
 		mesh_num_indices.push_back(num_indices);
 		mesh_start_indices.push_back(start_indicees + num_indices);
@@ -1314,33 +1442,34 @@ namespace
 
 		for (uint32_t ind_index = 0; ind_index < num_indices; ++ ind_index)
 		{
-			if (is_index_16s)
-			{
-				uint32_t ind32 = *reinterpret_cast<uint16_t const *>(&triangle_indices[ind_index * sizeof(uint16_t)]);
-				std::memcpy(&merged_indices[(start_indicees + ind_index) * 4],
-					&ind32, sizeof(ind32));
-			}
-			else
+			if (triangle_indices[ind_index] > 0xFFFF)
 			{
-				std::memcpy(&merged_indices[(start_indicees + ind_index) * 4],
-					&triangle_indices[ind_index * sizeof(uint32_t)], sizeof(uint32_t));
+				is_index_16_bit = false;
 			}
+			std::memcpy(&merged_indices[(start_indicees + ind_index) * 4],
+				&triangle_indices[ind_index], sizeof(uint32_t));
 		}
 	}
 
-	void CompileMeshesChunk(XMLNodePtr const & meshes_chunk,
+	void CompileMeshesChunk(XMLReader& reader,
 		std::vector<std::string>& mesh_names, std::vector<int32_t>& mtl_ids,
 		std::vector<AABBox>& pos_bbs, std::vector<AABBox>& tc_bbs, 
 		std::vector<uint32_t>& mesh_num_vertices, std::vector<uint32_t>& mesh_base_vertices,
 		std::vector<uint32_t>& mesh_num_indices, std::vector<uint32_t>& mesh_start_indices,
+		std::vector<std::vector<MeshLod>>& mesh_lods,
 		std::vector<VertexElement>& merged_ves, std::vector<std::vector<uint8_t>>& merged_vertices,
-		std::vector<uint8_t>& merged_indices, char& is_index_16_bit)
+		std::vector<uint8_t>& merged_indices, char& is_index_16_bit,
+		std::vector<std::pair<std::string, MeshOptimizationResult>>& opt_results,
+		std::vector<MeshQuantizationError>& quant_errors, uint32_t num_lods)
 	{
 		mesh_names.clear();
+		opt_results.clear();
+		quant_errors.clear();
 		mtl_ids.clear();
 
 		mesh_num_vertices.clear();
 		mesh_num_indices.clear();
+		mesh_lods.clear();
 		mesh_base_vertices.assign(1, 0);
 		mesh_start_indices.assign(1, 0);
 		merged_ves.clear();
@@ -1357,13 +1486,20 @@ namespace
 		std::vector<int16_t> tex_coords;
 		std::vector<uint32_t> bone_indices;
 		std::vector<uint32_t> bone_weights;
-		std::vector<uint8_t> triangle_indices;
+		std::vector<uint32_t> triangle_indices;
+		std::vector<std::vector<LodLevel>> lod_levels;
 
 		uint32_t mesh_index = 0;
-		for (XMLNodePtr mesh_node = meshes_chunk->FirstNode("mesh"); mesh_node; mesh_node = mesh_node->NextSibling("mesh"), ++ mesh_index)
+		uint32_t const chunk_depth = reader.Depth();
+		while (reader.ReadChild(chunk_depth))
 		{
-			mesh_names.push_back(mesh_node->Attrib("name")->ValueString());
-			mtl_ids.push_back(mesh_node->Attrib("mtl_id")->ValueInt());
+			if (reader.Name() != "mesh")
+			{
+				continue;
+			}
+
+			mesh_names.push_back(reader.AttribString("name", ""));
+			mtl_ids.push_back(reader.AttribInt("mtl_id", 0));
 
 			pos_bbs.resize(mesh_index + 1);
 			tc_bbs.resize(pos_bbs.size());
@@ -1378,14 +1514,49 @@ namespace
 			bone_indices.clear();
 			bone_weights.clear();
 
-			XMLNodePtr vertices_chunk = mesh_node->FirstNode("vertices_chunk");
-			if (vertices_chunk)
+			quant_errors.push_back({ 0, 0, 0, 0 });
+
+			triangle_indices.clear();
+
+			bool has_vertices_chunk = false;
+			bool has_triangles_chunk = false;
+			uint32_t const mesh_depth = reader.Depth();
+			while (reader.ReadChild(mesh_depth))
 			{
-				CompileMeshesVerticesChunk(vertices_chunk,
-					pos_bbs[mesh_index], tc_bbs[mesh_index], ves,
-					positions, normals,	tangent_quats,
+				if (!has_vertices_chunk && ("vertices_chunk" == reader.Name()))
+				{
+					CompileMeshesVerticesChunk(reader,
+						pos_bbs[mesh_index], tc_bbs[mesh_index], ves,
+						positions, normals,	tangent_quats,
+						diffuses, speculars, tex_coords,
+						bone_indices, bone_weights, quant_errors.back());
+					has_vertices_chunk = true;
+				}
+				else if (!has_triangles_chunk && ("triangles_chunk" == reader.Name()))
+				{
+					CompileMeshesTrianglesChunk(reader, triangle_indices);
+					has_triangles_chunk = true;
+				}
+			}
+
+			if (!positions.empty() && !triangle_indices.empty())
+			{
+				opt_results.emplace_back(mesh_names.back(), OptimizeMeshData(pos_bbs[mesh_index], triangle_indices,
+					positions, normals, tangent_quats,
 					diffuses, speculars, tex_coords,
-					bone_indices, bone_weights);
+					bone_indices, bone_weights));
+			}
+
+			lod_levels.emplace_back();
+			if ((num_lods > 0) && !positions.empty() && !triangle_indices.empty())
+			{
+				lod_levels.back() = GenerateMeshLods(pos_bbs[mesh_index], triangle_indices,
+					positions, normals, tangent_quats, diffuses, tex_coords,
+					bone_indices, bone_weights, num_lods);
+			}
+
+			if (has_vertices_chunk)
+			{
 				AppendMeshVertices(ves,
 					positions, normals, tangent_quats, 
 					diffuses, speculars, tex_coords, 
@@ -1393,25 +1564,38 @@ namespace
 					mesh_num_vertices, mesh_base_vertices,
 					merged_ves, merged_vertices);
 			}
-
-			triangle_indices.clear();
-
-			XMLNodePtr triangles_chunk = mesh_node->FirstNode("triangles_chunk");
-			if (triangles_chunk)
+			if (has_triangles_chunk)
 			{
-				char is_index_16s = true;
-				CompileMeshesTrianglesChunk(triangles_chunk,
-					triangle_indices, is_index_16s);
-				AppendMeshIndices(triangle_indices, is_index_16s,
+				AppendMeshIndices(triangle_indices,
 					mesh_num_indices, mesh_start_indices, merged_indices,
 					is_index_16_bit);
 			}
+
+			++ mesh_index;
+		}
+
+		// LOD levels go after all full detail meshes, so the mesh ranges stay the same with or without them
+		mesh_lods.resize(lod_levels.size());
+		for (size_t i = 0; i < lod_levels.size(); ++ i)
+		{
+			for (auto const & level : lod_levels[i])
+			{
+				MeshLod lod;
+				lod.num_indices = static_cast<uint32_t>(level.indices.size());
+				lod.start_index_location = static_cast<uint32_t>(merged_indices.size() / sizeof(uint32_t));
+				lod.error = level.error;
+				mesh_lods[i].push_back(lod);
+
+				merged_indices.resize(merged_indices.size() + level.indices.size() * sizeof(uint32_t));
+				std::memcpy(&merged_indices[lod.start_index_location * sizeof(uint32_t)], &level.indices[0],
+					level.indices.size() * sizeof(uint32_t));
+			}
 		}
 
 		if (is_index_16_bit)
 		{
 			std::vector<uint8_t> merged_indices_16(merged_indices.size() / 2);
-			for (uint32_t ind_index = 0; ind_index < mesh_start_indices.back(); ++ ind_index)
+			for (uint32_t ind_index = 0; ind_index < merged_indices.size() / sizeof(uint32_t); ++ ind_index)
 			{
 				uint16_t ind16 = Native2LE(static_cast<uint16_t>(*reinterpret_cast<uint32_t*>(&merged_indices[ind_index * sizeof(uint32_t)])));
 				std::memcpy(&merged_indices_16[ind_index * sizeof(uint16_t)], &ind16, sizeof(ind16));
@@ -1421,126 +1605,187 @@ namespace
 		}
 	}
 
-	void CompileBonesChunk(XMLNodePtr const & bones_chunk,
-		std::vector<Joint>& joints)
+	// A transform in bind_pos and bind_quat, or in real and dual, which are also called bind_real and bind_dual
+	struct DualQuaternionNodes
 	{
-		Joint joint;
-		for (XMLNodePtr bone_node = bones_chunk->FirstNode("bone"); bone_node; bone_node = bone_node->NextSibling("bone"))
+		DualQuaternionNodes()
+			: has_pos(false), has_quat(false), has_real(false), has_bind_real(false), has_dual(false), has_bind_dual(false)
 		{
-			joint.name = bone_node->Attrib("name")->ValueString();
-			joint.parent = static_cast<int16_t>(bone_node->Attrib("parent")->ValueInt());
-
-			XMLNodePtr bind_pos_node = bone_node->FirstNode("bind_pos");
-			if (bind_pos_node)
-			{
-				float3 bind_pos(bind_pos_node->Attrib("x")->ValueFloat(), bind_pos_node->Attrib("y")->ValueFloat(),
-					bind_pos_node->Attrib("z")->ValueFloat());
-
-				XMLNodePtr bind_quat_node = bone_node->FirstNode("bind_quat");
-				Quaternion bind_quat(bind_quat_node->Attrib("x")->ValueFloat(), bind_quat_node->Attrib("y")->ValueFloat(),
-					bind_quat_node->Attrib("z")->ValueFloat(), bind_quat_node->Attrib("w")->ValueFloat());
-
-				float scale = MathLib::length(bind_quat);
-				bind_quat /= scale;
+		}
 
-				joint.bind_dual = MathLib::quat_trans_to_udq(bind_quat, bind_pos);
-				joint.bind_real = bind_quat * scale;
-				joint.bind_scale = scale;
-			}
-			else
+		// The node names of a bone and a key are different
+		void Read(XMLReader& reader, char const * pos_name, char const * quat_name)
+		{
+			uint32_t const depth = reader.Depth();
+			while (reader.ReadChild(depth))
 			{
-				XMLNodePtr bind_real_node = bone_node->FirstNode("real");
-				if (!bind_real_node)
+				std::string const & name = reader.Name();
+				if (!has_pos && (pos_name == name))
 				{
-					bind_real_node = bone_node->FirstNode("bind_real");
+					ReadFVector<3>(reader, "xyz", &pos[0]);
+					has_pos = true;
 				}
-				XMLAttributePtr attr = bind_real_node->Attrib("v");
-				if (attr)
+				else if (!has_quat && (quat_name == name))
 				{
-					ExtractFVector<4>(attr->ValueString(), &joint.bind_real[0]);
+					ReadFVector<4>(reader, "xyzw", &quat[0]);
+					has_quat = true;
 				}
-				else
+				else if (!has_real && ("real" == name))
 				{
-					joint.bind_real.x() = bind_real_node->Attrib("x")->ValueFloat();
-					joint.bind_real.y() = bind_real_node->Attrib("y")->ValueFloat();
-					joint.bind_real.z() = bind_real_node->Attrib("z")->ValueFloat();
-					joint.bind_real.w() = bind_real_node->Attrib("w")->ValueFloat();
+					ReadFVector<4>(reader, "xyzw", &real[0]);
+					has_real = true;
 				}
-
-				XMLNodePtr bind_dual_node = bone_node->FirstNode("dual");
-				if (!bind_dual_node)
+				else if (!has_bind_real && ("bind_real" == name))
 				{
-					bind_dual_node = bone_node->FirstNode("bind_dual");
+					ReadFVector<4>(reader, "xyzw", &bind_real[0]);
+					has_bind_real = true;
 				}
-				attr = bind_dual_node->Attrib("v");
-				if (attr)
+				else if (!has_dual && ("dual" == name))
 				{
-					ExtractFVector<4>(attr->ValueString(), &joint.bind_dual[0]);
+					ReadFVector<4>(reader, "xyzw", &dual[0]);
+					has_dual = true;
 				}
-				else
+				else if (!has_bind_dual && ("bind_dual" == name))
 				{
-					joint.bind_dual.x() = bind_dual_node->Attrib("x")->ValueFloat();
-					joint.bind_dual.y() = bind_dual_node->Attrib("y")->ValueFloat();
-					joint.bind_dual.z() = bind_dual_node->Attrib("z")->ValueFloat();
-					joint.bind_dual.w() = bind_dual_node->Attrib("w")->ValueFloat();
+					ReadFVector<4>(reader, "xyzw", &bind_dual[0]);
+					has_bind_dual = true;
 				}
+			}
+		}
+
+		void DualQuat(Quaternion& real_out, Quaternion& dual_out, float& scale_out) const
+		{
+			if (has_pos)
+			{
+				real_out = quat;
+				scale_out = MathLib::length(real_out);
+				real_out /= scale_out;
+
+				dual_out = MathLib::quat_trans_to_udq(real_out, pos);
+			}
+			else
+			{
+				real_out = has_real ? real : bind_real;
+				dual_out = has_dual ? dual : bind_dual;
 
-				joint.bind_scale = MathLib::length(joint.bind_real);
-				joint.bind_real /= joint.bind_scale;
-				if (MathLib::SignBit(joint.bind_real.w()) < 0)
+				scale_out = MathLib::length(real_out);
+				real_out /= scale_out;
+				if (MathLib::SignBit(real_out.w()) < 0)
 				{
-					joint.bind_real = -joint.bind_real;
-					joint.bind_scale = -joint.bind_scale;
+					real_out = -real_out;
+					scale_out = -scale_out;
 				}
 			}
+		}
+
+		float3 pos;
+		Quaternion quat;
+		Quaternion real;
+		Quaternion bind_real;
+		Quaternion dual;
+		Quaternion bind_dual;
+
+		bool has_pos;
+		bool has_quat;
+		bool has_real;
+		bool has_bind_real;
+		bool has_dual;
+		bool has_bind_dual;
+	};
+
+	void CompileBonesChunk(XMLReader& reader,
+		std::vector<Joint>& joints)
+	{
+		Joint joint;
+		uint32_t const chunk_depth = reader.Depth();
+		while (reader.ReadChild(chunk_depth))
+		{
+			if (reader.Name() != "bone")
+			{
+				continue;
+			}
+
+			joint.name = reader.AttribString("name", "");
+			joint.parent = static_cast<int16_t>(reader.AttribInt("parent", -1));
+
+			DualQuaternionNodes nodes;
+			nodes.Read(reader, "bind_pos", "bind_quat");
+			if (nodes.has_pos)
+			{
+				Quaternion bind_quat = nodes.quat;
+				float scale = MathLib::length(bind_quat);
+				bind_quat /= scale;
+
+				joint.bind_dual = MathLib::quat_trans_to_udq(bind_quat, nodes.pos);
+				joint.bind_real = bind_quat * scale;
+				joint.bind_scale = scale;
+			}
+			else
+			{
+				nodes.DualQuat(joint.bind_real, joint.bind_dual, joint.bind_scale);
+			}
 
 			joints.push_back(joint);
 		}
 	}
 
-	void CompileKeyFramesChunk(XMLNodePtr const & key_frames_chunk,
+	// Key frames of one joint. The joint ids are only resolved after the whole file is read, because the bones might
+	// come later.
+	struct JointKeyFrames
+	{
+		uint32_t joint_id;
+		KeyFrames kfs;
+	};
+
+	void CompileKeyFramesChunk(XMLReader& reader,
 		uint32_t& num_frames, uint32_t& frame_rate,
-		std::vector<KeyFrames>& kfss)
+		std::vector<JointKeyFrames>& joint_kfss)
 	{
-		XMLAttributePtr nf_attr = key_frames_chunk->Attrib("num_frames");
-		if (nf_attr)
+		if (reader.HasAttrib("num_frames"))
 		{
-			num_frames = nf_attr->ValueUInt();
+			num_frames = reader.AttribUInt("num_frames", 0);
 		}
 		else
 		{
-			int32_t start_frame = key_frames_chunk->Attrib("start_frame")->ValueInt();
-			int32_t end_frame = key_frames_chunk->Attrib("end_frame")->ValueInt();
+			int32_t start_frame = reader.AttribInt("start_frame", 0);
+			int32_t end_frame = reader.AttribInt("end_frame", 0);
 			num_frames = end_frame - start_frame;
 		}
-		frame_rate = key_frames_chunk->Attrib("frame_rate")->ValueUInt();
+		frame_rate = reader.AttribUInt("frame_rate", 0);
 
 		uint32_t joint_id = 0;
-		for (XMLNodePtr kf_node = key_frames_chunk->FirstNode("key_frame"); kf_node; kf_node = kf_node->NextSibling("key_frame"))
+		uint32_t const chunk_depth = reader.Depth();
+		while (reader.ReadChild(chunk_depth))
 		{
-			XMLAttributePtr joint_attr = kf_node->Attrib("joint");
-			if (joint_attr)
+			if (reader.Name() != "key_frame")
+			{
+				continue;
+			}
+
+			if (reader.HasAttrib("joint"))
 			{
-				joint_id = joint_attr->ValueUInt();
+				joint_id = reader.AttribUInt("joint", 0);
 			}
 			else
 			{
 				++ joint_id;
 			}
-			KeyFrames& kfs = kfss[joint_id];
-
-			kfs.frame_id.clear();
-			kfs.bind_real.clear();
-			kfs.bind_dual.clear();
-			kfs.bind_scale.clear();
+			joint_kfss.emplace_back();
+			joint_kfss.back().joint_id = joint_id;
+			KeyFrames& kfs = joint_kfss.back().kfs;
 
 			int32_t frame_id = -1;
-			for (XMLNodePtr key_node = kf_node->FirstNode("key"); key_node; key_node = key_node->NextSibling("key"))
+			uint32_t const kf_depth = reader.Depth();
+			while (reader.ReadChild(kf_depth))
 			{
-				XMLAttributePtr id_attr = key_node->Attrib("id");
-				if (id_attr)
+				if (reader.Name() != "key")
+				{
+					continue;
+				}
+
+				if (reader.HasAttrib("id"))
 				{
-					frame_id = id_attr->ValueInt();
+					frame_id = reader.AttribInt("id", 0);
 				}
 				else
 				{
@@ -1548,188 +1793,125 @@ namespace
 				}
 				kfs.frame_id.push_back(frame_id);
 
+				DualQuaternionNodes nodes;
+				nodes.Read(reader, "pos", "quat");
+
 				Quaternion bind_real, bind_dual;
 				float bind_scale;
-				XMLNodePtr pos_node = key_node->FirstNode("pos");
-				if (pos_node)
-				{
-					float3 bind_pos(pos_node->Attrib("x")->ValueFloat(), pos_node->Attrib("y")->ValueFloat(),
-						pos_node->Attrib("z")->ValueFloat());
-
-					XMLNodePtr quat_node = key_node->FirstNode("quat");
-					bind_real = Quaternion(quat_node->Attrib("x")->ValueFloat(), quat_node->Attrib("y")->ValueFloat(),
-						quat_node->Attrib("z")->ValueFloat(), quat_node->Attrib("w")->ValueFloat());
-
-					bind_scale = MathLib::length(bind_real);
-					bind_real /= bind_scale;
-
-					bind_dual = MathLib::quat_trans_to_udq(bind_real, bind_pos);
-				}
-				else
-				{
-					XMLNodePtr bind_real_node = key_node->FirstNode("real");
-					if (!bind_real_node)
-					{
-						bind_real_node = key_node->FirstNode("bind_real");
-					}
-					XMLAttributePtr attr = bind_real_node->Attrib("v");
-					if (attr)
-					{
-						ExtractFVector<4>(attr->ValueString(), &bind_real[0]);
-					}
-					else
-					{
-						bind_real.x() = bind_real_node->Attrib("x")->ValueFloat();
-						bind_real.y() = bind_real_node->Attrib("y")->ValueFloat();
-						bind_real.z() = bind_real_node->Attrib("z")->ValueFloat();
-						bind_real.w() = bind_real_node->Attrib("w")->ValueFloat();
-					}
-							
-					XMLNodePtr bind_dual_node = key_node->FirstNode("dual");
-					if (!bind_dual_node)
-					{
-						bind_dual_node = key_node->FirstNode("bind_dual");
-					}
-					attr = bind_dual_node->Attrib("v");
-					if (attr)
-					{
-						ExtractFVector<4>(attr->ValueString(), &bind_dual[0]);
-					}
-					else
-					{
-						bind_dual.x() = bind_dual_node->Attrib("x")->ValueFloat();
-						bind_dual.y() = bind_dual_node->Attrib("y")->ValueFloat();
-						bind_dual.z() = bind_dual_node->Attrib("z")->ValueFloat();
-						bind_dual.w() = bind_dual_node->Attrib("w")->ValueFloat();
-					}
-
-					bind_scale = MathLib::length(bind_real);
-					bind_real /= bind_scale;
-					if (MathLib::SignBit(bind_real.w()) < 0)
-					{
-						bind_real = -bind_real;
-						bind_scale = -bind_scale;
-					}
-				}
+				nodes.DualQuat(bind_real, bind_dual, bind_scale);
 
 				kfs.bind_real.push_back(bind_real);
 				kfs.bind_dual.push_back(bind_dual);
 				kfs.bind_scale.push_back(bind_scale);
 			}
+		}
+	}
 
-			kfss.push_back(kfs);
+	// Every key frame record replaces the key frames of its joint, and is also appended after all the joints
+	void ResolveKeyFrames(std::vector<JointKeyFrames> const & joint_kfss, std::vector<KeyFrames>& kfss)
+	{
+		for (auto const & joint_kfs : joint_kfss)
+		{
+			kfss[joint_kfs.joint_id] = joint_kfs.kfs;
+			kfss.push_back(joint_kfs.kfs);
 		}
 	}
 
-	void CompileBBKeyFramesChunk(XMLNodePtr const & bb_kfs_chunk,
-		std::vector<AABBox> const & pos_bbs, uint32_t num_frames,
+	void CompileBBKeyFramesChunk(XMLReader& reader,
 		std::vector<AABBKeyFrames>& bb_kfss)
 	{
 		AABBKeyFrames bb_kfs;
-		if (bb_kfs_chunk)
+		uint32_t const chunk_depth = reader.Depth();
+		while (reader.ReadChild(chunk_depth))
 		{
-			for (XMLNodePtr bb_kf_node = bb_kfs_chunk->FirstNode("bb_key_frame"); bb_kf_node; bb_kf_node = bb_kf_node->NextSibling("bb_key_frame"))
+			if (reader.Name() != "bb_key_frame")
 			{
-				bb_kfs.frame_id.clear();
-				bb_kfs.bb.clear();
+				continue;
+			}
 
-				int32_t frame_id = -1;
-				for (XMLNodePtr key_node = bb_kf_node->FirstNode("key"); key_node; key_node = key_node->NextSibling("key"))
-				{
-					XMLAttributePtr id_attr = key_node->Attrib("id");
-					if (id_attr)
-					{
-						frame_id = id_attr->ValueInt();
-					}
-					else
-					{
-						++ frame_id;
-					}
-					bb_kfs.frame_id.push_back(frame_id);
+			bb_kfs.frame_id.clear();
+			bb_kfs.bb.clear();
 
-					float3 bb_min, bb_max;
-					XMLAttributePtr attr = key_node->Attrib("min");
-					if (attr)
-					{
-						ExtractFVector<3>(attr->ValueString(), &bb_min[0]);
-					}
-					else
-					{
-						XMLNodePtr min_node = key_node->FirstNode("min");
-						bb_min.x() = min_node->Attrib("x")->ValueFloat();
-						bb_min.y() = min_node->Attrib("y")->ValueFloat();
-						bb_min.z() = min_node->Attrib("z")->ValueFloat();
-					}
-					attr = key_node->Attrib("max");
-					if (attr)
-					{
-						ExtractFVector<3>(attr->ValueString(), &bb_max[0]);
-					}
-					else
-					{
-						XMLNodePtr max_node = key_node->FirstNode("max");
-						bb_max.x() = max_node->Attrib("x")->ValueFloat();
-						bb_max.y() = max_node->Attrib("y")->ValueFloat();
-						bb_max.z() = max_node->Attrib("z")->ValueFloat();
-					}
+			int32_t frame_id = -1;
+			uint32_t const kf_depth = reader.Depth();
+			while (reader.ReadChild(kf_depth))
+			{
+				if (reader.Name() != "key")
+				{
+					continue;
+				}
 
-					bb_kfs.bb.push_back(AABBox(bb_min, bb_max));
+				if (reader.HasAttrib("id"))
+				{
+					frame_id = reader.AttribInt("id", 0);
+				}
+				else
+				{
+					++ frame_id;
 				}
+				bb_kfs.frame_id.push_back(frame_id);
 
-				bb_kfss.push_back(bb_kfs);
+				float3 bb_min, bb_max;
+				ReadBoundingBox<3>(reader, &bb_min[0], &bb_max[0]);
+				bb_kfs.bb.push_back(AABBox(bb_min, bb_max));
 			}
+
+			bb_kfss.push_back(bb_kfs);
 		}
-		else
-		{
-			bb_kfs.frame_id.resize(2);
-			bb_kfs.bb.resize(2);
+	}
 
-			bb_kfs.frame_id[0] = 0;
-			bb_kfs.frame_id[1] = num_frames - 1;
+	// Without a bb_key_frames_chunk, the bounding boxes of the meshes are used for all frames
+	void DefaultBBKeyFrames(std::vector<AABBox> const & pos_bbs, uint32_t num_frames,
+		std::vector<AABBKeyFrames>& bb_kfss)
+	{
+		AABBKeyFrames bb_kfs;
+		bb_kfs.frame_id.resize(2);
+		bb_kfs.bb.resize(2);
 
-			for (uint32_t mesh_index = 0; mesh_index < pos_bbs.size(); ++ mesh_index)
-			{
-				bb_kfs.bb[0] = pos_bbs[mesh_index];
-				bb_kfs.bb[1] = pos_bbs[mesh_index];
+		bb_kfs.frame_id[0] = 0;
+		bb_kfs.frame_id[1] = num_frames - 1;
 
-				bb_kfss.push_back(bb_kfs);
-			}
+		for (uint32_t mesh_index = 0; mesh_index < pos_bbs.size(); ++ mesh_index)
+		{
+			bb_kfs.bb[0] = pos_bbs[mesh_index];
+			bb_kfs.bb[1] = pos_bbs[mesh_index];
+
+			bb_kfss.push_back(bb_kfs);
 		}
 	}
 
-	void CompileActionsChunk(XMLNodePtr const & actions_chunk,
-		uint32_t num_frames,
+	void CompileActionsChunk(XMLReader& reader,
 		std::vector<AnimationAction>& actions)
 	{
-		XMLNodePtr action_node;
-		if (actions_chunk)
-		{
-			action_node = actions_chunk->FirstNode("action");
-		}
-
 		AnimationAction action;
-		if (action_node)
+		uint32_t const chunk_depth = reader.Depth();
+		while (reader.ReadChild(chunk_depth))
 		{
-			for (; action_node; action_node = action_node->NextSibling("action"))
+			if (reader.Name() != "action")
 			{
-				action.name = action_node->Attrib("name")->ValueString();
+				continue;
+			}
 
-				action.start_frame = action_node->Attrib("start")->ValueUInt();
-				action.end_frame = action_node->Attrib("end")->ValueUInt();
+			action.name = reader.AttribString("name", "");
 
-				actions.push_back(action);
-			}
-		}
-		else
-		{
-			action.name = "root";
-			action.start_frame = 0;
-			action.end_frame = num_frames;
+			action.start_frame = reader.AttribUInt("start", 0);
+			action.end_frame = reader.AttribUInt("end", 0);
 
 			actions.push_back(action);
 		}
 	}
 
+	// The root action covers all frames, if there are no actions
+	void DefaultActions(uint32_t num_frames, std::vector<AnimationAction>& actions)
+	{
+		AnimationAction action;
+		action.name = "root";
+		action.start_frame = 0;
+		action.end_frame = num_frames;
+
+		actions.push_back(action);
+	}
+
 	void WriteMaterialsChunk(std::vector<OfflineRenderMaterial> const & mtls, std::ostream& os)
 	{
 		for (size_t i = 0; i < mtls.size(); ++ i)
@@ -1801,6 +1983,7 @@ namespace
 		std::vector<AABBox> const & pos_bbs, std::vector<AABBox> const & tc_bbs,
 		std::vector<uint32_t> const & mesh_num_vertices, std::vector<uint32_t> const & mesh_base_vertices,
 		std::vector<uint32_t> const & mesh_num_indices, std::vector<uint32_t> const & mesh_start_indices,
+		std::vector<std::vector<MeshLod>> const & mesh_lods,
 		std::vector<VertexElement> const & merged_ves,
 		std::vector<std::vector<uint8_t>> const & merged_vertices, std::vector<uint8_t> const & merged_indices,
 		char is_index_16_bit, std::ostream& os)
@@ -1817,7 +2000,7 @@ namespace
 
 		uint32_t num_vertices = Native2LE(mesh_base_vertices.back());
 		os.write(reinterpret_cast<char*>(&num_vertices), sizeof(num_vertices));
-		uint32_t num_indices = Native2LE(mesh_start_indices.back());
+		uint32_t num_indices = Native2LE(static_cast<uint32_t>(merged_indices.size() / (is_index_16_bit ? 2 : 4)));
 		os.write(reinterpret_cast<char*>(&num_indices), sizeof(num_indices));
 		os.write(&is_index_16_bit, sizeof(is_index_16_bit));
 
@@ -1862,6 +2045,18 @@ namespace
 			os.write(reinterpret_cast<char*>(&ni), sizeof(ni));
 			uint32_t si = Native2LE(mesh_start_indices[mesh_index]);
 			os.write(reinterpret_cast<char*>(&si), sizeof(si));
+
+			uint32_t num_lods = Native2LE(static_cast<uint32_t>(mesh_lods[mesh_index].size()));
+			os.write(reinterpret_cast<char*>(&num_lods), sizeof(num_lods));
+			for (auto const & lod : mesh_lods[mesh_index])
+			{
+				uint32_t lod_ni = Native2LE(lod.num_indices);
+				os.write(reinterpret_cast<char*>(&lod_ni), sizeof(lod_ni));
+				uint32_t lod_si = Native2LE(lod.start_index_location);
+				os.write(reinterpret_cast<char*>(&lod_si), sizeof(lod_si));
+				float lod_error = Native2LE(lod.error);
+				os.write(reinterpret_cast<char*>(&lod_error), sizeof(lod_error));
+			}
 		}
 	}
 
@@ -1964,7 +2159,106 @@ namespace
 		}
 	}
 
-	void ConvertTextures(std::string const & output_name, std::vector<OfflineRenderMaterial>& mtls, std::string const & platform)
+	std::mutex output_mutex;
+
+	std::mutex texture_outputs_mutex;
+	std::map<std::string, std::shared_future<void>> texture_outputs;
+
+	// Makes a texture file once per process. Models sharing a texture in a batch wait for the first one making it.
+	void MakeTextureOutput(std::string const & output, std::function<void()> const & make)
+	{
+		std::shared_future<void> made;
+		std::unique_ptr<std::promise<void>> promise;
+		{
+			std::lock_guard<std::mutex> lock(texture_outputs_mutex);
+			auto iter = texture_outputs.find(output);
+			if (iter == texture_outputs.end())
+			{
+				promise = MakeUniquePtr<std::promise<void>>();
+				texture_outputs.emplace(output, promise->get_future().share());
+			}
+			else
+			{
+				made = iter->second;
+			}
+		}
+
+		if (promise)
+		{
+			try
+			{
+				make();
+				promise->set_value();
+			}
+			catch (...)
+			{
+				promise->set_exception(std::current_exception());
+				throw;
+			}
+		}
+		else
+		{
+			made.get();
+		}
+	}
+
+	// The last task runs on the calling thread. The pool makes more threads when it runs out, so tasks can wait for
+	// outputs made by other tasks.
+	void RunTasks(thread_pool& tp, std::vector<std::function<void()>> const & tasks)
+	{
+		std::vector<joiner<void>> joiners;
+		for (size_t i = 1; i < tasks.size(); ++ i)
+		{
+			joiners.push_back(tp(tasks[i]));
+		}
+
+		// All tasks are done before the first failure is rethrown, none of them outlives the inputs
+		std::exception_ptr failure;
+		if (!tasks.empty())
+		{
+			try
+			{
+				tasks[0]();
+			}
+			catch (...)
+			{
+				failure = std::current_exception();
+			}
+		}
+		for (auto& joiner : joiners)
+		{
+			try
+			{
+				joiner();
+			}
+			catch (...)
+			{
+				if (!failure)
+				{
+					failure = std::current_exception();
+				}
+			}
+		}
+		if (failure)
+		{
+			std::rethrow_exception(failure);
+		}
+	}
+
+	void RunCommand(std::string const & cmd)
+	{
+		if (system(cmd.c_str()) != 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(output_mutex);
+				cout << "Failed: " << cmd << endl;
+			}
+			TMSG("Failed: " + cmd);
+		}
+	}
+
+	void ConvertTextures(std::string const & output_name, std::vector<OfflineRenderMaterial>& mtls, std::string const & platform,
+		thread_pool& tp)
 	{
 		std::map<filesystem::path, std::vector<std::pair<size_t, size_t>>> all_texture_slots;
 		for (size_t i = 0; i < mtls.size(); ++ i)
@@ -1976,19 +2270,27 @@ namespace
 		}
 
 		std::vector<std::pair<filesystem::path, std::string>> deploy_files;
+		std::vector<std::function<void()>> texconv_tasks;
 		for (auto const & slot : all_texture_slots)
 		{
 			std::string ext_name = slot.first.extension().string();
 			if (ext_name != ".dds")
 			{
-				std::string cmd = "texconv -f A8B8G8R8 -ft DDS -m 1 \"" + slot.first.string() + "\"";
-				system(cmd.c_str());
+				std::string const cmd = "texconv -f A8B8G8R8 -ft DDS -m 1 \"" + slot.first.string() + "\"";
+				texconv_tasks.push_back([cmd]
+					{
+						MakeTextureOutput(cmd, [&cmd]
+							{
+								RunCommand(cmd);
+							});
+					});
 
 				std::string tex_base = (slot.first.parent_path() / slot.first.stem()).string();
 				deploy_files.emplace_back(filesystem::path(tex_base + ".dds"),
 					mtls[slot.second[0].first].texture_slots[slot.second[0].second].first);
 			}
 		}
+		RunTasks(tp, texconv_tasks);
 
 		std::vector<std::pair<filesystem::path, filesystem::path>> dup_files;
 		std::map<filesystem::path, std::vector<std::pair<size_t, size_t>>> augmented_texture_slots;
@@ -2028,9 +2330,13 @@ namespace
 
 		for (auto const & dup : dup_files)
 		{
-			filesystem::copy_file(std::get<0>(dup), std::get<1>(dup));
+			MakeTextureOutput(std::get<1>(dup).string(), [&dup]
+				{
+					filesystem::copy_file(std::get<0>(dup), std::get<1>(dup));
+				});
 		}
 
+		std::vector<std::function<void()>> deploy_tasks;
 		for (auto const & df : deploy_files)
 		{
 			std::string deploy_type;
@@ -2071,11 +2377,22 @@ namespace
 				deploy_type = df.second;
 			}
 
-			cout << "Processing " << df.first.string() << endl;
+			std::string const name = df.first.string();
+			std::string const cmd = "platformdeployer -P " + platform + " -I \"" + name + "\" -T " + deploy_type;
+			deploy_tasks.push_back([name, cmd]
+				{
+					MakeTextureOutput(cmd, [&name, &cmd]
+						{
+							{
+								std::lock_guard<std::mutex> lock(output_mutex);
+								cout << "Processing " << name << endl;
+							}
 
-			std::string cmd = "platformdeployer -P " + platform + " -I \"" + df.first.string() + "\" -T " + deploy_type;
-			system(cmd.c_str());
+							RunCommand(cmd);
+						});
+				});
 		}
+		RunTasks(tp, deploy_tasks);
 
 		filesystem::path output_folder = filesystem::path(output_name).parent_path();
 		for (auto const & slot : augmented_texture_slots)
@@ -2105,24 +2422,102 @@ namespace
 		return ret;
 	}
 
-	void MeshMLJIT(std::string const & meshml_name, std::string const & output_name, std::string const & platform)
+	void MeshMLJIT(std::string const & meshml_name, std::string const & output_name, std::string const & platform,
+		uint32_t num_lods, bool quiet, thread_pool& tp)
 	{
 		std::ostringstream ss;
 
+		// The file is read once without building a DOM. Vertices, indices, joints and key frames go directly to arrays.
 		ResIdentifierPtr file = ResLoader::Instance().Open(meshml_name);
-		KlayGE::XMLDocument doc;
-		XMLNodePtr root = doc.Parse(file);
-
-		BOOST_ASSERT(root->Attrib("version") && (root->Attrib("version")->ValueInt() >= 1));
+		XMLReader reader(file);
+		if (!reader.Read() || !reader.IsStartElement() || (reader.AttribInt("version", 0) < 1))
+		{
+			TMSG("No model element with a version");
+		}
 
-		XMLNodePtr materials_chunk = root->FirstNode("materials_chunk");
+		bool has_materials_chunk = false;
 		std::vector<OfflineRenderMaterial> mtls;
-		if (materials_chunk)
+
+		bool has_meshes_chunk = false;
+		std::vector<std::string> mesh_names;
+		std::vector<int32_t> mtl_ids;
+		std::vector<AABBox> pos_bbs;
+		std::vector<AABBox> tc_bbs;
+		std::vector<uint32_t> mesh_num_vertices;
+		std::vector<uint32_t> mesh_base_vertices;
+		std::vector<uint32_t> mesh_num_indices;
+		std::vector<uint32_t> mesh_start_indices;
+		std::vector<std::vector<MeshLod>> mesh_lods;
+		std::vector<VertexElement> merged_ves;
+		std::vector<std::vector<uint8_t>> merged_vertices;
+		std::vector<uint8_t> merged_indices;
+		char is_index_16_bit = true;
+		std::vector<std::pair<std::string, MeshOptimizationResult>> opt_results;
+		std::vector<MeshQuantizationError> quant_errors;
+
+		bool has_bones_chunk = false;
+		std::vector<Joint> joints;
+
+		bool has_key_frames_chunk = false;
+		uint32_t num_frames = 0;
+		uint32_t frame_rate = 0;
+		std::vector<JointKeyFrames> joint_kfs;
+
+		bool has_bb_key_frames_chunk = false;
+		std::vector<AABBKeyFrames> bb_kfs;
+
+		bool has_actions_chunk = false;
+		std::vector<AnimationAction> actions;
+
+		uint32_t const root_depth = reader.Depth();
+		while (reader.ReadChild(root_depth))
+		{
+			std::string const & name = reader.Name();
+			if (!has_materials_chunk && ("materials_chunk" == name))
+			{
+				// Materials are small, and easier to handle in a DOM
+				KlayGE::XMLDocument doc;
+				XMLNodePtr materials_chunk = doc.Parse(MakeSharedPtr<ResIdentifier>(meshml_name, 0,
+					MakeSharedPtr<std::stringstream>(reader.ReadElementSource())));
+				CompileMaterialsChunk(materials_chunk, mtls);
+				has_materials_chunk = true;
+			}
+			else if (!has_meshes_chunk && ("meshes_chunk" == name))
+			{
+				CompileMeshesChunk(reader, mesh_names, mtl_ids, pos_bbs, tc_bbs,
+					mesh_num_vertices, mesh_base_vertices,
+					mesh_num_indices, mesh_start_indices, mesh_lods,
+					merged_ves, merged_vertices, merged_indices,
+					is_index_16_bit, opt_results, quant_errors, num_lods);
+				has_meshes_chunk = true;
+			}
+			else if (!has_bones_chunk && ("bones_chunk" == name))
+			{
+				CompileBonesChunk(reader, joints);
+				has_bones_chunk = true;
+			}
+			else if (!has_key_frames_chunk && ("key_frames_chunk" == name))
+			{
+				CompileKeyFramesChunk(reader, num_frames, frame_rate, joint_kfs);
+				has_key_frames_chunk = true;
+			}
+			else if (!has_bb_key_frames_chunk && ("bb_key_frames_chunk" == name))
+			{
+				CompileBBKeyFramesChunk(reader, bb_kfs);
+				has_bb_key_frames_chunk = true;
+			}
+			else if (!has_actions_chunk && ("actions_chunk" == name))
+			{
+				CompileActionsChunk(reader, actions);
+				has_actions_chunk = true;
+			}
+		}
+
+		if (has_materials_chunk)
 		{
-			CompileMaterialsChunk(materials_chunk, mtls);
 			if (!platform.empty())
 			{
-				ConvertTextures(output_name, mtls, platform);
+				ConvertTextures(output_name, mtls, platform, tp);
 			}
 
 			for (size_t i = 0; i < mtls.size(); ++ i)
@@ -2165,51 +2560,45 @@ namespace
 			ss.write(reinterpret_cast<char*>(&num_mtls), sizeof(num_mtls));
 		}
 
-		XMLNodePtr meshes_chunk = root->FirstNode("meshes_chunk");
-		std::vector<std::string> mesh_names;
-		std::vector<int32_t> mtl_ids;
-		std::vector<AABBox> pos_bbs;
-		std::vector<AABBox> tc_bbs;
-		std::vector<uint32_t> mesh_num_vertices;
-		std::vector<uint32_t> mesh_base_vertices;
-		std::vector<uint32_t> mesh_num_indices;
-		std::vector<uint32_t> mesh_start_indices;
-		std::vector<VertexElement> merged_ves;
-		std::vector<std::vector<uint8_t>> merged_vertices;
-		std::vector<uint8_t> merged_indices;
-		char is_index_16_bit = true;
-		if (meshes_chunk)
+		if (has_meshes_chunk)
 		{
-			CompileMeshesChunk(meshes_chunk, mesh_names, mtl_ids, pos_bbs, tc_bbs,
-				mesh_num_vertices, mesh_base_vertices,
-				mesh_num_indices, mesh_start_indices,
-				merged_ves, merged_vertices, merged_indices,
-				is_index_16_bit);
+			if (!quiet)
+			{
+				for (size_t i = 0; i < quant_errors.size(); ++ i)
+				{
+					cout << mesh_names[i] << ": Max quantization error position " << quant_errors[i].position
+						<< ", texcoord " << quant_errors[i].tex_coord << ", normal " << quant_errors[i].normal
+						<< " degrees, blend weight " << quant_errors[i].blend_weight << endl;
+				}
+				for (auto const & result : opt_results)
+				{
+					cout << result.first << ": ACMR " << result.second.before.acmr << " -> " << result.second.after.acmr
+						<< ", ATVR " << result.second.before.atvr << " -> " << result.second.after.atvr << endl;
+				}
+				for (size_t i = 0; i < mesh_lods.size(); ++ i)
+				{
+					for (size_t j = 0; j < mesh_lods[i].size(); ++ j)
+					{
+						cout << mesh_names[i] << ": LOD " << j + 1 << ", " << mesh_lods[i][j].num_indices / 3
+							<< " triangles, error " << mesh_lods[i][j].error << endl;
+					}
+				}
+			}
 		}
 		{
 			uint32_t num_meshes = Native2LE(static_cast<uint32_t>(pos_bbs.size()));
 			ss.write(reinterpret_cast<char*>(&num_meshes), sizeof(num_meshes));
 		}
 
-		XMLNodePtr bones_chunk = root->FirstNode("bones_chunk");
-		std::vector<Joint> joints;
-		if (bones_chunk)
-		{
-			CompileBonesChunk(bones_chunk, joints);
-		}
 		{
 			uint32_t num_joints = Native2LE(static_cast<uint32_t>(joints.size()));
 			ss.write(reinterpret_cast<char*>(&num_joints), sizeof(num_joints));
 		}
 
-		XMLNodePtr key_frames_chunk = root->FirstNode("key_frames_chunk");
-		uint32_t num_frames = 0;
-		uint32_t frame_rate = 0;
 		std::vector<KeyFrames> kfs(joints.size());
-		std::vector<AABBKeyFrames> bb_kfs;
-		if (key_frames_chunk)
+		if (has_key_frames_chunk)
 		{
-			CompileKeyFramesChunk(key_frames_chunk, num_frames, frame_rate, kfs);
+			ResolveKeyFrames(joint_kfs, kfs);
 
 			for (size_t i = 0; i < kfs.size(); ++ i)
 			{
@@ -2239,43 +2628,43 @@ namespace
 				}
 			}
 
-			XMLNodePtr bb_kfs_chunk = root->FirstNode("bb_key_frames_chunk");
-			CompileBBKeyFramesChunk(bb_kfs_chunk, pos_bbs, num_frames, bb_kfs);
+			if (!has_bb_key_frames_chunk)
+			{
+				DefaultBBKeyFrames(pos_bbs, num_frames, bb_kfs);
+			}
 		}
 		{
 			uint32_t num_kfs = Native2LE(static_cast<uint32_t>(kfs.size()));
 			ss.write(reinterpret_cast<char*>(&num_kfs), sizeof(num_kfs));
 		}
 
-		XMLNodePtr actions_chunk = root->FirstNode("actions_chunk");
-		std::vector<AnimationAction> actions;
-		if (actions_chunk)
+		if (has_actions_chunk && actions.empty())
 		{
-			CompileActionsChunk(actions_chunk, num_frames, actions);
+			DefaultActions(num_frames, actions);
 		}
 		{
-			uint32_t num_actions = Native2LE(key_frames_chunk ? std::max(static_cast<uint32_t>(actions.size()), 1U) : 0);
+			uint32_t num_actions = Native2LE(has_key_frames_chunk ? std::max(static_cast<uint32_t>(actions.size()), 1U) : 0);
 			ss.write(reinterpret_cast<char*>(&num_actions), sizeof(num_actions));
 		}
 
-		if (materials_chunk)
+		if (has_materials_chunk)
 		{
 			WriteMaterialsChunk(mtls, ss);
 		}
 
-		if (meshes_chunk)
+		if (has_meshes_chunk)
 		{
 			WriteMeshesChunk(mesh_names, mtl_ids, pos_bbs, tc_bbs,
-				mesh_num_vertices, mesh_base_vertices, mesh_num_indices, mesh_start_indices,
+				mesh_num_vertices, mesh_base_vertices, mesh_num_indices, mesh_start_indices, mesh_lods,
 				merged_ves, merged_vertices, merged_indices, is_index_16_bit, ss);
 		}
 
-		if (bones_chunk)
+		if (has_bones_chunk)
 		{
 			WriteBonesChunk(joints, ss);
 		}
 
-		if (key_frames_chunk)
+		if (has_key_frames_chunk)
 		{
 			WriteKeyFramesChunk(num_frames, frame_rate, kfs, ss);
 			WriteBBKeyFramesChunk(bb_kfs, ss);
@@ -2290,19 +2679,312 @@ namespace
 		uint32_t ver = Native2LE(MODEL_BIN_VERSION);
 		ofs.write(reinterpret_cast<char*>(&ver), sizeof(ver));
 
-		uint64_t original_len = Native2LE(static_cast<uint64_t>(ss.str().size()));
+		std::string const uncompressed = ss.str();
+		uint64_t original_len = Native2LE(static_cast<uint64_t>(uncompressed.size()));
 		ofs.write(reinterpret_cast<char*>(&original_len), sizeof(original_len));
 
-		std::ofstream::pos_type p = ofs.tellp();
-		uint64_t len = 0;
-		ofs.write(reinterpret_cast<char*>(&len), sizeof(len));
-
 		LZMACodec lzma;
-		len = lzma.Encode(ofs, ss.str().c_str(), ss.str().size());
+		std::vector<uint8_t> compressed;
+		lzma.Encode(compressed, uncompressed.c_str(), uncompressed.size());
 
-		ofs.seekp(p, std::ios_base::beg);
-		len = Native2LE(len);
+		uint64_t len = Native2LE(static_cast<uint64_t>(compressed.size()));
 		ofs.write(reinterpret_cast<char*>(&len), sizeof(len));
+		ofs.write(reinterpret_cast<char const *>(compressed.data()), compressed.size());
+
+		if (!quiet)
+		{
+			uint64_t vertex_bytes = 0;
+			for (auto const & vertices : merged_vertices)
+			{
+				vertex_bytes += vertices.size();
+			}
+
+			// Decompression is most of the loading time of a model
+			Timer timer;
+			std::vector<uint8_t> decoded;
+			lzma.Decode(decoded, compressed.data(), compressed.size(), uncompressed.size());
+			double const decode_time = timer.elapsed();
+
+			cout << "File size " << static_cast<uint64_t>(ofs.tellp()) << " bytes, " << uncompressed.size()
+				<< " bytes uncompressed with " << vertex_bytes << " bytes of vertices in "
+				<< (mesh_base_vertices.empty() ? 0 : mesh_base_vertices.back()) << " vertices. Decompressed in "
+				<< decode_time * 1000 << " ms." << endl;
+		}
+	}
+
+	// Bump it when the output changes without a change in the inputs, to rebuild everything
+	uint32_t const MANIFEST_VERSION = 1;
+
+	struct ModelJob
+	{
+		std::string meshml_name;
+		std::string output_name;
+
+		std::vector<std::string> texture_names;
+		std::string digest;
+
+		bool built;
+	};
+
+	std::string ReadResource(std::string const & name)
+	{
+		std::string ret;
+		ResIdentifierPtr res = ResLoader::Instance().Open(name);
+		if (res)
+		{
+			ret.assign(std::istreambuf_iterator<char>(res->input_stream()), std::istreambuf_iterator<char>());
+		}
+		return ret;
+	}
+
+	// The textures referenced by the materials, without duplicates
+	void CollectTextures(std::string const & meshml_name, std::vector<std::string>& texture_names)
+	{
+		ResIdentifierPtr file = ResLoader::Instance().Open(meshml_name);
+		if (!file)
+		{
+			return;
+		}
+
+		// Stops at the materials, the meshes after them are never parsed
+		XMLReader reader(file);
+		if (!reader.Read())
+		{
+			return;
+		}
+		uint32_t const root_depth = reader.Depth();
+		while (reader.ReadChild(root_depth))
+		{
+			if ("materials_chunk" == reader.Name())
+			{
+				KlayGE::XMLDocument doc;
+				XMLNodePtr materials_chunk = doc.Parse(MakeSharedPtr<ResIdentifier>(meshml_name, 0,
+					MakeSharedPtr<std::stringstream>(reader.ReadElementSource())));
+
+				std::vector<OfflineRenderMaterial> mtls;
+				CompileMaterialsChunk(materials_chunk, mtls);
+				for (auto const & mtl : mtls)
+				{
+					for (auto const & slot : mtl.texture_slots)
+					{
+						if (std::find(texture_names.begin(), texture_names.end(), slot.second) == texture_names.end())
+						{
+							texture_names.push_back(slot.second);
+						}
+					}
+				}
+				break;
+			}
+		}
+	}
+
+	// Texture names in a meshml are relative to it. A texture with the same name next to another model of the batch is
+	// another texture.
+	std::string ReadTexture(std::string const & meshml_name, std::string const & texture_name)
+	{
+		filesystem::path texture_path(texture_name);
+		if (!texture_path.is_absolute())
+		{
+			texture_path = filesystem::path(meshml_name).parent_path() / texture_path;
+		}
+
+		std::ifstream ifs(texture_path.string().c_str(), std::ios_base::binary);
+		return std::string(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+	}
+
+	// Covers the meshml, the content of its textures, the options and the model_bin version
+	std::string InputDigest(std::string const & platform, uint32_t num_lods, ModelJob const & job)
+	{
+		BuildDigest digest;
+		digest.AddValue(MODEL_BIN_VERSION).AddValue(MANIFEST_VERSION).AddString(platform).AddValue(num_lods);
+		digest.AddString(ReadResource(job.meshml_name));
+		for (auto const & texture_name : job.texture_names)
+		{
+			digest.AddString(texture_name).AddString(ReadTexture(job.meshml_name, texture_name));
+		}
+		return digest.Str();
+	}
+
+	// A model_bin cut short by a crash or a full disk isn't a converted model
+	bool ModelBinComplete(std::string const & name)
+	{
+		std::ifstream ifs(name.c_str(), std::ios_base::binary);
+
+		uint32_t fourcc = 0;
+		ifs.read(reinterpret_cast<char*>(&fourcc), sizeof(fourcc));
+		uint32_t ver = 0;
+		ifs.read(reinterpret_cast<char*>(&ver), sizeof(ver));
+		uint64_t original_len = 0;
+		ifs.read(reinterpret_cast<char*>(&original_len), sizeof(original_len));
+		uint64_t len = 0;
+		ifs.read(reinterpret_cast<char*>(&len), sizeof(len));
+		if (!ifs || (LE2Native(fourcc) != MakeFourCC<'K', 'L', 'M', ' '>::value) || (LE2Native(ver) != MODEL_BIN_VERSION))
+		{
+			return false;
+		}
+
+		uint64_t const header_len = sizeof(fourcc) + sizeof(ver) + sizeof(original_len) + sizeof(len);
+		ifs.seekg(0, std::ios_base::end);
+		return static_cast<uint64_t>(ifs.tellg()) == header_len + LE2Native(len);
+	}
+
+	// A directory means all the .meshml files in it, anything else is a text file with one model per line
+	std::vector<std::string> CollectBatchFiles(std::string const & batch)
+	{
+		std::vector<std::string> ret;
+		if (filesystem::is_directory(batch))
+		{
+			for (filesystem::directory_iterator iter(batch), end; iter != end; ++ iter)
+			{
+				std::string ext = iter->path().extension().string();
+				boost::algorithm::to_lower(ext);
+				if (filesystem::is_regular_file(iter->path()) && (".meshml" == ext))
+				{
+					ret.push_back(iter->path().string());
+				}
+			}
+		}
+		else
+		{
+			std::ifstream ifs(batch.c_str());
+			std::string line;
+			while (std::getline(ifs, line))
+			{
+				boost::algorithm::trim(line);
+				if (!line.empty())
+				{
+					std::string const file = ResLoader::Instance().Locate(line);
+					if (file.empty())
+					{
+						cout << "Couldn't locate " << line << endl;
+					}
+					else
+					{
+						ret.push_back(file);
+					}
+				}
+			}
+		}
+
+		return ret;
+	}
+
+	// Models are independent, so they are converted on all cores. Their textures are converted concurrently too, and a
+	// texture shared by several models is converted once.
+	int ConvertBatch(std::string const & batch, filesystem::path const & target_folder, std::string const & platform,
+		uint32_t num_lods, bool use_cache)
+	{
+		Timer timer;
+
+		std::vector<std::string> const meshml_names = CollectBatchFiles(batch);
+		if (meshml_names.empty())
+		{
+			cout << "No model to convert." << endl;
+			return 1;
+		}
+
+		filesystem::path manifest_folder = target_folder;
+		if (manifest_folder.empty())
+		{
+			manifest_folder = filesystem::is_directory(batch) ? filesystem::path(batch) : filesystem::path(batch).parent_path();
+		}
+		else
+		{
+			filesystem::create_directories(target_folder);
+		}
+		// -N converts everything, the digests are still recorded for the next run
+		BuildManifest manifest((manifest_folder
+			/ ("MeshMLJIT" + (platform.empty() ? std::string() : "_" + platform) + ".manifest")).string(),
+			"MeshMLJIT manifest " + std::to_string(MANIFEST_VERSION));
+
+		std::vector<ModelJob> jobs(meshml_names.size());
+		std::vector<uint32_t> dirty_jobs;
+		for (size_t i = 0; i < meshml_names.size(); ++ i)
+		{
+			ModelJob& job = jobs[i];
+			job.meshml_name = meshml_names[i];
+
+			filesystem::path const meshml_path(job.meshml_name);
+			job.output_name = ((target_folder.empty() ? meshml_path.parent_path() : target_folder)
+				/ meshml_path.filename()).string() + JIT_EXT_NAME;
+
+			// A malformed model fails on its own when it's converted
+			try
+			{
+				CollectTextures(job.meshml_name, job.texture_names);
+			}
+			catch (std::exception const & e)
+			{
+				cout << job.meshml_name << ": " << e.what() << endl;
+			}
+			job.digest = InputDigest(platform, num_lods, job);
+
+			job.built = use_cache && manifest.UpToDate(job.meshml_name, job.digest) && ModelBinComplete(job.output_name);
+			if (job.built)
+			{
+				cout << "Up to date: " << job.meshml_name << endl;
+			}
+			else
+			{
+				dirty_jobs.push_back(static_cast<uint32_t>(i));
+			}
+		}
+
+		if (!dirty_jobs.empty())
+		{
+			std::atomic<uint32_t> num_done(0);
+			thread_pool tp(1, CPUInfo().NumHWThreads());
+			uint32_t const num_threads = std::min(static_cast<uint32_t>(CPUInfo().NumHWThreads()),
+				static_cast<uint32_t>(dirty_jobs.size()));
+			parallel_for(tp, num_threads, static_cast<uint32_t>(dirty_jobs.size()), [&](uint32_t i)
+				{
+					ModelJob& job = jobs[dirty_jobs[i]];
+
+					// Failed textures throw too, the model refers to them
+					try
+					{
+						// An old model_bin must not look like the result of this conversion
+						if (filesystem::exists(job.output_name))
+						{
+							filesystem::remove(job.output_name);
+						}
+
+						MeshMLJIT(job.meshml_name, job.output_name, platform, num_lods, true, tp);
+						job.built = ModelBinComplete(job.output_name);
+					}
+					catch (std::exception const & e)
+					{
+						std::lock_guard<std::mutex> lock(output_mutex);
+						cout << job.meshml_name << ": " << e.what() << endl;
+						job.built = false;
+					}
+
+					uint32_t const done = ++ num_done;
+					std::lock_guard<std::mutex> lock(output_mutex);
+					cout << "[" << done << "/" << dirty_jobs.size() << "] " << (job.built ? "" : "Failed: ")
+						<< job.meshml_name << endl;
+				});
+		}
+
+		// Failed models are converted again next time. Entries of models not in this batch are kept.
+		uint32_t num_failed = 0;
+		for (auto const & job : jobs)
+		{
+			if (job.built)
+			{
+				manifest.Built(job.meshml_name, job.digest, job.texture_names);
+			}
+			else
+			{
+				manifest.Failed(job.meshml_name);
+				++ num_failed;
+			}
+		}
+		manifest.Save();
+		cout << dirty_jobs.size() - num_failed << " converted, " << jobs.size() - dirty_jobs.size() << " up to date, "
+			<< num_failed << " failed in " << timer.elapsed() << " s." << endl;
+
+		return (0 == num_failed) ? 0 : 1;
 	}
 }
 
@@ -2311,7 +2993,10 @@ int main(int argc, char* argv[])
 	std::string input_name;
 	filesystem::path target_folder;
 	std::string platform;
+	uint32_t num_lods = 0;
 	bool quiet = false;
+	std::string batch;
+	bool use_cache = true;
 
 	boost::program_options::options_description desc("Allowed options");
 	desc.add_options()
@@ -2319,7 +3004,11 @@ int main(int argc, char* argv[])
 		("input-name,I", boost::program_options::value<std::string>(), "Input meshml name.")
 		("target-folder,T", boost::program_options::value<std::string>(), "Target folder.")
 		("platform,P", boost::program_options::value<std::string>()->implicit_value(""), "Platform name.")
+		("lods,L", boost::program_options::value<uint32_t>(), "Number of LOD levels to generate, each with half of the triangles.")
 		("quiet,q", boost::program_options::value<bool>()->implicit_value(true), "Quiet mode.")
+		("batch,B", boost::program_options::value<std::string>(),
+			"Convert all meshml files in a directory, or listed in a text file. Unchanged models are skipped.")
+		("no-cache,N", "Convert all models in the batch, even unchanged ones.")
 		("version,v", "Version.");
 
 	boost::program_options::variables_map vm;
@@ -2333,14 +3022,22 @@ int main(int argc, char* argv[])
 	}
 	if (vm.count("version") > 0)
 	{
-		cout << "KlayGE MeshMLJIT, Version 1.0.0" << endl;
+		cout << "KlayGE MeshMLJIT, Version 1.1.0" << endl;
 		return 1;
 	}
+	if (vm.count("batch") > 0)
+	{
+		batch = vm["batch"].as<std::string>();
+	}
+	if (vm.count("no-cache") > 0)
+	{
+		use_cache = false;
+	}
 	if (vm.count("input-name") > 0)
 	{
 		input_name = vm["input-name"].as<std::string>();
 	}
-	else
+	else if (batch.empty())
 	{
 		cout << "Need input meshml name." << endl;
 		return 1;
@@ -2353,11 +3050,24 @@ int main(int argc, char* argv[])
 	{
 		platform = vm["platform"].as<std::string>();
 	}
+	if (vm.count("lods") > 0)
+	{
+		num_lods = vm["lods"].as<uint32_t>();
+	}
 	if (vm.count("quiet") > 0)
 	{
 		quiet = vm["quiet"].as<bool>();
 	}
 
+	if (!batch.empty())
+	{
+		int const ret = ConvertBatch(batch, target_folder, platform, num_lods, use_cache);
+
+		Context::Destroy();
+
+		return ret;
+	}
+
 	std::string meshml_name = ResLoader::Instance().Locate(input_name);
 	if (meshml_name.empty())
 	{
@@ -2397,7 +3107,19 @@ int main(int argc, char* argv[])
 
 	std::string output_name = (target_folder / filesystem::path(file_name)).string() + JIT_EXT_NAME;
 
-	MeshMLJIT(meshml_name, output_name, platform);
+	try
+	{
+		thread_pool tp(1, CPUInfo().NumHWThreads());
+		MeshMLJIT(meshml_name, output_name, platform, num_lods, quiet, tp);
+	}
+	catch (std::exception const & e)
+	{
+		cout << meshml_name << ": " << e.what() << endl;
+
+		Context::Destroy();
+
+		return 1;
+	}
 
 	if (!quiet)
 	{
@@ -1,4 +1,7 @@
 #include <KlayGE/KlayGE.hpp>
+#include <KFL/CpuInfo.hpp>
+#include <KFL/Thread.hpp>
+#include <KFL/Timer.hpp>
 #include <KFL/Util.hpp>
 #include <KlayGE/Texture.hpp>
 #include <KFL/Math.hpp>
@@ -9,126 +12,449 @@
 #include <vector>
 #include <cstring>
 
+#if defined(KLAYGE_SSE_SUPPORT)
+#include <xmmintrin.h>
+#endif
+
+#if defined(KLAYGE_COMPILER_GCC)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wdeprecated-declarations" // Ignore auto_ptr declaration
+#endif
+#include <boost/program_options.hpp>
+#if defined(KLAYGE_COMPILER_GCC)
+#pragma GCC diagnostic pop
+#endif
+
 using namespace std;
 using namespace KlayGE;
 
 namespace
 {
-	void GenMipmap(std::string const & in_file, std::string const & out_file)
+	enum MipFilter
 	{
-		Texture::TextureType in_type;
-		uint32_t in_width, in_height, in_depth;
-		uint32_t in_num_mipmaps;
-		uint32_t in_array_size;
-		ElementFormat in_format;
-		std::vector<ElementInitData> in_data;
-		std::vector<uint8_t> in_data_block;
-		LoadTexture(in_file, in_type, in_width, in_height, in_depth, in_num_mipmaps, in_array_size, in_format, in_data, in_data_block);
+		MF_Box,
+		MF_Kaiser
+	};
 
-		uint32_t const elem_size = NumFormatBytes(in_format);
+	// Rows of the destination level processed by one task
+	uint32_t const BAND_ROWS = 32;
 
-		uint32_t num_full_mip_maps = 1;
-		uint32_t w = in_width;
-		uint32_t h = in_height;
-		while ((w != 1) || (h != 1))
+	// Kaiser window, in destination texels, and its shape parameter
+	float const KAISER_RADIUS = 3;
+	float const KAISER_ALPHA = 4;
+
+	float BesselI0(float x)
+	{
+		float sum = 1;
+		float term = 1;
+		float const half_x_sq = x * x / 4;
+		for (int k = 1; k < 32; ++ k)
 		{
-			++ num_full_mip_maps;
+			term *= half_x_sq / (k * k);
+			sum += term;
+			if (term < sum * 1e-7f)
+			{
+				break;
+			}
+		}
+		return sum;
+	}
+
+	float KaiserSinc(float x)
+	{
+		float const t = x / KAISER_RADIUS;
+		if (t * t >= 1)
+		{
+			return 0;
+		}
+
+		float const sinc = (x == 0) ? 1 : sin(PI * x) / (PI * x);
+		return sinc * BesselI0(KAISER_ALPHA * sqrt(1 - t * t)) / BesselI0(KAISER_ALPHA);
+	}
+
+	// Normalized 1D taps of one destination texel, edges clamped
+	struct FilterTaps
+	{
+		std::vector<uint32_t> first_tap;
+		std::vector<uint32_t> num_taps;
+		std::vector<uint32_t> src_index;
+		std::vector<float> weight;
+
+		FilterTaps(MipFilter filter, uint32_t src_size, uint32_t dst_size)
+			: first_tap(dst_size), num_taps(dst_size)
+		{
+			float const scale = static_cast<float>(src_size) / dst_size;
+			float const half_width = (MF_Box == filter) ? scale / 2 : KAISER_RADIUS * scale;
+
+			for (uint32_t i = 0; i < dst_size; ++ i)
+			{
+				float const center = (i + 0.5f) * scale;
+				int const begin = static_cast<int>(floor(center - half_width));
+				int const end = static_cast<int>(ceil(center + half_width));
+
+				first_tap[i] = static_cast<uint32_t>(weight.size());
+				float sum = 0;
+				for (int j = begin; j < end; ++ j)
+				{
+					float w;
+					if (MF_Box == filter)
+					{
+						w = std::min(center + half_width, j + 1.0f) - std::max(center - half_width, static_cast<float>(j));
+					}
+					else
+					{
+						w = KaiserSinc((j + 0.5f - center) / scale);
+					}
+					if (w != 0)
+					{
+						src_index.push_back(MathLib::clamp(j, 0, static_cast<int>(src_size) - 1));
+						weight.push_back(w);
+						sum += w;
+					}
+				}
+				num_taps[i] = static_cast<uint32_t>(weight.size()) - first_tap[i];
 
-			w = std::max<uint32_t>(1U, w / 2);
-			h = std::max<uint32_t>(1U, h / 2);
+				for (uint32_t t = first_tap[i]; t < first_tap[i] + num_taps[i]; ++ t)
+				{
+					weight[t] /= sum;
+				}
+			}
 		}
+	};
 
-		std::vector<ElementInitData> new_data(in_array_size * num_full_mip_maps);
-		std::vector<std::vector<uint8_t>> new_data_block(new_data.size());
+	// dst[x] = sum(src[src_index[t]] * weight[t]), one float4 texel at a time
+	void FilterRow(float* dst, float const * src, FilterTaps const & taps, uint32_t dst_width)
+	{
+		for (uint32_t x = 0; x < dst_width; ++ x)
+		{
+			uint32_t const first = taps.first_tap[x];
+			uint32_t const last = first + taps.num_taps[x];
+#if defined(KLAYGE_SSE_SUPPORT)
+			__m128 acc = _mm_setzero_ps();
+			for (uint32_t t = first; t < last; ++ t)
+			{
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(src + taps.src_index[t] * 4), _mm_set1_ps(taps.weight[t])));
+			}
+			_mm_storeu_ps(dst + x * 4, acc);
+#else
+			float acc[4] = { 0, 0, 0, 0 };
+			for (uint32_t t = first; t < last; ++ t)
+			{
+				float const * s = src + taps.src_index[t] * 4;
+				float const w = taps.weight[t];
+				acc[0] += s[0] * w;
+				acc[1] += s[1] * w;
+				acc[2] += s[2] * w;
+				acc[3] += s[3] * w;
+			}
+			std::memcpy(dst + x * 4, acc, sizeof(acc));
+#endif
+		}
+	}
 
-		for (uint32_t sub_res = 0; sub_res < in_array_size; ++ sub_res)
+	// dst = sum(rows[i] * weights[i]) over num_floats floats
+	void BlendRows(float* dst, float const * const * rows, float const * weights, uint32_t num_rows, uint32_t num_floats)
+	{
+		uint32_t i = 0;
+#if defined(KLAYGE_SSE_SUPPORT)
+		for (; i + 4 <= num_floats; i += 4)
+		{
+			__m128 acc = _mm_setzero_ps();
+			for (uint32_t r = 0; r < num_rows; ++ r)
+			{
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(rows[r] + i), _mm_set1_ps(weights[r])));
+			}
+			_mm_storeu_ps(dst + i, acc);
+		}
+#endif
+		for (; i < num_floats; ++ i)
 		{
-			uint32_t the_width = in_width;
-			uint32_t the_height = in_height;
+			float acc = 0;
+			for (uint32_t r = 0; r < num_rows; ++ r)
+			{
+				acc += rows[r][i] * weights[r];
+			}
+			dst[i] = acc;
+		}
+	}
 
+	void CalcPitches(ElementFormat format, uint32_t width, uint32_t height, uint32_t& row_pitch, uint32_t& slice_pitch)
+	{
+		uint32_t const elem_size = NumFormatBytes(format);
+		if (IsCompressedFormat(format))
+		{
+			row_pitch = ((width + 3) & ~3) * elem_size;
+			slice_pitch = (height + 3) / 4 * row_pitch;
+		}
+		else
+		{
+			row_pitch = width * elem_size;
+			slice_pitch = height * row_pitch;
+		}
+	}
+
+	// Builds the full mip chain of every slice (array element or cube face) from its first level. Filtering happens in
+	// linear ABGR32F, so sRGB formats are decoded before and encoded after. The work of each level is split into bands
+	// of rows over all slices.
+	void GenMipChain(std::vector<ElementInitData>& new_data, std::vector<std::vector<uint8_t>>& new_data_block,
+		uint32_t& num_full_mip_maps,
+		std::vector<ElementInitData> const & in_data, uint32_t in_width, uint32_t in_height, uint32_t in_num_mipmaps,
+		ElementFormat in_format, MipFilter filter, thread_pool& tp, uint32_t num_threads)
+	{
+		uint32_t const num_slices = static_cast<uint32_t>(in_data.size() / in_num_mipmaps);
+
+		num_full_mip_maps = 1;
+		{
+			uint32_t w = in_width;
+			uint32_t h = in_height;
+			while ((w != 1) || (h != 1))
 			{
-				ElementInitData& dst_data = new_data[sub_res * num_full_mip_maps];
+				++ num_full_mip_maps;
 
-				dst_data.row_pitch = the_width * elem_size;
-				dst_data.slice_pitch = dst_data.row_pitch * the_height;
+				w = std::max<uint32_t>(1U, w / 2);
+				h = std::max<uint32_t>(1U, h / 2);
+			}
+		}
 
-				new_data_block[sub_res * num_full_mip_maps].resize(dst_data.slice_pitch);
+		std::vector<uint32_t> widths(num_full_mip_maps);
+		std::vector<uint32_t> heights(num_full_mip_maps);
+		widths[0] = in_width;
+		heights[0] = in_height;
+		for (uint32_t mip = 1; mip < num_full_mip_maps; ++ mip)
+		{
+			widths[mip] = std::max<uint32_t>(1U, widths[mip - 1] / 2);
+			heights[mip] = std::max<uint32_t>(1U, heights[mip - 1] / 2);
+		}
 
-				dst_data.data = &new_data_block[sub_res * num_full_mip_maps][0];
+		new_data.resize(num_slices * num_full_mip_maps);
+		new_data_block.resize(new_data.size());
+		for (uint32_t slice = 0; slice < num_slices; ++ slice)
+		{
+			for (uint32_t mip = 0; mip < num_full_mip_maps; ++ mip)
+			{
+				uint32_t const sub_res = slice * num_full_mip_maps + mip;
+				ElementInitData& dst_data = new_data[sub_res];
+				CalcPitches(in_format, widths[mip], heights[mip], dst_data.row_pitch, dst_data.slice_pitch);
+				new_data_block[sub_res].resize(dst_data.slice_pitch);
+				dst_data.data = &new_data_block[sub_res][0];
+			}
+		}
 
-				ElementInitData const & src_data = in_data[sub_res * in_num_mipmaps];
+		// The first level is kept as is, and also decoded to linear float as the source of the next level
+		std::vector<std::vector<float>> linear_levels(num_slices * 2);
+		parallel_for(tp, num_threads, num_slices, [&](uint32_t slice)
+			{
+				ElementInitData const & src_data = in_data[slice * in_num_mipmaps];
+				ElementInitData const & dst_data = new_data[slice * num_full_mip_maps];
 
+				uint32_t const num_rows = IsCompressedFormat(in_format) ? (in_height + 3) / 4 : in_height;
 				uint8_t const * src = static_cast<uint8_t const *>(src_data.data);
-				uint8_t* dst = &new_data_block[sub_res * num_full_mip_maps][0];
-				for (uint32_t y = 0; y < the_height; ++ y)
+				uint8_t* dst = static_cast<uint8_t*>(const_cast<void*>(dst_data.data));
+				for (uint32_t y = 0; y < num_rows; ++ y)
 				{
 					std::memcpy(dst, src, dst_data.row_pitch);
 
 					src += src_data.row_pitch;
 					dst += dst_data.row_pitch;
 				}
-			}
 
-			for (uint32_t mip = 0; mip < num_full_mip_maps - 1; ++ mip)
+				std::vector<float>& linear = linear_levels[slice * 2];
+				linear.resize(in_width * in_height * 4);
+				ResizeTexture(&linear[0], in_width * sizeof(float) * 4, in_width * in_height * sizeof(float) * 4,
+					EF_ABGR32F, in_width, in_height, 1,
+					dst_data.data, dst_data.row_pitch, dst_data.slice_pitch, in_format, in_width, in_height, 1,
+					false);
+			});
+
+		// Compressed formats are written in whole blocks
+		uint32_t const band_rows = BAND_ROWS;
+		for (uint32_t mip = 1; mip < num_full_mip_maps; ++ mip)
+		{
+			uint32_t const src_width = widths[mip - 1];
+			uint32_t const dst_width = widths[mip];
+			uint32_t const dst_height = heights[mip];
+			FilterTaps const h_taps(filter, src_width, dst_width);
+			FilterTaps const v_taps(filter, heights[mip - 1], dst_height);
+
+			for (uint32_t slice = 0; slice < num_slices; ++ slice)
 			{
-				uint32_t new_width = std::max(the_width / 2, 1U);
-				uint32_t new_height = std::max(the_height / 2, 1U);
+				linear_levels[slice * 2 + (mip & 1)].resize(dst_width * dst_height * 4);
+			}
 
-				ElementInitData& src_data = new_data[sub_res * num_full_mip_maps + mip];
-				ElementInitData& dst_data = new_data[sub_res * num_full_mip_maps + mip + 1];
+			uint32_t const num_bands = (dst_height + band_rows - 1) / band_rows;
+			parallel_for(tp, num_threads, num_slices * num_bands, [&](uint32_t task)
+				{
+					uint32_t const slice = task / num_bands;
+					uint32_t const y_begin = task % num_bands * band_rows;
+					uint32_t const y_end = std::min(y_begin + band_rows, dst_height);
 
-				dst_data.row_pitch = new_width * elem_size;
-				dst_data.slice_pitch = dst_data.row_pitch * new_height;
+					std::vector<float> const & src = linear_levels[slice * 2 + ((mip - 1) & 1)];
+					std::vector<float>& dst = linear_levels[slice * 2 + (mip & 1)];
 
-				new_data_block[sub_res * num_full_mip_maps + mip + 1].resize(dst_data.slice_pitch);
+					// Horizontal pass on every source row the band touches, then the vertical pass
+					uint32_t src_row_begin = std::numeric_limits<uint32_t>::max();
+					uint32_t src_row_end = 0;
+					for (uint32_t t = v_taps.first_tap[y_begin]; t < v_taps.first_tap[y_end - 1] + v_taps.num_taps[y_end - 1]; ++ t)
+					{
+						src_row_begin = std::min(src_row_begin, v_taps.src_index[t]);
+						src_row_end = std::max(src_row_end, v_taps.src_index[t] + 1);
+					}
 
-				dst_data.data = &new_data_block[sub_res * num_full_mip_maps + mip + 1][0];
+					std::vector<float> h_filtered((src_row_end - src_row_begin) * dst_width * 4);
+					for (uint32_t y = src_row_begin; y < src_row_end; ++ y)
+					{
+						FilterRow(&h_filtered[(y - src_row_begin) * dst_width * 4], &src[y * src_width * 4], h_taps, dst_width);
+					}
 
-				ResizeTexture(&new_data_block[sub_res * num_full_mip_maps + mip + 1][0],
-					dst_data.row_pitch, dst_data.slice_pitch,
-					in_format, new_width, new_height, 1,
-					src_data.data, src_data.row_pitch, src_data.slice_pitch,
-					in_format, the_width, the_height, 1,
-					true);
+					std::vector<float const *> rows;
+					for (uint32_t y = y_begin; y < y_end; ++ y)
+					{
+						uint32_t const first = v_taps.first_tap[y];
+						uint32_t const num = v_taps.num_taps[y];
+						rows.resize(num);
+						for (uint32_t t = 0; t < num; ++ t)
+						{
+							rows[t] = &h_filtered[(v_taps.src_index[first + t] - src_row_begin) * dst_width * 4];
+						}
+						BlendRows(&dst[y * dst_width * 4], &rows[0], &v_taps.weight[first], num, dst_width * 4);
+					}
 
-				the_width = new_width;
-				the_height = new_height;
-			}
+					ElementInitData const & dst_data = new_data[slice * num_full_mip_maps + mip];
+					uint32_t const dst_row_offset = IsCompressedFormat(in_format) ? y_begin / 4 : y_begin;
+					uint32_t const band_height = y_end - y_begin;
+					ResizeTexture(static_cast<uint8_t*>(const_cast<void*>(dst_data.data)) + dst_row_offset * dst_data.row_pitch,
+						dst_data.row_pitch, dst_data.slice_pitch, in_format, dst_width, band_height, 1,
+						&dst[y_begin * dst_width * 4], dst_width * sizeof(float) * 4, band_height * dst_width * sizeof(float) * 4,
+						EF_ABGR32F, dst_width, band_height, 1,
+						false);
+				});
+		}
+	}
+
+	bool GenMipmap(std::string const & in_file, std::string const & out_file, MipFilter filter, uint32_t num_iterations)
+	{
+		Texture::TextureType in_type;
+		uint32_t in_width, in_height, in_depth;
+		uint32_t in_num_mipmaps;
+		uint32_t in_array_size;
+		ElementFormat in_format;
+		std::vector<ElementInitData> in_data;
+		std::vector<uint8_t> in_data_block;
+		LoadTexture(in_file, in_type, in_width, in_height, in_depth, in_num_mipmaps, in_array_size, in_format, in_data, in_data_block);
+
+		if (Texture::TT_3D == in_type)
+		{
+			cout << "3D textures are not supported." << endl;
+			return false;
+		}
+
+		CPUInfo cpu;
+		uint32_t const num_threads = cpu.NumHWThreads();
+		thread_pool tp(1, num_threads);
+
+		uint32_t num_full_mip_maps;
+		std::vector<ElementInitData> new_data;
+		std::vector<std::vector<uint8_t>> new_data_block;
+
+		Timer timer;
+		for (uint32_t i = 0; i < num_iterations; ++ i)
+		{
+			GenMipChain(new_data, new_data_block, num_full_mip_maps,
+				in_data, in_width, in_height, in_num_mipmaps, in_format, filter, tp, num_threads);
+		}
+
+		if (num_iterations > 1)
+		{
+			double const elapsed = timer.elapsed();
+			uint64_t const texels_per_iteration = static_cast<uint64_t>(in_width) * in_height * (in_data.size() / in_num_mipmaps);
+			cout << num_iterations << " iterations in " << elapsed << " s, "
+				<< texels_per_iteration * num_iterations / elapsed / 1e6 << " Mtexels/s of input on "
+				<< num_threads << " threads" << endl;
+		}
+
+		if (!out_file.empty())
+		{
+			SaveTexture(out_file, in_type, in_width, in_height, in_depth, num_full_mip_maps, in_array_size, in_format, new_data);
 		}
 
-		SaveTexture(out_file, in_type, in_width, in_height, in_depth, num_full_mip_maps, in_array_size, in_format, new_data);
+		return true;
 	}
 }
 
 int main(int argc, char* argv[])
 {
-	if (argc < 2)
+	std::string in_file;
+	std::string out_file;
+	std::string filter_name;
+	uint32_t num_iterations;
+
+	boost::program_options::options_description desc("Allowed options");
+	desc.add_options()
+		("help,H", "Produce help message")
+		("input-name,I", boost::program_options::value<std::string>(&in_file), "Input texture name.")
+		("output-name,O", boost::program_options::value<std::string>(&out_file), "Output texture name. Default is the input.")
+		("filter,F", boost::program_options::value<std::string>(&filter_name)->default_value("box"), "Mip filter, box or kaiser. Default is box.")
+		("throughput,T", boost::program_options::value<uint32_t>(&num_iterations)->default_value(1),
+			"Generate the mip chain this many times and report the throughput. Nothing is saved if it is larger than 1.")
+		("version,v", "Version.");
+
+	boost::program_options::positional_options_description pos_desc;
+	pos_desc.add("input-name", 1);
+	pos_desc.add("output-name", 1);
+
+	boost::program_options::variables_map vm;
+	boost::program_options::store(boost::program_options::command_line_parser(argc, argv)
+		.options(desc).positional(pos_desc).run(), vm);
+	boost::program_options::notify(vm);
+
+	if ((argc <= 1) || (vm.count("help") > 0))
 	{
-		cout << "Usage: Mipmapper xxx.dds [yyy.dds]" << endl;
+		cout << "Usage: Mipmapper xxx.dds [yyy.dds] [options]" << endl;
+		cout << desc << endl;
+		return 1;
+	}
+	if (vm.count("version") > 0)
+	{
+		cout << "KlayGE Mipmapper, Version 1.1.0" << endl;
 		return 1;
 	}
 
-	std::string in_file = ResLoader::Instance().Locate(argv[1]);
-	if (in_file.empty())
+	MipFilter filter;
+	if ("box" == filter_name)
+	{
+		filter = MF_Box;
+	}
+	else if ("kaiser" == filter_name)
+	{
+		filter = MF_Kaiser;
+	}
+	else
+	{
+		cout << "Unknown filter " << filter_name << endl;
+		return 1;
+	}
+
+	std::string const in_path = ResLoader::Instance().Locate(in_file);
+	if (in_path.empty())
 	{
 		cout << "Couldn't locate " << in_file << endl;
 		Context::Destroy();
 		return 1;
 	}
 
-	std::string out_file;
-	if (argc < 3)
+	if (num_iterations > 1)
 	{
-		out_file = in_file;
+		out_file.clear();
 	}
-	else
+	else if (out_file.empty())
 	{
-		out_file = argv[2];
+		out_file = in_path;
 	}
 
-	GenMipmap(in_file, out_file);
-
-	cout << "Mipmapped texture is saved." << endl;
+	if (GenMipmap(in_path, out_file, filter, std::max(num_iterations, 1U)) && !out_file.empty())
+	{
+		cout << "Mipmapped texture is saved." << endl;
+	}
 
 	Context::Destroy();
 
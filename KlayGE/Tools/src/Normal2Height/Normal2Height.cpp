@@ -8,24 +8,31 @@
 #include <fstream>
 #include <vector>
 
+#include "TexelWorkers.hpp"
+
 using namespace std;
 namespace
 {
 	using namespace KlayGE;
 
-	void CreateDDM(std::vector<float2>& ddm, std::vector<float3> const & normal_map, float min_z)
+	void CreateDDM(TexelWorkers& workers, std::vector<float2>& ddm, std::vector<float3> const & normal_map,
+		uint32_t width, uint32_t height, float min_z)
 	{
 		ddm.resize(normal_map.size());
-		for (size_t i = 0; i < normal_map.size(); ++ i)
-		{
-			float3 n = normal_map[i];
-			n.z() = std::max(n.z(), min_z);
-			ddm[i].x() = n.x() / n.z();
-			ddm[i].y() = n.y() / n.z();
-		}
+		workers.ForEachTexelRun(width, height, [&ddm, &normal_map, width, min_z](uint32_t x, uint32_t y, uint32_t n)
+			{
+				uint32_t const i = y * width + x;
+				TexelLanes const nx = TexelWorkers::LoadLanes(&normal_map[i].x(), 3, n);
+				TexelLanes const ny = TexelWorkers::LoadLanes(&normal_map[i].y(), 3, n);
+				TexelLanes const nz = Max(TexelWorkers::LoadLanes(&normal_map[i].z(), 3, n), TexelLanes(min_z));
+				TexelWorkers::StoreLanes(&ddm[i].x(), 2, n, nx / nz);
+				TexelWorkers::StoreLanes(&ddm[i].y(), 2, n, ny / nz);
+			});
 	}
 
-	void AccumulateDDM(std::vector<float>& height_map, std::vector<float2> const & ddm, uint32_t width, uint32_t height, int directions, int rings)
+	// Each ring reads the sums of the last ring only, so texels of a ring are independent
+	void AccumulateDDM(TexelWorkers& workers, std::vector<float>& height_map, std::vector<float2> const & ddm,
+		uint32_t width, uint32_t height, int directions, int rings)
 	{
 		float const step = 2 * PI / directions;
 		std::vector<float2> dxdy(directions);
@@ -37,41 +44,54 @@ namespace
 		std::vector<float2> tmp_hm[2];
 		tmp_hm[0].resize(ddm.size(), float2(0, 0));
 		tmp_hm[1].resize(ddm.size(), float2(0, 0));
+		// The sums of the last ring and the ddm of a texel side by side, the 4 corners of a bilinear sample are 4 loads
+		std::vector<float4> src_hm_ddm(ddm.size());
 		int active = 0;
 		for (int i = 1; i < rings; ++ i)
 		{
-			for (size_t j = 0; j < ddm.size(); ++ j)
-			{
-				int y = static_cast<int>(j / width);
-				int x = static_cast<int>(j - y * width);
+			std::vector<float2> const & src_hm = tmp_hm[active];
+			std::vector<float2>& dst_hm = tmp_hm[!active];
+			workers.ForEachTexel(width, height, [&src_hm_ddm, &src_hm, &ddm, width](uint32_t x, uint32_t y)
+				{
+					uint32_t const j = y * width + x;
+					src_hm_ddm[j] = float4(src_hm[j].x(), src_hm[j].y(), ddm[j].x(), ddm[j].y());
+				});
 
-				for (int k = 0; k < directions; ++ k)
+			workers.ForEachTexel(width, height, [&src_hm_ddm, &dst_hm, &dxdy, width, height, directions, i](uint32_t ux,
+				uint32_t uy)
 				{
-					float2 delta = dxdy[k] * static_cast<float>(i);
-					float sample_x = x + delta.x();
-					float sample_y = y + delta.y();
-					int sample_x0 = static_cast<int>(floor(sample_x));
-					int sample_y0 = static_cast<int>(floor(sample_y));
-					int sample_x1 = sample_x0 + 1;
-					int sample_y1 = sample_y0 + 1;
-					float weight_x = sample_x - sample_x0;
-					float weight_y = sample_y - sample_y0;
-
-					sample_x0 %= width;
-					sample_y0 %= height;
-					sample_x1 %= width;
-					sample_y1 %= height;
-
-					float2 hl0 = MathLib::lerp(tmp_hm[active][sample_y0 * width + sample_x0], tmp_hm[active][sample_y0 * width + sample_x1], weight_x);
-					float2 hl1 = MathLib::lerp(tmp_hm[active][sample_y1 * width + sample_x0], tmp_hm[active][sample_y1 * width + sample_x1], weight_x);
-					float2 h = MathLib::lerp(hl0, hl1, weight_y);
-					float2 ddl0 = MathLib::lerp(ddm[sample_y0 * width + sample_x0], ddm[sample_y0 * width + sample_x1], weight_x);
-					float2 ddl1 = MathLib::lerp(ddm[sample_y1 * width + sample_x0], ddm[sample_y1 * width + sample_x1], weight_x);
-					float2 dd = MathLib::lerp(ddl0, ddl1, weight_y);
-
-					tmp_hm[!active][j] += h + dd * delta;
-				}
-			}
+					int const x = static_cast<int>(ux);
+					int const y = static_cast<int>(uy);
+					size_t const j = uy * width + ux;
+
+					for (int k = 0; k < directions; ++ k)
+					{
+						float2 delta = dxdy[k] * static_cast<float>(i);
+						float sample_x = x + delta.x();
+						float sample_y = y + delta.y();
+						int sample_x0 = static_cast<int>(floor(sample_x));
+						int sample_y0 = static_cast<int>(floor(sample_y));
+						int sample_x1 = sample_x0 + 1;
+						int sample_y1 = sample_y0 + 1;
+						float weight_x = sample_x - sample_x0;
+						float weight_y = sample_y - sample_y0;
+
+						sample_x0 %= width;
+						sample_y0 %= height;
+						sample_x1 %= width;
+						sample_y1 %= height;
+
+						TexelLanes const wx(weight_x);
+						TexelLanes const l0 = Lerp(TexelLanes::Load(&src_hm_ddm[sample_y0 * width + sample_x0].x()),
+							TexelLanes::Load(&src_hm_ddm[sample_y0 * width + sample_x1].x()), wx);
+						TexelLanes const l1 = Lerp(TexelLanes::Load(&src_hm_ddm[sample_y1 * width + sample_x0].x()),
+							TexelLanes::Load(&src_hm_ddm[sample_y1 * width + sample_x1].x()), wx);
+						float4 h_dd;
+						Lerp(l0, l1, TexelLanes(weight_y)).Store(&h_dd.x());
+
+						dst_hm[j] += float2(h_dd.x(), h_dd.y()) + float2(h_dd.z(), h_dd.w()) * delta;
+					}
+				});
 
 			active = !active;
 		}
@@ -88,6 +108,8 @@ namespace
 
 	void CreateHeightMap(std::string const & in_file, std::string const & out_file, float min_z)
 	{
+		TexelWorkers workers;
+
 		Texture::TextureType type;
 		uint32_t width, height, depth;
 		uint32_t num_mipmaps;
@@ -157,9 +179,9 @@ namespace
 				}
 
 				std::vector<float2> ddm;
-				CreateDDM(ddm, normals, min_z);
+				CreateDDM(workers, ddm, normals, the_width, the_height, min_z);
 
-				AccumulateDDM(heights[i], ddm, the_width, the_height, 4, 9);
+				AccumulateDDM(workers, heights[i], ddm, the_width, the_height, 4, 9);
 
 				the_width = std::max(the_width / 2, 1U);
 				the_height = std::max(the_height / 2, 1U);
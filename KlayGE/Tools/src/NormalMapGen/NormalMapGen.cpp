@@ -7,6 +7,8 @@
 #include <fstream>
 #include <vector>
 
+#include "TexelWorkers.hpp"
+
 using namespace std;
 namespace
 {
@@ -25,6 +27,8 @@ namespace
 
 		if ((Texture::TT_2D == type) && (EF_R8 == format))
 		{
+			TexelWorkers workers;
+
 			uint32_t the_width = width;
 			uint32_t the_height = height;
 
@@ -33,55 +37,29 @@ namespace
 			std::vector<size_t> base(in_data.size());
 			for (size_t i = 0; i < in_data.size(); ++ i)
 			{
-				std::vector<uint8_t> heights(the_width * the_height);
-				for (uint32_t y = 0; y < the_height; ++ y)
-				{
-					for (uint32_t x = 0; x < the_width; ++ x)
-					{
-						heights[y * the_width + x] = static_cast<uint8_t const *>(in_data[i].data)[y * in_data[i].row_pitch + x];
-					}
-				}
-
-				std::vector<int> dx;
-				dx.resize(heights.size());
-				for (uint32_t y = 0; y < the_height; ++ y)
-				{
-					for (uint32_t x = 0; x < the_width; ++ x)
-					{
-						int x0 = x;
-						int x1 = (x0 + 1) % the_width;
-						dx[y * the_width + x] = heights[y * the_width + x1] - heights[y * the_width + x0];
-					}
-				}
-
-				std::vector<int> dy;
-				dy.resize(heights.size());
-				for (uint32_t x = 0; x < the_width; ++ x)
-				{
-					for (uint32_t y = 0; y < the_height; ++ y)
-					{
-						int y0 = y;
-						int y1 = (y0 + 1) % the_height;
-						dy[y * the_width + x] = heights[y1 * the_width + x] - heights[y0 * the_width + x];
-					}
-				}
+				uint8_t const * heights = static_cast<uint8_t const *>(in_data[i].data);
+				uint32_t const row_pitch = in_data[i].row_pitch;
 
 				base[i] = data_block.size();
 				data_block.resize(data_block.size() + the_width * the_height * 4);
-				for (uint32_t y = 0; y < the_height; ++ y)
-				{
-					for (uint32_t x = 0; x < the_width; ++ x)
+				uint8_t* normals_data = &data_block[base[i]];
+				workers.ForEachTexel(the_width, the_height, [heights, row_pitch, normals_data, the_width, the_height](uint32_t x,
+					uint32_t y)
 					{
-						float3 normal = MathLib::normalize(float3(static_cast<float>(-dx[y * the_width + x]),
-							static_cast<float>(-dy[y * the_width + x]), 8));
+						uint32_t const x1 = (x + 1) % the_width;
+						uint32_t const y1 = (y + 1) % the_height;
+						int const dx = heights[y * row_pitch + x1] - heights[y * row_pitch + x];
+						int const dy = heights[y1 * row_pitch + x] - heights[y * row_pitch + x];
+
+						float3 normal = MathLib::normalize(float3(static_cast<float>(-dx), static_cast<float>(-dy), 8));
 						normal = normal * 0.5f + float3(0.5f, 0.5f, 0.5f);
 
-						data_block[base[i] + (y * the_width + x) * 4 + 0] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(normal.z() * 255 + 0.5f), 0, 255));
-						data_block[base[i] + (y * the_width + x) * 4 + 1] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(normal.y() * 255 + 0.5f), 0, 255));
-						data_block[base[i] + (y * the_width + x) * 4 + 2] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(normal.x() * 255 + 0.5f), 0, 255));
-						data_block[base[i] + (y * the_width + x) * 4 + 3] = 255;
-					}
-				}
+						uint8_t* dst = normals_data + (y * the_width + x) * 4;
+						dst[0] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(normal.z() * 255 + 0.5f), 0, 255));
+						dst[1] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(normal.y() * 255 + 0.5f), 0, 255));
+						dst[2] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(normal.x() * 255 + 0.5f), 0, 255));
+						dst[3] = 255;
+					});
 
 				the_width /= 2;
 				the_height /= 2;
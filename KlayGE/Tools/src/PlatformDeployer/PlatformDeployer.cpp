@@ -2,11 +2,18 @@
 #include <KFL/Util.hpp>
 #include <KlayGE/JudaTexture.hpp>
 #include <KlayGE/ResLoader.hpp>
+#include <KlayGE/Texture.hpp>
+#include <KFL/CpuInfo.hpp>
+#include <KFL/Thread.hpp>
 #include <KFL/XMLDom.hpp>
 #include <KFL/CXX17/filesystem.hpp>
 
+#include <functional>
 #include <iostream>
 #include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
 #include <vector>
 #include <regex>
 
@@ -30,6 +37,9 @@
 #endif
 #include <boost/algorithm/string/trim.hpp>
 
+#include "BuildManifest.hpp"
+#include "ToolRunner.hpp"
+
 using namespace std;
 using namespace KlayGE;
 
@@ -160,162 +170,225 @@ OfflineRenderDeviceCaps LoadPlatformConfig(std::string const & platform)
 	return caps;
 }
 
-void Deploy(std::vector<std::string> const & res_names, std::string const & res_type, OfflineRenderDeviceCaps const & caps)
+// Bumped whenever the steps of a resource type change, so everything deployed by an older version is done again
+uint32_t const DEPLOYER_VERSION = 2;
+
+char const * const RES_ARG = "<res>";
+char const * const WORK_ARG = "<work>";
+
+#if defined(KLAYGE_CXX17_LIBRARY_FILESYSTEM_SUPPORT) || defined(KLAYGE_TS_LIBRARY_FILESYSTEM_SUPPORT)
+typedef std::error_code FileSystemErrorCode;
+#else
+typedef boost::system::error_code FileSystemErrorCode;
+#endif
+
+// Reads its input from the resource or the work file of the task, and writes to the other one. Returns false on failure.
+struct DeployStep
 {
-	std::ofstream ofs("convert.bat");
+	// The external tool it runs, empty for steps done in this process
+	std::string tool;
+	std::function<bool(std::string const & res_name, std::string const & work_name)> run;
+};
 
-	if (("albedo" == res_type)
-		|| ("emissive" == res_type))
+// The steps of a resource run one after another, different resources are deployed at the same time. Each task has its
+// own work file in place of the shared temp.dds of the old convert.bat.
+struct DeployTask
+{
+	std::string res_name;
+	std::string work_name;
+	std::vector<DeployStep> steps;
+	// Files generated beside the resource. Textures are deployed in place and have none.
+	std::vector<std::string> outputs;
+
+	std::string digest;
+	bool deployed;
+};
+
+DeployStep ToolStep(std::string const & tool, std::vector<std::string> const & args)
+{
+	DeployStep step;
+	step.tool = tool;
+	step.run = [tool, args](std::string const & res_name, std::string const & work_name)
 	{
-		for (size_t i = 0; i < res_names.size(); ++i)
+		std::string const tool_name = LocateTool(tool);
+		if (tool_name.empty())
 		{
-			ofs << "@echo Processing: " << res_names[i] << std::endl;
+			cout << "Couldn't locate " << tool << ". Forgot to build Tools?" << endl;
+			return false;
+		}
 
-			ofs << "@echo off" << std::endl << std::endl;
-			if (caps.srgb_support)
-			{
-				ofs << "ForceTexSRGB \"" << res_names[i] << "\" temp.dds" << std::endl;
-			}
-			else
-			{
-				ofs << "copy \"" << res_names[i] << "\" temp.dds" << std::endl;
-			}
-			ofs << "Mipmapper temp.dds" << std::endl;
-			if (caps.bc7_support)
+		std::vector<std::string> tool_args;
+		for (auto const & arg : args)
+		{
+			if (arg.empty())
 			{
-				ofs << "TexCompressor BC7 temp.dds \"" << res_names[i] << "\"" << std::endl;
+				continue;
 			}
-			else if (caps.bc1_support)
+			if (RES_ARG == arg)
 			{
-				ofs << "TexCompressor BC1 temp.dds \"" << res_names[i] << "\"" << std::endl;
+				tool_args.push_back(res_name);
 			}
-			else if (caps.etc1_support)
+			else if (WORK_ARG == arg)
 			{
-				ofs << "TexCompressor ETC1 temp.dds \"" << res_names[i] << "\"" << std::endl;
+				tool_args.push_back(work_name);
 			}
 			else
 			{
-				ofs << "copy temp.dds \"" << res_names[i] << "\"" << std::endl;
+				tool_args.push_back(arg);
 			}
-			ofs << "del temp.dds" << std::endl;
-			ofs << "@echo on" << std::endl << std::endl;
 		}
-	}
-	else if (("glossiness" == res_type)
-		|| ("metalness" == res_type))
+
+		return 0 == RunTool(tool_name, tool_args);
+	};
+	return step;
+}
+
+DeployStep CopyStep(bool to_work)
+{
+	DeployStep step;
+	step.run = [to_work](std::string const & res_name, std::string const & work_name)
 	{
-		for (size_t i = 0; i < res_names.size(); ++i)
+		FileSystemErrorCode ec;
+		filesystem::copy_file(to_work ? res_name : work_name, to_work ? work_name : res_name,
+#if defined(KLAYGE_CXX17_LIBRARY_FILESYSTEM_SUPPORT) || defined(KLAYGE_TS_LIBRARY_FILESYSTEM_SUPPORT)
+			filesystem::copy_options::overwrite_existing,
+#else
+			filesystem::copy_option::overwrite_if_exists,
+#endif
+			ec);
+		return !ec;
+	};
+	return step;
+}
+
+// The same as ForceTexSRGB, without a process for it
+DeployStep ForceSRGBStep()
+{
+	DeployStep step;
+	step.run = [](std::string const & res_name, std::string const & work_name)
+	{
+		Texture::TextureType type;
+		uint32_t width, height, depth;
+		uint32_t num_mipmaps;
+		uint32_t array_size;
+		ElementFormat format;
+		std::vector<ElementInitData> init_data;
+		std::vector<uint8_t> data_block;
+		LoadTexture(res_name, type, width, height, depth, num_mipmaps, array_size, format, init_data, data_block);
+		if (init_data.empty())
 		{
-			ofs << "@echo Processing: " << res_names[i] << std::endl;
+			return false;
+		}
 
-			ofs << "@echo off" << std::endl << std::endl;
-			ofs << "copy \"" << res_names[i] << "\" temp.dds" << std::endl;
-			ofs << "Mipmapper temp.dds" << std::endl;
-			if (caps.bc7_support)
-			{
-				ofs << "TexCompressor BC7 temp.dds \"" << res_names[i] << "\"" << std::endl;
-			}
-			else if (caps.bc4_support)
-			{
-				ofs << "TexCompressor BC4 temp.dds \"" << res_names[i] << "\"" << std::endl;
-			}
-			else if (caps.bc1_support)
-			{
-				ofs << "TexCompressor BC1 temp.dds \"" << res_names[i] << "\"" << std::endl;
-			}
-			else if (caps.etc1_support)
-			{
-				ofs << "TexCompressor ETC1 temp.dds \"" << res_names[i] << "\"" << std::endl;
-			}
-			else
-			{
-				ofs << "copy temp.dds \"" << res_names[i] << "\"" << std::endl;
-			}
-			ofs << "del temp.dds" << std::endl;
-			ofs << "@echo on" << std::endl << std::endl;
+		// Formats without a sRGB counterpart are kept as they are
+		SaveTexture(work_name, type, width, height, depth, num_mipmaps, array_size, MakeSRGB(format), init_data);
+		return true;
+	};
+	return step;
+}
+
+// The choices of formats are the same as the old convert.bat
+std::vector<DeployStep> DeploySteps(std::string const & res_type, OfflineRenderDeviceCaps const & caps)
+{
+	std::vector<DeployStep> steps;
+
+	if (("albedo" == res_type)
+		|| ("emissive" == res_type))
+	{
+		steps.push_back(caps.srgb_support ? ForceSRGBStep() : CopyStep(true));
+		steps.push_back(ToolStep("Mipmapper", { WORK_ARG }));
+		if (caps.bc7_support)
+		{
+			steps.push_back(ToolStep("TexCompressor", { "BC7", WORK_ARG, RES_ARG }));
+		}
+		else if (caps.bc1_support)
+		{
+			steps.push_back(ToolStep("TexCompressor", { "BC1", WORK_ARG, RES_ARG }));
+		}
+		else if (caps.etc1_support)
+		{
+			steps.push_back(ToolStep("TexCompressor", { "ETC1", WORK_ARG, RES_ARG }));
+		}
+		else
+		{
+			steps.push_back(CopyStep(false));
 		}
 	}
-	else if ("normal" == res_type)
+	else if (("glossiness" == res_type)
+		|| ("metalness" == res_type))
 	{
-		for (size_t i = 0; i < res_names.size(); ++ i)
+		steps.push_back(CopyStep(true));
+		steps.push_back(ToolStep("Mipmapper", { WORK_ARG }));
+		if (caps.bc7_support)
 		{
-			ofs << "@echo Processing: " << res_names[i] << std::endl;
-
-			ofs << "@echo off" << std::endl << std::endl;
-			ofs << "Mipmapper \"" << res_names[i] << "\" temp.dds" << std::endl;
-			if (caps.bc5_support)
-			{
-				ofs << "NormalMapCompressor temp.dds \"" << res_names[i] << "\" BC5" << std::endl;
-			}
-			else if (caps.bc3_support)
-			{
-				ofs << "NormalMapCompressor temp.dds \"" << res_names[i] << "\" BC3" << std::endl;
-			}
-			else
-			{
-				ofs << "copy temp.dds \"" << res_names[i] << "\"" << std::endl;
-			}
-			ofs << "del temp.dds" << std::endl;
-			ofs << "@echo on" << std::endl << std::endl;
+			steps.push_back(ToolStep("TexCompressor", { "BC7", WORK_ARG, RES_ARG }));
+		}
+		else if (caps.bc4_support)
+		{
+			steps.push_back(ToolStep("TexCompressor", { "BC4", WORK_ARG, RES_ARG }));
+		}
+		else if (caps.bc1_support)
+		{
+			steps.push_back(ToolStep("TexCompressor", { "BC1", WORK_ARG, RES_ARG }));
+		}
+		else if (caps.etc1_support)
+		{
+			steps.push_back(ToolStep("TexCompressor", { "ETC1", WORK_ARG, RES_ARG }));
+		}
+		else
+		{
+			steps.push_back(CopyStep(false));
 		}
 	}
-	else if ("bump" == res_type)
+	else if (("normal" == res_type)
+		|| ("bump" == res_type))
 	{
-		for (size_t i = 0; i < res_names.size(); ++ i)
+		if ("normal" == res_type)
 		{
-			ofs << "@echo Processing: " << res_names[i] << std::endl;
-
-			ofs << "@echo off" << std::endl << std::endl;
-			ofs << "Bump2Normal \"" << res_names[i] << "\" temp.dds 0.4" << std::endl;
-			ofs << "Mipmapper temp.dds" << std::endl; 
-			if (caps.bc5_support)
-			{
-				ofs << "NormalMapCompressor temp.dds \"" << res_names[i] << "\" BC5" << std::endl;
-			}
-			else if (caps.bc3_support)
-			{
-				ofs << "NormalMapCompressor temp.dds \"" << res_names[i] << "\" BC3" << std::endl;
-			}
-			else
-			{
-				ofs << "copy temp.dds \"" << res_names[i] << "\"" << std::endl;
-			}
-			ofs << "del temp.dds" << std::endl;
-			ofs << "@echo on" << std::endl << std::endl;
+			steps.push_back(ToolStep("Mipmapper", { RES_ARG, WORK_ARG }));
+		}
+		else
+		{
+			steps.push_back(ToolStep("Bump2Normal", { RES_ARG, WORK_ARG, "0.4" }));
+			steps.push_back(ToolStep("Mipmapper", { WORK_ARG }));
+		}
+		if (caps.bc5_support)
+		{
+			steps.push_back(ToolStep("NormalMapCompressor", { WORK_ARG, RES_ARG, "BC5" }));
+		}
+		else if (caps.bc3_support)
+		{
+			steps.push_back(ToolStep("NormalMapCompressor", { WORK_ARG, RES_ARG, "BC3" }));
+		}
+		else
+		{
+			steps.push_back(CopyStep(false));
 		}
 	}
 	else if ("height" == res_type)
 	{
-		for (size_t i = 0; i < res_names.size(); ++i)
+		steps.push_back(CopyStep(true));
+		steps.push_back(ToolStep("Mipmapper", { WORK_ARG }));
+		if (caps.bc4_support)
 		{
-			ofs << "@echo Processing: " << res_names[i] << std::endl;
-
-			ofs << "@echo off" << std::endl << std::endl;
-			ofs << "Mipmapper \"" << res_names[i] << "\" temp.dds" << std::endl;
-			if (caps.bc4_support)
-			{
-				ofs << "TexCompressor BC4 temp.dds \"" << res_names[i] << "\"" << std::endl;
-			}
-			else if (caps.bc1_support)
-			{
-				ofs << "TexCompressor BC1 temp.dds \"" << res_names[i] << "\"" << std::endl;
-			}
-			else if (caps.etc1_support)
-			{
-				ofs << "TexCompressor ETC1 temp.dds \"" << res_names[i] << "\"" << std::endl;
-			}
-			else
-			{
-				ofs << "copy temp.dds \"" << res_names[i] << "\"" << std::endl;
-			}
-			ofs << "del temp.dds" << std::endl;
-			ofs << "@echo on" << std::endl << std::endl;
+			steps.push_back(ToolStep("TexCompressor", { "BC4", WORK_ARG, RES_ARG }));
+		}
+		else if (caps.bc1_support)
+		{
+			steps.push_back(ToolStep("TexCompressor", { "BC1", WORK_ARG, RES_ARG }));
+		}
+		else if (caps.etc1_support)
+		{
+			steps.push_back(ToolStep("TexCompressor", { "ETC1", WORK_ARG, RES_ARG }));
+		}
+		else
+		{
+			steps.push_back(CopyStep(false));
 		}
 	}
 	else if ("cubemap" == res_type)
 	{
 		std::string y_fmt;
-		std::string c_fmt;
 		if (caps.r16_support)
 		{
 			y_fmt = "R16";
@@ -324,6 +397,8 @@ void Deploy(std::vector<std::string> const & res_names, std::string const & res_
 		{
 			y_fmt = "R16F";
 		}
+
+		std::string c_fmt;
 		if (caps.bc5_support)
 		{
 			c_fmt = "BC5";
@@ -333,50 +408,353 @@ void Deploy(std::vector<std::string> const & res_names, std::string const & res_
 			c_fmt = "BC3";
 		}
 
-		for (size_t i = 0; i < res_names.size(); ++ i)
+		steps.push_back(ToolStep("HDRCompressor", { RES_ARG, y_fmt, c_fmt }));
+	}
+	else if ("model" == res_type)
+	{
+		steps.push_back(ToolStep("MeshMLJIT", { "-I", RES_ARG, "-P", caps.platform, "-q" }));
+	}
+	else if ("effect" == res_type)
+	{
+		steps.push_back(ToolStep("FXMLJIT", { caps.platform, RES_ARG }));
+	}
+
+	return steps;
+}
+
+std::vector<std::string> DeployOutputs(std::string const & res_name, std::string const & res_type)
+{
+	std::vector<std::string> ret;
+
+	filesystem::path const res_path(res_name);
+	if ("cubemap" == res_type)
+	{
+		std::string const stem = res_path.stem().string();
+		std::string const ext = res_path.extension().string();
+		ret.push_back(stem + "_y" + ext);
+		ret.push_back(stem + "_c" + ext);
+	}
+	else if ("model" == res_type)
+	{
+		ret.push_back(res_name + ".model_bin");
+	}
+	else if ("effect" == res_type)
+	{
+		ret.push_back((res_path.parent_path() / res_path.stem()).string() + ".kfx");
+	}
+
+	return ret;
+}
+
+// A file referenced by a resource is searched next to it first, like the tools do
+std::string ResolveReference(std::string const & referrer, std::string const & name)
+{
+	filesystem::path const ref_path = filesystem::path(referrer).parent_path() / name;
+	if (filesystem::exists(ref_path))
+	{
+		return ref_path.string();
+	}
+	return ResLoader::Instance().Locate(name);
+}
+
+void CollectEffectIncludes(std::string const & fxml_name, std::vector<std::string>& include_names)
+{
+	ResIdentifierPtr source = ResLoader::Instance().Open(fxml_name);
+	if (!source)
+	{
+		return;
+	}
+
+	KlayGE::XMLDocument doc;
+	XMLNodePtr root = doc.Parse(source);
+	for (XMLNodePtr node = root->FirstNode("include"); node; node = node->NextSibling("include"))
+	{
+		std::string const include_name = ResolveReference(fxml_name, RetrieveAttrValue(node, "name", ""));
+		if (!include_name.empty()
+			&& (std::find(include_names.begin(), include_names.end(), include_name) == include_names.end()))
 		{
-			ofs << "@echo Processing: " << res_names[i] << std::endl;
+			include_names.push_back(include_name);
+			CollectEffectIncludes(include_name, include_names);
+		}
+	}
+}
 
-			ofs << "@echo off" << std::endl << std::endl;
-			ofs << "HDRCompressor \"" << res_names[i] << "\" " << y_fmt << ' ' << c_fmt << std::endl;
-			ofs << "@echo on" << std::endl << std::endl;
+// Textures are in texture attributes, or in the names of texture nodes
+void CollectMaterialTextures(XMLNodePtr const & node, std::vector<std::string>& texture_names)
+{
+	for (XMLAttributePtr attr = node->FirstAttrib(); attr; attr = attr->NextAttrib())
+	{
+		if (("texture" == attr->Name()) || (("texture" == node->Name()) && ("name" == attr->Name())))
+		{
+			texture_names.push_back(attr->ValueString());
 		}
 	}
+	for (XMLNodePtr child = node->FirstNode(); child; child = child->NextSibling())
+	{
+		CollectMaterialTextures(child, texture_names);
+	}
+}
+
+void CollectModelTextures(std::string const & meshml_name, std::vector<std::string>& texture_names)
+{
+	ResIdentifierPtr file = ResLoader::Instance().Open(meshml_name);
+	if (!file)
+	{
+		return;
+	}
+
+	// Stops at the materials, the meshes after them are never parsed
+	XMLReader reader(file);
+	if (!reader.Read())
+	{
+		return;
+	}
+	uint32_t const root_depth = reader.Depth();
+	while (reader.ReadChild(root_depth))
+	{
+		if ("materials_chunk" == reader.Name())
+		{
+			KlayGE::XMLDocument doc;
+			XMLNodePtr materials_chunk = doc.Parse(MakeSharedPtr<ResIdentifier>(meshml_name, 0,
+				MakeSharedPtr<std::stringstream>(reader.ReadElementSource())));
+
+			std::vector<std::string> names;
+			CollectMaterialTextures(materials_chunk, names);
+			for (auto const & name : names)
+			{
+				std::string const texture_name = ResolveReference(meshml_name, name);
+				if (!texture_name.empty()
+					&& (std::find(texture_names.begin(), texture_names.end(), texture_name) == texture_names.end()))
+				{
+					texture_names.push_back(texture_name);
+				}
+			}
+			break;
+		}
+	}
+}
+
+// The files a resource is built from, other than itself
+std::vector<std::string> ResourceDependencies(std::string const & res_name, std::string const & res_type)
+{
+	std::vector<std::string> ret;
+	if ("effect" == res_type)
+	{
+		CollectEffectIncludes(res_name, ret);
+	}
 	else if ("model" == res_type)
 	{
-		for (size_t i = 0; i < res_names.size(); ++ i)
+		// A malformed model fails on its own when it's deployed
+		try
+		{
+			CollectModelTextures(res_name, ret);
+		}
+		catch (std::exception const & e)
 		{
-			ofs << "@echo Processing: " << res_names[i] << std::endl;
+			cout << res_name << ": " << e.what() << endl;
+		}
+	}
+	return ret;
+}
 
-			ofs << "@echo off" << std::endl << std::endl;
-			ofs << "MeshMLJIT -I \"" << res_names[i] << "\" -P " << caps.platform << std::endl;
-			ofs << "@echo on" << std::endl << std::endl;
+// The binaries of the external tools stand in for their versions
+std::string ToolsDigest(std::vector<DeployStep> const & steps)
+{
+	BuildDigest digest;
+	for (auto const & step : steps)
+	{
+		if (!step.tool.empty())
+		{
+			digest.AddString(step.tool);
+			digest.AddFile(LocateTool(step.tool));
 		}
 	}
-	else if ("effect" == res_type)
+	return digest.Str();
+}
+
+// Textures are deployed in place, so the content after deploying is what the next run sees. Everything else generates
+// new files, and the content of the source, the files it references and the tools decide.
+std::string ResourceDigest(std::string const & res_name, std::string const & res_type, OfflineRenderDeviceCaps const & caps,
+	std::string const & tools_digest)
+{
+	BuildDigest digest;
+	if (!digest.AddFile(res_name))
+	{
+		return std::string();
+	}
+	for (auto const & dependency : ResourceDependencies(res_name, res_type))
 	{
-		for (size_t i = 0; i < res_names.size(); ++ i)
+		digest.AddString(dependency);
+		digest.AddFile(dependency);
+	}
+
+	digest.AddString(tools_digest).AddValue(DEPLOYER_VERSION).AddString(res_type).AddString(caps.platform);
+	digest.AddValue(caps.major_version).AddValue(caps.minor_version);
+	bool const supports[] = { caps.bc1_support, caps.bc3_support, caps.bc4_support, caps.bc5_support, caps.bc7_support,
+		caps.etc1_support, caps.r16_support, caps.r16f_support, caps.srgb_support };
+	for (bool const support : supports)
+	{
+		digest.AddValue(support);
+	}
+	return digest.Str();
+}
+
+std::string ManifestHeader()
+{
+	return "PlatformDeployer manifest " + std::to_string(DEPLOYER_VERSION);
+}
+
+bool RunTask(DeployTask& task, std::string const & res_type, OfflineRenderDeviceCaps const & caps,
+	std::string const & tools_digest, std::mutex& output_mutex)
+{
+	{
+		std::lock_guard<std::mutex> lock(output_mutex);
+		cout << "Processing: " << task.res_name << endl;
+	}
+
+	bool succeeded = true;
+	for (auto const & step : task.steps)
+	{
+		if (!step.run(task.res_name, task.work_name))
 		{
-			ofs << "@echo Processing: " << res_names[i] << std::endl;
+			succeeded = false;
+			break;
+		}
+	}
 
-			ofs << "@echo off" << std::endl << std::endl;
-			ofs << "FXMLJIT " << caps.platform << " \"" << res_names[i] << "\"" << std::endl;
-			ofs << "@echo on" << std::endl << std::endl;
+	FileSystemErrorCode ec;
+	filesystem::remove(task.work_name, ec);
+
+	if (succeeded)
+	{
+		for (auto const & output : task.outputs)
+		{
+			if (!filesystem::exists(output))
+			{
+				succeeded = false;
+				break;
+			}
 		}
 	}
+
+	if (succeeded)
+	{
+		task.digest = ResourceDigest(task.res_name, res_type, caps, tools_digest);
+	}
 	else
 	{
-		printf("Error: Unknown resource type.");
-		return;
+		std::lock_guard<std::mutex> lock(output_mutex);
+		cout << "Failed to deploy " << task.res_name << endl;
+	}
+
+	return succeeded;
+}
+
+// Every resource is a chain of steps. The chains are independent and run on all cores. Resources unchanged since they
+// were deployed for the same device caps by the same version are skipped.
+int Deploy(std::vector<std::string> const & res_names, std::string const & res_type, OfflineRenderDeviceCaps const & caps,
+	bool use_cache)
+{
+	std::vector<DeployStep> const steps = DeploySteps(res_type, caps);
+	if (steps.empty())
+	{
+		cout << "Error: Unknown resource type." << endl;
+		return 1;
 	}
+	std::string const tools_digest = ToolsDigest(steps);
 
-	ofs.close();
+	// -N deploys everything, the digests are still recorded for the next run
+	BuildManifest manifest("PlatformDeployer_" + caps.platform + ".manifest", ManifestHeader());
 
-	if ((res_type != "cubemap") && (res_type != "model") && (res_type != "effect"))
+	// Another deployer running at the same time has its own work files
+	std::string const work_tag = UniqueBuildTag();
+
+	std::vector<DeployTask> tasks;
+	uint32_t num_cached = 0;
+	for (auto const & res_name : res_names)
 	{
-		system("convert.bat");
-		system("del convert.bat");
+		DeployTask task;
+		task.res_name = ResLoader::Instance().Locate(res_name);
+		if (task.res_name.empty())
+		{
+			cout << "Couldn't locate " << res_name << endl;
+			continue;
+		}
+		task.outputs = DeployOutputs(task.res_name, res_type);
+		task.deployed = false;
+
+		if (use_cache && manifest.UpToDate(task.res_name, ResourceDigest(task.res_name, res_type, caps, tools_digest)))
+		{
+			bool outputs_exist = true;
+			for (auto const & output : task.outputs)
+			{
+				outputs_exist &= filesystem::exists(output);
+			}
+			if (outputs_exist)
+			{
+				cout << "Up to date: " << task.res_name << endl;
+				++ num_cached;
+				continue;
+			}
+		}
+
+		// Unique among tasks, and among processes running at the same time
+		filesystem::path const res_path(task.res_name);
+		task.work_name = (filesystem::temp_directory_path()
+			/ (res_path.stem().string() + "_" + caps.platform + "_" + work_tag + "_" + std::to_string(tasks.size())
+				+ res_path.extension().string())).string();
+		task.steps = steps;
+		tasks.push_back(std::move(task));
 	}
+
+	if (!tasks.empty())
+	{
+		std::mutex output_mutex;
+
+		CPUInfo cpu;
+		uint32_t const num_threads = std::min(static_cast<uint32_t>(cpu.NumHWThreads()), static_cast<uint32_t>(tasks.size()));
+		thread_pool tp(1, num_threads);
+		parallel_for(tp, num_threads, static_cast<uint32_t>(tasks.size()),
+			[&tasks, &res_type, &caps, &tools_digest, &output_mutex](uint32_t index)
+			{
+				// A resource that throws fails on its own, the others are still deployed
+				DeployTask& task = tasks[index];
+				try
+				{
+					task.deployed = RunTask(task, res_type, caps, tools_digest, output_mutex);
+				}
+				catch (std::exception const & e)
+				{
+					task.deployed = false;
+
+					FileSystemErrorCode ec;
+					filesystem::remove(task.work_name, ec);
+
+					std::lock_guard<std::mutex> lock(output_mutex);
+					cout << "Failed to deploy " << task.res_name << " (" << e.what() << ")" << endl;
+				}
+			});
+	}
+
+	uint32_t num_failed = 0;
+	for (auto const & task : tasks)
+	{
+		if (task.deployed)
+		{
+			manifest.Built(task.res_name, task.digest);
+		}
+		else
+		{
+			// Deployed again next time
+			manifest.Failed(task.res_name);
+			++ num_failed;
+		}
+	}
+	manifest.Save();
+
+	cout << (tasks.size() - num_failed) << " deployed, " << num_cached << " up to date, " << num_failed << " failed." << endl;
+
+	return (0 == num_failed) ? 0 : 1;
 }
 
 int main(int argc, char* argv[])
@@ -393,6 +771,7 @@ int main(int argc, char* argv[])
 		("input-name,I", boost::program_options::value<std::string>(), "Input resource name.")
 		("type,T", boost::program_options::value<std::string>(), "Resource type.")
 		("platform,P", boost::program_options::value<std::string>(), "Platform name.")
+		("no-cache,N", "Deploy all resources, even if they are up to date.")
 		("version,v", "Version.");
 
 	boost::program_options::variables_map vm;
@@ -407,7 +786,7 @@ int main(int argc, char* argv[])
 	}
 	if (vm.count("version") > 0)
 	{
-		cout << "KlayGE PlatformDeployer, Version 1.0.0" << endl;
+		cout << "KlayGE PlatformDeployer, Version 1.1.0" << endl;
 		Context::Destroy();
 		return 1;
 	}
@@ -527,9 +906,9 @@ int main(int argc, char* argv[])
 	}
 
 	OfflineRenderDeviceCaps caps = LoadPlatformConfig(platform);
-	Deploy(res_names, res_type, caps);
+	int const ret = Deploy(res_names, res_type, caps, vm.count("no-cache") == 0);
 
 	Context::Destroy();
 
-	return 0;
+	return ret;
 }
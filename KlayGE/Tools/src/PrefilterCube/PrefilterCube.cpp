@@ -1,6 +1,9 @@
 #include <KlayGE/KlayGE.hpp>
 #include <KFL/Half.hpp>
 #include <KFL/Math.hpp>
+#include <KFL/SIMDMath.hpp>
+#include <KFL/SIMDVector.hpp>
+#include <KFL/AlignedAllocator.hpp>
 #include <KFL/Timer.hpp>
 #include <KlayGE/Texture.hpp>
 #include <KlayGE/ResLoader.hpp>
@@ -17,27 +20,467 @@
 
 #include <boost/assert.hpp>
 
+#include "TexelWorkers.hpp"
+
 using namespace std;
 using namespace KlayGE;
 
 namespace
 {
-	void PrefilterCubeGPU(std::string const & in_file, std::string const & out_file)
+	// The same as PrefilterCube.fxml
+	uint32_t const NUM_SAMPLES = 1024;
+
+	typedef std::vector<float, aligned_allocator<float, 16>> AlignedFloats;
+
+	uint32_t NumPrefilteredMipmaps(uint32_t width)
 	{
-		TexturePtr in_tex = SyncLoadTexture(in_file, EAH_GPU_Read | EAH_Immutable);
-		uint32_t in_width = in_tex->Width(0);
+		uint32_t num_mipmaps = 1;
+		uint32_t w = width;
+		while (w > 8)
+		{
+			++ num_mipmaps;
+
+			w = std::max<uint32_t>(1U, w / 2);
+		}
+		return num_mipmaps;
+	}
+
+	// ToDir in PrefilterCube.fxml
+	float3 CubeTexelDir(uint32_t face, float x, float y)
+	{
+		float3 dir;
+		switch (face)
+		{
+		case Texture::CF_Positive_X:
+			dir = float3(+1, 1 - y * 2, 1 - x * 2);
+			break;
+
+		case Texture::CF_Negative_X:
+			dir = float3(-1, 1 - y * 2, x * 2 - 1);
+			break;
+
+		case Texture::CF_Positive_Y:
+			dir = float3(x * 2 - 1, +1, y * 2 - 1);
+			break;
+
+		case Texture::CF_Negative_Y:
+			dir = float3(x * 2 - 1, -1, 1 - y * 2);
+			break;
+
+		case Texture::CF_Positive_Z:
+			dir = float3(x * 2 - 1, 1 - y * 2, +1);
+			break;
+
+		default:
+			dir = float3(1 - x * 2, 1 - y * 2, -1);
+			break;
+		}
+
+		return MathLib::normalize(dir);
+	}
+
+	float2 Hammersley2D(uint32_t i, uint32_t n)
+	{
+		uint32_t bits = i;
+		bits = (bits << 16) | (bits >> 16);
+		bits = ((bits & 0x55555555) << 1) | ((bits & 0xAAAAAAAA) >> 1);
+		bits = ((bits & 0x33333333) << 2) | ((bits & 0xCCCCCCCC) >> 2);
+		bits = ((bits & 0x0F0F0F0F) << 4) | ((bits & 0xF0F0F0F0) >> 4);
+		bits = ((bits & 0x00FF00FF) << 8) | ((bits & 0xFF00FF00) >> 8);
+		return float2(static_cast<float>(i) / n, bits * 2.3283064365386963e-10f);
+	}
+
+	void TangentFrame(float3 const & normal, float3& tangent, float3& binormal)
+	{
+		float3 const up_vec = (MathLib::abs(normal.z()) < 0.999f) ? float3(0, 0, 1) : float3(1, 0, 0);
+		tangent = MathLib::normalize(MathLib::cross(up_vec, normal));
+		binormal = MathLib::cross(normal, tangent);
+	}
+
+	// Level 0 of a cube map in RGBA32F, sampled bilinearly with clamped faces like skybox_sampler
+	class CubeSampler
+	{
+	public:
+		bool Load(std::string const & in_file)
+		{
+			Texture::TextureType type;
+			uint32_t width, height, depth;
+			uint32_t num_mipmaps;
+			uint32_t array_size;
+			ElementFormat format;
+			std::vector<ElementInitData> init_data;
+			std::vector<uint8_t> data_block;
+			LoadTexture(in_file, type, width, height, depth, num_mipmaps, array_size, format, init_data, data_block);
+			if (type != Texture::TT_Cube)
+			{
+				return false;
+			}
+
+			size_ = width;
+			uint32_t const face_size = size_ * size_ * 4;
+			texels_.resize(6 * face_size);
+			for (uint32_t face = 0; face < 6; ++ face)
+			{
+				ElementInitData const & src = init_data[face * num_mipmaps];
+				ResizeTexture(&texels_[face * face_size], size_ * sizeof(float) * 4, face_size * sizeof(float), EF_ABGR32F,
+					size_, size_, 1,
+					src.data, src.row_pitch, src.slice_pitch, format, size_, size_, 1, false);
+			}
+
+			return true;
+		}
+
+		uint32_t Size() const
+		{
+			return size_;
+		}
+
+		SIMDVectorF4 Texel(uint32_t face, uint32_t x, uint32_t y) const
+		{
+			return SIMDMathLib::LoadVector4(&texels_[((face * size_ + y) * size_ + x) * 4]);
+		}
+
+		SIMDVectorF4 Sample(float3 const & dir) const
+		{
+			float const ax = MathLib::abs(dir.x());
+			float const ay = MathLib::abs(dir.y());
+			float const az = MathLib::abs(dir.z());
+
+			uint32_t face;
+			float sc, tc, ma;
+			if ((ax >= ay) && (ax >= az))
+			{
+				face = (dir.x() > 0) ? Texture::CF_Positive_X : Texture::CF_Negative_X;
+				sc = (dir.x() > 0) ? -dir.z() : dir.z();
+				tc = -dir.y();
+				ma = ax;
+			}
+			else if (ay >= az)
+			{
+				face = (dir.y() > 0) ? Texture::CF_Positive_Y : Texture::CF_Negative_Y;
+				sc = dir.x();
+				tc = (dir.y() > 0) ? dir.z() : -dir.z();
+				ma = ay;
+			}
+			else
+			{
+				face = (dir.z() > 0) ? Texture::CF_Positive_Z : Texture::CF_Negative_Z;
+				sc = (dir.z() > 0) ? dir.x() : -dir.x();
+				tc = -dir.y();
+				ma = az;
+			}
+
+			float const max_coord = static_cast<float>(size_ - 1);
+			float const fx = MathLib::clamp((sc / ma + 1) * 0.5f * size_ - 0.5f, 0.0f, max_coord);
+			float const fy = MathLib::clamp((tc / ma + 1) * 0.5f * size_ - 0.5f, 0.0f, max_coord);
+			uint32_t const x0 = static_cast<uint32_t>(fx);
+			uint32_t const y0 = static_cast<uint32_t>(fy);
+			uint32_t const x1 = std::min(x0 + 1, size_ - 1);
+			uint32_t const y1 = std::min(y0 + 1, size_ - 1);
+			float const wx = fx - x0;
+			float const wy = fy - y0;
+
+			SIMDVectorF4 const top = SIMDMathLib::Lerp(this->Texel(face, x0, y0), this->Texel(face, x1, y0), wx);
+			SIMDVectorF4 const bottom = SIMDMathLib::Lerp(this->Texel(face, x0, y1), this->Texel(face, x1, y1), wx);
+			return SIMDMathLib::Lerp(top, bottom, wy);
+		}
+
+	private:
+		uint32_t size_;
+		AlignedFloats texels_;
+	};
+
+	// Light directions around the normal in the tangent space, weighted by n dot l. The view is the normal, like in
+	// PrefilterCubeSpecularPS.
+	struct SpecularSample
+	{
+		float3 l;
+		float n_dot_l;
+	};
+
+	// ImportanceSampleBP in PrefilterCube.fxml. The lighting shades with Blinn-Phong of Glossiness2Shininess, so both
+	// paths prefilter with its lobe.
+	std::vector<SpecularSample> BlinnPhongSamples(float shininess)
+	{
+		std::vector<SpecularSample> samples;
+		for (uint32_t i = 0; i < NUM_SAMPLES; ++ i)
+		{
+			float2 const xi = Hammersley2D(i, NUM_SAMPLES);
+			float const phi = 2 * PI * xi.x();
+			float const cos_theta = MathLib::pow(1 - xi.y() * (shininess + 1) / (shininess + 2), 1 / (shininess + 1));
+			float const sin_theta = MathLib::sqrt(1 - cos_theta * cos_theta);
+
+			float const n_dot_l = 2 * cos_theta * cos_theta - 1;
+			if (n_dot_l > 0)
+			{
+				SpecularSample sample;
+				sample.l = float3(2 * cos_theta * sin_theta * MathLib::cos(phi), 2 * cos_theta * sin_theta * MathLib::sin(phi),
+					n_dot_l);
+				sample.n_dot_l = n_dot_l;
+				samples.push_back(sample);
+			}
+		}
+		return samples;
+	}
+
+	// The 9 real spherical harmonics of band 0 to 2
+	void SHBasis(float3 const & dir, float* basis)
+	{
+		float const x = dir.x();
+		float const y = dir.y();
+		float const z = dir.z();
+		basis[0] = 0.282095f;
+		basis[1] = 0.488603f * y;
+		basis[2] = 0.488603f * z;
+		basis[3] = 0.488603f * x;
+		basis[4] = 1.092548f * x * y;
+		basis[5] = 1.092548f * y * z;
+		basis[6] = 0.315392f * (3 * z * z - 1);
+		basis[7] = 1.092548f * x * z;
+		basis[8] = 0.546274f * (x * x - y * y);
+	}
+
+	// The radiance projected on SH, convolved with the cosine lobe and divided by PI, from "An Efficient Representation
+	// for Irradiance Environment Maps" by Ramamoorthi and Hanrahan. Evaluated in a direction, it's the average of the
+	// radiance weighted by n dot l, the same as PrefilterCubeDiffusePS without the sampling noise.
+	std::vector<SIMDVectorF4> IrradianceSH(TexelWorkers& workers, CubeSampler const & sampler)
+	{
+		uint32_t const size = sampler.Size();
+		uint32_t const num_tiles = (size + TexelWorkers::TILE_ROWS - 1) / TexelWorkers::TILE_ROWS;
+
+		// Each tile has its own sums, added up in order afterwards, so the result doesn't depend on the threads
+		std::vector<SIMDVectorF4> tile_coeffs(6 * num_tiles * 9, SIMDVectorF4::Zero());
+		workers.ForEach(6 * num_tiles, [&sampler, &tile_coeffs, size, num_tiles](uint32_t task)
+			{
+				uint32_t const face = task / num_tiles;
+				uint32_t const y_begin = task % num_tiles * TexelWorkers::TILE_ROWS;
+				uint32_t const y_end = std::min(y_begin + TexelWorkers::TILE_ROWS, size);
+				SIMDVectorF4* coeffs = &tile_coeffs[task * 9];
+
+				float const texel_size = 2.0f / size;
+				for (uint32_t y = y_begin; y < y_end; ++ y)
+				{
+					for (uint32_t x = 0; x < size; ++ x)
+					{
+						float const u = (x + 0.5f) * texel_size - 1;
+						float const v = (y + 0.5f) * texel_size - 1;
+						float const d_sq = 1 + u * u + v * v;
+						float const solid_angle = texel_size * texel_size / (d_sq * MathLib::sqrt(d_sq));
+
+						float basis[9];
+						SHBasis(CubeTexelDir(face, (x + 0.5f) / size, (y + 0.5f) / size), basis);
+						SIMDVectorF4 const radiance = sampler.Texel(face, x, y) * solid_angle;
+						for (uint32_t i = 0; i < 9; ++ i)
+						{
+							coeffs[i] += radiance * basis[i];
+						}
+					}
+				}
+			});
+
+		float const bands[] = { 1, 2 / 3.0f, 2 / 3.0f, 2 / 3.0f, 1 / 4.0f, 1 / 4.0f, 1 / 4.0f, 1 / 4.0f, 1 / 4.0f };
+		std::vector<SIMDVectorF4> coeffs(9, SIMDVectorF4::Zero());
+		for (uint32_t task = 0; task < 6 * num_tiles; ++ task)
+		{
+			for (uint32_t i = 0; i < 9; ++ i)
+			{
+				coeffs[i] += tile_coeffs[task * 9 + i];
+			}
+		}
+		for (uint32_t i = 0; i < 9; ++ i)
+		{
+			coeffs[i] *= bands[i];
+		}
+		return coeffs;
+	}
+
+	void StoreHalf4(half* dst, SIMDVectorF4 const & v)
+	{
+		dst[0] = half(SIMDMathLib::GetX(v));
+		dst[1] = half(SIMDMathLib::GetY(v));
+		dst[2] = half(SIMDMathLib::GetZ(v));
+		dst[3] = half(1.0f);
+	}
+
+	// The same levels as PrefilterCubeGPU: level 0 is the input, the last level is the diffuse irradiance, and the
+	// others are the specular from glossy to rough. Tasks are rows of a face in a level, so all threads stay busy
+	// on the small levels as well.
+	bool PrefilterCubeCPU(std::string const & in_file, std::string const & out_file)
+	{
+		CubeSampler sampler;
+		if (!sampler.Load(in_file))
+		{
+			return false;
+		}
+
+		uint32_t const in_width = sampler.Size();
+		uint32_t const out_num_mipmaps = NumPrefilteredMipmaps(in_width);
+
+		TexelWorkers workers;
+
+		std::vector<std::vector<SpecularSample>> level_samples(out_num_mipmaps);
+		for (uint32_t level = 1; level < out_num_mipmaps - 1; ++ level)
+		{
+			level_samples[level] = BlinnPhongSamples(Glossiness2Shininess(static_cast<float>(out_num_mipmaps - 2 - level) / (out_num_mipmaps - 2)));
+		}
+		std::vector<SIMDVectorF4> const sh_coeffs = IrradianceSH(workers, sampler);
+
+		std::vector<ElementInitData> out_data(6 * out_num_mipmaps);
+		std::vector<std::vector<half>> out_data_block(out_data.size());
 
-		uint32_t out_num_mipmaps = 1;
+		struct RowTile
+		{
+			uint32_t face;
+			uint32_t level;
+			uint32_t y_begin;
+			uint32_t y_end;
+		};
+		std::vector<RowTile> tiles;
+		for (uint32_t face = 0; face < 6; ++ face)
 		{
-			uint32_t w = in_width;
-			while (w > 8)
+			for (uint32_t level = 0; level < out_num_mipmaps; ++ level)
 			{
-				++ out_num_mipmaps;
+				uint32_t const width = std::max<uint32_t>(1U, in_width >> level);
 
-				w = std::max<uint32_t>(1U, w / 2);
+				ElementInitData& data = out_data[face * out_num_mipmaps + level];
+				std::vector<half>& block = out_data_block[face * out_num_mipmaps + level];
+				block.resize(width * width * 4);
+				data.data = &block[0];
+				data.row_pitch = width * sizeof(half) * 4;
+				data.slice_pitch = data.row_pitch * width;
+
+				for (uint32_t y = 0; y < width; y += TexelWorkers::TILE_ROWS)
+				{
+					tiles.push_back({ face, level, y, std::min(y + TexelWorkers::TILE_ROWS, width) });
+				}
 			}
 		}
 
+		workers.ForEach(static_cast<uint32_t>(tiles.size()),
+			[&sampler, &level_samples, &sh_coeffs, &out_data_block, &tiles, in_width, out_num_mipmaps](uint32_t task)
+			{
+				RowTile const & tile = tiles[task];
+				uint32_t const width = std::max<uint32_t>(1U, in_width >> tile.level);
+				half* dst = &out_data_block[tile.face * out_num_mipmaps + tile.level][0];
+				std::vector<SpecularSample> const & samples = level_samples[tile.level];
+
+				for (uint32_t y = tile.y_begin; y < tile.y_end; ++ y)
+				{
+					for (uint32_t x = 0; x < width; ++ x)
+					{
+						half* texel = dst + (y * width + x) * 4;
+						if (0 == tile.level)
+						{
+							StoreHalf4(texel, sampler.Texel(tile.face, x, y));
+							continue;
+						}
+
+						float3 const normal = CubeTexelDir(tile.face, (x + 0.5f) / width, (y + 0.5f) / width);
+						if (tile.level == out_num_mipmaps - 1)
+						{
+							float basis[9];
+							SHBasis(normal, basis);
+							SIMDVectorF4 irradiance = SIMDVectorF4::Zero();
+							for (uint32_t i = 0; i < 9; ++ i)
+							{
+								irradiance += sh_coeffs[i] * basis[i];
+							}
+							StoreHalf4(texel, SIMDMathLib::Maximize(irradiance, SIMDVectorF4::Zero()));
+						}
+						else
+						{
+							float3 tangent, binormal;
+							TangentFrame(normal, tangent, binormal);
+
+							SIMDVectorF4 prefiltered_clr = SIMDVectorF4::Zero();
+							float total_weight = 0;
+							for (auto const & sample : samples)
+							{
+								float3 const l = tangent * sample.l.x() + binormal * sample.l.y() + normal * sample.l.z();
+								prefiltered_clr += sampler.Sample(l) * sample.n_dot_l;
+								total_weight += sample.n_dot_l;
+							}
+							StoreHalf4(texel, prefiltered_clr / std::max(1e-6f, total_weight));
+						}
+					}
+				}
+			});
+
+		SaveTexture(out_file, Texture::TT_Cube, in_width, in_width, 1, out_num_mipmaps, 1, EF_ABGR16F, out_data);
+		return true;
+	}
+
+	// Compares the RGB of each level with a stored output, such as one from the GPU path. Returns false if the RMS
+	// error of a level is more than tolerance of the RMS of the reference.
+	bool CompareWithReference(std::string const & out_file, std::string const & ref_file, float tolerance)
+	{
+		Texture::TextureType types[2];
+		uint32_t widths[2], heights[2], depths[2];
+		uint32_t num_mipmaps[2];
+		uint32_t array_sizes[2];
+		ElementFormat formats[2];
+		std::vector<ElementInitData> init_data[2];
+		std::vector<uint8_t> data_blocks[2];
+		std::string const files[] = { out_file, ref_file };
+		for (uint32_t i = 0; i < 2; ++ i)
+		{
+			LoadTexture(files[i], types[i], widths[i], heights[i], depths[i], num_mipmaps[i], array_sizes[i], formats[i],
+				init_data[i], data_blocks[i]);
+		}
+		if ((types[1] != Texture::TT_Cube) || (widths[0] != widths[1]) || (num_mipmaps[0] != num_mipmaps[1]))
+		{
+			cout << ref_file << " doesn't have the same layout as " << out_file << endl;
+			return false;
+		}
+
+		bool ret = true;
+		for (uint32_t level = 0; level < num_mipmaps[0]; ++ level)
+		{
+			uint32_t const width = std::max<uint32_t>(1U, widths[0] >> level);
+			double error_sq = 0;
+			double ref_sq = 0;
+			float max_error = 0;
+			for (uint32_t face = 0; face < 6; ++ face)
+			{
+				std::vector<Color> texels[2];
+				for (uint32_t i = 0; i < 2; ++ i)
+				{
+					ElementInitData const & src = init_data[i][face * num_mipmaps[i] + level];
+					texels[i].resize(width * width);
+					ResizeTexture(&texels[i][0], width * sizeof(Color), width * width * sizeof(Color), EF_ABGR32F,
+						width, width, 1,
+						src.data, src.row_pitch, src.slice_pitch, formats[i], width, width, 1, false);
+				}
+
+				for (uint32_t j = 0; j < width * width; ++ j)
+				{
+					for (uint32_t c = 0; c < 3; ++ c)
+					{
+						float const diff = texels[0][j][c] - texels[1][j][c];
+						error_sq += diff * diff;
+						ref_sq += texels[1][j][c] * texels[1][j][c];
+						max_error = std::max(max_error, MathLib::abs(diff));
+					}
+				}
+			}
+
+			float const relative_error = static_cast<float>(MathLib::sqrt(error_sq / std::max(ref_sq, 1e-12)));
+			cout << "Level " << level << ": relative RMS error " << relative_error << ", max error " << max_error << endl;
+			if (relative_error > tolerance)
+			{
+				ret = false;
+			}
+		}
+
+		return ret;
+	}
+
+	void PrefilterCubeGPU(std::string const & in_file, std::string const & out_file)
+	{
+		TexturePtr in_tex = SyncLoadTexture(in_file, EAH_GPU_Read | EAH_Immutable);
+		uint32_t in_width = in_tex->Width(0);
+		uint32_t out_num_mipmaps = NumPrefilteredMipmaps(in_width);
+
 		RenderFactory& rf = Context::Instance().RenderFactoryInstance();
 
 		PostProcessPtr diff_pp = SyncLoadPostProcess("PrefilterCube.ppml", "PrefilterCubeDiffuse");
@@ -102,35 +545,91 @@ int main(int argc, char* argv[])
 	context_cfg.graphics_cfg.gamma = false;
 	Context::Instance().Config(context_cfg);
 
-	PrefilterCubeApp app;
-	app.Create();
-
-	using namespace KlayGE;
-
 	if (argc < 2)
 	{
-		cout << "Usage: PrefilterCube xxx.dds [xxx_filtered.dds]" << endl;
+		cout << "Usage: PrefilterCube xxx.dds [xxx_filtered.dds] [-cpu] [-ref reference.dds [tolerance=0.1]]" << endl;
+		cout << "\tAdd -cpu to filter without a render device." << endl;
+		cout << "\tAdd -ref to compare the output with a stored one." << endl;
 		return 1;
 	}
 
-	std::string input(argv[1]);
+	std::vector<std::string> args(argv + 1, argv + argc);
+	bool use_cpu = false;
+	std::string ref_file;
+	float tolerance = 0.1f;
+	for (auto iter = args.begin(); iter != args.end();)
+	{
+		if ("-cpu" == *iter)
+		{
+			use_cpu = true;
+			iter = args.erase(iter);
+		}
+		else if (("-ref" == *iter) && (iter + 1 != args.end()))
+		{
+			ref_file = *(iter + 1);
+			iter = args.erase(iter, iter + 2);
+			if ((iter != args.end()) && !iter->empty() && (isdigit(static_cast<unsigned char>((*iter)[0])) || ('.' == (*iter)[0])))
+			{
+				tolerance = static_cast<float>(atof(iter->c_str()));
+				iter = args.erase(iter);
+			}
+		}
+		else
+		{
+			++ iter;
+		}
+	}
+	if (args.empty())
+	{
+		cout << "No input cube map" << endl;
+		return 1;
+	}
+
+	std::unique_ptr<PrefilterCubeApp> app;
+	if (!use_cpu)
+	{
+		app = MakeUniquePtr<PrefilterCubeApp>();
+		app->Create();
+	}
+
+	std::string input(args[0]);
 	std::string output;
-	if (argc >= 3)
+	if (args.size() >= 2)
 	{
-		output = argv[2];
+		output = args[1];
 	}
 	else
 	{
-		filesystem::path output_path(argv[1]);
+		filesystem::path output_path(args[0]);
 		output = output_path.stem().string() + "_filtered.dds";
 	}
 
 	Timer timer;
 
-	PrefilterCubeGPU(input, output);
+	if (use_cpu)
+	{
+		if (!PrefilterCubeCPU(input, output))
+		{
+			cout << input << " is not a cube map" << endl;
+			return 1;
+		}
+	}
+	else
+	{
+		PrefilterCubeGPU(input, output);
+	}
 
 	cout << timer.elapsed() << " s" << endl;
 	cout << "Filtered cube map is saved into " << output << endl;
 
+	if (!ref_file.empty())
+	{
+		if (!CompareWithReference(output, ref_file, tolerance))
+		{
+			cout << "The output is off the reference by more than " << tolerance << endl;
+			return 1;
+		}
+	}
+
 	return 0;
 }
@@ -10,6 +10,8 @@
 #include <vector>
 #include <cstring>
 
+#include "TexelWorkers.hpp"
+
 using namespace std;
 using namespace KlayGE;
 
@@ -28,6 +30,8 @@ namespace
 		std::vector<uint8_t> in_data_block;
 		LoadTexture(in_file, in_type, in_width, in_height, in_depth, in_num_mipmaps, in_array_size, in_format, in_data, in_data_block);
 
+		TexelWorkers workers;
+
 		std::vector<ElementInitData> height_data(in_data.size());
 		std::vector<std::vector<uint8_t>> height_data_block(in_data.size());
 		for (size_t array_index = 0; array_index < in_array_size; ++ array_index)
@@ -62,19 +66,18 @@ namespace
 
 			for (uint32_t z = 0; z < in_depth; ++ z)
 			{
-				for (uint32_t y = 0; y < in_height; ++ y)
-				{
-					for (uint32_t x = 0; x < in_width; ++ x)
+				uint8_t const * rgba_slice = rgba_data + z * rgba_slice_pitch;
+				uint8_t* height_slice = &height_data_block[array_index * in_num_mipmaps][z * in_height * in_width];
+				workers.ForEachTexel(in_width, in_height, [&RGB_TO_LUM, rgba_slice, rgba_row_pitch, height_slice, in_width](uint32_t x,
+					uint32_t y)
 					{
-						float const r = rgba_data[z * rgba_slice_pitch + y * rgba_row_pitch + x * 4 + 0] / 255.0f;
-						float const g = rgba_data[z * rgba_slice_pitch + y * rgba_row_pitch + x * 4 + 1] / 255.0f;
-						float const b = rgba_data[z * rgba_slice_pitch + y * rgba_row_pitch + x * 4 + 2] / 255.0f;
+						float const r = rgba_slice[y * rgba_row_pitch + x * 4 + 0] / 255.0f;
+						float const g = rgba_slice[y * rgba_row_pitch + x * 4 + 1] / 255.0f;
+						float const b = rgba_slice[y * rgba_row_pitch + x * 4 + 2] / 255.0f;
 
 						float const lum = MathLib::dot(float3(r, g, b), RGB_TO_LUM);
-						height_data_block[array_index * in_num_mipmaps][(z * in_height + y) * in_width + x]
-							= static_cast<uint8_t>(MathLib::clamp(static_cast<int>(lum * 255 + 0.5f), 0, 255));
-					}
-				}
+						height_slice[y * in_width + x] = static_cast<uint8_t>(MathLib::clamp(static_cast<int>(lum * 255 + 0.5f), 0, 255));
+					});
 
 				uint32_t last_width = in_width;
 				uint32_t last_height = in_height;
@@ -9,11 +9,21 @@
 #include <KlayGE/TexCompressionETC.hpp>
 #include <KFL/CpuInfo.hpp>
 #include <KFL/Hash.hpp>
+#include <KFL/Thread.hpp>
+#include <KFL/CXX17/filesystem.hpp>
 
 #include <boost/algorithm/string/case_conv.hpp>
+#include <boost/algorithm/string/trim.hpp>
 
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
 #include <iostream>
 #include <fstream>
+#include <iterator>
+#include <mutex>
+#include <sstream>
 #include <vector>
 
 using namespace std;
@@ -21,241 +31,115 @@ using namespace KlayGE;
 
 namespace
 {
-	void CompressABlock(std::atomic<int32_t>& block_index, std::vector<std::tuple<uint32_t, uint32_t, uint32_t>> const & block_addrs,
-				uint32_t in_num_mipmaps, uint32_t in_width, uint32_t in_height, ElementFormat in_format,
-				std::vector<ElementInitData> const & in_data,
-				std::vector<ElementInitData> const & out_data, ElementFormat out_format)
-	{
-		std::unique_ptr<TexCompression> in_codec;
-		if (IsCompressedFormat(in_format))
-		{
-			switch (in_format)
-			{
-			case EF_BC1:
-			case EF_BC1_SRGB:
-			case EF_SIGNED_BC1:
-				in_codec = MakeUniquePtr<TexCompressionBC1>();
-				break;
-
-			case EF_BC2:
-			case EF_BC2_SRGB:
-			case EF_SIGNED_BC2:
-				in_codec = MakeUniquePtr<TexCompressionBC2>();
-				break;
-
-			case EF_BC3:
-			case EF_BC3_SRGB:
-			case EF_SIGNED_BC3:
-				in_codec = MakeUniquePtr<TexCompressionBC3>();
-				break;
-
-			case EF_BC4:
-			case EF_BC4_SRGB:
-			case EF_SIGNED_BC4:
-				in_codec = MakeUniquePtr<TexCompressionBC4>();
-				break;
-
-			case EF_BC5:
-			case EF_BC5_SRGB:
-			case EF_SIGNED_BC5:
-				in_codec = MakeUniquePtr<TexCompressionBC5>();
-				break;
-
-			case EF_BC6:
-				in_codec = MakeUniquePtr<TexCompressionBC6U>();
-				break;
-
-			case EF_SIGNED_BC6:
-				in_codec = MakeUniquePtr<TexCompressionBC6S>();
-				break;
-
-			case EF_BC7:
-			case EF_BC7_SRGB:
-				in_codec = MakeUniquePtr<TexCompressionBC7>();
-				break;
-
-			case EF_ETC1:
-				in_codec = MakeUniquePtr<TexCompressionETC1>();
-				break;
-
-			case EF_ETC2_BGR8:
-			case EF_ETC2_BGR8_SRGB:
-				in_codec = MakeUniquePtr<TexCompressionETC2RGB8>();
-				break;
-
-			case EF_ETC2_A1BGR8:
-			case EF_ETC2_A1BGR8_SRGB:
-				in_codec = MakeUniquePtr<TexCompressionETC2RGB8A1>();
-				break;
-
-			case EF_ETC2_ABGR8:
-			case EF_ETC2_ABGR8_SRGB:
-				// TODO
-				KFL_UNREACHABLE("Not implemented");
-				break;
-
-			case EF_ETC2_R11:
-			case EF_SIGNED_ETC2_R11:
-				// TODO
-				KFL_UNREACHABLE("Not implemented");
-				break;
-
-			case EF_ETC2_GR11:
-			case EF_SIGNED_ETC2_GR11:
-				// TODO
-				KFL_UNREACHABLE("Not implemented");
-				break;
-
-			default:
-				KFL_UNREACHABLE("Invalid compression format");
-			}
-		}
+	// Bump it when the output of the codecs changes, to invalidate the cache
+	uint32_t const CACHE_VERSION = 2;
+	TexCompressionMethod const COMPRESSION_METHOD = TCM_Quality;
 
-		std::unique_ptr<TexCompression> out_codec;
-		switch (out_format)
+	std::unique_ptr<TexCompression> CreateCodec(ElementFormat format)
+	{
+		std::unique_ptr<TexCompression> codec;
+		switch (format)
 		{
 		case EF_BC1:
 		case EF_BC1_SRGB:
 		case EF_SIGNED_BC1:
-			out_codec = MakeUniquePtr<TexCompressionBC1>();
+			codec = MakeUniquePtr<TexCompressionBC1>();
 			break;
 
 		case EF_BC2:
 		case EF_BC2_SRGB:
 		case EF_SIGNED_BC2:
-			out_codec = MakeUniquePtr<TexCompressionBC2>();
+			codec = MakeUniquePtr<TexCompressionBC2>();
 			break;
 
 		case EF_BC3:
 		case EF_BC3_SRGB:
 		case EF_SIGNED_BC3:
-			out_codec = MakeUniquePtr<TexCompressionBC3>();
+			codec = MakeUniquePtr<TexCompressionBC3>();
 			break;
 
 		case EF_BC4:
 		case EF_BC4_SRGB:
 		case EF_SIGNED_BC4:
-			out_codec = MakeUniquePtr<TexCompressionBC4>();
+			codec = MakeUniquePtr<TexCompressionBC4>();
 			break;
 
 		case EF_BC5:
 		case EF_BC5_SRGB:
 		case EF_SIGNED_BC5:
-			out_codec = MakeUniquePtr<TexCompressionBC5>();
+			codec = MakeUniquePtr<TexCompressionBC5>();
 			break;
 
 		case EF_BC6:
-			out_codec = MakeUniquePtr<TexCompressionBC6U>();
+			codec = MakeUniquePtr<TexCompressionBC6U>();
 			break;
 
 		case EF_SIGNED_BC6:
-			out_codec = MakeUniquePtr<TexCompressionBC6S>();
+			codec = MakeUniquePtr<TexCompressionBC6S>();
 			break;
 
 		case EF_BC7:
 		case EF_BC7_SRGB:
-			out_codec = MakeUniquePtr<TexCompressionBC7>();
+			codec = MakeUniquePtr<TexCompressionBC7>();
 			break;
 
 		case EF_ETC1:
-			out_codec = MakeUniquePtr<TexCompressionETC1>();
+			codec = MakeUniquePtr<TexCompressionETC1>();
 			break;
 
 		case EF_ETC2_BGR8:
 		case EF_ETC2_BGR8_SRGB:
-			out_codec = MakeUniquePtr<TexCompressionETC2RGB8>();
+			codec = MakeUniquePtr<TexCompressionETC2RGB8>();
 			break;
 
 		case EF_ETC2_A1BGR8:
 		case EF_ETC2_A1BGR8_SRGB:
-			out_codec = MakeUniquePtr<TexCompressionETC2RGB8A1>();
+			codec = MakeUniquePtr<TexCompressionETC2RGB8A1>();
 			break;
 
 		case EF_ETC2_ABGR8:
 		case EF_ETC2_ABGR8_SRGB:
-			// TODO
-			KFL_UNREACHABLE("Not implemented");
+			codec = MakeUniquePtr<TexCompressionETC2RGBA8>();
 			break;
 
 		case EF_ETC2_R11:
+			codec = MakeUniquePtr<TexCompressionETC2R11>();
+			break;
+
 		case EF_SIGNED_ETC2_R11:
-			// TODO
-			KFL_UNREACHABLE("Not implemented");
+			codec = MakeUniquePtr<TexCompressionETC2SignedR11>();
 			break;
 
 		case EF_ETC2_GR11:
+			codec = MakeUniquePtr<TexCompressionETC2RG11>();
+			break;
+
 		case EF_SIGNED_ETC2_GR11:
-			// TODO
-			KFL_UNREACHABLE("Not implemented");
+			codec = MakeUniquePtr<TexCompressionETC2SignedRG11>();
 			break;
 
 		default:
 			KFL_UNREACHABLE("Invalid compression format");
 		}
 
-		ElementFormat const block_in_fmt = in_codec ? in_codec->DecodedFormat() : in_format;
-		bool const color_conversion = (MakeNonSRGB(block_in_fmt) != out_codec->DecodedFormat());
-		uint32_t const num_texels = out_codec->BlockWidth() * out_codec->BlockHeight();
-		std::vector<uint8_t> block_in_data;
-		std::vector<Color> block_in_data_f32;
-
-		while (block_index < static_cast<int>(block_addrs.size()))
-		{
-			uint32_t index = block_index ++;
-			if (index >= block_addrs.size() - 1)
-			{
-				break;
-			}
-
-			auto const & block_addr = block_addrs[index];
-			uint32_t const sub_res = std::get<0>(block_addr);
-			uint32_t const x = std::get<1>(block_addr);
-			uint32_t const y = std::get<2>(block_addr);
-			uint32_t const array_index = sub_res / in_num_mipmaps;
-			uint32_t const mip = sub_res - array_index * in_num_mipmaps;
-			uint32_t const mip_width = std::max(1U, in_width >> mip);
-			uint32_t const mip_height = std::max(1U, in_height >> mip);
-
-			ElementInitData const & sub_res_data = in_data[std::get<0>(block_addr)];
-			uint8_t const * src_data = static_cast<uint8_t const *>(sub_res_data.data);
-			if (in_codec)
-			{
-				BOOST_ASSERT(in_codec->BlockWidth() == out_codec->BlockWidth());
-				BOOST_ASSERT(in_codec->BlockHeight() == out_codec->BlockHeight());
-
-				block_in_data.resize(num_texels * NumFormatBytes(block_in_fmt));
-				in_codec->DecodeBlock(&block_in_data[0], src_data
-					+ (y / in_codec->BlockHeight()) * sub_res_data.row_pitch + x / in_codec->BlockWidth() * in_codec->BlockBytes());
-			}
-			else
-			{
-				uint32_t const elem_size = NumFormatBytes(in_format);
-				block_in_data.resize(num_texels * elem_size, 0);
-				for (uint32_t dy = 0; (dy < out_codec->BlockHeight()) && (y + dy < mip_height); ++ dy)
-				{
-					memcpy(&block_in_data[dy * out_codec->BlockWidth() * elem_size],
-						src_data + (y + dy) * sub_res_data.row_pitch + x * elem_size,
-						std::min(out_codec->BlockWidth(), mip_width - x) * elem_size);
-				}
-			}
-
-			if (color_conversion)
-			{
-				block_in_data_f32.resize(num_texels);
-				ConvertToABGR32F(block_in_fmt, &block_in_data[0], num_texels, &block_in_data_f32[0]);
-				block_in_data.resize(num_texels * NumFormatBytes(out_codec->DecodedFormat()));
-				ConvertFromABGR32F(out_codec->DecodedFormat(), &block_in_data_f32[0], num_texels, &block_in_data[0]);
-			}
-
-			uint32_t const offset = y / out_codec->BlockHeight() * out_data[sub_res].row_pitch
-				+ (x / out_codec->BlockWidth()) * out_codec->BlockBytes();
-			uint8_t* dst = static_cast<uint8_t*>(const_cast<void*>(out_data[sub_res].data));
-			out_codec->EncodeBlock(dst + offset, &block_in_data[0], TCM_Quality);
-		}
+		return codec;
 	}
 
-	void CompressTex(std::string const & in_file, std::string const & out_file, ElementFormat fmt)
+	struct BlockAddr
+	{
+		uint32_t sub_res;
+		uint32_t x;
+		uint32_t y;
+	};
+
+	// One texture of a run. Its blocks are compressed by any thread, and the thread finishing the last one saves it.
+	struct TexJob
 	{
+		uint32_t index;
+		std::string in_file;
+		std::string out_file;
+		std::string cache_file;
+
 		Texture::TextureType in_type;
 		uint32_t in_width, in_height, in_depth;
 		uint32_t in_num_mipmaps;
@@ -263,132 +147,162 @@ namespace
 		ElementFormat in_format;
 		std::vector<ElementInitData> in_data;
 		std::vector<uint8_t> in_data_block;
-		LoadTexture(in_file, in_type, in_width, in_height, in_depth, in_num_mipmaps, in_array_size, in_format, in_data, in_data_block);
 
-		if (IsSigned(in_format))
+		uint32_t out_width, out_height;
+		ElementFormat out_format;
+		std::vector<ElementInitData> new_data;
+		std::vector<std::vector<uint8_t>> new_data_block;
+
+		std::vector<BlockAddr> block_addrs;
+		uint32_t next_block;
+		std::atomic<uint32_t> remaining_blocks;
+	};
+
+	// A cache entry is the DDS file followed by this footer, so a truncated entry is detected and ignored
+	struct CacheFooter
+	{
+		uint64_t dds_size;
+		uint32_t fourcc;
+		uint32_t version;
+	};
+	uint32_t const CACHE_FOURCC = MakeFourCC<'T', 'C', 'C', 'E'>::value;
+
+	// Named by the hash of the source bytes, the requested format and the compression settings
+	std::string CacheFileName(std::string const & in_file, ElementFormat fmt)
+	{
+		std::ifstream ifs(in_file.c_str(), std::ios_base::binary);
+		if (!ifs)
 		{
-			fmt = MakeSigned(fmt);
+			return std::string();
 		}
-		if (IsSRGB(in_format))
+		std::vector<char> const content((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+
+		size_t seed = 0;
+		HashRange(seed, content.begin(), content.end());
+		HashCombine(seed, content.size());
+		HashCombine(seed, static_cast<uint64_t>(fmt));
+		HashCombine(seed, static_cast<uint32_t>(COMPRESSION_METHOD));
+		HashCombine(seed, CACHE_VERSION);
+
+		std::ostringstream ss;
+		ss << ResLoader::Instance().LocalFolder() << "TexCompressorCache/" << std::hex << seed << ".dds";
+		return ss.str();
+	}
+
+	// Copies a complete cache entry to the output. Returns false if there is no entry, or it's truncated.
+	bool CopyFromCache(std::string const & cache_file, std::string const & out_file)
+	{
+		// Read it completely first, the output could be the input
+		std::ifstream ifs(cache_file.c_str(), std::ios_base::binary);
+		if (!ifs)
 		{
-			fmt = MakeSRGB(fmt);
+			return false;
 		}
-
-		std::unique_ptr<TexCompression> out_codec;
-		switch (fmt)
+		std::vector<char> const cached((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+		if (cached.size() <= sizeof(CacheFooter))
 		{
-		case EF_BC1:
-		case EF_BC1_SRGB:
-		case EF_SIGNED_BC1:
-			out_codec = MakeUniquePtr<TexCompressionBC1>();
-			break;
-
-		case EF_BC2:
-		case EF_BC2_SRGB:
-		case EF_SIGNED_BC2:
-			out_codec = MakeUniquePtr<TexCompressionBC2>();
-			break;
-
-		case EF_BC3:
-		case EF_BC3_SRGB:
-		case EF_SIGNED_BC3:
-			out_codec = MakeUniquePtr<TexCompressionBC3>();
-			break;
-
-		case EF_BC4:
-		case EF_BC4_SRGB:
-		case EF_SIGNED_BC4:
-			out_codec = MakeUniquePtr<TexCompressionBC4>();
-			break;
-
-		case EF_BC5:
-		case EF_BC5_SRGB:
-		case EF_SIGNED_BC5:
-			out_codec = MakeUniquePtr<TexCompressionBC5>();
-			break;
-
-		case EF_BC6:
-			out_codec = MakeUniquePtr<TexCompressionBC6U>();
-			break;
-
-		case EF_SIGNED_BC6:
-			out_codec = MakeUniquePtr<TexCompressionBC6S>();
-			break;
+			return false;
+		}
 
-		case EF_BC7:
-		case EF_BC7_SRGB:
-			out_codec = MakeUniquePtr<TexCompressionBC7>();
-			break;
+		CacheFooter footer;
+		std::memcpy(&footer, &cached[cached.size() - sizeof(footer)], sizeof(footer));
+		footer.dds_size = LE2Native(footer.dds_size);
+		footer.fourcc = LE2Native(footer.fourcc);
+		footer.version = LE2Native(footer.version);
+		if ((footer.fourcc != CACHE_FOURCC) || (footer.version != CACHE_VERSION)
+			|| (footer.dds_size != cached.size() - sizeof(footer)))
+		{
+			return false;
+		}
 
-		case EF_ETC1:
-			out_codec = MakeUniquePtr<TexCompressionETC1>();
-			break;
+		std::ofstream ofs(out_file.c_str(), std::ios_base::binary);
+		ofs.write(&cached[0], footer.dds_size);
+		return static_cast<bool>(ofs);
+	}
 
-		case EF_ETC2_BGR8:
-		case EF_ETC2_BGR8_SRGB:
-			out_codec = MakeUniquePtr<TexCompressionETC2RGB8>();
-			break;
+	// Written atomically, an interrupted write never leaves a truncated entry behind. The cache is optional, if it's not
+	// written the next run compresses again.
+	void SaveToCache(TexJob const & job)
+	{
+		WriteFileAtomically(job.cache_file, [&job](std::string const & tmp_name)
+			{
+				SaveTexture(tmp_name, job.in_type, job.out_width, job.out_height, job.in_depth, job.in_num_mipmaps,
+					job.in_array_size, job.out_format, job.new_data);
 
-		case EF_ETC2_A1BGR8:
-		case EF_ETC2_A1BGR8_SRGB:
-			out_codec = MakeUniquePtr<TexCompressionETC2RGB8A1>();
-			break;
+				CacheFooter footer;
+				footer.dds_size = Native2LE(static_cast<uint64_t>(std::filesystem::file_size(tmp_name)));
+				footer.fourcc = Native2LE(CACHE_FOURCC);
+				footer.version = Native2LE(CACHE_VERSION);
 
-		case EF_ETC2_ABGR8:
-		case EF_ETC2_ABGR8_SRGB:
-			// TODO
-			KFL_UNREACHABLE("Not implemented");
-			break;
+				std::ofstream ofs(tmp_name.c_str(), std::ios_base::binary | std::ios_base::app);
+				ofs.write(reinterpret_cast<char const *>(&footer), sizeof(footer));
+				if (!ofs)
+				{
+					throw std::ios_base::failure("Failed to write the cache entry");
+				}
+			});
+	}
 
-		case EF_ETC2_R11:
-		case EF_SIGNED_ETC2_R11:
-			// TODO
-			KFL_UNREACHABLE("Not implemented");
-			break;
+	// Loads the texture and lists its blocks. Returns false if the output is copied from the cache.
+	bool PrepareJob(TexJob& job, ElementFormat fmt, bool use_cache)
+	{
+		if (use_cache)
+		{
+			job.cache_file = CacheFileName(job.in_file, fmt);
+			if (!job.cache_file.empty() && CopyFromCache(job.cache_file, job.out_file))
+			{
+				return false;
+			}
+		}
 
-		case EF_ETC2_GR11:
-		case EF_SIGNED_ETC2_GR11:
-			// TODO
-			KFL_UNREACHABLE("Not implemented");
-			break;
+		LoadTexture(job.in_file, job.in_type, job.in_width, job.in_height, job.in_depth, job.in_num_mipmaps, job.in_array_size,
+			job.in_format, job.in_data, job.in_data_block);
 
-		default:
-			KFL_UNREACHABLE("Invalid compression format");
+		if (IsSigned(job.in_format))
+		{
+			fmt = MakeSigned(fmt);
+		}
+		if (IsSRGB(job.in_format))
+		{
+			fmt = MakeSRGB(fmt);
 		}
+		job.out_format = fmt;
+
+		std::unique_ptr<TexCompression> out_codec = CreateCodec(fmt);
 
-		uint32_t out_width = (in_width + out_codec->BlockWidth() - 1) & ~(out_codec->BlockWidth() - 1);
-		uint32_t out_height = (in_height + out_codec->BlockHeight() - 1) & ~(out_codec->BlockHeight() - 1);
+		job.out_width = (job.in_width + out_codec->BlockWidth() - 1) & ~(out_codec->BlockWidth() - 1);
+		job.out_height = (job.in_height + out_codec->BlockHeight() - 1) & ~(out_codec->BlockHeight() - 1);
 
-		std::vector<ElementInitData> new_data(in_data.size());
-		std::vector<std::vector<uint8_t>> new_data_block(in_data.size());
+		job.new_data.resize(job.in_data.size());
+		job.new_data_block.resize(job.in_data.size());
 
-		std::vector<std::tuple<uint32_t, uint32_t, uint32_t>> block_addrs;
-		for (uint32_t array_index = 0; array_index < in_array_size; ++ array_index)
+		uint32_t const num_slices = static_cast<uint32_t>(job.in_data.size() / job.in_num_mipmaps);
+		for (uint32_t array_index = 0; array_index < num_slices; ++ array_index)
 		{
-			uint32_t src_width = in_width;
-			uint32_t src_height = in_height;
+			uint32_t src_width = job.in_width;
+			uint32_t src_height = job.in_height;
 
-			uint32_t dst_width = out_width;
-			uint32_t dst_height = out_height;
+			uint32_t dst_width = job.out_width;
+			uint32_t dst_height = job.out_height;
 
-			for (uint32_t mip = 0; mip < in_num_mipmaps; ++ mip)
+			for (uint32_t mip = 0; mip < job.in_num_mipmaps; ++ mip)
 			{
-				uint32_t const sub_res = array_index * in_num_mipmaps + mip;
+				uint32_t const sub_res = array_index * job.in_num_mipmaps + mip;
 				uint32_t const block_size = out_codec->BlockBytes();
 
-				ElementInitData& dst_data = new_data[sub_res];
+				ElementInitData& dst_data = job.new_data[sub_res];
 
 				dst_data.row_pitch = ((dst_width + out_codec->BlockWidth() - 1) / out_codec->BlockWidth()) * block_size;
 				dst_data.slice_pitch = dst_data.row_pitch * ((dst_height + out_codec->BlockHeight() - 1) / out_codec->BlockHeight());
 
-				new_data_block[sub_res].resize(dst_data.slice_pitch);
-				dst_data.data = &new_data_block[sub_res][0];
+				job.new_data_block[sub_res].resize(dst_data.slice_pitch);
+				dst_data.data = &job.new_data_block[sub_res][0];
 
 				for (uint32_t y = 0; y < src_height; y += out_codec->BlockHeight())
 				{
 					for (uint32_t x = 0; x < src_width; x += out_codec->BlockWidth())
 					{
-						block_addrs.push_back(std::make_tuple(sub_res, x, y));
+						job.block_addrs.push_back({ sub_res, x, y });
 					}
 				}
 
@@ -400,43 +314,334 @@ namespace
 			}
 		}
 
-		CPUInfo cpu;
-		uint32_t const num_threads = cpu.NumHWThreads();
-		thread_pool tp(1, num_threads);
-		std::vector<joiner<void>> joiners(num_threads);
-		std::atomic<int> block_index(0);
-		for (uint32_t i = 0; i < num_threads; ++ i)
+		job.next_block = 0;
+		job.remaining_blocks = static_cast<uint32_t>(job.block_addrs.size());
+		return true;
+	}
+
+	// All blocks of the open textures go through one pool, so small textures don't leave threads idle. A texture is
+	// loaded only when no open one has blocks left to hand out, so just a few are in memory at any time.
+	class CompressionContext
+	{
+	public:
+		CompressionContext(std::vector<std::pair<std::string, std::string>> const & files, ElementFormat fmt, bool use_cache)
+			: files_(files), fmt_(fmt), use_cache_(use_cache), next_file_(0), num_preparing_jobs_(0),
+				num_done_jobs_(0), num_cached_(0)
+		{
+		}
+
+		void CompressBlocks()
+		{
+			uint32_t codec_job = static_cast<uint32_t>(-1);
+			std::unique_ptr<TexCompression> in_codec;
+			std::unique_ptr<TexCompression> out_codec;
+			std::vector<uint8_t> block_in_data;
+			std::vector<uint8_t> block_converted_data;
+
+			for (;;)
+			{
+				TexJob* job;
+				uint32_t block;
+				if (!this->ClaimBlock(job, block))
+				{
+					if (this->OpenNextJob() || this->WaitForPreparingJobs())
+					{
+						continue;
+					}
+					else
+					{
+						break;
+					}
+				}
+
+				// Blocks are handed out by texture, so the codecs rarely change
+				if (codec_job != job->index)
+				{
+					in_codec = IsCompressedFormat(job->in_format) ? CreateCodec(job->in_format) : nullptr;
+					out_codec = CreateCodec(job->out_format);
+					codec_job = job->index;
+				}
+
+				this->CompressABlock(*job, job->block_addrs[block], in_codec.get(), *out_codec,
+					block_in_data, block_converted_data);
+
+				if (0 == -- job->remaining_blocks)
+				{
+					this->FinishJob(*job);
+				}
+			}
+		}
+
+		uint32_t NumCompressed() const
+		{
+			return num_done_jobs_;
+		}
+		uint32_t NumCached() const
+		{
+			return num_cached_;
+		}
+
+	private:
+		bool ClaimBlock(TexJob*& job, uint32_t& block)
+		{
+			std::lock_guard<std::mutex> lock(open_jobs_mutex_);
+			for (auto const & open_job : open_jobs_)
+			{
+				if (open_job->next_block < open_job->block_addrs.size())
+				{
+					job = open_job.get();
+					block = open_job->next_block;
+					++ open_job->next_block;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		// Returns false if all files are taken
+		bool OpenNextJob()
+		{
+			uint32_t const index = next_file_ ++;
+			if (index >= files_.size())
+			{
+				return false;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(open_jobs_mutex_);
+				++ num_preparing_jobs_;
+			}
+
+			auto job = MakeUniquePtr<TexJob>();
+			job->index = index;
+			job->in_file = files_[index].first;
+			job->out_file = files_[index].second;
+			bool compress;
+			try
+			{
+				compress = PrepareJob(*job, fmt_, use_cache_);
+				if (!compress)
+				{
+					++ num_cached_;
+
+					std::lock_guard<std::mutex> lock(output_mutex_);
+					cout << "Up to date: " << job->out_file << endl;
+				}
+				else if (0 == job->remaining_blocks)
+				{
+					this->FinishJob(*job);
+				}
+			}
+			catch (...)
+			{
+				// Idle threads wait until no job is being prepared
+				{
+					std::lock_guard<std::mutex> lock(open_jobs_mutex_);
+					-- num_preparing_jobs_;
+				}
+				open_jobs_cv_.notify_all();
+				throw;
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(open_jobs_mutex_);
+				-- num_preparing_jobs_;
+				if (compress && (job->remaining_blocks > 0))
+				{
+					open_jobs_.push_back(std::move(job));
+				}
+			}
+			open_jobs_cv_.notify_all();
+
+			return true;
+		}
+
+		// Once all files are taken, idle threads wait for the ones still being loaded. Returns false if there are none.
+		bool WaitForPreparingJobs()
+		{
+			std::unique_lock<std::mutex> lock(open_jobs_mutex_);
+			open_jobs_cv_.wait(lock, [this]
+				{
+					return (0 == num_preparing_jobs_) || this->HasUnclaimedBlocksLocked();
+				});
+			return this->HasUnclaimedBlocksLocked();
+		}
+
+		bool HasUnclaimedBlocksLocked() const
 		{
-			joiners[i] = tp(std::bind(CompressABlock, std::ref(block_index), std::cref(block_addrs), in_num_mipmaps,
-				in_width, in_height, in_format, std::cref(in_data), std::cref(new_data), fmt));
+			for (auto const & open_job : open_jobs_)
+			{
+				if (open_job->next_block < open_job->block_addrs.size())
+				{
+					return true;
+				}
+			}
+			return false;
 		}
 
-		uint32_t const total_blocks = static_cast<uint32_t>(block_addrs.size());
-		for (;;)
+		void FinishJob(TexJob& job)
 		{
-			uint32_t index = block_index;
-			cout.precision(2);
-			cout << fixed << index * 100.0f / total_blocks << " %        \r";
+			SaveTexture(job.out_file, job.in_type, job.out_width, job.out_height, job.in_depth, job.in_num_mipmaps,
+				job.in_array_size, job.out_format, job.new_data);
+			if (!job.cache_file.empty())
+			{
+				SaveToCache(job);
+			}
+
+			uint32_t const done = ++ num_done_jobs_;
+			{
+				std::lock_guard<std::mutex> lock(output_mutex_);
+				cout << "[" << done + num_cached_ << "/" << files_.size() << "] " << job.out_file << endl;
+			}
+
+			// All its blocks are done, no other thread touches it any more
+			std::lock_guard<std::mutex> lock(open_jobs_mutex_);
+			for (auto iter = open_jobs_.begin(); iter != open_jobs_.end(); ++ iter)
+			{
+				if (iter->get() == &job)
+				{
+					open_jobs_.erase(iter);
+					break;
+				}
+			}
+		}
+
+		void CompressABlock(TexJob const & job, BlockAddr const & block_addr,
+			TexCompression* in_codec, TexCompression& out_codec,
+			std::vector<uint8_t>& block_in_data, std::vector<uint8_t>& block_converted_data)
+		{
+			ElementFormat const block_in_fmt = in_codec ? in_codec->DecodedFormat() : job.in_format;
+			bool const color_conversion = (MakeNonSRGB(block_in_fmt) != out_codec.DecodedFormat());
+			uint32_t const num_texels = out_codec.BlockWidth() * out_codec.BlockHeight();
+
+			uint32_t const sub_res = block_addr.sub_res;
+			uint32_t const x = block_addr.x;
+			uint32_t const y = block_addr.y;
+			uint32_t const mip = sub_res % job.in_num_mipmaps;
+			uint32_t const mip_width = std::max(1U, job.in_width >> mip);
+			uint32_t const mip_height = std::max(1U, job.in_height >> mip);
+
+			ElementInitData const & sub_res_data = job.in_data[sub_res];
+			uint8_t const * src_data = static_cast<uint8_t const *>(sub_res_data.data);
+			if (in_codec)
+			{
+				BOOST_ASSERT(in_codec->BlockWidth() == out_codec.BlockWidth());
+				BOOST_ASSERT(in_codec->BlockHeight() == out_codec.BlockHeight());
 
-			if (index >= total_blocks)
+				block_in_data.resize(num_texels * NumFormatBytes(block_in_fmt));
+				in_codec->DecodeBlock(&block_in_data[0], src_data
+					+ (y / in_codec->BlockHeight()) * sub_res_data.row_pitch + x / in_codec->BlockWidth() * in_codec->BlockBytes());
+			}
+			else
 			{
-				break;
+				uint32_t const elem_size = NumFormatBytes(job.in_format);
+				block_in_data.assign(num_texels * elem_size, 0);
+				for (uint32_t dy = 0; (dy < out_codec.BlockHeight()) && (y + dy < mip_height); ++ dy)
+				{
+					memcpy(&block_in_data[dy * out_codec.BlockWidth() * elem_size],
+						src_data + (y + dy) * sub_res_data.row_pitch + x * elem_size,
+						std::min(out_codec.BlockWidth(), mip_width - x) * elem_size);
+				}
 			}
 
-			KlayGE::Sleep(1000);
+			uint8_t const * block_src = &block_in_data[0];
+			if (color_conversion)
+			{
+				block_converted_data.resize(num_texels * NumFormatBytes(out_codec.DecodedFormat()));
+				ConvertFormat(block_in_fmt, &block_in_data[0], num_texels, out_codec.DecodedFormat(), &block_converted_data[0]);
+				block_src = &block_converted_data[0];
+			}
+
+			ElementInitData const & out_data = job.new_data[sub_res];
+			uint32_t const offset = y / out_codec.BlockHeight() * out_data.row_pitch
+				+ (x / out_codec.BlockWidth()) * out_codec.BlockBytes();
+			uint8_t* dst = static_cast<uint8_t*>(const_cast<void*>(out_data.data));
+			out_codec.EncodeBlock(dst + offset, block_src, COMPRESSION_METHOD);
+		}
+
+	private:
+		std::vector<std::pair<std::string, std::string>> const & files_;
+		ElementFormat const fmt_;
+		bool const use_cache_;
+
+		std::atomic<uint32_t> next_file_;
+		std::vector<std::unique_ptr<TexJob>> open_jobs_;
+		uint32_t num_preparing_jobs_;
+		std::mutex open_jobs_mutex_;
+		std::condition_variable open_jobs_cv_;
+
+		std::atomic<uint32_t> num_done_jobs_;
+		std::atomic<uint32_t> num_cached_;
+		std::mutex output_mutex_;
+	};
+
+	void CompressTexs(std::vector<std::pair<std::string, std::string>> const & files, ElementFormat fmt, bool use_cache)
+	{
+		if (use_cache)
+		{
+			std::filesystem::create_directories(ResLoader::Instance().LocalFolder() + "TexCompressorCache");
 		}
 
-		for (uint32_t i = 0; i < num_threads; ++ i)
+		CompressionContext context(files, fmt, use_cache);
+
+		CPUInfo cpu;
+		uint32_t const num_threads = static_cast<uint32_t>(std::max(cpu.NumHWThreads(), 1));
+		thread_pool tp(1, num_threads);
+		// One task per thread, the context hands out the blocks
+		parallel_for(tp, num_threads, num_threads, [&context](uint32_t thread)
+			{
+				KFL_UNUSED(thread);
+				context.CompressBlocks();
+			});
+
+		cout << context.NumCompressed() << " compressed, " << context.NumCached() << " from cache." << endl;
+	}
+
+	// A directory means all the .dds files in it, anything else is a text file with one texture per line
+	std::vector<std::string> CollectBatchFiles(std::string const & batch)
+	{
+		std::vector<std::string> ret;
+		if (std::filesystem::is_directory(batch))
 		{
-			joiners[i]();
+			for (std::filesystem::directory_iterator iter(batch), end; iter != end; ++ iter)
+			{
+				std::string ext = iter->path().extension().string();
+				boost::algorithm::to_lower(ext);
+				if (std::filesystem::is_regular_file(iter->path()) && (".dds" == ext))
+				{
+					ret.push_back(iter->path().string());
+				}
+			}
+		}
+		else
+		{
+			std::ifstream ifs(batch.c_str());
+			std::string line;
+			while (std::getline(ifs, line))
+			{
+				boost::algorithm::trim(line);
+				if (!line.empty())
+				{
+					std::string const file = ResLoader::Instance().Locate(line);
+					if (file.empty())
+					{
+						cout << "Couldn't locate " << line << endl;
+					}
+					else
+					{
+						ret.push_back(file);
+					}
+				}
+			}
 		}
 
-		SaveTexture(out_file, in_type, out_width, out_height, in_depth, in_num_mipmaps, in_array_size, fmt, new_data);
+		return ret;
 	}
 
 	void PrintSupportedFormats()
 	{
-		cout << "Supported formats: bc1, bc2, bc3, bc4, bc5, bc7, etc1" << endl;
+		cout << "Supported formats: bc1, bc2, bc3, bc4, bc5, bc6, bc6_signed, bc7, etc1, etc2_rgb8, etc2_rgb8a1, etc2_rgba8, "
+			"etc2_r11, etc2_r11_signed, etc2_rg11, etc2_rg11_signed" << endl;
 	}
 }
 
@@ -445,12 +650,30 @@ int main(int argc, char* argv[])
 	if (argc < 3)
 	{
 		cout << "Usage: TexCompressor format xxx.dds [yyy.dds]" << endl;
+		cout << "       TexCompressor format -batch dir|list.txt [output_dir]" << endl;
+		cout << "\tWithout output_dir, a batch is written to a subdirectory named after the format, next to the input." << endl;
 		cout << "\t";
 		PrintSupportedFormats();
+		cout << "\tAdd -nocache to ignore and not update the compressed texture cache." << endl;
 		return 1;
 	}
 
-	std::string fmt_str = argv[1];
+	std::vector<std::string> args(argv + 1, argv + argc);
+	bool use_cache = true;
+	for (auto iter = args.begin(); iter != args.end();)
+	{
+		if ("-nocache" == *iter)
+		{
+			use_cache = false;
+			iter = args.erase(iter);
+		}
+		else
+		{
+			++ iter;
+		}
+	}
+
+	std::string fmt_str = args[0];
 	boost::algorithm::to_lower(fmt_str);
 	size_t const fmt_hash = RT_HASH(fmt_str.c_str());
 
@@ -475,6 +698,14 @@ int main(int argc, char* argv[])
 	{
 		fmt = EF_BC5;
 	}
+	else if (CT_HASH("bc6") == fmt_hash)
+	{
+		fmt = EF_BC6;
+	}
+	else if (CT_HASH("bc6_signed") == fmt_hash)
+	{
+		fmt = EF_SIGNED_BC6;
+	}
 	else if (CT_HASH("bc7") == fmt_hash)
 	{
 		fmt = EF_BC7;
@@ -483,6 +714,34 @@ int main(int argc, char* argv[])
 	{
 		fmt = EF_ETC1;
 	}
+	else if (CT_HASH("etc2_rgb8") == fmt_hash)
+	{
+		fmt = EF_ETC2_BGR8;
+	}
+	else if (CT_HASH("etc2_rgb8a1") == fmt_hash)
+	{
+		fmt = EF_ETC2_A1BGR8;
+	}
+	else if (CT_HASH("etc2_rgba8") == fmt_hash)
+	{
+		fmt = EF_ETC2_ABGR8;
+	}
+	else if (CT_HASH("etc2_r11") == fmt_hash)
+	{
+		fmt = EF_ETC2_R11;
+	}
+	else if (CT_HASH("etc2_r11_signed") == fmt_hash)
+	{
+		fmt = EF_SIGNED_ETC2_R11;
+	}
+	else if (CT_HASH("etc2_rg11") == fmt_hash)
+	{
+		fmt = EF_ETC2_GR11;
+	}
+	else if (CT_HASH("etc2_rg11_signed") == fmt_hash)
+	{
+		fmt = EF_SIGNED_ETC2_GR11;
+	}
 	else
 	{
 		cout << "Unknown output format. ";
@@ -490,27 +749,66 @@ int main(int argc, char* argv[])
 		return 1;
 	}
 
-	std::string in_file = ResLoader::Instance().Locate(argv[2]);
-	if (in_file.empty())
+	std::vector<std::pair<std::string, std::string>> files;
+	if ((args.size() >= 3) && ("-batch" == args[1]))
 	{
-		cout << "Couldn't locate " << in_file << endl;
-		Context::Destroy();
-		return 1;
-	}
+		// Never overwrites the sources, a batch could be run again with another format
+		std::filesystem::path out_dir;
+		if (args.size() >= 4)
+		{
+			out_dir = args[3];
+		}
+		else
+		{
+			std::filesystem::path const batch_path(args[2]);
+			out_dir = (std::filesystem::is_directory(batch_path) ? batch_path : batch_path.parent_path()) / fmt_str;
+		}
+		std::filesystem::create_directories(out_dir);
 
-	std::string out_file;
-	if (argc < 4)
-	{
-		out_file = in_file;
+		for (auto const & in_file : CollectBatchFiles(args[2]))
+		{
+			std::filesystem::path const out_path = out_dir / std::filesystem::path(in_file).filename();
+			if (std::filesystem::exists(out_path) && std::filesystem::equivalent(in_file, out_path))
+			{
+				cout << "Skipping " << in_file << ", the output would overwrite it." << endl;
+			}
+			else
+			{
+				files.emplace_back(in_file, out_path.string());
+			}
+		}
 	}
-	else
+	else if (args.size() >= 2)
 	{
-		out_file = argv[3];
+		std::string in_file = ResLoader::Instance().Locate(args[1]);
+		if (in_file.empty())
+		{
+			cout << "Couldn't locate " << args[1] << endl;
+			Context::Destroy();
+			return 1;
+		}
+
+		std::string out_file;
+		if (args.size() < 3)
+		{
+			out_file = in_file;
+		}
+		else
+		{
+			out_file = args[2];
+		}
+
+		files.emplace_back(in_file, out_file);
 	}
 
-	CompressTex(in_file, out_file, fmt);
+	if (files.empty())
+	{
+		cout << "No texture to compress." << endl;
+		Context::Destroy();
+		return 1;
+	}
 
-	cout << "Compressed texture is saved." << endl;
+	CompressTexs(files, fmt, use_cache);
 
 	Context::Destroy();
 
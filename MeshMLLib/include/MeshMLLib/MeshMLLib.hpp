@@ -42,6 +42,7 @@
 #include <KFL/Vector.hpp>
 #include <KFL/Quaternion.hpp>
 #include <KFL/Matrix.hpp>
+#include <MeshMLLib/MeshOptimizer.hpp>
 
 #ifndef MESHMLLIB_SOURCE
 	#define KLAYGE_LIB_NAME MeshMLLib
@@ -66,6 +67,7 @@ namespace KlayGE
 			UES_None = 0,
 			UES_CombineMeshes = 0x1,
 			UES_SortMeshes = 0x2,
+			UES_OptimizeMeshes = 0x4,
 			UES_All = 0xFF
 		};
 
@@ -184,9 +186,15 @@ namespace KlayGE
 		void SetAction(int action_id, std::string const & name, int start_frame, int end_frame);
 
 		void WriteMeshML(std::ostream& os,
-			int vertex_export_settings = VES_TangentQuat | VES_Texcoord, int user_export_settings = UES_SortMeshes,
+			int vertex_export_settings = VES_TangentQuat | VES_Texcoord, int user_export_settings = UES_SortMeshes | UES_OptimizeMeshes,
 			std::string const & encoding = std::string());
 
+		// Filled by WriteMeshML with UES_OptimizeMeshes, one for each mesh with triangles
+		std::vector<std::pair<std::string, MeshOptimizationResult>> const & MeshOptimizationResults() const
+		{
+			return mesh_opt_results_;
+		}
+
 	private:
 		typedef std::pair<int, float> JointBinding;
 
@@ -274,6 +282,8 @@ namespace KlayGE
 		std::vector<Mesh> meshes_;
 		std::vector<Keyframes> keyframes_;
 		std::vector<AnimationAction> actions_;
+
+		std::vector<std::pair<std::string, MeshOptimizationResult>> mesh_opt_results_;
 	};
 }
 
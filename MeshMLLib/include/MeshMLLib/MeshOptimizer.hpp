@@ -0,0 +1,112 @@
+/**
+ * @file MeshOptimizer.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of MeshMLLib, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _MESHMLLIB_MESHOPTIMIZER_HPP
+#define _MESHMLLIB_MESHOPTIMIZER_HPP
+
+#pragma once
+
+#include <vector>
+
+#include <KFL/PreDeclare.hpp>
+#include <KFL/Vector.hpp>
+
+#ifndef MESHMLLIB_SOURCE
+	#define KLAYGE_LIB_NAME MeshMLLib
+	#include <KFL/Detail/AutoLink.hpp>
+#endif	// MESHMLLIB_SOURCE
+
+namespace KlayGE
+{
+	// Triangle lists only. The cache is modeled as a FIFO, small enough to be there on every GPU in use.
+	uint32_t const VERTEX_CACHE_SIZE = 16;
+	uint32_t const UNUSED_VERTEX = 0xFFFFFFFF;
+
+	struct VertexCacheStatistics
+	{
+		// Average cache miss ratio, vertex shader runs per triangle. 3 at worst, close to 0.5 on a large regular mesh at best.
+		float acmr;
+		// Average transformed vertex ratio, vertex shader runs per vertex used by triangles. 1 at best.
+		float atvr;
+	};
+
+	struct MeshOptimizationResult
+	{
+		VertexCacheStatistics before;
+		VertexCacheStatistics after;
+		uint32_t num_vertices;
+	};
+
+	VertexCacheStatistics AnalyzeVertexCache(std::vector<uint32_t> const & indices, uint32_t num_vertices,
+		uint32_t cache_size = VERTEX_CACHE_SIZE);
+
+	// Tipsify, from "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" by Sander, Nehab and Barczak.
+	// Returns the first triangle of each cluster, where the fan walk had to jump to a dead end or to an unused vertex
+	// because no vertex of the last fan would stay in the cache.
+	std::vector<uint32_t> OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t num_vertices,
+		uint32_t cache_size = VERTEX_CACHE_SIZE);
+	// From the same paper. Clusters are split further as long as that costs less than threshold times their ACMR, then
+	// sorted to draw the ones facing out of the mesh first. No clusters means the whole mesh is one.
+	void OptimizeOverdraw(std::vector<uint32_t>& indices, std::vector<uint32_t> const & clusters,
+		std::vector<float3> const & positions, float threshold = 1.05f, uint32_t cache_size = VERTEX_CACHE_SIZE);
+	// Renumbers vertices in the order triangles use them first. remap[old] is the new index, or UNUSED_VERTEX for vertices
+	// no triangle uses, which are dropped. Returns the number of vertices left.
+	uint32_t OptimizeVertexFetch(std::vector<uint32_t>& remap, std::vector<uint32_t>& indices, uint32_t num_vertices);
+
+	// All of the above in order. Vertex data has to be moved with RemapVertices afterwards.
+	MeshOptimizationResult OptimizeMesh(std::vector<uint32_t>& remap, std::vector<uint32_t>& indices,
+		std::vector<float3> const & positions);
+
+	// Any number of components per vertex. Empty attributes are left alone.
+	template <typename T>
+	void RemapVertices(std::vector<T>& attribs, std::vector<uint32_t> const & remap, uint32_t num_vertices)
+	{
+		if (attribs.empty())
+		{
+			return;
+		}
+
+		size_t const components = attribs.size() / remap.size();
+		std::vector<T> remapped(num_vertices * components);
+		for (size_t i = 0; i < remap.size(); ++ i)
+		{
+			if (remap[i] != UNUSED_VERTEX)
+			{
+				for (size_t c = 0; c < components; ++ c)
+				{
+					remapped[remap[i] * components + c] = attribs[i * components + c];
+				}
+			}
+		}
+		attribs.swap(remapped);
+	}
+}
+
+#endif		// _MESHMLLIB_MESHOPTIMIZER_HPP
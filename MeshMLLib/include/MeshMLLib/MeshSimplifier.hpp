@@ -0,0 +1,152 @@
+/**
+ * @file MeshSimplifier.hpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of MeshMLLib, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#ifndef _MESHMLLIB_MESHSIMPLIFIER_HPP
+#define _MESHMLLIB_MESHSIMPLIFIER_HPP
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <queue>
+#include <unordered_set>
+#include <vector>
+
+#include <KFL/PreDeclare.hpp>
+#include <KFL/Vector.hpp>
+
+#ifndef MESHMLLIB_SOURCE
+	#define KLAYGE_LIB_NAME MeshMLLib
+	#include <KFL/Detail/AutoLink.hpp>
+#endif	// MESHMLLIB_SOURCE
+
+namespace KlayGE
+{
+	// Edge collapses ordered by quadric error, from "Surface Simplification Using Quadric Error Metrics" by Garland and
+	// Heckbert. An edge collapses onto one of its vertices, so all levels index the original vertex buffer.
+	//
+	// Vertices at the same position are one corner of the surface. An edge only collapses if each vertex of the corner
+	// has a vertex across the edge in the same triangles, so UV, normal and skinning seams stay closed. Border corners
+	// only move along the border.
+	class MeshSimplifier
+	{
+	public:
+		// attribs has num_attribs floats per vertex, such as normals, texcoords or skinning weights. The caller scales
+		// them, so a difference of 1 costs as much as moving 1 unit away from the surface.
+		MeshSimplifier(std::vector<uint32_t> const & indices, std::vector<float3> const & positions,
+			std::vector<float> const & attribs, uint32_t num_attribs);
+
+		// Collapses edges until no more than target_num_triangles are left, or no edge can collapse. Continues from
+		// the previous call, so calls with decreasing targets make a chain of levels.
+		void Simplify(uint32_t target_num_triangles);
+
+		uint32_t NumTriangles() const
+		{
+			return num_alive_triangles_;
+		}
+		std::vector<uint32_t> Indices() const;
+		// The largest RMS distance so far from a collapsed corner to the original triangle planes around it. It's a
+		// quadric error, not a Hausdorff distance. The surface can move further than it, mostly at sharp features.
+		float Error() const
+		{
+			return error_;
+		}
+
+	private:
+		// The symmetric 4x4 matrix of the plane equations, and the sum of their weights
+		typedef std::array<double, 11> Quadric;
+
+		struct Collapse
+		{
+			float cost;
+			uint32_t from;
+			uint32_t to;
+
+			bool operator<(Collapse const & rhs) const
+			{
+				// The cheapest on the top of the heap
+				return cost > rhs.cost;
+			}
+		};
+
+		float3 const & CornerPosition(uint32_t corner) const
+		{
+			return positions_[corner_vertices_[corner][0]];
+		}
+		void CornerTriangles(uint32_t corner, std::vector<uint32_t>& triangles);
+		void CornerNeighbors(uint32_t corner, std::vector<uint32_t>& neighbors);
+		uint32_t MatchingVertex(uint32_t vertex, uint32_t to_corner, float& attrib_cost) const;
+		float CollapseCost(uint32_t from, uint32_t to);
+		bool CanCollapse(uint32_t from, uint32_t to);
+		void DoCollapse(uint32_t from, uint32_t to);
+		void PushCollapses(uint32_t corner);
+
+		static uint64_t EdgeKey(uint32_t a, uint32_t b)
+		{
+			return (static_cast<uint64_t>(std::min(a, b)) << 32) | std::max(a, b);
+		}
+
+	private:
+		std::vector<float3> positions_;
+		std::vector<float> attribs_;
+		uint32_t num_attribs_;
+
+		std::vector<uint32_t> indices_;
+		std::vector<char> triangle_alive_;
+		uint32_t num_alive_triangles_;
+		std::vector<std::vector<uint32_t>> vertex_triangles_;
+
+		std::vector<uint32_t> vertex_corners_;
+		std::vector<std::vector<uint32_t>> corner_vertices_;
+		std::vector<char> corner_alive_;
+		std::vector<char> corner_border_;
+		std::vector<Quadric> quadrics_;
+		std::unordered_set<uint64_t> border_edges_;
+
+		std::priority_queue<Collapse> collapses_;
+		float error_;
+
+		std::vector<uint32_t> triangles_cache_;
+		std::vector<uint32_t> from_neighbors_cache_;
+		std::vector<uint32_t> to_neighbors_cache_;
+	};
+
+	struct LodLevel
+	{
+		std::vector<uint32_t> indices;
+		float error;
+	};
+
+	// Level i has about reduction^(i + 1) of the triangles. Stops early when the mesh can't be simplified further.
+	std::vector<LodLevel> GenerateLods(std::vector<uint32_t> const & indices, std::vector<float3> const & positions,
+		std::vector<float> const & attribs, uint32_t num_attribs, uint32_t num_levels, float reduction = 0.5f);
+}
+
+#endif		// _MESHMLLIB_MESHSIMPLIFIER_HPP
@@ -1121,6 +1121,55 @@ namespace KlayGE
 		{
 			std::sort(meshes_.begin(), meshes_.end(), MaterialIDSortOp());
 		}
+
+		mesh_opt_results_.clear();
+		if (user_export_settings & UES_OptimizeMeshes)
+		{
+			std::vector<uint32_t> indices;
+			std::vector<float3> positions;
+			std::vector<uint32_t> remap;
+			for (auto& mesh : meshes_)
+			{
+				if (mesh.triangles.empty())
+				{
+					continue;
+				}
+
+				indices.clear();
+				for (auto const & tri : mesh.triangles)
+				{
+					indices.push_back(tri.vertex_index[0]);
+					indices.push_back(tri.vertex_index[1]);
+					indices.push_back(tri.vertex_index[2]);
+				}
+				positions.clear();
+				for (auto const & vertex : mesh.vertices)
+				{
+					positions.push_back(vertex.position);
+				}
+
+				MeshOptimizationResult const result = OptimizeMesh(remap, indices, positions);
+
+				std::vector<Vertex> vertices(result.num_vertices);
+				for (size_t i = 0; i < remap.size(); ++ i)
+				{
+					if (remap[i] != UNUSED_VERTEX)
+					{
+						vertices[remap[i]] = std::move(mesh.vertices[i]);
+					}
+				}
+				mesh.vertices.swap(vertices);
+
+				for (size_t i = 0; i < mesh.triangles.size(); ++ i)
+				{
+					mesh.triangles[i].vertex_index[0] = indices[i * 3 + 0];
+					mesh.triangles[i].vertex_index[1] = indices[i * 3 + 1];
+					mesh.triangles[i].vertex_index[2] = indices[i * 3 + 2];
+				}
+
+				mesh_opt_results_.emplace_back(mesh.name, result);
+			}
+		}
 	}
 
 	void MeshMLObj::MatrixToDQ(float4x4 const & mat, Quaternion& real, Quaternion& dual) const
@@ -0,0 +1,397 @@
+/**
+ * @file MeshOptimizer.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of MeshMLLib, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KFL/KFL.hpp>
+#include <KFL/Math.hpp>
+#include <MeshMLLib/MeshOptimizer.hpp>
+
+#include <algorithm>
+
+#include <boost/assert.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	// A vertex is in the cache if less than cache_size vertices entered it after this one. Moving the time forward by
+	// more than cache_size empties the cache.
+	class VertexCache
+	{
+	public:
+		VertexCache(uint32_t num_vertices, uint32_t cache_size)
+			: cache_size_(cache_size), time_(cache_size + 1), timestamps_(num_vertices, 0)
+		{
+		}
+
+		bool Contains(uint32_t v) const
+		{
+			return time_ - timestamps_[v] <= cache_size_;
+		}
+
+		// Returns 1 for a miss
+		uint32_t Access(uint32_t v)
+		{
+			if (this->Contains(v))
+			{
+				return 0;
+			}
+			else
+			{
+				timestamps_[v] = time_;
+				++ time_;
+				return 1;
+			}
+		}
+
+		uint32_t AccessTriangle(uint32_t const * tri)
+		{
+			return this->Access(tri[0]) + this->Access(tri[1]) + this->Access(tri[2]);
+		}
+
+		void Flush()
+		{
+			time_ += cache_size_ + 1;
+		}
+
+		// How long ago the vertex entered the cache
+		uint32_t Age(uint32_t v) const
+		{
+			return time_ - timestamps_[v];
+		}
+
+		uint32_t CacheSize() const
+		{
+			return cache_size_;
+		}
+
+	private:
+		uint32_t cache_size_;
+		uint32_t time_;
+		std::vector<uint32_t> timestamps_;
+	};
+}
+
+namespace KlayGE
+{
+	VertexCacheStatistics AnalyzeVertexCache(std::vector<uint32_t> const & indices, uint32_t num_vertices, uint32_t cache_size)
+	{
+		BOOST_ASSERT(indices.size() % 3 == 0);
+
+		VertexCache cache(num_vertices, cache_size);
+		std::vector<char> used(num_vertices, false);
+		uint32_t num_used = 0;
+		uint32_t misses = 0;
+		for (auto const index : indices)
+		{
+			misses += cache.Access(index);
+			if (!used[index])
+			{
+				used[index] = true;
+				++ num_used;
+			}
+		}
+
+		VertexCacheStatistics ret;
+		ret.acmr = indices.empty() ? 0.0f : static_cast<float>(misses) / (indices.size() / 3);
+		ret.atvr = (0 == num_used) ? 0.0f : static_cast<float>(misses) / num_used;
+		return ret;
+	}
+
+	std::vector<uint32_t> OptimizeVertexCache(std::vector<uint32_t>& indices, uint32_t num_vertices, uint32_t cache_size)
+	{
+		BOOST_ASSERT(indices.size() % 3 == 0);
+
+		uint32_t const num_triangles = static_cast<uint32_t>(indices.size() / 3);
+		std::vector<uint32_t> clusters;
+		if (0 == num_triangles)
+		{
+			return clusters;
+		}
+
+		// Triangles around each vertex, and how many of them are still to emit
+		std::vector<uint32_t> live(num_vertices, 0);
+		for (auto const index : indices)
+		{
+			++ live[index];
+		}
+		std::vector<uint32_t> adjacency_offsets(num_vertices + 1, 0);
+		for (uint32_t i = 0; i < num_vertices; ++ i)
+		{
+			adjacency_offsets[i + 1] = adjacency_offsets[i] + live[i];
+		}
+		std::vector<uint32_t> adjacency(indices.size());
+		{
+			std::vector<uint32_t> fill(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+			for (uint32_t i = 0; i < indices.size(); ++ i)
+			{
+				adjacency[fill[indices[i]]] = i / 3;
+				++ fill[indices[i]];
+			}
+		}
+
+		VertexCache cache(num_vertices, cache_size);
+		std::vector<char> emitted(num_triangles, false);
+		std::vector<uint32_t> dead_ends;
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> sorted;
+		sorted.reserve(indices.size());
+
+		uint32_t cursor = 0;
+		while ((cursor < num_vertices) && (0 == live[cursor]))
+		{
+			++ cursor;
+		}
+
+		uint32_t fanning = cursor;
+		clusters.push_back(0);
+		while (fanning < num_vertices)
+		{
+			candidates.clear();
+			for (uint32_t i = adjacency_offsets[fanning]; i < adjacency_offsets[fanning + 1]; ++ i)
+			{
+				uint32_t const tri = adjacency[i];
+				if (!emitted[tri])
+				{
+					for (uint32_t j = 0; j < 3; ++ j)
+					{
+						uint32_t const v = indices[tri * 3 + j];
+						sorted.push_back(v);
+						dead_ends.push_back(v);
+						candidates.push_back(v);
+						-- live[v];
+						cache.Access(v);
+					}
+					emitted[tri] = true;
+				}
+			}
+
+			// The candidate that entered the cache earliest and still stays there after its fan is emitted. As in the
+			// paper, candidates that would drop out of the cache have priority 0, which still beats the -1 sentinel, so
+			// the walk only goes to a dead end when no candidate has live triangles.
+			uint32_t next = num_vertices;
+			int32_t best_priority = -1;
+			for (auto const v : candidates)
+			{
+				if (live[v] > 0)
+				{
+					int32_t priority = 0;
+					if (cache.Age(v) + 2 * live[v] <= cache.CacheSize())
+					{
+						priority = static_cast<int32_t>(cache.Age(v));
+					}
+					if (priority > best_priority)
+					{
+						best_priority = priority;
+						next = v;
+					}
+				}
+			}
+
+			// A jump to a dead end or to the next unused vertex starts a new cluster
+			if (next == num_vertices)
+			{
+				while (!dead_ends.empty())
+				{
+					uint32_t const v = dead_ends.back();
+					dead_ends.pop_back();
+					if (live[v] > 0)
+					{
+						next = v;
+						break;
+					}
+				}
+
+				if (next == num_vertices)
+				{
+					while ((cursor < num_vertices) && (0 == live[cursor]))
+					{
+						++ cursor;
+					}
+					next = cursor;
+				}
+
+				if (next < num_vertices)
+				{
+					clusters.push_back(static_cast<uint32_t>(sorted.size() / 3));
+				}
+			}
+
+			fanning = next;
+		}
+
+		BOOST_ASSERT(sorted.size() == indices.size());
+		indices.swap(sorted);
+
+		return clusters;
+	}
+
+	void OptimizeOverdraw(std::vector<uint32_t>& indices, std::vector<uint32_t> const & clusters,
+		std::vector<float3> const & positions, float threshold, uint32_t cache_size)
+	{
+		BOOST_ASSERT(indices.size() % 3 == 0);
+
+		uint32_t const num_triangles = static_cast<uint32_t>(indices.size() / 3);
+		if (0 == num_triangles)
+		{
+			return;
+		}
+
+		// No clusters means the whole mesh is one
+		std::vector<uint32_t> const whole_mesh(1, 0);
+		std::vector<uint32_t> const & hard_clusters = clusters.empty() ? whole_mesh : clusters;
+
+		// Split the clusters where the cache misses so far are already close to the whole cluster's
+		std::vector<uint32_t> soft_clusters;
+		{
+			VertexCache cache(static_cast<uint32_t>(positions.size()), cache_size);
+			for (size_t c = 0; c < hard_clusters.size(); ++ c)
+			{
+				uint32_t const begin = hard_clusters[c];
+				uint32_t const end = (c + 1 < hard_clusters.size()) ? hard_clusters[c + 1] : num_triangles;
+
+				cache.Flush();
+				uint32_t cluster_misses = 0;
+				for (uint32_t i = begin; i < end; ++ i)
+				{
+					cluster_misses += cache.AccessTriangle(&indices[i * 3]);
+				}
+				float const max_acmr = threshold * cluster_misses / (end - begin);
+
+				cache.Flush();
+				soft_clusters.push_back(begin);
+				uint32_t misses = 0;
+				uint32_t start = begin;
+				for (uint32_t i = begin; i < end - 1; ++ i)
+				{
+					misses += cache.AccessTriangle(&indices[i * 3]);
+					if (misses <= max_acmr * (i + 1 - start))
+					{
+						cache.Flush();
+						soft_clusters.push_back(i + 1);
+						misses = 0;
+						start = i + 1;
+					}
+				}
+			}
+		}
+
+		uint32_t const num_clusters = static_cast<uint32_t>(soft_clusters.size());
+		std::vector<float3> centroids(num_clusters);
+		std::vector<float3> normals(num_clusters);
+		float3 mesh_centroid(0, 0, 0);
+		float mesh_area = 0;
+		for (uint32_t c = 0; c < num_clusters; ++ c)
+		{
+			uint32_t const begin = soft_clusters[c];
+			uint32_t const end = (c + 1 < num_clusters) ? soft_clusters[c + 1] : num_triangles;
+
+			float3 centroid(0, 0, 0);
+			float3 normal(0, 0, 0);
+			float area = 0;
+			for (uint32_t i = begin; i < end; ++ i)
+			{
+				float3 const & p0 = positions[indices[i * 3 + 0]];
+				float3 const & p1 = positions[indices[i * 3 + 1]];
+				float3 const & p2 = positions[indices[i * 3 + 2]];
+				float3 const n = MathLib::cross(p1 - p0, p2 - p0);
+				float const a = MathLib::length(n);
+				centroid += (p0 + p1 + p2) * (a / 3);
+				normal += n;
+				area += a;
+			}
+
+			mesh_centroid += centroid;
+			mesh_area += area;
+			centroids[c] = (area > 0) ? centroid / area : positions[indices[begin * 3]];
+			float const normal_len = MathLib::length(normal);
+			normals[c] = (normal_len > 0) ? normal / normal_len : float3(0, 0, 0);
+		}
+		if (mesh_area > 0)
+		{
+			mesh_centroid /= mesh_area;
+		}
+
+		// Clusters on the outside facing away from the center occlude the others, so they go first
+		std::vector<float> occluder_scores(num_clusters);
+		std::vector<uint32_t> order(num_clusters);
+		for (uint32_t c = 0; c < num_clusters; ++ c)
+		{
+			occluder_scores[c] = MathLib::dot(centroids[c] - mesh_centroid, normals[c]);
+			order[c] = c;
+		}
+		std::stable_sort(order.begin(), order.end(),
+			[&occluder_scores](uint32_t lhs, uint32_t rhs)
+			{
+				return occluder_scores[lhs] > occluder_scores[rhs];
+			});
+
+		std::vector<uint32_t> sorted;
+		sorted.reserve(indices.size());
+		for (auto const c : order)
+		{
+			uint32_t const begin = soft_clusters[c];
+			uint32_t const end = (c + 1 < num_clusters) ? soft_clusters[c + 1] : num_triangles;
+			sorted.insert(sorted.end(), indices.begin() + begin * 3, indices.begin() + end * 3);
+		}
+		indices.swap(sorted);
+	}
+
+	uint32_t OptimizeVertexFetch(std::vector<uint32_t>& remap, std::vector<uint32_t>& indices, uint32_t num_vertices)
+	{
+		remap.assign(num_vertices, UNUSED_VERTEX);
+		uint32_t num_used = 0;
+		for (auto& index : indices)
+		{
+			if (UNUSED_VERTEX == remap[index])
+			{
+				remap[index] = num_used;
+				++ num_used;
+			}
+			index = remap[index];
+		}
+		return num_used;
+	}
+
+	MeshOptimizationResult OptimizeMesh(std::vector<uint32_t>& remap, std::vector<uint32_t>& indices,
+		std::vector<float3> const & positions)
+	{
+		uint32_t const num_vertices = static_cast<uint32_t>(positions.size());
+
+		MeshOptimizationResult ret;
+		ret.before = AnalyzeVertexCache(indices, num_vertices);
+
+		std::vector<uint32_t> const clusters = OptimizeVertexCache(indices, num_vertices);
+		OptimizeOverdraw(indices, clusters, positions);
+		ret.num_vertices = OptimizeVertexFetch(remap, indices, num_vertices);
+
+		ret.after = AnalyzeVertexCache(indices, ret.num_vertices);
+		return ret;
+	}
+}
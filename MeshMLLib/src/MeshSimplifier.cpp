@@ -0,0 +1,527 @@
+/**
+ * @file MeshSimplifier.cpp
+ * @author Minmin Gong
+ *
+ * @section DESCRIPTION
+ *
+ * This source file is part of MeshMLLib, a subproject of KlayGE
+ * For the latest info, see http://www.klayge.org
+ *
+ * @section LICENSE
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published
+ * by the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ *
+ * You may alternatively use this source under the terms of
+ * the KlayGE Proprietary License (KPL). You can obtained such a license
+ * from http://www.klayge.org/licensing/.
+ */
+
+#include <KFL/KFL.hpp>
+#include <KFL/Math.hpp>
+#include <MeshMLLib/MeshSimplifier.hpp>
+
+#include <cmath>
+#include <limits>
+#include <map>
+#include <unordered_map>
+
+#include <boost/assert.hpp>
+
+namespace
+{
+	using namespace KlayGE;
+
+	float const REJECTED_COST = std::numeric_limits<float>::max();
+
+	// Squared distance to the plane ax + by + cz + d = 0, times weight. Stored as the upper half of the symmetric 4x4 matrix,
+	// followed by the weight.
+	std::array<double, 11> PlaneQuadric(double a, double b, double c, double d, double weight)
+	{
+		return { { a * a * weight, a * b * weight, a * c * weight, a * d * weight,
+			b * b * weight, b * c * weight, b * d * weight,
+			c * c * weight, c * d * weight,
+			d * d * weight,
+			weight } };
+	}
+
+	void AddQuadric(std::array<double, 11>& lhs, std::array<double, 11> const & rhs)
+	{
+		for (size_t i = 0; i < lhs.size(); ++ i)
+		{
+			lhs[i] += rhs[i];
+		}
+	}
+
+	double EvaluateQuadric(std::array<double, 11> const & q, float3 const & p)
+	{
+		double const x = p.x();
+		double const y = p.y();
+		double const z = p.z();
+		double const ret = q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+			+ q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+			+ q[7] * z * z + 2 * q[8] * z
+			+ q[9];
+		// Rounding could make it a little negative
+		return std::max(ret, 0.0);
+	}
+}
+
+namespace KlayGE
+{
+	MeshSimplifier::MeshSimplifier(std::vector<uint32_t> const & indices, std::vector<float3> const & positions,
+			std::vector<float> const & attribs, uint32_t num_attribs)
+		: positions_(positions), attribs_(attribs), num_attribs_(num_attribs),
+			indices_(indices), num_alive_triangles_(0),
+			error_(0)
+	{
+		BOOST_ASSERT(indices.size() % 3 == 0);
+		BOOST_ASSERT(attribs.size() == positions.size() * num_attribs);
+
+		uint32_t const num_vertices = static_cast<uint32_t>(positions_.size());
+		uint32_t const num_triangles = static_cast<uint32_t>(indices_.size() / 3);
+
+		// Vertices with exactly the same position are one corner
+		{
+			std::map<std::array<float, 3>, uint32_t> corner_map;
+			vertex_corners_.resize(num_vertices);
+			for (uint32_t i = 0; i < num_vertices; ++ i)
+			{
+				std::array<float, 3> const key = { { positions_[i].x(), positions_[i].y(), positions_[i].z() } };
+				auto iter = corner_map.emplace(key, static_cast<uint32_t>(corner_vertices_.size())).first;
+				if (iter->second == corner_vertices_.size())
+				{
+					corner_vertices_.emplace_back();
+				}
+				vertex_corners_[i] = iter->second;
+				corner_vertices_[iter->second].push_back(i);
+			}
+		}
+		uint32_t const num_corners = static_cast<uint32_t>(corner_vertices_.size());
+		corner_alive_.assign(num_corners, true);
+		corner_border_.assign(num_corners, false);
+		quadrics_.assign(num_corners, Quadric());
+
+		triangle_alive_.assign(num_triangles, false);
+		vertex_triangles_.resize(num_vertices);
+		std::unordered_map<uint64_t, uint32_t> edge_counts;
+		for (uint32_t i = 0; i < num_triangles; ++ i)
+		{
+			uint32_t const c0 = vertex_corners_[indices_[i * 3 + 0]];
+			uint32_t const c1 = vertex_corners_[indices_[i * 3 + 1]];
+			uint32_t const c2 = vertex_corners_[indices_[i * 3 + 2]];
+			if ((c0 != c1) && (c1 != c2) && (c2 != c0))
+			{
+				triangle_alive_[i] = true;
+				++ num_alive_triangles_;
+				for (uint32_t j = 0; j < 3; ++ j)
+				{
+					vertex_triangles_[indices_[i * 3 + j]].push_back(i);
+				}
+
+				++ edge_counts[EdgeKey(c0, c1)];
+				++ edge_counts[EdgeKey(c1, c2)];
+				++ edge_counts[EdgeKey(c2, c0)];
+			}
+		}
+		for (auto const & edge : edge_counts)
+		{
+			if (1 == edge.second)
+			{
+				border_edges_.insert(edge.first);
+				corner_border_[edge.first >> 32] = true;
+				corner_border_[edge.first & 0xFFFFFFFF] = true;
+			}
+		}
+
+		for (uint32_t i = 0; i < num_triangles; ++ i)
+		{
+			if (!triangle_alive_[i])
+			{
+				continue;
+			}
+
+			uint32_t const corners[] = { vertex_corners_[indices_[i * 3 + 0]], vertex_corners_[indices_[i * 3 + 1]],
+				vertex_corners_[indices_[i * 3 + 2]] };
+			float3 const & p0 = this->CornerPosition(corners[0]);
+			float3 const & p1 = this->CornerPosition(corners[1]);
+			float3 const & p2 = this->CornerPosition(corners[2]);
+			float3 normal = MathLib::cross(p1 - p0, p2 - p0);
+			float const len = MathLib::length(normal);
+			if (len <= 0)
+			{
+				continue;
+			}
+			normal /= len;
+
+			Quadric const q = PlaneQuadric(normal.x(), normal.y(), normal.z(), -MathLib::dot(normal, p0), 1);
+			for (uint32_t j = 0; j < 3; ++ j)
+			{
+				AddQuadric(quadrics_[corners[j]], q);
+			}
+
+			// A plane through each border edge, perpendicular to the triangle, keeps the border from moving inwards
+			for (uint32_t j = 0; j < 3; ++ j)
+			{
+				uint32_t const a = corners[j];
+				uint32_t const b = corners[(j + 1) % 3];
+				if (border_edges_.find(EdgeKey(a, b)) != border_edges_.end())
+				{
+					float3 const & pa = this->CornerPosition(a);
+					float3 border_normal = MathLib::cross(this->CornerPosition(b) - pa, normal);
+					float const border_len = MathLib::length(border_normal);
+					if (border_len > 0)
+					{
+						border_normal /= border_len;
+						Quadric const bq = PlaneQuadric(border_normal.x(), border_normal.y(), border_normal.z(),
+							-MathLib::dot(border_normal, pa), 1);
+						AddQuadric(quadrics_[a], bq);
+						AddQuadric(quadrics_[b], bq);
+					}
+				}
+			}
+		}
+
+		for (uint32_t i = 0; i < num_corners; ++ i)
+		{
+			this->PushCollapses(i);
+		}
+	}
+
+	void MeshSimplifier::Simplify(uint32_t target_num_triangles)
+	{
+		while ((num_alive_triangles_ > target_num_triangles) && !collapses_.empty())
+		{
+			Collapse const collapse = collapses_.top();
+			collapses_.pop();
+
+			if (!corner_alive_[collapse.from] || !corner_alive_[collapse.to])
+			{
+				continue;
+			}
+
+			// Costs get stale when the neighborhood changes. A stale collapse that got more expensive waits for its turn.
+			float const cost = this->CollapseCost(collapse.from, collapse.to);
+			if (cost >= REJECTED_COST)
+			{
+				continue;
+			}
+			if (cost > collapse.cost * 1.0001f + 1e-12f)
+			{
+				collapses_.push({ cost, collapse.from, collapse.to });
+				continue;
+			}
+
+			if (this->CanCollapse(collapse.from, collapse.to))
+			{
+				this->DoCollapse(collapse.from, collapse.to);
+			}
+		}
+	}
+
+	std::vector<uint32_t> MeshSimplifier::Indices() const
+	{
+		std::vector<uint32_t> ret;
+		ret.reserve(num_alive_triangles_ * 3);
+		for (uint32_t i = 0; i < triangle_alive_.size(); ++ i)
+		{
+			if (triangle_alive_[i])
+			{
+				ret.insert(ret.end(), indices_.begin() + i * 3, indices_.begin() + i * 3 + 3);
+			}
+		}
+		return ret;
+	}
+
+	void MeshSimplifier::CornerTriangles(uint32_t corner, std::vector<uint32_t>& triangles)
+	{
+		triangles.clear();
+		for (auto const v : corner_vertices_[corner])
+		{
+			auto& vt = vertex_triangles_[v];
+			vt.erase(std::remove_if(vt.begin(), vt.end(),
+				[this](uint32_t tri)
+				{
+					return !triangle_alive_[tri];
+				}), vt.end());
+			triangles.insert(triangles.end(), vt.begin(), vt.end());
+		}
+	}
+
+	void MeshSimplifier::CornerNeighbors(uint32_t corner, std::vector<uint32_t>& neighbors)
+	{
+		this->CornerTriangles(corner, triangles_cache_);
+
+		neighbors.clear();
+		for (auto const tri : triangles_cache_)
+		{
+			for (uint32_t j = 0; j < 3; ++ j)
+			{
+				uint32_t const c = vertex_corners_[indices_[tri * 3 + j]];
+				if (c != corner)
+				{
+					neighbors.push_back(c);
+				}
+			}
+		}
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+	}
+
+	uint32_t MeshSimplifier::MatchingVertex(uint32_t vertex, uint32_t to_corner, float& attrib_cost) const
+	{
+		// Among the vertices across the edge in the triangles of this vertex, the one with the closest attributes. There's
+		// none if the edge is on a seam and this vertex is on the other side of it.
+		uint32_t ret = UINT32_MAX;
+		attrib_cost = REJECTED_COST;
+		for (auto const tri : vertex_triangles_[vertex])
+		{
+			if (!triangle_alive_[tri])
+			{
+				continue;
+			}
+
+			for (uint32_t j = 0; j < 3; ++ j)
+			{
+				uint32_t const w = indices_[tri * 3 + j];
+				if (vertex_corners_[w] == to_corner)
+				{
+					float cost = 0;
+					for (uint32_t k = 0; k < num_attribs_; ++ k)
+					{
+						float const diff = attribs_[vertex * num_attribs_ + k] - attribs_[w * num_attribs_ + k];
+						cost += diff * diff;
+					}
+					if ((UINT32_MAX == ret) || (cost < attrib_cost))
+					{
+						ret = w;
+						attrib_cost = cost;
+					}
+				}
+			}
+		}
+		return ret;
+	}
+
+	float MeshSimplifier::CollapseCost(uint32_t from, uint32_t to)
+	{
+		if (corner_border_[from] && (border_edges_.find(EdgeKey(from, to)) == border_edges_.end()))
+		{
+			return REJECTED_COST;
+		}
+
+		Quadric q = quadrics_[from];
+		AddQuadric(q, quadrics_[to]);
+		double cost = EvaluateQuadric(q, this->CornerPosition(to));
+
+		bool connected = false;
+		for (auto const u : corner_vertices_[from])
+		{
+			bool used = false;
+			for (auto const tri : vertex_triangles_[u])
+			{
+				if (triangle_alive_[tri])
+				{
+					used = true;
+					break;
+				}
+			}
+			if (!used)
+			{
+				continue;
+			}
+
+			float attrib_cost;
+			if (UINT32_MAX == this->MatchingVertex(u, to, attrib_cost))
+			{
+				return REJECTED_COST;
+			}
+			cost += attrib_cost;
+			connected = true;
+		}
+
+		return connected ? static_cast<float>(cost) : REJECTED_COST;
+	}
+
+	bool MeshSimplifier::CanCollapse(uint32_t from, uint32_t to)
+	{
+		// Link condition. The only corners next to both are the ones opposite the edge, otherwise the collapse pinches
+		// the surface.
+		this->CornerNeighbors(to, to_neighbors_cache_);
+		this->CornerNeighbors(from, from_neighbors_cache_);
+		this->CornerTriangles(from, triangles_cache_);
+
+		uint32_t num_opposites = 0;
+		for (auto const tri : triangles_cache_)
+		{
+			uint32_t const c0 = vertex_corners_[indices_[tri * 3 + 0]];
+			uint32_t const c1 = vertex_corners_[indices_[tri * 3 + 1]];
+			uint32_t const c2 = vertex_corners_[indices_[tri * 3 + 2]];
+			if ((c0 == to) || (c1 == to) || (c2 == to))
+			{
+				++ num_opposites;
+				continue;
+			}
+
+			// No triangle flips over
+			float3 const p0 = (c0 == from) ? this->CornerPosition(to) : this->CornerPosition(c0);
+			float3 const p1 = (c1 == from) ? this->CornerPosition(to) : this->CornerPosition(c1);
+			float3 const p2 = (c2 == from) ? this->CornerPosition(to) : this->CornerPosition(c2);
+			float3 const & o0 = this->CornerPosition(c0);
+			float3 const & o1 = this->CornerPosition(c1);
+			float3 const & o2 = this->CornerPosition(c2);
+			float3 const old_normal = MathLib::cross(o1 - o0, o2 - o0);
+			float3 const new_normal = MathLib::cross(p1 - p0, p2 - p0);
+			if (MathLib::dot(old_normal, new_normal) <= 0)
+			{
+				return false;
+			}
+		}
+		if (0 == num_opposites)
+		{
+			return false;
+		}
+
+		uint32_t num_common = 0;
+		auto iter = to_neighbors_cache_.begin();
+		for (auto const c : from_neighbors_cache_)
+		{
+			while ((iter != to_neighbors_cache_.end()) && (*iter < c))
+			{
+				++ iter;
+			}
+			if ((iter != to_neighbors_cache_.end()) && (*iter == c))
+			{
+				++ num_common;
+			}
+		}
+		// Every triangle on the edge has its own opposite corner. 2 on the inside, 1 on the border.
+		return num_common <= num_opposites;
+	}
+
+	void MeshSimplifier::DoCollapse(uint32_t from, uint32_t to)
+	{
+		this->CornerNeighbors(from, from_neighbors_cache_);
+
+		for (auto const u : corner_vertices_[from])
+		{
+			float attrib_cost;
+			uint32_t const w = this->MatchingVertex(u, to, attrib_cost);
+			if (UINT32_MAX == w)
+			{
+				// Not used by any live triangle
+				continue;
+			}
+
+			for (auto const tri : vertex_triangles_[u])
+			{
+				if (!triangle_alive_[tri])
+				{
+					continue;
+				}
+
+				bool on_edge = false;
+				for (uint32_t j = 0; j < 3; ++ j)
+				{
+					on_edge |= (vertex_corners_[indices_[tri * 3 + j]] == to);
+				}
+				if (on_edge)
+				{
+					triangle_alive_[tri] = false;
+					-- num_alive_triangles_;
+				}
+				else
+				{
+					for (uint32_t j = 0; j < 3; ++ j)
+					{
+						if (indices_[tri * 3 + j] == u)
+						{
+							indices_[tri * 3 + j] = w;
+						}
+					}
+					vertex_triangles_[w].push_back(tri);
+				}
+			}
+			vertex_triangles_[u].clear();
+		}
+
+		for (auto const c : from_neighbors_cache_)
+		{
+			auto iter = border_edges_.find(EdgeKey(from, c));
+			if (iter != border_edges_.end())
+			{
+				border_edges_.erase(iter);
+				if (c != to)
+				{
+					border_edges_.insert(EdgeKey(to, c));
+				}
+			}
+		}
+
+		AddQuadric(quadrics_[to], quadrics_[from]);
+		corner_alive_[from] = false;
+		error_ = std::max(error_, static_cast<float>(std::sqrt(EvaluateQuadric(quadrics_[to], this->CornerPosition(to)) / quadrics_[to][10])));
+
+		this->PushCollapses(to);
+	}
+
+	void MeshSimplifier::PushCollapses(uint32_t corner)
+	{
+		std::vector<uint32_t> neighbors;
+		this->CornerNeighbors(corner, neighbors);
+		for (auto const c : neighbors)
+		{
+			float const cost = this->CollapseCost(corner, c);
+			if (cost < REJECTED_COST)
+			{
+				collapses_.push({ cost, corner, c });
+			}
+			float const reverse_cost = this->CollapseCost(c, corner);
+			if (reverse_cost < REJECTED_COST)
+			{
+				collapses_.push({ reverse_cost, c, corner });
+			}
+		}
+	}
+
+	std::vector<LodLevel> GenerateLods(std::vector<uint32_t> const & indices, std::vector<float3> const & positions,
+		std::vector<float> const & attribs, uint32_t num_attribs, uint32_t num_levels, float reduction)
+	{
+		std::vector<LodLevel> ret;
+
+		MeshSimplifier simplifier(indices, positions, attribs, num_attribs);
+		uint32_t num_triangles = simplifier.NumTriangles();
+		float target = static_cast<float>(num_triangles);
+		for (uint32_t i = 0; i < num_levels; ++ i)
+		{
+			target *= reduction;
+			simplifier.Simplify(static_cast<uint32_t>(target));
+
+			// Not worth another draw range if it barely got simpler
+			uint32_t const new_num_triangles = simplifier.NumTriangles();
+			if ((0 == new_num_triangles) || (new_num_triangles > num_triangles * (1 + reduction) / 2))
+			{
+				break;
+			}
+
+			LodLevel level;
+			level.indices = simplifier.Indices();
+			level.error = simplifier.Error();
+			ret.push_back(std::move(level));
+			num_triangles = new_num_triangles;
+		}
+
+		return ret;
+	}
+}